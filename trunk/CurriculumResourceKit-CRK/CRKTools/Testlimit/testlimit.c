@@ -32,11 +32,21 @@ BOOL EnablePrivilege(PTCHAR Privilege)
 void Usage()
 {
     printf("usage: testlimit [-p [-n]] | [-t] | [-h] | [-u] | [-g [object size]] | [-m [MB]]\n");
+    printf("       testlimit -r <h|t|p|v|f> [seconds] [threads] [-c]\n");
     printf("  -g       Create GDI handles of specified size (default 1 byte)\n");
     printf("  -h       Create handles\n");
     printf("  -m       Leak memory in specified MBs (default is 1)\n");
     printf("  -n       Set min working set of processes to smallest\n");
     printf("  -p       Create processes.\n");
+    printf("  -r       Measure operation rates with 1, 2, 4... threads up to the\n");
+    printf("           specified count (default is the number of CPUs), for the\n");
+    printf("           specified seconds (default 5) at each thread count:\n");
+    printf("             h  create/close event handles\n");
+    printf("             t  create/exit threads\n");
+    printf("             p  create/exit processes\n");
+    printf("             v  VirtualAlloc, touch and free pages (counts page faults)\n");
+    printf("             f  read pages of a mapped file view (counts page reads)\n");
+    printf("           -c prints comma separated values\n");
     printf("  -t       Create threads\n");
     printf("  -u       Create USER handles\n");
 }
@@ -56,6 +66,222 @@ DWORD WINAPI ThreadProc(LPVOID lpParameter)
 }
 
 
+//
+// Rate mode state. Each worker loops on its operation until RateStop is
+// set and bumps RateCount once per operation; the main thread samples the
+// count once a second.
+//
+
+#define RATE_VIRTUAL_SIZE   (64 * 1024)
+#define RATE_MAPPED_SIZE    (4 * 1024 * 1024)
+
+volatile LONG RateStop;
+volatile LONG RateCount;
+char RateTest;
+ULONG RatePageSize;
+PUCHAR RateView;
+
+
+DWORD WINAPI ExitThreadProc(LPVOID lpParameter)
+{
+    return 0;
+}
+
+
+DWORD WINAPI RateThreadProc(LPVOID lpParameter)
+{
+    STARTUPINFO startup;
+    PROCESS_INFORMATION procinfo;
+    HANDLE handle;
+    PUCHAR buffer;
+    ULONG offset;
+    volatile UCHAR sum = 0;
+
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+
+    while (!RateStop) {
+        switch (RateTest) {
+        case 'h':
+            handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+            if (handle == NULL) return GetLastError();
+            CloseHandle(handle);
+            InterlockedIncrement(&RateCount);
+            break;
+
+        case 't':
+            handle = CreateThread(NULL, 0, ExitThreadProc, 0, 0, NULL);
+            if (handle == NULL) return GetLastError();
+            WaitForSingleObject(handle, INFINITE);
+            CloseHandle(handle);
+            InterlockedIncrement(&RateCount);
+            break;
+
+        case 'p':
+            if (!CreateProcess("testlimit.exe", "testlimit x", NULL, NULL, FALSE, 0, NULL, NULL, &startup, &procinfo)) {
+                return GetLastError();
+            }
+            WaitForSingleObject(procinfo.hProcess, INFINITE);
+            CloseHandle(procinfo.hThread);
+            CloseHandle(procinfo.hProcess);
+            InterlockedIncrement(&RateCount);
+            break;
+
+        case 'v':
+            buffer = VirtualAlloc(NULL, RATE_VIRTUAL_SIZE, MEM_COMMIT, PAGE_READWRITE);
+            if (buffer == NULL) return GetLastError();
+            for (offset = 0; offset < RATE_VIRTUAL_SIZE; offset += RatePageSize) {
+                buffer[offset] = 1;
+            }
+            VirtualFree(buffer, 0, MEM_RELEASE);
+            InterlockedExchangeAdd(&RateCount, RATE_VIRTUAL_SIZE / RatePageSize);
+            break;
+
+        case 'f':
+
+            //
+            // Only the first pass takes read faults; later passes measure
+            // faults only for pages the working set manager has trimmed.
+            //
+
+            for (offset = 0; offset < RATE_MAPPED_SIZE && !RateStop; offset += RatePageSize) {
+                sum += RateView[offset];
+                InterlockedIncrement(&RateCount);
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
+BOOL RateMapFile()
+// Creates a temporary file and maps a view of it for the mapped read test.
+{
+    char path[MAX_PATH], name[MAX_PATH];
+    HANDLE hFile, hSection;
+    PUCHAR buffer;
+    DWORD written;
+    BOOL result;
+
+    if (!GetTempPath(sizeof(path), path) || !GetTempFileName(path, "tl", 0, name)) {
+        return FALSE;
+    }
+
+    hFile = CreateFile(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    buffer = VirtualAlloc(NULL, RATE_MAPPED_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    if (buffer == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+    result = WriteFile(hFile, buffer, RATE_MAPPED_SIZE, &written, NULL);
+    VirtualFree(buffer, 0, MEM_RELEASE);
+    if (!result) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    hSection = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (hSection == NULL) {
+        return FALSE;
+    }
+
+    RateView = MapViewOfFile(hSection, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hSection);
+    return RateView != NULL;
+}
+
+
+void RateTestRun(char Test, int Seconds, int MaxThreads, BOOL Csv)
+// Runs the rate test with 1, 2, 4... threads up to MaxThreads, reporting
+// the operations completed in each second and the average per thread count.
+{
+    HANDLE threads[MAXIMUM_WAIT_OBJECTS];
+    SYSTEM_INFO sysinfo;
+    LONG previous, current;
+    int nthreads, i, second;
+    DWORD status;
+
+    GetSystemInfo(&sysinfo);
+    RatePageSize = sysinfo.dwPageSize;
+    RateTest = Test;
+
+    if (MaxThreads <= 0) {
+        MaxThreads = sysinfo.dwNumberOfProcessors;
+    }
+    if (MaxThreads > MAXIMUM_WAIT_OBJECTS) {
+        MaxThreads = MAXIMUM_WAIT_OBJECTS;
+    }
+
+    if (Test == 'f' && !RateMapFile()) {
+        printf("Could not map the temporary file. Lasterror: %d\n", GetLastError());
+        PrintError(GetLastError());
+        return;
+    }
+
+    if (Csv) {
+        printf("test,threads,second,operations\n");
+    }
+
+    for (nthreads = 1; ; nthreads = (nthreads * 2 > MaxThreads) ? MaxThreads : nthreads * 2) {
+        RateStop = FALSE;
+        RateCount = 0;
+
+        for (i = 0; i < nthreads; i++) {
+            threads[i] = CreateThread(NULL, 0, RateThreadProc, 0, 0, NULL);
+            if (threads[i] == NULL) {
+                printf("Could not create thread %d. Lasterror: %d\n", i, GetLastError());
+                break;
+            }
+        }
+        nthreads = i;
+
+        previous = 0;
+        for (second = 1; second <= Seconds; second++) {
+            Sleep(1000);
+            current = RateCount;
+            if (Csv) {
+                printf("%c,%d,%d,%d\n", Test, nthreads, second, current - previous);
+            } else {
+                printf("\r%d threads: %d/s  ", nthreads, current - previous);
+            }
+            previous = current;
+        }
+
+        InterlockedExchange(&RateStop, TRUE);
+        WaitForMultipleObjects(nthreads, threads, TRUE, INFINITE);
+
+        for (i = 0; i < nthreads; i++) {
+            if (GetExitCodeThread(threads[i], &status) && status != 0) {
+                printf("\nThread %d stopped early. Lasterror: %d\n", i, status);
+                PrintError(status);
+            }
+            CloseHandle(threads[i]);
+        }
+
+        if (!Csv) {
+            printf("\r%d threads: %d/s average\n", nthreads, previous / Seconds);
+        }
+
+        if (nthreads == 0 || nthreads >= MaxThreads) {
+            break;
+        }
+    }
+
+    if (RateView != NULL) {
+        UnmapViewOfFile(RateView);
+        RateView = NULL;
+    }
+}
+
+
 void PrintError(DWORD ErrorCode)
 {
     HMODULE hModule = NULL; // default to system source
@@ -100,6 +326,8 @@ void main(int argc, char *argv[])
 
     if (argv[1][0] == 't') {
 
+    } else if (argv[1][0] == 'x') {
+        return;
     } else if (argv[1][0] == 'n') {
         EnablePrivilege(SE_INC_BASE_PRIORITY_NAME);
         SetProcessWorkingSetSize(GetCurrentProcess(), 4096, 1024 * 1024);
@@ -186,6 +414,24 @@ void main(int argc, char *argv[])
 
         printf("\rLeaked %d MB of private memory. Lasterror: %d\n", i * gdiSize, GetLastError());
         PrintError(GetLastError());
+    } else if (!stricmp(argv[1], "-r") && argc > 2 && strchr("htpvf", argv[2][0]) && argv[2][0]) {
+        int seconds = 5, threads = 0;
+        BOOL csv = FALSE;
+
+        if (argc > 3 && !stricmp(argv[argc - 1], "-c")) {
+            csv = TRUE;
+            argc--;
+        }
+        if (argc > 3) sscanf(argv[3], "%d", &seconds);
+        if (argc > 4) sscanf(argv[4], "%d", &threads);
+        if (seconds <= 0) seconds = 1;
+
+        if (!csv) {
+            Banner();
+            printf("Measuring rates for %d seconds per thread count...\n", seconds);
+        }
+        RateTestRun(argv[2][0], seconds, threads, csv);
+        return;
     } else {
         Usage();
         return;
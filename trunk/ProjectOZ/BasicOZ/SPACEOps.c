@@ -40,6 +40,15 @@ void SPACE_MapMemory(ulong ctx, ulong vpage, ulong ppage, ulong readmask, ulong
 }
 
 
+EMULscalar2    trapMapMemoryVector;
+
+
+void SPACE_MapMemoryVector(XMapMemory maps[], ulong nmaps)
+{
+    (void) trapMapMemoryVector((ulong)maps, nmaps);
+}
+
+
 EMULscalar1    trapCleanCtx;
 
 
@@ -320,6 +320,7 @@ trap&name& LABEL PROC
     EmulationCall HaltCPU
     EmulationCall GetSPACEParams
     EmulationCall SPACEBreak
+    EmulationCall MapMemoryVector
 
 ; Define the dispatch entries here
 
@@ -96,6 +96,12 @@ typedef union {
 } XMapMemory;
 #define NTSPACE_INVALIDPAGE (0xffffffff)
 
+// apply a vector of MapMemory operations with a single emulation call
+// SPACE reads the vector out of the calling domain, so it is not declared for SPACE itself
+#ifndef SPACE_EXE
+void SPACE_MapMemoryVector(XMapMemory maps[], ulong nmaps);
+#endif
+
 EMULRETURN E(CleanCtx) (EMULCPU  ulong ctx);
 
 ulong E(CreatePortal)       (EMULCPU  uchar type, uchar mode, uchar irql, ulong ctx, ulong handler, ulong protmask);
@@ -492,6 +492,26 @@ EMULRESULT EmulateHardware(NTThreadDescr *ntthreaddescr, ULONG trapdecodeiwhole)
         status = MapMemory(cpu, u->ctx, u->vpage, u->ppage, u->readmask, u->writemask);
     }
     break;
+    case TRAPEMUL_MapMemoryVector:
+    {
+        // copy the vector out of the calling domain a chunk at a time and apply each mapping in order
+        XMapMemory  maps[16];
+        ULONG_PTR   va = arg[0];
+        ULONG       nmaps = arg[1];
+        ULONG       n;
+        ULONG       i;
+
+        while (NT_SUCCESS(status) && nmaps) {
+            n = (nmaps < ASIZEOF(maps)) ? nmaps : ASIZEOF(maps);
+            status = NtReadVirtualMemory(ntthreaddescr->domain->ntprocess, (PVOID)va, maps, n * sizeof(maps[0]), NULL);
+            for (i = 0; NT_SUCCESS(status) && i < n; i++) {
+                status = MapMemory(cpu, maps[i].ctx, maps[i].vpage, maps[i].ppage, maps[i].readmask, maps[i].writemask);
+            }
+            va += n * sizeof(maps[0]);
+            nmaps -= n;
+        }
+    }
+    break;
     case TRAPEMUL_MapIO:
     {
         XMapIO *u = (XMapIO *)arg;
@@ -229,9 +229,14 @@ ULONG CreatePortal(ULONG cpu, UCHAR type, UCHAR mode, UCHAR irql, ULONG ctx, ULO
 }
 
 
+// portalids are handed out sequentially, so the wanted portal is almost always the first entry in its bucket.
+// Check that entry with a 32-bit modulo before falling back to the generic 64-bit lookup.
 Portal * lookupportal(ULONG       portalid)
 {
-    Hashentry   *ptr = LookupHashEntry(PortalHash, ASIZEOF(PortalHash), portalid, NULL);
+    Hashentry   *ptr = PortalHash[portalid % ASIZEOF(PortalHash)];
+
+    if (ptr == NULL || ptr->value != portalid)
+        ptr = LookupHashEntry(PortalHash, ASIZEOF(PortalHash), portalid, NULL);
     return ptr ? CONTAINING_RECORD(ptr, Portal, hash) : NULL;
 }
 
@@ -69,6 +69,7 @@ int main(int ac, char *argv[])
     uportalid = CreatePortal(0, emulationcall, 0, 0, EMULCTX, 0, ACCESSMASK(KERNELMODE) | ACCESSMASK(USERMODE));
     s = MapTrap(0, EMULCTX, trapemul, 1, TRAPEMUL_Noop, 0, uportalid);  FATALFAIL(s, "Map trapemul Noop");
     s = MapTrap(0, EMULCTX, trapemul, 1, TRAPEMUL_MapMemory, 0, kportalid);  FATALFAIL(s, "Map trapemul MapMemory");
+    s = MapTrap(0, EMULCTX, trapemul, 1, TRAPEMUL_MapMemoryVector, 0, kportalid);  FATALFAIL(s, "Map trapemul MapMemoryVector");
     s = MapTrap(0, EMULCTX, trapemul, 1, TRAPEMUL_MapIO, 0, kportalid);  FATALFAIL(s, "Map trapemul MapIO");
     s = MapTrap(0, EMULCTX, trapemul, 1, TRAPEMUL_MapTrap, 0, kportalid);  FATALFAIL(s, "Map trapemul MapTrap");
     s = MapTrap(0, EMULCTX, trapemul, 1, TRAPEMUL_CreatePortal, 0, kportalid);  FATALFAIL(s, "Map trapemul CreatePortal");
@@ -29,7 +29,8 @@
 #define     TRAPEMUL_HaltCPU         16
 #define     TRAPEMUL_GetSPACEParams  17
 #define     TRAPEMUL_Break           18
-#define     NTRAP_EMULCALLS          19
+#define     TRAPEMUL_MapMemoryVector 19
+#define     NTRAP_EMULCALLS          20
 
 #define TRAPTYPE_SERVICETRAP  1      // implement service call
 #define     NTRAP_SERVCALLS         256
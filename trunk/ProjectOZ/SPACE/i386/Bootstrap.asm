@@ -129,6 +129,7 @@ emulationvector:
         defemulcall  HaltCPU        ; 16
         defemulcall  GetSPACEParams ; 17
         defemulcall  SPACEBreak     ; 18
+        defemulcall  MapMemoryVector ; 19
 
 ; must match SystemLib.h
         extern  StudyImage:PROC     ;   SPACEStatus StudyImage(void *imagebase, ulong imagesize, Section imagesections[], int *nimagesections)
@@ -178,6 +179,7 @@ emul_Resume:
     SPACECall    1, HaltCPU,            0, 0, 0 ; void  HaltCPU()
     SPACECall    1, GetSPACEParams,    5, 1, 1 ; void  GetSPACEParams(...)
     SPACECall    1, SPACEBreak,        5, 1, 1 ; void  SPACEBreak(ulong breakvalue, uchar breakmsg[16])
+    SPACECall    1, MapMemoryVector,    2, 0, 0 ; void  MapMemoryVector(XMapMemory maps[], ulong nmaps)
 
 
 ; the table of service calls for BasicOZ:
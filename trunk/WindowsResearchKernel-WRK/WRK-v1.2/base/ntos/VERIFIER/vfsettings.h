@@ -224,6 +224,16 @@ typedef enum {
     // amount of IRPs per device object to log.
     VERIFIER_VALUE_IRPLOG_COUNT,
 
+
+    // These values are the percentage of IRPs, pool allocations, and lock
+    // acquisitions that are verified. The sampling decision is made once per
+    // IRP, allocation, or acquisition with VfRandomGetNumber, so an unsampled
+    // operation pays only for the decision. A value of 100 verifies every
+    // operation, which is the default.
+    VERIFIER_VALUE_IRP_SAMPLE_PERCENTAGE,
+    VERIFIER_VALUE_POOL_SAMPLE_PERCENTAGE,
+    VERIFIER_VALUE_LOCK_SAMPLE_PERCENTAGE,
+
     VERIFIER_VALUE_MAX
 } VERIFIER_VALUE;
 
@@ -43,6 +43,14 @@ LIST_ENTRY CcPostTickWorkQueue;
 
 BOOLEAN CcQueueThrottle = FALSE;
 
+//  Write behind requests are throttled per volume so that one slow device cannot occupy every worker thread while the dirty data of
+//  other volumes waits in the regular queue.  Volumes are hashed on their device object to a small set of buckets, each counting the
+//  write behinds currently queued or running for it.  CcMaxWriteBehindPerVolume is the limit per bucket; zero means size it in
+//  CcInitializeCacheManager.
+
+ULONG CcMaxWriteBehindPerVolume = 0;
+LONG CcActiveWriteBehinds[CC_WRITE_BEHIND_VOLUME_BUCKETS];
+
 //  Store the current idle delay and target time to clean all.  We must calculate the idle delay in terms of clock ticks for the lazy writer timeout.
 
 ULONG CcIdleDelayTick;
@@ -64,6 +72,9 @@ PVACB CcBeyondVacbs;
 LIST_ENTRY CcVacbLru;
 LIST_ENTRY CcVacbFreeList;
 ULONG CcMaxVacbLevelsSeen = 1;
+
+//  Largest unmap behind window for sequential streams.  Zero means size it from the number of Vacbs in CcInitializeVacbs.
+ULONG CcMaxSequentialMapLimit = 0;
 ULONG CcVacbLevelEntries = 0;
 PVACB *CcVacbLevelFreeList = NULL;
 ULONG CcVacbLevelWithBcbsEntries = 0;
@@ -144,6 +155,14 @@ ULONG CcMdlReadNoWaitMiss;
 ULONG CcMdlReadWaitMiss;
 
 ULONG CcReadAheadIos;
+ULONG CcReadAheadPages;
+ULONG CcReadAheadPagesResident;
+
+ULONG CcVacbMaps;
+ULONG CcVacbUnmaps;
+
+ULONG CcDeferredWriteWaits;
+ULONGLONG CcDeferredWriteWaitTime;
 
 ULONG CcLazyWriteHotSpots;
 ULONG CcLazyWriteIos;
@@ -46,6 +46,14 @@ VOID CcReleaseByteRangeFromWrite(IN PSHARED_CACHE_MAP SharedCacheMap,
                                  IN BOOLEAN VerifyRequired);
 PBITMAP_RANGE CcFindBitmapRangeToDirty(IN PMBCB Mbcb, IN LONGLONG Page, IN PULONG *FreePageForSetting);
 PBITMAP_RANGE CcFindBitmapRangeToClean(IN PMBCB Mbcb, IN LONGLONG Page);
+VOID CcTrimBitmapSummary(IN PMBCB Mbcb, IN PBITMAP_RANGE BitmapRange, IN ULONG FirstWord, IN ULONG LastWord);
+VOID CcFlushWriteThrough(IN PSHARED_CACHE_MAP SharedCacheMap, IN PLARGE_INTEGER FileOffset, IN ULONG Length, OUT PIO_STATUS_BLOCK IoStatus);
+LOGICAL CcMatchReadAheadStream(IN PSHARED_CACHE_MAP SharedCacheMap,
+                               IN LONGLONG FileOffset,
+                               IN LONGLONG BeyondLastByte,
+                               IN ULONG ReadAheadSize,
+                               OUT PLARGE_INTEGER ReadAheadOffset,
+                               OUT PULONG ReadAheadLength);
 BOOLEAN CcLogError(IN PFILE_OBJECT FileObject, IN PUNICODE_STRING FileName, IN NTSTATUS Error, IN NTSTATUS DeviceError, IN UCHAR IrpMajorCode);
 
 
@@ -810,6 +818,17 @@ Arguments:
         }
     }
 
+    //  Read Ahead Case 3.
+
+    //  The last reads through this file object do not form a pattern, but the read may continue one of several sequential streams
+    //  interleaved on the file, for example a backup reading several ranges of one file in parallel.
+    else if (CcMatchReadAheadStream(SharedCacheMap, NewOffset.QuadPart, NewBeyond.QuadPart, ReadAheadSize, &FileOffset2, &ReadAheadSize)) {
+        ASSERT(FileOffset2.HighPart >= 0);
+        PrivateCacheMap->ReadAheadOffset[1] = FileOffset2;
+        PrivateCacheMap->ReadAheadLength[1] = ReadAheadSize;
+        Changed = TRUE;
+    }
+
     //  Get out if the ReadAhead requirements did not change.
     if (!Changed || PrivateCacheMap->Flags.ReadAheadActive) {
         DebugTrace(0, me, "Read ahead already in progress or no change\n", 0);
@@ -847,6 +866,97 @@ Arguments:
 }
 
 
+LOGICAL CcMatchReadAheadStream(IN PSHARED_CACHE_MAP SharedCacheMap,
+                               IN LONGLONG FileOffset,
+                               IN LONGLONG BeyondLastByte,
+                               IN ULONG ReadAheadSize,
+                               OUT PLARGE_INTEGER ReadAheadOffset,
+                               OUT PULONG ReadAheadLength)
+/*
+Routine Description:
+    This routine matches a read against the sequential streams recently seen on the file.
+    A read which starts where a stream's last read ended continues that stream, and the stream's read ahead distance is doubled up to CC_MAX_STREAM_READ_AHEAD,
+    so a stream which keeps consuming its read ahead gets more of it.
+    Read ahead is only requested once less than half of the stream's distance remains scheduled beyond the read, and only for the part not already scheduled.
+    A read which matches no stream starts a new one in place of the least recently used.
+Arguments:
+    SharedCacheMap - Supplies the SharedCacheMap of the file.
+    FileOffset - Supplies the offset of the read.
+    BeyondLastByte - Supplies the offset just beyond the read.
+    ReadAheadSize - Supplies the read length rounded up to the read ahead granularity.
+    ReadAheadOffset - Returns the offset to read ahead from.
+    ReadAheadLength - Returns the length to read ahead.
+Return Value:
+    TRUE if read ahead should be scheduled, FALSE otherwise.
+Environment:
+    The ReadAheadSpinLock of the PrivateCacheMap is held.
+*/
+{
+    PREAD_AHEAD_STREAM Stream;
+    PREAD_AHEAD_STREAM Victim;
+    LONGLONG Start;
+    LONGLONG End;
+    ULONG Length;
+    ULONG i;
+    LOGICAL Schedule = FALSE;
+
+    ExAcquireSpinLockAtDpcLevel(&SharedCacheMap->ReadAheadStreamSpinLock);
+    SharedCacheMap->ReadAheadStreamClock += 1;
+    Victim = &SharedCacheMap->ReadAheadStreams[0];
+    for (i = 0; i < CC_READ_AHEAD_STREAMS; i += 1) {
+        Stream = &SharedCacheMap->ReadAheadStreams[i];
+        if ((Stream->BeyondLastByte != 0) &&
+            ((FileOffset & ~(LONGLONG)NOISE_BITS) == (Stream->BeyondLastByte & ~(LONGLONG)NOISE_BITS))) {
+            break;
+        }
+
+        if ((LONG)(Stream->LastUsed - Victim->LastUsed) < 0) {
+            Victim = Stream;
+        }
+    }
+
+    if (i == CC_READ_AHEAD_STREAMS) {
+        //  A new stream, remember where it is but wait for its next read before reading ahead.
+        Victim->BeyondLastByte = BeyondLastByte;
+        Victim->ReadAheadEnd = BeyondLastByte;
+        Victim->ReadAheadLength = 0;
+        Victim->LastUsed = SharedCacheMap->ReadAheadStreamClock;
+        ExReleaseSpinLockFromDpcLevel(&SharedCacheMap->ReadAheadStreamSpinLock);
+        return FALSE;
+    }
+
+    Length = Stream->ReadAheadLength << 1;
+    if (Length < ReadAheadSize) {
+        Length = ReadAheadSize;
+    }
+
+    if (Length > CC_MAX_STREAM_READ_AHEAD) {
+        Length = CC_MAX_STREAM_READ_AHEAD;
+    }
+
+    Stream->ReadAheadLength = Length;
+    Stream->BeyondLastByte = BeyondLastByte;
+    Stream->LastUsed = SharedCacheMap->ReadAheadStreamClock;
+
+    //  If the reader has overtaken the read ahead, start again from the read.
+    if (Stream->ReadAheadEnd < BeyondLastByte) {
+        Stream->ReadAheadEnd = BeyondLastByte;
+    }
+
+    if ((Stream->ReadAheadEnd - BeyondLastByte) < (LONGLONG)(Length >> 1)) {
+        Start = Stream->ReadAheadEnd & ~(LONGLONG)(PAGE_SIZE - 1);
+        End = BeyondLastByte + (LONGLONG)Length;
+        *ReadAheadOffset = *(PLARGE_INTEGER)&Start;
+        *ReadAheadLength = (ULONG)ROUND_TO_PAGES(End - Start);
+        Stream->ReadAheadEnd = End;
+        Schedule = TRUE;
+    }
+
+    ExReleaseSpinLockFromDpcLevel(&SharedCacheMap->ReadAheadStreamSpinLock);
+    return Schedule;
+}
+
+
 VOID FASTCALL CcPerformReadAhead(IN PFILE_OBJECT FileObject)
 /*
 Routine Description:
@@ -864,6 +974,7 @@ Arguments:
     PCACHE_MANAGER_CALLBACKS Callbacks;
     PVOID Context;
     ULONG SavedState;
+    ULONG SavedPagePriority;
     LOGICAL Done;
     LOGICAL HitEof = FALSE;
     LOGICAL ReadAheadPerformed = FALSE;
@@ -878,6 +989,9 @@ Arguments:
 
     MmSavePageFaultReadAhead(Thread, &SavedState);
 
+    //  Pages brought in by read ahead are repurposed first unless they are used again.
+    MmSetPagePriorityThread(Thread, MM_PAGE_PRIORITY_LOW, &SavedPagePriority);
+
     try {
         //  Since we have the open count biased, we can safely access the SharedCacheMap.
         SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
@@ -967,7 +1081,12 @@ Arguments:
                         CcMissCounter = &CcReadAheadIos;
                         while (PagesToGo) {
                             MmSetPageFaultReadAhead(Thread, (PagesToGo - 1));
-                            FaultOccurred |= !MmCheckCachedPageState(CacheBuffer, FALSE);
+                            CcReadAheadPages += 1;
+                            if (MmCheckCachedPageState(CacheBuffer, FALSE)) {
+                                CcReadAheadPagesResident += 1;
+                            } else {
+                                FaultOccurred = TRUE;
+                            }
                             CacheBuffer = (PCHAR)CacheBuffer + PAGE_SIZE;
                             PagesToGo -= 1;
                         }
@@ -993,6 +1112,7 @@ Arguments:
     try_exit: NOTHING;
     } finally{
         MmResetPageFaultReadAhead(Thread, SavedState);
+        MmResetPagePriorityThread(Thread, SavedPagePriority);
         CcMissCounter = &CcThrowAway;
 
         //  If we got an error faulting a single page in, release the Vacb here.
@@ -1131,6 +1251,7 @@ Environment:
     FreeRange->BasePage = BasePage;
     FreeRange->FirstDirtyPage = MAXULONG;
     FreeRange->LastDirtyPage = 0;
+    FreeRange->Summary = 0;
 
     //  If the range does not have a bitmap yet, then consume the one we were passed in.
     if (FreeRange->Bitmap == NULL) {
@@ -1176,6 +1297,50 @@ Environment:
 }
 
 
+//  Internal support routine
+
+
+VOID CcTrimBitmapSummary(IN PMBCB Mbcb, IN PBITMAP_RANGE BitmapRange, IN ULONG FirstWord, IN ULONG LastWord)
+/*
+Routine Description:
+    This routine is called after dirty bits have been cleared from a bitmap range,
+    to clear the Summary bits of any groups of longwords in the cleared span which are now entirely clean.
+Arguments:
+    Mbcb - Supplies the Mbcb owning the range, used to bound the scan of the small initial bitmap.
+    BitmapRange - Supplies the range whose bits were cleared.
+    FirstWord - Supplies the index of the first bitmap longword which was modified.
+    LastWord - Supplies the index of the last bitmap longword which was modified.
+Environment:
+    The BcbSpinLock must be held on entry.
+*/
+{
+    ULONG Word;
+    ULONG EndWord;
+    ULONG BitmapWords;
+
+    //  The initial bitmap embedded in the Mbcb may end in the middle of a group.
+    BitmapWords = MBCB_BITMAP_BLOCK_SIZE / sizeof(ULONG);
+    if (Mbcb->NodeTypeCode != CACHE_NTC_MBCB_GRANDE) {
+        BitmapWords = MBCB_BITMAP_INITIAL_SIZE / sizeof(ULONG);
+    }
+
+    for (FirstWord -= FirstWord % MBCB_SUMMARY_WORDS; FirstWord <= LastWord; FirstWord += MBCB_SUMMARY_WORDS) {
+        EndWord = FirstWord + MBCB_SUMMARY_WORDS;
+        if (EndWord > BitmapWords) {
+            EndWord = BitmapWords;
+        }
+
+        for (Word = FirstWord; (Word < EndWord) && (BitmapRange->Bitmap[Word] == 0); Word++) {
+            NOTHING;
+        }
+
+        if (Word == EndWord) {
+            BitmapRange->Summary &= ~(1 << (FirstWord / MBCB_SUMMARY_WORDS));
+        }
+    }
+}
+
+
 VOID CcSetDirtyInMask(IN PSHARED_CACHE_MAP SharedCacheMap, IN PLARGE_INTEGER FileOffset, IN ULONG Length)
 /*
 Routine Description:
@@ -1313,6 +1478,7 @@ Arguments:
         for (; FirstPage <= LastPage; FirstPage++) {
             if ((*MaskPtr & Mask) == 0) {
                 CcChargeMaskDirtyPages(SharedCacheMap, Mbcb, BitmapRange, 1);
+                CcSetBitmapSummary(BitmapRange, (ULONG)(MaskPtr - BitmapRange->Bitmap));
                 *MaskPtr |= Mask;
             }
 
@@ -1629,6 +1795,14 @@ Return Value:
                 MaskPtr += 1;
                 FirstDirtyPage += 32;
 
+                //  Step over whole groups of longwords which the range summary shows to be clean.
+                while ((MaskPtr <= EndPtr) &&
+                       ((((ULONG)(MaskPtr - BitmapRange->Bitmap)) % MBCB_SUMMARY_WORDS) == 0) &&
+                       !CcTestBitmapSummary(BitmapRange, (ULONG)(MaskPtr - BitmapRange->Bitmap))) {
+                    MaskPtr += MBCB_SUMMARY_WORDS;
+                    FirstDirtyPage += 32 * MBCB_SUMMARY_WORDS;
+                }
+
                 //  If we go beyond the end, then we must wrap back to the first dirty page.
                 // We will just go back to the start of the first longword.
                 if (MaskPtr > EndPtr) {
@@ -1725,6 +1899,12 @@ Return Value:
             Mbcb->PagesToWrite = 0;
         }
 
+        //  Let the range summary forget any groups of longwords we just finished cleaning.
+        CcTrimBitmapSummary(Mbcb,
+                            BitmapRange,
+                            (ULONG)(FirstDirtyPage - BitmapRange->BasePage) / 32,
+                            (ULONG)(FirstDirtyPage - BitmapRange->BasePage + *Length - 1) / 32);
+
         //  Reduce the dirty page counts by the number of pages we just cleared.
         ASSERT(Mbcb->DirtyPages >= *Length);
         Mbcb->DirtyPages -= *Length;
@@ -1751,6 +1931,7 @@ Return Value:
         if (BitmapRange->DirtyPages == 0) {
             BitmapRange->FirstDirtyPage = MAXULONG;
             BitmapRange->LastDirtyPage = 0;
+            BitmapRange->Summary = 0;
 
             //  Assume this is a large file and that the resume point should be at the beginning of the next range.
             //  In all cases if the resume point is set too high, the next resume will just wrap back to 0 anyway.
@@ -3566,7 +3747,7 @@ Return Value:
                 MmSetAddressRangeModified(SavedMappedBuffer, SavedMappedLength);
             }
 
-            MmFlushSection(SharedCacheMap->FileObject->SectionObjectPointer, FileOffset, SavedTotalLength, &IoStatus, MM_FLUSH_ACQUIRE_FILE);
+            CcFlushWriteThrough(SharedCacheMap, FileOffset, SavedTotalLength, &IoStatus);
             ASSERT(IoStatus.Status != STATUS_ENCOUNTERED_WRITE_IN_PROGRESS);
 
             //  If we successfully flushed the file, move forward ValidDataGoal.
@@ -3597,6 +3778,118 @@ Return Value:
 }
 
 
+//  Internal support routine
+
+
+VOID CcFlushWriteThrough(IN PSHARED_CACHE_MAP SharedCacheMap, IN PLARGE_INTEGER FileOffset, IN ULONG Length, OUT PIO_STATUS_BLOCK IoStatus)
+/*
+Routine Description:
+    This routine flushes the range just written by a write through request, merging it with the flushes of concurrent write through
+    requests to the same file.
+
+    If no flush is in progress the caller flushes its range at once, but publishes it as the active group.
+    While a flush is active, the first writer to arrive starts a pending group and waits for the active flush to complete.
+    Later writers whose ranges overlap or abut the pending group widen it and simply wait for its result,
+    so a burst of small log writes costs one paging write per group instead of one per write.
+    Writers which cannot join (a disjoint range, or a group already at MAX_WRITE_BEHIND) flush on their own as before.
+Arguments:
+    SharedCacheMap - Supplies the SharedCacheMap of the file written.
+    FileOffset - Supplies the offset of the write.
+    Length - Supplies the length of the write.
+    IoStatus - Returns the result of the flush which covered the range.
+Environment:
+    Called with no spinlocks held, from the finally clause of CcMapAndCopy.
+*/
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PWRITE_THROUGH_GROUP Group = NULL;
+    PWRITE_THROUGH_GROUP Previous = NULL;
+    LARGE_INTEGER FlushOffset;
+    LONGLONG BeyondLastByte = FileOffset->QuadPart + Length;
+
+    KeAcquireInStackQueuedSpinLock(&SharedCacheMap->BcbSpinLock, &LockHandle);
+    if (SharedCacheMap->PendingWriteThrough != NULL) {
+        Group = SharedCacheMap->PendingWriteThrough;
+
+        //  Join the pending group if our range touches it and the merged flush stays within one maximum write.
+        if ((FileOffset->QuadPart <= Group->BeyondLastByte) && (BeyondLastByte >= Group->FileOffset) &&
+            ((max(BeyondLastByte, Group->BeyondLastByte) - min(FileOffset->QuadPart, Group->FileOffset)) <= MAX_WRITE_BEHIND)) {
+            if (FileOffset->QuadPart < Group->FileOffset) {
+                Group->FileOffset = FileOffset->QuadPart;
+            }
+
+            if (BeyondLastByte > Group->BeyondLastByte) {
+                Group->BeyondLastByte = BeyondLastByte;
+            }
+
+            InterlockedIncrement(&Group->ReferenceCount);
+            KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+            KeWaitForSingleObject(&Group->Event, Executive, KernelMode, FALSE, NULL);
+            *IoStatus = Group->IoStatus;
+            CcDereferenceWriteThroughGroup(Group);
+            return;
+        }
+
+        Group = NULL;
+    } else {
+        Group = ExAllocatePoolWithTag(NonPagedPool, sizeof(WRITE_THROUGH_GROUP), 'gWcC');
+        if (Group != NULL) {
+            Group->FileOffset = FileOffset->QuadPart;
+            Group->BeyondLastByte = BeyondLastByte;
+            Group->ReferenceCount = 1;
+            KeInitializeEvent(&Group->Event, NotificationEvent, FALSE);
+
+            //  If a flush is under way, lead the group which follows it, otherwise become the active flush.
+            if (SharedCacheMap->ActiveWriteThrough != NULL) {
+                Previous = SharedCacheMap->ActiveWriteThrough;
+                InterlockedIncrement(&Previous->ReferenceCount);
+                SharedCacheMap->PendingWriteThrough = Group;
+            } else {
+                SharedCacheMap->ActiveWriteThrough = Group;
+            }
+        }
+    }
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    //  If we could not use a group, just flush our own range.
+    if (Group == NULL) {
+        MmFlushSection(SharedCacheMap->FileObject->SectionObjectPointer, FileOffset, Length, IoStatus, MM_FLUSH_ACQUIRE_FILE);
+        return;
+    }
+
+    //  Wait for the active flush, then close our group to new members and make it the active one.
+    if (Previous != NULL) {
+        KeWaitForSingleObject(&Previous->Event, Executive, KernelMode, FALSE, NULL);
+        CcDereferenceWriteThroughGroup(Previous);
+
+        KeAcquireInStackQueuedSpinLock(&SharedCacheMap->BcbSpinLock, &LockHandle);
+        ASSERT(SharedCacheMap->PendingWriteThrough == Group);
+        ASSERT(SharedCacheMap->ActiveWriteThrough == NULL);
+        SharedCacheMap->PendingWriteThrough = NULL;
+        SharedCacheMap->ActiveWriteThrough = Group;
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
+    }
+
+    FlushOffset.QuadPart = Group->FileOffset;
+    MmFlushSection(SharedCacheMap->FileObject->SectionObjectPointer,
+                   &FlushOffset,
+                   (ULONG)(Group->BeyondLastByte - Group->FileOffset),
+                   &Group->IoStatus,
+                   MM_FLUSH_ACQUIRE_FILE);
+
+    KeAcquireInStackQueuedSpinLock(&SharedCacheMap->BcbSpinLock, &LockHandle);
+    ASSERT(SharedCacheMap->ActiveWriteThrough == Group);
+    SharedCacheMap->ActiveWriteThrough = NULL;
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    //  Complete every member of the group, including the leader of any group which was waiting for us.
+    *IoStatus = Group->IoStatus;
+    KeSetEvent(&Group->Event, 0, FALSE);
+    CcDereferenceWriteThroughGroup(Group);
+}
+
+
 BOOLEAN CcLogError(IN PFILE_OBJECT FileObject, IN PUNICODE_STRING FileName, IN NTSTATUS Error, IN NTSTATUS DeviceError, IN UCHAR IrpMajorCode)
 /*
 Routine Description:
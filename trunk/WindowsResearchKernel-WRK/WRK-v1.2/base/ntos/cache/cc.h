@@ -77,7 +77,9 @@ extern PFN_NUMBER MmAvailablePages;//  Peek at number of available pages.
 
 
 //  For non FO_RANDOM_ACCESS files, define how far we go before umapping views.
+//  Each SharedCacheMap starts with this window and grows it, up to CcMaxSequentialMapLimit, while it keeps reading sequentially through a large file.
 #define SEQUENTIAL_MAP_LIMIT        ((ULONG)(0x00080000))
+#define MAX_SEQUENTIAL_MAP_LIMIT    ((ULONG)(0x00800000))
 
 
 //  Define some constants to drive read ahead and write behind
@@ -145,6 +147,14 @@ extern PFN_NUMBER MmAvailablePages;//  Peek at number of available pages.
 #define WRITE_CHARGE_THRESHOLD          (64 * PAGE_SIZE)
 
 
+//  Define the reserve of dirty pages above CcDirtyPageThreshold kept for light writers, and how few dirty pages a stream must have to be one.
+//  Once a bulk writer has filled the cache to the threshold, streams like logs which only ever have a little dirty data can still write
+//  into the reserve instead of queueing behind it.  Heavy streams stay throttled at the threshold, so the reserve is only consumed in
+//  small pieces and the Lazy Writer keeps draining it.
+#define LIGHT_WRITER_RESERVE(THRESHOLD) ((THRESHOLD) / 16)
+#define LIGHT_WRITER_DIRTY_PAGES        (4 * (WRITE_CHARGE_THRESHOLD / PAGE_SIZE))
+
+
 //  Define constants to control zeroing of file data: one constant to control
 //  how much data we will actually zero ahead in the cache, and another to control what the maximum transfer size is that we will use to write zeros.
 #define MAX_ZERO_TRANSFER               (PAGE_SIZE * 128)
@@ -201,6 +211,13 @@ typedef struct _VACB_LEVEL_REFERENCE {
 #define MBCB_BITMAP_INITIAL_SIZE         (2 * sizeof(BITMAP_RANGE))
 
 
+//  Define how many bitmap longwords are covered by each bit of a bitmap range Summary, and how the bits are set and tested.
+#define MBCB_SUMMARY_WORDS               ((MBCB_BITMAP_BLOCK_SIZE / sizeof(ULONG)) / 32)
+
+#define CcSetBitmapSummary( B, W )       (B)->Summary |= (1 << ((W) / MBCB_SUMMARY_WORDS))
+#define CcTestBitmapSummary( B, W )      FlagOn( (B)->Summary, 1 << ((W) / MBCB_SUMMARY_WORDS) )
+
+
 //  Define constants controlling when the Bcb list is broken into a pendaflex-style array of listheads, and how the correct listhead is found.
 //  Begin when file size exceeds 2MB, and cover 512KB per listhead.
 //  At 512KB per listhead, the BcbListArray is the same size as the Vacb array, i.e., it doubles the size.
@@ -214,19 +231,24 @@ typedef struct _VACB_LEVEL_REFERENCE {
 #define SIZE_PER_BCB_LIST                (VACB_MAPPING_GRANULARITY * 2)
 #define BCB_LIST_SHIFT                   (VACB_OFFSET_SHIFT + 1)
 
+//  Streams with pinned access keep these listheads, so CcFindBcb only scans the Bcbs of one 512KB range.
+//  Metadata streams (modified writing disabled) always did; other pinned streams, such as database logs, can have just as many pinned ranges.
+//  This must not change after the Vacb array is created, since it decides the layout of the Vacb array and its levels.
+#define CcUsesBcbListHeads(SCM)          FlagOn((SCM)->Flags, MODIFIED_WRITE_DISABLED | PIN_ACCESS)
+
 
 //  Macros to lock/unlock a Vacb level as Bcbs are inserted/deleted
 
 
 #define CcLockVacbLevel(SCM,OFF) {                                                               \
     if (((SCM)->SectionSize.QuadPart > VACB_SIZE_OF_FIRST_LEVEL) &&                              \
-        FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {                                \
+        CcUsesBcbListHeads(SCM)) {                                                               \
     CcAdjustVacbLevelLockCount((SCM),(OFF), +1);}                                                \
 }
 
 #define CcUnlockVacbLevel(SCM,OFF) {                                                             \
     if (((SCM)->SectionSize.QuadPart > VACB_SIZE_OF_FIRST_LEVEL) &&                              \
-        FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {                                \
+        CcUsesBcbListHeads(SCM)) {                                                               \
     CcAdjustVacbLevelLockCount((SCM),(OFF), -1);}                                                \
 }
 
@@ -329,6 +351,9 @@ typedef struct _VACB {
     } Overlay;
 
     LIST_ENTRY LruList;//  Entry for the VACB reuse list
+
+    //  Set when the view is used while on the reuse list, giving it a second chance before it is reclaimed.  Synchronized by the VacbLock.
+    BOOLEAN Referenced;
 } VACB, *PVACB;
 
 
@@ -440,6 +465,47 @@ typedef PRIVATE_CACHE_MAP *PPRIVATE_CACHE_MAP;
     }                                                       \
 }
 
+//  Number of buckets volumes are hashed to for throttling write behind, and the active write behind count for a SharedCacheMap's volume.
+#define CC_WRITE_BEHIND_VOLUME_BUCKETS   32
+
+#define CC_WRITE_BEHIND_VOLUME(SCM)                                                             \
+    (CcActiveWriteBehinds[((ULONG_PTR)(SCM)->FileObject->DeviceObject >> 4) % CC_WRITE_BEHIND_VOLUME_BUCKETS])
+
+//  Read ahead state for one sequential stream through a file.
+//  Several of these are kept in each SharedCacheMap so that interleaved sequential readers, on one file object or several,
+//  are each recognized even though the private cache map only remembers the last two reads.
+#define CC_READ_AHEAD_STREAMS            4
+
+//  The read ahead distance of a stream starts at the read size and doubles on each sequential read up to this limit.
+#define CC_MAX_STREAM_READ_AHEAD         (MAX_READ_AHEAD / 8)
+
+typedef struct _READ_AHEAD_STREAM {
+    LONGLONG BeyondLastByte;//  End of the last read matched to this stream, zero when the entry is unused.
+    LONGLONG ReadAheadEnd;//  End of the data already scheduled for read ahead on this stream.
+    ULONG ReadAheadLength;//  Current read ahead distance.
+    ULONG LastUsed;//  Value of ReadAheadStreamClock when the stream was last matched, for replacement.
+} READ_AHEAD_STREAM, *PREAD_AHEAD_STREAM;
+
+
+//  Write through flushes of one file are group committed.  While one flush is under way, writers whose ranges touch collect in a
+//  pending group, whose first member issues a single flush for all of them once the active flush completes.
+typedef struct _WRITE_THROUGH_GROUP {
+    //  Byte range to be flushed for the group, widened as writers join.
+    LONGLONG FileOffset;
+    LONGLONG BeyondLastByte;
+
+    LONG ReferenceCount;//  Number of threads still using the group; the last one frees it.
+    IO_STATUS_BLOCK IoStatus;//  Result of the flush, for every member.
+    KEVENT Event;//  Set when the flush for the group has completed.
+} WRITE_THROUGH_GROUP, *PWRITE_THROUGH_GROUP;
+
+#define CcDereferenceWriteThroughGroup( G ) {                           \
+    if (InterlockedDecrement( &(G)->ReferenceCount ) == 0) {            \
+        ExFreePool( (G) );                                              \
+    }                                                                   \
+}
+
+
 typedef struct _SHARED_CACHE_MAP {
 
 
@@ -637,6 +703,20 @@ typedef struct _SHARED_CACHE_MAP {
 
     EX_PUSH_LOCK VacbPushLock;
 
+    //  Distance mapped views are kept behind a sequential reader before they are unmapped, a power of two between SEQUENTIAL_MAP_LIMIT
+    //  and CcMaxSequentialMapLimit.  Only updated by the unmap behind logic in CcGetVacbMiss, so no synchronization is used.
+    ULONG SequentialMapLimit;
+
+    //  The write through group whose flush is in progress, and the one collecting writers to flush next.  Synchronized by the BcbSpinLock.
+    PWRITE_THROUGH_GROUP ActiveWriteThrough;
+    PWRITE_THROUGH_GROUP PendingWriteThrough;
+
+    //  Sequential streams recently seen on this file.  Synchronized by the ReadAheadStreamSpinLock,
+    //  which is acquired after the ReadAheadSpinLock of a PrivateCacheMap.
+    KSPIN_LOCK ReadAheadStreamSpinLock;
+    ULONG ReadAheadStreamClock;
+    READ_AHEAD_STREAM ReadAheadStreams[CC_READ_AHEAD_STREAMS];
+
     PRIVATE_CACHE_MAP PrivateCacheMap;//  Preallocate one PrivateCacheMap to reduce pool allocations.
 } SHARED_CACHE_MAP;
 
@@ -799,6 +879,12 @@ typedef struct _BITMAP_RANGE {
     ULONG LastDirtyPage;
 
     ULONG DirtyPages;//  Number of dirty pages in this range.
+
+    //  Summary level over the bitmap below, one bit for each MBCB_SUMMARY_WORDS longwords.
+    //  A bit is set whenever any of its longwords may be nonzero, and is only cleared once they are all seen to be zero,
+    //  so the dirty page scan can step over clean stretches of a sparse range without touching them.
+    ULONG Summary;
+
     PULONG Bitmap;//  Pointer to the bitmap for this range.
 } BITMAP_RANGE, *PBITMAP_RANGE;
 
@@ -1139,6 +1225,8 @@ extern LIST_ENTRY CcExpressWorkQueue;
 extern LIST_ENTRY CcRegularWorkQueue;
 extern LIST_ENTRY CcPostTickWorkQueue;
 extern BOOLEAN CcQueueThrottle;
+extern ULONG CcMaxWriteBehindPerVolume;
+extern LONG CcActiveWriteBehinds[];
 extern ULONG CcIdleDelayTick;
 extern LARGE_INTEGER CcNoDelay;
 extern LARGE_INTEGER CcFirstDelay;
@@ -1169,6 +1257,7 @@ extern LONG CcAggressiveZeroThreshold;
 extern ULONG CcLazyWriteHotSpots;
 extern MM_SYSTEMSIZE CcCapturedSystemSize;
 extern ULONG CcMaxVacbLevelsSeen;
+extern ULONG CcMaxSequentialMapLimit;
 extern ULONG CcVacbLevelEntries;
 extern PVACB *CcVacbLevelFreeList;
 extern ULONG CcVacbLevelWithBcbsEntries;
@@ -1213,7 +1302,7 @@ _inline VOID CcDeallocateVacbLevel (IN PVACB *Entry, IN LOGICAL DeallocatingBcbL
 //  Export the macros for inspecting the reference counts for the multilevel Vacb array.
 _inline PVACB_LEVEL_REFERENCE VacbLevelReference (IN PSHARED_CACHE_MAP SharedCacheMap, IN PVACB *VacbArray, IN ULONG Level)
 {
-    return (PVACB_LEVEL_REFERENCE)((PCHAR)VacbArray + VACB_LEVEL_BLOCK_SIZE + (Level != 0? 0 : (FlagOn( SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED )? VACB_LEVEL_BLOCK_SIZE : 0)));
+    return (PVACB_LEVEL_REFERENCE)((PCHAR)VacbArray + VACB_LEVEL_BLOCK_SIZE + (Level != 0? 0 : (CcUsesBcbListHeads( SharedCacheMap )? VACB_LEVEL_BLOCK_SIZE : 0)));
 }
 
 
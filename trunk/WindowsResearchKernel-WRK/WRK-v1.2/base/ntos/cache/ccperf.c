@@ -60,4 +60,97 @@ Environment:
     }
 
     CcReleaseMasterLock( OldIrql );
-}
\ No newline at end of file
+}
+
+NTSTATUS CcGetCacheManagerInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length)
+/*
+Routine Description:
+    This routine returns a snapshot of the Cache Manager counters for NtQuerySystemInformation:
+    copy read hits and misses, read ahead effectiveness, view map and unmap counts, the lazy writer backlog and worker queue depth,
+    and how often and how long writers were held up by the write throttle.
+Arguments:
+    SystemInformation - Returns the cache manager information.
+    SystemInformationLength - Supplies the length of the SystemInformation buffer.
+    Length - Returns the length of the information placed in the buffer.
+Return Value:
+    Returns the status of the operation.
+Environment:
+    Kernel mode, PASSIVE_LEVEL. The buffer has been probed and the caller handles exceptions.
+*/
+{
+    KIRQL OldIrql;
+    ULONG i;
+    PLIST_ENTRY Entry;
+    SYSTEM_CACHE_MANAGER_INFORMATION CacheInfo;
+#if !defined(NT_UP)
+    PKPRCB Prcb;
+#endif
+
+    C_ASSERT(SYSTEM_CACHE_WRITE_BEHIND_BUCKETS == CC_WRITE_BEHIND_VOLUME_BUCKETS);
+
+    *Length = sizeof(SYSTEM_CACHE_MANAGER_INFORMATION);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    RtlZeroMemory(&CacheInfo, sizeof(CacheInfo));
+
+    CacheInfo.CopyReads = CcCopyReadWait + CcCopyReadNoWait;
+    CacheInfo.CopyReadMisses = CcCopyReadWaitMiss + CcCopyReadNoWaitMiss;
+
+#if !defined(NT_UP)
+    //  The hot copy read counters are kept per processor.
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++) {
+        Prcb = KiProcessorBlock[i];
+        CacheInfo.CopyReads += Prcb->CcCopyReadWait + Prcb->CcCopyReadNoWait;
+        CacheInfo.CopyReadMisses += Prcb->CcCopyReadNoWaitMiss;
+    }
+#endif
+
+    CacheInfo.ReadAheadPages = CcReadAheadPages;
+    CacheInfo.ReadAheadPagesResident = CcReadAheadPagesResident;
+    CacheInfo.ReadAheadIos = CcReadAheadIos;
+    CacheInfo.VacbMaps = CcVacbMaps;
+    CacheInfo.VacbUnmaps = CcVacbUnmaps;
+    CacheInfo.LazyWriteIos = CcLazyWriteIos;
+    CacheInfo.LazyWritePages = CcLazyWritePages;
+    CacheInfo.DeferredWriteWaits = CcDeferredWriteWaits;
+    CacheInfo.DeferredWriteWaitTime = CcDeferredWriteWaitTime;
+
+    for (i = 0; i < CC_WRITE_BEHIND_VOLUME_BUCKETS; i++) {
+        CacheInfo.ActiveWriteBehinds[i] = (ULONG)CcActiveWriteBehinds[i];
+    }
+
+    CcAcquireMasterLock(&OldIrql);
+    CacheInfo.DirtyPages = CcTotalDirtyPages;
+    CacheInfo.DirtyPageThreshold = CcDirtyPageThreshold;
+    CacheInfo.PagesYetToWrite = CcPagesYetToWrite;
+    CcReleaseMasterLock(OldIrql);
+
+    //  Count the work items which are waiting for a worker thread.
+    CcAcquireWorkQueueLock(&OldIrql);
+    for (Entry = CcExpressWorkQueue.Flink; Entry != &CcExpressWorkQueue; Entry = Entry->Flink) {
+        CacheInfo.WorkQueueDepth += 1;
+    }
+
+    for (Entry = CcRegularWorkQueue.Flink; Entry != &CcRegularWorkQueue; Entry = Entry->Flink) {
+        CacheInfo.WorkQueueDepth += 1;
+    }
+
+    for (Entry = CcPostTickWorkQueue.Flink; Entry != &CcPostTickWorkQueue; Entry = Entry->Flink) {
+        CacheInfo.WorkQueueDepth += 1;
+    }
+
+    CacheInfo.ActiveWorkerThreads = CcNumberActiveWorkerThreads;
+    CacheInfo.NumberWorkerThreads = CcNumberWorkerThreads;
+    CcReleaseWorkQueueLock(OldIrql);
+
+    ExAcquireSpinLock(&CcDeferredWriteSpinLock, &OldIrql);
+    for (Entry = CcDeferredWrites.Flink; Entry != &CcDeferredWrites; Entry = Entry->Flink) {
+        CacheInfo.DeferredWrites += 1;
+    }
+    ExReleaseSpinLock(&CcDeferredWriteSpinLock, OldIrql);
+
+    RtlCopyMemory(SystemInformation, &CacheInfo, sizeof(CacheInfo));
+    return STATUS_SUCCESS;
+}
@@ -16,9 +16,13 @@ Abstract:
 //  Define our debug constant
 #define me 0x00000004
 
+VOID CcCopyFromView(IN PETHREAD Thread, OUT PVOID Buffer, IN PVOID CacheBuffer, IN ULONG Length, IN OUT PULONG GotAMiss);
+LOGICAL CcIsLightWriter(IN PFILE_OBJECT FileObject, IN ULONG PagesToWrite, IN LOGICAL MasterLockHeld);
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,CcCopyRead)
 #pragma alloc_text(PAGE,CcFastCopyRead)
+#pragma alloc_text(PAGE,CcCopyFromView)
 #endif
 
 
@@ -74,9 +78,6 @@ Return Value:
     ULONG ActivePage;
     ULONG PageIsDirty;
     ULONG SavedState;
-    ULONG PagesToGo;
-    ULONG MoveLength;
-    ULONG LengthToGo;
     NTSTATUS Status;
     ULONG OriginalLength = Length;
     PETHREAD Thread = PsGetCurrentThread();
@@ -130,37 +131,10 @@ Return Value:
                 LengthToCopy = Length;
             }
 
-            //  Like the logic for the normal case below, we want to spin around making sure Mm only reads the pages we will need.
-            PagesToGo = ADDRESS_AND_SIZE_TO_SPAN_PAGES(CacheBuffer, LengthToCopy) - 1;
-
-            //  Copy the data to the user buffer.
+            //  Copy the data to the user buffer.  Like the normal case below, we make sure Mm only reads the pages we will need.
             try {
-                if (PagesToGo != 0) {
-                    LengthToGo = LengthToCopy;
-                    while (LengthToGo != 0) {
-                        MoveLength = (ULONG)((PCHAR)(ROUND_TO_PAGES(((PCHAR)CacheBuffer + 1))) - (PCHAR)CacheBuffer);
-                        if (MoveLength > LengthToGo) {
-                            MoveLength = LengthToGo;
-                        }
-
-                        //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                        //  If not let Mm know how many pages we are after before doing the move.
-                        MmSetPageFaultReadAhead(Thread, PagesToGo);
-                        GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                        RtlCopyBytes(Buffer, CacheBuffer, MoveLength);
-                        PagesToGo -= 1;
-                        LengthToGo -= MoveLength;
-                        Buffer = (PCHAR)Buffer + MoveLength;
-                        CacheBuffer = (PCHAR)CacheBuffer + MoveLength;
-                    }
-                } else {//  Handle the read here that stays on a single page.
-                    //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                    //  If not let Mm know how many pages we are after before doing the move.
-                    MmSetPageFaultReadAhead(Thread, 0);
-                    GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                    RtlCopyBytes(Buffer, CacheBuffer, LengthToCopy);
-                    Buffer = (PCHAR)Buffer + LengthToCopy;
-                }
+                CcCopyFromView(Thread, Buffer, CacheBuffer, LengthToCopy, &GotAMiss);
+                Buffer = (PCHAR)Buffer + LengthToCopy;
             } except(CcCopyReadExceptionFilter(GetExceptionInformation(), &Status))
             {
                 MmResetPageFaultReadAhead(Thread, SavedState);
@@ -224,8 +198,6 @@ Return Value:
         //  If we fail to access the buffer we must raise a status that the caller's exception filter considers as "expected".
         //  Also we unmap the Bcb here, since we otherwise would have no other reason to put a try-finally around this loop.
         try {
-            PagesToGo = ADDRESS_AND_SIZE_TO_SPAN_PAGES(CacheBuffer, ReceivedLength) - 1;
-
             //  We know exactly how much we want to read here, and we do not want to read any more in case the caller is doing random access.
             //  Our read ahead logic takes care of detecting sequential reads, and tends to do large asynchronous read aheads.
             //  So far we have only mapped the data and we have not forced any in.
@@ -234,34 +206,8 @@ Return Value:
             //  With this strategy, for cache hits we never make a single expensive call to MM to guarantee that the data is in, 
             //  yet if we do take a fault, we are guaranteed to only take one fault because
             //  we will read all of the data in for the rest of the transfer.
-
-            //  We test first for the multiple page case, to keep the small reads faster.
-            if (PagesToGo != 0) {
-                LengthToGo = ReceivedLength;
-                while (LengthToGo != 0) {
-                    MoveLength = (ULONG)((PCHAR)(ROUND_TO_PAGES(((PCHAR)CacheBuffer + 1))) - (PCHAR)CacheBuffer);
-                    if (MoveLength > LengthToGo) {
-                        MoveLength = LengthToGo;
-                    }
-
-                    //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                    //  If not let Mm know how many pages we are after before doing the move.
-                    MmSetPageFaultReadAhead(Thread, PagesToGo);
-                    GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                    RtlCopyBytes(Buffer, CacheBuffer, MoveLength);
-                    PagesToGo -= 1;
-                    LengthToGo -= MoveLength;
-                    Buffer = (PCHAR)Buffer + MoveLength;
-                    CacheBuffer = (PCHAR)CacheBuffer + MoveLength;
-                }
-            } else {//  Handle the read here that stays on a single page.
-                //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                //  If not let Mm know how many pages we are after before doing the move.
-                MmSetPageFaultReadAhead(Thread, 0);
-                GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                RtlCopyBytes(Buffer, CacheBuffer, ReceivedLength);
-                Buffer = (PCHAR)Buffer + ReceivedLength;
-            }
+            CcCopyFromView(Thread, Buffer, CacheBuffer, ReceivedLength, &GotAMiss);
+            Buffer = (PCHAR)Buffer + ReceivedLength;
         } except(CcCopyReadExceptionFilter(GetExceptionInformation(), &Status))
         {
             CcMissCounter = &CcThrowAway;
@@ -355,9 +301,6 @@ Arguments:
     ULONG ActivePage;
     ULONG PageIsDirty;
     ULONG SavedState;
-    ULONG PagesToGo;
-    ULONG MoveLength;
-    ULONG LengthToGo;
     NTSTATUS Status;
     LARGE_INTEGER OriginalOffset;
     ULONG OriginalLength = Length;
@@ -409,37 +352,10 @@ Arguments:
                 LengthToCopy = Length;
             }
 
-            //  Like the logic for the normal case below, we want to spin around making sure Mm only reads the pages we will need.
-            PagesToGo = ADDRESS_AND_SIZE_TO_SPAN_PAGES(CacheBuffer, LengthToCopy) - 1;
-
-            //  Copy the data to the user buffer.
+            //  Copy the data to the user buffer.  Like the normal case below, we make sure Mm only reads the pages we will need.
             try {
-                if (PagesToGo != 0) {
-                    LengthToGo = LengthToCopy;
-                    while (LengthToGo != 0) {
-                        MoveLength = (ULONG)((PCHAR)(ROUND_TO_PAGES(((PCHAR)CacheBuffer + 1))) - (PCHAR)CacheBuffer);
-                        if (MoveLength > LengthToGo) {
-                            MoveLength = LengthToGo;
-                        }
-
-                        //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                        //  If not let Mm know how many pages we are after before doing the move.
-                        MmSetPageFaultReadAhead(Thread, PagesToGo);
-                        GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                        RtlCopyBytes(Buffer, CacheBuffer, MoveLength);
-                        PagesToGo -= 1;
-                        LengthToGo -= MoveLength;
-                        Buffer = (PCHAR)Buffer + MoveLength;
-                        CacheBuffer = (PCHAR)CacheBuffer + MoveLength;
-                    }
-                } else {//  Handle the read here that stays on a single page.
-                    //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                    //  If not let Mm know how many pages we are after before doing the move.
-                    MmSetPageFaultReadAhead(Thread, 0);
-                    GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                    RtlCopyBytes(Buffer, CacheBuffer, LengthToCopy);
-                    Buffer = (PCHAR)Buffer + LengthToCopy;
-                }
+                CcCopyFromView(Thread, Buffer, CacheBuffer, LengthToCopy, &GotAMiss);
+                Buffer = (PCHAR)Buffer + LengthToCopy;
             } except(CcCopyReadExceptionFilter(GetExceptionInformation(), &Status))
             {
                 MmResetPageFaultReadAhead(Thread, SavedState);
@@ -490,8 +406,6 @@ Arguments:
         //  If we fail to access the buffer we must raise a status that the caller's exception filter considers as "expected".
         //  Also we unmap the Bcb here, since we otherwise would have no other reason to put a try-finally around this loop.
         try {
-            PagesToGo = ADDRESS_AND_SIZE_TO_SPAN_PAGES(CacheBuffer, ReceivedLength) - 1;
-
             //  We know exactly how much we want to read here, and we do not want to read any more in case the caller is doing random access.
             //  Our read ahead logic takes care of detecting sequential reads, and tends to do large asynchronous read aheads.
             //  So far we have only mapped the data and we have not forced any in.
@@ -499,34 +413,8 @@ Arguments:
             //  we would like to have read in, in the event that we take a fault.
             //  With this strategy, for cache hits we never make a single expensive call to MM to guarantee that the data is in, yet if we
             //  do take a fault, we are guaranteed to only take one fault because we will read all of the data in for the rest of the transfer.
-
-            //  We test first for the multiple page case, to keep the small reads faster.
-            if (PagesToGo != 0) {
-                LengthToGo = ReceivedLength;
-                while (LengthToGo != 0) {
-                    MoveLength = (ULONG)((PCHAR)(ROUND_TO_PAGES(((PCHAR)CacheBuffer + 1))) - (PCHAR)CacheBuffer);
-                    if (MoveLength > LengthToGo) {
-                        MoveLength = LengthToGo;
-                    }
-
-                    //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                    //  If not let Mm know how many pages we are after before doing the move.
-                    MmSetPageFaultReadAhead(Thread, PagesToGo);
-                    GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                    RtlCopyBytes(Buffer, CacheBuffer, MoveLength);
-                    PagesToGo -= 1;
-                    LengthToGo -= MoveLength;
-                    Buffer = (PCHAR)Buffer + MoveLength;
-                    CacheBuffer = (PCHAR)CacheBuffer + MoveLength;
-                }
-            } else {//  Handle the read here that stays on a single page.
-                //  Here's hoping that it is cheaper to call Mm to see if the page is valid.
-                //  If not let Mm know how many pages we are after before doing the move.
-                MmSetPageFaultReadAhead(Thread, 0);
-                GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
-                RtlCopyBytes(Buffer, CacheBuffer, ReceivedLength);
-                Buffer = (PCHAR)Buffer + ReceivedLength;
-            }
+            CcCopyFromView(Thread, Buffer, CacheBuffer, ReceivedLength, &GotAMiss);
+            Buffer = (PCHAR)Buffer + ReceivedLength;
         } except(CcCopyReadExceptionFilter(GetExceptionInformation(), &Status))
         {
             CcMissCounter = &CcThrowAway;
@@ -902,6 +790,127 @@ Raises:
 }
 
 
+//  Internal support routine
+LOGICAL CcIsLightWriter(IN PFILE_OBJECT FileObject, IN ULONG PagesToWrite, IN LOGICAL MasterLockHeld)
+/*
+Routine Description:
+    This routine decides whether a write which would exceed CcDirtyPageThreshold may go ahead in the light writer reserve.
+    That is the case if the reserve has room for it and the stream, counting this write, has fewer than LIGHT_WRITER_DIRTY_PAGES dirty pages.
+Arguments:
+    FileObject - for the file to be written
+    PagesToWrite - Number of pages the caller will dirty.
+    MasterLockHeld - TRUE if the caller already holds the MasterSpinLock.
+Return Value:
+    TRUE if the write may proceed in the reserve.
+*/
+{
+    PSECTION_OBJECT_POINTERS SectionObjectPointers;
+    PSHARED_CACHE_MAP SharedCacheMap;
+    LOGICAL LightWriter = FALSE;
+    KIRQL OldIrql;
+
+    if ((PagesToWrite >= LIGHT_WRITER_DIRTY_PAGES) ||
+        (CcTotalDirtyPages + PagesToWrite >= CcDirtyPageThreshold + LIGHT_WRITER_RESERVE(CcDirtyPageThreshold)) ||
+        !MmEnoughMemoryForWrite()) {
+        return FALSE;
+    }
+
+    if (!MasterLockHeld) {
+        CcAcquireMasterLock(&OldIrql);
+    }
+
+    //  A stream which is not cached yet has no dirty pages.
+    if (((SectionObjectPointers = FileObject->SectionObjectPointer) == NULL) ||
+        ((SharedCacheMap = SectionObjectPointers->SharedCacheMap) == NULL) ||
+        ((SharedCacheMap->DirtyPages + PagesToWrite) < LIGHT_WRITER_DIRTY_PAGES)) {
+        LightWriter = TRUE;
+    }
+
+    if (!MasterLockHeld) {
+        CcReleaseMasterLock(OldIrql);
+    }
+
+    return LightWriter;
+}
+
+
+//  Internal support routine
+VOID CcCopyFromView(IN PETHREAD Thread, OUT PVOID Buffer, IN PVOID CacheBuffer, IN ULONG Length, IN OUT PULONG GotAMiss)
+/*
+Routine Description:
+    This routine copies data from a view in the system cache to the caller's buffer.
+
+    Each run of pages which Mm can make valid without a read is moved with a single copy, so large cached reads are not broken into
+    page sized moves.  At the first page which must be read, Mm is told how many more pages of the transfer we are after before
+    we touch it, so that we take at most one fault for the rest of the data.
+Arguments:
+    Thread - Supplies the current thread, for setting the page fault read ahead.
+    Buffer - Supplies the caller's buffer.
+    CacheBuffer - Supplies the address of the data in the view.
+    Length - Supplies the number of bytes to copy, which may not cross the end of the view.
+    GotAMiss - Set nonzero if any of the pages was not resident.
+Environment:
+    The caller must handle any exceptions raised while accessing the buffers.
+*/
+{
+    ULONG PagesToGo;
+    ULONG MoveLength;
+    ULONG RunLength;
+
+    //  Handle the read here that stays on a single page.
+    PagesToGo = ADDRESS_AND_SIZE_TO_SPAN_PAGES(CacheBuffer, Length) - 1;
+    if (PagesToGo == 0) {
+        MmSetPageFaultReadAhead(Thread, 0);
+        *GotAMiss |= !MmCheckCachedPageState(CacheBuffer, FALSE);
+        RtlCopyBytes(Buffer, CacheBuffer, Length);
+        return;
+    }
+
+    while (Length != 0) {
+        //  Find the run of pages which are already in memory.
+        RunLength = 0;
+        while (RunLength < Length) {
+            MoveLength = (ULONG)((PCHAR)(ROUND_TO_PAGES(((PCHAR)CacheBuffer + RunLength + 1))) - ((PCHAR)CacheBuffer + RunLength));
+            if (MoveLength > (Length - RunLength)) {
+                MoveLength = Length - RunLength;
+            }
+
+            if (!MmCheckCachedPageState((PCHAR)CacheBuffer + RunLength, FALSE)) {
+                break;
+            }
+
+            RunLength += MoveLength;
+            PagesToGo -= 1;
+        }
+
+        //  Move the whole run at once.  A page of it could have been trimmed since we checked it, in which case we just fault it back in.
+        if (RunLength != 0) {
+            MmSetPageFaultReadAhead(Thread, 0);
+            RtlCopyBytes(Buffer, CacheBuffer, RunLength);
+            Length -= RunLength;
+            Buffer = (PCHAR)Buffer + RunLength;
+            CacheBuffer = (PCHAR)CacheBuffer + RunLength;
+        }
+
+        //  Now take the fault on the page which is not in memory, asking for the rest of the transfer along with it.
+        if (Length != 0) {
+            *GotAMiss = TRUE;
+            MoveLength = (ULONG)((PCHAR)(ROUND_TO_PAGES(((PCHAR)CacheBuffer + 1))) - (PCHAR)CacheBuffer);
+            if (MoveLength > Length) {
+                MoveLength = Length;
+            }
+
+            MmSetPageFaultReadAhead(Thread, PagesToGo);
+            RtlCopyBytes(Buffer, CacheBuffer, MoveLength);
+            PagesToGo -= 1;
+            Length -= MoveLength;
+            Buffer = (PCHAR)Buffer + MoveLength;
+            CacheBuffer = (PCHAR)CacheBuffer + MoveLength;
+        }
+    }
+}
+
+
 LONG CcCopyReadExceptionFilter(IN PEXCEPTION_POINTERS ExceptionPointer, IN PNTSTATUS ExceptionCode)
 /*
 Routine Description:
@@ -953,6 +962,7 @@ Return Value:
     BOOLEAN ExceededPerFileThreshold;
     DEFERRED_WRITE DeferredWrite;
     PSECTION_OBJECT_POINTERS SectionObjectPointers;
+    ULONGLONG WaitStart;
 
     //  If this file is writethrough or of remote origin, exempt it from throttling and let it write.
     //  We do this under the assumption that it has been throttled at the remote location and we do not want to block it here.
@@ -987,6 +997,11 @@ Return Value:
         return TRUE;
     }
 
+    //  Otherwise let a stream with little dirty data of its own write into the reserve, even ahead of the queue.
+    if (!ExceededPerFileThreshold && CcIsLightWriter(FileObject, PagesToWrite, (LOGICAL)(Retrying == MAXUCHAR))) {
+        return TRUE;
+    }
+
     //  Otherwise, if our caller is synchronous, we will just wait here.
     if (Wait) {
         if (IsListEmpty(&CcDeferredWrites)) {
@@ -1014,6 +1029,7 @@ Return Value:
             ExInterlockedInsertTailList(&CcDeferredWrites, &DeferredWrite.DeferredWriteLinks, &CcDeferredWriteSpinLock);
         }
 
+        WaitStart = KeQueryInterruptTime();
         while (TRUE) {
             //  Now since we really didn't synchronize anything but the insertion,
             //  we call the post routine to make sure that in some wierd case we do not leave anyone hanging with no dirty bytes for the Lazy Writer.
@@ -1021,6 +1037,8 @@ Return Value:
 
             //  Finally wait until the event is signaled and we can write and return to tell the guy he can write.
             if (KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, &CcIdleDelay) == STATUS_SUCCESS) {
+                CcDeferredWriteWaits += 1;
+                CcDeferredWriteWaitTime += KeQueryInterruptTime() - WaitStart;
                 return TRUE;
             }
         }
@@ -1106,9 +1124,11 @@ Routine Description:
     PDEFERRED_WRITE DeferredWrite;
     ULONG TotalBytesLetLoose = 0;
     KIRQL OldIrql;
+    LOGICAL Blocked;
 
     do {
         DeferredWrite = NULL;//  Initially clear the deferred write structure pointer and synchronize.
+        Blocked = FALSE;
 
         ExAcquireSpinLock(&CcDeferredWriteSpinLock, &OldIrql);
         if (!IsListEmpty(&CcDeferredWrites)) {//  If the list is empty we are done.
@@ -1117,6 +1137,20 @@ Routine Description:
             while (Entry != &CcDeferredWrites) {
                 DeferredWrite = CONTAINING_RECORD(Entry, DEFERRED_WRITE, DeferredWriteLinks);
 
+                //  Once a write ahead of us is blocked by the global threshold, only light writers may pass it, and only in the reserve.
+                //  This keeps a small writer from waiting behind every queued write of a bulk writer, without letting other writes jump the queue.
+                if (Blocked) {
+                    if (!DeferredWrite->LimitModifiedPages &&
+                        CcIsLightWriter(DeferredWrite->FileObject, (DeferredWrite->BytesToWrite + (PAGE_SIZE - 1)) / PAGE_SIZE, FALSE)) {
+                        RemoveEntryList(&DeferredWrite->DeferredWriteLinks);
+                        break;
+                    }
+
+                    Entry = Entry->Flink;
+                    DeferredWrite = NULL;
+                    continue;
+                }
+
                 //  Check for a paranoid case here that TotalBytesLetLoose wraps.
                 //  We stop processing the list at this time.
                 TotalBytesLetLoose += DeferredWrite->BytesToWrite;
@@ -1136,8 +1170,11 @@ Routine Description:
                         DeferredWrite = NULL;
                         continue;
                     } else {
+                        Entry = Entry->Flink;
+                        TotalBytesLetLoose -= DeferredWrite->BytesToWrite;
                         DeferredWrite = NULL;
-                        break;
+                        Blocked = TRUE;
+                        continue;
                     }
                 }
             }
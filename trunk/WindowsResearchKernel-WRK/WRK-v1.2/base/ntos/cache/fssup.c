@@ -110,6 +110,14 @@ Return Value:
 
     CcAggressiveZeroCount = 0;
 
+    //  Allow each volume up to half of the worker threads for write behind, leaving the rest for other volumes and for read ahead.
+    if (CcMaxWriteBehindPerVolume == 0) {
+        CcMaxWriteBehindPerVolume = CcNumberWorkerThreads / 2;
+        if (CcMaxWriteBehindPerVolume == 0) {
+            CcMaxWriteBehindPerVolume = 1;
+        }
+    }
+
     //  Now allocate and initialize the above number of worker thread items.
     for (i = 0; i < CcNumberWorkerThreads; i++) {
         WorkItem = ExAllocatePoolWithTag(NonPagedPool, sizeof(WORK_QUEUE_ITEM), 'qWcC');
@@ -252,7 +260,9 @@ Return Value:
         //  Initialize the spin locks.
         KeInitializeSpinLock(&SharedCacheMap->ActiveVacbSpinLock);
         KeInitializeSpinLock(&SharedCacheMap->BcbSpinLock);
+        KeInitializeSpinLock(&SharedCacheMap->ReadAheadStreamSpinLock);
         ExInitializePushLock(&SharedCacheMap->VacbPushLock);
+        SharedCacheMap->SequentialMapLimit = SEQUENTIAL_MAP_LIMIT;
         if (PinAccess) {
             SetFlag(SharedCacheMap->Flags, PIN_ACCESS);
         }
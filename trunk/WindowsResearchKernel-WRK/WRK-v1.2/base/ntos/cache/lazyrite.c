@@ -242,6 +242,9 @@ Routine Description:
             //  if the file was not opened delete-on-close to begin with.
 
             //  Since we will write closed files with dirty pages as part of the regular pass (even temporary ones), only do lazy close on files with no dirty pages.
+
+            //  Finally, skip dirty streams whose volume already has CcMaxWriteBehindPerVolume write behinds outstanding, unless they are waiting for teardown.
+            //  They do not count against PagesToWrite, so the budget goes to streams on other volumes and they are picked up again on the next scan.
             if (!FlagOn(SharedCacheMap->Flags, WRITE_QUEUED | IS_CURSOR) &&
                 (((SharedCacheMap->DirtyPages != 0) &&
                 (FlagOn(SharedCacheMap->Flags, WAITING_FOR_TEARDOWN) ||
@@ -253,7 +256,10 @@ Routine Description:
                   (!FlagOn(SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE) ||
                    (SharedCacheMap->OpenCount == 0) ||
                    !CcCanIWrite(SharedCacheMap->FileObject, WRITE_CHARGE_THRESHOLD, FALSE, MAXUCHAR))))) ||
-                   ((SharedCacheMap->OpenCount == 0) && (SharedCacheMap->DirtyPages == 0) || (SharedCacheMap->FileSize.QuadPart == 0)))) {
+                   ((SharedCacheMap->OpenCount == 0) && (SharedCacheMap->DirtyPages == 0) || (SharedCacheMap->FileSize.QuadPart == 0))) &&
+                ((SharedCacheMap->DirtyPages == 0) ||
+                 FlagOn(SharedCacheMap->Flags, WAITING_FOR_TEARDOWN) ||
+                 ((ULONG)CC_WRITE_BEHIND_VOLUME(SharedCacheMap) < CcMaxWriteBehindPerVolume))) {
                 PWORK_QUEUE_ENTRY WorkQueueEntry;
 
                 //  If this is a metadata stream with at least 4 times the maximum write behind I/O size, 
@@ -320,9 +326,10 @@ Routine Description:
                 WorkQueueEntry->Function = (UCHAR)WriteBehind;
                 WorkQueueEntry->Parameters.Write.SharedCacheMap = SharedCacheMap;
 
-                //  Post it to the regular work queue.
+                //  Post it to the regular work queue, charging it to the volume until CcWorkerThread has run it.
                 CcAcquireMasterLock(&OldIrql);
                 SharedCacheMap->DirtyPages -= 1;
+                InterlockedIncrement(&CC_WRITE_BEHIND_VOLUME(SharedCacheMap));
 
                 if (FlagOn(SharedCacheMap->Flags, WAITING_FOR_TEARDOWN)) {
                     //  If we are waiting for this shared cache map to be torn down, put it at the head of the express work queue so that it gets processed right away.
@@ -463,6 +470,7 @@ Arguments:
     BOOLEAN RescanOk = FALSE;
     BOOLEAN DropThrottle = FALSE;
     IO_STATUS_BLOCK IoStatus;
+    PLONG ActiveWriteBehinds = NULL;
 
     IoStatus.Status = STATUS_SUCCESS;
     IoStatus.Information = 0;
@@ -481,6 +489,7 @@ Arguments:
         if (IoStatus.Information == CC_REQUEUE) {
             InsertTailList(WorkQueue, &WorkQueueEntry->WorkQueueLinks);
             IoStatus.Information = 0;
+            ActiveWriteBehinds = NULL;
         }
 
         //  First see if there is something in the express queue.
@@ -519,6 +528,9 @@ Arguments:
                 //  we mark this thread as a MemoryMaker so that Mm will allow pool allocations to succeed when we are getting into low-resource situations.
                 //  This helps avoid loss delayed write error in low-resource scenarios.
                 PsGetCurrentThread()->MemoryMaker = 1;
+
+                //  Capture the volume count now, since the SharedCacheMap may be deleted by CcWriteBehind.
+                ActiveWriteBehinds = &CC_WRITE_BEHIND_VOLUME(WorkQueueEntry->Parameters.Write.SharedCacheMap);
                 CcWriteBehind(WorkQueueEntry->Parameters.Write.SharedCacheMap, &IoStatus);
                 RescanOk = (BOOLEAN)NT_SUCCESS(IoStatus.Status);
                 PsGetCurrentThread()->MemoryMaker = 0;
@@ -542,8 +554,13 @@ Arguments:
             }
         }
 
-        //  If not a requeue request, free the workitem.
+        //  If not a requeue request, free the workitem and return its write behind slot to the volume.
         if (IoStatus.Information != CC_REQUEUE) {
+            if (ActiveWriteBehinds != NULL) {
+                InterlockedDecrement(ActiveWriteBehinds);
+                ActiveWriteBehinds = NULL;
+            }
+
             CcFreeWorkQueueEntry(WorkQueueEntry);
         }
     }
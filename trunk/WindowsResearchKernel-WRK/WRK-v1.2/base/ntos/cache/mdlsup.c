@@ -18,6 +18,7 @@ Abstract:
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,CcMdlRead)
+#pragma alloc_text(PAGE,CcMdlReadRanges)
 #pragma alloc_text(PAGE,CcMdlReadComplete)
 #pragma alloc_text(PAGE,CcMdlReadComplete2)
 #pragma alloc_text(PAGE,CcMdlWriteComplete)
@@ -209,6 +210,213 @@ Raises:
 }
 
 
+VOID CcMdlReadRanges(__in PFILE_OBJECT FileObject,
+                     __in ULONG RangeCount,
+                     __in_ecount(RangeCount) PCC_MDL_READ_RANGE Ranges,
+                     __out PMDL *MdlChain,
+                     __out PIO_STATUS_BLOCK IoStatus)
+/*
+Routine Description:
+    This routine is the batched form of CcMdlRead, for servers which send several ranges of a file in one request.
+    It locks all of the specified ranges in the cache and returns a single Mdl chain describing them, in the order given.
+
+    A view is mapped only once while consecutive ranges fall within it, and ranges which continue one another
+    within a view are described by a single Mdl, so one probe and lock covers them.
+    The chain is released with a single call to CcMdlReadComplete, exactly as for CcMdlRead.
+
+    This routine is synchronous, and raises on errors.
+Arguments:
+    FileObject - Pointer to the file object for a file which was opened with NO_INTERMEDIATE_BUFFERING clear, i.e., for which CcInitializeCacheMap was called by the file system.
+    RangeCount - Number of entries in Ranges.
+    Ranges - Supplies the byte ranges to lock, each of which must lie within the file size.
+    MdlChain - On output it returns a pointer to an Mdl chain describing the data of all of the ranges.
+    IoStatus - Pointer to standard I/O status block to receive the status for the transfer.
+               The I/O Information Field indicates how many bytes have been successfully locked down in the Mdl Chain.
+Raises:
+    STATUS_INSUFFICIENT_RESOURCES - If a pool allocation failure occurs.
+*/
+{
+    PSHARED_CACHE_MAP SharedCacheMap;
+    PPRIVATE_CACHE_MAP PrivateCacheMap;
+    PVOID CacheBuffer;
+    PVOID RunBuffer;
+    ULONG RunLength;
+    ULONG ReceivedLength;
+    LARGE_INTEGER FOffset;
+    LONGLONG ViewStart = 0;
+    LONGLONG ViewEnd = 0;
+    PCHAR ViewBase = NULL;
+    PMDL Mdl = NULL;
+    PMDL MdlTemp;
+    PMDL *MdlTail = MdlChain;
+    PETHREAD Thread = PsGetCurrentThread();
+    ULONG SavedState = 0;
+    ULONG Information = 0;
+    ULONG Length;
+    ULONG i;
+    PVACB Vacb = NULL;
+    ULONG SavedMissCounter = 0;
+    ULONG ActivePage;
+    ULONG PageIsDirty;
+    PVACB ActiveVacb = NULL;
+
+    DebugTrace(+1, me, "CcMdlReadRanges\n", 0);
+    DebugTrace(0, me, "    FileObject = %08lx\n", FileObject);
+    DebugTrace(0, me, "    RangeCount = %08lx\n", RangeCount);
+
+    ASSERT(RangeCount != 0);
+
+    MmSavePageFaultReadAhead(Thread, &SavedState);//  Save the current readahead hints.
+
+    //  Get pointer to SharedCacheMap.
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+    PrivateCacheMap = FileObject->PrivateCacheMap;
+
+    GetActiveVacb(SharedCacheMap, OldIrql, ActiveVacb, ActivePage, PageIsDirty);//  See if we have an active Vacb, that we need to free.
+    if ((ActiveVacb != NULL) || (SharedCacheMap->NeedToZero != NULL)) {
+        CcFreeActiveVacb(SharedCacheMap, ActiveVacb, ActivePage, PageIsDirty);
+    }
+
+    //  If read ahead is enabled, then start it from the first range so it overlaps with the locking below.
+    if (PrivateCacheMap->Flags.ReadAheadEnabled && (PrivateCacheMap->ReadAheadLength[1] == 0)) {
+        CcScheduleReadAhead(FileObject, &Ranges[0].FileOffset, Ranges[0].Length);
+    }
+
+    CcMdlReadWait += 1;//  Increment performance counters
+    CcMissCounter = &CcMdlReadWaitMiss;
+
+    try {
+        //  New Mdls go on the end of any chain the caller passed in.
+        while (*MdlTail != NULL) {
+            MdlTail = &(*MdlTail)->Next;
+        }
+
+        i = 0;
+        FOffset = Ranges[0].FileOffset;
+        Length = Ranges[0].Length;
+        while (TRUE) {
+            //  Advance to the next range with data left to lock.
+            while (Length == 0) {
+                i += 1;
+                if (i == RangeCount) {
+                    break;
+                }
+
+                FOffset = Ranges[i].FileOffset;
+                Length = Ranges[i].Length;
+            }
+
+            if (Length == 0) {
+                break;
+            }
+
+            //  Check for read past file size, the caller must filter this case out.
+            ASSERT((FOffset.QuadPart + (LONGLONG)Length) <= SharedCacheMap->FileSize.QuadPart);
+
+            //  Map the view containing this data, unless we already hold it.
+            if ((Vacb == NULL) || (FOffset.QuadPart < ViewStart) || (FOffset.QuadPart >= ViewEnd)) {
+                if (Vacb != NULL) {
+                    CcFreeVirtualAddress(Vacb);
+                    Vacb = NULL;
+                }
+
+                CacheBuffer = CcGetVirtualAddress(SharedCacheMap, FOffset, &Vacb, &ReceivedLength);
+                ViewBase = (PCHAR)CacheBuffer - (FOffset.LowPart & (VACB_MAPPING_GRANULARITY - 1));
+                ViewStart = FOffset.QuadPart & ~((LONGLONG)VACB_MAPPING_GRANULARITY - 1);
+                ViewEnd = FOffset.QuadPart + ReceivedLength;
+            }
+
+            //  Describe as much of this range as the view holds, and absorb any following ranges which simply continue it.
+            RunBuffer = ViewBase + (ULONG)(FOffset.QuadPart - ViewStart);
+            RunLength = 0;
+            do {
+                ReceivedLength = (ULONG)(ViewEnd - FOffset.QuadPart);
+                if (ReceivedLength > Length) {
+                    ReceivedLength = Length;
+                }
+
+                RunLength += ReceivedLength;
+                FOffset.QuadPart += ReceivedLength;
+                Length -= ReceivedLength;
+
+                if ((Length == 0) && ((i + 1) < RangeCount) && (Ranges[i + 1].FileOffset.QuadPart == FOffset.QuadPart)) {
+                    i += 1;
+                    Length = Ranges[i].Length;
+                    ASSERT((FOffset.QuadPart + (LONGLONG)Length) <= SharedCacheMap->FileSize.QuadPart);
+                }
+            } while ((Length != 0) && (FOffset.QuadPart < ViewEnd));
+
+            Mdl = IoAllocateMdl(RunBuffer, RunLength, FALSE, FALSE, NULL);
+            if (Mdl == NULL) {
+                DebugTrace(0, 0, "Failed to allocate Mdl\n", 0);
+                ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+            }
+
+            SavedMissCounter += CcMdlReadWaitMiss;
+            MmSetPageFaultReadAhead(Thread, ADDRESS_AND_SIZE_TO_SPAN_PAGES(RunBuffer, RunLength) - 1);
+            MmProbeAndLockPages(Mdl, KernelMode, IoReadAccess);
+            SavedMissCounter -= CcMdlReadWaitMiss;
+
+            //  Link the Mdl onto the end of the caller's chain.
+            *MdlTail = Mdl;
+            MdlTail = &Mdl->Next;
+            Mdl = NULL;
+
+            Information += RunLength;
+        }
+
+        //  Unmap the last view now that its pages are locked down.
+        if (Vacb != NULL) {
+            CcFreeVirtualAddress(Vacb);
+            Vacb = NULL;
+        }
+    } finally{
+        CcMissCounter = &CcThrowAway;
+        MmResetPageFaultReadAhead(Thread, SavedState);
+        if (AbnormalTermination()) {
+            if (Vacb != NULL) {
+                CcFreeVirtualAddress(Vacb);
+            }
+
+            if (Mdl != NULL) {
+                IoFreeMdl(Mdl);
+            }
+
+            //  Loop to deallocate the Mdls
+            while (*MdlChain != NULL) {
+                MdlTemp = (*MdlChain)->Next;
+                MmUnlockPages(*MdlChain);
+                IoFreeMdl(*MdlChain);
+                *MdlChain = MdlTemp;
+            }
+
+            DebugTrace(-1, me, "CcMdlReadRanges -> Unwinding\n", 0);
+        } else {
+            i = RangeCount - 1;
+
+            //  Now enable read ahead if it looks like we got any misses, and do the first one from the last range.
+            if (!FlagOn(FileObject->Flags, FO_RANDOM_ACCESS) && !PrivateCacheMap->Flags.ReadAheadEnabled && (SavedMissCounter != 0)) {
+                CC_SET_PRIVATE_CACHE_MAP(PrivateCacheMap, PRIVATE_CACHE_MAP_READ_AHEAD_ENABLED);
+                CcScheduleReadAhead(FileObject, &Ranges[i].FileOffset, Ranges[i].Length);
+            }
+
+            //  Shift the read history down as for a single read of the last range.
+            PrivateCacheMap->FileOffset1 = PrivateCacheMap->FileOffset2;
+            PrivateCacheMap->BeyondLastByte1 = PrivateCacheMap->BeyondLastByte2;
+            PrivateCacheMap->FileOffset2 = Ranges[i].FileOffset;
+            PrivateCacheMap->BeyondLastByte2.QuadPart = Ranges[i].FileOffset.QuadPart + (LONGLONG)Ranges[i].Length;
+
+            IoStatus->Status = STATUS_SUCCESS;
+            IoStatus->Information = Information;
+        }
+    }
+
+    DebugTrace(0, me, "    <MdlChain = %08lx\n", *MdlChain);
+    DebugTrace2(0, me, "    <IoStatus = %08lx, %08lx\n", IoStatus->Status, IoStatus->Information);
+    DebugTrace(-1, me, "CcMdlReadRanges -> VOID\n", 0);
+}
+
+
 VOID CcMdlReadComplete(__in PFILE_OBJECT FileObject, __in PMDL MdlChain)
 //  First we have the old routine which checks for an entry in the FastIo vector.
 //  This routine becomes obsolete for every component that compiles with the new definition of FsRtlMdlReadComplete in fsrtl.h.
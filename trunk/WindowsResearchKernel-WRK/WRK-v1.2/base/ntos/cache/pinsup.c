@@ -184,10 +184,10 @@ Return Value:
 
     //  Increment performance counters
     if (FlagOn(Flags, MAP_WAIT)) {
-        CcMapDataWait += 1;
+        HOT_STATISTIC(CcMapDataWait) += 1;
         CcMissCounter = &CcMapDataWaitMiss;//  Initialize the indirect pointer to our miss counter.
     } else {
-        CcMapDataNoWait += 1;
+        HOT_STATISTIC(CcMapDataNoWait) += 1;
     }
 
     //  Get pointer to SharedCacheMap.
@@ -386,7 +386,7 @@ Return Value:
 
     //  Increment performance counters
     if (FlagOn(Flags, PIN_WAIT)) {
-        CcPinReadWait += 1;
+        HOT_STATISTIC(CcPinReadWait) += 1;
         CcMissCounter = &CcPinReadWaitMiss;//  Initialize the indirect pointer to our miss counter.
     } else {
         CcPinReadNoWait += 1;
@@ -73,6 +73,10 @@ _inline VOID ReferenceVacbLevel(
 #define CcMoveVacbToReuseFree(V)        RemoveEntryList( &(V)->LruList );   InsertHeadList( &CcVacbFreeList, &(V)->LruList );
 #define CcMoveVacbToReuseTail(V)        RemoveEntryList( &(V)->LruList );   InsertTailList( &CcVacbLru, &(V)->LruList );
 
+//  Hits on a mapped view only mark it referenced rather than requeue it, so the common case does not write the list head and
+//  neighboring Vacbs while holding the VacbLock.  CcGetVacbMiss moves referenced views to the tail as it scans for a victim.
+#define CcMarkVacbReferenced(V)         (V)->Referenced = TRUE;
+
 
 //  If the HighPart is nonzero, then we will go to a multi-level structure anyway, which is most easily triggered by returning MAXULONG.
 #define SizeOfVacbArray(LSZ) (                                                            \
@@ -113,6 +117,7 @@ Routine Description:
 {
     SIZE_T VacbBytes;
     PVACB NextVacb;
+    ULONG SequentialMapLimit;
 
     CcNumberVacbs = (MmSizeOfSystemCacheInPages >> (VACB_OFFSET_SHIFT - PAGE_SHIFT)) - 2;
     VacbBytes = CcNumberVacbs * sizeof(VACB);
@@ -129,6 +134,22 @@ Routine Description:
             InsertTailList(&CcVacbFreeList, &NextVacb->LruList);
         }
     }
+
+    //  Size the largest sequential unmap behind window so that a single stream, which keeps up to twice the window mapped,
+    //  never holds more than 1/32 of the views.  A preset value is rounded down to a power of two within the supported range.
+    if (CcMaxSequentialMapLimit == 0) {
+        CcMaxSequentialMapLimit = MAX_SEQUENTIAL_MAP_LIMIT;
+        while ((CcMaxSequentialMapLimit > SEQUENTIAL_MAP_LIMIT) && (((CcMaxSequentialMapLimit * 2) / VACB_MAPPING_GRANULARITY) > (CcNumberVacbs / 32))) {
+            CcMaxSequentialMapLimit /= 2;
+        }
+    } else {
+        SequentialMapLimit = SEQUENTIAL_MAP_LIMIT;
+        while ((SequentialMapLimit < MAX_SEQUENTIAL_MAP_LIMIT) && ((SequentialMapLimit * 2) <= CcMaxSequentialMapLimit)) {
+            SequentialMapLimit *= 2;
+        }
+
+        CcMaxSequentialMapLimit = SequentialMapLimit;
+    }
 }
 
 
@@ -195,8 +216,8 @@ Return Value:
 
         (*Vacb)->Overlay.ActiveCount += 1;
 
-        //  Move this range away from the front to avoid wasting cycles looking at it for reuse.
-        CcMoveVacbToReuseTail(*Vacb);
+        //  Keep this range away from reuse.
+        CcMarkVacbReferenced(*Vacb);
         Value = (PVOID)((PCHAR)(*Vacb)->BaseAddress + VacbOffset);
     }
     CcReleaseVacbLock(OldIrql);
@@ -240,7 +261,7 @@ Return Value:
     //  the SharedCacheMap->BcbSpinLock and the VacbLock to synchronize this correctly.  Otherwise, the VACB lock is sufficient for synchronizing
     //  the VACB lookup.
 
-    if (FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {
+    if (CcUsesBcbListHeads(SharedCacheMap)) {
         HasBcbListHeads = TRUE;
     }
 
@@ -248,17 +269,19 @@ Return Value:
     ASSERT(FileOffset.QuadPart <= SharedCacheMap->SectionSize.QuadPart);
     if ((TempVacb = GetVacb(SharedCacheMap, FileOffset)) == NULL) {
         TempVacb = CcGetVacbMiss(SharedCacheMap, FileOffset, &LockHandle, HasBcbListHeads);
+
+        //  Move this range away from the front to avoid wasting cycles
+        //  looking at it for reuse.
+        CcMoveVacbToReuseTail(TempVacb);
     } else {
         if (TempVacb->Overlay.ActiveCount == 0) {
             SharedCacheMap->VacbActiveCount += 1;
         }
 
         TempVacb->Overlay.ActiveCount += 1;
+        CcMarkVacbReferenced(TempVacb);
     }
 
-    //  Move this range away from the front to avoid wasting cycles
-    //  looking at it for reuse.
-    CcMoveVacbToReuseTail(TempVacb);
     CcReleaseBcbSpinLockAndVacbLock(HasBcbListHeads, &LockHandle);
     ExReleasePushLockShared(&SharedCacheMap->VacbPushLock);
 
@@ -299,6 +322,7 @@ Return Value:
 {
     PSHARED_CACHE_MAP OldSharedCacheMap;
     PVACB Vacb, TempVacb;
+    PLIST_ENTRY NextEntry;
     LARGE_INTEGER MappedLength;
     LARGE_INTEGER NormalOffset;
     NTSTATUS Status;
@@ -306,6 +330,7 @@ Return Value:
     ULONG PageIsDirty;
     PVACB ActiveVacb = NULL;
     ULONG VacbOffset = FileOffset.LowPart & (VACB_MAPPING_GRANULARITY - 1);
+    ULONG SequentialMapLimit = SharedCacheMap->SequentialMapLimit;
 
     NormalOffset = FileOffset;
     NormalOffset.LowPart -= VacbOffset;
@@ -325,7 +350,11 @@ Return Value:
     //  intelligently, while we have a pretty good guess where the candidate pages should come from.  We can't let the filecache size make large
     //  excursions, or we'll kick out a lot of valuable pages in the process.
 
-    if (!FlagOn(SharedCacheMap->Flags, RANDOM_ACCESS_SEEN) && ((NormalOffset.LowPart & (SEQUENTIAL_MAP_LIMIT - 1)) == 0) && (NormalOffset.QuadPart >= (SEQUENTIAL_MAP_LIMIT * 2))) {
+    //  For large files the window is doubled each time a pass completes without colliding with an active view, so a long sequential stream drops
+    //  its locks and unmaps behind itself in larger, less frequent batches.  A collision means someone else is still using views behind us, so
+    //  we drop back toward the default window.
+
+    if (!FlagOn(SharedCacheMap->Flags, RANDOM_ACCESS_SEEN) && ((NormalOffset.LowPart & (SequentialMapLimit - 1)) == 0) && (NormalOffset.QuadPart >= (SequentialMapLimit * 2))) {
         //  Use MappedLength as a scratch variable to form the offset to start unmapping.  We are not synchronized with these past
         //  views, so it is possible that CcUnmapVacbArray will kick out early when it sees an active view.  That is why we go back
         //  twice the distance, and effectively try to unmap everything twice.  The second time should normally do it.  If the file
@@ -334,8 +363,14 @@ Return Value:
         //  the file to push out the dirty bits.
         CcReleaseBcbSpinLockAndVacbLock(HasBcbListHeads, LockHandle);
         ExReleasePushLockShared(&SharedCacheMap->VacbPushLock);
-        MappedLength.QuadPart = NormalOffset.QuadPart - (SEQUENTIAL_MAP_LIMIT * 2);
-        CcUnmapVacbArray(SharedCacheMap, &MappedLength, (SEQUENTIAL_MAP_LIMIT * 2), TRUE);
+        MappedLength.QuadPart = NormalOffset.QuadPart - (SequentialMapLimit * 2);
+        if (CcUnmapVacbArray(SharedCacheMap, &MappedLength, (SequentialMapLimit * 2), TRUE)) {
+            if ((SequentialMapLimit < CcMaxSequentialMapLimit) && (SharedCacheMap->SectionSize.QuadPart >= ((LONGLONG)SequentialMapLimit * 8))) {
+                SharedCacheMap->SequentialMapLimit = SequentialMapLimit * 2;
+            }
+        } else if (SequentialMapLimit > SEQUENTIAL_MAP_LIMIT) {
+            SharedCacheMap->SequentialMapLimit = SequentialMapLimit / 2;
+        }
         ExAcquirePushLockShared(&SharedCacheMap->VacbPushLock);
         CcAcquireBcbSpinLockAndVacbLock(HasBcbListHeads, SharedCacheMap, LockHandle);
     }
@@ -348,6 +383,20 @@ Return Value:
         //  Scan from the front of the lru for the next victim Vacb
         Vacb = CONTAINING_RECORD(CcVacbLru.Flink, VACB, LruList);
         while (TRUE) {
+            //  If this guy has been used since we last looked at him, give him a second chance at the tail of the lru.
+            //  He is found again after the rest of the list if nothing else can be reused, so the scan still terminates.
+            if (Vacb->Referenced && (Vacb->Overlay.ActiveCount == 0)) {
+                NextEntry = Vacb->LruList.Flink;
+                Vacb->Referenced = FALSE;
+                CcMoveVacbToReuseTail(Vacb);
+                if (NextEntry == &CcVacbLru) {
+                    NextEntry = CcVacbLru.Flink;
+                }
+
+                Vacb = CONTAINING_RECORD(NextEntry, VACB, LruList);
+                continue;
+            }
+
             //  If this guy is not active, break out and use him.  Also, if
             //  it is an Active Vacb, delete it now, because the reader may be idle and we want to clean up.
             OldSharedCacheMap = Vacb->SharedCacheMap;
@@ -409,6 +458,7 @@ Return Value:
 
     //  Mark it in use so no one else will muck with it after we release the spin lock.
     Vacb->Overlay.ActiveCount = 1;
+    Vacb->Referenced = FALSE;
     SharedCacheMap->VacbActiveCount += 1;
     CcReleaseBcbSpinLockAndVacbLock(HasBcbListHeads, LockHandle);
 
@@ -452,6 +502,7 @@ Return Value:
         DebugTrace(0, mm, "    ViewSize = %08lx\n", MappedLength.LowPart);
 
         Status = MmMapViewInSystemCache(SharedCacheMap->Section, &Vacb->BaseAddress, &NormalOffset, &MappedLength.LowPart);
+        CcVacbMaps += 1;
 
         //  Take this opportunity to free the active vacb.
         if (ActiveVacb != NULL) {
@@ -476,7 +527,7 @@ Return Value:
             //  Raise if we cannot preallocate enough buffers.
             if (!CcPrefillVacbLevelZone(CcMaxVacbLevelsSeen - 1,
                                         LockHandle,
-                                        FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED),
+                                        CcUsesBcbListHeads(SharedCacheMap),
                                         HasBcbListHeads,
                                         SharedCacheMap)) {
                 //  We can't setup the Vacb levels, so we will raise the error here and the finally clause will do the proper cleanup.
@@ -578,15 +629,12 @@ Arguments:
                 KeSetEvent(SharedCacheMap->WaitOnActiveCount, 0, FALSE);
             }
 
-            CcMoveVacbToReuseTail(Vacb);//  Go to the back of the LRU to save this range for a bit
+            CcMarkVacbReferenced(Vacb);//  Save this range for a bit, the next victim scan moves it to the back of the LRU
         } else {
             //  This range is no longer referenced, so make it available
             ASSERT(Vacb->BaseAddress == NULL);
             CcMoveVacbToReuseFree(Vacb);
         }
-    } else {
-        //  This range is still in use, so move it away from the front so that it doesn't consume cycles being checked.
-        CcMoveVacbToReuseTail(Vacb);
     }
 
     CcReleaseVacbLock(OldIrql);
@@ -611,7 +659,7 @@ Arguments:
         //  Prefill the level zone so that we can expand the tree if required.
         if (!CcPrefillVacbLevelZone(CcMaxVacbLevelsSeen - 1,
                                     &LockHandle,
-                                    FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED),
+                                    CcUsesBcbListHeads(SharedCacheMap),
                                     TRUE,
                                     SharedCacheMap)) {
             ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
@@ -716,6 +764,7 @@ Arguments:
 
     MmUnmapViewInSystemCache(Vacb->BaseAddress, SharedCacheMap->Section, UnmapBehind && FlagOn(SharedCacheMap->Flags, ONLY_SEQUENTIAL_ONLY_SEEN));
     Vacb->BaseAddress = NULL;
+    CcVacbUnmaps += 1;
 }
 
 
@@ -775,7 +824,7 @@ Return Value:
             }
         } else {
             //  Does this stream get a Bcb Listhead array?
-            if (FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED) && (NewSectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY)) {
+            if (CcUsesBcbListHeads(SharedCacheMap) && (NewSectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY)) {
                 //  Grow the size we need to allocation sufficiently that it can accommodate the BCB list heads.  This is basically
                 //  doubling the size of the array since we have a BCB list head (i.e., LIST_ENTRY) for every 2 VACB pointers.
                 GrowArrayForBcbListHeads(SizeToAllocate);
@@ -845,7 +894,7 @@ Arguments:
     }
 
     //  See if we will be growing the Bcb ListHeads, so we can take out the BCB spin lock.
-    if (FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED) && (NewSectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY)) {
+    if (CcUsesBcbListHeads(SharedCacheMap) && (NewSectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY)) {
         GrowingBcbListHeads = TRUE;
     }
 
@@ -1024,7 +1073,7 @@ Arguments:
                     //  we have expanded up to the multilevel Vacbs above.  This level can't remain at the root and needs to be destroyed.  What we need to do is
                     //  replace it with one of our prefilled (non Bcb) levels and unlink the Bcb listheads in the old one.
 
-                    if (Level == 1 && FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {
+                    if (Level == 1 && CcUsesBcbListHeads(SharedCacheMap)) {
                         PLIST_ENTRY PredecessorListHead, SuccessorListHead;
                         NextVacbArray = SharedCacheMap->Vacbs;
                         SharedCacheMap->Vacbs = CcAllocateVacbLevel(FALSE);
@@ -1092,7 +1141,7 @@ Return Value:
     //  If this file uses BCB list heads for BCB management, mapping a new view may cause more BCB list heads to be added to the BcbList.  In this case,
     //  we must acquire both the SharedCacheMap->BcbSpinLock and the VacbLock to synchronize this correctly.  Otherwise, the VACB lock is sufficient
     //  for synchronizing the VACB manipulations.
-    if ((SharedCacheMap->SectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY) && FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {
+    if ((SharedCacheMap->SectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY) && CcUsesBcbListHeads(SharedCacheMap)) {
         HasBcbListHeads = TRUE;
     }
 
@@ -1275,7 +1324,7 @@ Environment:
 {
     PLIST_ENTRY BcbListHead;
 
-    if ((SharedCacheMap->SectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY) && FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {
+    if ((SharedCacheMap->SectionSize.QuadPart > BEGIN_BCB_LIST_ARRAY) && CcUsesBcbListHeads(SharedCacheMap)) {
         //  We've got BCB list head markers for this stream, so now do the work to find the appropriate list head for this offset.
         if (SharedCacheMap->SectionSize.QuadPart > VACB_SIZE_OF_FIRST_LEVEL) {
             //  We are using the multi-level VACB representation for this stream, so we need to walk the levels to find our BCB list head.
@@ -1517,7 +1566,7 @@ Environment:
     }
 
     //  If this is a metadata stream, we also have to count the Bcbs in the corresponding listheads.
-    if (FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED) && (Level == 0)) {
+    if (CcUsesBcbListHeads(SharedCacheMap) && (Level == 0)) {
 
         //  Pick up the Blink of the first listhead, casting it to a Bcb.
         Bcb = (PBCB)CONTAINING_RECORD(((PLIST_ENTRY)VacbTemp)->Blink, BCB, BcbLinks);
@@ -1652,7 +1701,7 @@ Environment:
         if (NextVacbArray == NULL) {//  If it is NULL then we have to allocate the next level to fill it in.
             //  We better not be thinking we're dereferencing a level if the level doesn't currently exist.
             ASSERT(Vacb != VACB_SPECIAL_DEREFERENCE);
-            AllocatingBcbListHeads = FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED) && (Level == 0);
+            AllocatingBcbListHeads = CcUsesBcbListHeads(SharedCacheMap) && (Level == 0);
 
             //  This is only valid if we are setting a nonzero pointer!
             ASSERT(Vacb != NULL);
@@ -1742,7 +1791,7 @@ Environment:
 
                 //  First see if we have Bcb Listheads to delete and if so, we have to unlink the whole block first.
                 AllocatingBcbListHeads = FALSE;
-                if ((Level++ == 0) && FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED)) {
+                if ((Level++ == 0) && CcUsesBcbListHeads(SharedCacheMap)) {
                     AllocatingBcbListHeads = TRUE;
                     PredecessorListHead = ((PLIST_ENTRY)((PCHAR)VacbArray + VACB_LEVEL_BLOCK_SIZE))->Flink;
                     SuccessorListHead = ((PLIST_ENTRY)((PCHAR)VacbArray + (VACB_LEVEL_BLOCK_SIZE * 2) - sizeof(LIST_ENTRY)))->Blink;
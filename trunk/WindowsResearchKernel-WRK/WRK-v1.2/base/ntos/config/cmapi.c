@@ -2011,7 +2011,7 @@ Arguments:
 
         CmpLockHiveListExclusive();
         CmpRemoveEntryList(&(NewHive->HiveList));
-        CmpUnlockHiveList();
+        CmpUnlockHiveListExclusive();
 
         UNLOCK_HIVE_LOAD();
 #if DBG
@@ -2301,6 +2301,7 @@ Notes:
 {
     NTSTATUS    Status;
     PLIST_ENTRY p;
+    PEX_PUSH_LOCK HiveListLock;
     PCMHIVE     h;
     BOOLEAN     Result = TRUE;
 
@@ -2313,7 +2314,7 @@ Notes:
     CmpForceForceFlush = FALSE;
 
     // traverse list of hives, sync each one
-    CmpLockHiveListShared();
+    CmpLockHiveListShared(HiveListLock);
     p = CmpHiveListHead.Flink;
     while (p != &CmpHiveListHead) {
         h = CONTAINING_RECORD(p, CMHIVE, HiveList);
@@ -2357,7 +2358,7 @@ Notes:
 
         p = p->Flink;
     }
-    CmpUnlockHiveList();
+    CmpUnlockHiveListShared(HiveListLock);
 
     return Result;
 }
@@ -2402,6 +2403,7 @@ Notes:
 {
     NTSTATUS    Status;
     PLIST_ENTRY p;
+    PEX_PUSH_LOCK HiveListLock;
     PCMHIVE     h;
     BOOLEAN     Result;
     ULONG       HiveCount = CmpLazyFlushHiveCount;
@@ -2423,7 +2425,7 @@ Notes:
     CmpForceForceFlush = FALSE;
 
     // traverse list of hives, sync each one
-    CmpLockHiveListShared();
+    CmpLockHiveListShared(HiveListLock);
     p = CmpHiveListHead.Flink;
     while (p != &CmpHiveListHead) {
         h = CONTAINING_RECORD(p, CMHIVE, HiveList);
@@ -2509,7 +2511,7 @@ Notes:
     } else {
         Result = TRUE;
     }
-    CmpUnlockHiveList();
+    CmpUnlockHiveListShared(HiveListLock);
 
     return Result;
 }
@@ -250,7 +250,7 @@ PCMHIVE CmpMasterHive = {0};
 BOOLEAN CmpNoMasterCreates = FALSE;     // Set TRUE after we're done to prevent random creates in the master hive, which is not backed by a file.
 
 LIST_ENTRY      CmpHiveListHead = {0};            // List of CMHIVEs
-EX_PUSH_LOCK    CmpHiveListHeadLock;                // used to protect the list above
+EX_PUSH_LOCK_AUTO_EXPAND CmpHiveListHeadLock;   // used to protect the list above
 EX_PUSH_LOCK    CmpLoadHiveLock;
 
 POBJECT_TYPE CmpKeyObjectType = {0};// Addresses of object type descriptors:
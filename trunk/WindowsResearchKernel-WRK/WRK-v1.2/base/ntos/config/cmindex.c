@@ -121,7 +121,8 @@ HCELL_INDEX
 CmpDoFindSubKeyByNumber(
     PHHIVE          Hive,
     PCM_KEY_INDEX   Index,
-    ULONG           Number
+    ULONG           Number,
+    ULONG           TotalCount
 );
 
 HCELL_INDEX
@@ -722,7 +723,7 @@ Return Value:
             // we couldn't map the bin containing this cell
             return HCELL_NIL;
         }
-        Result = CmpDoFindSubKeyByNumber(Hive, Index, Number);
+        Result = CmpDoFindSubKeyByNumber(Hive, Index, Number, Node->SubKeyCounts[Stable]);
         HvReleaseCell(Hive, Node->SubKeyLists[Stable]);
         return Result;
     } else if (Hive->StorageTypeCount > Volatile) {
@@ -734,7 +735,7 @@ Return Value:
                 // we couldn't map the bin containing this cell
                 return HCELL_NIL;
             }
-            Result = CmpDoFindSubKeyByNumber(Hive, Index, Number);
+            Result = CmpDoFindSubKeyByNumber(Hive, Index, Number, Node->SubKeyCounts[Volatile]);
             HvReleaseCell(Hive, Node->SubKeyLists[Volatile]);
             return Result;
         }
@@ -744,14 +745,17 @@ Return Value:
 }
 
 
-HCELL_INDEX CmpDoFindSubKeyByNumber(PHHIVE          Hive, PCM_KEY_INDEX   Index, ULONG           Number)
+HCELL_INDEX CmpDoFindSubKeyByNumber(PHHIVE          Hive, PCM_KEY_INDEX   Index, ULONG           Number, ULONG           TotalCount)
 /*
 Routine Description:
     Helper for CmpFindSubKeyByNumber, Find the Number'th entry in the index, starting from 0.
+    Entries in the back half of a root index are located by stepping through the root from its end,
+    so no lookup has to map more than half of the leaves.
 Arguments:
     Hive - pointer to hive control structure for hive of interest
     Index - root or leaf of the index
     Number - ordinal of child key to return
+    TotalCount - number of entries in the whole index (the SubKeyCounts of the parent for this storage type)
 Return Value:
     Cell of requested entry. HCELL_NIL on resources problem
 */
@@ -761,8 +765,39 @@ Return Value:
     PCM_KEY_INDEX   Leaf = NULL;
     PCM_KEY_FAST_INDEX FastIndex;
     HCELL_INDEX     Result;
+    ULONG           Remaining;
 
     if (Index->Signature == CM_KEY_INDEX_ROOT) {
+        ASSERT(Number < TotalCount);
+        if (Number >= (TotalCount / 2)) {
+            // step back through root from the end, till we find the right leaf;
+            // Remaining is the number of entries from the one we want to the end of the index
+            Remaining = TotalCount - Number;
+            for (i = Index->Count; i-- > 0; ) {
+                LeafCell = Index->List[i];
+                Leaf = (PCM_KEY_INDEX)HvGetCell(Hive, LeafCell);
+                if (Leaf == NULL) {
+                    // we couldn't map the bin containing this cell
+                    return HCELL_NIL;
+                }
+                if (Remaining <= Leaf->Count) {
+                    Number = Leaf->Count - Remaining;
+                    if ((Leaf->Signature == CM_KEY_FAST_LEAF) || (Leaf->Signature == CM_KEY_HASH_LEAF)) {
+                        FastIndex = (PCM_KEY_FAST_INDEX)Leaf;
+                        Result = FastIndex->List[Number].Cell;
+                    } else {
+                        Result = Leaf->List[Number];
+                    }
+                    HvReleaseCell(Hive, LeafCell);
+                    return Result;
+                }
+                Remaining = Remaining - Leaf->Count;
+                HvReleaseCell(Hive, LeafCell);
+            }
+            ASSERT(FALSE);
+            return HCELL_NIL;
+        }
+
         // step through root, till we find the right leaf
         for (i = 0; i < Index->Count; i++) {
             if (i) {
@@ -581,7 +581,7 @@ Return Value:
     if (!(CheckFlags&CM_DONT_ADD_TO_HIVE_LIST)) {
         CmpLockHiveListExclusive(); // at the end so system hive is first during the lazy flush iteration
         InsertTailList(&CmpHiveListHead, &(cmhive2->HiveList));
-        CmpUnlockHiveList();
+        CmpUnlockHiveListExclusive();
     }
     *CmHive = cmhive2;
     return (STATUS_SUCCESS);
@@ -622,7 +622,7 @@ Return Value:
         // Take the hive out of the hive list
         CmpLockHiveListExclusive();
         CmpRemoveEntryList(&(((PCMHIVE)Hive)->HiveList));
-        CmpUnlockHiveList();
+        CmpUnlockHiveListExclusive();
         return(TRUE);
     } else {
         return(FALSE);
@@ -1092,11 +1092,12 @@ Arguments:
     USHORT              NrViews;
     PCMHIVE             CmCurrentHive;
     PLIST_ENTRY         p;
+    PEX_PUSH_LOCK       HiveListLock;
 
     CM_PAGED_CODE();
 
     // iterate through the hive list
-    CmpLockHiveListShared();
+    CmpLockHiveListShared(HiveListLock);
     p = CmpHiveListHead.Flink;
     while (p != &CmpHiveListHead) {
         CmCurrentHive = (PCMHIVE)CONTAINING_RECORD(p, CMHIVE, HiveList);
@@ -1130,7 +1131,7 @@ Arguments:
     Ignore:
         p = p->Flink;
     }
-    CmpUnlockHiveList();
+    CmpUnlockHiveListShared(HiveListLock);
 }
 
 
@@ -1150,6 +1151,7 @@ Return Value:
 {
     PCMHIVE             CmHive = NULL;
     PLIST_ENTRY         p;
+    PEX_PUSH_LOCK       HiveListLock;
     NTSTATUS            Status;
 
     CM_PAGED_CODE();
@@ -1161,7 +1163,7 @@ Return Value:
     CmpLockRegistry();
 
     // iterate through the hive list
-    CmpLockHiveListShared();
+    CmpLockHiveListShared(HiveListLock);
     p = CmpHiveListHead.Flink;
     while (p != &CmpHiveListHead) {
         CmHive = (PCMHIVE)CONTAINING_RECORD(p, CMHIVE, HiveList);
@@ -1174,7 +1176,7 @@ Return Value:
 
         p = p->Flink;
     }
-    CmpUnlockHiveList();
+    CmpUnlockHiveListShared(HiveListLock);
 
     if (p == &CmpHiveListHead) {
         // bad luck;
@@ -1204,10 +1206,11 @@ BOOLEAN CmIsFileLoadedAsHive(PFILE_OBJECT FileObject)
 {
     PCMHIVE             CmHive;
     PLIST_ENTRY         p;
+    PEX_PUSH_LOCK       HiveListLock;
     BOOLEAN             HiveFound = FALSE;
 
     // iterate through the hive list
-    CmpLockHiveListShared();
+    CmpLockHiveListShared(HiveListLock);
     p = CmpHiveListHead.Flink;
     while (p != &CmpHiveListHead) {
         CmHive = (PCMHIVE)CONTAINING_RECORD(p, CMHIVE, HiveList);
@@ -1218,7 +1221,7 @@ BOOLEAN CmIsFileLoadedAsHive(PFILE_OBJECT FileObject)
 
         p = p->Flink;
     }
-    CmpUnlockHiveList();
+    CmpUnlockHiveListShared(HiveListLock);
 
     return HiveFound;
 }
@@ -34,6 +34,10 @@ Abstract:
 
 #define CmpCheckPostBlock(a) //nothing
 
+// Ancestors of the changed key up to this depth are looked up by level when matching notify blocks,
+// instead of walking the parent chain again for every notify block on the hive.
+#define CM_NOTIFY_ANCESTOR_LEVELS   32
+
 // "Back Side" of notify
 
 extern  PCMHIVE  CmpMasterHive;
@@ -217,9 +221,20 @@ Arguments:
     KIRQL               OldIrql;
     LIST_ENTRY          DelayedDeref;
     PCM_KEY_NODE        Node;
+    PCM_KEY_CONTROL_BLOCK Ancestors[CM_NOTIFY_ANCESTOR_LEVELS];
+    PCM_KEY_CONTROL_BLOCK kcb;
+    ULONG               LevelDiff, l;
 
     CM_PAGED_CODE();
 
+    // record the shallow ancestors of the kcb by level, once for the whole notify list
+    RtlZeroMemory(Ancestors, sizeof(Ancestors));
+    for (kcb = KeyControlBlock; kcb != NULL; kcb = kcb->ParentKcb) {
+        if (kcb->TotalLevels < CM_NOTIFY_ANCESTOR_LEVELS) {
+            Ancestors[kcb->TotalLevels] = kcb;
+        }
+    }
+
     Node = (PCM_KEY_NODE)HvGetCell(Hive, Cell);
     if (Node == NULL) {
         // bad luck, we cannot map the view containing this cell
@@ -238,15 +253,20 @@ Arguments:
         if (NotifyBlock->KeyControlBlock->TotalLevels > KeyControlBlock->TotalLevels) {
             // list is level sorted, we're past all shorter entries
             break;
+        } else if ((NotifyBlock->Filter & Filter) == 0) {
+            // not watching for this kind of event; don't bother finding the ancestor
+            continue;
         } else {
-            PCM_KEY_CONTROL_BLOCK kcb;
-            ULONG LevelDiff, l;
-
-            LevelDiff = KeyControlBlock->TotalLevels - NotifyBlock->KeyControlBlock->TotalLevels;
+            l = NotifyBlock->KeyControlBlock->TotalLevels;
+            if ((l < CM_NOTIFY_ANCESTOR_LEVELS) && (Ancestors[l] != NULL)) {
+                kcb = Ancestors[l];
+            } else {
+                LevelDiff = KeyControlBlock->TotalLevels - l;
 
-            kcb = KeyControlBlock;
-            for (l = 0; l < LevelDiff; l++) {
-                kcb = kcb->ParentKcb;
+                kcb = KeyControlBlock;
+                for (l = 0; l < LevelDiff; l++) {
+                    kcb = kcb->ParentKcb;
+                }
             }
 
             if (kcb == NotifyBlock->KeyControlBlock) {
@@ -24,6 +24,7 @@ Abstract:
 #define     _64K    (64L*1024L)   //64K
 #define     _256K   (256L*1024L)  //256K
 #define        IO_BUFFER_SIZE  _64K  //64K
+#define        IO_LOAD_BUFFER_SIZE  _256K  // preferred chunk when reading a whole hive image in; falls back to IO_BUFFER_SIZE
 
 #include "ntos.h"
 #include "hive.h"
@@ -199,6 +200,7 @@ VOID CmpWmiDumpKcb(PCM_KEY_CONTROL_BLOCK       kcb);
 // Extra Tags for cache.
 // We may want to merge these tags later.
 #define  CM_CACHE_VALUE_INDEX_TAG 'IVMC'
+#define  CM_CACHE_VALUE_HASH_TAG  'HVMC'
 #define  CM_CACHE_VALUE_TAG       'aVMC'
 #define  CM_CACHE_INDEX_TAG       'nIMC'
 #define  CM_CACHE_VALUE_DATA_TAG  'aDMC'
@@ -523,10 +525,12 @@ extern EX_PUSH_LOCK CmpStashBufferLock;
 #define UNLOCK_STASH_BUFFER() ExReleasePushLock(&CmpStashBufferLock)
 
 // protection for CmpHiveListHead
-extern EX_PUSH_LOCK CmpHiveListHeadLock;
-#define CmpLockHiveListShared()     ExAcquirePushLockShared(&CmpHiveListHeadLock)
-#define CmpLockHiveListExclusive()  ExAcquirePushLockExclusive(&CmpHiveListHeadLock)
-#define CmpUnlockHiveList()         ExReleasePushLock(&CmpHiveListHeadLock)
+// N.B. The hive list lock is read mostly, so it is an auto expand push lock. Shared acquires return the push lock to release.
+extern EX_PUSH_LOCK_AUTO_EXPAND CmpHiveListHeadLock;
+#define CmpLockHiveListShared(PushLock)     ((PushLock) = ExAcquireAutoExpandPushLockShared(&CmpHiveListHeadLock))
+#define CmpUnlockHiveListShared(PushLock)   ExReleaseAutoExpandPushLockShared(PushLock)
+#define CmpLockHiveListExclusive()          ExAcquireAutoExpandPushLockExclusive(&CmpHiveListHeadLock)
+#define CmpUnlockHiveListExclusive()        ExReleaseAutoExpandPushLockExclusive(&CmpHiveListHeadLock)
 
 // protection for CmLoadKey
 extern EX_PUSH_LOCK    CmpLoadHiveLock;
@@ -672,12 +676,12 @@ if( !IsListEmpty(&(CmHive->TrustClassEntry)) ) {            \
     ASSERT(CmHive->Flags&CM_CMHIVE_FLAG_UNTRUSTED);         \
     CmpLockHiveListExclusive();                             \
     RemoveEntryList(&(CmHive->TrustClassEntry));            \
-    CmpUnlockHiveList();                                    \
+    CmpUnlockHiveListExclusive();                           \
 }
 #define CmpJoinClassOfTrust(_NewHive,_OtherHive)                            \
 CmpLockHiveListExclusive();                                                 \
 InsertTailList(&(_OtherHive->TrustClassEntry),&(_NewHive->TrustClassEntry));\
-CmpUnlockHiveList()
+CmpUnlockHiveListExclusive()
 
 
 #define CmLogCellRef( HIVE, CELL )
@@ -1487,6 +1491,9 @@ VOID CmpCleanUpKcbCacheWithLock(PCM_KEY_CONTROL_BLOCK   KeyControlBlock, BOOLEAN
 VOID CmpRemoveFromDelayedClose(IN PCM_KEY_CONTROL_BLOCK kcb);
 PUNICODE_STRING CmpConstructName(PCM_KEY_CONTROL_BLOCK kcb);
 
+// Value lists at least this long get a hash index (CM_VALUE_HASH_INDEX) on the first lookup by name.
+#define CM_VALUE_HASH_INDEX_THRESHOLD   16
+
 typedef enum _VALUE_SEARCH_RETURN_TYPE {
     SearchSuccess = 0,
     SearchNeedExclusiveLock = 1,
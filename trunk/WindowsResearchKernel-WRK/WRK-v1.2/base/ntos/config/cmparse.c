@@ -2344,6 +2344,7 @@ Return Value:
 {
     PCMHIVE     TmpHive;
     PLIST_ENTRY AnchorAddr;
+    PEX_PUSH_LOCK HiveListLock;
 
     PAGED_CODE();
 
@@ -2363,7 +2364,7 @@ Return Value:
 
     ASSERT(DestHive->Flags & CM_CMHIVE_FLAG_UNTRUSTED);// both untrusted; see if they are in the same class of trust
 
-    CmpLockHiveListShared();
+    CmpLockHiveListShared(HiveListLock);
 
     // walk the TrustClassEntry list of SrcHive, to see if we can find DstSrc
     AnchorAddr = &(DestHive->TrustClassEntry);
@@ -2373,14 +2374,14 @@ Return Value:
         TmpHive = CONTAINING_RECORD(TmpHive, CMHIVE, TrustClassEntry);
         if (TmpHive == OrigHive) {
             // found it ==> same class of trust
-            CmpUnlockHiveList();
+            CmpUnlockHiveListShared(HiveListLock);
             return TRUE;
         }
 
         TmpHive = (PCMHIVE)(TmpHive->TrustClassEntry.Flink);// skip to the next element
     }
 
-    CmpUnlockHiveList();
+    CmpUnlockHiveListShared(HiveListLock);
 
 Fail:
     // returning TRUE here will disable the 'don't follow links outside class of trust' behavior
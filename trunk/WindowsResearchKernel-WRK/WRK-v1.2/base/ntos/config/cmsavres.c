@@ -1317,7 +1317,7 @@ Arguments:
 
     CmpLockHiveListExclusive();
     CmpRemoveEntryList(&CmHive->HiveList);
-    CmpUnlockHiveList();
+    CmpUnlockHiveListExclusive();
 
     HvFreeHive(&(CmHive->Hive));
     CmpFreeMutex(CmHive->ViewLock);
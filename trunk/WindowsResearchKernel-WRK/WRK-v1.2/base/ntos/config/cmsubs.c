@@ -20,6 +20,14 @@ PCM_KEY_HASH_TABLE_ENTRY CmpCacheTable;
 PCM_NAME_HASH_TABLE_ENTRY CmpNameCacheTable;
 ULONG CmpHashTableSize = 2048;
 
+// The KCB and name hash tables are sized once, when the cache is initialized, from the amount of physical memory.
+// Every bucket carries its own push lock and KCB lock ordering is done by bucket index, so the table cannot be
+// rehashed under a live registry; larger machines (which open many more keys concurrently) simply get more buckets
+// and therefore shorter chains and less contention on each bucket lock.
+#define CM_MINIMUM_HASH_TABLE_SIZE  2048
+#define CM_MAXIMUM_HASH_TABLE_SIZE  65536
+#define CM_PAGES_PER_HASH_BUCKET    ((64 * 1024) >> PAGE_SHIFT)     // one bucket per 64K of physical memory
+
 #ifdef ALLOC_DATA_PRAGMA
 #pragma data_seg("PAGEDATA")
 #endif
@@ -912,10 +920,17 @@ Return Value:
 {
     ULONG i;
     PULONG_PTR CachedList;
+    PCM_CACHED_VALUE_INDEX CachedValueIndex;
 
     ASSERT_KCB_LOCKED_EXCLUSIVE(KeyControlBlock);
 
     if (CMP_IS_CELL_CACHED(KeyControlBlock->ValueCache.ValueList)) {
+        // the hash index only refers to positions in the cached list; drop it along with the list
+        CachedValueIndex = (PCM_CACHED_VALUE_INDEX)CMP_GET_CACHED_ADDRESS(KeyControlBlock->ValueCache.ValueList);
+        if (CachedValueIndex->HashIndex != NULL) {
+            ExFreePool(CachedValueIndex->HashIndex);
+        }
+
         CachedList = (PULONG_PTR)CMP_GET_CACHED_CELLDATA(KeyControlBlock->ValueCache.ValueList);
         for (i = 0; i < KeyControlBlock->ValueCache.Count; i++) {
             if (CMP_IS_CELL_CACHED(CachedList[i])) {
@@ -1698,6 +1713,14 @@ VOID CmpInitializeCache()
 {
     ULONG   i;
     ULONG   TotalCmCacheSize;
+    ULONG   Buckets;
+
+    // scale the table with physical memory; keep it a power of two between the minimum and maximum sizes
+    Buckets = (ULONG)(MmNumberOfPhysicalPages / CM_PAGES_PER_HASH_BUCKET);
+    CmpHashTableSize = CM_MINIMUM_HASH_TABLE_SIZE;
+    while ((CmpHashTableSize < CM_MAXIMUM_HASH_TABLE_SIZE) && (CmpHashTableSize < Buckets)) {
+        CmpHashTableSize <<= 1;
+    }
 
     TotalCmCacheSize = CmpHashTableSize * sizeof(CM_KEY_HASH_TABLE_ENTRY);
     CmpCacheTable = ExAllocatePoolWithTag(PagedPool, TotalCmCacheSize, 'aCMC');
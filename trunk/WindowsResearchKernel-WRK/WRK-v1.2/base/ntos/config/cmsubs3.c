@@ -40,6 +40,10 @@ Abstract:
 #endif
 
 // Global registry lock
+// Queries, enumerations and ordinary writes (create, set/delete value, delete key) all take it shared; what they
+// modify is protected by the KCB hash entry locks, the hive flusher lock and the per-hive writer lock, so a writer
+// in one hive does not block readers of another. It is only taken exclusive by operations that reshape the
+// namespace or replace hives wholesale (load/unload, restore, rename, compaction) and by forced flushes.
 ERESOURCE   CmpRegistryLock;
 
 LONG        CmpFlushStarveWriters = 0;
@@ -226,7 +226,7 @@ Return Value:
 
     // Initialize the hive list head
     InitializeListHead(&CmpHiveListHead);
-    ExInitializePushLock(&CmpHiveListHeadLock);
+    ExInitializeAutoExpandPushLock(&CmpHiveListHeadLock);
     ExInitializePushLock(&CmpLoadHiveLock);
 
     ExInitializeResourceLite(&CmpRegistryLock);// Initialize the global registry resource
@@ -13,9 +13,12 @@ Abstract:
 
 #include    "cmp.h"
 
+PCM_VALUE_HASH_INDEX CmpBuildValueHashIndex(IN PCM_KEY_CONTROL_BLOCK KeyControlBlock, IN PCELL_DATA List);
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,CmpGetValueListFromCache)
 #pragma alloc_text(PAGE,CmpGetValueKeyFromCache)
+#pragma alloc_text(PAGE,CmpBuildValueHashIndex)
 #pragma alloc_text(PAGE,CmpFindValueByNameFromCache)
 #pragma alloc_text(PAGE,CmpGetValueDataFromCache)
 #endif
@@ -82,6 +85,7 @@ Return Value:
         CachedValueIndex = (PCM_CACHED_VALUE_INDEX)ExAllocatePoolWithTag(PagedPool, AllocSize, CM_CACHE_VALUE_INDEX_TAG);
         if (CachedValueIndex) {
             CachedValueIndex->CellIndex = CMP_GET_CACHED_CELL_INDEX(ChildList->ValueList);
+            CachedValueIndex->HashIndex = NULL;
 #pragma prefast(suppress:12009, "no overflow")
             for (i = 0; i < ChildList->Count; i++) {
                 CachedValueIndex->Data.List[i] = (ULONG_PTR)(*List)->u.KeyList[i];
@@ -236,6 +240,74 @@ Return Value:
 }
 
 
+PCM_VALUE_HASH_INDEX
+CmpBuildValueHashIndex(
+    IN PCM_KEY_CONTROL_BLOCK KeyControlBlock,
+    IN PCELL_DATA           List
+)
+/*
+Routine Description:
+    Build the hash index over a cached value list, so lookups by name only look at the values whose name hash
+    falls in the same bucket instead of walking the whole list.
+    Every value node in the list is cached on the way, since the index is built from the cached name hashes.
+Arguments:
+    KeyControlBlock - KCB whose value list is cached; must be locked exclusive.
+    List - the cached value index array.
+Return Value:
+    Pointer to the new hash index, NULL if it could not be built (the caller simply walks the list).
+*/
+{
+    ULONG                   i;
+    ULONG                   Count;
+    ULONG                   Bucket;
+    PULONG_PTR              CachedList;
+    PPCM_CACHED_VALUE       ContainingList;
+    PCM_KEY_VALUE           Value;
+    BOOLEAN                 ValueCached;
+    HCELL_INDEX             CellToRelease;
+    PCM_VALUE_HASH_INDEX    HashIndex;
+    VALUE_SEARCH_RETURN_TYPE ret;
+
+    ASSERT_KCB_LOCKED_EXCLUSIVE(KeyControlBlock);
+    ASSERT(CMP_IS_CELL_CACHED(KeyControlBlock->ValueCache.ValueList));
+
+    Count = KeyControlBlock->ValueCache.Count;
+    CachedList = (PULONG_PTR)List;
+
+    for (i = 0; i < Count; i++) {
+        ret = CmpGetValueKeyFromCache(KeyControlBlock, List, i, &ContainingList, &Value, TRUE, &ValueCached, &CellToRelease);
+        if (CellToRelease != HCELL_NIL) {
+            HvReleaseCell(KeyControlBlock->KeyHive, CellToRelease);
+        }
+        if ((ret != SearchSuccess) || (ValueCached == FALSE)) {
+            // without the cached name hash of every value we cannot index the list
+            return NULL;
+        }
+    }
+
+    // one bucket per value keeps the chains short; buckets and links share one allocation
+    HashIndex = (PCM_VALUE_HASH_INDEX)ExAllocatePoolWithTag(PagedPool,
+                                                            FIELD_OFFSET(CM_VALUE_HASH_INDEX, Buckets) + 2 * Count * sizeof(ULONG),
+                                                            CM_CACHE_VALUE_HASH_TAG);
+    if (HashIndex == NULL) {
+        return NULL;
+    }
+    HashIndex->BucketCount = Count;
+    HashIndex->Links = &(HashIndex->Buckets[Count]);
+    RtlZeroMemory(HashIndex->Buckets, Count * sizeof(ULONG));
+
+    // insert from the end so every chain is in list order, as the linear walk would find them
+    for (i = Count; i-- > 0; ) {
+        ASSERT(CMP_IS_CELL_CACHED(CachedList[i]));
+        Bucket = ((PCM_CACHED_VALUE)CMP_GET_CACHED_ADDRESS(CachedList[i]))->HashKey % Count;
+        HashIndex->Links[i] = HashIndex->Buckets[Bucket];
+        HashIndex->Buckets[Bucket] = i + 1;
+    }
+
+    return HashIndex;
+}
+
+
 VALUE_SEARCH_RETURN_TYPE
 CmpFindValueByNameFromCache(
     IN PCM_KEY_CONTROL_BLOCK KeyControlBlock,
@@ -264,6 +336,7 @@ Return Value:
 Notes:
     New hives (Minor >= 4) have ValueList sorted; this implies ValueCache is sorted too;
     So, we can do a binary search here!
+    Long cached value lists are searched through their hash index (see CmpBuildValueHashIndex) instead.
 */
 {
     UNICODE_STRING      Candidate;
@@ -275,6 +348,8 @@ Notes:
     ULONG               HashKey = 0;
     PHHIVE              Hive = KeyControlBlock->KeyHive;
     PCACHED_CHILD_LIST  ChildList = &(KeyControlBlock->ValueCache);
+    PCM_CACHED_VALUE_INDEX  CachedValueIndex;
+    PCM_VALUE_HASH_INDEX    HashIndex = NULL;
     VALUE_SEARCH_RETURN_TYPE    ret = SearchFail;
 
     ASSERT_KCB_LOCKED(KeyControlBlock);
@@ -303,10 +378,38 @@ Notes:
                 ret = SearchFail;
                 goto Exit;
             }
+
+            if (ChildList->Count >= CM_VALUE_HASH_INDEX_THRESHOLD) {
+                // build the hash index on the first lookup we can make exclusive; it is read-only afterwards,
+                // so shared lookups use it as is. If we cannot get the lock right away just walk the list.
+                CachedValueIndex = (PCM_CACHED_VALUE_INDEX)CMP_GET_CACHED_ADDRESS(ChildList->ValueList);
+                if ((CachedValueIndex->HashIndex == NULL) &&
+                    (CmpIsKCBLockedExclusive(KeyControlBlock) || CmpTryConvertKCBLockSharedToExclusive(KeyControlBlock))) {
+
+                    // Trying to catch the BAD guy who writes over our pool.
+                    CmpMakeSpecialPoolReadWrite(CachedValueIndex);
+
+                    CachedValueIndex->HashIndex = CmpBuildValueHashIndex(KeyControlBlock, List);
+
+                    // Trying to catch the BAD guy who writes over our pool.
+                    CmpMakeSpecialPoolReadOnly(CachedValueIndex);
+                }
+                HashIndex = CachedValueIndex->HashIndex;
+            }
         }
 
-        // old plain hive; simulate a for
-        Current = 0;
+        if (HashIndex != NULL) {
+            // start at the head of the name's bucket
+            Current = HashIndex->Buckets[HashKey % HashIndex->BucketCount];
+            if (Current == 0) {
+                ret = SearchFail;
+                goto Exit;
+            }
+            Current--;
+        } else {
+            // old plain hive; simulate a for
+            Current = 0;
+        }
 
         while (TRUE) {
             if (*CellToRelease != HCELL_NIL) {
@@ -373,6 +476,18 @@ Notes:
                 goto Exit;
             }
 
+            if (HashIndex != NULL) {
+                // next value in the same bucket
+                Current = HashIndex->Links[Current];
+                if (Current == 0) {
+                    (*Value) = NULL;
+                    ret = SearchFail;
+                    goto Exit;
+                }
+                Current--;
+                continue;
+            }
+
             // compute the next index to try: old'n plain hive; go on
             Current++;
             if (Current == ChildList->Count) {
@@ -146,6 +146,11 @@ Arguments:
 
     ASSERT((Cell - (Type * HCELL_TYPE_MASK)) < Hive->Storage[Type].Length);
 
+    if (Type == Volatile) {
+        // HvpGetCellMapped took no reference on volatile cells; nothing to give back
+        return;
+    }
+
     // lock hive views before extracting data
     CmLockHiveViews((PCMHIVE)Hive);
     Map = &((Hive->Storage[Type].Map)->Directory[Table]->Table[Block]);
@@ -223,6 +228,26 @@ struct _CELL_DATA * HvpGetCellMapped(PHHIVE      Hive, HCELL_INDEX Cell)
 
     ASSERT((Cell - (Type * HCELL_TYPE_MASK)) < Hive->Storage[Type].Length);
 
+    if (Type == Volatile) {
+        // Volatile storage lives in paged pool for the life of the hive. It is never mapped through a view and never
+        // dropped by HvpDropPagedBins, so there is no view to map or pin and no use count to take.
+        // Resolve it straight from the map, without the view lock, as HvpGetCellPaged does.
+        Map = &((Hive->Storage[Volatile].Map)->Directory[Table]->Table[Block]);
+        ASSERT(Map->BinAddress & HMAP_INPAGEDPOOL);
+        ASSERT(HBIN_BASE(Map->BinAddress) != 0);
+        ASSERT((Map->BinAddress & HMAP_DISCARDABLE) == 0);
+
+        pcell = (PHCELL)((ULONG_PTR)(Map->BlockAddress) + Offset);
+
+        PERFINFO_HIVECELL_REFERENCE_PAGED(Hive, pcell, Cell, Type, Map);
+
+        if (USE_OLD_CELL(Hive)) {
+            return (struct _CELL_DATA *)&(pcell->u.OldCell.u.UserData);
+        } else {
+            return (struct _CELL_DATA *)&(pcell->u.NewCell.u.UserData);
+        }
+    }
+
     CmLockHiveViews((PCMHIVE)Hive);
 
     Map = &((Hive->Storage[Type].Map)->Directory[Table]->Table[Block]);
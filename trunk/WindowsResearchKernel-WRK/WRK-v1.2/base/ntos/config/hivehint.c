@@ -478,6 +478,13 @@ Note:
     ASSERT(!RtlAreBitsClear(&(Hive->Storage[Type].FreeDisplay[Index].Display), FileOffsetStart / HBLOCK_SIZE, (FileOffsetEnd - FileOffsetStart) / HBLOCK_SIZE));
 
     while (FileOffsetStart < FileOffsetEnd) {
+        if (RtlCheckBit(&(Hive->Storage[Type].FreeDisplay[Index].Display), FileOffsetStart / HBLOCK_SIZE) == 0) {
+            // hints are set for every block of a bin, so the bin this block belongs to has no free cell of this size;
+            // step over it without mapping its view (a fragmented window may have only a couple of hinted bins)
+            FileOffsetStart += HBLOCK_SIZE;
+            continue;
+        }
+
         Cell = FileOffsetStart + (Type * HCELL_TYPE_MASK);
         Me = HvpGetCellMap(Hive, Cell);
         VALIDATE_CELL_MAP(__LINE__, Me, Hive, Cell);
@@ -425,7 +425,8 @@ NTSTATUS HvpReadFileImageAndBuildMap(PHHIVE  Hive, ULONG   Length)
 Routine Description:
     Read the hive from the file and allocate storage for the hive image in chunks of HBINs.
     Build the hive map "on the fly".
-    Optimized to read chunks of 64K from the file.
+    Optimized to read chunks of 256K from the file (64K if pool is tight), so CmpFileRead issues its 64K reads
+    back to back and sets up its event once per chunk rather than once per 64K.
 Arguments:
     Hive - supplies a pointer to the hive control structure for the hive of interest
     Length - the length of the hive, in bytes
@@ -447,7 +448,8 @@ Return Value:
     ULONG           BinDataInBuffer;// the amount of data needed to be copied in the current bin available in the buffer
     ULONG           BinDataNeeded;  //
     PUCHAR                      IOBuffer;
-    ULONG           IOBufferSize;       // valid data in IOBuffer (only at the end of the file this is different than IO_BUFFER_SIZE)
+    ULONG           IOBufferSize;       // valid data in IOBuffer (only at the end of the file this is different than IOBufferLength)
+    ULONG           IOBufferLength;     // size of the IOBuffer allocation
     ULONG           IOBufferOffset;     // current offset inside IOBuffer
     NTSTATUS        Status2 = STATUS_SUCCESS; // used to force recoverData upon exit
     BOOLEAN         MarkBinDirty;
@@ -459,9 +461,18 @@ Return Value:
         return Status;
     }
 
-    // Allocate a IO_BUFFER_SIZE for I/O operations from paged pool.
+    // Allocate a IO_LOAD_BUFFER_SIZE (or at least IO_BUFFER_SIZE) for I/O operations from paged pool.
     // It will be freed at the end of the function.
-    IOBuffer = (PUCHAR)ExAllocatePool(PagedPool, IO_BUFFER_SIZE);
+    IOBufferLength = IO_LOAD_BUFFER_SIZE;
+    if (IOBufferLength > ROUND_UP(Length, IO_BUFFER_SIZE)) {
+        // no point in a buffer bigger than the hive
+        IOBufferLength = ROUND_UP(Length, IO_BUFFER_SIZE);
+    }
+    IOBuffer = (PUCHAR)ExAllocatePool(PagedPool, IOBufferLength);
+    if ((IOBuffer == NULL) && (IOBufferLength > IO_BUFFER_SIZE)) {
+        IOBufferLength = IO_BUFFER_SIZE;
+        IOBuffer = (PUCHAR)ExAllocatePool(PagedPool, IOBufferLength);
+    }
     if (IOBuffer == NULL) {
         Status = STATUS_INSUFFICIENT_RESOURCES;
         HvpCleanMap(Hive);
@@ -473,15 +484,15 @@ Return Value:
     BinFileOffset = FileOffset;
     Bin = NULL;
 
-    // outer loop : reads IO_BUFFER_SIZE chunks from the file
+    // outer loop : reads IOBufferLength chunks from the file
     while (FileOffset < (Length + HBLOCK_SIZE)) {
         // we are at the beginning of the IO buffer
         IOBufferOffset = 0;
 
-        // the buffer size will be either IO_BufferSize, or the amount
-        // uread from the file (when this is smaller than IO_BUFFER_SIZE)
+        // the buffer size will be either IOBufferLength, or the amount
+        // uread from the file (when this is smaller than IOBufferLength)
         IOBufferSize = Length + HBLOCK_SIZE - FileOffset;
-        IOBufferSize = (IOBufferSize > IO_BUFFER_SIZE) ? IO_BUFFER_SIZE : IOBufferSize;
+        IOBufferSize = (IOBufferSize > IOBufferLength) ? IOBufferLength : IOBufferSize;
 
         ASSERT((IOBufferSize % HBLOCK_SIZE) == 0);
 
@@ -1869,7 +1869,9 @@ Return Value:
     ULONG       RunSpan;
     ULONG       RunLength;
     ULONG       FileLength;
+    ULONG       BinEnd;
     PFREE_HBIN  FreeBin;
+    PHBIN       Bin;
 
     CmKdPrintEx((DPFLTR_CONFIG_ID, CML_IO, "HvpFindNextDirtyBlock:\n\t"));
     CmKdPrintEx((DPFLTR_CONFIG_ID, CML_IO, "Hive:%p Current:%08lx\n", Hive, *Current));
@@ -1947,12 +1949,9 @@ Return Value:
         FileBaseAddress = ROUND_UP(FileBaseAddress + 1, HBLOCK_SIZE);
     }
 
-    // Scan forward through blocks, filling up length as we go.
-
-    // NOTE:    This loop grows forward 1 block at time.  If we were
-    //          really clever we'd fill forward a bin at time, since
-    //          bins are always contiguous.  But most bins will be
-    //          one block long anyway, so we won't bother for now.
+    // Scan forward through bins, filling up length as we go.
+    // Only the first block of each bin needs a map lookup and a contiguity check; the rest of the bin is contiguous
+    // in memory by construction, so large dirty bins (and hives whose bins happen to be adjacent) go out as one run.
     while (RunLength < FileLength) {
         Me = HvpGetCellMap(Hive, FileBaseAddress);
         VALIDATE_CELL_MAP(__LINE__, Me, Hive, FileBaseAddress);
@@ -1979,18 +1978,27 @@ Return Value:
             break;
         }
 
-        if ((FileEndAddress - FileBaseAddress) <= HBLOCK_SIZE) {
-            // We've reached the tail block, all is contiguous, fill up to end and return.
+        // the bin (or free bin) this block belongs to ends here
+        if (Me->BinAddress & HMAP_DISCARDABLE) {
+            BinEnd = FreeBin->FileOffset + FreeBin->Size;
+        } else {
+            Bin = (PHBIN)HBIN_BASE(Me->BinAddress);
+            BinEnd = Bin->FileOffset + Bin->Size;
+        }
+        ASSERT((BinEnd > FileBaseAddress) && ((BinEnd % HBLOCK_SIZE) == 0));
+
+        if (FileEndAddress <= BinEnd) {
+            // We've reached the tail bin, all is contiguous, fill up to end and return.
             *Length = FileLength;
             *Current = End;
             return TRUE;
         }
 
-        // Just another contiguous block, fill forward
-        RunLength += HBLOCK_SIZE;
-        RunSpan += HSECTOR_COUNT;
-        FileBaseAddress += HBLOCK_SIZE;
-        Block = NextBlock;
+        // Just another contiguous bin, fill forward to its end
+        RunLength += BinEnd - FileBaseAddress;
+        RunSpan += (BinEnd - FileBaseAddress) / HSECTOR_SIZE;
+        Block = NextBlock + (BinEnd - FileBaseAddress - HBLOCK_SIZE);
+        FileBaseAddress = BinEnd;
     }
 
     // We either hit a discontinuity, OR, we're at the end of the range
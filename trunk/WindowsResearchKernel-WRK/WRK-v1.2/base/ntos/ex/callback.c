@@ -375,11 +375,17 @@ Return Value:
     PEX_CALLBACK_ROUTINE_BLOCK - Allocated block or NULL if allocation fails.
 */
 {
-    PEX_CALLBACK_ROUTINE_BLOCK NewBlock = ExAllocatePoolWithTag(PagedPool, sizeof(EX_CALLBACK_ROUTINE_BLOCK), 'brbC');
+    PEX_CALLBACK_ROUTINE_BLOCK NewBlock;
+    SIZE_T RundownSize;
+
+    // The rundown protection is per-processor so that callouts on different processors do not contend on a single reference count.
+    RundownSize = ExSizeOfRundownProtectionCacheAware();
+    NewBlock = ExAllocatePoolWithTag(PagedPool, sizeof(EX_CALLBACK_ROUTINE_BLOCK) + RundownSize, 'brbC');
     if (NewBlock != NULL) {
         NewBlock->Function = Function;
         NewBlock->Context = Context;
-        ExInitializeRundownProtection(&NewBlock->RundownProtect);
+        NewBlock->RundownProtect = (PEX_RUNDOWN_REF_CACHE_AWARE)(NewBlock + 1);
+        ExInitializeRundownProtectionCacheAware(NewBlock->RundownProtect, RundownSize);
     }
 
     return NewBlock;
@@ -406,7 +412,7 @@ Arguments:
     CallBackBlock - Call back block to wait for
 */
 {
-    ExWaitForRundownProtectionRelease(&CallBackBlock->RundownProtect);// Wait for all active callbacks to be finished.
+    ExWaitForRundownProtectionReleaseCacheAware(CallBackBlock->RundownProtect);// Wait for all active callbacks to be finished.
 }
 
 
@@ -428,7 +434,7 @@ Return Value:
     PEX_CALLBACK_ROUTINE_BLOCK ReplacedBlock;
 
     if (NewBlock != NULL) {// Add the additional references to the routine block
-        if (!ExAcquireRundownProtectionEx(&NewBlock->RundownProtect, ExFastRefGetAdditionalReferenceCount() + 1)) {
+        if (!ExAcquireRundownProtectionCacheAwareEx(NewBlock->RundownProtect, ExFastRefGetAdditionalReferenceCount() + 1)) {
             ASSERTMSG("Callback block is already undergoing rundown", FALSE);
             return FALSE;
         }
@@ -446,12 +452,12 @@ Return Value:
             KeEnterCriticalRegionThread(CurrentThread);
             ExAcquireReleasePushLockExclusive(&ExpCallBackFlush);
             KeLeaveCriticalRegionThread(CurrentThread);
-            ExReleaseRundownProtectionEx(&ReplacedBlock->RundownProtect, ExFastRefGetUnusedReferences(OldRef) + 1);
+            ExReleaseRundownProtectionCacheAwareEx(ReplacedBlock->RundownProtect, ExFastRefGetUnusedReferences(OldRef) + 1);
         }
         return TRUE;
     } else {// The swap failed. Remove the addition references if we had added any.
         if (NewBlock != NULL) {
-            ExReleaseRundownProtectionEx(&NewBlock->RundownProtect, ExFastRefGetAdditionalReferenceCount() + 1);
+            ExReleaseRundownProtectionCacheAwareEx(NewBlock->RundownProtect, ExFastRefGetAdditionalReferenceCount() + 1);
         }
         return FALSE;
     }
@@ -480,7 +486,7 @@ Return Value:
         KeEnterCriticalRegionThread(CurrentThread);
         ExAcquirePushLockExclusive(&ExpCallBackFlush);
         CallBackBlock = ExFastRefGetObject(CallBack->RoutineBlock);
-        if (CallBackBlock && !ExAcquireRundownProtection(&CallBackBlock->RundownProtect)) {
+        if (CallBackBlock && !ExAcquireRundownProtectionCacheAware(CallBackBlock->RundownProtect)) {
             CallBackBlock = NULL;
         }
         ExReleasePushLockExclusive(&ExpCallBackFlush);
@@ -493,9 +499,9 @@ Return Value:
         if (ExFastRefIsLastReference(OldRef) && !ExpCallBackReturnRefs) {// If we just removed the last reference then attempt fix it up.
             ULONG RefsToAdd;
             RefsToAdd = ExFastRefGetAdditionalReferenceCount();
-            if (ExAcquireRundownProtectionEx(&CallBackBlock->RundownProtect, RefsToAdd)) {// If we can't add the references then just give up
+            if (ExAcquireRundownProtectionCacheAwareEx(CallBackBlock->RundownProtect, RefsToAdd)) {// If we can't add the references then just give up
                 if (!ExFastRefAddAdditionalReferenceCounts(&CallBack->RoutineBlock, CallBackBlock, RefsToAdd)) {// Repopulate the cached refs. If this fails we just give them back.
-                    ExReleaseRundownProtectionEx(&CallBackBlock->RundownProtect, RefsToAdd);
+                    ExReleaseRundownProtectionCacheAwareEx(CallBackBlock->RundownProtect, RefsToAdd);
                 }
             }
         }
@@ -542,7 +548,7 @@ Arguments:
 */
 {
     if (ExpCallBackReturnRefs || !ExFastRefDereference(&CallBack->RoutineBlock, CallBackBlock)) {
-        ExReleaseRundownProtection(&CallBackBlock->RundownProtect);
+        ExReleaseRundownProtectionCacheAware(CallBackBlock->RundownProtect);
     }
 }
 
@@ -17,6 +17,7 @@ Abstract:
 PCALLBACK_OBJECT ExCbSetSystemTime;
 PCALLBACK_OBJECT ExCbSetSystemState;
 PCALLBACK_OBJECT ExCbPowerState;
+PCALLBACK_OBJECT ExCbMemoryPressure;
 
 #ifdef _PNP_POWER_
 WORK_QUEUE_ITEM ExpCheckSystemInfoWorkItem;// Work Item to scan SystemInformation levels
@@ -44,6 +45,7 @@ const EXP_INITIALIZE_GLOBAL_CALLBACKS  ExpInitializeCallback[] = {
     &ExCbSetSystemTime,             L"\\Callback\\SetSystemTime",
     &ExCbSetSystemState,            L"\\Callback\\SetSystemState",
     &ExCbPowerState,                L"\\Callback\\PowerState",
+    &ExCbMemoryPressure,            L"\\Callback\\MemoryPressure",
     NULL,                           NULL
 };
 
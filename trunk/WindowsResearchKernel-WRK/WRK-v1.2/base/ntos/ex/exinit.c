@@ -140,6 +140,8 @@ Return Value:
     BOOLEAN Initialized = TRUE;
     ULONG List;
     PGENERAL_LOOKASIDE Lookaside;
+    PGENERAL_LOOKASIDE NodeLookaside;
+    ULONG Node;
     PKPRCB Prcb;
 
     RtlInitializeAtomPackage('motA');// Initialize the ATOM package
@@ -199,10 +201,37 @@ Return Value:
         KdPrint(("Executive: Win32 initialization failed\n"));
     }
 
+    // On multinode systems, initialize per node paged and nonpaged pool lookaside lists for every node other than node 0.
+    // These replace the global pool lookaside lists as the second level lookaside lists of the processors in the node, so that
+    // entries freed on a node are reused on that node and the processors of different nodes do not contend on the same list heads.
+    for (Node = 1; Node < KeNumberNodes; Node += 1) {
+        Lookaside = ExAllocatePoolWithTag(NonPagedPool, sizeof(GENERAL_LOOKASIDE) * POOL_SMALL_LISTS * 2, 'LooP');
+        ExpNodePoolLookasideLists[Node] = Lookaside;
+        if (Lookaside != NULL) {
+            for (List = 0; List < POOL_SMALL_LISTS; List += 1) {
+                ExInitializeSystemLookasideList(Lookaside, NonPagedPool, (List + 1) * sizeof(POOL_BLOCK), 'LooP', 256, &ExPoolLookasideListHead);
+                Lookaside += 1;
+                ExInitializeSystemLookasideList(Lookaside, PagedPool, (List + 1) * sizeof(POOL_BLOCK), 'LooP', 256, &ExPoolLookasideListHead);
+                Lookaside += 1;
+            }
+        }
+    }
+
     // Initialize per processor paged and nonpaged pool lookaside lists.
     for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
         Prcb = KiProcessorBlock[Index];
 
+        // Point the second level lookaside lists at the lists of the processor's node if it has them.
+        NodeLookaside = ExpNodePoolLookasideLists[Prcb->ParentNode->NodeNumber];
+        if (NodeLookaside != NULL) {
+            for (List = 0; List < POOL_SMALL_LISTS; List += 1) {
+                Prcb->PPNPagedLookasideList[List].L = NodeLookaside;
+                NodeLookaside += 1;
+                Prcb->PPPagedLookasideList[List].L = NodeLookaside;
+                NodeLookaside += 1;
+            }
+        }
+
         // Allocate all of the lookaside list structures at once so they will be dense and aligned properly.
         Lookaside = ExAllocatePoolWithTag(NonPagedPool, sizeof(GENERAL_LOOKASIDE) * POOL_SMALL_LISTS * 2, 'LooP');
 
@@ -346,6 +375,7 @@ Arguments:
     Lookaside->Size = Size;
     Lookaside->LastTotalAllocates = 0;
     Lookaside->LastAllocateHits = 0;
+    RtlZeroMemory(EX_LOOKASIDE_TUNING(Lookaside), sizeof(LOOKASIDE_TUNING));
     InsertTailList(ListHead, &Lookaside->ListEntry);
 }
 
@@ -131,6 +131,7 @@ extern ERESOURCE ExpKeyManipLock;
 
 extern GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[POOL_SMALL_LISTS];
 extern GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[POOL_SMALL_LISTS];
+extern PGENERAL_LOOKASIDE ExpNodePoolLookasideLists[MAXIMUM_CCNUMA_NODES];
 
 extern LIST_ENTRY ExNPagedLookasideListHead;
 extern KSPIN_LOCK ExNPagedLookasideLock;
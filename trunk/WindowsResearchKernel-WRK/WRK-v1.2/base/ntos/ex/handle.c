@@ -96,6 +96,29 @@ ULONG CurrentSeq = 0;
 #define HIGHLEVEL_SIZE (HIGHLEVEL_COUNT * sizeof (PHANDLE_TABLE_ENTRY))
 #define LEVEL_CODE_MASK 3
 
+//  Each processor caches a few free handles of a table so that handles opened and closed on the same processor
+//  do not go through the free list head shared by all the processors.
+//  A slot holds a free handle value or zero, and is claimed with an interlocked exchange, so there is no A-B-A problem.
+#define HANDLE_FREE_CACHE_DEPTH 16
+
+typedef struct _HANDLE_FREE_BATCH {
+    ULONG Handles[HANDLE_FREE_CACHE_DEPTH];
+} HANDLE_FREE_BATCH, *PHANDLE_FREE_BATCH;
+
+typedef struct _HANDLE_TABLE_FREE_CACHE {
+    ULONG Processors;
+    ULONG Spare[HANDLE_FREE_CACHE_DEPTH - 1];
+    HANDLE_FREE_BATCH Batch[1];
+} HANDLE_TABLE_FREE_CACHE, *PHANDLE_TABLE_FREE_CACHE;
+
+#define HANDLE_FREE_CACHE_SIZE(Processors) (FIELD_OFFSET(HANDLE_TABLE_FREE_CACHE, Batch) + (Processors) * sizeof(HANDLE_FREE_BATCH))
+
+//  The free cache pointer of a table is set to this value if the cache could not be allocated
+#define HANDLE_FREE_CACHE_DISABLED ((PHANDLE_TABLE_FREE_CACHE)1)
+
+//  The summary bit for the low level table holding a handle value
+#define HANDLE_INHERIT_PAGE_BIT(HandleValue) (1UL << ((ULONG)((HandleValue) / (LOWLEVEL_COUNT * HANDLE_VALUE_INC)) % 32))
+
 //  Local support routines
 PHANDLE_TABLE ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL, IN BOOLEAN DoInit);
 VOID ExpFreeHandleTable(IN PHANDLE_TABLE HandleTable);
@@ -110,6 +133,8 @@ PHANDLE_TABLE_ENTRY ExpAllocateLowLevelTable(IN PHANDLE_TABLE HandleTable, IN BO
 VOID ExpFreeLowLevelTable(IN PEPROCESS QuotaProcess, IN PHANDLE_TABLE_ENTRY TableLevel1);
 VOID ExpBlockOnLockedHandleEntry(PHANDLE_TABLE HandleTable, PHANDLE_TABLE_ENTRY HandleTableEntry);
 ULONG ExpMoveFreeHandles(IN PHANDLE_TABLE HandleTable);
+BOOLEAN ExpFreeHandleToCache(IN PHANDLE_TABLE HandleTable, IN ULONG Handle);
+ULONG ExpAllocateHandleFromCache(IN PHANDLE_TABLE HandleTable, IN BOOLEAN AnyProcessor);
 VOID ExpUpdateDebugInfo(PHANDLE_TABLE HandleTable, PETHREAD CurrentThread, HANDLE Handle, ULONG Type);
 PVOID ExpAllocateTablePagedPoolNoZero(IN PEPROCESS QuotaProcess OPTIONAL, IN SIZE_T NumberOfBytes);
 
@@ -128,6 +153,7 @@ PVOID ExpAllocateTablePagedPoolNoZero(IN PEPROCESS QuotaProcess OPTIONAL, IN SIZ
 #pragma alloc_text(PAGE, ExChangeHandle)
 #pragma alloc_text(PAGE, ExMapHandleToPointer)
 #pragma alloc_text(PAGE, ExMapHandleToPointerEx)
+#pragma alloc_text(PAGE, ExReadHandleTableEntry)
 #pragma alloc_text(PAGE, ExpAllocateHandleTable)
 #pragma alloc_text(PAGE, ExpFreeHandleTable)
 #pragma alloc_text(PAGE, ExpAllocateHandleTableEntry)
@@ -135,6 +161,7 @@ PVOID ExpAllocateTablePagedPoolNoZero(IN PEPROCESS QuotaProcess OPTIONAL, IN SIZ
 #pragma alloc_text(PAGE, ExpFreeHandleTableEntry)
 #pragma alloc_text(PAGE, ExpLookupHandleTableEntry)
 #pragma alloc_text(PAGE, ExSweepHandleTable)
+#pragma alloc_text(PAGE, ExSweepHandleTablePartition)
 #pragma alloc_text(PAGE, ExpAllocateMidLevelTable)
 #pragma alloc_text(PAGE, ExpAllocateTablePagedPool)
 #pragma alloc_text(PAGE, ExpAllocateTablePagedPoolNoZero)
@@ -146,6 +173,8 @@ PVOID ExpAllocateTablePagedPoolNoZero(IN PEPROCESS QuotaProcess OPTIONAL, IN SIZ
 #pragma alloc_text(PAGE, ExpFreeLowLevelTable)
 #pragma alloc_text(PAGE, ExpBlockOnLockedHandleEntry)
 #pragma alloc_text(PAGE, ExpMoveFreeHandles)
+#pragma alloc_text(PAGE, ExpFreeHandleToCache)
+#pragma alloc_text(PAGE, ExpAllocateHandleFromCache)
 #pragma alloc_text(PAGE, ExEnableHandleTracing)
 #pragma alloc_text(PAGE, ExDereferenceHandleDebugInfo)
 #pragma alloc_text(PAGE, ExReferenceHandleDebugInfo)
@@ -209,6 +238,36 @@ Return Value:
 }
 
 
+FORCEINLINE VOID ExpNoteInheritableEntry(IN PHANDLE_TABLE HandleTable, IN EXHANDLE Handle, IN ULONG_PTR OldValue, IN ULONG_PTR NewValue)
+/*
+Routine Description:
+    This routine keeps the inheritable entry count and summary of a table up to date when an entry changes.
+Arguments:
+    HandleTable - Supplies the handle table containing the entry.
+    Handle - Supplies the handle of the entry.
+    OldValue - Supplies the previous value of the entry, zero if it was free.
+    NewValue - Supplies the new value of the entry, zero if it is being freed.
+*/
+{
+    ULONG PageBit;
+
+    if ((OldValue & OBJ_INHERIT) == (NewValue & OBJ_INHERIT)) {
+        return;
+    }
+
+    if (NewValue & OBJ_INHERIT) {
+        PageBit = HANDLE_INHERIT_PAGE_BIT(Handle.Value);
+        if ((HandleTable->InheritablePages & PageBit) == 0) {
+            InterlockedOr((PLONG)&HandleTable->InheritablePages, PageBit);
+        }
+
+        InterlockedIncrement(&HandleTable->InheritableCount);
+    } else {
+        InterlockedDecrement(&HandleTable->InheritableCount);
+    }
+}
+
+
 ULONG ExpMoveFreeHandles(IN PHANDLE_TABLE HandleTable)
 {
     ULONG OldValue, NewValue;
@@ -270,6 +329,121 @@ ULONG ExpMoveFreeHandles(IN PHANDLE_TABLE HandleTable)
 }
 
 
+BOOLEAN ExpFreeHandleToCache(IN PHANDLE_TABLE HandleTable, IN ULONG Handle)
+/*
+Routine Description:
+    This routine places a free handle in the free cache of the current processor.
+    The cache is allocated on the first free once the system has more than one processor.
+Arguments:
+    HandleTable - Supplies the handle table the handle belongs to.
+    Handle - Supplies the handle value being freed.
+Return Value:
+    TRUE if the handle was cached, and FALSE if it must be pushed on the free list.
+*/
+{
+    PHANDLE_TABLE_FREE_CACHE Cache;
+    PHANDLE_TABLE_FREE_CACHE NewCache;
+    ULONG Number;
+    ULONG Processors;
+    PULONG Slots;
+    ULONG i;
+
+    Cache = HandleTable->FreeCache;
+    if (Cache == NULL) {
+        Processors = (ULONG)KeNumberProcessors;
+        if (Processors == 1) {
+            return FALSE;
+        }
+
+        //  If we can't get pool or quota for the cache then we don't try again for this table.
+        NewCache = ExpAllocateTablePagedPool(HandleTable->QuotaProcess, HANDLE_FREE_CACHE_SIZE(Processors));
+        if (NewCache != NULL) {
+            NewCache->Processors = Processors;
+        } else {
+            NewCache = HANDLE_FREE_CACHE_DISABLED;
+        }
+
+        Cache = InterlockedCompareExchangePointer((PVOID *)&HandleTable->FreeCache, NewCache, NULL);
+        if (Cache == NULL) {
+            Cache = NewCache;
+        } else if (NewCache != HANDLE_FREE_CACHE_DISABLED) {
+            ExpFreeTablePagedPool(HandleTable->QuotaProcess, NewCache, HANDLE_FREE_CACHE_SIZE(Processors));
+        }
+    }
+
+    if (Cache == HANDLE_FREE_CACHE_DISABLED) {
+        return FALSE;
+    }
+
+    //  Processors that started after the cache was allocated just use the free list.
+    Number = KeGetCurrentProcessorNumber();
+    if (Number >= Cache->Processors) {
+        return FALSE;
+    }
+
+    Slots = Cache->Batch[Number].Handles;
+    for (i = 0; i < HANDLE_FREE_CACHE_DEPTH; i += 1) {
+        if ((Slots[i] == 0) && (InterlockedCompareExchange((PLONG)&Slots[i], Handle, 0) == 0)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+ULONG ExpAllocateHandleFromCache(IN PHANDLE_TABLE HandleTable, IN BOOLEAN AnyProcessor)
+/*
+Routine Description:
+    This routine takes a free handle out of the free cache of the current processor.
+Arguments:
+    HandleTable - Supplies the handle table being allocated from.
+    AnyProcessor - If TRUE the caches of all the processors are searched.
+                   This is used when the table can't be expanded so that no free handle is left stranded in a cache.
+Return Value:
+    The handle value taken from the cache, or zero if there was none.
+*/
+{
+    PHANDLE_TABLE_FREE_CACHE Cache;
+    ULONG Handle;
+    ULONG Last;
+    ULONG Number;
+    PULONG Slots;
+    ULONG i;
+
+    Cache = HandleTable->FreeCache;
+    if ((Cache == NULL) || (Cache == HANDLE_FREE_CACHE_DISABLED)) {
+        return 0;
+    }
+
+    if (AnyProcessor) {
+        Number = 0;
+        Last = Cache->Processors;
+    } else {
+        Number = KeGetCurrentProcessorNumber();
+        if (Number >= Cache->Processors) {
+            return 0;
+        }
+
+        Last = Number + 1;
+    }
+
+    for (; Number < Last; Number += 1) {
+        Slots = Cache->Batch[Number].Handles;
+        for (i = 0; i < HANDLE_FREE_CACHE_DEPTH; i += 1) {
+            if (Slots[i] != 0) {
+                Handle = InterlockedExchange((PLONG)&Slots[i], 0);
+                if (Handle != 0) {
+                    return Handle;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+
 PHANDLE_TABLE_ENTRY ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable, OUT PEXHANDLE pHandle)
 /*
 Routine Description:
@@ -289,6 +463,17 @@ Return Value:
     BOOLEAN RetVal;
     ULONG Idx;
 
+    //  Try the free cache of this processor before the free list shared by all the processors.
+    if (!HandleTable->StrictFIFO) {
+        Handle.Value = ExpAllocateHandleFromCache(HandleTable, FALSE);
+        if (Handle.Value != 0) {
+            Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+            InterlockedIncrement(&HandleTable->HandleCount);
+            *pHandle = Handle;
+            return Entry;
+        }
+    }
+
     CurrentThread = KeGetCurrentThread();
     while (1) {
         OldValue = HandleTable->FirstFree;
@@ -319,8 +504,17 @@ Return Value:
 
             // If ExpAllocateHandleTableEntrySlow had a failed allocation then we want to fail the call.
             // We check for free entries before we exit just in case they got allocated or freed by somebody else in the gap.
+            // Handles cached by other processors are free too so we take one of those before we give up.
             if (!RetVal) {
                 if (OldValue == 0) {
+                    Handle.Value = ExpAllocateHandleFromCache(HandleTable, TRUE);
+                    if (Handle.Value != 0) {
+                        Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+                        InterlockedIncrement(&HandleTable->HandleCount);
+                        *pHandle = Handle;
+                        return Entry;
+                    }
+
                     pHandle->GenericHandleOverlay = NULL;
                     return NULL;
                 }
@@ -553,26 +747,57 @@ Arguments:
     EnumHandleProcedure - Supplies a pointer to a function to call for each valid handle in the enumerated handle table.
     EnumParameter - Supplies an uninterpreted 32-bit value that is passed to the EnumHandleProcedure each time it is called.
 */
+{
+    ULONG Partition;
+
+    PAGED_CODE();
+
+    //  Iterate through the handle table one low level table at a time.
+    //  Note that this loop exits when we get to a low level table that doesn't exist.
+    //  We know there will be no more possible entries after that because we allocate memory of the handles in a dense fashion.
+    for (Partition = 0; ExSweepHandleTablePartition(HandleTable, Partition, EnumHandleProcedure, EnumParameter); Partition += 1) {
+        NOTHING;
+    }
+}
+
+
+NTKERNELAPI BOOLEAN ExSweepHandleTablePartition(__in PHANDLE_TABLE HandleTable,
+                                                __in ULONG Partition,
+                                                __in EX_ENUMERATE_HANDLE_ROUTINE EnumHandleProcedure,
+                                                __in PVOID EnumParameter)
+/*
+Routine Description:
+    This function sweeps the handles of one low level table of a handle table in a unsynchronized manner.
+    Different partitions may be swept by different threads at the same time, as long as no handles are being created in the table.
+Arguments:
+    HandleTable - Supplies a pointer to a handle table
+    Partition - Supplies the index of the low level table to sweep
+    EnumHandleProcedure - Supplies a pointer to a function to call for each valid handle in the partition.
+    EnumParameter - Supplies an uninterpreted 32-bit value that is passed to the EnumHandleProcedure each time it is called.
+Return Value:
+    FALSE if the partition lies beyond the end of the handle table, TRUE otherwise.
+*/
 {
     EXHANDLE Handle;
     PHANDLE_TABLE_ENTRY HandleTableEntry;
 
     PAGED_CODE();
 
-    //  Iterate through the handle table and for each handle that is allocated we'll invoke the call back.
-    //  Note that this loop exits when we get a null handle table entry.
-    //  We know there will be no more possible entries after the first null one is encountered because we allocate memory of the handles in a dense fashion.
-    Handle.Value = HANDLE_VALUE_INC;
-    while ((HandleTableEntry = ExpLookupHandleTableEntry(HandleTable, Handle)) != NULL) {
-        do {
-            if (ExpLockHandleTableEntry(HandleTable, HandleTableEntry)) {//  Only do the callback if the entry is not free
-                (*EnumHandleProcedure)(HandleTableEntry, Handle.GenericHandleOverlay, EnumParameter);
-            }
-            Handle.Value += HANDLE_VALUE_INC;
-            HandleTableEntry++;
-        } while ((Handle.Value % (LOWLEVEL_COUNT * HANDLE_VALUE_INC)) != 0);
-        Handle.Value += HANDLE_VALUE_INC;// Skip past the first entry that's not a real entry
+    Handle.Value = (ULONG_PTR)Partition * (LOWLEVEL_COUNT * HANDLE_VALUE_INC) + HANDLE_VALUE_INC;// Skip past the first entry that's not a real entry
+    HandleTableEntry = ExpLookupHandleTableEntry(HandleTable, Handle);
+    if (HandleTableEntry == NULL) {
+        return FALSE;
     }
+
+    do {
+        if (ExpLockHandleTableEntry(HandleTable, HandleTableEntry)) {//  Only do the callback if the entry is not free
+            (*EnumHandleProcedure)(HandleTableEntry, Handle.GenericHandleOverlay, EnumParameter);
+        }
+        Handle.Value += HANDLE_VALUE_INC;
+        HandleTableEntry++;
+    } while ((Handle.Value % (LOWLEVEL_COUNT * HANDLE_VALUE_INC)) != 0);
+
+    return TRUE;
 }
 
 
@@ -660,11 +885,29 @@ NTKERNELAPI PHANDLE_TABLE ExDupHandleTable(
     PHANDLE_TABLE_ENTRY NewHandleTableEntry;
     BOOLEAN FreeEntry;
     NTSTATUS Status;
+    BOOLEAN InheritOnly;
 
     PAGED_CODE();
 
     CurrentThread = KeGetCurrentThread();
 
+    //  When only inheritable entries are duplicated the inheritable summary of the old table tells us which parts to look at.
+    //  If the old table has no inheritable entries at all then the new table is just an empty one.
+    InheritOnly = (BOOLEAN)(Mask == OBJ_INHERIT);
+    if (InheritOnly && (OldHandleTable->InheritableCount == 0)) {
+        NewHandleTable = ExpAllocateHandleTable(Process, TRUE);
+        if (NewHandleTable == NULL) {
+            return NULL;
+        }
+
+        KeEnterCriticalRegionThread(CurrentThread);
+        ExAcquirePushLockExclusive(&HandleTableListLock);
+        InsertTailList(&HandleTableListHead, &NewHandleTable->HandleTableList);
+        ExReleasePushLockExclusive(&HandleTableListLock);
+        KeLeaveCriticalRegionThread(CurrentThread);
+        return NewHandleTable;
+    }
+
     NewHandleTable = ExpAllocateHandleTable(Process, FALSE);//  First allocate a new handle table. 
     if (NewHandleTable == NULL) {
         return NULL;// If this fails then return immediately to our caller
@@ -693,6 +936,20 @@ NTKERNELAPI PHANDLE_TABLE ExDupHandleTable(
     Handle.Value = HANDLE_VALUE_INC;
     KeEnterCriticalRegionThread(CurrentThread);
     while ((NewHandleTableEntry = ExpLookupHandleTableEntry(NewHandleTable, Handle)) != NULL) {
+        //  If no entry of this low level table can be inheritable then all the new entries are free and the old ones need not be read.
+        if (InheritOnly && ((OldHandleTable->InheritablePages & HANDLE_INHERIT_PAGE_BIT(Handle.Value)) == 0)) {
+            do {
+                NewHandleTableEntry->Object = NULL;
+                NewHandleTableEntry->NextFreeTableEntry = NewHandleTable->FirstFree;
+                NewHandleTable->FirstFree = (ULONG)Handle.Value;
+                Handle.Value += HANDLE_VALUE_INC;
+                NewHandleTableEntry++;
+            } while ((Handle.Value % (LOWLEVEL_COUNT * HANDLE_VALUE_INC)) != 0);
+
+            Handle.Value += HANDLE_VALUE_INC; // Skip past the first entry thats not a real entry
+            continue;
+        }
+
         OldHandleTableEntry = ExpLookupHandleTableEntry(OldHandleTable, Handle);// Lookup the old entry.
         do {
             //  If the old entry is free then simply copy over the entire old entry to the new entry.  The lock command will tell us if the entry is free.
@@ -723,6 +980,7 @@ NTKERNELAPI PHANDLE_TABLE ExDupHandleTable(
                         // Since there is no route to the new table yet we can just clear the lock bit
                         NewHandleTableEntry->Value |= EXHANDLE_TABLE_ENTRY_LOCK_BIT;
                         NewHandleTable->HandleCount += 1;
+                        ExpNoteInheritableEntry(NewHandleTable, Handle, 0, NewHandleTableEntry->Value);
                         FreeEntry = FALSE;
                     } else {
                         if (EntryInfo) {
@@ -916,6 +1174,7 @@ Return Value:
         // We are about to create a locked entry so protect against suspension
         KeEnterCriticalRegionThread(&CurrentThread->Tcb);
         *NewHandleTableEntry = *HandleTableEntry;
+        ExpNoteInheritableEntry(HandleTable, Handle, 0, HandleTableEntry->Value);
 
         if (HandleTable->DebugInfo != NULL) {// If we are debugging handle operations then save away the details
             ExpUpdateDebugInfo(HandleTable, CurrentThread, Handle.GenericHandleOverlay, HANDLE_TRACE_DB_OPEN);
@@ -976,6 +1235,7 @@ Return Value:
     Object = InterlockedExchangePointer(&HandleTableEntry->Object, NULL);
     EXASSERT(Object != NULL);
     EXASSERT((((ULONG_PTR)Object)&EXHANDLE_TABLE_ENTRY_LOCK_BIT) == 0);
+    ExpNoteInheritableEntry(HandleTable, LocalHandle, (ULONG_PTR)Object, 0);
 
     // Unblock any waiters waiting for this table entry.
     ExUnblockPushLock(&HandleTable->HandleContentionEvent, NULL);
@@ -1003,6 +1263,7 @@ Return Value:
 
     PHANDLE_TABLE_ENTRY HandleTableEntry;
     BOOLEAN ReturnValue;
+    ULONG_PTR OldValue;
 
     PAGED_CODE();
 
@@ -1020,7 +1281,9 @@ Return Value:
     //  Make sure we can't get suspended and then invoke the callback
     KeEnterCriticalRegionThread(CurrentThread);
     if (ExpLockHandleTableEntry(HandleTable, HandleTableEntry)) {
+        OldValue = HandleTableEntry->Value;
         ReturnValue = (*ChangeRoutine)(HandleTableEntry, Parameter);
+        ExpNoteInheritableEntry(HandleTable, LocalHandle, OldValue, HandleTableEntry->Value);
         ExUnlockHandleTableEntry(HandleTable, HandleTableEntry);
     } else {
         ReturnValue = FALSE;
@@ -1128,6 +1391,53 @@ Return Value:
 }
 
 
+NTKERNELAPI PHANDLE_TABLE_ENTRY ExReadHandleTableEntry(__in PHANDLE_TABLE HandleTable, __in HANDLE Handle, __out PHANDLE_TABLE_ENTRY Snapshot)
+/*
+Routine Description:
+    This function maps a handle to a pointer to a handle table entry and captures the contents of the entry without locking it.
+    The entry is never written, so any number of threads can read the same entry without contending for its cache line.
+    N.B. The captured contents are only a snapshot. The caller must compare the entry against the snapshot
+         after it has used the snapshot to decide that the entry is still the same.
+Arguments:
+    HandleTable - Supplies a pointer to a handle table.
+    Handle - Supplies the handle to be mapped to a handle entry.
+    Snapshot - Receives the contents of the handle table entry.
+Return Value:
+    If the handle maps to an entry that is in use and not locked,
+    then the address of the handle table entry is returned as the function value with the entry unlocked.
+    Otherwise, a value of NULL is returned and the caller must use ExMapHandleToPointer to resolve the handle.
+*/
+{
+    EXHANDLE LocalHandle;
+    PHANDLE_TABLE_ENTRY HandleTableEntry;
+
+    PAGED_CODE();
+
+    LocalHandle.GenericHandleOverlay = Handle;
+
+    if ((LocalHandle.Index & (LOWLEVEL_COUNT - 1)) == 0) {
+        return NULL;
+    }
+
+    //  Table pages are never freed while the table exists, so the entry can be read without any lock.
+    HandleTableEntry = ExpLookupHandleTableEntry(HandleTable, LocalHandle);
+    if (HandleTableEntry == NULL) {
+        return NULL;
+    }
+
+    Snapshot->Value = *(volatile ULONG_PTR *)&HandleTableEntry->Value;
+    KeMemoryBarrier();
+    Snapshot->GrantedAccess = *(volatile ACCESS_MASK *)&HandleTableEntry->GrantedAccess;
+
+    //  A locked entry is being changed and a free entry has no object, so both are left to the locked path.
+    if ((Snapshot->Value & EXHANDLE_TABLE_ENTRY_LOCK_BIT) == 0) {
+        return NULL;
+    }
+
+    return HandleTableEntry;
+}
+
+
 //  Local Support Routine
 
 
@@ -1542,6 +1852,10 @@ Arguments:
         ExDereferenceHandleDebugInfo(HandleTable, HandleTable->DebugInfo);
     }
 
+    if ((HandleTable->FreeCache != NULL) && (HandleTable->FreeCache != HANDLE_FREE_CACHE_DISABLED)) {// Free the per processor free handle caches
+        ExpFreeTablePagedPool(Process, HandleTable->FreeCache, HANDLE_FREE_CACHE_SIZE(HandleTable->FreeCache->Processors));
+    }
+
     //  Finally deallocate the handle table itself
     ExFreePool(HandleTable);
     if (Process != NULL) {
@@ -1834,6 +2148,12 @@ Arguments:
 #endif //DBG
 
         if (!HandleTable->StrictFIFO) {
+            // Keep the handle on this processor if there is room in its free cache.
+            HandleTableEntry->NextFreeTableEntry = 0;
+            if (ExpFreeHandleToCache(HandleTable, NewFree)) {
+                return;
+            }
+
             // We are pushing potentially old entries onto the free list.
             // Prevent the A-B-A problem by shifting to an alternate list read this element has the list head out of the loop.
             Idx = (NewFree >> 2) % HANDLE_TABLE_LOCKS;
@@ -20,31 +20,49 @@ Abstract:
 #pragma alloc_text(PAGE, NtReleaseKeyedEvent)
 #pragma alloc_text(PAGE, NtWaitForKeyedEvent)
 
-// Define the keyed event object type
-typedef struct _KEYED_EVENT_OBJECT
+// Define the keyed event object type.
+// Waiters are hashed by key and process into independently locked buckets so that unrelated keys do not contend on one lock and one list.
+#define KEYED_EVENT_HASH_BUCKETS 128
+
+typedef struct _KEYED_EVENT_BUCKET
 {
     EX_PUSH_LOCK Lock;
     LIST_ENTRY WaitQueue;
+} KEYED_EVENT_BUCKET, * PKEYED_EVENT_BUCKET;
+
+typedef struct _KEYED_EVENT_OBJECT
+{
+    KEYED_EVENT_BUCKET HashTable[KEYED_EVENT_HASH_BUCKETS];
 } KEYED_EVENT_OBJECT, * PKEYED_EVENT_OBJECT;
 
+// Keys are usually the addresses of user mode locks so the low bits carry little information.
+// The process is part of the hash since waiters and releasers only ever match within the same process.
+#define KEYED_EVENT_HASH(xxxKeyValue,xxxProcess)                     \
+    ((((ULONG_PTR)(xxxKeyValue) >> 3) ^                              \
+      ((ULONG_PTR)(xxxKeyValue) >> 10) ^                             \
+      ((ULONG_PTR)(xxxProcess) >> 6)) & (KEYED_EVENT_HASH_BUCKETS - 1))
+
+#define KEYED_EVENT_HASH_BUCKET(xxxKeyedEventObject,xxxKeyValue,xxxProcess) \
+    (&(xxxKeyedEventObject)->HashTable[KEYED_EVENT_HASH(xxxKeyValue, xxxProcess)])
+
 POBJECT_TYPE ExpKeyedEventObjectType;
 
 // The low bit of the keyvalue signifies that we are a release thread waiting for the wait thread to enter the keyed event code.
 
 #define KEYVALUE_RELEASE 1
 
-#define LOCK_KEYED_EVENT_EXCLUSIVE(xxxKeyedEventObject,xxxCurrentThread) { \
+#define LOCK_KEYED_EVENT_EXCLUSIVE(xxxKeyedEventBucket,xxxCurrentThread) { \
     KeEnterCriticalRegionThread (&(xxxCurrentThread)->Tcb);                \
-    ExAcquirePushLockExclusive (&(xxxKeyedEventObject)->Lock);             \
+    ExAcquirePushLockExclusive (&(xxxKeyedEventBucket)->Lock);             \
 }
 
-#define UNLOCK_KEYED_EVENT_EXCLUSIVE(xxxKeyedEventObject,xxxCurrentThread) { \
-    ExReleasePushLockExclusive (&(xxxKeyedEventObject)->Lock);               \
+#define UNLOCK_KEYED_EVENT_EXCLUSIVE(xxxKeyedEventBucket,xxxCurrentThread) { \
+    ExReleasePushLockExclusive (&(xxxKeyedEventBucket)->Lock);               \
     KeLeaveCriticalRegionThread (&(xxxCurrentThread)->Tcb);                  \
 }
 
-#define UNLOCK_KEYED_EVENT_EXCLUSIVE_UNSAFE(xxxKeyedEventObject) { \
-    ExReleasePushLockExclusive (&(xxxKeyedEventObject)->Lock);     \
+#define UNLOCK_KEYED_EVENT_EXCLUSIVE_UNSAFE(xxxKeyedEventBucket) { \
+    ExReleasePushLockExclusive (&(xxxKeyedEventBucket)->Lock);     \
 }
 
 
@@ -154,6 +172,7 @@ Return Value:
     NTSTATUS Status;
     PKEYED_EVENT_OBJECT KeyedEventObject;
     HANDLE Handle;
+    ULONG Index;
     KPROCESSOR_MODE PreviousMode;
 
     // Get previous processor mode and probe output arguments if necessary.
@@ -179,9 +198,11 @@ Return Value:
         return Status;
     }
 
-    // Initialize the lock and wait queue
-    ExInitializePushLock(&KeyedEventObject->Lock);
-    InitializeListHead(&KeyedEventObject->WaitQueue);
+    // Initialize the lock and wait queue of each hash bucket
+    for (Index = 0; Index < KEYED_EVENT_HASH_BUCKETS; Index++) {
+        ExInitializePushLock(&KeyedEventObject->HashTable[Index].Lock);
+        InitializeListHead(&KeyedEventObject->HashTable[Index].WaitQueue);
+    }
 
     // Insert the object into the handle table
     Status = ObInsertObject(KeyedEventObject, NULL, DesiredAccess, 0, NULL, &Handle);
@@ -262,6 +283,7 @@ Return Value:
     NTSTATUS Status;
     KPROCESSOR_MODE PreviousMode;
     PKEYED_EVENT_OBJECT KeyedEventObject;
+    PKEYED_EVENT_BUCKET KeyedEventBucket;
     PETHREAD CurrentThread, TargetThread;
     PEPROCESS CurrentProcess;
     PLIST_ENTRY ListHead, ListEntry;
@@ -297,9 +319,10 @@ Return Value:
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
     CurrentThread->KeyedEventInUse = 1;
     CurrentProcess = PsGetCurrentProcessByThread(CurrentThread);
-    ListHead = &KeyedEventObject->WaitQueue;
+    KeyedEventBucket = KEYED_EVENT_HASH_BUCKET(KeyedEventObject, KeyValue, CurrentProcess);
+    ListHead = &KeyedEventBucket->WaitQueue;
 
-    LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventObject, CurrentThread);
+    LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventBucket, CurrentThread);
     ListEntry = ListHead->Flink;
     while (1) {
         if (ListEntry == ListHead) {
@@ -309,7 +332,7 @@ Return Value:
             OldKeyValue = CurrentThread->KeyedWaitValue;
             CurrentThread->KeyedWaitValue = (PVOID)(((ULONG_PTR)KeyValue) | KEYVALUE_RELEASE);
 
-            // Insert the thread at the head of the list.
+            // Insert the thread at the head of the bucket list.
             // We establish an invariant were release waiters are always at the front of the queue to improve the wait code since it only has to search as far as the first non-release waiter.
             InsertHeadList(ListHead, &CurrentThread->KeyedWaitChain);
             TargetThread = NULL;
@@ -327,7 +350,7 @@ Return Value:
 
     // Release the lock but leave APC's disabled.
     // This prevents us from being suspended and holding up the target.
-    UNLOCK_KEYED_EVENT_EXCLUSIVE_UNSAFE(KeyedEventObject);
+    UNLOCK_KEYED_EVENT_EXCLUSIVE_UNSAFE(KeyedEventBucket);
     if (TargetThread != NULL) {
         KeReleaseSemaphore(&TargetThread->KeyedWaitSemaphore, SEMAPHORE_INCREMENT, 1, FALSE);
         KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
@@ -337,13 +360,13 @@ Return Value:
         if (Status != STATUS_SUCCESS) {// If we were woken by termination then we must manually remove ourselves from the queue
             BOOLEAN Wait = TRUE;
 
-            LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventObject, CurrentThread);
+            LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventBucket, CurrentThread);
             if (!IsListEmpty(&CurrentThread->KeyedWaitChain)) {
                 RemoveEntryList(&CurrentThread->KeyedWaitChain);
                 InitializeListHead(&CurrentThread->KeyedWaitChain);
                 Wait = FALSE;
             }
-            UNLOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventObject, CurrentThread);
+            UNLOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventBucket, CurrentThread);
 
             if (Wait) {// If this thread was no longer in the queue then another thread must be about to wake us up. Wait for that wake.
                 KeWaitForSingleObject(&CurrentThread->KeyedWaitSemaphore, Executive, KernelMode, FALSE, NULL);
@@ -375,6 +398,7 @@ Return Value:
     NTSTATUS Status;
     KPROCESSOR_MODE PreviousMode;
     PKEYED_EVENT_OBJECT KeyedEventObject;
+    PKEYED_EVENT_BUCKET KeyedEventBucket;
     PETHREAD CurrentThread, TargetThread;
     PEPROCESS CurrentProcess;
     PLIST_ENTRY ListHead, ListEntry;
@@ -410,9 +434,10 @@ Return Value:
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
     CurrentThread->KeyedEventInUse = 1;
     CurrentProcess = PsGetCurrentProcessByThread(CurrentThread);
-    ListHead = &KeyedEventObject->WaitQueue;
+    KeyedEventBucket = KEYED_EVENT_HASH_BUCKET(KeyedEventObject, KeyValue, CurrentProcess);
+    ListHead = &KeyedEventBucket->WaitQueue;
 
-    LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventObject, CurrentThread);
+    LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventBucket, CurrentThread);
     ListEntry = ListHead->Flink;
     while (1) {
         TargetThread = CONTAINING_RECORD(ListEntry, ETHREAD, KeyedWaitChain);
@@ -439,7 +464,7 @@ Return Value:
 
     // Release the lock but leave APC's disabled.
     // This prevents us from being suspended and holding up the target.
-    UNLOCK_KEYED_EVENT_EXCLUSIVE_UNSAFE(KeyedEventObject);
+    UNLOCK_KEYED_EVENT_EXCLUSIVE_UNSAFE(KeyedEventBucket);
 
     if (TargetThread == NULL) {
         KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
@@ -447,13 +472,13 @@ Return Value:
         if (Status != STATUS_SUCCESS) {// If we were woken by termination then we must manually remove ourselves from the queue
             BOOLEAN Wait = TRUE;
 
-            LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventObject, CurrentThread);
+            LOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventBucket, CurrentThread);
             if (!IsListEmpty(&CurrentThread->KeyedWaitChain)) {
                 RemoveEntryList(&CurrentThread->KeyedWaitChain);
                 InitializeListHead(&CurrentThread->KeyedWaitChain);
                 Wait = FALSE;
             }
-            UNLOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventObject, CurrentThread);
+            UNLOCK_KEYED_EVENT_EXCLUSIVE(KeyedEventBucket, CurrentThread);
 
 
             if (Wait) {// If this thread was no longer in the queue then another thread must be about to wake us up. Wait for that wake.
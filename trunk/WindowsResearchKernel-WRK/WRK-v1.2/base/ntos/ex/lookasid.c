@@ -17,12 +17,17 @@ Abstract:
 
 #define MINIMUM_LOOKASIDE_DEPTH 4// Define Minimum lookaside list depth.
 #define MINIMUM_ALLOCATION_THRESHOLD 25// Define minimum allocation threshold.
+#define MAXIMUM_DEPTH_INCREMENT 30// Define maximum depth increment per scan period.
+#define BURST_MISS_RATIO 100// Define miss ratio (per thousand) above which the depth is raised by half the remaining headroom.
+#define LOOKASIDE_TRIM_THRESHOLD ((8 * 1024 * 1024) / PAGE_SIZE)// Define available page threshold below which lookaside lists are trimmed.
 
 // Define forward referenced function prototypes.
 
 PVOID ExpDummyAllocate(IN POOL_TYPE PoolType, IN SIZE_T NumberOfBytes, IN ULONG Tag);
 VOID ExpScanGeneralLookasideList(IN PLIST_ENTRY ListHead, IN PKSPIN_LOCK SpinLock);
 VOID ExpScanSystemLookasideList(VOID);
+VOID ExpTrimLookasideLists(VOID);
+VOID ExpFreeObjectCacheEntry(IN PVOID Buffer);
 
 // Define the global nonpaged and paged lookaside list data.
 LIST_ENTRY ExNPagedLookasideListHead;
@@ -39,6 +44,19 @@ ULONG ExpScanCount = 0;
 // Lookasides are disabled (via the variable below) when the verifier is on.
 USHORT ExMinimumLookasideDepth = MINIMUM_LOOKASIDE_DEPTH;
 
+// Define lookaside list memory pressure data.
+PFN_NUMBER ExLookasideTrimThreshold = LOOKASIDE_TRIM_THRESHOLD;
+BOOLEAN ExpLookasidePressure = FALSE;
+
+// Define the header that precedes each object cache entry.
+
+// N.B. The list entry is only used while the entry is cached. The owning cache and oversized indicator are preserved, so entries freed by the lookaside trim can be destructed.
+typedef struct DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) _EX_OBJECT_CACHE_ENTRY {
+    SLIST_ENTRY ListEntry;
+    PEX_OBJECT_CACHE Cache;
+    ULONG_PTR Oversized;
+} EX_OBJECT_CACHE_ENTRY, * PEX_OBJECT_CACHE_ENTRY;
+
 
 VOID ExAdjustLookasideDepth(VOID)
 /*
@@ -46,6 +64,13 @@ Routine Description:
     This function is called periodically to adjust the maximum depth of all lookaside lists.
 */
 {
+    // If available memory is below the trim threshold, then lower the depth of all lookaside lists and return the excess entries to pool.
+    // The depth of each list is then held down by the periodic scan until available memory recovers.
+    ExpLookasidePressure = (BOOLEAN)(MmAvailablePages < ExLookasideTrimThreshold);
+    if (ExpLookasidePressure != FALSE) {
+        ExpTrimLookasideLists();
+    }
+
     // Switch on the current scan count.
     switch (ExpScanCount) {
 
@@ -90,17 +115,39 @@ Arguments:
     USHORT MaximumDepth;
     ULONG Ratio;
     LONG Target;
+    PLOOKASIDE_TUNING Tuning;
 
     // Compute the total number of allocations and misses per second for this scan period.
     Allocates = Lookaside->TotalAllocates - Lookaside->LastTotalAllocates;
     Lookaside->LastTotalAllocates = Lookaside->TotalAllocates;
 
-    // If the verifier is enabled, disable lookasides so driver problems can be isolated. Otherwise, compute the target lookaside list depth.
+    // Compute the miss ratio in tenths of a percent.
+
+    // N.B. It is possible that the number of misses are greater than the number of allocates, but this won't cause the an incorrect computation of the depth adjustment.
+    Ratio = 0;
+    if (Allocates != 0) {
+        Ratio = (Misses * 1000) / Allocates;
+    }
+
+    // Record the miss ratio and the depth of the last scan period in the tuning history of the lookaside list.
+    Tuning = EX_LOOKASIDE_TUNING(Lookaside);
+    Tuning->MissRatio = (USHORT)((Ratio < 1000) ? Ratio : 1000);
+    Tuning->DepthHistory[1] = Tuning->DepthHistory[0];
+    Tuning->DepthHistory[0] = Lookaside->Depth;
+
+    // If the verifier is enabled, disable lookasides so driver problems can be isolated.
+    // Otherwise, if available memory is low, then halve the depth so the lookaside list gives memory back rather than chase its miss rate.
+    // Otherwise, compute the target lookaside list depth.
     if (ExMinimumLookasideDepth == 0) {
         Target = 0;
+    } else if (ExpLookasidePressure != FALSE) {
+        if ((Target = Lookaside->Depth / 2) < MINIMUM_LOOKASIDE_DEPTH) {
+            Target = MINIMUM_LOOKASIDE_DEPTH;
+        }
     } else {
         // If the allocate rate is less than the minimum threshold, then lower the maximum depth of the lookaside list.
         // Otherwise, if the miss rate is less than .5%, then lower the maximum depth.
+        // Otherwise, if the miss rate is above the burst ratio, then raise the maximum depth by half the remaining headroom.
         // Otherwise, raise the maximum depth based on the miss rate.
         MaximumDepth = Lookaside->MaximumDepth;
         Target = Lookaside->Depth;
@@ -108,31 +155,116 @@ Arguments:
             if ((Target -= 10) < MINIMUM_LOOKASIDE_DEPTH) {
                 Target = MINIMUM_LOOKASIDE_DEPTH;
             }
+        } else if (Ratio < 5) {
+            if ((Target -= 1) < MINIMUM_LOOKASIDE_DEPTH) {
+                Target = MINIMUM_LOOKASIDE_DEPTH;
+            }
         } else {
-            // N.B. The number of allocates is guaranteed to be greater than zero because of the above test.
-
-            // N.B. It is possible that the number of misses are greater than the number of allocates, but this won't cause the an incorrect computation of the depth adjustment.
-            Ratio = (Misses * 1000) / Allocates;
-            if (Ratio < 5) {
-                if ((Target -= 1) < MINIMUM_LOOKASIDE_DEPTH) {
-                    Target = MINIMUM_LOOKASIDE_DEPTH;
-                }
-            } else {
-                if ((Delta = ((Ratio * (MaximumDepth - Target)) / (1000 * 2)) + 5) > 30) {
-                    Delta = 30;
-                }
+            if (Ratio >= BURST_MISS_RATIO) {
+                Delta = ((MaximumDepth - Target) / 2) + 5;
+            } else if ((Delta = ((Ratio * (MaximumDepth - Target)) / (1000 * 2)) + 5) > MAXIMUM_DEPTH_INCREMENT) {
+                Delta = MAXIMUM_DEPTH_INCREMENT;
+            }
 
-                if ((Target += Delta) > MaximumDepth) {
-                    Target = MaximumDepth;
-                }
+            if ((Target += Delta) > MaximumDepth) {
+                Target = MaximumDepth;
             }
         }
     }
 
+    if (Target > Tuning->PeakDepth) {
+        Tuning->PeakDepth = (USHORT)Target;
+    }
+
     Lookaside->Depth = (USHORT)Target;
 }
 
 
+FORCEINLINE VOID ExpTrimLookasideList(IN PGENERAL_LOOKASIDE Lookaside, IN USHORT Depth)
+/*
+Routine Description:
+    This function lowers the depth of a general or system lookaside list and frees the entries above the new depth with the free routine of the list.
+Arguments:
+    Lookaside - Supplies a pointer to a lookaside list descriptor.
+    Depth - Supplies the new depth of the lookaside list.
+*/
+{
+    PVOID Entry;
+
+    if (Lookaside->Depth > Depth) {
+        Lookaside->Depth = Depth;
+    }
+
+    while (ExQueryDepthSList(&Lookaside->ListHead) > Lookaside->Depth) {
+        Entry = InterlockedPopEntrySList(&Lookaside->ListHead);
+        if (Entry == NULL) {
+            break;
+        }
+
+        (Lookaside->Free)(Entry);
+    }
+}
+
+
+VOID ExpTrimLookasideLists(VOID)
+/*
+Routine Description:
+    This function lowers the depth of all lookaside lists to the minimum depth and returns the excess entries to pool.
+    It is called by the periodic depth adjustment while available memory is below the trim threshold.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+
+    N.B. The entries of paged general lookaside lists cannot be freed while the general lookaside list spinlock is held.
+         Only their depth is lowered and the excess entries are consumed by subsequent allocations.
+*/
+{
+    PLIST_ENTRY Entry;
+    PGENERAL_LOOKASIDE Lookaside;
+    KIRQL OldIrql;
+
+    // Trim the pool lookaside lists. The entries on these lists are already marked free, so they are returned through the pool package.
+    Entry = ExPoolLookasideListHead.Flink;
+    while (Entry != &ExPoolLookasideListHead) {
+        Lookaside = CONTAINING_RECORD(Entry, GENERAL_LOOKASIDE, ListEntry);
+        ExTrimPoolLookasideList(Lookaside, ExMinimumLookasideDepth);
+        Entry = Entry->Flink;
+    }
+
+    // Trim the system lookaside lists.
+    Entry = ExSystemLookasideListHead.Flink;
+    while (Entry != &ExSystemLookasideListHead) {
+        Lookaside = CONTAINING_RECORD(Entry, GENERAL_LOOKASIDE, ListEntry);
+        ExpTrimLookasideList(Lookaside, ExMinimumLookasideDepth);
+        Entry = Entry->Flink;
+    }
+
+    // Trim the general nonpaged lookaside lists.
+    ExAcquireSpinLock(&ExNPagedLookasideLock, &OldIrql);
+    Entry = ExNPagedLookasideListHead.Flink;
+    while (Entry != &ExNPagedLookasideListHead) {
+        Lookaside = &CONTAINING_RECORD(Entry, NPAGED_LOOKASIDE_LIST, L.ListEntry)->L;
+        ExpTrimLookasideList(Lookaside, ExMinimumLookasideDepth);
+        Entry = Entry->Flink;
+    }
+
+    ExReleaseSpinLock(&ExNPagedLookasideLock, OldIrql);
+
+    // Lower the depth of the general paged lookaside lists.
+    ExAcquireSpinLock(&ExPagedLookasideLock, &OldIrql);
+    Entry = ExPagedLookasideListHead.Flink;
+    while (Entry != &ExPagedLookasideListHead) {
+        Lookaside = &CONTAINING_RECORD(Entry, PAGED_LOOKASIDE_LIST, L.ListEntry)->L;
+        if (Lookaside->Depth > ExMinimumLookasideDepth) {
+            Lookaside->Depth = ExMinimumLookasideDepth;
+        }
+
+        Entry = Entry->Flink;
+    }
+
+    ExReleaseSpinLock(&ExPagedLookasideLock, OldIrql);
+}
+
+
 VOID ExpScanGeneralLookasideList(IN PLIST_ENTRY ListHead, IN PKSPIN_LOCK SpinLock)
 /*
 Routine Description:
@@ -184,6 +316,7 @@ Return Value:
     ULONG Index;
     PGENERAL_LOOKASIDE Lookaside;
     ULONG Misses;
+    ULONG Node;
     PKPRCB Prcb;
     ULONG ScanPeriod;
 
@@ -224,6 +357,22 @@ Return Value:
 
             ExpComputeLookasideDepth(Lookaside, Misses, ScanPeriod);
         }
+
+        // Adjust the maximum depth for the per node sets of small pool lookaside descriptors.
+        // N.B. The nonpaged and paged descriptors of each size are adjacent.
+        for (Node = 1; Node < KeNumberNodes; Node += 1) {
+            Lookaside = ExpNodePoolLookasideLists[Node];
+            if (Lookaside != NULL) {
+                for (Index = 0; Index < (POOL_SMALL_LISTS * 2); Index += 1) {
+                    Hits = Lookaside->AllocateHits - Lookaside->LastAllocateHits;
+                    Lookaside->LastAllocateHits = Lookaside->AllocateHits;
+                    Misses = Lookaside->TotalAllocates - Lookaside->LastTotalAllocates - Hits;
+
+                    ExpComputeLookasideDepth(Lookaside, Misses, ScanPeriod);
+                    Lookaside += 1;
+                }
+            }
+        }
     } else {
         // Adjust the maximum depth for the global set of per processor system lookaside descriptors.
         Prcb = KiProcessorBlock[ExpPoolScanCount];
@@ -314,6 +463,7 @@ Arguments:
 
     Lookaside->L.LastTotalAllocates = 0;
     Lookaside->L.LastAllocateMisses = 0;
+    RtlZeroMemory(EX_LOOKASIDE_TUNING(&Lookaside->L), sizeof(LOOKASIDE_TUNING));
 
     // Insert the lookaside list structure in the system nonpaged lookaside list.
     ExInterlockedInsertTailList(&ExNPagedLookasideListHead, &Lookaside->L.ListEntry, &ExNPagedLookasideLock);
@@ -396,6 +546,7 @@ Arguments:
 
     Lookaside->L.LastTotalAllocates = 0;
     Lookaside->L.LastAllocateMisses = 0;
+    RtlZeroMemory(EX_LOOKASIDE_TUNING(&Lookaside->L), sizeof(LOOKASIDE_TUNING));
 
     // Insert the lookaside list structure in the system paged lookaside list.
     ExInterlockedInsertTailList(&ExPagedLookasideListHead, &Lookaside->L.ListEntry, &ExPagedLookasideLock);
@@ -426,6 +577,262 @@ Arguments:
 }
 
 
+FORCEINLINE VOID ExpInitializeObjectCacheList(IN PGENERAL_LOOKASIDE Lookaside, IN PEX_OBJECT_CACHE Cache)
+/*
+Routine Description:
+    This function initializes one of the lookaside lists of an object cache and inserts it in the general lookaside list for its pool type.
+Arguments:
+    Lookaside - Supplies a pointer to the lookaside list to initialize.
+    Cache - Supplies a pointer to the object cache whose type, tag, and size the lookaside list inherits.
+*/
+{
+    ExInitializeSListHead(&Lookaside->ListHead);
+    Lookaside->Depth = ExMinimumLookasideDepth;
+    Lookaside->MaximumDepth = 256;
+    Lookaside->TotalAllocates = 0;
+    Lookaside->AllocateMisses = 0;
+    Lookaside->TotalFrees = 0;
+    Lookaside->FreeMisses = 0;
+    Lookaside->Type = Cache->L.Type;
+    Lookaside->Tag = Cache->L.Tag;
+    Lookaside->Size = Cache->L.Size;
+    Lookaside->Allocate = ExpDummyAllocate;
+    Lookaside->Free = ExpFreeObjectCacheEntry;
+    Lookaside->LastTotalAllocates = 0;
+    Lookaside->LastAllocateMisses = 0;
+    RtlZeroMemory(EX_LOOKASIDE_TUNING(Lookaside), sizeof(LOOKASIDE_TUNING));
+    if ((Cache->L.Type & BASE_POOL_TYPE_MASK) == NonPagedPool) {
+        ExInterlockedInsertTailList(&ExNPagedLookasideListHead, &Lookaside->ListEntry, &ExNPagedLookasideLock);
+    } else {
+        ExInterlockedInsertTailList(&ExPagedLookasideListHead, &Lookaside->ListEntry, &ExPagedLookasideLock);
+    }
+}
+
+
+NTSTATUS ExInitializeObjectCache(OUT PEX_OBJECT_CACHE Cache,
+                                 IN POOL_TYPE PoolType,
+                                 IN SIZE_T Size,
+                                 IN ULONG Tag,
+                                 IN PEX_OBJECT_CACHE_CONSTRUCTOR Constructor OPTIONAL,
+                                 IN PEX_OBJECT_CACHE_DESTRUCTOR Destructor OPTIONAL,
+                                 IN PVOID Context OPTIONAL)
+/*
+Routine Description:
+    This function initializes an object cache with a global lookaside list and a lookaside list for each processor.
+Arguments:
+    Cache - Supplies a pointer to a nonpaged, cache aligned object cache structure.
+    PoolType - Supplies the pool type of the cached objects.
+    Size - Supplies the size of a cache entry. Larger objects may be allocated from the cache, but they are not cached when they are freed.
+    Tag - Supplies the pool tag for the cached objects.
+    Constructor - Supplies an optional pointer to a function that initializes an object when it is allocated from pool.
+    Destructor - Supplies an optional pointer to a function that is called before an object is returned to pool.
+                 The destructor of a nonpaged cache may be called at DISPATCH_LEVEL.
+    Context - Supplies an optional context that is passed to the constructor and destructor.
+Return Value:
+    STATUS_SUCCESS if the object cache is initialized, or STATUS_INSUFFICIENT_RESOURCES if the per processor lists cannot be allocated.
+*/
+{
+    ULONG Index;
+    ULONG NumberProcessors;
+
+    // Processors that are started after the cache is initialized use only the global lookaside list.
+    NumberProcessors = KeNumberProcessors;
+    Cache->PerProcessor = ExAllocatePoolWithTag(NonPagedPoolCacheAligned, NumberProcessors * sizeof(GENERAL_LOOKASIDE), 'cOxE');
+    if (Cache->PerProcessor == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Cache->NumberProcessors = NumberProcessors;
+    Cache->Constructor = Constructor;
+    Cache->Destructor = Destructor;
+    Cache->Context = Context;
+    Cache->L.Type = PoolType;
+    Cache->L.Tag = Tag;
+    Cache->L.Size = (ULONG)Size;
+    ExpInitializeObjectCacheList(&Cache->L, Cache);
+    for (Index = 0; Index < NumberProcessors; Index += 1) {
+        ExpInitializeObjectCacheList(&Cache->PerProcessor[Index], Cache);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+VOID ExDeleteObjectCache(IN PEX_OBJECT_CACHE Cache)
+/*
+Routine Description:
+    This function removes the lookaside lists of an object cache from the general lookaside lists and destructs and frees the cached objects.
+    N.B. All objects allocated from the cache must have been freed.
+Arguments:
+    Cache - Supplies a pointer to an object cache structure.
+*/
+{
+    PVOID Entry;
+    ULONG Index;
+    PGENERAL_LOOKASIDE Lookaside;
+    KIRQL OldIrql;
+    PKSPIN_LOCK SpinLock;
+
+    // Acquire the general lookaside list lock and remove the lookaside lists of the object cache from the list.
+    if ((Cache->L.Type & BASE_POOL_TYPE_MASK) == NonPagedPool) {
+        SpinLock = &ExNPagedLookasideLock;
+    } else {
+        SpinLock = &ExPagedLookasideLock;
+    }
+
+    ExAcquireSpinLock(SpinLock, &OldIrql);
+    RemoveEntryList(&Cache->L.ListEntry);
+    for (Index = 0; Index < Cache->NumberProcessors; Index += 1) {
+        RemoveEntryList(&Cache->PerProcessor[Index].ListEntry);
+    }
+
+    ExReleaseSpinLock(SpinLock, OldIrql);
+
+    // Destruct and free all cached objects.
+    while ((Entry = InterlockedPopEntrySList(&Cache->L.ListHead)) != NULL) {
+        ExpFreeObjectCacheEntry(Entry);
+    }
+
+    for (Index = 0; Index < Cache->NumberProcessors; Index += 1) {
+        Lookaside = &Cache->PerProcessor[Index];
+        while ((Entry = InterlockedPopEntrySList(&Lookaside->ListHead)) != NULL) {
+            ExpFreeObjectCacheEntry(Entry);
+        }
+    }
+
+    ExFreePoolWithTag(Cache->PerProcessor, 'cOxE');
+}
+
+
+PVOID ExAllocateFromObjectCache(IN PEX_OBJECT_CACHE Cache, IN SIZE_T Size)
+/*
+Routine Description:
+    This function allocates a constructed object from an object cache.
+    The per processor lookaside list is tried first, then the global lookaside list, and then a new object is allocated from pool and constructed.
+Arguments:
+    Cache - Supplies a pointer to an object cache structure.
+    Size - Supplies the size of the object. If the size is larger than the cache entry size, then an oversized object is allocated from pool.
+Return Value:
+    A pointer to the object, or NULL if the object cannot be allocated.
+    N.B. A cached object has the state that was left by its previous user, not the state set by the constructor.
+         Users must restore the constructed state of the fields they change before the object is freed.
+*/
+{
+    PEX_OBJECT_CACHE_ENTRY Entry;
+    PGENERAL_LOOKASIDE Lookaside;
+    ULONG Number;
+    ULONG_PTR Oversized;
+
+    Oversized = (Size > Cache->L.Size);
+    if (Oversized == FALSE) {
+        // Attempt to allocate from the per processor lookaside list.
+        Number = KeGetCurrentProcessorNumber();
+        if (Number < Cache->NumberProcessors) {
+            Lookaside = &Cache->PerProcessor[Number];
+            Lookaside->TotalAllocates += 1;
+            Entry = (PEX_OBJECT_CACHE_ENTRY)InterlockedPopEntrySList(&Lookaside->ListHead);
+            if (Entry != NULL) {
+                return Entry + 1;
+            }
+
+            Lookaside->AllocateMisses += 1;
+        }
+
+        // Attempt to allocate from the global lookaside list.
+        Lookaside = &Cache->L;
+        Lookaside->TotalAllocates += 1;
+        Entry = (PEX_OBJECT_CACHE_ENTRY)InterlockedPopEntrySList(&Lookaside->ListHead);
+        if (Entry != NULL) {
+            return Entry + 1;
+        }
+
+        Lookaside->AllocateMisses += 1;
+        Size = Cache->L.Size;
+    }
+
+    // Allocate a new object from pool and construct it.
+    Entry = ExAllocatePoolWithTag(Cache->L.Type, sizeof(EX_OBJECT_CACHE_ENTRY) + Size, Cache->L.Tag);
+    if (Entry == NULL) {
+        return NULL;
+    }
+
+    Entry->Cache = Cache;
+    Entry->Oversized = Oversized;
+    if (Cache->Constructor != NULL) {
+        (Cache->Constructor)(Entry + 1, Cache->Context);
+    }
+
+    return Entry + 1;
+}
+
+
+VOID ExFreeToObjectCache(IN PVOID Object)
+/*
+Routine Description:
+    This function frees an object to the object cache it was allocated from.
+    If the per processor and global lookaside lists are full or the object is oversized, then the object is destructed and returned to pool.
+Arguments:
+    Object - Supplies a pointer to an object allocated by ExAllocateFromObjectCache.
+*/
+{
+    PEX_OBJECT_CACHE Cache;
+    PEX_OBJECT_CACHE_ENTRY Entry;
+    PGENERAL_LOOKASIDE Lookaside;
+    ULONG Number;
+
+    Entry = (PEX_OBJECT_CACHE_ENTRY)Object - 1;
+    Cache = Entry->Cache;
+    if (Entry->Oversized == FALSE) {
+        // If the depth of the per processor lookaside list is less than its maximum depth, then free the object to the per processor list.
+        // Otherwise, attempt to free the object to the global lookaside list.
+        Number = KeGetCurrentProcessorNumber();
+        if (Number < Cache->NumberProcessors) {
+            Lookaside = &Cache->PerProcessor[Number];
+            Lookaside->TotalFrees += 1;
+            if (ExQueryDepthSList(&Lookaside->ListHead) < Lookaside->Depth) {
+                InterlockedPushEntrySList(&Lookaside->ListHead, &Entry->ListEntry);
+                return;
+            }
+
+            Lookaside->FreeMisses += 1;
+        }
+
+        Lookaside = &Cache->L;
+        Lookaside->TotalFrees += 1;
+        if (ExQueryDepthSList(&Lookaside->ListHead) < Lookaside->Depth) {
+            InterlockedPushEntrySList(&Lookaside->ListHead, &Entry->ListEntry);
+            return;
+        }
+
+        Lookaside->FreeMisses += 1;
+    }
+
+    ExpFreeObjectCacheEntry(Entry);
+}
+
+
+VOID ExpFreeObjectCacheEntry(IN PVOID Buffer)
+/*
+Routine Description:
+    This function destructs an object cache entry and returns it to pool.
+    It is the free routine of the object cache lookaside lists, so it is also called when the lookaside lists are trimmed.
+Arguments:
+    Buffer - Supplies a pointer to the header of an object cache entry.
+*/
+{
+    PEX_OBJECT_CACHE Cache;
+    PEX_OBJECT_CACHE_ENTRY Entry;
+
+    Entry = (PEX_OBJECT_CACHE_ENTRY)Buffer;
+    Cache = Entry->Cache;
+    if (Cache->Destructor != NULL) {
+        (Cache->Destructor)(Entry + 1, Cache->Context);
+    }
+
+    ExFreePoolWithTag(Entry, Cache->L.Tag);
+}
+
+
 PVOID ExpDummyAllocate(IN POOL_TYPE PoolType, IN SIZE_T NumberOfBytes, IN ULONG Tag)
 /*
 Routine Description:
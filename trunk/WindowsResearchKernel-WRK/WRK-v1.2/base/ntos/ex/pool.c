@@ -28,27 +28,37 @@ Abstract:
 
 // Define forward referenced function prototypes.
 
+PVOID ExpAllocatePoolProfiled(IN POOL_TYPE PoolType, IN SIZE_T NumberOfBytes, IN ULONG Tag, IN PVOID CallingAddress);
+VOID ExpFreePoolProfiled(IN PVOID P);
+
 #ifdef ALLOC_PRAGMA
 PVOID ExpAllocateStringRoutine(IN SIZE_T NumberOfBytes);
 VOID ExDeferredFreePool(IN PPOOL_DESCRIPTOR PoolDesc);
 VOID ExpSeedHotTags(VOID);
 NTSTATUS ExGetSessionPoolTagInfo(IN PVOID SystemInformation, IN ULONG SystemInformationLength, IN OUT PULONG ReturnedEntries, IN OUT PULONG ActualEntries);
 NTSTATUS ExGetPoolTagInfo(IN PVOID SystemInformation, IN ULONG SystemInformationLength, IN OUT PULONG ReturnLength OPTIONAL);
+NTSTATUS ExGetPoolProfileInfo(IN PVOID SystemInformation, IN ULONG SystemInformationLength, IN OUT PULONG ReturnLength OPTIONAL);
+NTSTATUS ExSetPoolProfile(IN ULONG SampleInterval, IN BOOLEAN Reset);
 
 #pragma alloc_text(PAGE, ExpAllocateStringRoutine)
 #pragma alloc_text(INIT, InitializePool)
 #pragma alloc_text(INIT, ExpSeedHotTags)
 #pragma alloc_text(PAGE, ExInitializePoolDescriptor)
 #pragma alloc_text(PAGE, ExDrainPoolLookasideList)
+#pragma alloc_text(PAGE, ExTrimPoolLookasideList)
 #pragma alloc_text(PAGE, ExCreatePoolTagTable)
 #pragma alloc_text(PAGE, ExGetSessionPoolTagInfo)
 #pragma alloc_text(PAGE, ExGetPoolTagInfo)
+#pragma alloc_text(PAGE, ExGetPoolProfileInfo)
+#pragma alloc_text(PAGE, ExSetPoolProfile)
 #pragma alloc_text(PAGEVRFY, ExAllocatePoolSanityChecks)
 #pragma alloc_text(PAGEVRFY, ExFreePoolSanityChecks)
 #pragma alloc_text(POOLCODE, ExAllocatePoolWithTag)
 #pragma alloc_text(POOLCODE, ExFreePool)
 #pragma alloc_text(POOLCODE, ExFreePoolWithTag)
 #pragma alloc_text(POOLCODE, ExDeferredFreePool)
+#pragma alloc_text(POOLCODE, ExpAllocatePoolProfiled)
+#pragma alloc_text(POOLCODE, ExpFreePoolProfiled)
 #endif
 
 #if defined (NT_UP)
@@ -73,7 +83,6 @@ ULONG ExpSessionPoolSmallLists;
 ULONG ExpLargeSessionPoolUnTracked;
 #endif
 ULONG ExpBigTableExpansionFailed;
-LONG ExpPoolBigEntriesInUse;
 
 extern SIZE_T MmSizeOfNonPagedPoolInBytes;
 
@@ -107,14 +116,41 @@ SIZE_T PoolTrackTableExpansionPages;
 
 #define DEFAULT_BIGPAGE_TABLE 4096
 
-PPOOL_TRACKER_BIG_PAGES PoolBigPageTable;
+// The big page table is split into independently locked and independently expanded shards selected by the hash of the allocation address.
+// This keeps exclusive acquisition for table growth (and the rehash it performs) confined to a fraction of the entries and of the allocating threads.
+POOL_BIG_PAGE_SHARD PoolBigPageShards[POOL_BIG_TABLE_SHARDS];
 
 // Registry-overridable, but must be a power of 2.
 SIZE_T PoolBigPageTableSize;   // Must be a power of 2.
-SIZE_T PoolBigPageTableHash;
 #define POOL_BIG_TABLE_ENTRY_FREE   0x1     // Must be the low bit since InterlockedAdd is used also to set/clear this.
 ULONG PoolHitTag = 0xffffff0f;
 
+// ULONG POOL_BIG_TABLE_HASH (IN PVOID Va);
+// Routine Description:
+//    This macro folds the page number of a big page allocation into a hash value.
+//    The low bits of the hash select the shard and the remaining bits select the entry within the shard.
+#define POOL_BIG_TABLE_HASH(Va)                                                   \
+    ((((ULONG)(((ULONG_PTR)(Va)) >> PAGE_SHIFT)) >> 24) ^                         \
+     (((ULONG)(((ULONG_PTR)(Va)) >> PAGE_SHIFT)) >> 16) ^                         \
+     (((ULONG)(((ULONG_PTR)(Va)) >> PAGE_SHIFT)) >> 8) ^                          \
+     ((ULONG)(((ULONG_PTR)(Va)) >> PAGE_SHIFT)))
+
+#define POOL_BIG_TABLE_SHARD(Hash)  (&PoolBigPageShards[(Hash) & (POOL_BIG_TABLE_SHARDS - 1)])
+#define POOL_BIG_TABLE_INDEX(Hash)  ((Hash) >> POOL_BIG_TABLE_SHARD_SHIFT)
+
+// Pool allocation profiling.
+
+// When ExpPoolProfileInterval is nonzero, every Nth allocation on each processor captures a short stack back trace and is charged to the call site with that stack.
+// The call site and live tables are allocated the first time profiling is enabled and are never freed so frees can always be matched against them.
+ULONG ExpPoolProfileInterval;
+LONG ExpPoolProfileDropped;
+ULONGLONG ExpPoolProfileStartTime;
+PPOOL_PROFILE_SITE ExpPoolProfileSites;
+PPOOL_PROFILE_LIVE ExpPoolProfileLive;
+POOL_PROFILE_COUNTER ExpPoolProfileCounter[MAXIMUM_PROCESSORS];
+
+#define POOL_PROFILE_LIVE_HASH(Va) ((ULONG)(((ULONG_PTR)(Va) >> POOL_BLOCK_SHIFT) ^ ((ULONG_PTR)(Va) >> (PAGE_SHIFT + 4))) & (POOL_PROFILE_LIVE_ENTRIES - 1))
+
 
 FORCEINLINE ULONG POOLTAG_HASH(IN ULONG Key, IN SIZE_T Mask)
 /*
@@ -210,8 +246,6 @@ PKGUARDED_MUTEX ExpPagedPoolMutex;
 volatile ULONG ExpPoolIndex = 1;
 KSPIN_LOCK ExpTaggedPoolLock;
 
-EX_SPIN_LOCK ExpLargePoolTableLock;
-
 #if DBG
 LONG ExConcurrentQuotaPool;
 LONG ExConcurrentQuotaPoolMax;
@@ -230,6 +264,11 @@ PSZ PoolTypeNames[MaxPoolType] = {
 GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[POOL_SMALL_LISTS];
 GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[POOL_SMALL_LISTS];
 
+// Define the per node paged and nonpaged pool lookaside descriptors.
+// Each entry points to POOL_SMALL_LISTS pairs of nonpaged and paged descriptors which are the second level lookaside lists of the processors in the node.
+// Node 0 and any node whose allocation failed use the global descriptors above.
+PGENERAL_LOOKASIDE ExpNodePoolLookasideLists[MAXIMUM_CCNUMA_NODES];
+
 #define LOCK_POOL(PoolDesc, LockHandle) {                                   \
     if ((PoolDesc->PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool) {       \
         if (PoolDesc == &NonPagedPoolDescriptor) {                          \
@@ -552,6 +591,47 @@ Arguments:
     }
 }
 
+
+VOID ExTrimPoolLookasideList(IN PGENERAL_LOOKASIDE Lookaside, IN USHORT Depth)
+/*
+Routine Description:
+    This function lowers the depth of the specified pool lookaside list and returns the entries above the new depth to pool.
+    It is called by the lookaside depth adjustment when available memory is low.
+Arguments:
+    Lookaside - Supplies a pointer to a pool lookaside list structure.
+    Depth - Supplies the new depth of the lookaside list.
+Environment:
+    Kernel mode, PASSIVE_LEVEL as paged pool entries may be freed.
+*/
+{
+    PVOID Entry;
+    PPOOL_HEADER PoolHeader;
+
+    if (Lookaside->Depth > Depth) {
+        Lookaside->Depth = Depth;
+    }
+
+    // Remove the excess pool entries from the specified lookaside structure, mark them as active, then free them.
+
+    // N.B. The depth is held at zero while the entries are freed so the free path does not push them back onto this list.
+    //      This isn't interlocked, so a racing free on another processor can at worst leave the list briefly above the new depth.
+    while (ExQueryDepthSList(&Lookaside->ListHead) > Depth) {
+        Entry = InterlockedPopEntrySList(&Lookaside->ListHead);
+        if (Entry == NULL) {
+            break;
+        }
+
+        PoolHeader = (PPOOL_HEADER)Entry - 1;
+        PoolHeader->PoolType = (USHORT)(Lookaside->Type + 1);
+        PoolHeader->PoolType |= POOL_IN_USE_MASK;
+        ExpInsertPoolTracker(PoolHeader->PoolTag, PoolHeader->BlockSize << POOL_BLOCK_SHIFT, Lookaside->Type);
+        Lookaside->Depth = 0;
+        (Lookaside->Free)(Entry);
+    }
+
+    Lookaside->Depth = Depth;
+}
+
 // FREE_CHECK_ERESOURCE - If enabled causes each free pool to verify no active ERESOURCEs are in the pool block being freed.
 
 // FREE_CHECK_KTIMER - If enabled causes each free pool to verify no active KTIMERs are in the pool block being freed.
@@ -619,6 +699,7 @@ Arguments:
     ULONG Index;
     PKGUARDED_MUTEX GuardedMutex;
     SIZE_T NumberOfBytes;
+    PPOOL_BIG_PAGE_SHARD Shard;
 
     ASSERT((PoolType & MUST_SUCCEED_POOL_TYPE_MASK) == 0);
 
@@ -698,37 +779,55 @@ Arguments:
             PoolBigPageTableSize = DEFAULT_BIGPAGE_TABLE;
         } else {
             PoolBigPageTableSize = ((SIZE_T)1) << i;
-            if (PoolBigPageTableSize < 64) {
-                PoolBigPageTableSize = 64;
+            if (PoolBigPageTableSize < 64 * POOL_BIG_TABLE_SHARDS) {
+                PoolBigPageTableSize = 64 * POOL_BIG_TABLE_SHARDS;
             }
         }
 
+        // Split the table evenly across the shards. Each shard is subsequently expanded on its own as its entries fill up.
         do {
             if (PoolBigPageTableSize > (MAXULONG_PTR / sizeof(POOL_TRACKER_BIG_PAGES))) {
                 PoolBigPageTableSize >>= 1;
                 continue;
             }
 
-            PoolBigPageTable = MiAllocatePoolPages(NonPagedPool, PoolBigPageTableSize * sizeof(POOL_TRACKER_BIG_PAGES));
-            if (PoolBigPageTable != NULL) {
+            for (Index = 0; Index < POOL_BIG_TABLE_SHARDS; Index += 1) {
+                Shard = &PoolBigPageShards[Index];
+                Shard->TableSize = PoolBigPageTableSize / POOL_BIG_TABLE_SHARDS;
+                Shard->Table = MiAllocatePoolPages(NonPagedPool, Shard->TableSize * sizeof(POOL_TRACKER_BIG_PAGES));
+                if (Shard->Table == NULL) {
+                    break;
+                }
+            }
+
+            if (Index == POOL_BIG_TABLE_SHARDS) {
                 break;
             }
 
-            if (PoolBigPageTableSize == 1) {
+            while (Index != 0) {
+                Index -= 1;
+                MiFreePoolPages(PoolBigPageShards[Index].Table);
+                PoolBigPageShards[Index].Table = NULL;
+            }
+
+            if (PoolBigPageTableSize == POOL_BIG_TABLE_SHARDS) {
                 KeBugCheckEx(MUST_SUCCEED_POOL_EMPTY, NumberOfBytes, (ULONG_PTR)-1, (ULONG_PTR)-1, (ULONG_PTR)-1);
             }
 
             PoolBigPageTableSize >>= 1;
         } while (TRUE);
 
-        PoolBigPageTableHash = PoolBigPageTableSize - 1;
-        RtlZeroMemory(PoolBigPageTable, PoolBigPageTableSize * sizeof(POOL_TRACKER_BIG_PAGES));
-        p = &PoolBigPageTable[0];
-        for (i = 0; i < PoolBigPageTableSize; i += 1, p += 1) {
-            p->Va = (PVOID)POOL_BIG_TABLE_ENTRY_FREE;
-        }
+        for (Index = 0; Index < POOL_BIG_TABLE_SHARDS; Index += 1) {
+            Shard = &PoolBigPageShards[Index];
+            Shard->TableHash = Shard->TableSize - 1;
+            RtlZeroMemory(Shard->Table, Shard->TableSize * sizeof(POOL_TRACKER_BIG_PAGES));
+            p = &Shard->Table[0];
+            for (i = 0; i < Shard->TableSize; i += 1, p += 1) {
+                p->Va = (PVOID)POOL_BIG_TABLE_ENTRY_FREE;
+            }
 
-        ExpInsertPoolTracker('looP', ROUND_TO_PAGES(PoolBigPageTableSize * sizeof(POOL_TRACKER_BIG_PAGES)), NonPagedPool);
+            ExpInsertPoolTracker('looP', ROUND_TO_PAGES(Shard->TableSize * sizeof(POOL_TRACKER_BIG_PAGES)), NonPagedPool);
+        }
         if (KeNumberNodes > 1) {
             ExpNumberOfNonPagedPools = KeNumberNodes;
 
@@ -884,12 +983,12 @@ Environment:
     No pool locks held except during the rare case of expansion table growth.
     so pool may be freely allocated here as needed.
     In expansion table growth, the tagged spinlock is held on entry, but we are guaranteed to find an entry in the builtin table so a recursive acquire cannot occur.
+    Entries in the builtin table are claimed lock-free, so the tagged spinlock is only ever acquired for the expansion table.
 */
 {
     ULONG Hash;
     ULONG Index;
     LONG OriginalKey;
-    KIRQL OldIrql;
     PPOOL_TRACKER_TABLE TrackTable;
     PPOOL_TRACKER_TABLE TrackTableEntry;
     SIZE_T TrackTableMask;
@@ -972,16 +1071,10 @@ Environment:
 #endif
 
             if (Hash != PoolTrackTableSize - 1) {
-                // New entries cannot be created with an interlocked compare exchange because any new entry must reside at the same index in each processor's private PoolTrackTable.
-                // This is to make ExGetPoolTagInfo statistics gathering much simpler (faster).
-                ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
-                if (PoolTrackTable[Hash].Key == 0) {
-                    ASSERT(TrackTable[Hash].Key == 0);
-                    PoolTrackTable[Hash].Key = Key;
-                    TrackTableEntry->Key = Key;
-                }
-
-                ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+                // Any new entry must reside at the same index in each processor's private PoolTrackTable so ExGetPoolTagInfo can simply sum the tables entry by entry.
+                // Claiming the slot with an interlocked compare exchange on the master table is sufficient for this because every processor
+                // consults the master table (and copies its key) before it considers a slot in its own table to be empty.
+                InterlockedCompareExchange((PLONG)& PoolTrackTable[Hash].Key, (LONG)Key, 0);
 
                 // Either this thread has won the race and the requested tag is now in or some other thread won the race and took this slot (using this tag or a different one).
 
@@ -1160,6 +1253,21 @@ Return Value:
     ASSERT(NumberOfBytes != 0);
     ASSERT_ALLOCATE_IRQL(PoolType, NumberOfBytes);
 
+    // If allocation profiling is enabled and this allocation is selected as a sample, then have the profiler make the allocation.
+    // Note this will result in a recursive callback to this routine with the profile bit set.
+    if ((PoolType & POOL_PROFILE_MASK) == 0) {
+        if ((ExpPoolProfileInterval != 0) && (--ExpPoolProfileCounter[KeGetCurrentProcessorNumber()].Countdown <= 0)) {
+#if defined (_X86_)
+            RtlGetCallersAddress(&CallingAddress, &CallersCaller);
+#else
+            CallingAddress = (PVOID)_ReturnAddress();
+#endif
+            return ExpAllocatePoolProfiled(PoolType, NumberOfBytes, Tag, CallingAddress);
+        }
+    } else {
+        PoolType &= ~POOL_PROFILE_MASK;
+    }
+
     if (ExpPoolFlags & (EX_KERNEL_VERIFIER_ENABLED | EX_SPECIAL_POOL_ENABLED)) {
         if (ExpPoolFlags & EX_KERNEL_VERIFIER_ENABLED) {
             if ((PoolType & POOL_DRIVER_MASK) == 0) {
@@ -1332,8 +1440,9 @@ Return Value:
                 if (KeNumberNodes > 1) {
                     // Use the pool descriptor which contains memory local to the current processor even if we have to wait for it.
                     // While it is possible that the paged pool addresses in the local descriptor have been paged out, on large memory NUMA machines this should be less common.
-                    Prcb = KeGetCurrentPrcb();
-                    PoolIndex = Prcb->ParentNode->Color;
+
+                    // N.B. If a preferred node has been set for the current process, then memory local to the preferred node is used.
+                    PoolIndex = KeGetPreferredNode()->Color;
                     if (PoolIndex < ExpNumberOfPagedPools) {
                         PoolIndex += 1;
                         PoolDesc = ExpPagedPoolDescriptor[PoolIndex];
@@ -1437,9 +1546,8 @@ Return Value:
 
         if (ExpNumberOfNonPagedPools <= 1) {
             PoolIndex = 0;
-        } else {// Use the pool descriptor which contains memory local to the current processor even if we have to contend for its lock.
-            Prcb = KeGetCurrentPrcb();
-            PoolIndex = Prcb->ParentNode->Color;
+        } else {// Use the pool descriptor which contains memory local to the current processor, or the preferred node of the current process, even if we have to contend for its lock.
+            PoolIndex = KeGetPreferredNode()->Color;
             if (PoolIndex >= ExpNumberOfNonPagedPools) {
                 PoolIndex = ExpNumberOfNonPagedPools - 1;
             }
@@ -2374,16 +2482,17 @@ VOID ExpRemovePoolTracker(IN ULONG Key, IN SIZE_T NumberOfBytes, IN POOL_TYPE Po
 }
 
 
-LOGICAL ExpExpandBigPageTable(IN KIRQL OldIrql)
+LOGICAL ExpExpandBigPageTable(IN PPOOL_BIG_PAGE_SHARD Shard, IN KIRQL OldIrql)
 /*
 Routine Description:
-    This function expands the big page tracking table and rehashes all the old entries into the new table at the same time.
+    This function expands one shard of the big page tracking table and rehashes all the old entries of the shard into the new table at the same time.
 Arguments:
-    OldIrql - Supplies the IRQL the pool track table spinlock was acquired at.
+    Shard - Supplies a pointer to the shard to expand.
+    OldIrql - Supplies the IRQL the shard spinlock was acquired at.
 Return Value:
     TRUE if the table was expanded, FALSE if not.
 Environment:
-    Pool track table executive spinlock held exclusive at DISPATCH_LEVEL.
+    Shard executive spinlock held exclusive at DISPATCH_LEVEL.
     The spinlock is released here (and IRQL lowered) prior to returning !!!
 */
 {
@@ -2398,17 +2507,17 @@ Environment:
     PPOOL_TRACKER_BIG_PAGES NewTable;
 
     // Try to expand the tracker table.
-    TableSize = PoolBigPageTableSize;
+    TableSize = Shard->TableSize;
     SizeInBytes = TableSize * sizeof(POOL_TRACKER_BIG_PAGES);
     NewSizeInBytes = (SizeInBytes << 1);
     if (NewSizeInBytes <= SizeInBytes) {
-        ExReleaseSpinLockExclusive(&ExpLargePoolTableLock, OldIrql);
+        ExReleaseSpinLockExclusive(&Shard->Lock, OldIrql);
         return FALSE;
     }
 
     NewTable = MiAllocatePoolPages(NonPagedPool, NewSizeInBytes);
     if (NewTable == NULL) {
-        ExReleaseSpinLockExclusive(&ExpLargePoolTableLock, OldIrql);
+        ExReleaseSpinLockExclusive(&Shard->Lock, OldIrql);
         return FALSE;
     }
 
@@ -2423,14 +2532,14 @@ Environment:
     } while (Table != TableEnd);
 
     // Rehash the valid tables in the old table into their new locations in the new table.
-    Table = PoolBigPageTable;
+    Table = Shard->Table;
     TableEnd = Table + TableSize;
     NewHash = (ULONG)((TableSize << 1) - 1);
     do {
         if (((ULONG_PTR)Table->Va & POOL_BIG_TABLE_ENTRY_FREE) == 0) {
-            Hash = (ULONG)(((ULONG_PTR)Table->Va) >> PAGE_SHIFT);
-            Hash = ((Hash >> 24) ^ (Hash >> 16) ^ (Hash >> 8) ^ Hash);
-            Hash &= NewHash;
+            Hash = POOL_BIG_TABLE_HASH(Table->Va);
+            ASSERT(POOL_BIG_TABLE_SHARD(Hash) == Shard);
+            Hash = POOL_BIG_TABLE_INDEX(Hash) & NewHash;
             while (((ULONG_PTR)NewTable[Hash].Va & POOL_BIG_TABLE_ENTRY_FREE) == 0) {
                 Hash += 1;
                 if (Hash > NewHash) {
@@ -2444,12 +2553,12 @@ Environment:
         Table += 1;
     } while (Table != TableEnd);
 
-    Table = PoolBigPageTable;
-    PoolBigPageTable = NewTable;
-    PoolBigPageTableSize = (TableSize << 1);
-    PoolBigPageTableHash = NewHash;
+    Table = Shard->Table;
+    Shard->Table = NewTable;
+    Shard->TableSize = (TableSize << 1);
+    Shard->TableHash = NewHash;
 
-    ExReleaseSpinLockExclusive(&ExpLargePoolTableLock, OldIrql);
+    ExReleaseSpinLockExclusive(&Shard->Lock, OldIrql);
 
     // The table growth has completed, release the spinlock.
     BigPages = MiFreePoolPages(Table);
@@ -2482,6 +2591,7 @@ Environment:
     PPOOL_TRACKER_BIG_PAGES Entry;
     PPOOL_TRACKER_BIG_PAGES EntryEnd;
     PPOOL_TRACKER_BIG_PAGES EntryStart;
+    PPOOL_BIG_PAGE_SHARD Shard;
 
     // The low bit of the address is set to indicate a free entry.
     // The high bit cannot be used because in some configurations the high bit is not set for all kernelmode addresses.
@@ -2516,32 +2626,32 @@ Environment:
     }
 
     IterationCount = 0;
+    Hash = POOL_BIG_TABLE_HASH(Va);
+    Shard = POOL_BIG_TABLE_SHARD(Hash);
+    Hash = POOL_BIG_TABLE_INDEX(Hash);
 
     do {
-        Hash = (ULONG)(((ULONG_PTR)Va) >> PAGE_SHIFT);
-        Hash = ((Hash >> 24) ^ (Hash >> 16) ^ (Hash >> 8) ^ Hash);
-        OldIrql = ExAcquireSpinLockShared(&ExpLargePoolTableLock);
-        Hash &= PoolBigPageTableHash;
-        TableSize = PoolBigPageTableSize;
-        Entry = &PoolBigPageTable[Hash];
+        OldIrql = ExAcquireSpinLockShared(&Shard->Lock);
+        TableSize = Shard->TableSize;
+        Entry = &Shard->Table[Hash & Shard->TableHash];
         EntryStart = Entry;
-        EntryEnd = &PoolBigPageTable[TableSize];
+        EntryEnd = &Shard->Table[TableSize];
         do {
             OldVa = Entry->Va;
             if (((ULONG_PTR)OldVa & POOL_BIG_TABLE_ENTRY_FREE) &&
                 (InterlockedCompareExchangePointer(&Entry->Va, Va, OldVa) == OldVa)) {
                 Entry->Key = Key;
                 Entry->NumberOfPages = NumberOfPages;
-                InterlockedIncrement(&ExpPoolBigEntriesInUse);
-                if ((IterationCount >= 16) && ((ULONG)ExpPoolBigEntriesInUse > (ULONG)(TableSize / 4))) {
-                    if (ExTryAcquireSpinLockExclusive(&ExpLargePoolTableLock) == TRUE) {
-                        ASSERT(TableSize == PoolBigPageTableSize);
-                        ExpExpandBigPageTable(OldIrql);// The expansion function always releases the lock.
+                InterlockedIncrement(&Shard->EntriesInUse);
+                if ((IterationCount >= 16) && ((ULONG)Shard->EntriesInUse > (ULONG)(TableSize / 4))) {
+                    if (ExTryAcquireSpinLockExclusive(&Shard->Lock) == TRUE) {
+                        ASSERT(TableSize == Shard->TableSize);
+                        ExpExpandBigPageTable(Shard, OldIrql);// The expansion function always releases the lock.
                     } else {
-                        ExReleaseSpinLockShared(&ExpLargePoolTableLock, OldIrql);
+                        ExReleaseSpinLockShared(&Shard->Lock, OldIrql);
                     }
                 } else {
-                    ExReleaseSpinLockShared(&ExpLargePoolTableLock, OldIrql);
+                    ExReleaseSpinLockShared(&Shard->Lock, OldIrql);
                 }
 
                 return TRUE;
@@ -2550,7 +2660,7 @@ Environment:
             IterationCount += 1;
             Entry += 1;
             if (Entry >= EntryEnd) {
-                Entry = &PoolBigPageTable[0];
+                Entry = &Shard->Table[0];
             }
         } while (Entry != EntryStart);
 
@@ -2558,15 +2668,15 @@ Environment:
 
         // Since this involves copying the existing entries over and deleting the old table,
         // first acquire the lock exclusive.
-        if (ExTryAcquireSpinLockExclusive(&ExpLargePoolTableLock) == FALSE) {
-            ExReleaseSpinLockShared(&ExpLargePoolTableLock, OldIrql);
+        if (ExTryAcquireSpinLockExclusive(&Shard->Lock) == FALSE) {
+            ExReleaseSpinLockShared(&Shard->Lock, OldIrql);
             continue;
         }
 
-        ASSERT(TableSize == PoolBigPageTableSize);// No thread could have grown this during the contention above, so ASSERT that this is the case.
+        ASSERT(TableSize == Shard->TableSize);// No thread could have grown this during the contention above, so ASSERT that this is the case.
 
         // The expansion function always releases the lock.
-        if (ExpExpandBigPageTable(OldIrql) == FALSE) {
+        if (ExpExpandBigPageTable(Shard, OldIrql) == FALSE) {
             ExpBigTableExpansionFailed += 1;
             return FALSE;
         }
@@ -2594,6 +2704,7 @@ Environment:
     KIRQL OldIrql;
     ULONG ReturnKey;
     PPOOL_TRACKER_BIG_PAGES Entry;
+    PPOOL_BIG_PAGE_SHARD Shard;
 
     ASSERT(((ULONG_PTR)Va & POOL_BIG_TABLE_ENTRY_FREE) == 0);
 
@@ -2622,16 +2733,16 @@ Environment:
     }
 
     Inserted = TRUE;
-    Hash = (ULONG)(((ULONG_PTR)Va) >> PAGE_SHIFT);
-    Hash = ((Hash >> 24) ^ (Hash >> 16) ^ (Hash >> 8) ^ Hash);
-    OldIrql = ExAcquireSpinLockShared(&ExpLargePoolTableLock);
-    Hash &= PoolBigPageTableHash;
-    TableSize = PoolBigPageTableSize;
-    while (PoolBigPageTable[Hash].Va != Va) {
+    Hash = POOL_BIG_TABLE_HASH(Va);
+    Shard = POOL_BIG_TABLE_SHARD(Hash);
+    OldIrql = ExAcquireSpinLockShared(&Shard->Lock);
+    Hash = POOL_BIG_TABLE_INDEX(Hash) & Shard->TableHash;
+    TableSize = Shard->TableSize;
+    while (Shard->Table[Hash].Va != Va) {
         Hash += 1;
         if (Hash >= TableSize) {
             if (!Inserted) {
-                ExReleaseSpinLockShared(&ExpLargePoolTableLock, OldIrql);
+                ExReleaseSpinLockShared(&Shard->Lock, OldIrql);
                 *BigPages = 0;
                 return ' GIB';
             }
@@ -2641,10 +2752,10 @@ Environment:
         }
     }
 
-    Entry = &PoolBigPageTable[Hash];
+    Entry = &Shard->Table[Hash];
     *BigPages = Entry->NumberOfPages;
     ReturnKey = Entry->Key;
-    InterlockedDecrement(&ExpPoolBigEntriesInUse);
+    InterlockedDecrement(&Shard->EntriesInUse);
 
 #if defined(_WIN64)
     InterlockedIncrement64((PLONGLONG)& Entry->Va);
@@ -2652,7 +2763,7 @@ Environment:
     InterlockedIncrement((PLONG)& Entry->Va);
 #endif
 
-    ExReleaseSpinLockShared(&ExpLargePoolTableLock, OldIrql);
+    ExReleaseSpinLockShared(&Shard->Lock, OldIrql);
     return ReturnKey;
 }
 
@@ -2698,6 +2809,12 @@ Arguments:
 
     // Initializing LockHandle is not needed for correctness but without it the compiler cannot compile this code W4 to check for use of uninitialized variables.
     LockHandle.OldIrql = 0;
+
+    // If allocation profiling has ever been enabled, then charge the free back to the call site if the block was a sampled allocation.
+    if (ExpPoolProfileLive != NULL) {
+        ExpFreePoolProfiled(P);
+    }
+
     if (ExpPoolFlags & (EX_CHECK_POOL_FREES_FOR_ACTIVE_TIMERS |
                         EX_CHECK_POOL_FREES_FOR_ACTIVE_WORKERS |
                         EX_CHECK_POOL_FREES_FOR_ACTIVE_RESOURCES |
@@ -3706,13 +3823,14 @@ Return Value:
     PPOOL_TRACKER_BIG_PAGES SystemPoolEntryEnd;
     SIZE_T SnappedBigTableSize;
     SIZE_T SnappedBigTableSizeInBytes;
+    ULONG Index;
+    PPOOL_BIG_PAGE_SHARD Shard;
 
     PSYSTEM_BIGPOOL_ENTRY UserPoolEntry;
     PSYSTEM_BIGPOOL_INFORMATION UserPoolInfo;
 
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
 
-    NewTable = NULL;
     Status = STATUS_SUCCESS;
 
     UserPoolInfo = (PSYSTEM_BIGPOOL_INFORMATION)SystemInformation;
@@ -3720,67 +3838,375 @@ Return Value:
     TotalBytes = FIELD_OFFSET(SYSTEM_BIGPOOL_INFORMATION, AllocatedInfo);
     UserPoolInfo->Count = 0;
 
-    do {
-        SnappedBigTableSize = PoolBigPageTableSize;
-        SnappedBigTableSizeInBytes = SnappedBigTableSize * sizeof(POOL_TRACKER_BIG_PAGES);
+    // Snap and copy out each shard in turn so only one shard at a time is held exclusive.
+    for (Index = 0; Index < POOL_BIG_TABLE_SHARDS; Index += 1) {
+        Shard = &PoolBigPageShards[Index];
+        NewTable = NULL;
+
+        do {
+            SnappedBigTableSize = Shard->TableSize;
+            SnappedBigTableSizeInBytes = SnappedBigTableSize * sizeof(POOL_TRACKER_BIG_PAGES);
+
+            if (NewTable != NULL) {
+                MiFreePoolPages(NewTable);
+            }
 
-        if (NewTable != NULL) {
-            MiFreePoolPages(NewTable);
+            // Use MiAllocatePoolPages for the temporary buffer so we won't have to filter it out of the results before handing them back.
+            NewTable = MiAllocatePoolPages(NonPagedPool, SnappedBigTableSizeInBytes);
+            if (NewTable == NULL) {
+                return STATUS_INSUFFICIENT_RESOURCES;
+            }
+
+            OldIrql = ExAcquireSpinLockExclusive(&Shard->Lock);
+
+            if (SnappedBigTableSize >= Shard->TableSize) {
+                break;// Success - our table is big enough to hold everything.
+            }
+
+            ExReleaseSpinLockExclusive(&Shard->Lock, OldIrql);
+        } while (TRUE);
+
+        RtlCopyMemory(NewTable, Shard->Table, Shard->TableSize * sizeof(POOL_TRACKER_BIG_PAGES));
+
+        SnappedBigTableSize = Shard->TableSize;
+        ExReleaseSpinLockExclusive(&Shard->Lock, OldIrql);
+        SystemPoolEntry = NewTable;
+        SystemPoolEntryEnd = SystemPoolEntry + SnappedBigTableSize;
+
+        // Wrap the user space accesses with an exception handler so we can free the temp buffer if the user address was bogus.
+        try {
+            while (SystemPoolEntry < SystemPoolEntryEnd) {
+                if (((ULONG_PTR)SystemPoolEntry->Va & POOL_BIG_TABLE_ENTRY_FREE) == 0) {
+                    // This entry is in use so capture it.
+                    UserPoolInfo->Count += 1;
+                    TotalBytes += sizeof(SYSTEM_BIGPOOL_ENTRY);
+                    if (SystemInformationLength < TotalBytes) {
+                        Status = STATUS_INFO_LENGTH_MISMATCH;
+                    } else {
+                        UserPoolEntry->VirtualAddress = SystemPoolEntry->Va;
+                        if (MmDeterminePoolType(SystemPoolEntry->Va) == NonPagedPool) {
+                            UserPoolEntry->NonPaged = 1;
+                        }
+
+                        UserPoolEntry->TagUlong = SystemPoolEntry->Key & ~PROTECTED_POOL;
+                        UserPoolEntry->SizeInBytes = SystemPoolEntry->NumberOfPages << PAGE_SHIFT;
+                        UserPoolEntry += 1;
+                    }
+                }
+                SystemPoolEntry += 1;
+            }
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Status = GetExceptionCode();
         }
 
-        // Use MiAllocatePoolPages for the temporary buffer so we won't have to filter it out of the results before handing them back.
-        NewTable = MiAllocatePoolPages(NonPagedPool, SnappedBigTableSizeInBytes);
-        if (NewTable == NULL) {
-            return STATUS_INSUFFICIENT_RESOURCES;
+        MiFreePoolPages(NewTable);
+
+        if (!NT_SUCCESS(Status) && (Status != STATUS_INFO_LENGTH_MISMATCH)) {
+            break;
         }
+    }
 
-        OldIrql = ExAcquireSpinLockExclusive(&ExpLargePoolTableLock);
+    if (ARGUMENT_PRESENT(ReturnLength)) {
+        *ReturnLength = TotalBytes;
+    }
+
+    return Status;
+}
+
+
+DECLSPEC_NOINLINE PVOID ExpAllocatePoolProfiled(IN POOL_TYPE PoolType, IN SIZE_T NumberOfBytes, IN ULONG Tag, IN PVOID CallingAddress)
+/*
+Routine Description:
+    This function allocates a block of pool on behalf of an allocation that was selected as a profile sample,
+    captures the stack back trace of the allocation, and charges the allocation to the call site with that stack.
+Arguments:
+    PoolType - Supplies the type of pool to allocate.
+    NumberOfBytes - Supplies the number of bytes to allocate.
+    Tag - Supplies the caller's identifying tag.
+    CallingAddress - Supplies the address of the caller of ExAllocatePoolWithTag.
+Return Value:
+    The value returned by ExAllocatePoolWithTag.
+Environment:
+    Kernel mode, IRQL <= DISPATCH_LEVEL.
+    N.B. The stack is only walked below DISPATCH_LEVEL because unwinding may touch pageable image data. At DISPATCH_LEVEL only the immediate caller is recorded.
+*/
+{
+    PVOID BackTrace[POOL_PROFILE_FRAMES];
+    ULONG Depth;
+    ULONG Hash;
+    ULONG Index;
+    PPOOL_PROFILE_LIVE Live;
+    PVOID P;
+    ULONG Probe;
+    PPOOL_PROFILE_SITE Site;
+
+    // Rearm the sampling countdown of the current processor.
+    // N.B. The countdown is not updated with interlocked operations, so a context switch or migration can occasionally lose or add a sample.
+    ExpPoolProfileCounter[KeGetCurrentProcessorNumber()].Countdown = ExpPoolProfileInterval;
+
+    P = ExAllocatePoolWithTag(PoolType | POOL_PROFILE_MASK, NumberOfBytes, Tag);
+    if ((P == NULL) || (ExpPoolProfileSites == NULL)) {
+        return P;
+    }
 
-        if (SnappedBigTableSize >= PoolBigPageTableSize) {
-            break;// Success - our table is big enough to hold everything.
+    // Capture the stack back trace, skipping this routine and ExAllocatePoolWithTag.
+    Depth = 0;
+    Hash = 0;
+    if (KeGetCurrentIrql() < DISPATCH_LEVEL) {
+        Depth = RtlCaptureStackBackTrace(2, POOL_PROFILE_FRAMES, BackTrace, &Hash);
+    }
+
+    if (Depth == 0) {
+        BackTrace[0] = CallingAddress;
+        Depth = 1;
+        Hash = PtrToUlong(CallingAddress);
+    }
+
+    // A zero hash marks a free call site entry.
+    if (Hash == 0) {
+        Hash = 1;
+    }
+
+    // Look up the call site entry for the stack hash using linear probing, claiming a free entry with an interlocked compare exchange if the hash is not present.
+    Site = NULL;
+    Index = POOLTAG_HASH(Hash, POOL_PROFILE_SITES - 1);
+    for (Probe = 0; Probe < POOL_PROFILE_PROBES; Probe += 1) {
+        Site = &ExpPoolProfileSites[(Index + Probe) & (POOL_PROFILE_SITES - 1)];
+        if (Site->Hash == Hash) {
+            break;
         }
 
-        ExReleaseSpinLockExclusive(&ExpLargePoolTableLock, OldIrql);
-    } while (TRUE);
+        if ((Site->Hash == 0) && (InterlockedCompareExchange((PLONG)&Site->Hash, (LONG)Hash, 0) == 0)) {
+            Site->Tag = Tag;
+            RtlCopyMemory(&Site->BackTrace[0], &BackTrace[0], Depth * sizeof(PVOID));
+            Site->Depth = Depth;
+            break;
+        }
+
+        // Another thread may have claimed this entry for the same hash.
+        if (Site->Hash == Hash) {
+            break;
+        }
 
-    RtlCopyMemory(NewTable, PoolBigPageTable, PoolBigPageTableSize * sizeof(POOL_TRACKER_BIG_PAGES));
+        Site = NULL;
+    }
 
-    SnappedBigTableSize = PoolBigPageTableSize;
-    ExReleaseSpinLockExclusive(&ExpLargePoolTableLock, OldIrql);
-    SystemPoolEntry = NewTable;
-    SystemPoolEntryEnd = SystemPoolEntry + SnappedBigTableSize;
+    if (Site == NULL) {
+        InterlockedIncrement(&ExpPoolProfileDropped);
+        return P;
+    }
 
-    // Wrap the user space accesses with an exception handler so we can free the temp buffer if the user address was bogus.
-    try {
-        while (SystemPoolEntry < SystemPoolEntryEnd) {
-            if (((ULONG_PTR)SystemPoolEntry->Va & POOL_BIG_TABLE_ENTRY_FREE) == 0) {
-                // This entry is in use so capture it.
-                UserPoolInfo->Count += 1;
-                TotalBytes += sizeof(SYSTEM_BIGPOOL_ENTRY);
-                if (SystemInformationLength < TotalBytes) {
-                    Status = STATUS_INFO_LENGTH_MISMATCH;
-                } else {
-                    UserPoolEntry->VirtualAddress = SystemPoolEntry->Va;
-                    if (MmDeterminePoolType(SystemPoolEntry->Va) == NonPagedPool) {
-                        UserPoolEntry->NonPaged = 1;
-                    }
+    InterlockedIncrement(&Site->Allocations);
+
+    // Remember the allocation so its free can be charged back to the call site. The free cannot race with the insertion as the block has not been returned yet.
+    // If no live entry is free within the probe limit, then the allocation is counted but its bytes are not tracked as outstanding.
+    Index = POOL_PROFILE_LIVE_HASH(P);
+    for (Probe = 0; Probe < POOL_PROFILE_PROBES; Probe += 1) {
+        Live = &ExpPoolProfileLive[(Index + Probe) & (POOL_PROFILE_LIVE_ENTRIES - 1)];
+        if ((Live->Va == NULL) && (InterlockedCompareExchangePointer(&Live->Va, P, NULL) == NULL)) {
+            Live->Site = Site;
+            Live->NumberOfBytes = NumberOfBytes;
+            InterlockedExchangeAddSizeT(&Site->BytesOutstanding, NumberOfBytes);
+            return P;
+        }
+    }
 
-                    UserPoolEntry->TagUlong = SystemPoolEntry->Key & ~PROTECTED_POOL;
-                    UserPoolEntry->SizeInBytes = SystemPoolEntry->NumberOfPages << PAGE_SHIFT;
-                    UserPoolEntry += 1;
+    InterlockedIncrement(&ExpPoolProfileDropped);
+    return P;
+}
+
+
+VOID ExpFreePoolProfiled(IN PVOID P)
+/*
+Routine Description:
+    This function charges the free of a sampled allocation back to the call site that made the allocation.
+    Blocks which were not sampled are not found in the live table and are ignored.
+Arguments:
+    P - Supplies the address of the block of pool being deallocated.
+*/
+{
+    ULONG Index;
+    PPOOL_PROFILE_LIVE Live;
+    SIZE_T NumberOfBytes;
+    ULONG Probe;
+    PPOOL_PROFILE_SITE Site;
+
+    Index = POOL_PROFILE_LIVE_HASH(P);
+    for (Probe = 0; Probe < POOL_PROFILE_PROBES; Probe += 1) {
+        Live = &ExpPoolProfileLive[(Index + Probe) & (POOL_PROFILE_LIVE_ENTRIES - 1)];
+        if (Live->Va == P) {
+            // Capture the entry before releasing it as it may be immediately reused by another sampled allocation.
+            Site = Live->Site;
+            NumberOfBytes = Live->NumberOfBytes;
+            if (InterlockedCompareExchangePointer(&Live->Va, NULL, P) == P) {
+                // N.B. The site may be NULL if the tables were reset while this block was being inserted.
+                if (Site != NULL) {
+                    InterlockedIncrement(&Site->Frees);
+                    InterlockedExchangeAddSizeT(&Site->BytesOutstanding, 0 - NumberOfBytes);
                 }
             }
-            SystemPoolEntry += 1;
+
+            return;
         }
-    } except(EXCEPTION_EXECUTE_HANDLER)
-    {
-        Status = GetExceptionCode();
     }
+}
 
-    MiFreePoolPages(NewTable);
 
+NTSTATUS ExSetPoolProfile(IN ULONG SampleInterval, IN BOOLEAN Reset)
+/*
+Routine Description:
+    This function enables, disables or resets pool allocation profiling.
+Arguments:
+    SampleInterval - Supplies the number of allocations on each processor between samples. A value of zero disables sampling.
+    Reset - Supplies a boolean value that determines whether the recorded call sites are discarded.
+            The tables are only reset when sampling is disabled by the same call.
+Return Value:
+    STATUS_SUCCESS if the profile state was changed, STATUS_INVALID_PARAMETER if a reset was requested while enabling sampling,
+    or STATUS_INSUFFICIENT_RESOURCES if the profile tables could not be allocated.
+*/
+{
+    ULONG Index;
+    PPOOL_PROFILE_LIVE Live;
+    PPOOL_PROFILE_SITE Sites;
+
+    PAGED_CODE();
+
+    if ((Reset != FALSE) && (SampleInterval != 0)) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (SampleInterval == 0) {
+        ExpPoolProfileInterval = 0;
+        if ((Reset != FALSE) && (ExpPoolProfileSites != NULL)) {
+            RtlZeroMemory(ExpPoolProfileSites, POOL_PROFILE_SITES * sizeof(POOL_PROFILE_SITE));
+            RtlZeroMemory(ExpPoolProfileLive, POOL_PROFILE_LIVE_ENTRIES * sizeof(POOL_PROFILE_LIVE));
+            ExpPoolProfileDropped = 0;
+        }
+
+        return STATUS_SUCCESS;
+    }
+
+    // Allocate the profile tables the first time profiling is enabled.
+    // The tables must be allocated before the sample interval is set so these allocations are not sampled themselves.
+    if (ExpPoolProfileSites == NULL) {
+        Sites = ExAllocatePoolWithTag(NonPagedPool, POOL_PROFILE_SITES * sizeof(POOL_PROFILE_SITE), 'looP');
+        if (Sites == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        Live = ExAllocatePoolWithTag(NonPagedPool, POOL_PROFILE_LIVE_ENTRIES * sizeof(POOL_PROFILE_LIVE), 'looP');
+        if (Live == NULL) {
+            ExFreePool(Sites);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory(Sites, POOL_PROFILE_SITES * sizeof(POOL_PROFILE_SITE));
+        RtlZeroMemory(Live, POOL_PROFILE_LIVE_ENTRIES * sizeof(POOL_PROFILE_LIVE));
+        if (InterlockedCompareExchangePointer(&ExpPoolProfileLive, Live, NULL) != NULL) {
+            ExFreePool(Sites);
+            ExFreePool(Live);
+        } else {
+            InterlockedExchangePointer(&ExpPoolProfileSites, Sites);
+        }
+    }
+
+    if (ExpPoolProfileInterval == 0) {
+        ExpPoolProfileStartTime = KeQueryInterruptTime();
+    }
+
+    for (Index = 0; Index < MAXIMUM_PROCESSORS; Index += 1) {
+        ExpPoolProfileCounter[Index].Countdown = SampleInterval;
+    }
+
+    ExpPoolProfileInterval = SampleInterval;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS ExGetPoolProfileInfo(IN PVOID SystemInformation, IN ULONG SystemInformationLength, IN OUT PULONG ReturnLength OPTIONAL)
+/*
+Routine Description:
+    This function copies the recorded pool allocation call sites to the supplied buffer.
+    Note that the caller has already probed the USER address and wrapped this routine inside a try-except.
+    N.B. Call sites are updated concurrently, so the counts of an entry may not be exactly consistent with each other.
+Arguments:
+    SystemInformation - Supplies a user space buffer to copy the data to.
+    SystemInformationLength - Supplies the length of the user buffer.
+    ReturnLength - Supplies the number of bytes required to return all of the call sites.
+Return Value:
+    STATUS_SUCCESS if all of the call sites fit in the buffer, STATUS_INFO_LENGTH_MISMATCH otherwise.
+*/
+{
+    ULONG Count;
+    ULONG Depth;
+    ULONG Index;
+    PSYSTEM_POOL_PROFILE_INFORMATION Information;
+    ULONG Length;
+    PPOOL_PROFILE_SITE Site;
+    NTSTATUS Status;
+    PSYSTEM_POOL_PROFILE_ENTRY SystemEntry;
+
+    C_ASSERT(SYSTEM_POOL_PROFILE_FRAMES == POOL_PROFILE_FRAMES);
+
+    PAGED_CODE();
+
+    Length = FIELD_OFFSET(SYSTEM_POOL_PROFILE_INFORMATION, Entries);
+    if (SystemInformationLength < Length) {
+        if (ARGUMENT_PRESENT(ReturnLength)) {
+            *ReturnLength = Length;
+        }
+
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Status = STATUS_SUCCESS;
+    Information = (PSYSTEM_POOL_PROFILE_INFORMATION)SystemInformation;
+    Information->SampleInterval = ExpPoolProfileInterval;
+    Information->DroppedCount = (ULONG)ExpPoolProfileDropped;
+    Information->Reserved = 0;
+    Information->ElapsedTime = 0;
+    if (ExpPoolProfileInterval != 0) {
+        Information->ElapsedTime = KeQueryInterruptTime() - ExpPoolProfileStartTime;
+    }
+
+    Count = 0;
+    SystemEntry = &Information->Entries[0];
+    if (ExpPoolProfileSites != NULL) {
+        for (Index = 0; Index < POOL_PROFILE_SITES; Index += 1) {
+            Site = &ExpPoolProfileSites[Index];
+            if (Site->Hash == 0) {
+                continue;
+            }
+
+            Count += 1;
+            Length += sizeof(SYSTEM_POOL_PROFILE_ENTRY);
+            if (SystemInformationLength < Length) {
+                Status = STATUS_INFO_LENGTH_MISMATCH;
+                continue;
+            }
+
+            Depth = Site->Depth;
+            if (Depth > POOL_PROFILE_FRAMES) {
+                Depth = POOL_PROFILE_FRAMES;
+            }
+
+            SystemEntry->CallSiteHash = Site->Hash;
+            SystemEntry->Tag = Site->Tag & ~PROTECTED_POOL;
+            SystemEntry->Allocations = (ULONG)Site->Allocations;
+            SystemEntry->Frees = (ULONG)Site->Frees;
+            SystemEntry->BytesOutstanding = Site->BytesOutstanding;
+            SystemEntry->Depth = Depth;
+            SystemEntry->Reserved = 0;
+            RtlZeroMemory(&SystemEntry->BackTrace[0], sizeof(SystemEntry->BackTrace));
+            RtlCopyMemory(&SystemEntry->BackTrace[0], &Site->BackTrace[0], Depth * sizeof(PVOID));
+            SystemEntry += 1;
+        }
+    }
+
+    Information->NumberOfEntries = Count;
     if (ARGUMENT_PRESENT(ReturnLength)) {
-        *ReturnLength = TotalBytes;
+        *ReturnLength = Length;
     }
 
     return Status;
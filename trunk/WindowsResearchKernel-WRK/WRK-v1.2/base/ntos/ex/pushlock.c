@@ -108,6 +108,8 @@ VOID ExpInitializePushLocks(VOID);
 //#pragma alloc_text(PAGE, ExFreeCacheAwarePushLock)
 //#pragma alloc_text(PAGE, ExAcquireCacheAwarePushLockExclusive)
 //#pragma alloc_text(PAGE, ExReleaseCacheAwarePushLockExclusive)
+//#pragma alloc_text(PAGE, ExAcquireAutoExpandPushLockExclusive)
+//#pragma alloc_text(PAGE, ExReleaseAutoExpandPushLockExclusive)
 #pragma alloc_text(INIT, ExpInitializePushLocks)
 #endif
 
@@ -121,6 +123,10 @@ ULONG ExPushLockSpinCount = 0;
 #define USE_EXP_BACKOFF
 #endif
 
+// Number of contended shared acquires of an auto expand push lock after which the next exclusive owner expands it to a cache aware push lock.
+// The count is halved on every exclusive acquire that does not expand the push lock, so write mostly push locks are not expanded.
+ULONG ExPushLockExpandThreshold = 256;
+
 
 VOID ExpInitializePushLocks(VOID)
 /*
@@ -1004,4 +1010,71 @@ Arguments:
          Start++) {
         ExReleasePushLockExclusive(*Start);
     }
-}
\ No newline at end of file
+}
+
+
+NTKERNELAPI VOID FASTCALL ExfAcquireAutoExpandPushLockShared(__inout PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock)
+/*
+Routine Description:
+    Acquire the local lock of an auto expand push lock shared after the inline acquire found it owned.
+    N.B. The contention count is updated without an interlocked operation since it only needs to be approximate.
+Arguments:
+    AutoExpandPushLock - Auto expand push lock to be acquired
+*/
+{
+    AutoExpandPushLock->Contention += 1;
+    ExfAcquirePushLockShared(&AutoExpandPushLock->LocalLock);
+}
+
+
+NTKERNELAPI VOID ExAcquireAutoExpandPushLockExclusive(__inout PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock)
+/*
+Routine Description:
+    Acquire an auto expand push lock exclusive. If the shared acquires of the push lock have contended often enough,
+    then the push lock is expanded to a cache aware push lock while the local lock is owned exclusive.
+Arguments:
+    AutoExpandPushLock - Auto expand push lock to be acquired
+*/
+{
+    PEX_PUSH_LOCK_CACHE_AWARE CacheAwarePushLock;
+
+    ExAcquirePushLockExclusive(&AutoExpandPushLock->LocalLock);
+    CacheAwarePushLock = AutoExpandPushLock->CacheAwareLock;
+    if (CacheAwarePushLock != NULL) {
+        ExAcquireCacheAwarePushLockExclusive(CacheAwarePushLock);
+        return;
+    }
+
+#if !defined(NT_UP)
+    // If the contention threshold has not been reached, then decay the contention count. Otherwise, expand the push lock.
+
+    // N.B. The cache aware push lock is acquired exclusive before it is published, so shared acquires of the new slots wait for this owner.
+    if (AutoExpandPushLock->Contention < ExPushLockExpandThreshold) {
+        AutoExpandPushLock->Contention >>= 1;
+        return;
+    }
+
+    AutoExpandPushLock->Contention = 0;
+    CacheAwarePushLock = ExAllocateCacheAwarePushLock();
+    if (CacheAwarePushLock != NULL) {
+        ExAcquireCacheAwarePushLockExclusive(CacheAwarePushLock);
+        InterlockedExchangePointer(&AutoExpandPushLock->CacheAwareLock, CacheAwarePushLock);
+    }
+#endif
+}
+
+
+NTKERNELAPI VOID ExReleaseAutoExpandPushLockExclusive(__inout PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock)
+/*
+Routine Description:
+    Release an auto expand push lock exclusive.
+Arguments:
+    AutoExpandPushLock - Auto expand push lock to be released
+*/
+{
+    if (AutoExpandPushLock->CacheAwareLock != NULL) {
+        ExReleaseCacheAwarePushLockExclusive(AutoExpandPushLock->CacheAwareLock);
+    }
+
+    ExReleasePushLockExclusive(&AutoExpandPushLock->LocalLock);
+}
@@ -23,11 +23,47 @@ Environment:
 #define IsSharedWaiting(a) ((a)->NumberOfSharedWaiters != 0)
 #define IsOwnedExclusive(a) (((a)->Flag & ResourceOwnedExclusive) != 0)
 #define IsBoostAllowed(a) (((a)->Flag & DisablePriorityBoost) == 0)
+#define IsCacheAware(a) (((a)->Flag & ResourceCacheAware) != 0)
 
 // Define priority boost flags.
 
 #define DisablePriorityBoost 0x08
 
+// Define the maximum number of exclusively owned resources a priority inheritance chain is followed through.
+#define EXP_PRIORITY_INHERITANCE_DEPTH 4
+
+// Define the resource waiter object. The exclusive waiter event and the shared waiter semaphore are allocated as a waiter object
+// so the resource a thread is waiting for can be located from the thread's wait block when priority is inherited transitively.
+typedef struct _EXP_RESOURCE_WAITER {
+    union {
+        KEVENT Event;
+        KSEMAPHORE Semaphore;
+    };
+
+    PERESOURCE Resource;
+} EXP_RESOURCE_WAITER, *PEXP_RESOURCE_WAITER;
+
+// Define the shared counts of a cache aware resource. Shared acquisitions of a cache aware resource are counted in a cache line per processor
+// instead of the owner table, and an exclusive owner drains the counts of all processors before it is granted access.
+typedef struct _EXP_RESOURCE_SHARED_COUNT {
+    LONG Count;
+    UCHAR Pad[EX_CACHE_LINE_SIZE - sizeof(LONG)];
+} EXP_RESOURCE_SHARED_COUNT, *PEXP_RESOURCE_SHARED_COUNT;
+
+typedef struct _EXP_RESOURCE_SHARED_COUNTS {
+    union {
+        struct {
+            KEVENT DrainEvent;
+            ULONG Number;
+            BOOLEAN Draining;
+        };
+
+        UCHAR Pad[EX_CACHE_LINE_SIZE];
+    };
+
+    EXP_RESOURCE_SHARED_COUNT Processor[1];
+} EXP_RESOURCE_SHARED_COUNTS, *PEXP_RESOURCE_SHARED_COUNTS;
+
 LARGE_INTEGER ExShortTime = {(ULONG)(-10 * 1000 * 10), -1}; // 10 milliseconds
 
 #define EX_RESOURCE_CHECK_FREES   0x1
@@ -54,6 +90,8 @@ VOID ExpAssertResource(IN PERESOURCE Resource);
 #define EXP_UNLOCK_RESOURCE(_resource_, _plockhandle_) ExReleaseFastLock(&(_resource_)->SpinLock, *(_plockhandle_))
 #define EXP_LOCK_RESOURCE_RAISE   EXP_LOCK_RESOURCE
 #define EXP_UNLOCK_RESOURCE_RAISE EXP_UNLOCK_RESOURCE
+#define EXP_LOCK_RESOURCE_AT_SYNCH(_resource_, _plockhandle_) UNREFERENCED_PARAMETER(_plockhandle_)
+#define EXP_UNLOCK_RESOURCE_AT_SYNCH(_resource_, _plockhandle_)
 #else
 
 #define EXP_LOCK_HANDLE KLOCK_QUEUE_HANDLE
@@ -109,11 +147,33 @@ FORCEINLINE EXP_UNLOCK_RESOURCE_RAISE(IN PERESOURCE Resource, IN PEXP_LOCK_HANDL
     InterlockedAnd64((LONG64 *)&Resource->SpinLock, 0);
     KeLowerIrql(LockHandle->OldIrql);
 }
+
+
+FORCEINLINE VOID EXP_LOCK_RESOURCE_AT_SYNCH(IN PERESOURCE Resource, IN PEXP_LOCK_HANDLE LockHandle)
+{
+    UNREFERENCED_PARAMETER(LockHandle);
+
+    while (InterlockedBitTestAndSet64((LONG64 *)&Resource->SpinLock, 0) != FALSE) {
+        while (*(LONG64 volatile *)&Resource->SpinLock != 0) {
+            KeYieldProcessor();
+        }
+    }
+}
+
+
+FORCEINLINE EXP_UNLOCK_RESOURCE_AT_SYNCH(IN PERESOURCE Resource, IN PEXP_LOCK_HANDLE LockHandle)
+{
+    UNREFERENCED_PARAMETER(LockHandle);
+
+    InterlockedAnd64((LONG64 *)&Resource->SpinLock, 0);
+}
 #else
 #define EXP_LOCK_RESOURCE(_resource_, _plockhandle_) KeAcquireInStackQueuedSpinLock(&(_resource_)->SpinLock, (_plockhandle_))
 #define EXP_UNLOCK_RESOURCE(_resource_, _plockhandle_) KeReleaseInStackQueuedSpinLock(_plockhandle_)
 #define EXP_LOCK_RESOURCE_RAISE   EXP_LOCK_RESOURCE
 #define EXP_UNLOCK_RESOURCE_RAISE EXP_UNLOCK_RESOURCE
+#define EXP_LOCK_RESOURCE_AT_SYNCH(_resource_, _plockhandle_) KeAcquireInStackQueuedSpinLockAtDpcLevel(&(_resource_)->SpinLock, (_plockhandle_))
+#define EXP_UNLOCK_RESOURCE_AT_SYNCH(_resource_, _plockhandle_) KeReleaseInStackQueuedSpinLockFromDpcLevel(_plockhandle_)
 #endif
 #endif
 
@@ -184,16 +244,17 @@ Arguments:
     LockHandle - Supplies a pointer to a lock handle.
 */
 {
-    PKEVENT Event;
+    PEXP_RESOURCE_WAITER Waiter;
 
     // Allocate an exclusive wait event and retry the acquire operation.
     EXP_UNLOCK_RESOURCE(Resource, LockHandle);
     do {
-        Event = ExAllocatePoolWithTag(NonPagedPool, sizeof(KEVENT), 'vEeR');
-        if (Event != NULL) {
-            KeInitializeEvent(Event, SynchronizationEvent, FALSE);
-            if (InterlockedCompareExchangePointer(&Resource->ExclusiveWaiters, Event, NULL) != NULL) {
-                ExFreePool(Event);
+        Waiter = ExAllocatePoolWithTag(NonPagedPool, sizeof(EXP_RESOURCE_WAITER), 'vEeR');
+        if (Waiter != NULL) {
+            KeInitializeEvent(&Waiter->Event, SynchronizationEvent, FALSE);
+            Waiter->Resource = Resource;
+            if (InterlockedCompareExchangePointer(&Resource->ExclusiveWaiters, &Waiter->Event, NULL) != NULL) {
+                ExFreePool(Waiter);
             }
 
             break;
@@ -215,16 +276,17 @@ Arguments:
     LockHandle - Supplies a pointer to a lock handle.
 */
 {
-    PKSEMAPHORE Semaphore;
+    PEXP_RESOURCE_WAITER Waiter;
 
     // Allocate and initialize a shared wait semaphore for the specified resource.
     EXP_UNLOCK_RESOURCE(Resource, LockHandle);
     do {
-        Semaphore = ExAllocatePoolWithTag(NonPagedPool, sizeof(KSEMAPHORE), 'eSeR');
-        if (Semaphore != NULL) {
-            KeInitializeSemaphore(Semaphore, 0, MAXLONG);
-            if (InterlockedCompareExchangePointer(&Resource->SharedWaiters, Semaphore, NULL) != NULL) {
-                ExFreePool(Semaphore);
+        Waiter = ExAllocatePoolWithTag(NonPagedPool, sizeof(EXP_RESOURCE_WAITER), 'eSeR');
+        if (Waiter != NULL) {
+            KeInitializeSemaphore(&Waiter->Semaphore, 0, MAXLONG);
+            Waiter->Resource = Resource;
+            if (InterlockedCompareExchangePointer(&Resource->SharedWaiters, &Waiter->Semaphore, NULL) != NULL) {
+                ExFreePool(Waiter);
             }
 
             break;
@@ -236,6 +298,175 @@ Arguments:
 }
 
 
+FORCEINLINE VOID ExpRemoveOwnerPriority(IN ERESOURCE_THREAD OwnerThread)
+/*
+Routine Description:
+    This function removes the priority the specified owner thread has inherited from resource waiters once the thread has released its ownership.
+Arguments:
+    OwnerThread - Supplies the owner thread or owner pointer that released the resource.
+*/
+{
+    KIRQL OldIrql;
+    PKTHREAD Thread;
+
+    // If the owner is a thread rather than an owner pointer and the thread has inherited priority, then remove the inherited priority.
+    Thread = (PKTHREAD)OwnerThread;
+    if ((((ULONG_PTR)Thread & 0x3) == 0) && (Thread->PriorityInherited != FALSE)) {
+        KiLockDispatcherDatabase(&OldIrql);
+        KiRemoveInheritedPriority(Thread);
+        KiUnlockDispatcherDatabase(OldIrql);
+    }
+}
+
+
+FORCEINLINE VOID ExpDecrementSharedCount(IN PEXP_RESOURCE_SHARED_COUNTS SharedCounts, IN ULONG Index)
+/*
+Routine Description:
+    This function decrements the specified shared count of a cache aware resource and wakes an exclusive owner that is draining the shared counts.
+Arguments:
+    SharedCounts - Supplies a pointer to the shared counts of a cache aware resource.
+    Index - Supplies the index of the shared count to decrement.
+*/
+{
+    // N.B. The interlocked decrement is a full barrier, so either the draining owner observes the decrement when it sums the counts
+    //      or the decrement observes that the owner is draining.
+    InterlockedDecrement(&SharedCounts->Processor[Index].Count);
+    if (*((volatile BOOLEAN *)&SharedCounts->Draining) != FALSE) {
+        KeSetEvent(&SharedCounts->DrainEvent, 0, FALSE);
+    }
+}
+
+
+FORCEINLINE BOOLEAN ExpAcquireSharedCount(IN PERESOURCE Resource)
+/*
+Routine Description:
+    This function attempts to acquire a cache aware resource for shared access by incrementing the shared count of the current processor.
+Arguments:
+    Resource - Supplies a pointer to a cache aware resource.
+Return Value:
+    BOOLEAN - TRUE if shared access is granted and FALSE if the resource is owned exclusive.
+*/
+{
+    ULONG Index;
+    PEXP_RESOURCE_SHARED_COUNTS SharedCounts;
+
+    ASSERT(KeIsExecutingDpc() == FALSE);
+
+    EX_ENSURE_APCS_DISABLED(KeGetCurrentIrql(), Resource, KeGetCurrentThread());
+    SharedCounts = (PEXP_RESOURCE_SHARED_COUNTS)Resource->Address;
+    Index = KeGetCurrentProcessorNumber() % SharedCounts->Number;
+
+    // Count the acquisition and then check for an exclusive owner. If the resource is owned exclusive, then back out on the same count.
+
+    // N.B. Backing out on the same count guarantees that the sum of the counts never underestimates the number of shared owners.
+    InterlockedIncrement(&SharedCounts->Processor[Index].Count);
+    if ((*((volatile USHORT *)&Resource->Flag) & ResourceOwnedExclusive) == 0) {
+        return TRUE;
+    }
+
+    ExpDecrementSharedCount(SharedCounts, Index);
+    return FALSE;
+}
+
+
+FORCEINLINE VOID ExpReleaseSharedCount(IN PERESOURCE Resource)
+/*
+Routine Description:
+    This function releases a counted shared acquisition of a cache aware resource.
+    N.B. The acquisition may have been counted on another processor. Only the sum of the shared counts is meaningful.
+Arguments:
+    Resource - Supplies a pointer to a cache aware resource.
+*/
+{
+    PEXP_RESOURCE_SHARED_COUNTS SharedCounts;
+
+    SharedCounts = (PEXP_RESOURCE_SHARED_COUNTS)Resource->Address;
+    ExpDecrementSharedCount(SharedCounts, KeGetCurrentProcessorNumber() % SharedCounts->Number);
+}
+
+
+FORCEINLINE BOOLEAN ExpIsCountedSharedOwner(IN PERESOURCE Resource, IN ERESOURCE_THREAD OwnerThread)
+/*
+Routine Description:
+    This function determines whether a release of a cache aware resource by the specified owner releases a counted shared acquisition
+    rather than an owner entry.
+Arguments:
+    Resource - Supplies a pointer to a cache aware resource.
+    OwnerThread - Supplies the owner thread or owner pointer that releases the resource.
+Return Value:
+    BOOLEAN - TRUE if the release is for a counted shared acquisition and FALSE otherwise.
+*/
+{
+    EXP_LOCK_HANDLE LockHandle;
+    BOOLEAN Result;
+
+    // If the resource is owned exclusive, then the release is for the exclusive owner entry iff the specified owner is the exclusive owner.
+    if (IsOwnedExclusive(Resource)) {
+        return (BOOLEAN)(Resource->OwnerThreads[0].OwnerThread != OwnerThread);
+    }
+
+    // If there are no owner entries, then the release is for a counted acquisition. Otherwise, search the owner entries for the specified owner.
+
+    // N.B. Owner entries are only granted to shared owners of a cache aware resource that find it owned exclusive or with exclusive waiters.
+    if (Resource->ActiveCount == 0) {
+        return TRUE;
+    }
+
+    EXP_LOCK_RESOURCE(Resource, &LockHandle);
+    Result = (BOOLEAN)(ExpFindCurrentThread(Resource, OwnerThread, NULL) == NULL);
+    EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+    return Result;
+}
+
+
+BOOLEAN FASTCALL ExpDrainSharedCounts(IN PERESOURCE Resource, IN BOOLEAN Wait)
+/*
+Routine Description:
+    This function waits for the counted shared acquisitions of a cache aware resource to be released
+    after the current thread has been granted exclusive ownership of the resource.
+    N.B. No shared acquisitions are counted while the resource is owned exclusive.
+Arguments:
+    Resource - Supplies a pointer to a cache aware resource that is owned exclusive by the current thread.
+    Wait - A boolean value that specifies whether to wait for the counted shared acquisitions to be released.
+        If wait is not specified and there are counted shared acquisitions, then exclusive ownership is released.
+Return Value:
+    BOOLEAN - TRUE if exclusive access is granted and FALSE otherwise.
+*/
+{
+    ULONG Index;
+    PEXP_RESOURCE_SHARED_COUNTS SharedCounts;
+    LONG Total;
+
+    SharedCounts = (PEXP_RESOURCE_SHARED_COUNTS)Resource->Address;
+    SharedCounts->Draining = TRUE;
+    do {
+        // Clear the drain event and sum the shared counts.
+
+        // N.B. The memory barrier orders the exclusive ownership before the reads of the counts,
+        //      so a shared acquisition either observes the exclusive owner or is included in the sum.
+        KeClearEvent(&SharedCounts->DrainEvent);
+        KeMemoryBarrier();
+        Total = 0;
+        for (Index = 0; Index < SharedCounts->Number; Index += 1) {
+            Total += *((volatile LONG *)&SharedCounts->Processor[Index].Count);
+        }
+
+        if (Total == 0) {
+            SharedCounts->Draining = FALSE;
+            return TRUE;
+        }
+
+        if (Wait == FALSE) {
+            SharedCounts->Draining = FALSE;
+            ExReleaseResourceLite(Resource);
+            return FALSE;
+        }
+
+        KeWaitForSingleObject(&SharedCounts->DrainEvent, WrResource, KernelMode, FALSE, NULL);
+    } while (TRUE);
+}
+
+
 NTSTATUS ExInitializeResourceLite(__out PERESOURCE Resource)
 /*
 Routine Description:
@@ -269,6 +500,45 @@ Return Value:
 }
 
 
+NTSTATUS ExInitializeCacheAwareResourceLite(__out PERESOURCE Resource)
+/*
+Routine Description:
+    This routine initializes the specified resource as a cache aware resource.
+    Shared acquisitions of a cache aware resource that is not owned exclusive and has no exclusive waiters only increment a count in a cache line
+    of the current processor. They do not acquire the resource lock or update the owner table.
+    Exclusive acquisitions wait for the counted shared acquisitions to be released.
+    N.B. Counted shared acquisitions are not owned by a thread. A shared owner must not reacquire the resource while an exclusive acquisition
+         may be pending and ExIsResourceAcquiredSharedLite does not report counted shared acquisitions.
+         Cache aware resources are intended for read mostly resources whose shared owners do not acquire them recursively.
+Arguments:
+    Resource - Supplies a pointer to the resource to initialize.
+Return Value:
+    STATUS_SUCCESS if the resource is initialized and STATUS_INSUFFICIENT_RESOURCES if the shared counts cannot be allocated.
+*/
+{
+    ULONG Number;
+    PEXP_RESOURCE_SHARED_COUNTS SharedCounts;
+    SIZE_T Size;
+
+    Number = KeNumberProcessors;
+    Size = sizeof(EXP_RESOURCE_SHARED_COUNTS) + ((Number - 1) * sizeof(EXP_RESOURCE_SHARED_COUNT));
+    SharedCounts = ExAllocatePoolWithTag(NonPagedPoolCacheAligned, Size, 'cSeR');
+    if (SharedCounts == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(SharedCounts, Size);
+    KeInitializeEvent(&SharedCounts->DrainEvent, NotificationEvent, FALSE);
+    SharedCounts->Number = Number;
+    ExInitializeResourceLite(Resource);
+
+    // N.B. The address field locates the shared counts, so no creator back trace is recorded for a cache aware resource.
+    Resource->Address = SharedCounts;
+    Resource->Flag |= ResourceCacheAware;
+    return STATUS_SUCCESS;
+}
+
+
 NTSTATUS ExReinitializeResourceLite(__inout PERESOURCE Resource)
 /*
 Routine Description:
@@ -283,6 +553,7 @@ Return Value:
     ULONG Index;
     POWNER_ENTRY OwnerTable;
     PKSEMAPHORE Semaphore;
+    PEXP_RESOURCE_SHARED_COUNTS SharedCounts;
     ULONG TableSize;
 
     ASSERT(MmDeterminePoolType(Resource) == NonPagedPool);
@@ -297,9 +568,18 @@ Return Value:
         }
     }
 
-    // Set the active count and flags to zero.
+    // Set the active count and flags to zero. If the resource is cache aware, then it remains cache aware and the shared counts are zeroed.
     Resource->ActiveCount = 0;
-    Resource->Flag = 0;
+    Resource->Flag &= ResourceCacheAware;
+    if (IsCacheAware(Resource)) {
+        SharedCounts = (PEXP_RESOURCE_SHARED_COUNTS)Resource->Address;
+        for (Index = 0; Index < SharedCounts->Number; Index += 1) {
+            SharedCounts->Processor[Index].Count = 0;
+        }
+
+        SharedCounts->Draining = FALSE;
+        KeClearEvent(&SharedCounts->DrainEvent);
+    }
 
     // If the resource has a shared waiter semaphore, then reinitialize it.
     Semaphore = Resource->SharedWaiters;
@@ -404,6 +684,10 @@ retry:
 
                 // N.B. It is "safe" to store the owner thread without obtaining any locks since the thread has already been granted exclusive ownership.
                 Resource->OwnerThreads[0].OwnerThread = (ERESOURCE_THREAD)PsGetCurrentThread();
+                if (IsCacheAware(Resource)) {
+                    return ExpDrainSharedCounts(Resource, TRUE);
+                }
+
                 return TRUE;
             }
         }
@@ -417,6 +701,12 @@ retry:
     }
 
     EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+
+    // If exclusive ownership of a cache aware resource has just been granted, then wait for the counted shared acquisitions to be released.
+    if ((Result != FALSE) && IsCacheAware(Resource) && (Resource->OwnerThreads[0].OwnerCount == 1)) {
+        Result = ExpDrainSharedCounts(Resource, Wait);
+    }
+
     return Result;
 }
 
@@ -478,6 +768,12 @@ Return Value:
     }
 
     EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+
+    // If exclusive ownership of a cache aware resource has just been granted, then access can only be granted if there are no counted shared acquisitions.
+    if ((Result != FALSE) && IsCacheAware(Resource) && (Resource->OwnerThreads[0].OwnerCount == 1)) {
+        Result = ExpDrainSharedCounts(Resource, FALSE);
+    }
+
     return Result;
 }
 
@@ -502,6 +798,11 @@ Return Value:
     ASSERT(KeIsExecutingDpc() == FALSE);
     ASSERT_RESOURCE(Resource);
 
+    // If the resource is cache aware and there are no exclusive waiters, then attempt to count the shared acquisition on the current processor.
+    if (IsCacheAware(Resource) && (IsExclusiveWaiting(Resource) == FALSE) && ExpAcquireSharedCount(Resource)) {
+        return TRUE;
+    }
+
     EXP_LOCK_RESOURCE(Resource, &LockHandle);
 
     // Resource acquisition must be protected from thread suspends.
@@ -622,6 +923,12 @@ Return Value:
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ASSERT(KeIsExecutingDpc() == FALSE);
     ASSERT_RESOURCE(Resource);
+
+    // If the resource is cache aware, then attempt to count the shared acquisition on the current processor.
+    if (IsCacheAware(Resource) && ExpAcquireSharedCount(Resource)) {
+        return TRUE;
+    }
+
     EXP_LOCK_RESOURCE(Resource, &LockHandle);
     ExpIncrementCounter(StarveFirstLevel);
 
@@ -719,6 +1026,12 @@ Return Value:
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ASSERT(KeIsExecutingDpc() == FALSE);
     ASSERT_RESOURCE(Resource);
+
+    // If the resource is cache aware and there are no exclusive waiters, then attempt to count the shared acquisition on the current processor.
+    if (IsCacheAware(Resource) && (IsExclusiveWaiting(Resource) == FALSE) && ExpAcquireSharedCount(Resource)) {
+        return TRUE;
+    }
+
     EXP_LOCK_RESOURCE(Resource, &LockHandle);
     ExpIncrementCounter(WaitForExclusive);
 
@@ -878,6 +1191,12 @@ Arguments:
 
     ASSERT_RESOURCE(Resource);
 
+    // If the resource is cache aware and the release is for a counted shared acquisition, then decrement the shared count.
+    if (IsCacheAware(Resource) && ExpIsCountedSharedOwner(Resource, CurrentThread)) {
+        ExpReleaseSharedCount(Resource);
+        return;
+    }
+
     EXP_LOCK_RESOURCE(Resource, &LockHandle);// Acquire exclusive access to the specified resource.
     EX_ENSURE_APCS_DISABLED(LockHandle.OldIrql, Resource, KeGetCurrentThread());// Resource release must be protected from thread suspends.
 
@@ -915,6 +1234,7 @@ Arguments:
                 Resource->NumberOfSharedWaiters = 0;
                 EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
                 KeReleaseSemaphore(Resource->SharedWaiters, 0, Number, FALSE);
+                ExpRemoveOwnerPriority(CurrentThread);
                 return;
             } else if (IsExclusiveWaiting(Resource)) {
                 Resource->OwnerThreads[0].OwnerThread = 1;
@@ -923,6 +1243,7 @@ Arguments:
                 Resource->NumberOfExclusiveWaiters -= 1;
                 EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
                 KeSetEventBoostPriority(Resource->ExclusiveWaiters, (PRKTHREAD *)&Resource->OwnerThreads[0].OwnerThread);
+                ExpRemoveOwnerPriority(CurrentThread);
                 return;
             }
 
@@ -981,12 +1302,14 @@ Arguments:
                 Resource->NumberOfExclusiveWaiters -= 1;
                 EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
                 KeSetEventBoostPriority(Resource->ExclusiveWaiters, (PRKTHREAD *)&Resource->OwnerThreads[0].OwnerThread);
+                ExpRemoveOwnerPriority(CurrentThread);
                 return;
             }
         }
     }
 
     EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+    ExpRemoveOwnerPriority(CurrentThread);// The current thread no longer owns the resource.
 }
 
 
@@ -1022,6 +1345,12 @@ Arguments:
     ASSERT(CurrentThread != 0);
     ASSERT_RESOURCE(Resource);
 
+    // If the resource is cache aware and the release is for a counted shared acquisition, then decrement the shared count.
+    if (IsCacheAware(Resource) && ExpIsCountedSharedOwner(Resource, CurrentThread)) {
+        ExpReleaseSharedCount(Resource);
+        return;
+    }
+
     EXP_LOCK_RESOURCE(Resource, &LockHandle);// Acquire exclusive access to the specified resource.
     EX_ENSURE_APCS_DISABLED(LockHandle.OldIrql, Resource, KeGetCurrentThread());// Resource release must be protected from thread suspends.
 
@@ -1054,6 +1383,7 @@ Arguments:
                 Resource->NumberOfSharedWaiters = 0;
                 EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
                 KeReleaseSemaphore(Resource->SharedWaiters, 0, Number, FALSE);
+                ExpRemoveOwnerPriority(CurrentThread);
                 return;
             } else if (IsExclusiveWaiting(Resource)) {
                 Resource->OwnerThreads[0].OwnerThread = 1;
@@ -1062,6 +1392,7 @@ Arguments:
                 Resource->NumberOfExclusiveWaiters -= 1;
                 EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
                 KeSetEventBoostPriority(Resource->ExclusiveWaiters, (PRKTHREAD *)&Resource->OwnerThreads[0].OwnerThread);
+                ExpRemoveOwnerPriority(CurrentThread);
                 return;
             }
 
@@ -1126,12 +1457,14 @@ Arguments:
                 Resource->NumberOfExclusiveWaiters -= 1;
                 EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
                 KeSetEventBoostPriority(Resource->ExclusiveWaiters, (PRKTHREAD *)&Resource->OwnerThreads[0].OwnerThread);
+                ExpRemoveOwnerPriority(CurrentThread);
                 return;
             }
         }
     }
 
     EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+    ExpRemoveOwnerPriority(CurrentThread);// The current thread no longer owns the resource.
 }
 
 
@@ -1178,6 +1511,12 @@ Arguments:
         ExistingOwnerEntry = ExpFindCurrentThread(Resource, (ERESOURCE_THREAD)OwnerPointer, NULL);
         OwnerEntry = ExpFindCurrentThread(Resource, CurrentThread, NULL);
         if (OwnerEntry == NULL) {
+            // A counted shared acquisition of a cache aware resource has no owner entry and can be released for any owner.
+            if (IsCacheAware(Resource)) {
+                EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+                return;
+            }
+
             KeBugCheckEx(RESOURCE_NOT_OWNED, (ULONG_PTR)Resource, (ULONG_PTR)CurrentThread, (ULONG_PTR)Resource->OwnerTable, 0x3);
         }
 
@@ -1193,6 +1532,7 @@ Arguments:
     }
 
     EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
+    ExpRemoveOwnerPriority(CurrentThread);// The current thread no longer owns the resource.
 }
 
 
@@ -1263,6 +1603,11 @@ Return Value:
         ExFreePool(Resource->ExclusiveWaiters);
     }
 
+    // If the resource is cache aware, then free the shared counts to pool.
+    if (IsCacheAware(Resource)) {
+        ExFreePool(Resource->Address);
+    }
+
     return STATUS_SUCCESS;
 }
 
@@ -1425,7 +1770,9 @@ NTSTATUS ExQuerySystemLockInformation(__out_bcount(LockInformationLength) PRTL_P
                 LockInfo->Type = RTL_RESOURCE_TYPE;
                 LockInfo->CreatorBackTraceIndex = 0;
 #if i386 && !FPO
-                LockInfo->CreatorBackTraceIndex = (USHORT)Resource->CreatorBackTraceIndex;
+                if (IsCacheAware(Resource) == FALSE) {
+                    LockInfo->CreatorBackTraceIndex = (USHORT)Resource->CreatorBackTraceIndex;
+                }
 #endif // i386 && !FPO
 
                 if ((Resource->OwnerThreads[0].OwnerThread != 0) && ((Resource->OwnerThreads[0].OwnerThread & 3) == 0)) {
@@ -1457,49 +1804,117 @@ NTSTATUS ExQuerySystemLockInformation(__out_bcount(LockInformationLength) PRTL_P
 VOID FASTCALL ExpBoostOwnerThread(IN PKTHREAD CurrentThread, IN PKTHREAD OwnerThread)
 /*
 Routine Description:
-    This function boots the priority of the specified owner thread iff its priority is less than that of the current thread and is also less than fourteen.
+    This function makes the specified owner thread inherit the priority of the current thread iff its priority is less than that of the current thread.
+    If the owner is itself waiting for a mutant, then the mutant owners inherit the priority as well.
     N.B. this function is called with the dispatcher database lock held.
 Arguments:
     CurrentThread - Supplies a pointer to the current thread object.
     OwnerThread - Supplies a pointer to the owner thread object.
 */
 {
-    // If the owner thread is lower priority than the current thread, the current thread is running at a priority less than 14, 
-    // then boost the priority of the owner thread for a quantum.
+    // If the owner is a thread rather than an owner pointer, then the owner thread inherits the priority of the current thread until it releases the resource.
 
-    // N.B. A thread that has already been boosted may be reboosted to allow it to execute and release resources. 
-    // When the boost is removed, the thread will return to its priority before any boosting.
+    // N.B. The inherited priority does not decay at quantum end and is removed when the owner releases its ownership.
     if (((ULONG_PTR)OwnerThread & 0x3) == 0) {
-        if ((OwnerThread->Priority < CurrentThread->Priority) && (OwnerThread->Priority < 14)) {
-            KiAcquireThreadLock(OwnerThread);
-            OwnerThread->PriorityDecrement += 14 - OwnerThread->Priority;
-            OwnerThread->Quantum = OwnerThread->QuantumReset;
-            KiSetPriorityThread(OwnerThread, 14);
-            KiReleaseThreadLock(OwnerThread);
-        }
+        KiInheritPriorityChain(OwnerThread, CurrentThread->Priority);
     }
 }
 
 
+VOID FASTCALL ExpBoostOwnerThreads(IN PKTHREAD CurrentThread, IN PERESOURCE Resource)
+/*
+Routine Description:
+    This function makes the owner threads of the specified resource inherit the priority of the current thread.
+    If the resource is owned exclusive by a thread that is itself waiting for another resource,
+    then the owners of that resource inherit the priority as well.
+    N.B. this function is called with the dispatcher database lock held.
+
+    N.B. The resource lock of each resource is acquired while its owners are boosted so a thread that has already released its ownership,
+         and hence cannot remove the inherited priority, is never boosted. The resource lock is never held while the dispatcher database lock is acquired.
+Arguments:
+    CurrentThread - Supplies a pointer to the current thread object.
+    Resource - Supplies a pointer to the resource the current thread is waiting for.
+*/
+{
+    ULONG Depth;
+    ULONG Index;
+    EXP_LOCK_HANDLE LockHandle;
+    ULONG Number;
+    POWNER_ENTRY OwnerEntry;
+    PKTHREAD OwnerThread;
+    PEXP_RESOURCE_WAITER Waiter;
+
+    Depth = 0;
+    do {
+        EXP_LOCK_RESOURCE_AT_SYNCH(Resource, &LockHandle);
+
+        // Attempt to boost the one owner that can be shared or exclusive.
+        OwnerThread = (PKTHREAD)Resource->OwnerThreads[0].OwnerThread;
+        if (OwnerThread != NULL) {
+            ExpBoostOwnerThread(CurrentThread, OwnerThread);
+        }
+
+        // If the specified resource is not owned exclusive, then attempt to boost all the owning shared threads priority.
+        if (!IsOwnedExclusive(Resource)) {
+            OwnerThread = (PKTHREAD)Resource->OwnerThreads[1].OwnerThread;
+            if (OwnerThread != NULL) {
+                ExpBoostOwnerThread(CurrentThread, OwnerThread);
+            }
+
+            OwnerEntry = Resource->OwnerTable;
+            if (OwnerEntry != NULL) {
+                Number = OwnerEntry->TableSize;
+                for (Index = 1; Index < Number; Index += 1) {
+                    OwnerEntry += 1;
+                    OwnerThread = (PKTHREAD)OwnerEntry->OwnerThread;
+                    if (OwnerThread != NULL) {
+                        ExpBoostOwnerThread(CurrentThread, OwnerThread);
+                    }
+                }
+            }
+
+            EXP_UNLOCK_RESOURCE_AT_SYNCH(Resource, &LockHandle);
+            break;
+        }
+
+        // If the exclusive owner is a thread that is waiting for another resource, then continue with that resource.
+
+        // N.B. The waiting owner cannot release its ownership or stop waiting while the dispatcher database lock is held,
+        //      and the resource it is waiting for cannot be deleted while it has a waiter.
+        OwnerThread = (PKTHREAD)Resource->OwnerThreads[0].OwnerThread;
+        EXP_UNLOCK_RESOURCE_AT_SYNCH(Resource, &LockHandle);
+        if ((OwnerThread == NULL) ||
+            (((ULONG_PTR)OwnerThread & 0x3) != 0) ||
+            (OwnerThread->State != Waiting) ||
+            (OwnerThread->WaitReason != WrResource)) {
+            break;
+        }
+
+        Waiter = CONTAINING_RECORD(OwnerThread->WaitBlockList->Object, EXP_RESOURCE_WAITER, Event);
+        Resource = Waiter->Resource;
+        Depth += 1;
+    } while (Depth < EXP_PRIORITY_INHERITANCE_DEPTH);
+}
+
+
 VOID FASTCALL ExpWaitForResource(IN PERESOURCE Resource, IN PVOID Object)
 /*
 Routine Description:
     The routine waits for the specified resource object to be set.
-    If the wait is too long the priority of the current owners of the resource are boosted.
+    Before waiting, and each time the wait times out, the current owners of the resource inherit the priority of the waiting thread.
 Arguments:
     Resource - Supplies a pointer to the resource to wait for.
     Object - Supplies a pointer to an event (exclusive) or semaphore (shared) to wait for.
 */
 {
-    ULONG Index;
     ULONG Limit;
-    ULONG Number;
-    POWNER_ENTRY OwnerEntry;
-    PKTHREAD OwnerThread;
     NTSTATUS Status;
     PKTHREAD CurrentThread;
     LARGE_INTEGER Timeout;
 #if DBG
+    ULONG Index;
+    ULONG Number;
+    POWNER_ENTRY OwnerEntry;
     EXP_LOCK_HANDLE LockHandle;
 #endif
 
@@ -1508,6 +1923,20 @@ Arguments:
     Resource->ContentionCount += 1;
     Timeout.QuadPart = 500 * -10000;
     do {
+        // If priority boosts are allowed, then the owner threads inherit the priority of the current thread.
+        // Lock the dispatcher database and set wait next in the current thread so the dispatcher database lock does not need to be released before waiting for the resource.
+
+        // N.B. Owners are boosted before the first wait rather than after a timeout so a high priority waiter is not delayed by a low priority owner.
+        //      The boost is reapplied after each timeout in case an owner released another object and lost its inherited priority.
+
+        // N.B. The dispatcher lock is released by the wait.
+        if (IsBoostAllowed(Resource)) {
+            CurrentThread = KeGetCurrentThread();
+            KiLockDispatcherDatabase(&CurrentThread->WaitIrql);
+            CurrentThread->WaitNext = TRUE;
+            ExpBoostOwnerThreads(CurrentThread, Resource);
+        }
+
         Status = KeWaitForSingleObject(Object, WrResource, KernelMode, FALSE, &Timeout);
         if (Status != STATUS_TIMEOUT) {
             break;
@@ -1546,49 +1975,6 @@ Arguments:
             EXP_UNLOCK_RESOURCE(Resource, &LockHandle);
 #endif
         }
-
-        // If priority boosts are allowed, then attempt to boost the priority of owner threads.
-        if (IsBoostAllowed(Resource)) {
-            // Get the current thread address, lock the dispatcher database, 
-            // and set wait next in the current thread so the dispatcher database lock does not need to be released before waiting for the resource.
-
-            // N.B. Since the dispatcher database lock instead of the resource lock is being used to synchronize access to the resource, 
-            // it is possible for the information being read from the resource to be stale.
-            //      However, the important thing that cannot change is a valid thread address.
-            //      Thus a thread could possibly get boosted that actually has dropped its access to the resource, 
-            //      but it guaranteed that the thread cannot be terminated or otherwise deleted.
-
-            // N.B. The dispatcher lock is released by the wait at the top of loop.
-            CurrentThread = KeGetCurrentThread();
-            KiLockDispatcherDatabase(&CurrentThread->WaitIrql);
-            CurrentThread->WaitNext = TRUE;
-
-            // Attempt to boost the one owner that can be shared or exclusive.
-            OwnerThread = (PKTHREAD)Resource->OwnerThreads[0].OwnerThread;
-            if (OwnerThread != NULL) {
-                ExpBoostOwnerThread(CurrentThread, OwnerThread);
-            }
-
-            // If the specified resource is not owned exclusive, then attempt to boost all the owning shared threads priority.
-            if (!IsOwnedExclusive(Resource)) {
-                OwnerThread = (PKTHREAD)Resource->OwnerThreads[1].OwnerThread;
-                if (OwnerThread != NULL) {
-                    ExpBoostOwnerThread(CurrentThread, OwnerThread);
-                }
-
-                OwnerEntry = Resource->OwnerTable;
-                if (OwnerEntry != NULL) {
-                    Number = OwnerEntry->TableSize;
-                    for (Index = 1; Index < Number; Index += 1) {
-                        OwnerEntry += 1;
-                        OwnerThread = (PKTHREAD)OwnerEntry->OwnerThread;
-                        if (OwnerThread != NULL) {
-                            ExpBoostOwnerThread(CurrentThread, OwnerThread);
-                        }
-                    }
-                }
-            }
-        }
     } while (TRUE);
 }
 
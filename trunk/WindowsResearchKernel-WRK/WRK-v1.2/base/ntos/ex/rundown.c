@@ -616,6 +616,13 @@ Arguments:
         RunRef = EXP_GET_PROCESSOR_RUNDOWN_REF(RunRefCacheAware, Index);
         Value = RunRef->Count;//  Extract current count &  mark rundown active atomically
         do {
+            // If the structure has already been rundown and ExRundownCompletedCacheAware then there is nothing to wait for.
+            // This allows callers that might initiate rundown multiple times (like handle table rundown) to have subsequent rundowns become noops.
+            if (Value == EX_RUNDOWN_ACTIVE) {
+                Value = 0;
+                break;
+            }
+
             ASSERT((Value&EX_RUNDOWN_ACTIVE) == 0);
 
             //  Indicate that the on-stack count should be used for callers of release rundown protection
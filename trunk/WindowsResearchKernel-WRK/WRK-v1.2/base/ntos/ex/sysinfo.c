@@ -97,6 +97,7 @@ NTSTATUS ExpGetStackTraceInformation(OUT PVOID SystemInformation, IN ULONG Syste
 #endif
 NTSTATUS ExpGetLockInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
 NTSTATUS ExpGetLookasideInformation(OUT PVOID Buffer, IN ULONG BufferLength, OUT PULONG Length);
+NTSTATUS ExpGetLookasideTuningInformation(OUT PVOID Buffer, IN ULONG BufferLength, OUT PULONG Length);
 NTSTATUS ExpGetHandleInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
 NTSTATUS ExpGetHandleInformationEx(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
 NTSTATUS ExpGetObjectInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
@@ -107,6 +108,8 @@ NTSTATUS ExGetSessionPoolTagInfo(IN PVOID SystemInformation,
                                  IN OUT PULONG ReturnedEntries,
                                  IN OUT PULONG ActualEntries);
 NTSTATUS ExGetBigPoolInfo(IN PVOID SystemInformation, IN ULONG SystemInformationLength, IN OUT PULONG ReturnLength OPTIONAL);
+NTSTATUS ExGetPoolProfileInfo(IN PVOID SystemInformation, IN ULONG SystemInformationLength, IN OUT PULONG ReturnLength OPTIONAL);
+NTSTATUS ExSetPoolProfile(IN ULONG SampleInterval, IN BOOLEAN Reset);
 NTSTATUS ExpQueryModuleInformation(IN PLIST_ENTRY LoadOrderListHead,
                                    IN PLIST_ENTRY UserModeLoadOrderListHead,
                                    OUT PRTL_PROCESS_MODULES ModuleInformation,
@@ -1409,6 +1412,9 @@ Return Value:
                 LocalPerformanceInfo.CcCopyReadNoWait += Prcb->CcCopyReadNoWait;
                 LocalPerformanceInfo.CcCopyReadWait += Prcb->CcCopyReadWait;
                 LocalPerformanceInfo.CcCopyReadNoWaitMiss += Prcb->CcCopyReadNoWaitMiss;
+                LocalPerformanceInfo.CcMapDataNoWait += Prcb->CcMapDataNoWait;
+                LocalPerformanceInfo.CcMapDataWait += Prcb->CcMapDataWait;
+                LocalPerformanceInfo.CcPinReadWait += Prcb->CcPinReadWait;
             }
 #endif
             * PerformanceInfo = LocalPerformanceInfo;
@@ -1556,6 +1562,8 @@ Return Value:
             Status = ExpGetProcessInformation(ProcessInformation, ProcessInformationLength, ReturnLength, &SessionId, FALSE);
             break;
         case SystemCallCountInformation:
+            // Per service counts are only reported for service tables that were registered with a count table (see KeAddSystemServiceTable);
+            // the total number of system calls is always available from SystemPerformanceInformation.
             Length = sizeof(SYSTEM_CALL_COUNT_INFORMATION) + (NUMBER_SERVICE_TABLES * sizeof(ULONG));
             Table = KeServiceDescriptorTableShadow;
 
@@ -1683,6 +1691,11 @@ Return Value:
             break;
         case SystemHandleInformation:
             if (SystemInformationLength < sizeof(SYSTEM_HANDLE_INFORMATION)) {
+                // Return an estimate of the required length so callers can size the buffer without a failed full snapshot.
+                if (ARGUMENT_PRESENT(ReturnLength)) {
+                    *ReturnLength = FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION, Handles) + (ObGetHandleCount() * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO));
+                }
+
                 return STATUS_INFO_LENGTH_MISMATCH;
             }
 
@@ -1697,6 +1710,10 @@ Return Value:
             break;
         case SystemExtendedHandleInformation:
             if (SystemInformationLength < sizeof(SYSTEM_HANDLE_INFORMATION_EX)) {
+                if (ARGUMENT_PRESENT(ReturnLength)) {
+                    *ReturnLength = FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles) + (ObGetHandleCount() * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX));
+                }
+
                 return STATUS_INFO_LENGTH_MISMATCH;
             }
 
@@ -1990,6 +2007,48 @@ Return Value:
                 *ReturnLength = Length;
             }
 
+            break;
+        case SystemLookasideTuningInformation:
+            Status = ExpGetLookasideTuningInformation(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+        case SystemZeroPageInformation:
+            Status = MmGetZeroPageInformation(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+        case SystemModifiedWriterInformation:
+            Status = MmGetModifiedWriterInformation(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+        case SystemAweMapInformation:
+            Status = MmGetAweMapInformation(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+        case SystemCacheManagerInformation:
+            Status = CcGetCacheManagerInformation(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+        case SystemProcessChangeInformation:
+            Status = PsQueryProcessChanges(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
             break;
         case SystemRangeStartInformation:
             if (SystemInformationLength != sizeof(ULONG_PTR)) {
@@ -2139,6 +2198,64 @@ Return Value:
 
             Status = ExpGetSystemFirmwareTableInformation(SystemInformation, PreviousMode, ReturnLength);
             break;
+        case SystemTimerCoalescingInformation:
+            if (SystemInformationLength != sizeof(SYSTEM_TIMER_COALESCING_INFORMATION)) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            // Return the number of timers that were inserted with the same due time as a timer already in the timer table.
+            ((PSYSTEM_TIMER_COALESCING_INFORMATION)SystemInformation)->CoalescedExpirations = (ULONG)KiTimerCoalescedExpirations;
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = sizeof(SYSTEM_TIMER_COALESCING_INFORMATION);
+            }
+
+            break;
+        case SystemLockProfileInformation:
+#if defined(_AMD64_)
+            // The lock profile exposes kernel addresses so the caller must have the privilege to profile the system.
+            if ((PreviousMode != KernelMode) && !SeSinglePrivilegeCheck(SeSystemProfilePrivilege, PreviousMode)) {
+                return STATUS_PRIVILEGE_NOT_HELD;
+            }
+
+            Status = KiQueryLockProfile(SystemInformation, SystemInformationLength, &Length);
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+#else
+            Status = STATUS_NOT_SUPPORTED;
+#endif
+            break;
+        case SystemDpcLatencyInformation:
+        {
+            PSYSTEM_DPC_LATENCY_INFORMATION LatencyInformation;
+
+            C_ASSERT(SYSTEM_DPC_LATENCY_BUCKETS == DPC_HISTOGRAM_BUCKETS);
+
+            if (SystemInformationLength < (sizeof(SYSTEM_DPC_LATENCY_INFORMATION) * KeNumberProcessors)) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            LatencyInformation = (PSYSTEM_DPC_LATENCY_INFORMATION)SystemInformation;
+            for (i = 0; i < (ULONG)KeNumberProcessors; i++) {
+                RtlCopyMemory(&LatencyInformation->QueueLatency[0], &KiDpcHistogram[i].QueueLatency[0], sizeof(LatencyInformation->QueueLatency));
+                RtlCopyMemory(&LatencyInformation->ExecutionTime[0], &KiDpcHistogram[i].ExecutionTime[0], sizeof(LatencyInformation->ExecutionTime));
+                LatencyInformation->OffloadCount = KiDpcHistogram[i].OffloadCount;
+                ++LatencyInformation;
+            }
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = sizeof(SYSTEM_DPC_LATENCY_INFORMATION) * KeNumberProcessors;
+            }
+        }
+        break;
+        case SystemPoolProfileInformation:
+            // The pool profile exposes kernel addresses so the caller must have the privilege to profile the system.
+            if ((PreviousMode != KernelMode) && !SeSinglePrivilegeCheck(SeSystemProfilePrivilege, PreviousMode)) {
+                return STATUS_PRIVILEGE_NOT_HELD;
+            }
+
+            Status = ExGetPoolProfileInfo(SystemInformation, SystemInformationLength, ReturnLength);
+            break;
         default:
             return STATUS_INVALID_INFO_CLASS;// Invalid argument.
         }
@@ -2798,6 +2915,80 @@ Return Value:
         case SystemRegisterFirmwareTableInformationHandler:
             Status = ExpRegisterFirmwareTableInformationHandler(SystemInformation, SystemInformationLength, PreviousMode);
             break;
+        case SystemLockProfileInformation:
+        {
+            ULONG Enable;
+
+            // If the system information buffer is not the correct length, then return an error.
+            if (SystemInformationLength != sizeof(ULONG)) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            if (PreviousMode != KernelMode) {
+                if (!SeSinglePrivilegeCheck(SeSystemProfilePrivilege, PreviousMode)) {
+                    return STATUS_PRIVILEGE_NOT_HELD;
+                }
+            }
+
+            Enable = *(PULONG)SystemInformation;// Exception handler for this routine will return the correct error if this access fails.
+
+#if defined(_AMD64_)
+            Status = KiSetLockProfile((BOOLEAN)(Enable != 0));
+#else
+            UNREFERENCED_PARAMETER(Enable);
+            Status = STATUS_NOT_SUPPORTED;
+#endif
+        }
+        break;
+        case SystemDpcLatencyInformation:
+        {
+            SYSTEM_DPC_LATENCY_CONTROL LatencyControl;
+
+            // If the system information buffer is not the correct length, then return an error.
+            if (SystemInformationLength != sizeof(SYSTEM_DPC_LATENCY_CONTROL)) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            if (PreviousMode != KernelMode) {
+                // The caller's access mode is not kernel so check to ensure that the caller has the privilege to load a driver.
+                if (!SeSinglePrivilegeCheck(SeLoadDriverPrivilege, PreviousMode)) {
+                    return STATUS_PRIVILEGE_NOT_HELD;
+                }
+            }
+
+            LatencyControl = *(PSYSTEM_DPC_LATENCY_CONTROL)SystemInformation;// Exception handler for this routine will return the correct error if this access fails.
+
+            // If a reset is requested, then clear the histograms and forget the deferred routines that have been offloaded.
+            // N.B. Samples that are being counted concurrently may be lost.
+            if (LatencyControl.ResetHistograms != FALSE) {
+                RtlZeroMemory(&KiDpcHistogram[0], sizeof(KiDpcHistogram));
+                RtlZeroMemory(&KiDpcOffloadRoutine[0], sizeof(KiDpcOffloadRoutine));
+            }
+
+            // Set the new DPC latency variables.
+            KiDpcOffloadThreshold = LatencyControl.OffloadThreshold;
+            KiDpcHistogramEnabled = (BOOLEAN)(LatencyControl.EnableHistograms != FALSE);
+        }
+        break;
+        case SystemPoolProfileInformation:
+        {
+            SYSTEM_POOL_PROFILE_CONTROL ProfileControl;
+
+            // If the system information buffer is not the correct length, then return an error.
+            if (SystemInformationLength != sizeof(SYSTEM_POOL_PROFILE_CONTROL)) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            if (PreviousMode != KernelMode) {
+                if (!SeSinglePrivilegeCheck(SeSystemProfilePrivilege, PreviousMode)) {
+                    return STATUS_PRIVILEGE_NOT_HELD;
+                }
+            }
+
+            ProfileControl = *(PSYSTEM_POOL_PROFILE_CONTROL)SystemInformation;// Exception handler for this routine will return the correct error if this access fails.
+            Status = ExSetPoolProfile(ProfileControl.SampleInterval, ProfileControl.Reset);
+        }
+        break;
         default:
             Status = STATUS_INVALID_INFO_CLASS;
             break;
@@ -2912,6 +3103,7 @@ Return Value:
 {
     KLOCK_QUEUE_HANDLE LockHandle;
     PEPROCESS Process = NULL;
+    PS_PROCESS_ENUM_CONTEXT EnumContext;
     PETHREAD Thread;
     PSYSTEM_PROCESS_INFORMATION ProcessInfo;
     PVOID ThreadInfo;
@@ -2956,11 +3148,13 @@ Return Value:
     }
 
     ProcessInfo = (PSYSTEM_PROCESS_INFORMATION)MappedAddress;
+    EnumContext.Count = 0;
     try {
         // Do the idle process first then all the other processes.
+        // The processes are referenced in batches so that pollers of this class do not take the process list lock once per process.
         for (Process = PsIdleProcess;
              Process != NULL;
-             Process = PsGetNextProcess((Process == PsIdleProcess) ? NULL : Process)) {
+             Process = PsGetNextProcessBatched(&EnumContext, (Process == PsIdleProcess) ? NULL : Process)) {
             // If the process is marked as exiting, the executive process has no active threads,
             // the kernel process has no threads, and the kernel process has been signaled, then skip the process.
 
@@ -3122,9 +3316,7 @@ Return Value:
             *Length = TotalSize;
         }
     } finally {
-        if ((Process != NULL) && (Process != PsIdleProcess)) {
-            PsQuitNextProcess(Process);
-        }
+        PsQuitNextProcessBatched(&EnumContext, (Process != PsIdleProcess) ? Process : NULL);
 
         if (MappedAddress != NULL) {
             ExUnlockUserBuffer(LockVariable);
@@ -3821,6 +4013,148 @@ Return Value:
 }
 
 
+FORCEINLINE VOID ExpCopyLookasideTuningInformation(OUT PSYSTEM_LOOKASIDE_TUNING_INFORMATION Information,
+                                                   IN PGENERAL_LOOKASIDE Lookaside,
+                                                   IN ULONG AllocateMisses,
+                                                   IN ULONG Type)
+/*
+Routine Description:
+    This function copies the depth and tuning history of a lookaside list to a lookaside tuning information entry.
+Arguments:
+    Information - Supplies a pointer to the lookaside tuning information entry.
+    Lookaside - Supplies a pointer to a lookaside list descriptor.
+    AllocateMisses - Supplies the total number of allocate misses of the lookaside list.
+    Type - Supplies the type reported for the lookaside list.
+*/
+{
+    PLOOKASIDE_TUNING Tuning;
+
+    Tuning = EX_LOOKASIDE_TUNING(Lookaside);
+    Information->CurrentDepth = ExQueryDepthSList(&Lookaside->ListHead);
+    Information->MaximumDepth = Lookaside->Depth;
+    Information->PeakDepth = Tuning->PeakDepth;
+    Information->HitRatio = (USHORT)(1000 - Tuning->MissRatio);
+    Information->DepthHistory[0] = Tuning->DepthHistory[0];
+    Information->DepthHistory[1] = Tuning->DepthHistory[1];
+    Information->TotalAllocates = Lookaside->TotalAllocates;
+    Information->AllocateMisses = AllocateMisses;
+    Information->Type = Type;
+    Information->Tag = Lookaside->Tag;
+    Information->Size = Lookaside->Size;
+}
+
+
+NTSTATUS ExpGetLookasideTuningInformation(OUT PVOID Buffer, IN ULONG BufferLength, OUT PULONG Length)
+/*
+Routine Description:
+    This function returns the depth tuning history of the pool, system, and general lookaside lists.
+    The lists are returned in the same order as the lookaside list information.
+Arguments:
+    Buffer - Supplies a pointer to the buffer which receives the lookaside tuning information.
+    BufferLength - Supplies the length of the information buffer in bytes.
+    Length - Supplies a pointer to a variable that receives the length of lookaside tuning information returned.
+Return Value:
+    Returns one of the following status codes:
+        STATUS_SUCCESS - Normal, successful completion.
+        STATUS_ACCESS_VIOLATION - The buffer could not be locked in memory.
+*/
+{
+    PVOID BufferLock;
+    PLIST_ENTRY Entry;
+    PSYSTEM_LOOKASIDE_TUNING_INFORMATION Information;
+    KIRQL OldIrql;
+    ULONG Limit;
+    PGENERAL_LOOKASIDE Lookaside;
+    ULONG Number;
+    PKSPIN_LOCK SpinLock;
+    NTSTATUS Status;
+
+    // Compute the number of lookaside entries and set the return status to success.
+    Limit = BufferLength / sizeof(SYSTEM_LOOKASIDE_TUNING_INFORMATION);
+    Number = 0;
+    Status = STATUS_SUCCESS;
+
+    // If the number of lookaside entries to return is not zero, then collect the lookaside tuning information.
+    if (Limit != 0) {
+        Status = ExLockUserBuffer(Buffer, BufferLength, KeGetPreviousMode(), IoWriteAccess, &Information, &BufferLock);
+        if (NT_SUCCESS(Status)) {
+            Status = STATUS_SUCCESS;
+
+            // Copy nonpaged and paged pool lookaside tuning information to information buffer.
+            Entry = ExPoolLookasideListHead.Flink;
+            while (Entry != &ExPoolLookasideListHead) {
+                Lookaside = CONTAINING_RECORD(Entry, GENERAL_LOOKASIDE, ListEntry);
+                ExpCopyLookasideTuningInformation(Information, Lookaside, Lookaside->TotalAllocates - Lookaside->AllocateHits, Lookaside->Type);
+                Number += 1;
+                if (Number == Limit) {
+                    goto Finish2;
+                }
+
+                Entry = Entry->Flink;
+                Information += 1;
+            }
+
+            // Copy nonpaged and paged system lookaside tuning information to information buffer.
+            Entry = ExSystemLookasideListHead.Flink;
+            while (Entry != &ExSystemLookasideListHead) {
+                Lookaside = CONTAINING_RECORD(Entry, GENERAL_LOOKASIDE, ListEntry);
+                ExpCopyLookasideTuningInformation(Information, Lookaside, Lookaside->AllocateMisses, Lookaside->Type);
+                Number += 1;
+                if (Number == Limit) {
+                    goto Finish2;
+                }
+
+                Entry = Entry->Flink;
+                Information += 1;
+            }
+
+            // Copy nonpaged general lookaside tuning information to buffer.
+            SpinLock = &ExNPagedLookasideLock;
+            ExAcquireSpinLock(SpinLock, &OldIrql);
+            Entry = ExNPagedLookasideListHead.Flink;
+            while (Entry != &ExNPagedLookasideListHead) {
+                Lookaside = &CONTAINING_RECORD(Entry, NPAGED_LOOKASIDE_LIST, L.ListEntry)->L;
+                ExpCopyLookasideTuningInformation(Information, Lookaside, Lookaside->AllocateMisses, 0);
+                Number += 1;
+                if (Number == Limit) {
+                    goto Finish1;
+                }
+
+                Entry = Entry->Flink;
+                Information += 1;
+            }
+
+            ExReleaseSpinLock(SpinLock, OldIrql);
+
+            // Copy paged general lookaside tuning information to buffer.
+            SpinLock = &ExPagedLookasideLock;
+            ExAcquireSpinLock(SpinLock, &OldIrql);
+            Entry = ExPagedLookasideListHead.Flink;
+            while (Entry != &ExPagedLookasideListHead) {
+                Lookaside = &CONTAINING_RECORD(Entry, PAGED_LOOKASIDE_LIST, L.ListEntry)->L;
+                ExpCopyLookasideTuningInformation(Information, Lookaside, Lookaside->AllocateMisses, 1);
+                Number += 1;
+                if (Number == Limit) {
+                    goto Finish1;
+                }
+
+                Entry = Entry->Flink;
+                Information += 1;
+            }
+
+        Finish1:
+            ExReleaseSpinLock(SpinLock, OldIrql);
+
+        Finish2:
+            ExUnlockUserBuffer(BufferLock);// Unlock user buffer.
+        }
+    }
+
+    *Length = Number * sizeof(SYSTEM_LOOKASIDE_TUNING_INFORMATION);
+    return Status;
+}
+
+
 NTSTATUS ExpGetHandleInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length)
 /*
 Routine Description:
@@ -30,6 +30,7 @@ typedef struct
 {
     WORK_QUEUE_ITEM WorkItem;
     WORK_QUEUE_TYPE QueueType;
+    ULONG           Node;
     PETHREAD        PrevThread;
 } SHUTDOWN_WORK_ITEM, * PSHUTDOWN_WORK_ITEM;
 
@@ -66,8 +67,15 @@ typedef struct _EXP_WORKER_LINK
 // Flag to pass in to the worker thread, indicating whether it is dynamic or not.
 #define DYNAMIC_WORKER_THREAD 0x80000000
 
-// Per-queue dynamic thread state.
-EX_WORK_QUEUE ExWorkerQueue[MaximumWorkQueue];
+// Shift of the node number passed in to the worker thread and mask of the queue type.
+#define WORKER_NODE_SHIFT 16
+#define WORKER_QUEUE_TYPE_MASK 0xFFFF
+
+// Per-node, per-queue dynamic thread state.
+// The queues of node 0 come first, so ExWorkerQueue[QueueType] is the queue of that type for node 0.
+EX_WORK_QUEUE ExWorkerQueue[MAXIMUM_CCNUMA_NODES * MaximumWorkQueue];
+
+#define EXP_WORKER_QUEUE(Node, QueueType) (&ExWorkerQueue[((Node) * MaximumWorkQueue) + (QueueType)])
 
 // Additional worker threads... Controlled using registry settings
 
@@ -102,14 +110,14 @@ PVOID ExpDebuggerPageIn;
 ULONG ExpDebuggerWork;
 
 VOID ExpCheckDynamicThreadCount(VOID);
-NTSTATUS ExpCreateWorkerThread(WORK_QUEUE_TYPE QueueType, BOOLEAN Dynamic);
+NTSTATUS ExpCreateWorkerThread(WORK_QUEUE_TYPE QueueType, ULONG Node, BOOLEAN Dynamic);
 VOID ExpDetectWorkerThreadDeadlock(VOID);
 VOID ExpWorkerThreadBalanceManager(IN PVOID StartContext);
 VOID ExpSetSwappingKernelApc(IN PKAPC Apc, OUT PKNORMAL_ROUTINE* NormalRoutine, IN OUT PVOID NormalContext, IN OUT PVOID* SystemArgument1, IN OUT PVOID* SystemArgument2);
 
 // Procedure prototypes for the worker threads.
 VOID ExpWorkerThread(IN PVOID StartContext);
-LOGICAL ExpCheckQueueShutdown(IN WORK_QUEUE_TYPE QueueType, IN PSHUTDOWN_WORK_ITEM ShutdownItem);
+LOGICAL ExpCheckQueueShutdown(IN WORK_QUEUE_TYPE QueueType, IN ULONG Node, IN PSHUTDOWN_WORK_ITEM ShutdownItem);
 VOID ExpShutdownWorker(IN PVOID Parameter);
 VOID ExpDebuggerWorker(IN PVOID Context);
 
@@ -155,14 +163,66 @@ Return Value:
 }
 
 
+LOGICAL __forceinline ExpIsWorkerQueueIdle(IN PEX_WORK_QUEUE Queue)
+/*
+Routine Description:
+    This function determines whether the supplied worker queue has a worker thread waiting for work that could run a work item immediately.
+    N.B. The queue state is read without synchronization, so the result is only a hint.
+Arguments:
+    Queue - Supplies the queue that should be examined.
+Return Value:
+    TRUE if the queue has an idle worker thread, FALSE if not.
+*/
+{
+    return (LOGICAL)((IsListEmpty(&Queue->WorkerQueue.Header.WaitListHead) == FALSE) && (Queue->WorkerQueue.CurrentCount < Queue->WorkerQueue.MaximumCount));
+}
+
+
+PEX_WORK_QUEUE __forceinline ExpSelectWorkerQueue(IN WORK_QUEUE_TYPE QueueType)
+/*
+Routine Description:
+    This function selects the worker queue a work item of the supplied type is inserted in.
+    Work items are inserted in the queue of the current node. If that queue has no idle worker thread, then the queue of another node is used if it has one.
+Arguments:
+    QueueType - Supplies the type of the work queue.
+Return Value:
+    A pointer to the selected worker queue.
+*/
+{
+    ULONG Index;
+    ULONG Node;
+    PEX_WORK_QUEUE Queue;
+    PEX_WORK_QUEUE RemoteQueue;
+
+    Node = KeGetCurrentNode()->NodeNumber;
+    Queue = EXP_WORKER_QUEUE(Node, QueueType);
+    if ((KeNumberNodes == 1) || (ExpIsWorkerQueueIdle(Queue) != FALSE)) {
+        return Queue;
+    }
+
+    for (Index = 1; Index < KeNumberNodes; Index += 1) {
+        RemoteQueue = EXP_WORKER_QUEUE((Node + Index) % KeNumberNodes, QueueType);
+        if (ExpIsWorkerQueueIdle(RemoteQueue) != FALSE) {
+            return RemoteQueue;
+        }
+    }
+
+    return Queue;
+}
+
+
 NTSTATUS ExpWorkerInitialization(VOID)
 {
+    KAFFINITY Affinity;
     ULONG Index;
+    ULONG Node;
+    ULONG NumberOfProcessors;
     OBJECT_ATTRIBUTES ObjectAttributes;
     ULONG NumberOfDelayedThreads;
     ULONG NumberOfCriticalThreads;
     ULONG NumberOfThreads;
     NTSTATUS Status;
+    PEX_WORK_QUEUE Queue;
     HANDLE Thread;
     BOOLEAN NtAs;
     WORK_QUEUE_TYPE WorkQueueType;
@@ -207,54 +267,65 @@ NTSTATUS ExpWorkerInitialization(VOID)
         ExpAdditionalDelayedWorkerThreads = MAX_ADDITIONAL_THREADS;
     }
 
-    // Initialize the ExWorkerQueue[] array.
-    RtlZeroMemory(&ExWorkerQueue[0], MaximumWorkQueue * sizeof(EX_WORK_QUEUE));
-    for (WorkQueueType = 0; WorkQueueType < MaximumWorkQueue; WorkQueueType += 1) {
-        KeInitializeQueue(&ExWorkerQueue[WorkQueueType].WorkerQueue, 0);
-        ExWorkerQueue[WorkQueueType].Info.WaitMode = UserMode;
-    }
+    // Initialize the ExWorkerQueue[] array. Each node has a set of work queues whose concurrency is the number of processors in the node.
+    RtlZeroMemory(&ExWorkerQueue[0], sizeof(ExWorkerQueue));
+    for (Node = 0; Node < KeNumberNodes; Node += 1) {
+        NumberOfProcessors = 0;
+        if (KeNumberNodes > 1) {
+            for (Affinity = KeNodeBlock[Node]->ProcessorMask; Affinity != 0; Affinity &= (Affinity - 1)) {
+                NumberOfProcessors += 1;
+            }
+        }
 
-    // Always make stack for this thread resident so that worker pool deadlock magic can run even when what we are trying to do is inpage the hyper critical worker thread's stack.
-    // Without this fix, we hold the process lock but this thread's stack can't come in, and the deadlock detection cannot create new threads to break the system deadlock.
-    ExWorkerQueue[HyperCriticalWorkQueue].Info.WaitMode = KernelMode;
-    if (NtAs) {
-        ExWorkerQueue[CriticalWorkQueue].Info.WaitMode = KernelMode;
-    }
+        for (WorkQueueType = 0; WorkQueueType < MaximumWorkQueue; WorkQueueType += 1) {
+            Queue = EXP_WORKER_QUEUE(Node, WorkQueueType);
+            KeInitializeQueue(&Queue->WorkerQueue, NumberOfProcessors);
+            Queue->Info.WaitMode = UserMode;
+        }
 
-    // We only create dynamic threads for the critical work queue (note this doesn't apply to dynamic threads created to break deadlocks.)
+        // Always make stack for this thread resident so that worker pool deadlock magic can run even when what we are trying to do is inpage the hyper critical worker thread's stack.
+        // Without this fix, we hold the process lock but this thread's stack can't come in, and the deadlock detection cannot create new threads to break the system deadlock.
+        EXP_WORKER_QUEUE(Node, HyperCriticalWorkQueue)->Info.WaitMode = KernelMode;
+        if (NtAs) {
+            EXP_WORKER_QUEUE(Node, CriticalWorkQueue)->Info.WaitMode = KernelMode;
+        }
 
-    // The rationale is this: folks who use the delayed work queue are not time critical, and the hypercritical queue is used rarely by folks who are non-blocking.
-    ExWorkerQueue[CriticalWorkQueue].Info.MakeThreadsAsNecessary = 1;
+        // We only create dynamic threads for the critical work queue (note this doesn't apply to dynamic threads created to break deadlocks.)
+
+        // The rationale is this: folks who use the delayed work queue are not time critical, and the hypercritical queue is used rarely by folks who are non-blocking.
+        EXP_WORKER_QUEUE(Node, CriticalWorkQueue)->Info.MakeThreadsAsNecessary = 1;
+    }
 
     // Initialize the global thread set manager events
     KeInitializeEvent(&ExpThreadSetManagerEvent, SynchronizationEvent, FALSE);
     KeInitializeEvent(&ExpThreadSetManagerShutdownEvent, SynchronizationEvent, FALSE);
 
-    // Create the desired number of executive worker threads for each of the work queues.
-
-    // Create the builtin critical worker threads.
-    NumberOfThreads = NumberOfCriticalThreads + ExpAdditionalCriticalWorkerThreads;
-    for (Index = 0; Index < NumberOfThreads; Index += 1) {
-        Status = ExpCreateWorkerThread(CriticalWorkQueue, FALSE);// Create a worker thread to service the critical work queue.
-        if (!NT_SUCCESS(Status)) {
-            break;
+    // Create the desired number of executive worker threads for each of the work queues of each node.
+    for (Node = 0; Node < KeNumberNodes; Node += 1) {
+        // Create the builtin critical worker threads.
+        NumberOfThreads = NumberOfCriticalThreads + ExpAdditionalCriticalWorkerThreads;
+        for (Index = 0; Index < NumberOfThreads; Index += 1) {
+            Status = ExpCreateWorkerThread(CriticalWorkQueue, Node, FALSE);// Create a worker thread to service the critical work queue.
+            if (!NT_SUCCESS(Status)) {
+                break;
+            }
         }
-    }
 
-    ExCriticalWorkerThreads += Index;
+        ExCriticalWorkerThreads += Index;
 
-    // Create the delayed worker threads.
-    NumberOfThreads = NumberOfDelayedThreads + ExpAdditionalDelayedWorkerThreads;
-    for (Index = 0; Index < NumberOfThreads; Index += 1) {
-        Status = ExpCreateWorkerThread(DelayedWorkQueue, FALSE);// Create a worker thread to service the delayed work queue.
-        if (!NT_SUCCESS(Status)) {
-            break;
+        // Create the delayed worker threads.
+        NumberOfThreads = NumberOfDelayedThreads + ExpAdditionalDelayedWorkerThreads;
+        for (Index = 0; Index < NumberOfThreads; Index += 1) {
+            Status = ExpCreateWorkerThread(DelayedWorkQueue, Node, FALSE);// Create a worker thread to service the delayed work queue.
+            if (!NT_SUCCESS(Status)) {
+                break;
+            }
         }
-    }
 
-    ExDelayedWorkerThreads += Index;
+        ExDelayedWorkerThreads += Index;
 
-    Status = ExpCreateWorkerThread(HyperCriticalWorkQueue, FALSE);// Create the hypercritical worker thread.
+        Status = ExpCreateWorkerThread(HyperCriticalWorkQueue, Node, FALSE);// Create the hypercritical worker thread.
+    }
 
     // Create the worker thread set manager thread.
     InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
@@ -289,7 +360,7 @@ Arguments:
         KeBugCheckEx(WORKER_INVALID, 0x1, (ULONG_PTR)WorkItem, (ULONG_PTR)WorkItem->WorkerRoutine, 0);
     }
 
-    Queue = &ExWorkerQueue[QueueType];
+    Queue = ExpSelectWorkerQueue(QueueType);
     KeInsertQueue(&Queue->WorkerQueue, &WorkItem->List);// Insert the work item in the appropriate queue object.
 
     // We check the queue's shutdown state after we insert the work item to avoid the race condition when the queue's marked between checking the queue and inserting the item.
@@ -385,17 +456,17 @@ Routine Description:
     and creates one if so.
 */
 {
+    ULONG Index;
     PEX_WORK_QUEUE Queue;
-    WORK_QUEUE_TYPE QueueType;
 
     PAGED_CODE();
 
-    Queue = &ExWorkerQueue[0];// Check each worker queue.
-    for (QueueType = 0; QueueType < MaximumWorkQueue; Queue += 1, QueueType += 1) {
+    Queue = &ExWorkerQueue[0];// Check each worker queue of each node.
+    for (Index = 0; Index < (ULONG)(KeNumberNodes * MaximumWorkQueue); Queue += 1, Index += 1) {
         if (ExpNewThreadNecessary(Queue)) {
             // Create a new thread for this queue.  
             // We explicitly ignore an error from ExpCreateDynamicThread(): there's nothing we can or should do in the event of a failure.
-            ExpCreateWorkerThread(QueueType, TRUE);
+            ExpCreateWorkerThread(Index % MaximumWorkQueue, Index / MaximumWorkQueue, TRUE);
         }
     }
 }
@@ -412,8 +483,8 @@ Routine Description:
 
     PAGED_CODE();
 
-    // Process each queue type.
-    for (Index = 0; Index < MaximumWorkQueue; Index += 1) {
+    // Process each queue type of each node.
+    for (Index = 0; Index < (ULONG)(KeNumberNodes * MaximumWorkQueue); Index += 1) {
         Queue = &ExWorkerQueue[Index];
         ASSERT(Queue->DynamicThreadCount <= MAX_ADDITIONAL_DYNAMIC_THREADS);
 
@@ -428,7 +499,7 @@ Routine Description:
 
             // We explicitly ignore an error from ExpCreateDynamicThread():
             // we'll try again in another detection period if the queue looks like it's still stuck.
-            ExpCreateWorkerThread(Index, TRUE);
+            ExpCreateWorkerThread(Index % MaximumWorkQueue, Index / MaximumWorkQueue, TRUE);
         }
 
         // Update some bookkeeping.
@@ -440,12 +511,13 @@ Routine Description:
 }
 
 
-NTSTATUS ExpCreateWorkerThread(IN WORK_QUEUE_TYPE QueueType, IN BOOLEAN Dynamic)
+NTSTATUS ExpCreateWorkerThread(IN WORK_QUEUE_TYPE QueueType, IN ULONG Node, IN BOOLEAN Dynamic)
 /*
 Routine Description:
-    This function creates a single new static or dynamic worker thread for the given queue type.
+    This function creates a single new static or dynamic worker thread for the given queue type of the given node.
 Arguments:
     QueueType - Supplies the type of the queue for which the worker thread should be created.
+    Node - Supplies the number of the node whose queue the worker thread services. On multinode systems the thread runs only on processors of that node.
     Dynamic - If TRUE, the worker thread is created as a dynamic thread that will terminate after a sufficient period of inactivity.
               If FALSE, the worker thread will never terminate.
 Return Value:
@@ -463,7 +535,7 @@ Notes:
 
     InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
 
-    Context = QueueType;
+    Context = QueueType | (Node << WORKER_NODE_SHIFT);
     if (Dynamic != FALSE) {
         Context |= DYNAMIC_WORKER_THREAD;
     }
@@ -474,7 +546,7 @@ Notes:
     }
 
     if (Dynamic != FALSE) {
-        InterlockedIncrement((PLONG)& ExWorkerQueue[QueueType].DynamicThreadCount);
+        InterlockedIncrement((PLONG)& EXP_WORKER_QUEUE(Node, QueueType)->DynamicThreadCount);
     }
 
     // Set the priority according to the type of worker thread.
@@ -491,10 +563,14 @@ Notes:
         break;
     }
 
-    // Set the base priority of the just-created thread.
+    // Set the base priority of the just-created thread and restrict it to the processors of its node.
     Status = ObReferenceObjectByHandle(ThreadHandle, THREAD_SET_INFORMATION, PsThreadType, KernelMode, (PVOID*)& Thread, NULL);
     if (NT_SUCCESS(Status)) {
         KeSetBasePriorityThread(&Thread->Tcb, BasePriority);
+        if (KeNumberNodes > 1) {
+            KeSetAffinityThread(&Thread->Tcb, KeNodeBlock[Node]->ProcessorMask);
+        }
+
         ObDereferenceObject(Thread);
     }
 
@@ -509,13 +585,13 @@ VOID ExpCheckForWorker(IN PVOID p, IN SIZE_T Size)
     PLIST_ENTRY Entry;
     PCHAR BeginBlock;
     PCHAR EndBlock;
-    WORK_QUEUE_TYPE wqt;
+    ULONG wqt;
 
     BeginBlock = (PCHAR)p;
     EndBlock = (PCHAR)p + Size;
 
     KiLockDispatcherDatabase(&OldIrql);
-    for (wqt = CriticalWorkQueue; wqt < MaximumWorkQueue; wqt += 1) {
+    for (wqt = 0; wqt < (ULONG)(KeNumberNodes * MaximumWorkQueue); wqt += 1) {
         for (Entry = (PLIST_ENTRY)ExWorkerQueue[wqt].WorkerQueue.EntryListHead.Flink;
              Entry && (Entry != (PLIST_ENTRY)& ExWorkerQueue[wqt].WorkerQueue.EntryListHead);
              Entry = Entry->Flink) {
@@ -553,6 +629,7 @@ VOID ExpWorkerThread(IN PVOID StartContext)
     EX_QUEUE_WORKER_INFO OldWorkerInfo;
     EX_QUEUE_WORKER_INFO NewWorkerInfo;
     ULONG CountForQueueEmpty;
+    ULONG Node;
 
     // Set timeout value etc according to whether we are static or dynamic.
     if (((ULONG_PTR)StartContext & DYNAMIC_WORKER_THREAD) == 0) {
@@ -568,8 +645,9 @@ VOID ExpWorkerThread(IN PVOID StartContext)
 
     // If the thread is a critical worker thread, then set the thread priority to the lowest realtime level. 
     // Otherwise, set the base thread priority to time critical.
-    QueueType = (WORK_QUEUE_TYPE)((ULONG_PTR)StartContext & ~DYNAMIC_WORKER_THREAD);
-    WorkerQueue = &ExWorkerQueue[QueueType];
+    QueueType = (WORK_QUEUE_TYPE)((ULONG_PTR)StartContext & WORKER_QUEUE_TYPE_MASK);
+    Node = (ULONG)(((ULONG_PTR)StartContext & ~DYNAMIC_WORKER_THREAD) >> WORKER_NODE_SHIFT);
+    WorkerQueue = EXP_WORKER_QUEUE(Node, QueueType);
     WaitMode = (KPROCESSOR_MODE)WorkerQueue->Info.WaitMode;
     ASSERT(Thread->ExWorkerCanWaitUser == 0);
     if (WaitMode == UserMode) {
@@ -586,7 +664,7 @@ VOID ExpWorkerThread(IN PVOID StartContext)
     // Register as a worker, exiting if the queue's going down and there aren't any workers in the queue to hand us the shutdown
     // work item if we enter the queue (we want to be able to enter a queue even if the queue's shutting down, 
     // in case there's a backlog of work items that the balance manager thread's decided we should be helping to process).
-    if (PO_SHUTDOWN_QUEUE == QueueType) {
+    if ((PO_SHUTDOWN_QUEUE == QueueType) && (Node == 0)) {
         CountForQueueEmpty = 1;
     } else {
         CountForQueueEmpty = 0;
@@ -759,11 +837,13 @@ Arguments:
 }
 
 
-LOGICAL ExpCheckQueueShutdown(IN WORK_QUEUE_TYPE QueueType, IN PSHUTDOWN_WORK_ITEM ShutdownItem)
+LOGICAL ExpCheckQueueShutdown(IN WORK_QUEUE_TYPE QueueType, IN ULONG Node, IN PSHUTDOWN_WORK_ITEM ShutdownItem)
 {
     ULONG CountForQueueEmpty;
+    PEX_WORK_QUEUE Queue;
 
-    if (PO_SHUTDOWN_QUEUE == QueueType) {
+    Queue = EXP_WORKER_QUEUE(Node, QueueType);
+    if ((PO_SHUTDOWN_QUEUE == QueueType) && (Node == 0)) {
         CountForQueueEmpty = 1;
     } else {
         CountForQueueEmpty = 0;
@@ -773,12 +853,13 @@ LOGICAL ExpCheckQueueShutdown(IN WORK_QUEUE_TYPE QueueType, IN PSHUTDOWN_WORK_IT
     // we won't be incrementing it any more, so we're safe making this check without locks.
 
     // See ExpWorkerThread, ExpShutdownWorker, and ExpShutdownWorkerThreads.
-    if (ExWorkerQueue[QueueType].Info.WorkerCount > CountForQueueEmpty) {
+    if (Queue->Info.WorkerCount > CountForQueueEmpty) {
         // There're still worker threads; send one of them the axe.
         ShutdownItem->QueueType = QueueType;
+        ShutdownItem->Node = Node;
         ShutdownItem->PrevThread = PsGetCurrentThread();
         ObReferenceObject(ShutdownItem->PrevThread);
-        KeInsertQueue(&ExWorkerQueue[QueueType].WorkerQueue, &ShutdownItem->WorkItem.List);
+        KeInsertQueue(&Queue->WorkerQueue, &ShutdownItem->WorkItem.List);
         return TRUE;
     }
 
@@ -789,6 +870,7 @@ LOGICAL ExpCheckQueueShutdown(IN WORK_QUEUE_TYPE QueueType, IN PSHUTDOWN_WORK_IT
 VOID ExpShutdownWorker(IN PVOID Parameter)
 {
     PETHREAD CurrentThread;
+    ULONG Node;
     PSHUTDOWN_WORK_ITEM  ShutdownItem;
 
     ShutdownItem = (PSHUTDOWN_WORK_ITEM)Parameter;
@@ -803,9 +885,17 @@ VOID ExpShutdownWorker(IN PVOID Parameter)
     }
 
     // Decrement the worker count.
-    InterlockedDecrement(&ExWorkerQueue[ShutdownItem->QueueType].Info.QueueWorkerInfo);
+    InterlockedDecrement(&EXP_WORKER_QUEUE(ShutdownItem->Node, ShutdownItem->QueueType)->Info.QueueWorkerInfo);
     CurrentThread = PsGetCurrentThread();
-    if ((!ExpCheckQueueShutdown(DelayedWorkQueue, ShutdownItem)) && (!ExpCheckQueueShutdown(CriticalWorkQueue, ShutdownItem))) {
+
+    // Hand the shutdown work item to a remaining worker of any node.
+    for (Node = 0; Node < KeNumberNodes; Node += 1) {
+        if (ExpCheckQueueShutdown(DelayedWorkQueue, Node, ShutdownItem) || ExpCheckQueueShutdown(CriticalWorkQueue, Node, ShutdownItem)) {
+            break;
+        }
+    }
+
+    if (Node == KeNumberNodes) {
         // We're the last worker to exit
         ASSERT(!ExpLastWorkerThread);
         ExpLastWorkerThread = CurrentThread;
@@ -821,6 +911,7 @@ VOID ExpShutdownWorker(IN PVOID Parameter)
 
 VOID ExpShutdownWorkerThreads(VOID)
 {
+    ULONG Node;
     PULONG QueueEnable;
     SHUTDOWN_WORK_ITEM ShutdownItem;
 
@@ -830,16 +921,19 @@ VOID ExpShutdownWorkerThreads(VOID)
 
     ASSERT(KeGetCurrentThread()->Queue == &ExWorkerQueue[PO_SHUTDOWN_QUEUE].WorkerQueue);
 
-    // Mark the queues as terminating.
-    QueueEnable = (PULONG)& ExWorkerQueue[DelayedWorkQueue].Info.QueueWorkerInfo;
-    RtlInterlockedSetBitsDiscardReturn(QueueEnable, EX_WORKER_QUEUE_DISABLED);
-    QueueEnable = (PULONG)& ExWorkerQueue[CriticalWorkQueue].Info.QueueWorkerInfo;
-    RtlInterlockedSetBitsDiscardReturn(QueueEnable, EX_WORKER_QUEUE_DISABLED);
+    // Mark the queues of each node as terminating.
+    for (Node = 0; Node < KeNumberNodes; Node += 1) {
+        QueueEnable = (PULONG)& EXP_WORKER_QUEUE(Node, DelayedWorkQueue)->Info.QueueWorkerInfo;
+        RtlInterlockedSetBitsDiscardReturn(QueueEnable, EX_WORKER_QUEUE_DISABLED);
+        QueueEnable = (PULONG)& EXP_WORKER_QUEUE(Node, CriticalWorkQueue)->Info.QueueWorkerInfo;
+        RtlInterlockedSetBitsDiscardReturn(QueueEnable, EX_WORKER_QUEUE_DISABLED);
+    }
 
     // Queue the shutdown work item to the delayed work queue.
     // After all currently queued work items are complete, this will fire, repeatedly taking out every worker thread in every queue until they're all done.
     ExInitializeWorkItem(&ShutdownItem.WorkItem, &ExpShutdownWorker, &ShutdownItem);
     ShutdownItem.QueueType = DelayedWorkQueue;
+    ShutdownItem.Node = 0;
     ShutdownItem.PrevThread = NULL;
     KeInsertQueue(&ExWorkerQueue[DelayedWorkQueue].WorkerQueue, &ShutdownItem.WorkItem.List);
 
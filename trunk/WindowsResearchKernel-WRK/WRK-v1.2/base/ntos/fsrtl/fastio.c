@@ -36,8 +36,25 @@ FS_RTL_DEBUG_COUNTERS gCounter = {0, 0, 0, 0, 0, 0, 0, 0, 0};
 //  Trace level for the module
 #define Dbg                              (0x04000000)
 
+//  How long FsRtlBeginFastReadBarrier waits between checks for fast readers which have not drained yet (1 ms).
+const LARGE_INTEGER FsRtlFastReadDrainDelay = {(ULONG)(-1 * 1000 * 10), -1};
+
+BOOLEAN FsRtlpCopyReadNoResource(
+    __in PFILE_OBJECT FileObject,
+    __in PLARGE_INTEGER FileOffset,
+    __in ULONG Length,
+    __in BOOLEAN Wait,
+    __in ULONG PageCount,
+    __out_bcount(Length) PVOID Buffer,
+    __out PIO_STATUS_BLOCK IoStatus,
+    __out PBOOLEAN Status
+);
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, FsRtlCopyRead)
+#pragma alloc_text(PAGE, FsRtlpCopyReadNoResource)
+#pragma alloc_text(PAGE, FsRtlBeginFastReadBarrier)
+#pragma alloc_text(PAGE, FsRtlEndFastReadBarrier)
 #pragma alloc_text(PAGE, FsRtlCopyWrite)
 #pragma alloc_text(PAGE, FsRtlMdlRead)
 #pragma alloc_text(PAGE, FsRtlMdlReadDev)
@@ -60,6 +77,137 @@ FS_RTL_DEBUG_COUNTERS gCounter = {0, 0, 0, 0, 0, 0, 0, 0, 0};
 #endif
 
 
+BOOLEAN FsRtlpCopyReadNoResource(
+    __in PFILE_OBJECT FileObject,
+    __in PLARGE_INTEGER FileOffset,
+    __in ULONG Length,
+    __in BOOLEAN Wait,
+    __in ULONG PageCount,
+    __out_bcount(Length) PVOID Buffer,
+    __out PIO_STATUS_BLOCK IoStatus,
+    __out PBOOLEAN Status
+)
+/*
+Routine Description:
+    This routine tries to do the fast cached read of FsRtlCopyRead without acquiring the main resource of the stream.
+    Instead the reader registers itself in FastReaders and checks that FastReadSequence is even, which means that no file system thread is
+    inside FsRtlBeginFastReadBarrier, and such a thread waits for the registered readers before changing the file size or the cache map.
+    The read is only tried when fast I/O is plainly possible; a questionable stream (e.g., one with byte range locks) goes the normal way.
+    The caller has entered the file system and has checked the length for overflow.
+Arguments:
+    See FsRtlCopyRead.
+    PageCount - Number of pages spanned by the transfer.
+    Status - Receives the value FsRtlCopyRead should return if the read was handled here.
+Return Value:
+    TRUE - if the read was handled here, FALSE if there was a conflict and the caller must acquire the resource.
+*/
+{
+    PFSRTL_ADVANCED_FCB_HEADER Header = (PFSRTL_ADVANCED_FCB_HEADER)FileObject->FsContext;
+    LARGE_INTEGER BeyondLastByte;
+    LARGE_INTEGER FileSize;
+
+    PAGED_CODE();
+
+    //  The interlocked increment orders our registration against the sequence read which follows.
+    InterlockedIncrement(&Header->FastReaders);
+
+    if (((Header->FastReadSequence & 1) != 0) ||
+        (FileObject->PrivateCacheMap == NULL) ||
+        (Header->IsFastIoPossible != FastIoIsPossible)) {
+        InterlockedDecrement(&Header->FastReaders);
+        return FALSE;
+    }
+
+    if (Wait) {
+        HOT_STATISTIC(CcFastReadWait) += 1;
+    } else {
+        HOT_STATISTIC(CcFastReadNoWait) += 1;
+    }
+
+    //  The file size cannot change until we deregister, so one snapshot serves both the check and the copy.
+    FileSize = Header->FileSize;
+    BeyondLastByte.QuadPart = FileOffset->QuadPart + (LONGLONG)Length;
+    *Status = TRUE;
+
+    //  Check for read past file size.
+    if (BeyondLastByte.QuadPart > FileSize.QuadPart) {
+        if (FileOffset->QuadPart >= FileSize.QuadPart) {
+            IoStatus->Status = STATUS_END_OF_FILE;
+            IoStatus->Information = 0;
+            InterlockedDecrement(&Header->FastReaders);
+            return TRUE;
+        }
+
+        Length = (ULONG)(FileSize.QuadPart - FileOffset->QuadPart);
+    }
+
+    PsGetCurrentThread()->TopLevelIrp = FSRTL_FAST_IO_TOP_LEVEL_IRP;
+
+    try {
+        if (Wait && ((BeyondLastByte.HighPart | FileSize.HighPart) == 0)) {
+            CcFastCopyRead(FileObject, FileOffset->LowPart, Length, PageCount, Buffer, IoStatus);
+        } else {
+            *Status = CcCopyRead(FileObject, FileOffset, Length, Wait, Buffer, IoStatus);
+        }
+
+        FileObject->Flags |= FO_FILE_FAST_IO_READ;
+        if (*Status) {
+            FileObject->CurrentByteOffset.QuadPart = FileOffset->QuadPart + IoStatus->Information;
+        }
+    } except(FsRtlIsNtstatusExpected(GetExceptionCode()) ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        *Status = FALSE;
+    }
+
+    PsGetCurrentThread()->TopLevelIrp = 0;
+
+    InterlockedDecrement(&Header->FastReaders);
+    return TRUE;
+}
+
+
+VOID FsRtlBeginFastReadBarrier(__in PFSRTL_ADVANCED_FCB_HEADER Header)
+/*
+Routine Description:
+    This routine is called by a file system which sets FSRTL_FLAG2_SUPPORTS_FAST_READ_SEQUENCE before it changes the file size, the valid data
+    length or the fast I/O state of the stream, or tears down its cache map.
+    It makes the fast read sequence odd, so that new fast reads fall back to acquiring the main resource, and waits for the fast reads which
+    are already running without it.
+    The caller must hold the main resource exclusive, and must call FsRtlEndFastReadBarrier when the change is complete.
+Arguments:
+    Header - The advanced FCB header of the stream.
+*/
+{
+    PAGED_CODE();
+
+    ASSERT(FlagOn(Header->Flags2, FSRTL_FLAG2_SUPPORTS_FAST_READ_SEQUENCE));
+    ASSERT(ExIsResourceAcquiredExclusiveLite(Header->Resource));
+    ASSERT((Header->FastReadSequence & 1) == 0);
+
+    InterlockedIncrement(&Header->FastReadSequence);
+
+    while (Header->FastReaders != 0) {
+        KeDelayExecutionThread(KernelMode, FALSE, (PLARGE_INTEGER)&FsRtlFastReadDrainDelay);
+    }
+}
+
+
+VOID FsRtlEndFastReadBarrier(__in PFSRTL_ADVANCED_FCB_HEADER Header)
+/*
+Routine Description:
+    This routine ends the change begun by FsRtlBeginFastReadBarrier and lets fast reads run without the main resource again.
+Arguments:
+    Header - The advanced FCB header of the stream.
+*/
+{
+    PAGED_CODE();
+
+    ASSERT((Header->FastReadSequence & 1) != 0);
+
+    InterlockedIncrement(&Header->FastReadSequence);
+}
+
+
 BOOLEAN FsRtlCopyRead(
     __in PFILE_OBJECT FileObject,
     __in PLARGE_INTEGER FileOffset,
@@ -111,6 +259,14 @@ Return Value:
 
         FsRtlEnterFileSystem();//  Enter the file system
 
+        //  If the file system publishes a fast read sequence, first try the read without the resource.
+        if (FlagOn(Header->Flags, FSRTL_FLAG_ADVANCED_HEADER) &&
+            FlagOn(Header->Flags2, FSRTL_FLAG2_SUPPORTS_FAST_READ_SEQUENCE) &&
+            FsRtlpCopyReadNoResource(FileObject, FileOffset, Length, Wait, PageCount, Buffer, IoStatus, &Status)) {
+            FsRtlExitFileSystem();
+            return Status;
+        }
+
         //  Increment performance counters and get the resource
         if (Wait) {
             HOT_STATISTIC(CcFastReadWait) += 1;
@@ -1222,6 +1378,9 @@ Return Value:
 
     RtlCopyMemory(FsFilterCallbacks, Callbacks, Callbacks->SizeOfFsFilterCallbacks);
     DriverExt->FsFilterCallbacks = FsFilterCallbacks;
+
+    //  The driver may already be attached to device stacks, invalidate their callback summaries.
+    InterlockedIncrement(&FsFilterCallbackGeneration);
     return STATUS_SUCCESS;
 }
 
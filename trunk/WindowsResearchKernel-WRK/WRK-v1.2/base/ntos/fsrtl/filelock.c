@@ -56,6 +56,9 @@ Abstract:
 #define TAG_SHARED_LOCK     'hsLF'
 #define TAG_WAITING_LOCK    'lwLF'
 
+//  How deep FsRtlOptimisticCheckForRead will descend the exclusive tree before falling back to the spinlock
+#define FSRTL_OPTIMISTIC_LOCK_CHECK_DEPTH   64
+
 //  Globals
 
 //  This mutex synchronizes threads competing to initialize file lock structures.
@@ -190,6 +193,17 @@ typedef struct _LOCK_QUEUE
     PRTL_SPLAY_LINKS ExclusiveLockTree;
     SINGLE_LIST_ENTRY WaitingLocks;
     SINGLE_LIST_ENTRY WaitingLocksTail;
+
+    //  The following fields let FsRtlFastCheckLockForRead search the exclusive tree without the spinlock (see FsRtlOptimisticCheckForRead).
+    //  Sequence is odd while the spinlock is held.
+    //  OptimisticReaders counts the searches in progress, and exclusive locks removed while there are any are parked on DeferredExclusiveLocks
+    //  (threaded through Links.Parent, which the search does not follow) until the queue is released with no searches in progress.
+    volatile LONG Sequence;
+    volatile LONG OptimisticReaders;
+    PEX_LOCK DeferredExclusiveLocks;
+
+    //  Zero length exclusive locks may lie inside other exclusive locks, which the lockless search cannot handle, so it stands aside while there are any.
+    ULONG ZeroLengthExclusiveLocks;
 } LOCK_QUEUE, *PLOCK_QUEUE;
 
 
@@ -265,10 +279,65 @@ INLINE VOID FsRtlFreeLockInfo(IN PLOCK_INFO C)
     ExFreeToNPagedLookasideList(&FsRtlLockInfoLookasideList, (PVOID)C);
 }
 
-#define FsRtlAcquireLockQueue(a,b)          ExAcquireSpinLock(&(a)->QueueSpinLock, b)
-#define FsRtlReleaseLockQueue(a,b)          ExReleaseSpinLock(&(a)->QueueSpinLock, b)
-#define FsRtlAcquireLockQueueAtDpc(a)       ExAcquireSpinLockAtDpcLevel(&(a)->QueueSpinLock)
-#define FsRtlReleaseLockQueueFromDpc(a)     ExReleaseSpinLockFromDpcLevel(&(a)->QueueSpinLock)
+//  Free an exclusive lock which has been removed from the exclusive tree, parking it if a lockless search might still be looking at it.
+//  The lock queue must be held.
+INLINE VOID FsRtlRetireExclusiveLock(IN PLOCK_QUEUE LockQueue, IN PEX_LOCK Lock)
+{
+    if (Lock->LockInfo.Length.QuadPart == 0) {
+        LockQueue->ZeroLengthExclusiveLocks -= 1;
+    }
+
+    if (LockQueue->OptimisticReaders != 0) {
+        Lock->Links.Parent = (PRTL_SPLAY_LINKS)LockQueue->DeferredExclusiveLocks;
+        LockQueue->DeferredExclusiveLocks = Lock;
+    } else {
+        FsRtlFreeExclusiveLock(Lock);
+    }
+}
+
+INLINE VOID FsRtlBeginLockQueueUpdate(IN PLOCK_QUEUE LockQueue)
+{
+    InterlockedIncrement(&LockQueue->Sequence);
+}
+
+INLINE VOID FsRtlEndLockQueueUpdate(IN PLOCK_QUEUE LockQueue)
+{
+    PEX_LOCK Lock;
+
+    //  A search which starts after this point only sees the current tree, so the parked locks can go once the running searches are done.
+    if (LockQueue->OptimisticReaders == 0) {
+        while ((Lock = LockQueue->DeferredExclusiveLocks) != NULL) {
+            LockQueue->DeferredExclusiveLocks = (PEX_LOCK)Lock->Links.Parent;
+            FsRtlFreeExclusiveLock(Lock);
+        }
+    }
+
+    InterlockedIncrement(&LockQueue->Sequence);
+}
+
+INLINE VOID FsRtlAcquireLockQueue(IN PLOCK_QUEUE LockQueue, OUT PKIRQL OldIrql)
+{
+    ExAcquireSpinLock(&LockQueue->QueueSpinLock, OldIrql);
+    FsRtlBeginLockQueueUpdate(LockQueue);
+}
+
+INLINE VOID FsRtlReleaseLockQueue(IN PLOCK_QUEUE LockQueue, IN KIRQL OldIrql)
+{
+    FsRtlEndLockQueueUpdate(LockQueue);
+    ExReleaseSpinLock(&LockQueue->QueueSpinLock, OldIrql);
+}
+
+INLINE VOID FsRtlAcquireLockQueueAtDpc(IN PLOCK_QUEUE LockQueue)
+{
+    ExAcquireSpinLockAtDpcLevel(&LockQueue->QueueSpinLock);
+    FsRtlBeginLockQueueUpdate(LockQueue);
+}
+
+INLINE VOID FsRtlReleaseLockQueueFromDpc(IN PLOCK_QUEUE LockQueue)
+{
+    FsRtlEndLockQueueUpdate(LockQueue);
+    ExReleaseSpinLockFromDpcLevel(&LockQueue->QueueSpinLock);
+}
 
 #define FsRtlAcquireCancelCollide(a)        ExAcquireSpinLock(&FsRtlFileLockCancelCollideLock, a)
 #define FsRtlReleaseCancelCollide(a)        ExReleaseSpinLock(&FsRtlFileLockCancelCollideLock, a)
@@ -350,6 +419,7 @@ BOOLEAN FsRtlPrivateInitializeFileLock(IN PFILE_LOCK   FileLock, IN BOOLEAN ViaF
 VOID FsRtlPrivateRemoveLock(IN PLOCK_INFO LockInfo, IN PFILE_LOCK_INFO, IN BOOLEAN CheckForWaiters);
 BOOLEAN FsRtlCheckNoSharedConflict(IN PLOCK_QUEUE LockQueue, IN PLARGE_INTEGER Starting, IN PLARGE_INTEGER Ending);
 BOOLEAN FsRtlCheckNoExclusiveConflict(IN PLOCK_QUEUE LockQueue, IN PLARGE_INTEGER Starting, IN PLARGE_INTEGER Ending, IN ULONG Key, IN PFILE_OBJECT FileObject, IN PVOID ProcessId);
+BOOLEAN FsRtlOptimisticCheckForRead(IN PLOCK_INFO LockInfo, IN PLARGE_INTEGER Starting, IN PLARGE_INTEGER Ending, IN ULONG Key, IN PFILE_OBJECT FileObject, IN PVOID ProcessId, OUT PBOOLEAN Status);
 VOID FsRtlPrivateResetLowestLockOffset(PLOCK_INFO LockInfo);
 NTSTATUS FsRtlFastUnlockSingleShared(
     IN PLOCK_INFO LockInfo,
@@ -469,6 +539,10 @@ Return Value:
         LockInfo->LockQueue.ExclusiveLockTree = NULL;
         LockInfo->LockQueue.WaitingLocks.Next = NULL;
         LockInfo->LockQueue.WaitingLocksTail.Next = NULL;
+        LockInfo->LockQueue.Sequence = 0;
+        LockInfo->LockQueue.OptimisticReaders = 0;
+        LockInfo->LockQueue.DeferredExclusiveLocks = NULL;
+        LockInfo->LockQueue.ZeroLengthExclusiveLocks = 0;
 
         // Copy Irp & Unlock routines from pageable FileLock structure to non-pageable LockInfo structure
         LockInfo->CompleteLockIrpRoutine = FileLock->CompleteLockIrpRoutine;
@@ -1395,6 +1469,87 @@ Return Value:
 }
 
 
+BOOLEAN FsRtlOptimisticCheckForRead(
+    IN PLOCK_INFO LockInfo,
+    IN PLARGE_INTEGER Starting,
+    IN PLARGE_INTEGER Ending,
+    IN ULONG Key,
+    IN PFILE_OBJECT FileObject,
+    IN PVOID ProcessId,
+    OUT PBOOLEAN Status
+)
+/*
+Routine Description:
+    This routine tries to decide a read access check against the exclusive locks without acquiring the lock queue spinlock,
+    so that reads of a file with many locks do not contend with lock and unlock requests.
+
+    The search is a plain descent of the exclusive tree which, unlike FsRtlFindFirstOverlappingExclusiveNode, does not splay.
+    Since exclusive locks do not overlap each other (zero length locks excepted, and we stand aside while there are any), the only lock which can
+    overlap the range is on the descent path, so the tree needs no further augmentation to answer this.
+    The result is only used if the queue sequence shows that nobody held the spinlock during the search; removed locks are not freed while
+    we are registered in OptimisticReaders, so whatever we touch stays valid even when the search is discarded.
+Arguments:
+    LockInfo - Supplies the lock information of the file
+    Starting - Supplies the first byte of the range
+    Ending - Supplies the last byte of the range
+    Key, FileObject, ProcessId - Supply the identity of the reader
+    Status - Receives the result of the check if it was decided
+Return Value:
+    TRUE if the check was decided, FALSE if the caller must check under the spinlock.
+*/
+{
+    PLOCK_QUEUE LockQueue = &LockInfo->LockQueue;
+    PRTL_SPLAY_LINKS SplayLinks;
+    PEX_LOCK Lock;
+    LONG Sequence;
+    ULONG Depth;
+    BOOLEAN Decided = FALSE;
+
+    //  The interlocked increment orders our registration against the sequence read which follows.
+    InterlockedIncrement(&LockQueue->OptimisticReaders);
+
+    Sequence = LockQueue->Sequence;
+    if ((Sequence & 1) == 0 && LockQueue->ZeroLengthExclusiveLocks == 0) {
+        *Status = TRUE;
+        Decided = TRUE;
+
+        //  The tree may be changed underneath us, so bound the descent rather than trust it to terminate.
+        for (SplayLinks = LockQueue->ExclusiveLockTree, Depth = 0; SplayLinks != NULL; Depth += 1) {
+            if (Depth == FSRTL_OPTIMISTIC_LOCK_CHECK_DEPTH) {
+                Decided = FALSE;
+                break;
+            }
+
+            Lock = CONTAINING_RECORD(SplayLinks, EX_LOCK, Links);
+            if ((ULONGLONG)Ending->QuadPart < (ULONGLONG)Lock->LockInfo.StartingByte.QuadPart) {
+                SplayLinks = RtlLeftChild(SplayLinks);
+            } else if ((ULONGLONG)Starting->QuadPart > (ULONGLONG)Lock->LockInfo.EndingByte.QuadPart) {
+                SplayLinks = RtlRightChild(SplayLinks);
+            } else {
+                //  The range overlaps this lock.
+                //  Another owner's lock is a conflict, but if it is ours there may be others, so leave that to the full check.
+                if ((Lock->LockInfo.FileObject != FileObject) || (Lock->LockInfo.ProcessId != ProcessId) || (Lock->LockInfo.Key != Key)) {
+                    *Status = FALSE;
+                } else {
+                    Decided = FALSE;
+                }
+
+                break;
+            }
+        }
+
+        //  Make sure the tree did not change while we were looking at it.
+        KeMemoryBarrier();
+        if (LockQueue->Sequence != Sequence) {
+            Decided = FALSE;
+        }
+    }
+
+    InterlockedDecrement(&LockQueue->OptimisticReaders);
+    return Decided;
+}
+
+
 BOOLEAN FsRtlFastCheckLockForRead(
     __in PFILE_LOCK FileLock,
     __in PLARGE_INTEGER StartingByte,
@@ -1449,6 +1604,12 @@ Return Value:
 
     LockQueue = &LockInfo->LockQueue;// Now check lock queue
 
+    //  Try to settle the check without the spinlock first.
+    if (FsRtlOptimisticCheckForRead(LockInfo, &Starting, &Ending, Key, FileObject, ProcessId, &Status)) {
+        DebugTrace(0, Dbg, "FsRtlFastCheckLockForRead (optimistic)\n", 0);
+        return Status;
+    }
+
     //  Grab the waiting lock queue spinlock to exclude anyone from messing with the queue while we're using it
     FsRtlAcquireLockQueue(LockQueue, &OldIrql);
 
@@ -2036,7 +2197,7 @@ Return Value:
                 FsRtlAcquireLockQueue(LockQueue, &OldIrql);
             }
 
-            FsRtlFreeExclusiveLock(Lock);
+            FsRtlRetireExclusiveLock(LockQueue, Lock);
 
             //  See if there are additional waiting locks that we can now release.
             if (CheckForWaiters && LockQueue->WaitingLocks.Next) {
@@ -2529,6 +2690,10 @@ Arguments:
     //  This is the exclusive tree. Nothing can overlap (caller is supposed to ensure this) unless the lock is a zero length lock, in which case we just insert it - still.
     ASSERT(!OverlappedSplayLinks || NewLock->LockInfo.Length.QuadPart == 0);
 
+    if (NewLock->LockInfo.Length.QuadPart == 0) {
+        LockQueue->ZeroLengthExclusiveLocks += 1;
+    }
+
     //  Simple insert ...
     RtlInitializeSplayLinks(&NewLock->Links);
     if (OverlappedSplayLinks) {
@@ -3016,7 +3181,7 @@ Arguments:
                     }
                 }
 
-                FsRtlFreeExclusiveLock(ExLock);
+                FsRtlRetireExclusiveLock(LockQueue, ExLock);
             }
         }
     }
@@ -27,6 +27,10 @@ Abstract:
     (e.g. the device object).
 
     The InstanceId is used to specify a particular instance of the context data owned by a filter driver (e.g. the file object).
+
+    Lookups happen on every I/O once a few filters are stacked on a volume, so besides the list each stream and file object keeps a small index of
+    its contexts by owner.  The index is changed only under the mutex, in place, bracketed by a sequence number.  A lookup scans it without
+    the mutex and takes the mutex and walks the list only if a change raced with it or the index could not hold every context.
 */
 
 #include "FsRtlP.h"
@@ -34,6 +38,48 @@ Abstract:
 #define MySearchList(pHdr, Ptr) \
     for ( Ptr = (pHdr)->Flink;  Ptr != (pHdr);  Ptr = Ptr->Flink )
 
+//  The number of contexts a filter context index holds.
+//  This covers a deep stack of filters with a context each; beyond it lookups fall back to the list.
+#define FSRTL_FILTER_CONTEXT_INDEX_SLOTS    8
+
+//  The filter context index.
+//  Contexts are kept in insertion order, so scanning from the end finds the same context as walking the list from its head.
+//  Only the identifiers and the address of each context are recorded here, a lookup never touches the contexts themselves.
+typedef struct _FSRTL_FILTER_CONTEXT_INDEX
+{
+    //  Odd while a writer holding the mutex is changing the index.
+    volatile LONG Sequence;
+
+    //  The number of slots in use, and whether they describe every context on the list.
+    ULONG Count;
+    BOOLEAN Complete;
+
+    struct {
+        PVOID OwnerId;
+        PVOID InstanceId;
+        PVOID Context;
+    } Slots[FSRTL_FILTER_CONTEXT_INDEX_SLOTS];
+} FSRTL_FILTER_CONTEXT_INDEX, *PFSRTL_FILTER_CONTEXT_INDEX;
+
+//  Internal structure used to manage the Per FileObject Contexts.
+typedef struct _PER_FILEOBJECT_CTXCTRL
+{
+    //  This is a pointer to a Fast Mutex which may be used to properly synchronize access to the FsRtl header.
+    //  The Fast Mutex must be nonpaged.
+    FAST_MUTEX FastMutex;
+
+    // This is a pointer to a list of context structures belonging to filesystem filter drivers that are linked above the filesystem.
+    // Each structure is headed by FSRTL_FILTER_CONTEXT.
+    LIST_ENTRY FilterContexts;
+
+    //  The index of FilterContexts used by lookups.
+    FSRTL_FILTER_CONTEXT_INDEX Index;
+} PER_FILEOBJECT_CTXCTRL, *PPER_FILEOBJECT_CTXCTRL;
+
+VOID FsRtlpInitializeFilterContextIndex(IN PFSRTL_FILTER_CONTEXT_INDEX Index);
+VOID FsRtlpRebuildFilterContextIndex(IN PFSRTL_FILTER_CONTEXT_INDEX Index, IN PLIST_ENTRY FilterContexts);
+BOOLEAN FsRtlpLookupFilterContextIndex(IN PFSRTL_FILTER_CONTEXT_INDEX Index, IN PVOID OwnerId OPTIONAL, IN PVOID InstanceId OPTIONAL, OUT PVOID *Context);
+
 
 //  The rest of the routines are not marked pageable so they can be called during the paging path
 
@@ -47,6 +93,114 @@ NTKERNELAPI VOID FsRtlTeardownFilterContexts(IN PFSRTL_ADVANCED_FCB_HEADER AdvFc
 #endif
 
 
+//===========================================================================
+//                  Handles the Filter Context Index
+//===========================================================================
+
+VOID FsRtlpInitializeFilterContextIndex(IN PFSRTL_FILTER_CONTEXT_INDEX Index)
+/*
+Routine Description:
+    This routine initializes an empty filter context index.
+Arguments:
+    Index - The index to initialize.
+*/
+{
+    Index->Sequence = 0;
+    Index->Count = 0;
+    Index->Complete = TRUE;
+}
+
+
+VOID FsRtlpRebuildFilterContextIndex(IN PFSRTL_FILTER_CONTEXT_INDEX Index, IN PLIST_ENTRY FilterContexts)
+/*
+Routine Description:
+    This routine rebuilds a filter context index from the list of contexts after the list has changed.
+    The caller holds the mutex protecting the list.
+
+    Lists are short, so rebuilding in full is as cheap as patching the slots and keeps the order trivially in step with the list.
+Arguments:
+    Index - The index to rebuild.
+    FilterContexts - The list of contexts, each headed by FSRTL_FILTER_CONTEXT.
+*/
+{
+    PFSRTL_PER_FILEOBJECT_CONTEXT ctx;
+    PLIST_ENTRY list;
+    ULONG count = 0;
+
+    InterlockedIncrement(&Index->Sequence);
+    Index->Complete = TRUE;
+
+    //  Walk the list from its tail so that the newest context lands in the last slot.
+    for (list = FilterContexts->Blink; list != FilterContexts; list = list->Blink) {
+        if (count == FSRTL_FILTER_CONTEXT_INDEX_SLOTS) {
+            Index->Complete = FALSE;
+            break;
+        }
+
+        //  Stream and file object contexts share the FSRTL_FILTER_CONTEXT layout.
+        ctx = CONTAINING_RECORD(list, FSRTL_PER_FILEOBJECT_CONTEXT, Links);
+        Index->Slots[count].OwnerId = ctx->OwnerId;
+        Index->Slots[count].InstanceId = ctx->InstanceId;
+        Index->Slots[count].Context = ctx;
+        count += 1;
+    }
+
+    Index->Count = count;
+    InterlockedIncrement(&Index->Sequence);
+}
+
+
+BOOLEAN FsRtlpLookupFilterContextIndex(IN PFSRTL_FILTER_CONTEXT_INDEX Index, IN PVOID OwnerId OPTIONAL, IN PVOID InstanceId OPTIONAL, OUT PVOID *Context)
+/*
+Routine Description:
+    This routine looks up a context in a filter context index without acquiring the mutex protecting it.
+    The matching rules are those of the list walks below.
+Arguments:
+    Index - The index to search.
+    OwnerId - Used to identify context information belonging to a particular filter driver.
+    InstanceId - Used to search for a particular instance of a filter driver context.
+    Context - Receives the matching context, or NULL if there is none.
+Return Value:
+    TRUE if the index answered the lookup, FALSE if the caller must search the list under the mutex.
+*/
+{
+    LONG sequence;
+    ULONG slot;
+    PVOID rtnCtx = NULL;
+
+    sequence = Index->Sequence;
+    KeMemoryBarrier();
+
+    if ((sequence & 1) != 0 || !Index->Complete || Index->Count > FSRTL_FILTER_CONTEXT_INDEX_SLOTS) {
+        return FALSE;
+    }
+
+    for (slot = Index->Count; slot-- > 0;) {
+        if (ARGUMENT_PRESENT(InstanceId)) {
+            if (Index->Slots[slot].OwnerId != OwnerId || Index->Slots[slot].InstanceId != InstanceId) {
+                continue;
+            }
+        } else if (ARGUMENT_PRESENT(OwnerId)) {
+            if (Index->Slots[slot].OwnerId != OwnerId) {
+                continue;
+            }
+        }
+
+        rtnCtx = Index->Slots[slot].Context;
+        break;
+    }
+
+    //  If a writer changed the index meanwhile what we read may be torn, so let the caller take the mutex.
+    KeMemoryBarrier();
+    if (Index->Sequence != sequence) {
+        return FALSE;
+    }
+
+    *Context = rtnCtx;
+    return TRUE;
+}
+
+
 //===========================================================================
 //                  Handles Stream Contexts
 //===========================================================================
@@ -70,6 +224,24 @@ Return Value:
 
     ExAcquireFastMutex(AdvFcbHeader->FastMutex);
     InsertHeadList(&AdvFcbHeader->FilterContexts, &Ptr->Links);
+
+    //  Keep the index in step, allocating it with the first context.
+    //  If there is no pool for it lookups simply keep taking the mutex.
+    if (FlagOn(AdvFcbHeader->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX)) {
+        if (AdvFcbHeader->FilterContextIndex == NULL) {
+            PFSRTL_FILTER_CONTEXT_INDEX index;
+
+            index = ExAllocatePoolWithTag(NonPagedPool, sizeof(FSRTL_FILTER_CONTEXT_INDEX), 'XCSF');
+            if (index != NULL) {
+                FsRtlpInitializeFilterContextIndex(index);
+                FsRtlpRebuildFilterContextIndex(index, &AdvFcbHeader->FilterContexts);
+                InterlockedExchangePointer(&AdvFcbHeader->FilterContextIndex, index);
+            }
+        } else {
+            FsRtlpRebuildFilterContextIndex(AdvFcbHeader->FilterContextIndex, &AdvFcbHeader->FilterContexts);
+        }
+    }
+
     ExReleaseFastMutex(AdvFcbHeader->FastMutex);
     return STATUS_SUCCESS;
 }
@@ -95,11 +267,20 @@ Return Value:
 {
     PFSRTL_PER_STREAM_CONTEXT ctx;
     PFSRTL_PER_STREAM_CONTEXT rtnCtx;
+    PFSRTL_FILTER_CONTEXT_INDEX index;
     PLIST_ENTRY list;
 
     ASSERT(AdvFcbHeader);
     ASSERT(FlagOn(AdvFcbHeader->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXTS));
 
+    //  Try the index first, it does not need the mutex.
+    if (FlagOn(AdvFcbHeader->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX)) {
+        index = AdvFcbHeader->FilterContextIndex;
+        if (index != NULL && FsRtlpLookupFilterContextIndex(index, OwnerId, InstanceId, (PVOID *)&rtnCtx)) {
+            return rtnCtx;
+        }
+    }
+
     ExAcquireFastMutex(AdvFcbHeader->FastMutex);
     rtnCtx = NULL;
 
@@ -183,6 +364,10 @@ Return Value:
 
     if (rtnCtx) {
         RemoveEntryList(&rtnCtx->Links);   // remove the matched entry
+
+        if (FlagOn(AdvFcbHeader->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX) && AdvFcbHeader->FilterContextIndex != NULL) {
+            FsRtlpRebuildFilterContextIndex(AdvFcbHeader->FilterContextIndex, &AdvFcbHeader->FilterContexts);
+        }
     }
 
     ExReleaseFastMutex(AdvFcbHeader->FastMutex);
@@ -210,6 +395,10 @@ Arguments:
             //  Unlink the top entry then release the lock.
             //  We must release the lock before calling the use or their could be potential locking order deadlocks.
             ptr = RemoveHeadList(&AdvFcbHeader->FilterContexts);
+            if (FlagOn(AdvFcbHeader->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX) && AdvFcbHeader->FilterContextIndex != NULL) {
+                FsRtlpRebuildFilterContextIndex(AdvFcbHeader->FilterContextIndex, &AdvFcbHeader->FilterContexts);
+            }
+
             ExReleaseFastMutex(AdvFcbHeader->FastMutex);
             lockHeld = FALSE;
 
@@ -227,6 +416,12 @@ Arguments:
             ExReleaseFastMutex(AdvFcbHeader->FastMutex);
         }
     }
+
+    //  The stream is going away, so no lookup can be scanning the index any more.
+    if (FlagOn(AdvFcbHeader->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX) && AdvFcbHeader->FilterContextIndex != NULL) {
+        ExFreePool(AdvFcbHeader->FilterContextIndex);
+        AdvFcbHeader->FilterContextIndex = NULL;
+    }
 }
 
 
@@ -234,19 +429,6 @@ Arguments:
 //                  Handles FileObject Contexts
 //===========================================================================
 
-//  Internal structure used to manage the Per FileObject Contexts.
-typedef struct _PER_FILEOBJECT_CTXCTRL
-{
-    //  This is a pointer to a Fast Mutex which may be used to properly synchronize access to the FsRtl header.
-    //  The Fast Mutex must be nonpaged.
-    FAST_MUTEX FastMutex;
-
-    // This is a pointer to a list of context structures belonging to filesystem filter drivers that are linked above the filesystem.
-    // Each structure is headed by FSRTL_FILTER_CONTEXT.
-    LIST_ENTRY FilterContexts;
-} PER_FILEOBJECT_CTXCTRL, *PPER_FILEOBJECT_CTXCTRL;
-
-
 NTKERNELAPI NTSTATUS FsRtlInsertPerFileObjectContext(__in PFILE_OBJECT FileObject, __in PFSRTL_PER_FILEOBJECT_CONTEXT Ptr)
 /*
 Routine Description:
@@ -283,6 +465,7 @@ Return Value:
 
         ExInitializeFastMutex(&ctxCtrl->FastMutex);
         InitializeListHead(&ctxCtrl->FilterContexts);
+        FsRtlpInitializeFilterContextIndex(&ctxCtrl->Index);
 
         //  Insert into the file object extension
         status = IoChangeFileObjectFilterContext(FileObject, ctxCtrl, TRUE);
@@ -302,6 +485,7 @@ Return Value:
 
     ExAcquireFastMutex(&ctxCtrl->FastMutex);
     InsertHeadList(&ctxCtrl->FilterContexts, &Ptr->Links);
+    FsRtlpRebuildFilterContextIndex(&ctxCtrl->Index, &ctxCtrl->FilterContexts);
     ExReleaseFastMutex(&ctxCtrl->FastMutex);
     return STATUS_SUCCESS;
 }
@@ -337,6 +521,11 @@ Return Value:
         return NULL;
     }
 
+    //  Try the index first, it does not need the mutex.
+    if (FsRtlpLookupFilterContextIndex(&ctxCtrl->Index, OwnerId, InstanceId, (PVOID *)&rtnCtx)) {
+        return rtnCtx;
+    }
+
     rtnCtx = NULL;
     ExAcquireFastMutex(&ctxCtrl->FastMutex);
 
@@ -433,6 +622,7 @@ Return Value:
 
     if (rtnCtx) {
         RemoveEntryList(&rtnCtx->Links);   // remove the matched entry
+        FsRtlpRebuildFilterContextIndex(&ctxCtrl->Index, &ctxCtrl->FilterContexts);
     }
 
     ExReleaseFastMutex(&ctxCtrl->FastMutex);
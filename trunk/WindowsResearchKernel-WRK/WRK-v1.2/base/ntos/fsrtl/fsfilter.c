@@ -33,6 +33,11 @@ PFS_FILTER_RESERVE AcquireOpsReservePool;
 KEVENT ReleaseOpsEvent;
 PFS_FILTER_RESERVE ReleaseOpsReservePool;
 
+//  Completion stacks for device stacks deeper than FS_FILTER_DEFAULT_STACK_SIZE come from this lookaside list rather than from pool on every operation.
+NPAGED_LOOKASIDE_LIST FsFilterCompletionStackLookaside;
+
+volatile LONG FsFilterCallbackGeneration = 1;
+
 
 NTSTATUS FsFilterInit()
 /*
@@ -58,6 +63,14 @@ Return Value:
     KeInitializeEvent(&AcquireOpsEvent, SynchronizationEvent, TRUE);
     KeInitializeEvent(&ReleaseOpsEvent, SynchronizationEvent, TRUE);
 
+    ExInitializeNPagedLookasideList(&FsFilterCompletionStackLookaside,
+                                    NULL,
+                                    NULL,
+                                    0,
+                                    FS_FILTER_MAX_COMPLETION_STACK_SIZE * sizeof(FS_FILTER_COMPLETION_NODE),
+                                    FSRTL_FILTER_MEMORY_TAG,
+                                    0);
+
     return Status;
 }
 
@@ -85,7 +98,17 @@ Return Value:
     ASSERT(AllocationSize != NULL);
 
     *AllocationSize = FsFilterCtrl->CompletionStack.StackLength * sizeof(FS_FILTER_COMPLETION_NODE);
-    Stack = ExAllocatePoolWithTag(NonPagedPool, *AllocationSize, FSRTL_FILTER_MEMORY_TAG);
+    if (FsFilterCtrl->CompletionStack.StackLength <= FS_FILTER_MAX_COMPLETION_STACK_SIZE) {
+        Stack = ExAllocateFromNPagedLookasideList(&FsFilterCompletionStackLookaside);
+        if (Stack != NULL) {
+            SetFlag(FsFilterCtrl->Flags, FS_FILTER_USED_LOOKASIDE);
+        }
+    }
+
+    if (Stack == NULL) {
+        Stack = ExAllocatePoolWithTag(NonPagedPool, *AllocationSize, FSRTL_FILTER_MEMORY_TAG);
+    }
+
     if (Stack == NULL) {
         if (CanFail) {
             return STATUS_INSUFFICIENT_RESOURCES;
@@ -142,7 +165,9 @@ Arguments:
     ASSERT(FsFilterCtrl != NULL);
     ASSERT(FlagOn(FsFilterCtrl->Flags, FS_FILTER_ALLOCATED_COMPLETION_STACK));
 
-    if (!FlagOn(FsFilterCtrl->Flags, FS_FILTER_USED_RESERVE_POOL)) {
+    if (FlagOn(FsFilterCtrl->Flags, FS_FILTER_USED_LOOKASIDE)) {
+        ExFreeToNPagedLookasideList(&FsFilterCompletionStackLookaside, FsFilterCtrl->CompletionStack.Stack);
+    } else if (!FlagOn(FsFilterCtrl->Flags, FS_FILTER_USED_RESERVE_POOL)) {
         //  We were able to allocate this from the generate pool of memory, so just free the memory block used for the completion stack.
         ExFreePoolWithTag(FsFilterCtrl->CompletionStack.Stack, FSRTL_FILTER_MEMORY_TAG);
     } else {
@@ -233,11 +258,10 @@ Return Value:
         ASSERT(FsFilterCtrl->CompletionStack.Stack);
     } else {//  The default completion noded array allocated for the stack is large enough, so set Stack to point to that array.
         FsFilterCtrl->CompletionStack.Stack = &(FsFilterCtrl->CompletionStack.DefaultStack[0]);
-        AllocationSize = sizeof(FS_FILTER_COMPLETION_NODE) * FS_FILTER_DEFAULT_STACK_SIZE;
         FsFilterCtrl->CompletionStack.StackLength = FS_FILTER_DEFAULT_STACK_SIZE;
     }
 
-    RtlZeroMemory(FsFilterCtrl->CompletionStack.Stack, AllocationSize);
+    //  There is no need to zero the completion stack, every field of a node is set when it is pushed.
     return Status;
 }
 
@@ -359,6 +383,60 @@ Arguments:
 }
 
 
+UCHAR FsFilterGetStackCallbackMask(IN PDEVICE_OBJECT DeviceObject)
+/*
+Routine Description:
+    This routine returns the set of operations for which this device or any device it is attached to has registered FsFilter callbacks.
+    The set is computed by walking the stack once and is then kept in the device object extension of the top device.
+    Devices are only ever attached above a computed stack and detaching a device can only shrink the set, so the summary never misses a callback.
+    A registration made after the summary was computed changes FsFilterCallbackGeneration, which causes it to be recomputed.
+Arguments:
+    DeviceObject - The device object at the top of the stack the operation is sent to.
+Return Value:
+    A mask of FS_FILTER_OPERATION_BIT values.
+*/
+{
+    static const UCHAR Operations[] = {
+        FS_FILTER_ACQUIRE_FOR_SECTION_SYNCHRONIZATION,
+        FS_FILTER_RELEASE_FOR_SECTION_SYNCHRONIZATION,
+        FS_FILTER_ACQUIRE_FOR_MOD_WRITE,
+        FS_FILTER_RELEASE_FOR_MOD_WRITE,
+        FS_FILTER_ACQUIRE_FOR_CC_FLUSH,
+        FS_FILTER_RELEASE_FOR_CC_FLUSH
+    };
+    PDEVOBJ_EXTENSION Extension = DeviceObject->DeviceObjectExtension;
+    PFS_FILTER_CALLBACK PreOperationCallback;
+    PFS_FILTER_COMPLETION_CALLBACK PostOperationCallback;
+    PDEVICE_OBJECT CurrentDeviceObject;
+    ULONG Generation;
+    UCHAR Mask = 0;
+    ULONG i;
+
+    Generation = (ULONG)FsFilterCallbackGeneration;
+    if (Extension->FsFilterCallbackGeneration == Generation) {
+        KeMemoryBarrier();
+        return Extension->FsFilterCallbackMask;
+    }
+
+    for (CurrentDeviceObject = DeviceObject; CurrentDeviceObject != NULL; CurrentDeviceObject = CurrentDeviceObject->DeviceObjectExtension->AttachedTo) {
+        for (i = 0; i < RTL_NUMBER_OF(Operations); i++) {
+            FsFilterGetCallbacks(Operations[i], CurrentDeviceObject, &PreOperationCallback, &PostOperationCallback);
+            if (PreOperationCallback != NULL || PostOperationCallback != NULL) {
+                Mask |= FS_FILTER_OPERATION_BIT(Operations[i]);
+            }
+        }
+    }
+
+    //  Racing callers compute the same summary, so there is no need to serialize the update.
+    //  Publish the mask before the generation that validates it.
+    Extension->FsFilterCallbackMask = Mask;
+    KeMemoryBarrier();
+    Extension->FsFilterCallbackGeneration = Generation;
+
+    return Mask;
+}
+
+
 NTSTATUS FsFilterPerformCallbacks(IN PFS_FILTER_CTRL FsFilterCtrl, IN BOOLEAN AllowFilterToFail, IN BOOLEAN AllowBaseFsToFail, OUT BOOLEAN *BaseFsFailedOp)
 /*
 Routine Description:
@@ -391,6 +469,15 @@ Return Value:
     //  Initialize output parameters if present.
     *BaseFsFailedOp = FALSE;
 
+    //  If nothing in this stack registered for the operation, just leave Data->DeviceObject at the bottom as the walk below would.
+    if (!FlagOn(FsFilterGetStackCallbackMask(Data->DeviceObject), FS_FILTER_OPERATION_BIT(Data->Operation))) {
+        while (Data->DeviceObject->DeviceObjectExtension->AttachedTo != NULL) {
+            Data->DeviceObject = Data->DeviceObject->DeviceObjectExtension->AttachedTo;
+        }
+
+        return STATUS_SUCCESS;
+    }
+
     //  As we iterate through the device objects, we use the local
     //  CurrentDeviceObject to iterate through the list because we want
     //  Data->DeviceObject to be set to the last device object when we are finished iterating.
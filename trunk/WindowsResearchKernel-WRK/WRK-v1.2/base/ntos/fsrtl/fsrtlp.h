@@ -279,6 +279,15 @@ typedef struct _FS_FILTER_CTRL {
 #define FS_FILTER_ALLOCATED_COMPLETION_STACK    0x00000001
 #define FS_FILTER_USED_RESERVE_POOL             0x00000002
 #define FS_FILTER_CHANGED_DEVICE_STACKS         0x00000004
+#define FS_FILTER_USED_LOOKASIDE                0x00000008
+
+//  The bit representing an FS_FILTER_* operation in DEVOBJ_EXTENSION.FsFilterCallbackMask.
+//  The operations are numbered down from (UCHAR)-1.
+#define FS_FILTER_OPERATION_BIT( Operation ) \
+    ((UCHAR)(1 << ((UCHAR)(0 - (Operation)) - 1)))
+
+//  Bumped whenever a driver registers FsFilter callbacks, so that device stack summaries computed before are recomputed.
+extern volatile LONG FsFilterCallbackGeneration;
 
 NTSTATUS FsFilterInit();
 NTSTATUS FsFilterAllocateCompletionStack (IN PFS_FILTER_CTRL FsFilterCtrl, IN BOOLEAN CanFail, OUT PULONG AllocationSize);
@@ -302,6 +311,7 @@ VOID FsFilterCtrlFree (IN PFS_FILTER_CTRL FsFilterCtrl);
 #define FS_FILTER_HAVE_COMPLETIONS( fsFilterCtrl ) \
     ((fsFilterCtrl)->CompletionStack.NextStackPosition > 0)
 
+UCHAR FsFilterGetStackCallbackMask (IN PDEVICE_OBJECT DeviceObject);
 VOID FsFilterGetCallbacks (IN UCHAR Operation, IN PDEVICE_OBJECT DeviceObject, OUT PFS_FILTER_CALLBACK *PreOperationCallback, OUT PFS_FILTER_COMPLETION_CALLBACK *PostOperationCallback);
 NTSTATUS FsFilterPerformCallbacks (IN PFS_FILTER_CTRL FsFilterCtrl, IN BOOLEAN AllowFilterToFail, IN BOOLEAN AllowBaseFsToFail, OUT BOOLEAN *BaseFsFailedOp);
 VOID FsFilterPerformCompletionCallbacks(IN PFS_FILTER_CTRL FsFilterCtrl, IN NTSTATUS OperationStatus);
@@ -117,6 +117,7 @@ typedef struct _NONOPAQUE_BASE_MCB
     ULONG MaximumPairCount;
     ULONG PairCount;
     POOL_TYPE PoolType;
+    ULONG LastIndex;
     PMAPPING Mapping;
 } NONOPAQUE_BASE_MCB, *PNONOPAQUE_BASE_MCB;
 
@@ -375,6 +376,7 @@ Arguments:
     //  Initialize the fields in the Mcb
     Mcb->PairCount = 0;
     Mcb->PoolType = PoolType;
+    Mcb->LastIndex = 0;
 
     //  Allocate a new buffer an initial size is one that will hold 16 runs
     if (PoolType == PagedPool) {
@@ -1838,6 +1840,22 @@ Return Value:
 
     //  We'll just do a binary search for the mapping entry.  Min and max are our search boundaries
 
+    //  Paging I/O tends to walk a file in order, so first try the run found last time and the one after it.
+    //  The hint may be stale (callers of the base package may look up concurrently, and ntfs truncates by hand) so it is only trusted
+    //  after checking it against the pair count and the run bounds.
+    MidIndex = BaseMcb->LastIndex;
+    if ((ULONG)MidIndex < BaseMcb->PairCount && Vbn >= StartingVbn(BaseMcb, MidIndex)) {
+        if (Vbn <= EndingVbn(BaseMcb, MidIndex)) {
+            *Index = MidIndex;
+            return TRUE;
+        }
+
+        if ((ULONG)MidIndex + 1 < BaseMcb->PairCount && Vbn <= EndingVbn(BaseMcb, MidIndex + 1)) {
+            *Index = BaseMcb->LastIndex = MidIndex + 1;
+            return TRUE;
+        }
+    }
+
     MinIndex = 0;
     MaxIndex = BaseMcb->PairCount - 1;
 
@@ -1849,7 +1867,7 @@ Return Value:
         } else if (Vbn > EndingVbn(BaseMcb, MidIndex)) {//  check if the Vbn is greater than the mapping at the mid index            
             MinIndex = MidIndex + 1;//  Vbn is greater than the middle index so we need to bring up the min        
         } else {//  Otherwise we've found the index containing the Vbn so set the index and return TRUE.
-            *Index = MidIndex;
+            *Index = BaseMcb->LastIndex = MidIndex;
             return TRUE;
         }
     }
@@ -1885,11 +1903,12 @@ Arguments:
 
         //  We need to allocate a new mapping so compute a new maximum pair count.  We'll only be asked to grow by at most 2 at a time, so
         //  doubling will definitely make us large enough for the new amount.
-        //  But we won't double without bounds we'll stop doubling if the pair count gets too high.
+        //  But we won't double without bounds we'll stop doubling if the pair count gets too high, and grow by half from then on,
+        //  which still keeps the copying linear in the number of runs for very fragmented files.
         if (BaseMcb->MaximumPairCount < 2048) {
             NewMax = BaseMcb->MaximumPairCount * 2;
         } else {
-            NewMax = BaseMcb->MaximumPairCount + 2048;
+            NewMax = BaseMcb->MaximumPairCount + (BaseMcb->MaximumPairCount / 2);
         }
 
         Mapping = FsRtlpAllocatePool(BaseMcb->PoolType, sizeof(MAPPING) * NewMax);
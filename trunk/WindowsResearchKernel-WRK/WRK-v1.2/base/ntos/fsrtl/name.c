@@ -21,6 +21,8 @@ Abstract:
          Lexical ordering is strict unicode numerical ordering.
       o  FsRtlDoesNameContainsWildCards - This routine tells the caller if a string contains any wildcard characters.
       o  FsRtlIsNameInExpression - This routine is used to compare a string against a template (possibly containing wildcards) to sees if the string is in the language denoted by the template.
+      o  FsRtlCompileNameExpression, FsRtlIsNameInCompiledExpression - These routines do the same for many names against one template,
+         classifying the template only once.
 */
 
 #include "FsRtlP.h"
@@ -31,15 +33,25 @@ Abstract:
 #undef MODULE_POOL_TAG
 #define MODULE_POOL_TAG                  ('nrSF')
 
+//  The kinds of expression told apart by FsRtlCompileNameExpression
+#define FSRTL_EXPRESSION_GENERAL         (0)//  Needs the full automaton
+#define FSRTL_EXPRESSION_MATCH_ALL       (1)//  *
+#define FSRTL_EXPRESSION_LITERAL         (2)//  No wild cards at all
+#define FSRTL_EXPRESSION_SUFFIX          (3)//  *X, where X has no wild cards
+
 //  Local support routine prototypes
 BOOLEAN FsRtlIsNameInExpressionPrivate(IN PUNICODE_STRING Expression, IN PUNICODE_STRING Name, IN BOOLEAN IgnoreCase, IN PWCH UpcaseTable);
+BOOLEAN FsRtlIsNameSuffix(IN PWCH Suffix, IN ULONG SuffixLength, IN PUNICODE_STRING Name, IN BOOLEAN IgnoreCase, IN PWCH UpcaseTable);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, FsRtlAreNamesEqual)
+#pragma alloc_text(PAGE, FsRtlCompileNameExpression)
 #pragma alloc_text(PAGE, FsRtlDissectName)
 #pragma alloc_text(PAGE, FsRtlDoesNameContainWildCards)
 #pragma alloc_text(PAGE, FsRtlIsNameInExpression)
+#pragma alloc_text(PAGE, FsRtlIsNameInCompiledExpression)
 #pragma alloc_text(PAGE, FsRtlIsNameInExpressionPrivate)
+#pragma alloc_text(PAGE, FsRtlIsNameSuffix)
 #endif
 
 
@@ -218,8 +230,10 @@ Return Value:
 
         return BytesEqual;
     } else {
+        //  Names usually agree in case as well, so only go to the table for characters which differ.
         for (Index = 0; Index < NameLength; Index += 1) {
-            if (UpcaseTable[ConstantNameA->Buffer[Index]] != UpcaseTable[ConstantNameB->Buffer[Index]]) {
+            if ((ConstantNameA->Buffer[Index] != ConstantNameB->Buffer[Index]) &&
+                (UpcaseTable[ConstantNameA->Buffer[Index]] != UpcaseTable[ConstantNameB->Buffer[Index]])) {
                 return FALSE;
             }
         }
@@ -263,6 +277,137 @@ BOOLEAN FsRtlIsNameInExpression(__in PUNICODE_STRING Expression, __in PUNICODE_S
 }
 
 
+VOID FsRtlCompileNameExpression(
+    __in PUNICODE_STRING Expression,
+    __in BOOLEAN IgnoreCase,
+    __in_opt PWCH UpcaseTable,
+    __out PFSRTL_NAME_EXPRESSION CompiledExpression
+)
+/*
+Routine Description:
+    This routine prepares an expression for repeated use with FsRtlIsNameInCompiledExpression.
+    It works out once whether the expression is * or has no wild cards, or is of the form *X, which FsRtlIsNameInExpression otherwise works out for every name.
+Arguments:
+    Expression - Supplies the expression. It is not copied. Caller must already upcase it if passing IgnoreCase TRUE.
+    IgnoreCase - TRUE if names should be upcased before comparing.
+    UpcaseTable - If supplied, use this table for case insensitive compares, otherwise, use the default system upcase table.
+    CompiledExpression - Receives the prepared expression.
+*/
+{
+    UNICODE_STRING LocalExpression;
+
+    PAGED_CODE();
+
+    CompiledExpression->Expression = *Expression;
+    CompiledExpression->IgnoreCase = IgnoreCase;
+    CompiledExpression->UpcaseTable = UpcaseTable;
+    CompiledExpression->Kind = FSRTL_EXPRESSION_GENERAL;
+
+    if (Expression->Length == 0) {
+        return;
+    }
+
+    if ((Expression->Length == 2) && (Expression->Buffer[0] == L'*')) {
+        CompiledExpression->Kind = FSRTL_EXPRESSION_MATCH_ALL;
+    } else if (!FsRtlDoesNameContainWildCards(Expression)) {
+        CompiledExpression->Kind = FSRTL_EXPRESSION_LITERAL;
+    } else if (Expression->Buffer[0] == L'*') {
+        LocalExpression = *Expression;
+        LocalExpression.Buffer += 1;
+        LocalExpression.Length -= 2;
+        if (!FsRtlDoesNameContainWildCards(&LocalExpression)) {
+            CompiledExpression->Kind = FSRTL_EXPRESSION_SUFFIX;
+        }
+    }
+}
+
+
+BOOLEAN FsRtlIsNameInCompiledExpression(__in PFSRTL_NAME_EXPRESSION CompiledExpression, __in PUNICODE_STRING Name)
+/*
+Routine Description:
+    This routine tells the caller if the name is in the language defined by an expression prepared with FsRtlCompileNameExpression.
+    It gives the same answer as FsRtlIsNameInExpression.
+Arguments:
+    CompiledExpression - Supplies the prepared expression.
+    Name - Supplies the name to check for.
+Return Value:
+    BOOLEAN - TRUE if Name is an element in the set of strings denoted by the expression and FALSE otherwise.
+*/
+{
+    PUNICODE_STRING Expression = &CompiledExpression->Expression;
+
+    PAGED_CODE();
+
+    //  Without a table the name has to be upcased into pool, which the general routine already knows how to do.
+    if (CompiledExpression->IgnoreCase && (CompiledExpression->UpcaseTable == NULL)) {
+        return FsRtlIsNameInExpression(Expression, Name, TRUE, NULL);
+    }
+
+    switch (CompiledExpression->Kind) {
+    case FSRTL_EXPRESSION_MATCH_ALL:
+        return (BOOLEAN)(Name->Length != 0);
+    case FSRTL_EXPRESSION_LITERAL:
+        if (Name->Length != Expression->Length) {
+            return FALSE;
+        }
+
+        return FsRtlIsNameSuffix(Expression->Buffer, Expression->Length, Name, CompiledExpression->IgnoreCase, CompiledExpression->UpcaseTable);
+    case FSRTL_EXPRESSION_SUFFIX:
+        if (Name->Length == 0) {
+            return FALSE;
+        }
+
+        return FsRtlIsNameSuffix(Expression->Buffer + 1, Expression->Length - sizeof(WCHAR), Name, CompiledExpression->IgnoreCase, CompiledExpression->UpcaseTable);
+    default:
+        return FsRtlIsNameInExpressionPrivate(Expression, Name, CompiledExpression->IgnoreCase, CompiledExpression->UpcaseTable);
+    }
+}
+
+
+BOOLEAN FsRtlIsNameSuffix(IN PWCH Suffix, IN ULONG SuffixLength, IN PUNICODE_STRING Name, IN BOOLEAN IgnoreCase, IN PWCH UpcaseTable)
+/*
+Routine Description:
+    This routine tells the caller if the name ends with the given string, which has no wild cards.
+Arguments:
+    Suffix - Supplies the string to look for (Caller must already upcase if passing IgnoreCase TRUE.)
+    SuffixLength - Supplies the length of the string in bytes.
+    Name - Supplies the name to check.
+    IgnoreCase - TRUE if Name should be Upcased before comparing.
+    UpcaseTable - Supplies the upcase table if IgnoreCase is TRUE.
+Return Value:
+    BOOLEAN - TRUE if Name ends with the string and FALSE otherwise.
+*/
+{
+    PWCH NameBuffer;
+    ULONG Index;
+    WCHAR NameChar;
+
+    PAGED_CODE();
+
+    if (Name->Length < SuffixLength) {
+        return FALSE;
+    }
+
+    NameBuffer = Name->Buffer + (Name->Length - SuffixLength) / sizeof(WCHAR);
+
+    //  Do a simple memory compare if case sensitive, otherwise we have got to check this one character at a time,
+    //  only going to the table for characters which differ.
+    if (!IgnoreCase) {
+        return (BOOLEAN)RtlEqualMemory(Suffix, NameBuffer, SuffixLength);
+    }
+
+    for (Index = 0; Index < SuffixLength / sizeof(WCHAR); Index += 1) {
+        NameChar = NameBuffer[Index];
+        ASSERT(Suffix[Index] == UpcaseTable[Suffix[Index]]);
+        if ((NameChar != Suffix[Index]) && (UpcaseTable[NameChar] != Suffix[Index])) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
 #define MATCHES_ARRAY_SIZE 16
 
 
@@ -392,30 +537,7 @@ Return Value:
 
         //  Only special case an expression with a single *
         if (!FsRtlDoesNameContainWildCards(&LocalExpression)) {
-            ULONG StartingNameOffset;
-
-            if (Name->Length < (USHORT)(Expression->Length - sizeof(WCHAR))) {
-                return FALSE;
-            }
-
-            StartingNameOffset = (Name->Length - LocalExpression.Length) / sizeof(WCHAR);
-
-            //  Do a simple memory compare if case sensitive, otherwise we have got to check this one character at a time.
-            if (!IgnoreCase) {
-                return (BOOLEAN)RtlEqualMemory(LocalExpression.Buffer, Name->Buffer + StartingNameOffset, LocalExpression.Length);
-            } else {
-                for (ExprOffset = 0; ExprOffset < (USHORT)(LocalExpression.Length / sizeof(WCHAR)); ExprOffset += 1) {
-                    NameChar = Name->Buffer[StartingNameOffset + ExprOffset];
-                    NameChar = UpcaseTable[NameChar];
-                    ExprChar = LocalExpression.Buffer[ExprOffset];
-                    ASSERT(ExprChar == UpcaseTable[ExprChar]);
-                    if (NameChar != ExprChar) {
-                        return FALSE;
-                    }
-                }
-
-                return TRUE;
-            }
+            return FsRtlIsNameSuffix(LocalExpression.Buffer, LocalExpression.Length, Name, IgnoreCase, UpcaseTable);
         }
     }
 
@@ -52,6 +52,15 @@ typedef struct _REAL_NOTIFY_SYNC
     FAST_MUTEX FastMutex;
     ERESOURCE_THREAD OwningThread;
     ULONG OwnerCount;
+
+    //  Notify structures whose Irp completion has been put off to batch up further changes (see FsRtlNotifyBatchDelay).
+    //  The timer is armed while BatchActive is set, and BatchIdle is signalled once the batch worker has finished with this structure.
+    LIST_ENTRY DeferredNotifies;
+    BOOLEAN BatchActive;
+    KTIMER BatchTimer;
+    KDPC BatchDpc;
+    WORK_QUEUE_ITEM BatchWorkItem;
+    KEVENT BatchIdle;
 } REAL_NOTIFY_SYNC, * PREAL_NOTIFY_SYNC;
 
 //  A list of the following structures is used to store the NotifyChange requests.  They are linked to a filesystem-defined list head.
@@ -134,6 +143,9 @@ typedef struct _NOTIFY_CHANGE
 
     //  This is the process on whose behalf the structure was allocated.  We charge any quota to this process.
     PEPROCESS OwningProcess;
+
+    //  Links this structure into the DeferredNotifies of the notify sync while NOTIFY_BATCH_PENDING is set.
+    LIST_ENTRY DeferredLinks;
 } NOTIFY_CHANGE, * PNOTIFY_CHANGE;
 
 #define NOTIFY_WATCH_TREE               (0x0001)
@@ -142,6 +154,11 @@ typedef struct _NOTIFY_CHANGE
 #define NOTIFY_DEFER_NOTIFY             (0x0008)
 #define NOTIFY_DIR_IS_ROOT              (0x0010)
 #define NOTIFY_STREAM_IS_DELETED        (0x0020)
+#define NOTIFY_BATCH_PENDING            (0x0040)
+
+//  How long, in milliseconds, a reported change may wait before its notify Irp is completed, so that the changes which follow it in a burst
+//  go back to the caller in the same buffer.  Zero completes the Irp as soon as the change is reported.
+ULONG FsRtlNotifyBatchDelay = 10;
 
 //      CAST Add2Ptr (IN PVOID Pointer, IN ULONG Increment
 //          IN (CAST)
@@ -204,6 +221,18 @@ BOOLEAN FsRtlNotifyUpdateBuffer(
 VOID FsRtlNotifyCompleteIrpList(IN PNOTIFY_CHANGE Notify, IN NTSTATUS Status);
 VOID FsRtlCancelNotify(IN PDEVICE_OBJECT DeviceObject, IN PIRP ThisIrp);
 VOID FsRtlCheckNotifyForDelete(IN PLIST_ENTRY NotifyListHead, IN PVOID FsContext);
+VOID FsRtlNotifyDeferCompletion(IN PNOTIFY_CHANGE Notify);
+VOID FsRtlNotifyBatchDpc(IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2);
+VOID FsRtlNotifyBatchWorker(IN PVOID Context);
+BOOLEAN FsRtlNotifyIsDuplicateEntry(IN PFILE_NOTIFY_INFORMATION PreviousInfo, IN PFILE_NOTIFY_INFORMATION NotifyInfo);
+
+//  Take the notify structure off the deferred list of its sync, if it is there.
+#define FsRtlNotifyRemoveDeferred(N) {                  \
+    if (FlagOn((N)->Flags, NOTIFY_BATCH_PENDING)) {     \
+        RemoveEntryList(&(N)->DeferredLinks);           \
+        ClearFlag((N)->Flags, NOTIFY_BATCH_PENDING);    \
+    }                                                   \
+}
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, FsRtlNotifyInitializeSync)
@@ -220,6 +249,9 @@ VOID FsRtlCheckNotifyForDelete(IN PLIST_ENTRY NotifyListHead, IN PVOID FsContext
 #pragma alloc_text(PAGE, FsRtlNotifyUpdateBuffer)
 #pragma alloc_text(PAGE, FsRtlCheckNotifyForDelete)
 #pragma alloc_text(PAGE, FsRtlNotifyCompleteIrpList)
+#pragma alloc_text(PAGE, FsRtlNotifyDeferCompletion)
+#pragma alloc_text(PAGE, FsRtlNotifyBatchWorker)
+#pragma alloc_text(PAGE, FsRtlNotifyIsDuplicateEntry)
 #endif
 
 
@@ -247,6 +279,13 @@ Arguments:
     RealSync->OwningThread = (ERESOURCE_THREAD)0;
     RealSync->OwnerCount = 0;
 
+    InitializeListHead(&RealSync->DeferredNotifies);
+    RealSync->BatchActive = FALSE;
+    KeInitializeTimer(&RealSync->BatchTimer);
+    KeInitializeDpc(&RealSync->BatchDpc, FsRtlNotifyBatchDpc, RealSync);
+    ExInitializeWorkItem(&RealSync->BatchWorkItem, FsRtlNotifyBatchWorker, RealSync);
+    KeInitializeEvent(&RealSync->BatchIdle, NotificationEvent, TRUE);
+
     *NotifySync = (PNOTIFY_SYNC)RealSync;
 
     DebugTrace(-1, Dbg, "FsRtlNotifyInitializeSync:  Exit\n", 0);
@@ -267,7 +306,27 @@ Arguments:
 
     //  Free the structure if present and clear the pointer.
     if (*NotifySync != NULL) {
-        ExFreePool(*NotifySync);
+        PREAL_NOTIFY_SYNC RealSync = (PREAL_NOTIFY_SYNC)*NotifySync;
+        BOOLEAN WaitForWorker = FALSE;
+
+        //  Every notify structure has been through cleanup by now, so there is nothing left to complete.
+        //  But the batch timer may still be armed, or its worker on the way.
+        AcquireNotifySync(RealSync);
+        ASSERT(IsListEmpty(&RealSync->DeferredNotifies));
+        if (RealSync->BatchActive) {
+            if (KeCancelTimer(&RealSync->BatchTimer)) {
+                RealSync->BatchActive = FALSE;
+            } else {
+                WaitForWorker = TRUE;
+            }
+        }
+
+        ReleaseNotifySync(RealSync);
+        if (WaitForWorker) {
+            KeWaitForSingleObject(&RealSync->BatchIdle, Executive, KernelMode, FALSE, NULL);
+        }
+
+        ExFreePool(RealSync);
         *NotifySync = NULL;
     }
 
@@ -1019,9 +1078,16 @@ Return Value:
 
                 if (SizeOfEntry <= AllocationLength && (NextEntryOffset + SizeOfEntry) <= AllocationLength) {
                     PFILE_NOTIFY_INFORMATION NotifyInfo = NULL;
+                    PFILE_NOTIFY_INFORMATION PreviousInfo = NULL;
+                    ULONG PreviousEntry = 0;
 
                     //  If there is already a notify buffer, we append this data to it.
                     if (Notify->Buffer != NULL) {
+                        if (Notify->DataLength != 0) {
+                            PreviousEntry = Notify->LastEntry;
+                            PreviousInfo = Add2Ptr(Notify->Buffer, PreviousEntry, PFILE_NOTIFY_INFORMATION);
+                        }
+
                         NotifyInfo = Add2Ptr(Notify->Buffer, Notify->LastEntry, PFILE_NOTIFY_INFORMATION);
                         NotifyInfo->NextEntryOffset = NextEntryOffset - Notify->LastEntry;
                         Notify->LastEntry = NextEntryOffset;
@@ -1076,7 +1142,14 @@ Return Value:
                                                     StreamName,
                                                     (BOOLEAN)(Notify->CharacterSize == sizeof(WCHAR)),
                                                     SizeOfEntry)) {
-                            Notify->DataLength = NextEntryOffset + SizeOfEntry;//  Update the buffer data length.
+                            //  A burst of writes to one file reports the same modification over and over.
+                            //  If this entry only repeats the one before it, take it back out of the buffer.
+                            if ((PreviousInfo != NULL) && FsRtlNotifyIsDuplicateEntry(PreviousInfo, NotifyInfo)) {
+                                PreviousInfo->NextEntryOffset = 0;
+                                Notify->LastEntry = PreviousEntry;
+                            } else {
+                                Notify->DataLength = NextEntryOffset + SizeOfEntry;//  Update the buffer data length.
+                            }
 
                         //  We couldn't copy the data into the buffer.
                         //  Just notify without any additional information.
@@ -1108,7 +1181,12 @@ Return Value:
             } else {
                 ClearFlag(Notify->Flags, NOTIFY_DEFER_NOTIFY);
                 if (!IsListEmpty(&Notify->NotifyIrps)) {
-                    FsRtlNotifyCompleteIrpList(Notify, STATUS_SUCCESS);
+                    //  Hold the Irp back for a moment to gather more changes, unless the buffer has already given up.
+                    if ((FsRtlNotifyBatchDelay != 0) && !FlagOn(Notify->Flags, NOTIFY_IMMEDIATE_NOTIFY)) {
+                        FsRtlNotifyDeferCompletion(Notify);
+                    } else {
+                        FsRtlNotifyCompleteIrpList(Notify, STATUS_SUCCESS);
+                    }
                 }
             }
         }
@@ -1152,6 +1230,7 @@ Arguments:
         //  If found, then complete all the Irps with STATUS_NOTIFY_CLEANUP
         if (Notify != NULL) {
             SetFlag(Notify->Flags, NOTIFY_CLEANUP_CALLED);//  Set the flag to indicate that we have been called with cleanup.
+            FsRtlNotifyRemoveDeferred(Notify);
 
             if (!IsListEmpty(&Notify->NotifyIrps)) {
                 FsRtlNotifyCompleteIrpList(Notify, STATUS_NOTIFY_CLEANUP);
@@ -1481,6 +1560,9 @@ Arguments:
 
     DataLength = Notify->DataLength;
 
+    //  Whatever completion was put off is happening now.
+    FsRtlNotifyRemoveDeferred(Notify);
+
     //  Clear the fields to indicate that there is no more data to return.
     ClearFlag(Notify->Flags, NOTIFY_IMMEDIATE_NOTIFY);
     Notify->DataLength = 0;
@@ -1502,6 +1584,116 @@ Arguments:
 }
 
 
+//  Local support routine
+
+VOID FsRtlNotifyDeferCompletion(IN PNOTIFY_CHANGE Notify)
+/*
+Routine Description:
+    This routine puts off the completion of the notify Irp for a change just reported, so that further changes can be added to the same buffer.
+    The batch timer of the notify sync is armed if it is not already, and the batch worker completes the Irp when it fires.
+    The notify sync is held by the caller.
+Arguments:
+    Notify  -  This is the notify change structure with a pending Irp.
+*/
+{
+    PREAL_NOTIFY_SYNC RealSync = Notify->NotifySync;
+    LARGE_INTEGER DueTime;
+
+    PAGED_CODE();
+
+    if (!FlagOn(Notify->Flags, NOTIFY_BATCH_PENDING)) {
+        SetFlag(Notify->Flags, NOTIFY_BATCH_PENDING);
+        InsertTailList(&RealSync->DeferredNotifies, &Notify->DeferredLinks);
+    }
+
+    if (!RealSync->BatchActive) {
+        RealSync->BatchActive = TRUE;
+        KeClearEvent(&RealSync->BatchIdle);
+
+        DueTime.QuadPart = -10000 * (LONGLONG)FsRtlNotifyBatchDelay;
+        KeSetTimer(&RealSync->BatchTimer, DueTime, &RealSync->BatchDpc);
+    }
+}
+
+
+//  Local support routine
+
+VOID FsRtlNotifyBatchDpc(IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2)
+/*
+Routine Description:
+    This is the Dpc routine of the batch timer.  The Irps can only be completed under the notify sync, so pass the work to a worker thread.
+Arguments:
+    DeferredContext  -  This is the notify sync.
+*/
+{
+    PREAL_NOTIFY_SYNC RealSync = DeferredContext;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    ExQueueWorkItem(&RealSync->BatchWorkItem, DelayedWorkQueue);
+}
+
+
+//  Local support routine
+
+VOID FsRtlNotifyBatchWorker(IN PVOID Context)
+/*
+Routine Description:
+    This routine completes the notify Irps whose completion was put off by FsRtlNotifyDeferCompletion.
+    A rename which is still waiting for its new name keeps its Irp until the report of the new name.
+Arguments:
+    Context  -  This is the notify sync.
+*/
+{
+    PREAL_NOTIFY_SYNC RealSync = Context;
+    PNOTIFY_CHANGE Notify;
+
+    PAGED_CODE();
+
+    AcquireNotifySync(RealSync);
+
+    while (!IsListEmpty(&RealSync->DeferredNotifies)) {
+        Notify = CONTAINING_RECORD(RealSync->DeferredNotifies.Flink, NOTIFY_CHANGE, DeferredLinks);
+        FsRtlNotifyRemoveDeferred(Notify);
+
+        if (!FlagOn(Notify->Flags, NOTIFY_DEFER_NOTIFY) && !IsListEmpty(&Notify->NotifyIrps)) {
+            FsRtlNotifyCompleteIrpList(Notify, STATUS_SUCCESS);
+        }
+    }
+
+    RealSync->BatchActive = FALSE;
+    ReleaseNotifySync(RealSync);
+
+    //  Once this is signalled the notify sync may be freed, so don't touch it again.
+    KeSetEvent(&RealSync->BatchIdle, 0, FALSE);
+}
+
+
+//  Local support routine
+
+BOOLEAN FsRtlNotifyIsDuplicateEntry(IN PFILE_NOTIFY_INFORMATION PreviousInfo, IN PFILE_NOTIFY_INFORMATION NotifyInfo)
+/*
+Routine Description:
+    This routine tells whether a new entry in a notify buffer says nothing that the entry before it did not.
+    Only modifications are collapsed this way, since for the other actions the number and order of the entries matter to the caller.
+Arguments:
+    PreviousInfo  -  The previous entry in the buffer.
+    NotifyInfo  -  The entry just added.
+Return Value:
+    BOOLEAN - TRUE if the new entry can be dropped.
+*/
+{
+    PAGED_CODE();
+
+    return (BOOLEAN)(((NotifyInfo->Action == FILE_ACTION_MODIFIED) || (NotifyInfo->Action == FILE_ACTION_MODIFIED_STREAM)) &&
+                     (PreviousInfo->Action == NotifyInfo->Action) &&
+                     (PreviousInfo->FileNameLength == NotifyInfo->FileNameLength) &&
+                     RtlEqualMemory(PreviousInfo->FileName, NotifyInfo->FileName, NotifyInfo->FileNameLength));
+}
+
+
 //  Local support routine
 
 VOID FsRtlCancelNotify(IN PDEVICE_OBJECT DeviceObject, IN PIRP ThisIrp)
@@ -124,6 +124,15 @@ typedef struct _WAITING_IRP
     //  This field contains a copy of the Irp Iosb.Information field.
     //  We copy it here so that we can store the Oplock address in the Irp.
     ULONG Information;
+
+    //  The volume the waiting operation was issued against and the interrupt time at which it started to wait.
+    //  These are used to account the break latency in the volume's oplock statistics.
+    PDEVOBJ_EXTENSION VolumeExtension;
+    ULONGLONG WaitStart;
+
+    //  Synchronous waiters keep this structure on their own stack since they cannot return before it is dequeued.
+    //  Only structures allocated from pool are freed when the Irp is released.
+    BOOLEAN Allocated;
 } WAITING_IRP, *PWAITING_IRP;
 
 
@@ -164,6 +173,8 @@ VOID FsRtlCancelOplockIIIrp(IN PDEVICE_OBJECT DeviceObject, IN PIRP Irp);
 VOID FsRtlCancelExclusiveIrp(IN PDEVICE_OBJECT DeviceObject, IN PIRP Irp);
 VOID FsRtlRemoveAndCompleteWaitIrp(IN PWAITING_IRP WaitingIrp);
 VOID FsRtlNotifyCompletion(IN PVOID Context, IN PIRP Irp);
+PDEVOBJ_EXTENSION FsRtlpOplockVolumeExtension(IN PFILE_OBJECT FileObject);
+VOID FsRtlpCountOplockBreak(IN PFILE_OBJECT FileObject);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, FsRtlAllocateOplock)
@@ -175,6 +186,7 @@ VOID FsRtlNotifyCompletion(IN PVOID Context, IN PIRP Irp);
 #pragma alloc_text(PAGE, FsRtlOplockBreakNotify)
 #pragma alloc_text(PAGE, FsRtlOplockFsctrl)
 #pragma alloc_text(PAGE, FsRtlOplockIsFastIoPossible)
+#pragma alloc_text(PAGE, FsRtlQueryOplockStatistics)
 #endif
 
 
@@ -230,6 +242,7 @@ Arguments:
             while (!IsListEmpty(&ThisOplock->WaitingIrps)) {
                 PWAITING_IRP WaitingIrp;
                 PIRP ThisIrp;
+                BOOLEAN Allocated;
 
                 WaitingIrp = CONTAINING_RECORD(ThisOplock->WaitingIrps.Flink, WAITING_IRP, Links);
                 RemoveHeadList(&ThisOplock->WaitingIrps);
@@ -240,8 +253,12 @@ Arguments:
                 ThisIrp->IoStatus.Information = 0;
 
                 //  Call the completion routine in the Waiting Irp.
-                WaitingIrp->CompletionRoutine(WaitingIrp->Context, WaitingIrp->Irp);
-                ExFreePool(WaitingIrp);
+                //  A synchronous waiter may unwind its stack as soon as it is signalled, so don't touch the structure afterwards.
+                Allocated = WaitingIrp->Allocated;
+                WaitingIrp->CompletionRoutine(WaitingIrp->Context, ThisIrp);
+                if (Allocated) {
+                    ExFreePool(WaitingIrp);
+                }
             }
 
             //  Release any oplock II irps held.
@@ -635,6 +652,29 @@ Return Value:
 }
 
 
+VOID FsRtlQueryOplockStatistics(__in PDEVICE_OBJECT VolumeDeviceObject, __out PFSRTL_OPLOCK_STATISTICS Statistics)
+/*
+Routine Description:
+    This routine returns the oplock break statistics accumulated for a volume.
+    Breaks are charged to the volume device object the file was opened on.
+    The counters are sampled without synchronization, so the values may be slightly out of step with each other.
+Arguments:
+    VolumeDeviceObject - Supplies the file system's volume device object.
+    Statistics - Receives the number of breaks started, the number of operations which waited for a break to complete and
+                 the total and longest time those operations waited, in 100ns units.
+*/
+{
+    PDEVOBJ_EXTENSION DeviceExtension = VolumeDeviceObject->DeviceObjectExtension;
+
+    PAGED_CODE();
+
+    Statistics->BreakCount = DeviceExtension->OplockBreakCount;
+    Statistics->WaitCount = DeviceExtension->OplockBreakWaitCount;
+    Statistics->WaitTime.QuadPart = DeviceExtension->OplockBreakWaitTime.QuadPart;
+    Statistics->MaximumWaitTime.QuadPart = DeviceExtension->OplockBreakMaximumWaitTime.QuadPart;
+}
+
+
 //  Local support routine.
 
 PNONOPAQUE_OPLOCK FsRtlAllocateOplock()
@@ -1388,6 +1428,7 @@ Return Value:
                 Oplock->IrpExclusiveOplock->IoStatus.Information = CompletionStatus;
                 FsRtlCompleteRequest(Oplock->IrpExclusiveOplock, STATUS_SUCCESS);
                 Oplock->IrpExclusiveOplock = NULL;
+                FsRtlpCountOplockBreak(IrpSp->FileObject);
             }
 
             //  If there is a pending opfilter request then clear the request.
@@ -1504,6 +1545,7 @@ Return Value:
                 FsRtlCompleteRequest(Oplock->IrpExclusiveOplock, STATUS_SUCCESS);
                 Oplock->IrpExclusiveOplock = NULL;
                 SetFlag(Oplock->OplockState, BREAK_TO_NONE);
+                FsRtlpCountOplockBreak(IrpSp->FileObject);
             }
 
             //  If there are level II oplocks, this will break all of them.
@@ -1513,6 +1555,7 @@ Return Value:
             while (!IsListEmpty(&Oplock->IrpOplocksII)) {
                 //  Remove and complete this Irp with STATUS_SUCCESS.
                 FsRtlRemoveAndCompleteIrp(Oplock->IrpOplocksII.Flink);
+                FsRtlpCountOplockBreak(IrpSp->FileObject);
             }
 
             //  Set the oplock state to no oplocks held.
@@ -1635,6 +1678,7 @@ Return Value:
     LOGICAL AcquiredMutex;
     NTSTATUS Status = STATUS_INSUFFICIENT_RESOURCES;
     PWAITING_IRP WaitingIrp;
+    WAITING_IRP LocalWaitingIrp;
 
     DebugTrace(+1, Dbg, "FsRtlWaitOnIrp:   Entered\n", 0);
 
@@ -1645,10 +1689,20 @@ Return Value:
         PFAST_MUTEX OplockFastMutex = Oplock->FastMutex;
 
         //  Allocate and initialize the Wait Irp structure.
-        WaitingIrp = FsRtlpAllocatePool(PagedPool, sizeof(WAITING_IRP));
+        //  A synchronous caller blocks below until the structure is dequeued, so it can use the one on this stack.
+        if (ARGUMENT_PRESENT(CompletionRoutine)) {
+            WaitingIrp = FsRtlpAllocatePool(PagedPool, sizeof(WAITING_IRP));
+            WaitingIrp->Allocated = TRUE;
+        } else {
+            WaitingIrp = &LocalWaitingIrp;
+            WaitingIrp->Allocated = FALSE;
+        }
+
         WaitingIrp->Irp = Irp;
         WaitingIrp->Context = Context;
         WaitingIrp->Information = (ULONG)Irp->IoStatus.Information;
+        WaitingIrp->VolumeExtension = FsRtlpOplockVolumeExtension(IoGetCurrentIrpStackLocation(Irp)->FileObject);
+        WaitingIrp->WaitStart = KeQueryInterruptTime();
 
         //  Take appropriate action if depending on the value of the completion routine.
         if (ARGUMENT_PRESENT(CompletionRoutine)) {
@@ -1929,6 +1983,7 @@ Arguments:
 */
 {
     PIRP Irp;
+    BOOLEAN Allocated;
 
     PAGED_CODE();
 
@@ -1946,8 +2001,30 @@ Arguments:
     Irp->IoStatus.Information = WaitingIrp->Information;
     Irp->IoStatus.Status = (Irp->Cancel ? STATUS_CANCELLED : STATUS_SUCCESS);
 
+    //  Charge the time this operation spent waiting for the break to its volume.
+    //  Cancelled waiters did not see the break complete, so they are left out.
+    if (!Irp->Cancel && (WaitingIrp->VolumeExtension != NULL)) {
+        PDEVOBJ_EXTENSION VolumeExtension = WaitingIrp->VolumeExtension;
+        LONGLONG WaitTime = (LONGLONG)(KeQueryInterruptTime() - WaitingIrp->WaitStart);
+        LONGLONG MaximumWaitTime;
+
+        InterlockedIncrement(&VolumeExtension->OplockBreakWaitCount);
+        ExInterlockedAddLargeStatistic(&VolumeExtension->OplockBreakWaitTime, (WaitTime > MAXULONG) ? MAXULONG : (ULONG)WaitTime);
+
+        do {
+            MaximumWaitTime = VolumeExtension->OplockBreakMaximumWaitTime.QuadPart;
+            if (WaitTime <= MaximumWaitTime) {
+                break;
+            }
+        } while (InterlockedCompareExchange64(&VolumeExtension->OplockBreakMaximumWaitTime.QuadPart, WaitTime, MaximumWaitTime) != MaximumWaitTime);
+    }
+
+    //  A synchronous waiter may unwind its stack as soon as it is signalled, so don't touch the structure afterwards.
+    Allocated = WaitingIrp->Allocated;
     WaitingIrp->CompletionRoutine(WaitingIrp->Context, Irp);//  Call the completion routine in the Waiting Irp.
-    ExFreePool(WaitingIrp);//  And free up pool
+    if (Allocated) {
+        ExFreePool(WaitingIrp);//  And free up pool
+    }
     DebugTrace(-1, Dbg, "FsRtlRemoveAndCompleteWaitIrp:  Exit\n", 0);
 }
 
@@ -1974,4 +2051,51 @@ Arguments:
     FsRtlCompleteRequest(Irp, Irp->IoStatus.Status);
 
     DebugTrace(-1, Dbg, "FsRtlNotifyCompletion:  Exit\n", 0);
-}
\ No newline at end of file
+}
+
+
+//  Local support routine.
+
+PDEVOBJ_EXTENSION FsRtlpOplockVolumeExtension(IN PFILE_OBJECT FileObject)
+/*
+Routine Description:
+    This routine finds the device object extension which accumulates the oplock statistics for a file.
+    This is the file system's volume device object when the file was opened on a mounted volume, otherwise the device the file was opened on.
+Arguments:
+    FileObject - Supplies the file object the oplock operation was issued against.
+Return Value:
+    PDEVOBJ_EXTENSION - The extension to charge, NULL if there is none.
+*/
+{
+    PDEVICE_OBJECT DeviceObject;
+
+    if (FileObject == NULL) {
+        return NULL;
+    }
+
+    if ((FileObject->Vpb != NULL) && (FileObject->Vpb->DeviceObject != NULL)) {
+        DeviceObject = FileObject->Vpb->DeviceObject;
+    } else {
+        DeviceObject = FileObject->DeviceObject;
+    }
+
+    return (DeviceObject != NULL) ? DeviceObject->DeviceObjectExtension : NULL;
+}
+
+
+//  Local support routine.
+
+VOID FsRtlpCountOplockBreak(IN PFILE_OBJECT FileObject)
+/*
+Routine Description:
+    This routine counts an oplock break notification against the volume of the file being broken.
+Arguments:
+    FileObject - Supplies the file object of the operation which caused the break.
+*/
+{
+    PDEVOBJ_EXTENSION VolumeExtension = FsRtlpOplockVolumeExtension(FileObject);
+
+    if (VolumeExtension != NULL) {
+        InterlockedIncrement(&VolumeExtension->OplockBreakCount);
+    }
+}
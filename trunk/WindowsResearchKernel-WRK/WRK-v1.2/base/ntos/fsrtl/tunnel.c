@@ -27,6 +27,7 @@ Abstract:
     Tunneled information is in the paged pool.
 
     Concurrent access to the TUNNEL variable is controlled by this package.
+    The cache is a hash table with a mutex per bucket, so operations on different names of a volume do not serialize.
     Callers are responsible for synchronizing access to the FsRtlDeleteTunnelCache call.
 
     The functions provided in this package are as follows:
@@ -50,6 +51,12 @@ Abstract:
 #define TUNNEL_SIZE_VALUE_NAME    L"MaximumTunnelEntries"
 #define KEY_WORK_AREA ((sizeof(KEY_VALUE_FULL_INFORMATION) + sizeof(ULONG)) + 64)
 
+//  Bounds on the number of hash buckets given to each volume's cache.
+//  We aim for a handful of entries per bucket when the cache is full.
+#define TUNNEL_MIN_BUCKETS          8
+#define TUNNEL_MAX_BUCKETS          256
+#define TUNNEL_ENTRIES_PER_BUCKET   8
+
 //  Tunnel expiration parameters (cached once at startup)
 
 #ifdef ALLOC_DATA_PRAGMA
@@ -58,6 +65,7 @@ Abstract:
 
 ULONG   TunnelMaxEntries = 256; // Value for !MmIsThisAnNtAsSystem()
 ULONG   TunnelMaxAge = 15;
+ULONG   TunnelHashBuckets = TUNNEL_MIN_BUCKETS;
 
 #ifdef ALLOC_DATA_PRAGMA
 #pragma data_seg()
@@ -83,15 +91,16 @@ PAGED_LOOKASIDE_LIST    TunnelLookasideList;
 
 //  A TUNNEL is allocated in each VCB and initialized at mount time.
 
-//  TUNNEL_NODES are then arranged off of the TUNNEL in a splay tree keyed by DirKey ## Name, where Name is whichever of the names was removed from the directory (short or long).
-//  Each node is also timestamped and inserted into a timer queue for age expiration.
+//  TUNNEL_NODES are then hashed off of the TUNNEL by DirKey ## Name, where Name is whichever of the names was removed from the directory (short or long).
+//  Each bucket has its own mutex and keeps its nodes in insertion order, so the head of a bucket is always its oldest entry and aging a bucket only looks at its head.
+//  The size bound is enforced by an eviction hand which sweeps the buckets in turn and retires the oldest entry of each, approximating the global least recently inserted order the single timer queue used to give.
 
 typedef struct
 {
-    RTL_SPLAY_LINKS      CacheLinks;//  Splay links in the Cache tree
-    LIST_ENTRY           ListLinks;//  List links in the timer queue
+    LIST_ENTRY           ListLinks;//  List links in the hash bucket, oldest first
     LARGE_INTEGER        CreateTime;//  Time this entry was created (for constant time insert)
     ULONGLONG            DirKey;//  Directory these names are associated with
+    ULONG                Hash;//  Hash of DirKey ## Name, checked before comparing the names
     ULONG                Flags;//  Flags for the entry
 
     //  Long/Short names of the file
@@ -103,10 +112,20 @@ typedef struct
     ULONG                TunnelDataLength;
 } TUNNEL_NODE, *PTUNNEL_NODE;
 
+//  A hash bucket of the tunnel cache.
+//  The buckets hold dispatcher objects, so the table is allocated from nonpaged pool.
+
+typedef struct _TUNNEL_BUCKET
+{
+    FAST_MUTEX           Mutex;//  Mutex for manipulation of this bucket
+    LIST_ENTRY           Nodes;//  Nodes hashed to this bucket, in insertion order
+} TUNNEL_BUCKET, *PTUNNEL_BUCKET;
+
 //  Internal utility functions
 
 NTSTATUS FsRtlGetTunnelParameterValue(IN PUNICODE_STRING ValueName, IN OUT PULONG Value);
-VOID FsRtlPruneTunnelCache(IN PTUNNEL Cache, IN OUT PLIST_ENTRY FreePoolList);
+VOID FsRtlPruneTunnelBucket(IN PTUNNEL Cache, IN PTUNNEL_BUCKET Bucket, IN OUT PLIST_ENTRY FreePoolList);
+VOID FsRtlTrimTunnelCache(IN PTUNNEL Cache, IN OUT PLIST_ENTRY FreePoolList);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT, FsRtlInitializeTunnels)
@@ -115,24 +134,59 @@ VOID FsRtlPruneTunnelCache(IN PTUNNEL Cache, IN OUT PLIST_ENTRY FreePoolList);
 #pragma alloc_text(PAGE, FsRtlFindInTunnelCache)
 #pragma alloc_text(PAGE, FsRtlDeleteKeyFromTunnelCache)
 #pragma alloc_text(PAGE, FsRtlDeleteTunnelCache)
-#pragma alloc_text(PAGE, FsRtlPruneTunnelCache)
+#pragma alloc_text(PAGE, FsRtlPruneTunnelBucket)
+#pragma alloc_text(PAGE, FsRtlTrimTunnelCache)
 #pragma alloc_text(PAGE, FsRtlGetTunnelParameterValue)
 #endif
 
 
-INLINE LONG FsRtlCompareNodeAndKey(TUNNEL_NODE *Node, ULONGLONG DirectoryKey, PUNICODE_STRING Name)
+INLINE ULONG FsRtlTunnelHash(ULONGLONG DirectoryKey, PUNICODE_STRING Name)
+/*
+Routine Description:
+    Hash a key/name pair.
+    Names are compared case insensitively, so they are hashed upcased.
+Arguments:
+    DirectoryKey      - a key value
+    Name              - a filename
+Return Value:
+    Hash value
+*/
+{
+    ULONG Hash = (ULONG)DirectoryKey ^ (ULONG)(DirectoryKey >> 32);
+    ULONG Index;
+
+    for (Index = 0; Index < Name->Length / sizeof(WCHAR); Index++) {
+        Hash = (Hash * 37) + RtlUpcaseUnicodeChar(Name->Buffer[Index]);
+    }
+
+    return Hash;
+}
+
+
+INLINE BOOLEAN FsRtlNodeMatchesKey(TUNNEL_NODE *Node, ULONG Hash, ULONGLONG DirectoryKey, PUNICODE_STRING Name)
 /*
 Routine Description:
     Compare a tunnel node with a key/name pair
 Arguments:
     Node              - a tunnel node
+    Hash              - the hash of the key/name pair
     DirectoryKey      - a key value
     Name              - a filename
 Return Value:
-    Signed comparison result
+    TRUE if the node is keyed by this pair
+*/
+{
+    return (Node->Hash == Hash && Node->DirKey == DirectoryKey && RtlEqualUnicodeString((FlagOn(Node->Flags, TUNNEL_FLAG_KEY_SHORT) ? &Node->ShortName : &Node->LongName), Name, TRUE));
+}
+
+
+INLINE PTUNNEL_BUCKET FsRtlTunnelBucket(PTUNNEL Cache, ULONG Hash)
+/*
+Routine Description:
+    Return the bucket a hash value falls in.
 */
 {
-    return  (Node->DirKey > DirectoryKey ? 1 : (Node->DirKey < DirectoryKey ? -1 : RtlCompareUnicodeString((FlagOn(Node->Flags, TUNNEL_FLAG_KEY_SHORT) ? &Node->ShortName : &Node->LongName), Name, TRUE)));
+    return &Cache->Buckets[Hash & Cache->BucketMask];
 }
 
 
@@ -175,26 +229,19 @@ Arguments:
 }
 
 
-INLINE VOID FsRtlRemoveNodeFromTunnel(IN PTUNNEL Cache, IN PTUNNEL_NODE Node, IN PLIST_ENTRY FreePoolList, IN PBOOLEAN Splay OPTIONAL)
+INLINE VOID FsRtlRemoveNodeFromTunnel(IN PTUNNEL Cache, IN PTUNNEL_NODE Node, IN PLIST_ENTRY FreePoolList)
 /*
 Routine Description:
     Performs the common work of deleting a node from a tunnel cache. Pool memory is not deleted immediately but is saved aside on a list for deletion later by the calling routine.
+    The caller holds the mutex of the node's bucket.
 Arguments:
     Cache - the tunnel cache the node is in
     Node - the node being removed
     FreePoolList - an initialized list to take the node if it was allocated from pool
-    Splay - an optional flag to indicate whether the tree should be splayed on the delete. Set to FALSE if splaying was performed.
 */
 {
-    if (Splay && *Splay) {
-        Cache->Cache = RtlDelete(&Node->CacheLinks);
-        *Splay = FALSE;
-    } else {
-        RtlDeleteNoSplay(&Node->CacheLinks, &Cache->Cache);
-    }
-
     RemoveEntryList(&Node->ListLinks);
-    Cache->NumEntries--;
+    InterlockedDecrement(&Cache->NumEntries);
     FsRtlFreeTunnelNode(Node, FreePoolList);
 }
 
@@ -236,6 +283,11 @@ Routine Description:
     //  Convert from seconds to 10ths of msecs, the internal resolution
     TunnelMaxAge *= 10000000;
 
+    //  Size the hash table each cache will use, a power of two so the bucket is a mask of the hash
+    while (TunnelHashBuckets < TUNNEL_MAX_BUCKETS && TunnelHashBuckets * TUNNEL_ENTRIES_PER_BUCKET < TunnelMaxEntries) {
+        TunnelHashBuckets *= 2;
+    }
+
     //  Build the lookaside list for common node allocation
     if (TunnelMaxEntries > MAXUSHORT) {
         LookasideDepth = MAX_LOOKASIDE_DEPTH;//  User is hinting a big need to us
@@ -271,15 +323,33 @@ VOID FsRtlInitializeTunnelCache(__in TUNNEL *Cache)
 /*
 Routine Description:
     Initialize a new tunnel cache.
+    If the hash table cannot be allocated the cache is left disabled; tunneling is best effort and every other routine treats such a cache as empty.
 */
 {
-    PAGED_CODE();
+    ULONG Index;
 
-    ExInitializeFastMutex(&Cache->Mutex);
+    PAGED_CODE();
 
-    Cache->Cache = NULL;
-    InitializeListHead(&Cache->TimerQueue);
+    Cache->Buckets = NULL;
+    Cache->BucketMask = 0;
     Cache->NumEntries = 0;
+    Cache->EvictionHand = 0;
+
+    //  If MaxEntries is 0 then tunneling is disabled.
+    if (TunnelMaxEntries == 0)
+        return;
+
+    Cache->Buckets = ExAllocatePoolWithTag(NonPagedPool, TunnelHashBuckets * sizeof(TUNNEL_BUCKET), 'BnuT');
+    if (Cache->Buckets == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < TunnelHashBuckets; Index++) {
+        ExInitializeFastMutex(&Cache->Buckets[Index].Mutex);
+        InitializeListHead(&Cache->Buckets[Index].Nodes);
+    }
+
+    Cache->BucketMask = TunnelHashBuckets - 1;
 }
 
 
@@ -342,20 +412,21 @@ Arguments:
     Data - pointer to the opaque tunneling data segment
 */
 {
-    LONG Compare;
+    ULONG Hash;
     ULONG NodeSize;
     PUNICODE_STRING NameKey;
-    PRTL_SPLAY_LINKS *Links;
+    PTUNNEL_BUCKET Bucket;
+    PLIST_ENTRY Link;
     LIST_ENTRY FreePoolList;
 
-    PTUNNEL_NODE Node = NULL;
+    PTUNNEL_NODE Node;
     PTUNNEL_NODE NewNode = NULL;
     BOOLEAN AllocatedFromPool = FALSE;
 
     PAGED_CODE();
 
     //  If MaxEntries is 0 then tunneling is disabled.
-    if (TunnelMaxEntries == 0)
+    if (TunnelMaxEntries == 0 || Cache->Buckets == NULL)
         return;
 
     InitializeListHead(&FreePoolList);
@@ -376,71 +447,12 @@ Arguments:
         AllocatedFromPool = TRUE;
     }
 
-    //  Traverse the cache to find our insertion point
+    //  Stash tunneling information
     NameKey = (KeyByShortName ? ShortName : LongName);
-    ExAcquireFastMutex(&Cache->Mutex);
-    Links = &Cache->Cache;
-    while (*Links) {
-        Node = CONTAINING_RECORD(*Links, TUNNEL_NODE, CacheLinks);
-        Compare = FsRtlCompareNodeAndKey(Node, DirKey, NameKey);
-        if (Compare > 0) {
-            Links = &RtlLeftChild(&Node->CacheLinks);
-        } else {
-            if (Compare < 0) {
-                Links = &RtlRightChild(&Node->CacheLinks);
-            } else {
-                break;
-            }
-        }
-    }
-
-    //  Thread new data into the splay tree
-    RtlInitializeSplayLinks(&NewNode->CacheLinks);
-    if (Node) {
-        //  Not inserting first node in tree
-        if (*Links) {
-            //  Entry exists in the cache, so replace by swapping all splay links
-            RtlRightChild(&NewNode->CacheLinks) = RtlRightChild(*Links);
-            RtlLeftChild(&NewNode->CacheLinks) = RtlLeftChild(*Links);
-
-            if (RtlRightChild(*Links))
-                RtlParent(RtlRightChild(*Links)) = &NewNode->CacheLinks;
-            if (RtlLeftChild(*Links))
-                RtlParent(RtlLeftChild(*Links)) = &NewNode->CacheLinks;
-
-            if (!RtlIsRoot(*Links)) {
-                //  Change over the parent links. Note that we've messed with *Links now since it is pointing at the parent member.
-                RtlParent(&NewNode->CacheLinks) = RtlParent(*Links);
-                if (RtlIsLeftChild(*Links)) {
-                    RtlLeftChild(RtlParent(*Links)) = &NewNode->CacheLinks;
-                } else {
-                    RtlRightChild(RtlParent(*Links)) = &NewNode->CacheLinks;
-                }
-            } else {
-                Cache->Cache = &NewNode->CacheLinks;//  Set root of the cache
-            }
+    Hash = FsRtlTunnelHash(DirKey, NameKey);
 
-            //  Free old node
-            RemoveEntryList(&Node->ListLinks);
-            FsRtlFreeTunnelNode(Node, &FreePoolList);
-            Cache->NumEntries--;
-        } else {
-            //  Simple insertion as a leaf
-            NewNode->CacheLinks.Parent = &Node->CacheLinks;
-            *Links = &NewNode->CacheLinks;
-        }
-    } else {
-        Cache->Cache = &NewNode->CacheLinks;
-    }
-
-    //  Thread onto the timer list
-    KeQuerySystemTime(&NewNode->CreateTime);
-    InsertTailList(&Cache->TimerQueue, &NewNode->ListLinks);
-
-    Cache->NumEntries++;
-
-    //  Stash tunneling information
     NewNode->DirKey = DirKey;
+    NewNode->Hash = Hash;
     if (KeyByShortName) {
         NewNode->Flags = TUNNEL_FLAG_KEY_SHORT;
     } else {
@@ -475,9 +487,27 @@ Arguments:
         SetFlag(NewNode->Flags, TUNNEL_FLAG_NON_LOOKASIDE);
     }
 
-    //  Clean out the cache, release, and then drop any pool memory we need to
-    FsRtlPruneTunnelCache(Cache, &FreePoolList);
-    ExReleaseFastMutex(&Cache->Mutex);
+    //  The copying is done outside of the bucket mutex.  Now age the bucket, replace any entry with the same key and thread the new node onto the tail.
+    Bucket = FsRtlTunnelBucket(Cache, Hash);
+    ExAcquireFastMutex(&Bucket->Mutex);
+    FsRtlPruneTunnelBucket(Cache, Bucket, &FreePoolList);
+
+    for (Link = Bucket->Nodes.Flink; Link != &Bucket->Nodes; Link = Link->Flink) {
+        Node = CONTAINING_RECORD(Link, TUNNEL_NODE, ListLinks);
+        if (FsRtlNodeMatchesKey(Node, Hash, DirKey, NameKey)) {
+            //  Entry exists in the cache, so free the old node
+            FsRtlRemoveNodeFromTunnel(Cache, Node, &FreePoolList);
+            break;
+        }
+    }
+
+    KeQuerySystemTime(&NewNode->CreateTime);
+    InsertTailList(&Bucket->Nodes, &NewNode->ListLinks);
+    InterlockedIncrement(&Cache->NumEntries);
+    ExReleaseFastMutex(&Bucket->Mutex);
+
+    //  Advance the eviction hand to keep the cache within its bounds, then drop any pool memory we need to
+    FsRtlTrimTunnelCache(Cache, &FreePoolList);
     FsRtlEmptyFreePoolList(&FreePoolList);
 }
 
@@ -560,9 +590,10 @@ Return Value:
     Boolean true if found, false otherwise
 */
 {
-    PRTL_SPLAY_LINKS Links;
+    ULONG Hash;
+    PTUNNEL_BUCKET Bucket;
+    PLIST_ENTRY Link;
     PTUNNEL_NODE Node = NULL;
-    LONG Compare;
     LIST_ENTRY FreePoolList;
 
     BOOLEAN Status = FALSE;
@@ -570,33 +601,27 @@ Return Value:
     PAGED_CODE();
 
     //  If MaxEntries is 0 then tunneling is disabled.
-    if (TunnelMaxEntries == 0) {
+    if (TunnelMaxEntries == 0 || Cache->Buckets == NULL) {
         return FALSE;
     }
 
     InitializeListHead(&FreePoolList);
 
-    ExAcquireFastMutex(&Cache->Mutex);
+    Hash = FsRtlTunnelHash(DirKey, Name);
+    Bucket = FsRtlTunnelBucket(Cache, Hash);
+    ExAcquireFastMutex(&Bucket->Mutex);
 
     //  Expire aged entries first so we don't grab old data
-    FsRtlPruneTunnelCache(Cache, &FreePoolList);
-    Links = Cache->Cache;
-    while (Links) {
-        Node = CONTAINING_RECORD(Links, TUNNEL_NODE, CacheLinks);
-        Compare = FsRtlCompareNodeAndKey(Node, DirKey, Name);
-        if (Compare > 0) {
-            Links = RtlLeftChild(&Node->CacheLinks);
-        } else {
-            if (Compare < 0) {
-                Links = RtlRightChild(&Node->CacheLinks);
-            } else {
-                break;//  Found tunneling information
-            }
+    FsRtlPruneTunnelBucket(Cache, Bucket, &FreePoolList);
+    for (Link = Bucket->Nodes.Flink; Link != &Bucket->Nodes; Link = Link->Flink) {
+        Node = CONTAINING_RECORD(Link, TUNNEL_NODE, ListLinks);
+        if (FsRtlNodeMatchesKey(Node, Hash, DirKey, Name)) {
+            break;//  Found tunneling information
         }
     }
 
     try {
-        if (Links) {
+        if (Link != &Bucket->Nodes) {
             //  Copy node data into caller's area
             ASSERT(ShortName->MaximumLength >= (8 + 1 + 3) * sizeof(WCHAR));
             RtlCopyUnicodeString(ShortName, &Node->ShortName);
@@ -616,7 +641,7 @@ Return Value:
             Status = TRUE;
         }
     } finally{
-        ExReleaseFastMutex(&Cache->Mutex);
+        ExReleaseFastMutex(&Bucket->Mutex);
         FsRtlEmptyFreePoolList(&FreePoolList);
     }
 
@@ -640,63 +665,40 @@ Return Value:
 VOID FsRtlDeleteKeyFromTunnelCache(__in TUNNEL *Cache, __in ULONGLONG DirKey)
 /*
 Routine Description:
-    Deletes all entries in the cache associated with a specific directory
+    Deletes all entries in the cache associated with a specific directory.
+    The names of a directory hash across all of the buckets, so each bucket is visited in turn under its own mutex.
 Arguments:
     Cache - a tunnel cache initialized by FsRtlInitializeTunnelCache()
     DirKey - the key value of the directory (presumably being removed)
 */
 {
-    PRTL_SPLAY_LINKS Links;
-    PRTL_SPLAY_LINKS SuccessorLinks;
+    ULONG Index;
+    PTUNNEL_BUCKET Bucket;
+    PLIST_ENTRY Link, Next;
     PTUNNEL_NODE Node;
     LIST_ENTRY FreePoolList;
 
-    PRTL_SPLAY_LINKS LastLinks = NULL;
-    BOOLEAN Splay = TRUE;
-
     PAGED_CODE();
 
     //  If MaxEntries is 0 then tunneling is disabled.
-    if (TunnelMaxEntries == 0)
+    if (TunnelMaxEntries == 0 || Cache->Buckets == NULL)
         return;
 
     InitializeListHead(&FreePoolList);
-    ExAcquireFastMutex(&Cache->Mutex);
-    Links = Cache->Cache;
-    while (Links) {
-        Node = CONTAINING_RECORD(Links, TUNNEL_NODE, CacheLinks);
-        if (Node->DirKey > DirKey) {
-            //  All nodes to the right are bigger, go left
-            Links = RtlLeftChild(&Node->CacheLinks);
-        } else {
-            if (Node->DirKey < DirKey) {
-                if (LastLinks) {
-                    //  If we have previously seen a candidate node to delete and we have now gone too far left - we know where to start.
-                    break;
-                }
-
-                Links = RtlRightChild(&Node->CacheLinks);
-            } else {
-                //  Node is a candidate to be deleted, but we might have more nodes to the left in the tree. Note this location and go on.
-                LastLinks = Links;
-                Links = RtlLeftChild(&Node->CacheLinks);
+    for (Index = 0; Index <= Cache->BucketMask; Index++) {
+        Bucket = &Cache->Buckets[Index];
+        ExAcquireFastMutex(&Bucket->Mutex);
+        for (Link = Bucket->Nodes.Flink; Link != &Bucket->Nodes; Link = Next) {
+            Next = Link->Flink;
+            Node = CONTAINING_RECORD(Link, TUNNEL_NODE, ListLinks);
+            if (Node->DirKey == DirKey) {
+                FsRtlRemoveNodeFromTunnel(Cache, Node, &FreePoolList);
             }
         }
-    }
-
-    for (Links = LastLinks; Links; Links = SuccessorLinks) {
-        SuccessorLinks = RtlRealSuccessor(Links);
-        Node = CONTAINING_RECORD(Links, TUNNEL_NODE, CacheLinks);
-        if (Node->DirKey != DirKey) {
-            //  Reached nodes which have a different key, so we're done
-            break;
-        }
 
-        FsRtlRemoveNodeFromTunnel(Cache, Node, &FreePoolList, &Splay);
+        ExReleaseFastMutex(&Bucket->Mutex);
     }
 
-    ExReleaseFastMutex(&Cache->Mutex);
-
     FsRtlEmptyFreePoolList(&FreePoolList);//  Free delayed pool
 }
 
@@ -719,44 +721,49 @@ Arguments:
     Cache - the cache to delete, initialized by FsRtlInitializeTunnelCache()
 */
 {
+    ULONG Index;
     PTUNNEL_NODE Node;
     PLIST_ENTRY Link, Next;
 
     PAGED_CODE();
 
     //  If MaxEntries is 0 then tunneling is disabled.
-    if (TunnelMaxEntries == 0)
+    if (TunnelMaxEntries == 0 || Cache->Buckets == NULL)
         return;
 
-    //  Zero out the cache and delete everything on the timer list
-    Cache->Cache = NULL;
-    Cache->NumEntries = 0;
-    for (Link = Cache->TimerQueue.Flink; Link != &Cache->TimerQueue; Link = Next) {
-        Next = Link->Flink;
-        Node = CONTAINING_RECORD(Link, TUNNEL_NODE, ListLinks);
-        FsRtlFreeTunnelNode(Node, NULL);
+    //  Delete everything in each bucket and then the table itself
+    for (Index = 0; Index <= Cache->BucketMask; Index++) {
+        for (Link = Cache->Buckets[Index].Nodes.Flink; Link != &Cache->Buckets[Index].Nodes; Link = Next) {
+            Next = Link->Flink;
+            Node = CONTAINING_RECORD(Link, TUNNEL_NODE, ListLinks);
+            FsRtlFreeTunnelNode(Node, NULL);
+        }
     }
 
-    InitializeListHead(&Cache->TimerQueue);
+    ExFreePool(Cache->Buckets);
+    Cache->Buckets = NULL;
+    Cache->BucketMask = 0;
+    Cache->NumEntries = 0;
 }
 
 
-VOID FsRtlPruneTunnelCache(IN PTUNNEL Cache, IN OUT PLIST_ENTRY FreePoolList)
+VOID FsRtlPruneTunnelBucket(IN PTUNNEL Cache, IN PTUNNEL_BUCKET Bucket, IN OUT PLIST_ENTRY FreePoolList)
 /*
 Routine Description:
-    Removes deadwood entries from the tunnel cache as defined by TunnelMaxAge and TunnelMaxEntries.
+    Removes deadwood entries from a bucket of the tunnel cache as defined by TunnelMaxAge.
+    The caller holds the bucket mutex.
     Pool memory is returned on a list for deletion by the calling routine at a time of its choosing.
 
     For performance reasons we don't want to force freeing of memory inside a mutex.
 Arguments:
     Cache - the tunnel cache to prune
+    Bucket - the bucket of the cache to prune
     FreePoolList - a list to queue pool memory on to
 */
 {
     PTUNNEL_NODE Node;
     LARGE_INTEGER ExpireTime;
     LARGE_INTEGER CurrentTime;
-    BOOLEAN Splay = TRUE;
 
     PAGED_CODE();
 
@@ -764,23 +771,54 @@ Arguments:
     KeQuerySystemTime(&CurrentTime);
     ExpireTime.QuadPart = CurrentTime.QuadPart - TunnelMaxAge;
 
-    //  Expire old entries off of the timer queue.
+    //  Expire old entries off of the head of the bucket.
     //  We have to check for future time because the clock may jump as a result of hard clock change.
-    //  If we did not do this, a rogue entry with a future time could sit at the top of the queue and prevent entries from going away.
-    while (!IsListEmpty(&Cache->TimerQueue)) {
-        Node = CONTAINING_RECORD(Cache->TimerQueue.Flink, TUNNEL_NODE, ListLinks);
+    //  If we did not do this, a rogue entry with a future time could sit at the head of the bucket and prevent entries from going away.
+    while (!IsListEmpty(&Bucket->Nodes)) {
+        Node = CONTAINING_RECORD(Bucket->Nodes.Flink, TUNNEL_NODE, ListLinks);
         if (Node->CreateTime.QuadPart < ExpireTime.QuadPart || Node->CreateTime.QuadPart > CurrentTime.QuadPart) {
-            FsRtlRemoveNodeFromTunnel(Cache, Node, FreePoolList, &Splay);
+            FsRtlRemoveNodeFromTunnel(Cache, Node, FreePoolList);
         } else {
             //  No more nodes to be expired
             break;
         }
     }
+}
+
+
+VOID FsRtlTrimTunnelCache(IN PTUNNEL Cache, IN OUT PLIST_ENTRY FreePoolList)
+/*
+Routine Description:
+    Advances the eviction hand of the tunnel cache.
+    The bucket under the hand is aged, and while the cache holds more than TunnelMaxEntries the hand keeps moving, retiring the oldest entry of each bucket it passes.
+    Entries in buckets which are not otherwise touched are therefore aged out at the rate entries are added.
 
-    //  Remove entries until we're under the TunnelMaxEntries limit
-    while (Cache->NumEntries > TunnelMaxEntries) {
-        Node = CONTAINING_RECORD(Cache->TimerQueue.Flink, TUNNEL_NODE, ListLinks);
-        FsRtlRemoveNodeFromTunnel(Cache, Node, FreePoolList, &Splay);
+    The caller must not hold any bucket mutex.
+Arguments:
+    Cache - the tunnel cache to trim
+    FreePoolList - a list to queue pool memory on to
+*/
+{
+    PTUNNEL_BUCKET Bucket;
+    ULONG Sweep;
+
+    PAGED_CODE();
+
+    //  Visit at most every bucket once, so that we give up if other threads are emptying the same buckets under us.
+    for (Sweep = 0; Sweep <= Cache->BucketMask; Sweep++) {
+        Bucket = &Cache->Buckets[(ULONG)InterlockedIncrement(&Cache->EvictionHand) & Cache->BucketMask];
+
+        ExAcquireFastMutex(&Bucket->Mutex);
+        FsRtlPruneTunnelBucket(Cache, Bucket, FreePoolList);
+        if ((ULONG)Cache->NumEntries > TunnelMaxEntries && !IsListEmpty(&Bucket->Nodes)) {
+            FsRtlRemoveNodeFromTunnel(Cache, CONTAINING_RECORD(Bucket->Nodes.Flink, TUNNEL_NODE, ListLinks), FreePoolList);
+        }
+
+        ExReleaseFastMutex(&Bucket->Mutex);
+
+        if ((ULONG)Cache->NumEntries <= TunnelMaxEntries) {
+            break;
+        }
     }
 }
 
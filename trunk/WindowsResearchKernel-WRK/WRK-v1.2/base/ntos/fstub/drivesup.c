@@ -1524,19 +1524,9 @@ NTSTATUS FASTCALL IoReadPartitionTable(
         readSize = 512;
     }
 
-    // Look to see if this is an EZDrive Disk.  If it is then get the real partition table at 1.
-    {
-        PVOID buff;
-
-        HalExamineMBR(DeviceObject, readSize, (ULONG)0x55, &buff);
-        if (buff) {
-            foundEZHooker = TRUE;
-            ExFreePool(buff);
-            partitionTableOffset.QuadPart = 512;
-        } else {
-            partitionTableOffset.QuadPart = 0;
-        }
-    }
+    // Start with the master boot record.
+    // N.B. Whether this is an EZDrive disk is determined from the first read of sector 0 below rather than with a separate HalExamineMBR read of the same sector.
+    partitionTableOffset.QuadPart = 0;
 
     // Get the drive size so we can verify that the partition table is correct.
     status = HalpGetFullGeometry(DeviceObject, &diskGeometry, &maxOffset);
@@ -1602,6 +1592,15 @@ NTSTATUS FASTCALL IoReadPartitionTable(
             break;
         }
 
+        // Look to see if this is an EZDrive Disk.  If it is then get the real partition table at 1.
+        if (primaryPartitionTable && !foundEZHooker &&
+            (((PUSHORT)readBuffer)[BOOT_SIGNATURE_OFFSET] == BOOT_RECORD_SIGNATURE) &&
+            (((PPARTITION_DESCRIPTOR) &(((PUSHORT)readBuffer)[PARTITION_TABLE_OFFSET]))->PartitionType == 0x55)) {
+            foundEZHooker = TRUE;
+            partitionTableOffset.QuadPart = 512;
+            continue;
+        }
+
         // If EZDrive is hooking the MBR then we found the first partition table in sector 1 rather than 0.
         // However that partition table is relative to sector zero.
         // So, Even though we got it from one, reset the partition offset to 0.
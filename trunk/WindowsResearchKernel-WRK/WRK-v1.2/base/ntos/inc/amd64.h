@@ -1012,7 +1012,11 @@ typedef struct _KPRCB {
 
 // Context switch count.
     ULONG KeContextSwitches;
-    UCHAR PrcbPad2[12];
+
+// Cache manager map and pin performance counters.
+    ULONG CcMapDataNoWait;
+    ULONG CcMapDataWait;
+    ULONG CcPinReadWait;
 
 // MP interprocessor request packet and summary - 128-byte aligned.
     volatile KAFFINITY TargetSet;
@@ -1048,7 +1052,7 @@ typedef struct _KPRCB {
     ULONG DpcLastCount;
     BOOLEAN ThreadDpcEnable;
     volatile BOOLEAN QuantumEnd;
-    UCHAR PrcbPad50;
+    UCHAR IdleTickSkip;
     volatile BOOLEAN IdleSchedule;
     LONG DpcSetEventRequest;
     LONG PrcbPad40;
@@ -164,6 +164,14 @@ extern ULONG CcMdlReadNoWaitMiss;
 extern ULONG CcMdlReadWaitMiss;
 
 extern ULONG CcReadAheadIos;
+extern ULONG CcReadAheadPages;
+extern ULONG CcReadAheadPagesResident;
+
+extern ULONG CcVacbMaps;
+extern ULONG CcVacbUnmaps;
+
+extern ULONG CcDeferredWriteWaits;
+extern ULONGLONG CcDeferredWriteWaitTime;
 
 extern ULONG CcLazyWriteIos;
 extern ULONG CcLazyWritePages;
@@ -174,6 +182,13 @@ extern ULONG CcLostDelayedWrites;
 
 extern PULONG CcMissCounter;
 
+NTSTATUS
+CcGetCacheManagerInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
 // Global Maintenance routines
 NTKERNELAPI BOOLEAN CcInitializeCacheManager (VOID);
 LOGICAL CcHasInactiveViews (VOID);
@@ -333,6 +348,23 @@ CcMdlRead (
     __out PIO_STATUS_BLOCK IoStatus
     );
 
+//  Describes one of the ranges locked by CcMdlReadRanges.
+
+typedef struct _CC_MDL_READ_RANGE {
+    LARGE_INTEGER FileOffset;
+    ULONG Length;
+} CC_MDL_READ_RANGE, *PCC_MDL_READ_RANGE;
+
+NTKERNELAPI
+VOID
+CcMdlReadRanges (
+    __in PFILE_OBJECT FileObject,
+    __in ULONG RangeCount,
+    __in_ecount(RangeCount) PCC_MDL_READ_RANGE Ranges,
+    __out PMDL *MdlChain,
+    __out PIO_STATUS_BLOCK IoStatus
+    );
+
 
 //  This routine is now a wrapper for FastIo if present or CcMdlReadComplete2
 
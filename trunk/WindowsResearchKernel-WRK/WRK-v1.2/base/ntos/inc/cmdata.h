@@ -510,8 +510,20 @@ typedef union _KEY_VALUE_INFORMATION {
 #define CM_CACHE_DATA_TOO_BIG    2
 #define MAXIMUM_CACHED_DATA   2048  // Maximum data size to be cached.
 
+// Keys with many values get a hash index over the cached value list, built on the first lookup made with the KCB
+// lock held exclusive.  Buckets[] holds (value index + 1) of the first value in each bucket and Links, which follows
+// the buckets, holds (value index + 1) of the next value in the same bucket; 0 terminates a chain.
+// The index lives and dies with the cached value list, so anything that rebuilds the value cache drops it.
+
+typedef struct _CM_VALUE_HASH_INDEX {
+    ULONG       BucketCount;
+    PULONG      Links;
+    ULONG       Buckets[1];
+} CM_VALUE_HASH_INDEX, *PCM_VALUE_HASH_INDEX; // This is only used as a pointer.
+
 typedef struct _CM_CACHED_VALUE_INDEX {
     HCELL_INDEX CellIndex;
+    PCM_VALUE_HASH_INDEX HashIndex;
     union {
         CELL_DATA        CellData;
         ULONG_PTR        List[1];
@@ -822,6 +822,17 @@ PSLIST_ENTRY FASTCALL InterlockedPushListSList(IN PSLIST_HEADER ListHead,
 // Define interlocked lookaside list structure and allocation functions.
 VOID ExAdjustLookasideDepth(VOID);
 
+// Define the tuning history the depth adjustment keeps in the reserved fields of a lookaside list structure.
+#define LOOKASIDE_DEPTH_HISTORY 2
+
+typedef struct _LOOKASIDE_TUNING {
+    USHORT MissRatio;
+    USHORT PeakDepth;
+    USHORT DepthHistory[LOOKASIDE_DEPTH_HISTORY];
+} LOOKASIDE_TUNING, * PLOOKASIDE_TUNING;
+
+#define EX_LOOKASIDE_TUNING(Lookaside) ((PLOOKASIDE_TUNING)&(Lookaside)->Future[0])
+
 // begin_ntddk begin_wdm begin_ntosp
 
 typedef PVOID(*PALLOCATE_FUNCTION) (IN POOL_TYPE PoolType, IN SIZE_T NumberOfBytes, IN ULONG Tag);
@@ -962,6 +973,36 @@ typedef struct DECLSPEC_CACHEALIGN _PAGED_LOOKASIDE_LIST {
 C_ASSERT(sizeof(NPAGED_LOOKASIDE_LIST) == sizeof(PAGED_LOOKASIDE_LIST));
 #endif
 
+C_ASSERT(sizeof(LOOKASIDE_TUNING) == RTL_FIELD_SIZE(GENERAL_LOOKASIDE, Future));
+
+// Define object cache structures and functions.
+
+// N.B. An object cache is a global and a set of per processor lookaside lists whose entries stay constructed while they are cached.
+//      The constructor runs when an entry is allocated from pool and the destructor runs when an entry is returned to pool.
+//      The lists are inserted in the general lookaside lists, so their depth is adjusted and trimmed with the other lookaside lists.
+typedef VOID (*PEX_OBJECT_CACHE_CONSTRUCTOR) (IN PVOID Object, IN PVOID Context);
+typedef VOID (*PEX_OBJECT_CACHE_DESTRUCTOR) (IN PVOID Object, IN PVOID Context);
+
+typedef struct _EX_OBJECT_CACHE {
+    GENERAL_LOOKASIDE L;
+    PGENERAL_LOOKASIDE PerProcessor;
+    ULONG NumberProcessors;
+    PEX_OBJECT_CACHE_CONSTRUCTOR Constructor;
+    PEX_OBJECT_CACHE_DESTRUCTOR Destructor;
+    PVOID Context;
+} EX_OBJECT_CACHE, * PEX_OBJECT_CACHE;
+
+NTSTATUS ExInitializeObjectCache(OUT PEX_OBJECT_CACHE Cache,
+                                 IN POOL_TYPE PoolType,
+                                 IN SIZE_T Size,
+                                 IN ULONG Tag,
+                                 IN PEX_OBJECT_CACHE_CONSTRUCTOR Constructor OPTIONAL,
+                                 IN PEX_OBJECT_CACHE_DESTRUCTOR Destructor OPTIONAL,
+                                 IN PVOID Context OPTIONAL);
+VOID ExDeleteObjectCache(IN PEX_OBJECT_CACHE Cache);
+PVOID ExAllocateFromObjectCache(IN PEX_OBJECT_CACHE Cache, IN SIZE_T Size);
+VOID ExFreeToObjectCache(IN PVOID Object);
+
 // begin_ntddk begin_wdm begin_nthal begin_ntifs begin_ntosp
 
 NTKERNELAPI VOID ExInitializePagedLookasideList(__out PPAGED_LOOKASIDE_LIST Lookaside,
@@ -1043,6 +1084,7 @@ typedef enum _PP_NPAGED_LOOKASIDE_NUMBER {
     LookasideNameBufferList,
     LookasideTwilightList,
     LookasideCompletionList,
+    LookasideMediumIrpList,
     LookasideMaximumList
 } PP_NPAGED_LOOKASIDE_NUMBER, * PPP_NPAGED_LOOKASIDE_NUMBER;
 
@@ -1176,6 +1218,27 @@ NTKERNELAPI DECLSPEC_NORETURN VOID ExRaiseAccessViolation(VOID);
 }
 
 
+FORCEINLINE BOOLEAN ExIsUserAddressRange(IN CONST VOID *Address, IN SIZE_T Length)
+/*
+Routine Description:
+    This function checks whether a buffer lies entirely in the user address space without touching the buffer.
+    It allows a system service to reject a buffer that ProbeForRead or ProbeForWrite would fail on with a status instead of raising and dispatching an access violation.
+    N.B. A buffer that passes this check must still be probed, since its pages may not be accessible.
+Arguments:
+    Address - Supplies a pointer to the buffer.
+    Length - Supplies the length of the buffer.
+Return Value:
+    TRUE if the buffer has zero length or lies below MM_USER_PROBE_ADDRESS, FALSE otherwise.
+*/
+{
+    if ((Length != 0) && ((((ULONG_PTR)Address + Length) > (ULONG_PTR)MM_USER_PROBE_ADDRESS) || (((ULONG_PTR)Address + Length) < (ULONG_PTR)Address))) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
 #if defined(_AMD64_)
 FORCEINLINE VOID ProbeForReadSmallStructure(IN PVOID Address, IN SIZE_T Size, IN ULONG Alignment)
 /*
@@ -2363,6 +2426,7 @@ typedef struct _ERESOURCE {
 //  Values for ERESOURCE.Flag
 #define ResourceNeverExclusive       0x10
 #define ResourceReleaseByOtherThread 0x20
+#define ResourceCacheAware           0x40
 #define ResourceOwnedExclusive       0x80
 
 #define RESOURCE_HASH_TABLE_SIZE 64
@@ -2391,6 +2455,7 @@ typedef struct _RESOURCE_PERFORMANCE_DATA {
 // Define executive resource function prototypes.
 NTKERNELAPI NTSTATUS ExInitializeResourceLite(__out PERESOURCE Resource);
 NTKERNELAPI NTSTATUS ExReinitializeResourceLite(__inout PERESOURCE Resource);
+NTKERNELAPI NTSTATUS ExInitializeCacheAwareResourceLite(__out PERESOURCE Resource);
 NTKERNELAPI BOOLEAN ExAcquireResourceSharedLite(__inout PERESOURCE Resource, __in BOOLEAN Wait);
 NTKERNELAPI PVOID ExEnterCriticalRegionAndAcquireResourceShared(__inout PERESOURCE Resource);
 NTKERNELAPI BOOLEAN ExAcquireResourceExclusiveLite(__inout PERESOURCE Resource, __in BOOLEAN Wait);
@@ -2524,6 +2589,14 @@ typedef struct _EX_PUSH_LOCK_CACHE_AWARE_PADDED {
     };
 } EX_PUSH_LOCK_CACHE_AWARE_PADDED, * PEX_PUSH_LOCK_CACHE_AWARE_PADDED;
 
+// Define a push lock that is expanded to a cache aware push lock at runtime once its shared acquires contend.
+// Exclusive owners always own the local lock and, once the push lock is expanded, all the slots of the cache aware push lock.
+typedef struct _EX_PUSH_LOCK_AUTO_EXPAND {
+    EX_PUSH_LOCK LocalLock;
+    PEX_PUSH_LOCK_CACHE_AWARE CacheAwareLock;
+    ULONG Contention;
+} EX_PUSH_LOCK_AUTO_EXPAND, * PEX_PUSH_LOCK_AUTO_EXPAND;
+
 // begin_wdm begin_ntddk begin_ntifs
 
 typedef struct _EX_RUNDOWN_REF {// Rundown protection structure
@@ -2714,6 +2787,21 @@ typedef struct _HANDLE_TABLE {
         // If this bit is set then we always use FIFO handle allocation.
         BOOLEAN StrictFIFO : 1;
     };
+
+    // Per processor caches of free handles. Allocated on the first free on a multiprocessor and never changed after that.
+    struct _HANDLE_TABLE_FREE_CACHE* FreeCache;
+
+    // The number of entries marked OBJ_INHERIT and a summary of the low level tables that ever held one.
+    // Bit N of the summary is set for every low level table whose index modulo 32 is N. The summary is never cleared
+    // so a clear bit means that none of those tables has an inheritable entry, which lets duplication skip them.
+    LONG InheritableCount;
+    ULONG InheritablePages;
+
+    // The number of entries marked OBJ_INHERIT and a summary of the low level tables that ever held one.
+    // Bit N of the summary is set for every low level table whose index modulo 32 is N. The summary is never cleared
+    // so a clear bit means that none of those tables has an inheritable entry, which lets duplication skip them.
+    LONG InheritableCount;
+    ULONG InheritablePages;
 } HANDLE_TABLE, * PHANDLE_TABLE;
 
 //  Routines for handle manipulation.
@@ -2745,6 +2833,10 @@ NTKERNELAPI BOOLEAN ExEnumHandleTable(
 NTKERNELAPI VOID ExSweepHandleTable(__in PHANDLE_TABLE HandleTable,
                                     __in EX_ENUMERATE_HANDLE_ROUTINE EnumHandleProcedure,
                                     __in PVOID EnumParameter);
+NTKERNELAPI BOOLEAN ExSweepHandleTablePartition(__in PHANDLE_TABLE HandleTable,
+                                                __in ULONG Partition,
+                                                __in EX_ENUMERATE_HANDLE_ROUTINE EnumHandleProcedure,
+                                                __in PVOID EnumParameter);
 
 //  A function to duplicate the handle table of a process using a callback
 
@@ -2802,6 +2894,9 @@ NTKERNELAPI PHANDLE_TABLE_ENTRY ExMapHandleToPointer(__in PHANDLE_TABLE HandleTa
 NTKERNELAPI PHANDLE_TABLE_ENTRY ExMapHandleToPointerEx(__in PHANDLE_TABLE HandleTable,
                                                        __in HANDLE Handle,
                                                        __in KPROCESSOR_MODE PreviousMode);
+NTKERNELAPI PHANDLE_TABLE_ENTRY ExReadHandleTableEntry(__in PHANDLE_TABLE HandleTable,
+                                                       __in HANDLE Handle,
+                                                       __out PHANDLE_TABLE_ENTRY Snapshot);
 NTKERNELAPI NTSTATUS ExSetHandleInfo(__inout PHANDLE_TABLE HandleTable,
                                      __in HANDLE Handle,
                                      __in PHANDLE_TABLE_ENTRY_INFO EntryInfo,
@@ -3037,6 +3132,7 @@ extern PVOID ExPageLockHandle;// The lock handle for PAGELK section, initialized
 extern PCALLBACK_OBJECT ExCbSetSystemTime;
 extern PCALLBACK_OBJECT ExCbSetSystemState;
 extern PCALLBACK_OBJECT ExCbPowerState;
+extern PCALLBACK_OBJECT ExCbMemoryPressure;
 
 // begin_ntosp
 
@@ -3942,6 +4038,61 @@ Arguments:
     ExReleasePushLockSharedAssumeSingleOwner(PushLock);
 }
 
+NTKERNELAPI VOID ExAcquireAutoExpandPushLockExclusive(__inout PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock);
+NTKERNELAPI VOID ExReleaseAutoExpandPushLockExclusive(__inout PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock);
+NTKERNELAPI VOID FASTCALL ExfAcquireAutoExpandPushLockShared(__inout PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock);
+VOID FORCEINLINE ExInitializeAutoExpandPushLock(__out PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock)
+/*
+Routine Description:
+    Initialize an auto expand push lock. The push lock starts out as a single push lock.
+Arguments:
+    AutoExpandPushLock - Auto expand push lock to be initialized
+*/
+{
+    ExInitializePushLock(&AutoExpandPushLock->LocalLock);
+    AutoExpandPushLock->CacheAwareLock = NULL;
+    AutoExpandPushLock->Contention = 0;
+}
+
+PEX_PUSH_LOCK FORCEINLINE ExAcquireAutoExpandPushLockShared(IN PEX_PUSH_LOCK_AUTO_EXPAND AutoExpandPushLock)
+/*
+Routine Description:
+    Acquire an auto expand push lock shared.
+Arguments:
+    AutoExpandPushLock - Auto expand push lock to be acquired
+Return Value:
+    PEX_PUSH_LOCK - The push lock that was acquired. It must be passed to ExReleaseAutoExpandPushLockShared.
+*/
+{
+    PEX_PUSH_LOCK_CACHE_AWARE CacheAwarePushLock;
+
+    // If the push lock has been expanded, then take a single slot of the cache aware push lock shared.
+    CacheAwarePushLock = *((PEX_PUSH_LOCK_CACHE_AWARE volatile *)&AutoExpandPushLock->CacheAwareLock);
+    if (CacheAwarePushLock != NULL) {
+        return ExAcquireCacheAwarePushLockShared(CacheAwarePushLock);
+    }
+
+    // Take the local lock shared. If it is already owned, then the acquire is counted as contention.
+
+    // N.B. Exclusive owners always own the local lock, so it remains a valid shared acquire if the push lock is expanded after it is granted.
+    if (InterlockedCompareExchangePointer(&AutoExpandPushLock->LocalLock.Ptr, (PVOID)(EX_PUSH_LOCK_SHARE_INC | EX_PUSH_LOCK_LOCK), NULL) != NULL) {
+        ExfAcquireAutoExpandPushLockShared(AutoExpandPushLock);
+    }
+
+    return &AutoExpandPushLock->LocalLock;
+}
+
+VOID FORCEINLINE ExReleaseAutoExpandPushLockShared(IN PEX_PUSH_LOCK PushLock)
+/*
+Routine Description:
+    Release an auto expand push lock shared.
+Arguments:
+    PushLock - Push lock returned by ExAcquireAutoExpandPushLockShared
+*/
+{
+    ExReleasePushLockShared(PushLock);
+}
+
 #endif // !defined(NONTOSPINTERLOCK)
 
 // end_ntosp
@@ -3956,7 +4107,7 @@ typedef NTSTATUS(*PEX_CALLBACK_FUNCTION) (IN PVOID CallbackContext, IN PVOID Arg
 // end_wdm end_ntddk
 
 typedef struct _EX_CALLBACK_ROUTINE_BLOCK {
-    EX_RUNDOWN_REF        RundownProtect;
+    PEX_RUNDOWN_REF_CACHE_AWARE RundownProtect;// Per-processor rundown protection allocated after the block
     PEX_CALLBACK_FUNCTION Function;
     PVOID                 Context;
 } EX_CALLBACK_ROUTINE_BLOCK, * PEX_CALLBACK_ROUTINE_BLOCK;
@@ -87,6 +87,21 @@ typedef struct _FSRTL_ADVANCED_FCB_HEADER {
     // This is a pointer to a list of context structures belonging to filesystem filter drivers that are linked above the filesystem.
     // Each structure is headed by FSRTL_FILTER_CONTEXT.
     LIST_ENTRY FilterContexts;
+
+    //  The following two fields are supported only if Flags2 contains FSRTL_FLAG2_SUPPORTS_FAST_READ_SEQUENCE
+
+    //  This sequence is odd while the file system is changing the file size, the fast I/O state or the cache map of the stream.
+    //  It is only changed through FsRtlBeginFastReadBarrier and FsRtlEndFastReadBarrier.
+    volatile LONG FastReadSequence;
+
+    //  The number of fast reads in progress on the stream which did not acquire the main resource.
+    volatile LONG FastReaders;
+
+    //  The following field is supported only if Flags2 contains FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX
+
+    //  This is an index of FilterContexts by owner which lets FsRtlLookupPerStreamContext run without the Fast Mutex.
+    //  It is private to FsRtl, allocated on the first context insertion and freed by FsRtlTeardownPerStreamContexts.
+    struct _FSRTL_FILTER_CONTEXT_INDEX *FilterContextIndex;
 } FSRTL_ADVANCED_FCB_HEADER;
 typedef FSRTL_ADVANCED_FCB_HEADER *PFSRTL_ADVANCED_FCB_HEADER;
 
@@ -126,6 +141,16 @@ typedef FSRTL_ADVANCED_FCB_HEADER *PFSRTL_ADVANCED_FCB_HEADER;
 //  If this flag is set, the cache manager will flush and purge the cache map when a user first maps a file
 #define FSRTL_FLAG2_PURGE_WHEN_MAPPED (0x04)
 
+//  If this flag is set, the additional fields FastReadSequence and FastReaders are supported in FSRTL_ADVANCED_FCB_HEADER, and FsRtlCopyRead
+//  will satisfy cached reads without acquiring the main resource.
+//  The file system must then bracket every change to FileSize, ValidDataLength or IsFastIoPossible (including byte range lock changes), and
+//  every teardown of the cache map, with FsRtlBeginFastReadBarrier and FsRtlEndFastReadBarrier, and its paging read path must not need the main resource.
+#define FSRTL_FLAG2_SUPPORTS_FAST_READ_SEQUENCE (0x08)
+
+//  If this flag is set, the additional field FilterContextIndex is supported in FSRTL_ADVANCED_FCB_HEADER.
+//  FsRtlSetupAdvancedHeader sets this flag and initializes the field.
+#define FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX (0x10)
+
 //  The following constants are used to block top level Irp processing when (in either the fast io or cc case) file system resources have been
 //  acquired above the file system, or we are in an Fsp thread.
 
@@ -381,10 +406,10 @@ FsRtlPrivateLock (
 
 //  Tunnel cache structure
 typedef struct {
-    FAST_MUTEX          Mutex;//  Mutex for cache manipulation
-    PRTL_SPLAY_LINKS    Cache;//  Splay Tree of tunneled information keyed by DirKey ## Name
-    LIST_ENTRY          TimerQueue;//  Timer queue used to age entries out of the main cache
-    USHORT              NumEntries;//  Keep track of the number of entries in the cache to prevent excessive use of memory
+    struct _TUNNEL_BUCKET *Buckets;//  Hash table of tunneled information keyed by DirKey ## Name, each bucket with its own mutex
+    ULONG               BucketMask;//  Number of buckets in the table minus one
+    volatile LONG       NumEntries;//  Keep track of the number of entries in the cache to prevent excessive use of memory
+    volatile LONG       EvictionHand;//  Next bucket to be aged and trimmed when entries are added
 } TUNNEL, *PTUNNEL;
 
 NTKERNELAPI VOID FsRtlInitializeTunnelCache (__in TUNNEL *Cache);
@@ -539,10 +564,13 @@ NTKERNELAPI PERESOURCE FsRtlAllocateResource ();
 //  So to do that we need to export the structure.  This structure is not exact.
 //  The Mapping field is declared here as a pvoid but largemcb.c it is a pointer to mapping pairs.
 
+//  LastIndex is only a hint used by largemcb.c to speed up sequential lookups, and is checked against PairCount before it is used.
+
 typedef struct _BASE_MCB {
     ULONG MaximumPairCount;
     ULONG PairCount;
     POOL_TYPE PoolType;
+    ULONG LastIndex;
     PVOID Mapping;
 } BASE_MCB;
 typedef BASE_MCB *PBASE_MCB;
@@ -644,6 +672,18 @@ NTKERNELAPI NTSTATUS FsRtlCheckOplock (
 NTKERNELAPI BOOLEAN FsRtlOplockIsFastIoPossible (__in POPLOCK Oplock);
 NTKERNELAPI BOOLEAN FsRtlCurrentBatchOplock (__in POPLOCK Oplock);
 
+//  Oplock break statistics kept for each volume device object.
+//  The times are the interval from an operation starting to wait for a break until the break is acknowledged, in 100ns units.
+
+typedef struct _FSRTL_OPLOCK_STATISTICS {
+    ULONG BreakCount;
+    ULONG WaitCount;
+    LARGE_INTEGER WaitTime;
+    LARGE_INTEGER MaximumWaitTime;
+} FSRTL_OPLOCK_STATISTICS, *PFSRTL_OPLOCK_STATISTICS;
+
+NTKERNELAPI VOID FsRtlQueryOplockStatistics (__in PDEVICE_OBJECT VolumeDeviceObject, __out PFSRTL_OPLOCK_STATISTICS Statistics);
+
 //  Volume lock/unlock notification routines, implemented in PnP.c
 
 //  These routines provide PnP volume lock notification support for all filesystems.
@@ -774,6 +814,18 @@ NTKERNELAPI BOOLEAN FsRtlDoesNameContainWildCards (__in PUNICODE_STRING Name);
 NTKERNELAPI BOOLEAN FsRtlAreNamesEqual (__in PCUNICODE_STRING ConstantNameA, __in PCUNICODE_STRING ConstantNameB, __in BOOLEAN IgnoreCase, __in_opt PCWCH UpcaseTable);
 NTKERNELAPI BOOLEAN FsRtlIsNameInExpression (__in PUNICODE_STRING Expression, __in PUNICODE_STRING Name, __in BOOLEAN IgnoreCase, __in_opt PWCH UpcaseTable);
 
+//  An expression classified once by FsRtlCompileNameExpression, for matching every name of a directory enumeration against the same query.
+//  The structure refers to the caller's expression buffer, which must stay valid (and upcased, if IgnoreCase) for as long as the structure is used.
+typedef struct _FSRTL_NAME_EXPRESSION {
+    UNICODE_STRING Expression;
+    PWCH UpcaseTable;
+    BOOLEAN IgnoreCase;
+    UCHAR Kind;
+} FSRTL_NAME_EXPRESSION, *PFSRTL_NAME_EXPRESSION;
+
+NTKERNELAPI VOID FsRtlCompileNameExpression (__in PUNICODE_STRING Expression, __in BOOLEAN IgnoreCase, __in_opt PWCH UpcaseTable, __out PFSRTL_NAME_EXPRESSION CompiledExpression);
+NTKERNELAPI BOOLEAN FsRtlIsNameInCompiledExpression (__in PFSRTL_NAME_EXPRESSION CompiledExpression, __in PUNICODE_STRING Name);
+
 //  Stack Overflow support routine, implemented in StackOvf.c
 typedef VOID (*PFSRTL_STACK_OVERFLOW_ROUTINE) (__in PVOID Context, __in PKEVENT Event);
 NTKERNELAPI VOID FsRtlPostStackOverflow (__in PVOID Context, __in PKEVENT Event, __in PFSRTL_STACK_OVERFLOW_ROUTINE StackOverflowRoutine);
@@ -858,7 +910,9 @@ NTKERNELAPI PFSRTL_PER_STREAM_CONTEXT FsRtlRemovePerStreamContext (__in PFSRTL_A
 {                                                                           \
     SetFlag( (_advhdr)->Flags, FSRTL_FLAG_ADVANCED_HEADER );                \
     SetFlag( (_advhdr)->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXTS );     \
+    SetFlag( (_advhdr)->Flags2, FSRTL_FLAG2_SUPPORTS_FILTER_CONTEXT_INDEX );\
     InitializeListHead( &(_advhdr)->FilterContexts );                       \
+    (_advhdr)->FilterContextIndex = NULL;                                   \
     if ((_fmutx) != NULL) {                                                 \
         (_advhdr)->FastMutex = (_fmutx);                                    \
     }                                                                       \
@@ -954,6 +1008,9 @@ NTKERNELAPI VOID FsRtlIncrementCcFastReadWait(VOID);
 NTKERNELAPI VOID FsRtlIncrementCcFastReadNoWait(VOID);
 NTKERNELAPI VOID FsRtlIncrementCcFastReadResourceMiss(VOID);
 
+NTKERNELAPI VOID FsRtlBeginFastReadBarrier(__in PFSRTL_ADVANCED_FCB_HEADER Header);
+NTKERNELAPI VOID FsRtlEndFastReadBarrier(__in PFSRTL_ADVANCED_FCB_HEADER Header);
+
 //  Returns TRUE if the given fileObject represents a paging file, returns FALSE otherwise.
 NTKERNELAPI LOGICAL FsRtlIsPagingFile (__in PFILE_OBJECT FileObject);
 
@@ -846,7 +846,12 @@ typedef struct _KPRCB {
     LARGE_INTEGER IoReadTransferCount;
     LARGE_INTEGER IoWriteTransferCount;
     LARGE_INTEGER IoOtherTransferCount;
-    ULONG SpareCounter1[8];
+
+// Cache manager map and pin performance counters.
+    ULONG CcMapDataNoWait;
+    ULONG CcMapDataWait;
+    ULONG CcPinReadWait;
+    ULONG SpareCounter1[5];
 
 // Nonpaged per processor lookaside lists - 64-byte aligned.
     PP_LOOKASIDE_LIST PPLookasideList[16];
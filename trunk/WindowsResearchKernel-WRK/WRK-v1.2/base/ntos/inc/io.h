@@ -1094,6 +1094,7 @@ typedef struct _DEVICE_OBJECT *PDEVICE_OBJECT; // ntndis
 #define DOE_STARTIO_CANCELABLE          0x00000080
 #define DOE_STARTIO_DEFERRED            0x00000100  // Use non-recursive startio
 #define DOE_STARTIO_NO_CANCEL           0x00000200  // Pass non-cancelable IRP to startio
+#define DOE_CANCEL_LOCK_FREE            0x00000400  // Cancel routines run without the cancel spin lock, see IoSetCancelAttributes
 
 // begin_ntddk begin_nthal begin_ntifs begin_wdm begin_ntosp
 
@@ -1136,6 +1137,17 @@ typedef struct _DEVOBJ_EXTENSION
     PVPB           Vpb;                // If not NULL contains the VPB of the mounted volume.
                                        // Set in the filesystem's volume device object.
                                        // This is a reverse VPB pointer.
+    struct _IOP_FAIR_SHARE_QUEUE *FairShareQueue;  // If not NULL the device queue is shared fairly between processes, see IoSetDeviceQueueFairShare.
+
+    // Oplock break statistics for a file system volume device object, see FsRtlQueryOplockStatistics.
+    LONG           OplockBreakCount;            // Break notifications issued for files on this volume.
+    LONG           OplockBreakWaitCount;        // Operations which waited for a break to complete.
+    LARGE_INTEGER  OplockBreakWaitTime;         // Total time those operations waited, in 100ns units.
+    LARGE_INTEGER  OplockBreakMaximumWaitTime;  // Longest single wait, in 100ns units.
+
+    // Summary of the FsFilter callbacks registered by this device and the devices it is attached to, see FsFilterPerformCallbacks.
+    ULONG          FsFilterCallbackGeneration;  // Registration generation the summary was computed at, zero if it never was.
+    UCHAR          FsFilterCallbackMask;        // One bit for each FS_FILTER_* operation some device in the stack has callbacks for.
 
 // begin_ntddk begin_wdm begin_nthal begin_ntifs begin_ntosp
 } DEVOBJ_EXTENSION, *PDEVOBJ_EXTENSION;
@@ -1296,6 +1308,13 @@ typedef struct _IO_COMPLETION_CONTEXT
 #define FO_FILE_OBJECT_HAS_EXTENSION    0x00800000
 #define FO_REMOTE_ORIGIN                0x01000000
 
+// The I/O priority set on the handle with FileIoPriorityHintInformation, stored as IO_PRIORITY_HINT + 1 so that zero means none.
+#define FO_IO_PRIORITY_MASK             0x0E000000
+#define FO_IO_PRIORITY_SHIFT            25
+
+// A synchronous handle opened with FILE_POSITIONAL_IO_ONLY.  Reads and writes at an explicit offset do not take the file object lock.
+#define FO_POSITIONAL_IO                0x10000000
+
 typedef struct _FILE_OBJECT
 {
     CSHORT Type;
@@ -1353,6 +1372,11 @@ typedef struct _FILE_OBJECT *PFILE_OBJECT; // ntndis
 
 #define IRP_RETRY_IO_COMPLETION         0x00004000
 #define IRP_HIGH_PRIORITY_PAGING_IO     0x00008000
+#define IRP_REGISTERED_BUFFER           0x00010000
+
+// The I/O priority of the request, stored as IO_PRIORITY_HINT + 1 so that zero means the default.  See IoGetIoPriorityHint.
+#define IRP_IO_PRIORITY_MASK            0x000E0000
+#define IRP_IO_PRIORITY_SHIFT           17
 
 
 // Mask currently used by verifier. This should be made 1 flag in the
@@ -2331,6 +2355,10 @@ NTKERNELAPI BOOLEAN IoCancelIrp(IN PIRP Irp);
 
 NTKERNELAPI VOID IoCancelThreadIo(IN PETHREAD Thread);
 
+VOID IoRundownRegisteredBuffers(IN PEPROCESS Process);
+
+VOID IoInitializeThreadCompletionBatch(IN PETHREAD Thread);
+
 // begin_ntifs
 
 NTKERNELAPI NTSTATUS IoCheckDesiredAccess(IN OUT PACCESS_MASK DesiredAccess, IN ACCESS_MASK GrantedAccess);
@@ -3083,6 +3111,8 @@ NTKERNELAPI VOID IoStartNextPacket(IN PDEVICE_OBJECT DeviceObject, IN BOOLEAN Ca
 NTKERNELAPI VOID IoStartNextPacketByKey(IN PDEVICE_OBJECT DeviceObject, IN BOOLEAN Cancelable, IN ULONG Key);
 NTKERNELAPI VOID IoStartPacket(IN PDEVICE_OBJECT DeviceObject, IN PIRP Irp, IN PULONG Key OPTIONAL, IN PDRIVER_CANCEL CancelFunction OPTIONAL);
 VOID IoSetStartIoAttributes(IN PDEVICE_OBJECT DeviceObject, IN BOOLEAN DeferredStartIo, IN BOOLEAN NonCancelable);
+NTKERNELAPI VOID IoSetCancelAttributes(IN PDEVICE_OBJECT DeviceObject, IN BOOLEAN LockFreeCancel);
+NTKERNELAPI NTSTATUS IoSetDeviceQueueFairShare(IN PDEVICE_OBJECT DeviceObject, IN ULONG TargetLatency);
 
 // begin_ntifs
 
@@ -3650,6 +3680,10 @@ NTKERNELAPI NTSTATUS IoValidateDeviceIoControlAccess(IN  PIRP Irp, IN ULONG Requ
 
 NTKERNELAPI IO_PAGING_PRIORITY FASTCALL IoGetPagingIoPriority(IN PIRP IRP);
 
+NTKERNELAPI IO_PRIORITY_HINT FASTCALL IoGetIoPriorityHint(IN PIRP Irp);
+
+NTKERNELAPI NTSTATUS FASTCALL IoSetIoPriorityHint(IN PIRP Irp, IN IO_PRIORITY_HINT PriorityHint);
+
 // end_ntosp end_ntifs end_ntddk end_wdm
 
 PDEVICE_OBJECT IoFindDeviceThatFailedIrp(IN PIRP Irp);
@@ -672,6 +672,14 @@ typedef struct _ALIGNMENT_EXCEPTION_TABLE {
 
 #define KeGetCurrentNode() (KeGetCurrentPrcb()->ParentNode)
 
+// The preferred node of the current process is used for allocations made from thread context when a preferred node has been set for the process.
+// Otherwise, the node of the current processor is used.
+#define KeGetPreferredNode()                                                  \
+    (((KeGetCurrentThread()->ApcState.Process->PreferredNode != 0) &&         \
+      (KeGetCurrentIrql() < DISPATCH_LEVEL)) ?                                \
+        KeNodeBlock[KeGetCurrentThread()->ApcState.Process->IdealNode] :      \
+        KeGetCurrentNode())
+
 typedef struct DECLSPEC_CACHEALIGN _KNODE {
     SLIST_HEADER DeadStackList;         // node dead stack list
 
@@ -765,13 +773,15 @@ typedef struct _KPROCESS {
 #define KPROCESS_AUTO_ALIGNMENT_BIT 0
 #define KPROCESS_DISABLE_BOOST_BIT 1
 #define KPROCESS_DISABLE_QUANTUM_BIT 2
+#define KPROCESS_PREFERRED_NODE_BIT 3
 
     union {
         struct {
             LONG AutoAlignment : 1;
             LONG DisableBoost : 1;
             LONG DisableQuantum : 1;
-            LONG ReservedFlags : 29;
+            LONG PreferredNode : 1;
+            LONG ReservedFlags : 28;
         };
 
         LONG ProcessFlags;
@@ -885,12 +895,14 @@ typedef struct _KTHREAD {// Thread object
 
 #define KTHREAD_AUTO_ALIGNMENT_BIT 0
 #define KTHREAD_DISABLE_BOOST_BIT 1
+#define KTHREAD_PRIORITY_INHERITED_BIT 2
 
             union {
                 struct {
                     LONG AutoAlignment : 1;
                     LONG DisableBoost : 1;
-                    LONG ReservedFlags : 30;
+                    LONG PriorityInherited : 1;
+                    LONG ReservedFlags : 29;
                 };
 
                 LONG ThreadFlags;
@@ -1059,6 +1071,14 @@ typedef struct _KTHREAD {// Thread object
     LONG64 WriteTransferCount;
     LONG64 OtherTransferCount;
 #endif
+
+    // Power of two the stack protect time is scaled by for this thread.
+    // Raised when the thread wakes soon after its kernel stack was out swapped, lowered when it stays idle long after.
+    UCHAR StackProtectShift;
+
+    // Set while the thread releases a semaphore it is about to wait behind.
+    // The first waiter readied on the current processor is switched to directly instead of being dispatched elsewhere.
+    BOOLEAN DirectHandoff;
 } KTHREAD, *PKTHREAD, *PRKTHREAD;
 
 #if !defined(_X86AMD64_) && defined(_AMD64_)
@@ -1312,6 +1332,7 @@ NTKERNELAPI LONG KeReadStateQueue (__in PRKQUEUE Queue);
 NTKERNELAPI LONG KeInsertQueue (__inout PRKQUEUE Queue, __inout PLIST_ENTRY Entry);
 NTKERNELAPI LONG KeInsertHeadQueue (__inout PRKQUEUE Queue, __inout PLIST_ENTRY Entry);
 NTKERNELAPI PLIST_ENTRY KeRemoveQueue (__inout PRKQUEUE Queue, __in KPROCESSOR_MODE WaitMode, __in_opt PLARGE_INTEGER Timeout);
+NTKERNELAPI ULONG KeRemoveQueueEx (__inout PRKQUEUE Queue, __in KPROCESSOR_MODE WaitMode, __in_opt PLARGE_INTEGER Timeout, __out_ecount(Count) PLIST_ENTRY *EntryArray, __in ULONG Count);
 NTKERNELAPI PLIST_ENTRY KeRundownQueue (__inout PRKQUEUE Queue);
 
 // begin_ntddk begin_wdm
@@ -1323,6 +1344,8 @@ NTKERNELAPI LONG KeReleaseSemaphore (__inout PRKSEMAPHORE Semaphore, __in KPRIOR
 
 // end_ntddk end_wdm end_nthal end_ntifs end_ntosp
 
+LONG KeReleaseSemaphoreHandoff (__inout PRKSEMAPHORE Semaphore, __in KPRIORITY Increment, __in LONG Adjustment);
+
 // Process object
 VOID KeInitializeProcess (__out PRKPROCESS Process, __in KPRIORITY Priority, __in KAFFINITY Affinity, __in ULONG_PTR DirectoryTableBase[2], __in BOOLEAN Enable);
 LOGICAL KeForceAttachProcess (__inout PKPROCESS Process);
@@ -1366,6 +1389,7 @@ KPRIORITY KeSetPriorityAndQuantumProcess (__inout PKPROCESS Process, __in KPRIOR
 VOID KeSetQuantumProcess (__inout PKPROCESS Process, __in SCHAR QuantumReset);
 LOGICAL KeSetDisableBoostProcess (__inout PKPROCESS Process, __in LOGICAL Disable);
 LOGICAL KeSetDisableQuantumProcess (__inout PKPROCESS Process, __in LOGICAL Disable);
+NTKERNELAPI BOOLEAN KeSetIdealNodeProcess (__inout PKPROCESS Process, __in ULONG NodeNumber);
 
 #define KeTerminateProcess(Process)     (Process)->StackCount += 1;
 
@@ -1605,6 +1629,7 @@ NTKERNELAPI BOOLEAN KeCancelTimer (__inout PKTIMER);
 NTKERNELAPI BOOLEAN KeReadStateTimer (__in PKTIMER Timer);
 NTKERNELAPI BOOLEAN KeSetTimer (__inout PKTIMER Timer, __in LARGE_INTEGER DueTime, __in_opt PKDPC Dpc);
 NTKERNELAPI BOOLEAN KeSetTimerEx (__inout PKTIMER Timer, __in LARGE_INTEGER DueTime, __in LONG Period, __in_opt PKDPC Dpc);
+NTKERNELAPI BOOLEAN KeSetCoalescableTimer (__inout PKTIMER Timer, __in LARGE_INTEGER DueTime, __in LONG Period, __in ULONG TolerableDelay, __in_opt PKDPC Dpc);
 
 // end_ntddk end_nthal end_ntifs end_wdm end_ntosp
 
@@ -1833,6 +1858,9 @@ VOID KiReleaseDispatcherLockFromSynchLevel (VOID);
 #endif
 
 VOID FASTCALL KiSetPriorityThread (__inout PRKTHREAD Thread, __in KPRIORITY Priority);
+VOID FASTCALL KiInheritPriorityThread (__inout PRKTHREAD Thread, __in KPRIORITY Priority);
+VOID FASTCALL KiInheritPriorityChain (__inout PRKTHREAD Thread, __in KPRIORITY Priority);
+VOID FASTCALL KiRemoveInheritedPriority (__inout PRKTHREAD Thread);
 
 // begin_ntddk begin_wdm begin_nthal begin_ntifs begin_ntndis begin_ntosp
 
@@ -2718,23 +2746,31 @@ NTSTATUS KeSetPhysicalCacheTypeRange (IN PHYSICAL_ADDRESS PhysicalAddress, IN UL
 
 // Routines for zeroing a physical page.
 
-// These are defined as calls through a function pointer which is set to point at the optimal routine for this processor implementation.
+// KeZeroPages uses non-temporal stores where the processor has them and is meant for pages that are not about to be used, such as pages zeroed in the background.
+// KeZeroSinglePage always uses cached stores since its callers, like the fault handlers, touch the page right after it is zeroed.
+
+// On x86 KeZeroPages is a call through a function pointer which is set to point at the optimal routine for this processor implementation.
 #if defined(_X86_)
 typedef VOID (FASTCALL *KE_ZERO_PAGE_ROUTINE)(IN PVOID PageBase, IN SIZE_T NumberOfBytes);
 extern KE_ZERO_PAGE_ROUTINE KeZeroPages;
 extern KE_ZERO_PAGE_ROUTINE KeZeroPagesFromIdleThread;
-#define KeZeroSinglePage(v) KeZeroPages((v), PAGE_SIZE)
+VOID FASTCALL KiZeroPages (IN PVOID PageBase, IN SIZE_T NumberOfBytes);
+#define KeZeroSinglePage(v) KiZeroPages((v), PAGE_SIZE)
 #else
 #define KeZeroPagesFromIdleThread KeZeroPages
 VOID KeZeroPages (IN PVOID PageBase, IN SIZE_T NumberOfBytes);
 VOID KeZeroSinglePage (IN PVOID PageBase);
 #endif
 
-// Routine for copying a page.
+// Routines for copying a page.
+
+// KeCopyPage uses non-temporal stores where the processor has them, KeCopySinglePage always uses cached stores for a page that is about to be used.
 #if defined(_AMD64_)
 VOID KeCopyPage (IN PVOID Destination, IN PVOID Source);
+VOID KeCopySinglePage (IN PVOID Destination, IN PVOID Source);
 #else
 #define KeCopyPage(d,s) RtlCopyMemory((d),(s),PAGE_SIZE)
+#define KeCopySinglePage(d,s) RtlCopyMemory((d),(s),PAGE_SIZE)
 #endif
 
 // Verifier functions
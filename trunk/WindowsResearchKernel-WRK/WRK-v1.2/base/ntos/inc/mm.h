@@ -238,6 +238,31 @@ NTKERNELAPI MM_SYSTEMSIZE MmQuerySystemSize (VOID);
 
 NTKERNELAPI BOOLEAN MmIsThisAnNtAsSystem (VOID);
 
+// Memory pressure changes are notified through the \Callback\MemoryPressure callback object, at PASSIVE_LEVEL from the working set manager.
+// Argument1 is the new MM_MEMORY_PRESSURE level and Argument2 points to an MM_MEMORY_PRESSURE_INFORMATION that is only valid during the callback.
+// Callbacks should release cached memory in proportion to the level and return quickly.
+typedef enum _MM_MEMORY_PRESSURE {
+    MmPressureNone,
+    MmPressureLow,
+    MmPressureMedium,
+    MmPressureHigh
+} MM_MEMORY_PRESSURE;
+
+#define MM_PRESSURE_AVAILABLE_PAGES     0x1     // Few pages are available
+#define MM_PRESSURE_AVAILABLE_FALLING   0x2     // Available pages are falling quickly toward the thresholds
+#define MM_PRESSURE_STANDBY_REPURPOSED  0x4     // Standby pages are being reused before they age
+#define MM_PRESSURE_MODIFIED_BACKLOG    0x8     // The modified page writer is behind
+#define MM_PRESSURE_COMMIT_HEADROOM     0x10    // Commitment is close to the commit limit
+
+typedef struct _MM_MEMORY_PRESSURE_INFORMATION {
+    MM_MEMORY_PRESSURE Level;
+    ULONG Reasons;                  // MM_PRESSURE_xxx for each signal that contributes to the level
+    SIZE_T AvailablePages;
+    SIZE_T StandbyRepurposed;       // Standby pages reused since the previous sample
+    SIZE_T ModifiedPages;
+    SIZE_T CommitHeadroom;          // Pages that can still be committed
+} MM_MEMORY_PRESSURE_INFORMATION, *PMM_MEMORY_PRESSURE_INFORMATION;
+
 // end_ntddk end_nthal end_ntifs end_ntosp
 
 
@@ -521,6 +546,45 @@ NTKERNELAPI BOOLEAN MmIsRecursiveIoFault(VOID);
                 (Thread)->ReadClusterSize = (SavedState) / 2; }
 
 
+// Priorities for the pages a thread reads in.
+// Standby pages of low priority are repurposed before those of default priority, which keeps data that is read only once
+// (read ahead, backup and other scans) from pushing the pages that are used again out of the system file cache.
+// A low priority page gets the default priority once a thread of default priority uses it again.
+#define MM_PAGE_PRIORITY_DEFAULT 0
+#define MM_PAGE_PRIORITY_LOW     1
+
+
+// VOID
+// MmSetPagePriorityThread
+//     IN PETHREAD Thread,
+//     IN ULONG Priority,
+//     OUT PULONG SavedPriority
+//     );
+// Routine Description:
+// This macro sets the priority given to the pages the specified thread reads in.
+// Arguments:
+//     Thread - Supplies a pointer to the current thread.
+//     Priority - Supplies MM_PAGE_PRIORITY_DEFAULT or MM_PAGE_PRIORITY_LOW.
+//     SavedPriority - returns the previous page priority of the thread.
+#define MmSetPagePriorityThread(Thread, Priority, SavedPriority) {         \
+                *(SavedPriority) = (Thread)->PagePriority;                 \
+                (Thread)->PagePriority = (UCHAR)(Priority); }
+
+
+// VOID
+// MmResetPagePriorityThread
+//     IN PETHREAD Thread,
+//     IN ULONG SavedPriority
+//     );
+// Routine Description:
+// This macro restores the page priority saved by MmSetPagePriorityThread.
+// Arguments:
+//     Thread - Supplies a pointer to the current thread.
+//     SavedPriority - supplies the previous page priority of the thread.
+#define MmResetPagePriorityThread(Thread, SavedPriority) {                 \
+                (Thread)->PagePriority = (UCHAR)(SavedPriority); }
+
+
 // The order of this list is important, the zeroed, free and standby must occur before the modified or bad so comparisons can be made when pages are added to a list.
 
 // NOTE: This field is limited to 8 elements.
@@ -624,6 +688,9 @@ NTSTATUS MmAddVerifierEntry (IN PUNICODE_STRING ImageFileName);
 NTSTATUS MmSetVerifierInformation (IN OUT PVOID SystemInformation, IN ULONG SystemInformationLength);
 NTSTATUS MmGetVerifierInformation (OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
 NTSTATUS MmGetPageFileInformation (OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
+NTSTATUS MmGetZeroPageInformation (OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
+NTSTATUS MmGetModifiedWriterInformation (OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
+NTSTATUS MmGetAweMapInformation (OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length);
 HANDLE MmGetSystemPageFile (VOID);
 NTSTATUS MmExtendSection (IN PVOID SectionToExtend, IN OUT PLARGE_INTEGER NewSectionSize, IN ULONG IgnoreFileSizeChecking);
 NTSTATUS MmFlushVirtualMemory (IN PEPROCESS Process, IN OUT PVOID *BaseAddress, IN OUT PSIZE_T RegionSize, OUT PIO_STATUS_BLOCK IoStatus);
@@ -1096,6 +1163,13 @@ NTKERNELAPI NTSTATUS MmPrefetchPages (__in ULONG NumberOfLists, __in_ecount(Numb
 // end_ntifs
 
 NTSTATUS MmPrefetchPagesIntoLockedMdl (IN PFILE_OBJECT FileObject, IN PLARGE_INTEGER FileOffset, IN SIZE_T Length, OUT PMDL *MdlOut);
+
+typedef struct _MM_SECTION_RANGE_ENTRY {
+    LARGE_INTEGER SectionOffset;
+    SIZE_T NumberOfBytes;
+} MM_SECTION_RANGE_ENTRY, *PMM_SECTION_RANGE_ENTRY;
+
+NTKERNELAPI NTSTATUS MmPrefetchSectionRanges (__in PVOID SectionObject, __in ULONG NumberOfEntries, __in_ecount(NumberOfEntries) PMM_SECTION_RANGE_ENTRY Ranges);
 LOGICAL MmPrefetchForCacheManager (IN PFILE_OBJECT FileObject, IN LARGE_INTEGER SectionOffset, IN SIZE_T NumberOfBytes);
 LOGICAL MmIsMemoryAvailable (IN PFN_NUMBER PagesDesired);
 NTSTATUS MmIdentifyPhysicalMemory (VOID);
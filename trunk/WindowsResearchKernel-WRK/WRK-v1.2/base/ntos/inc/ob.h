@@ -252,6 +252,9 @@ typedef struct _OBJECT_DIRECTORY {
     EX_PUSH_LOCK Lock;
     struct _DEVICE_MAP *DeviceMap;
     ULONG SessionId;
+    struct _OBJECT_DIRECTORY_ENTRY **ExtendedHashBuckets;    // Replaces HashBuckets once the directory outgrows it
+    ULONG NumberOfExtendedBuckets;
+    ULONG NumberOfEntries;
 } OBJECT_DIRECTORY, *POBJECT_DIRECTORY;
 // end_ntosp
 
@@ -663,6 +666,8 @@ NTKERNELAPI LONG_PTR FASTCALL ObfDereferenceObject(__in PVOID Object);
 // end_ntddk end_wdm end_nthal end_ntifs end_ntosp
 
 NTKERNELAPI BOOLEAN FASTCALL ObReferenceObjectSafe (IN PVOID Object);
+BOOLEAN ObReferenceObjectByUnlockedEntry (IN PHANDLE_TABLE HandleTable, IN HANDLE Handle, OUT PVOID *Object);
+VOID ObWaitForUnlockedEntryReaders (VOID);
 NTKERNELAPI LONG_PTR FASTCALL ObReferenceObjectEx (IN PVOID Object, IN ULONG Count);
 LONG_PTR FASTCALL ObDereferenceObjectEx (IN PVOID Object, IN ULONG Count);
 NTSTATUS ObWaitForSingleObject(IN HANDLE Handle, IN BOOLEAN Alertable, IN PLARGE_INTEGER Timeout OPTIONAL);
@@ -753,6 +758,7 @@ typedef BOOLEAN (*OB_ENUM_OBJECT_TYPE_ROUTINE)(IN PVOID Object, IN PUNICODE_STRI
 NTSTATUS ObEnumerateObjectsByType(IN POBJECT_TYPE ObjectType, IN OB_ENUM_OBJECT_TYPE_ROUTINE EnumerationRoutine, IN PVOID Parameter);
 NTSTATUS ObGetHandleInformation(OUT PSYSTEM_HANDLE_INFORMATION HandleInformation, IN ULONG Length, OUT PULONG ReturnLength OPTIONAL);
 NTSTATUS ObGetHandleInformationEx (OUT PSYSTEM_HANDLE_INFORMATION_EX HandleInformation, IN ULONG Length, OUT PULONG ReturnLength OPTIONAL);
+ULONG ObGetHandleCount(VOID);
 NTSTATUS ObGetObjectInformation(IN PCHAR UserModeBufferAddress, OUT PSYSTEM_OBJECTTYPE_INFORMATION ObjectInformation, IN ULONG Length, OUT PULONG ReturnLength OPTIONAL);
 
 // begin_ntosp
@@ -782,6 +788,23 @@ NTKERNELAPI PVOID FASTCALL ObFastReferenceObjectLocked (IN PEX_FAST_REF FastRef)
 NTKERNELAPI VOID FASTCALL ObFastDereferenceObject (IN PEX_FAST_REF FastRef, IN PVOID Object);
 NTKERNELAPI PVOID FASTCALL ObFastReplaceObject (IN PEX_FAST_REF FastRef, IN PVOID Object);
 
+// Per processor fast references for objects that every processor references continuously (the system process, shared sections).
+// The holder of a long lived pointer opts in by creating one of these; each processor then references through its own cache line.
+typedef struct DECLSPEC_CACHEALIGN _OB_PROCESSOR_FAST_REF {
+    EX_FAST_REF FastRef;
+} OB_PROCESSOR_FAST_REF, *POB_PROCESSOR_FAST_REF;
+
+typedef struct _OB_PROCESSOR_REFERENCE {
+    PVOID Object;
+    ULONG NumberOfProcessors;
+    OB_PROCESSOR_FAST_REF Processor[1];
+} OB_PROCESSOR_REFERENCE, *POB_PROCESSOR_REFERENCE;
+
+NTKERNELAPI POB_PROCESSOR_REFERENCE ObCreateProcessorReference (IN PVOID Object);
+NTKERNELAPI PVOID FASTCALL ObProcessorReferenceObject (IN POB_PROCESSOR_REFERENCE Reference);
+NTKERNELAPI VOID FASTCALL ObProcessorDereferenceObject (IN POB_PROCESSOR_REFERENCE Reference, IN PVOID Object);
+NTKERNELAPI VOID ObDeleteProcessorReference (IN POB_PROCESSOR_REFERENCE Reference);
+
 #endif // DEVL
 
 #endif // _OB_
\ No newline at end of file
@@ -114,6 +114,16 @@ PerfInfoLogBytesAndUnicodeString(
     PUNICODE_STRING String
     );
 
+VOID
+PerfInfoLogStackTrace(
+    USHORT HookId
+    );
+
+#define PERFINFO_LOG_STACK_TRACE(_HookId)                                                               \
+    if (PERFINFO_IS_GROUP_ON(PERF_BACKTRACE)) {                                                         \
+        PerfInfoLogStackTrace(_HookId);                                                                 \
+    }
+
 
 // Macros for TimeStamps
 
@@ -41,6 +41,7 @@ Abstract:
 #define SESSION_POOL_MASK 32
 #define POOL_VERIFIER_MASK 64
 #define POOL_DRIVER_MASK 128        // Note this cannot encode into a header.
+#define POOL_PROFILE_MASK 512      // Note this cannot encode into a header.
 
 // WARNING: POOL_QUOTA_MASK is overloaded by POOL_QUOTA_FAIL_INSTEAD_OF_RAISE which is exported from ex.h.
 
@@ -178,6 +179,7 @@ typedef struct _POOL_BLOCK {// Define dummy type so computation of pointers is s
 
 VOID ExInitializePoolDescriptor (IN PPOOL_DESCRIPTOR PoolDescriptor, IN POOL_TYPE PoolType, IN ULONG PoolIndex, IN ULONG Threshold, IN PVOID PoolLock);
 VOID ExDrainPoolLookasideList (IN PPAGED_LOOKASIDE_LIST Lookaside);
+VOID ExTrimPoolLookasideList (IN PGENERAL_LOOKASIDE Lookaside, IN USHORT Depth);
 VOID ExDeferredFreePool (IN PPOOL_DESCRIPTOR PoolDesc);
 PVOID ExCreatePoolTagTable (IN ULONG NewProcessorNumber, IN UCHAR NodeNumber);
 VOID ExDeletePoolTagTable (IN ULONG NewProcessorNumber);
@@ -228,4 +230,47 @@ typedef struct _POOL_TRACKER_BIG_PAGES {
     PVOID QuotaObject;
 } POOL_TRACKER_BIG_PAGES, *PPOOL_TRACKER_BIG_PAGES;
 
+// The big page tracking table is divided into shards, each with its own lock and its own power of 2 sized table.
+
+#define POOL_BIG_TABLE_SHARD_SHIFT 4
+#define POOL_BIG_TABLE_SHARDS (1 << POOL_BIG_TABLE_SHARD_SHIFT)
+
+typedef struct DECLSPEC_CACHEALIGN _POOL_BIG_PAGE_SHARD {
+    EX_SPIN_LOCK Lock;
+    LONG EntriesInUse;
+    PPOOL_TRACKER_BIG_PAGES Table;
+    SIZE_T TableSize;               // Must be a power of 2.
+    SIZE_T TableHash;
+} POOL_BIG_PAGE_SHARD, *PPOOL_BIG_PAGE_SHARD;
+
+// Define the pool allocation profiler structures.
+
+// A call site entry is claimed by the first sampled allocation with its stack hash and accumulates the sampled allocations and frees of all allocations
+// made from the same stack. A live entry remembers a sampled allocation until it is freed so the free can be charged back to the call site.
+
+#define POOL_PROFILE_FRAMES 8
+#define POOL_PROFILE_SITES 1024          // Must be a power of 2.
+#define POOL_PROFILE_LIVE_ENTRIES 8192   // Must be a power of 2.
+#define POOL_PROFILE_PROBES 8
+
+typedef struct _POOL_PROFILE_SITE {
+    ULONG Hash;
+    ULONG Tag;
+    LONG Allocations;
+    LONG Frees;
+    LONG_PTR BytesOutstanding;
+    ULONG Depth;
+    PVOID BackTrace[POOL_PROFILE_FRAMES];
+} POOL_PROFILE_SITE, *PPOOL_PROFILE_SITE;
+
+typedef struct _POOL_PROFILE_LIVE {
+    PVOID Va;
+    PPOOL_PROFILE_SITE Site;
+    SIZE_T NumberOfBytes;
+} POOL_PROFILE_LIVE, *PPOOL_PROFILE_LIVE;
+
+typedef struct DECLSPEC_CACHEALIGN _POOL_PROFILE_COUNTER {
+    LONG Countdown;
+} POOL_PROFILE_COUNTER, *PPOOL_PROFILE_COUNTER;
+
 #endif
\ No newline at end of file
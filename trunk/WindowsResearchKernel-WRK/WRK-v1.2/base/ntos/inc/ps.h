@@ -78,6 +78,10 @@ typedef struct _MMADDRESS_NODE {
     struct _MMADDRESS_NODE *RightChild;
     ULONG_PTR StartingVpn;
     ULONG_PTR EndingVpn;
+
+    // The largest free gap that precedes any node of the subtree rooted here, in the units of StartingVpn and EndingVpn.
+    // The gap of a node runs from the end of its predecessor (or from zero for the first node) up to its start.
+    ULONG_PTR LargestGap;
 } MMADDRESS_NODE, *PMMADDRESS_NODE;
 
 // A pair of macros to deal with the packing of parent & balance in the MMADDRESS_NODE.
@@ -257,7 +261,9 @@ typedef struct _EPROCESS {
     PVOID VdmObjects;
     PVOID DeviceMap;
 
-    PVOID Spare0[3];
+    PEX_RUNDOWN_REF_CACHE_AWARE HandleTableRundown;// Per-processor rundown protection for cross process references to ObjectTable.
+    PVOID IoRegistrations;// Per-process table of registered I/O buffers and files, see NtRegisterIoBuffer.
+    PVOID Spare0[1];
     union {
         HARDWARE_PTE PageDirectoryPte;
         ULONGLONG Filler;
@@ -411,6 +417,10 @@ typedef struct _EPROCESS {
 
     MM_AVL_TABLE VadRoot;
 
+    // Advanced whenever a VAD is taken out of VadRoot, so that a VAD pointer captured with the same sequence is still in the tree.
+    // Changed only with both the address space and working set mutexes held.
+    ULONG_PTR VadSequence;
+
     ULONG Cookie;
 } EPROCESS, *PEPROCESS;
 
@@ -572,6 +582,17 @@ typedef struct _ETHREAD {
     BOOLEAN ForwardClusterOnly;
     BOOLEAN DisablePageFaultClustering;
     UCHAR ActiveFaultCount;
+    UCHAR PagePriority;// Priority of the pages read in by this thread, see MmSetPagePriorityThread
+    UCHAR IoPriority;// IO_PRIORITY_HINT + 1 given to the IRPs this thread allocates, zero for the default, see ThreadIoPriority
+
+    // The VAD this thread last located in its own process, valid while the VadSequence of the process is still VadHintSequence.
+    PVOID VadHint;
+    ULONG_PTR VadHintSequence;
+
+    // IRPs completed for this thread that are waiting for IoCompletionBatchApc to finish them, most recent first.
+    // The list is linked through Tail.Overlay.ListEntry.Flink of each IRP and is only ever emptied as a whole, by the APC.
+    PLIST_ENTRY IoCompletionBatch;
+    KAPC IoCompletionBatchApc;
 
 #if defined (PERF_DATA)
     ULONG PerformanceCountLow;
@@ -649,6 +670,12 @@ typedef struct _PS_JOB_TOKEN_FILTER {
     ULONG CapturedPrivilegesLength ;
 } PS_JOB_TOKEN_FILTER, * PPS_JOB_TOKEN_FILTER ;
 
+// Per-processor commit charge a job has accumulated but not yet folded into CurrentJobMemoryUsed.
+// Each block has its own cache line so processors charging the same job don't contend.
+typedef struct DECLSPEC_CACHEALIGN _PS_JOB_CHARGE_BLOCK {
+    SSIZE_T CommitCharge;
+} PS_JOB_CHARGE_BLOCK, *PPS_JOB_CHARGE_BLOCK;
+
 
 // Job Object
 typedef struct _EJOB {
@@ -716,6 +743,11 @@ typedef struct _EJOB {
     SIZE_T PeakJobMemoryUsed;
     SIZE_T CurrentJobMemoryUsed;
 
+    // Per-processor commit charges, one block per processor.
+    // CurrentJobMemoryUsed plus the sum of the blocks is the job's commit.
+    // NULL if the blocks could not be allocated, in which case all charges are made exactly under the memory limits lock.
+    PPS_JOB_CHARGE_BLOCK ChargeBlocks;
+
     KGUARDED_MUTEX MemoryLimitsLock;
 
     // List of jobs in a job set. Processes within a job in a job set can create processes in the same or higher members of the jobset.
@@ -1223,6 +1255,20 @@ NTSTATUS PsEnumProcessThreads (IN PEPROCESS Process, IN THREAD_ENUM_ROUTINE Call
 PEPROCESS PsGetNextProcess (IN PEPROCESS Process);
 PETHREAD PsGetNextProcessThread (IN PEPROCESS Process, IN PETHREAD Thread);
 VOID PsQuitNextProcess (IN PEPROCESS Process);
+
+// Context for PsGetNextProcessBatched, which references several processes per acquisition of the process list lock.
+// The caller zeroes Count before the first call.
+#define PS_PROCESS_ENUM_BATCH 32
+
+typedef struct _PS_PROCESS_ENUM_CONTEXT {
+    ULONG Count;
+    ULONG Next;
+    PEPROCESS Processes[PS_PROCESS_ENUM_BATCH];
+} PS_PROCESS_ENUM_CONTEXT, *PPS_PROCESS_ENUM_CONTEXT;
+
+PEPROCESS PsGetNextProcessBatched (IN PPS_PROCESS_ENUM_CONTEXT Context, IN PEPROCESS Process);
+VOID PsQuitNextProcessBatched (IN PPS_PROCESS_ENUM_CONTEXT Context, IN PEPROCESS Process);
+NTSTATUS PsQueryProcessChanges (OUT PSYSTEM_PROCESS_CHANGE_INFORMATION Information, IN ULONG InformationLength, OUT PULONG ReturnLength);
 VOID PsQuitNextProcessThread (IN PETHREAD Thread);
 PEJOB PsGetNextJob (IN PEJOB Job);
 PEPROCESS PsGetNextJobProcess (IN PEJOB Job, IN PEPROCESS Process);
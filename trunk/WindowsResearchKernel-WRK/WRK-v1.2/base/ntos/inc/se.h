@@ -601,6 +601,19 @@ NTKERNELAPI BOOLEAN SeAccessCheck (
     __out PNTSTATUS AccessStatus
     );
 
+BOOLEAN SeCachedAccessCheck (
+    __in PSECURITY_DESCRIPTOR SecurityDescriptor,
+    __in_opt PLUID DescriptorId,
+    __in PSECURITY_SUBJECT_CONTEXT SubjectSecurityContext,
+    __in ACCESS_MASK DesiredAccess,
+    __in ACCESS_MASK PreviouslyGrantedAccess,
+    __deref_out_opt PPRIVILEGE_SET *Privileges,
+    __in PGENERIC_MAPPING GenericMapping,
+    __in KPROCESSOR_MODE AccessMode,
+    __out PACCESS_MASK GrantedAccess,
+    __out PNTSTATUS AccessStatus
+    );
+
 
 #ifdef SE_NTFS_WORLD_CACHE
 VOID SeGetWorldRights (__in PSECURITY_DESCRIPTOR SecurityDescriptor, __in PGENERIC_MAPPING GenericMapping, __out PACCESS_MASK GrantedAccess);
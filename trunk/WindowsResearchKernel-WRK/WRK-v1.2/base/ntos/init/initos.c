@@ -748,6 +748,11 @@ VOID Phase1InitializationDiscard(IN PVOID Context)
 
     CmpInitSystemVersion(4, DataTableEntry);
 
+    // N.B. The phase 1 initialization of the components below is deliberately sequential, since each component uses the objects, registry keys,
+    //      or system threads created by the components before it.
+    //      Work that does not depend on the rest of initialization is already done off this thread once the other processors are started:
+    //      MmInitSystem(1) starts a zero page worker for each processor, and the machine hives are loaded on one system thread per hive.
+
     // Initialize OB, EX, KE, and KD.
     if (!ObInitSystem()) {
         KeBugCheck(OBJECT1_INITIALIZATION_FAILED);
@@ -41,9 +41,16 @@ Return Value:
     PIO_CSQ_IRP_CONTEXT irpContext;
     PIO_CSQ cfq;
 
+#if CSQLIB
     UNREFERENCED_PARAMETER(DeviceObject);
 
     IoReleaseCancelSpinLock(Irp->CancelIrql);
+#else
+    // The cancel spin lock is only held if the device did not opt into lock free cancel, the queue has its own lock.
+    if (!(DeviceObject->DeviceObjectExtension->StartIoFlags & DOE_CANCEL_LOCK_FREE)) {
+        IoReleaseCancelSpinLock(Irp->CancelIrql);
+    }
+#endif
 
     irpContext = Irp->Tail.Overlay.DriverContext[3];
     if (irpContext->Type == IO_TYPE_CSQ_IRP_CONTEXT) {
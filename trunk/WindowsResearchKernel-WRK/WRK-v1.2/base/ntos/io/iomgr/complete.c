@@ -22,9 +22,11 @@ VOID IopFreeMiniPacket(PIOP_MINI_COMPLETION_PACKET MiniPacket);
 #pragma alloc_text(PAGE, NtOpenIoCompletion)
 #pragma alloc_text(PAGE, NtQueryIoCompletion)
 #pragma alloc_text(PAGE, NtRemoveIoCompletion)
+#pragma alloc_text(PAGE, NtRemoveIoCompletionEx)
 #pragma alloc_text(PAGE, NtSetIoCompletion)
 #pragma alloc_text(PAGE, IoSetIoCompletion)
 #pragma alloc_text(PAGE, IopFreeMiniPacket)
+#pragma alloc_text(PAGE, IopCaptureCompletionEntry)
 #pragma alloc_text(PAGE, IopDeleteIoCompletion)
 
 
@@ -262,14 +264,10 @@ NTSTATUS NtRemoveIoCompletion(__in HANDLE IoCompletionHandle,
     PLARGE_INTEGER CapturedTimeout;
     PLIST_ENTRY Entry;
     PVOID IoCompletion;
-    PIRP Irp;
     KPROCESSOR_MODE PreviousMode;
     NTSTATUS Status;
     LARGE_INTEGER TimeoutValue;
-    PVOID LocalApcContext;
-    PVOID LocalKeyContext;
-    IO_STATUS_BLOCK LocalIoStatusBlock;
-    PIOP_MINI_COMPLETION_PACKET MiniPacket;
+    FILE_IO_COMPLETION_INFORMATION LocalInformation;
 
     // Establish an exception handler, probe the I/O context, the I/O status, and the optional timeout value if specified,
     // reference the I/O completion object, and attempt to remove an entry from the I/O completion object.
@@ -306,25 +304,11 @@ NTSTATUS NtRemoveIoCompletion(__in HANDLE IoCompletionHandle,
                 Status = (NTSTATUS)((LONG_PTR)Entry);
             } else {
                 Status = STATUS_SUCCESS;// Set the completion status, capture the completion information, 
+                IopCaptureCompletionEntry(Entry, &LocalInformation);//deallocate the associated packet, 
                 try {
-                    MiniPacket = CONTAINING_RECORD(Entry, IOP_MINI_COMPLETION_PACKET, ListEntry);
-                    if (MiniPacket->PacketType == IopCompletionPacketIrp) {
-                        Irp = CONTAINING_RECORD(Entry, IRP, Tail.Overlay.ListEntry);
-                        LocalApcContext = Irp->Overlay.AsynchronousParameters.UserApcContext;
-                        LocalKeyContext = (PVOID)Irp->Tail.CompletionKey;
-                        LocalIoStatusBlock = Irp->IoStatus;
-                        IoFreeIrp(Irp);//deallocate the associated IRP, 
-                    } else {
-                        LocalApcContext = MiniPacket->ApcContext;
-                        LocalKeyContext = (PVOID)MiniPacket->KeyContext;
-                        LocalIoStatusBlock.Status = MiniPacket->IoStatus;
-                        LocalIoStatusBlock.Information = MiniPacket->IoStatusInformation;
-                        IopFreeMiniPacket(MiniPacket);
-                    }
-
-                    *ApcContext = LocalApcContext;//and attempt to write the completion information.
-                    *KeyContext = LocalKeyContext;
-                    *IoStatusBlock = LocalIoStatusBlock;
+                    *ApcContext = LocalInformation.ApcContext;//and attempt to write the completion information.
+                    *KeyContext = LocalInformation.KeyContext;
+                    *IoStatusBlock = LocalInformation.IoStatusBlock;
                 } except(ExSystemExceptionFilter())
                 {// If the write of the completion information fails, then do not report an error.
                     NOTHING;// When the caller attempts to access the completion information, an access violation will occur.
@@ -342,6 +326,143 @@ NTSTATUS NtRemoveIoCompletion(__in HANDLE IoCompletionHandle,
 }
 
 
+NTSTATUS NtRemoveIoCompletionEx(__in HANDLE IoCompletionHandle,
+                                __out_ecount(Count) PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+                                __in ULONG Count,
+                                __out PULONG NumEntriesRemoved,
+                                __in_opt PLARGE_INTEGER Timeout
+)
+/*
+Routine Description:
+    This function removes up to the specified number of entries from an I/O completion object.
+    If there are currently no entries available, then the calling thread waits for an entry.
+    All of the available entries that fit in the caller's array are removed with a single wait on the completion queue.
+Arguments:
+    IoCompletionHandle - Supplies a handle to an I/O completion object.
+    IoCompletionInformation - Supplies a pointer to an array that receives the key context, apc context, and I/O status of each removed entry.
+    Count - Supplies the number of elements in the array.
+    NumEntriesRemoved - Supplies a pointer to a variable that receives the number of entries removed.
+    Timeout - Supplies a pointer to an optional time out value.
+Return Value:
+    STATUS_SUCCESS is returned if the function is success. Otherwise, an error status is returned.
+*/
+{
+    PLARGE_INTEGER CapturedTimeout;
+    PLIST_ENTRY* EntryArray;
+    PVOID IoCompletion;
+    ULONG Index;
+    PLIST_ENTRY LocalEntryArray[IOP_REMOVE_COMPLETION_LOCAL_COUNT];
+    FILE_IO_COMPLETION_INFORMATION LocalInformation;
+    ULONG Number;
+    KPROCESSOR_MODE PreviousMode;
+    NTSTATUS Status;
+    LARGE_INTEGER TimeoutValue;
+
+    PAGED_CODE();
+
+    if ((Count == 0) || (Count > (MAXULONG / sizeof(FILE_IO_COMPLETION_INFORMATION)))) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    // Establish an exception handler, probe the output array, the entry count, and the optional timeout value if specified.
+    // If the probe fails, then return the exception code as the service status.
+    try {
+        CapturedTimeout = NULL;
+        PreviousMode = KeGetPreviousMode();
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(IoCompletionInformation, Count * sizeof(FILE_IO_COMPLETION_INFORMATION), sizeof(ULONG_PTR));
+            ProbeForWriteUlong(NumEntriesRemoved);
+            if (ARGUMENT_PRESENT(Timeout)) {
+                CapturedTimeout = &TimeoutValue;
+                TimeoutValue = ProbeAndReadLargeInteger(Timeout);
+            }
+        } else {
+            if (ARGUMENT_PRESENT(Timeout)) {
+                CapturedTimeout = Timeout;
+            }
+        }
+    } except(ExSystemExceptionFilter())
+    {
+        return GetExceptionCode();
+    }
+
+    // Allocate the array that receives the removed queue entries before any entry is removed so that an allocation failure cannot lose completions.
+    EntryArray = &LocalEntryArray[0];
+    if (Count > IOP_REMOVE_COMPLETION_LOCAL_COUNT) {
+        EntryArray = ExAllocatePoolWithTag(PagedPool, Count * sizeof(PLIST_ENTRY), 'rpcI');
+        if (EntryArray == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    // Reference the I/O completion object by handle and attempt to remove entries from the I/O completion object.
+    Status = ObReferenceObjectByHandle(IoCompletionHandle, IO_COMPLETION_MODIFY_STATE, IoCompletionObjectType, PreviousMode, &IoCompletion, NULL);
+    if (NT_SUCCESS(Status)) {
+        Number = KeRemoveQueueEx((PKQUEUE)IoCompletion, PreviousMode, CapturedTimeout, EntryArray, Count);
+
+        // N.B. If the wait did not remove any entries, then the only entry returned is STATUS_USER_APC or STATUS_TIMEOUT.
+        if (((LONG_PTR)EntryArray[0] == STATUS_TIMEOUT) || ((LONG_PTR)EntryArray[0] == STATUS_USER_APC)) {
+            Status = (NTSTATUS)((LONG_PTR)EntryArray[0]);
+            Number = 0;
+        } else {
+            // Capture the completion information of each entry, release the associated packets, and attempt to write the completion information.
+            for (Index = 0; Index < Number; Index += 1) {
+                IopCaptureCompletionEntry(EntryArray[Index], &LocalInformation);
+                try {
+                    IoCompletionInformation[Index] = LocalInformation;
+                } except(ExSystemExceptionFilter())
+                {// If the write of the completion information fails, then do not report an error.
+                    NOTHING;// When the caller attempts to access the completion information, an access violation will occur.
+                }
+            }
+        }
+
+        ObDereferenceObject(IoCompletion);
+        try {
+            *NumEntriesRemoved = Number;
+        } except(ExSystemExceptionFilter())
+        {
+            NOTHING;
+        }
+    }
+
+    if (EntryArray != &LocalEntryArray[0]) {
+        ExFreePool(EntryArray);
+    }
+
+    return Status;
+}
+
+
+VOID IopCaptureCompletionEntry(PLIST_ENTRY Entry, PFILE_IO_COMPLETION_INFORMATION Information)
+/*
+Routine Description:
+    This function captures the completion information of an entry removed from an I/O completion object and frees the IRP or minipacket that carried it.
+Arguments:
+    Entry - Supplies a pointer to the list entry removed from the I/O completion object.
+    Information - Supplies a pointer to a variable that receives the key context, apc context, and I/O status of the entry.
+*/
+{
+    PIRP Irp;
+    PIOP_MINI_COMPLETION_PACKET MiniPacket;
+
+    MiniPacket = CONTAINING_RECORD(Entry, IOP_MINI_COMPLETION_PACKET, ListEntry);
+    if (MiniPacket->PacketType == IopCompletionPacketIrp) {
+        Irp = CONTAINING_RECORD(Entry, IRP, Tail.Overlay.ListEntry);
+        Information->ApcContext = Irp->Overlay.AsynchronousParameters.UserApcContext;
+        Information->KeyContext = (PVOID)Irp->Tail.CompletionKey;
+        Information->IoStatusBlock = Irp->IoStatus;
+        IoFreeIrp(Irp);
+    } else {
+        Information->ApcContext = MiniPacket->ApcContext;
+        Information->KeyContext = (PVOID)MiniPacket->KeyContext;
+        Information->IoStatusBlock.Status = MiniPacket->IoStatus;
+        Information->IoStatusBlock.Information = MiniPacket->IoStatusInformation;
+        IopFreeMiniPacket(MiniPacket);
+    }
+}
+
+
 NTKERNELAPI NTSTATUS IoSetIoCompletion(IN PVOID IoCompletion,
                                        IN PVOID KeyContext, 
                                        IN PVOID ApcContext,
@@ -67,6 +67,7 @@ PVPB IopMountInitializeVpb(IN  PDEVICE_OBJECT  DeviceObject, IN  PDEVICE_OBJECT
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE, IopAbortRequest)
+#pragma alloc_text(PAGE, IopAbortRequestBatch)
 #pragma alloc_text(PAGE, IopAcquireFileObjectLock)
 #pragma alloc_text(PAGE, IopAllocateIrpCleanup)
 #pragma alloc_text(PAGE, IopCallDriverReinitializationRoutines)
@@ -142,6 +143,21 @@ Arguments:
 }
 
 
+VOID IopAbortRequestBatch(IN PKAPC Apc)
+/*
+Routine Description:
+    This routine is invoked to abort the I/O requests of a thread's completion batch.
+    It is invoked during the rundown of a thread.
+Arguments:
+    Apc - Pointer to the completion batch APC of the thread.
+*/
+{
+    PAGED_CODE();
+
+    IopCompleteRequestBatch(Apc, &Apc->NormalRoutine, &Apc->NormalContext, &Apc->SystemArgument1, &Apc->SystemArgument2);
+}
+
+
 NTSTATUS IopAcquireFileObjectLock(IN PFILE_OBJECT FileObject, IN KPROCESSOR_MODE RequestorMode, IN BOOLEAN Alertable, OUT PBOOLEAN Interrupted)
 /*
 Routine Description:
@@ -639,6 +655,10 @@ Arguments:
     fileObject = (PFILE_OBJECT)* SystemArgument1;
     IOVP_COMPLETE_REQUEST(Apc, SystemArgument1, SystemArgument2);
 
+    if (PERFINFO_IS_GROUP_ON(PERF_DRIVERS)) {
+        IopPerfLogCompleteRequestApc(irp);
+    }
+
     // Ensure that the packet is not being completed with a minus one.
     // This is apparently a common problem in some drivers, and has no meaning as a status code.
     ASSERT(irp->IoStatus.Status != 0xffffffff);
@@ -775,7 +795,8 @@ Arguments:
                 if (!(irp->Flags & IRP_SYNCHRONOUS_API)) {
                     ObDereferenceObject(irp->UserEvent);
                 }
-                if (fileObject->Flags & FO_SYNCHRONOUS_IO && !(irp->Flags & IRP_OB_QUERY_NAME)) {
+                // A synchronous API waits on its own event, signaling the file object would wake the thread holding the file object lock.
+                if (fileObject->Flags & FO_SYNCHRONOUS_IO && !(irp->Flags & (IRP_OB_QUERY_NAME | IRP_SYNCHRONOUS_API))) {
                     (VOID)KeSetEvent(&fileObject->Event, 0, FALSE);
                     fileObject->FinalStatus = irp->IoStatus.Status;
                 }
@@ -888,6 +909,63 @@ Arguments:
 }
 
 
+VOID IopCompleteRequestBatch(IN PKAPC Apc,
+                             IN PKNORMAL_ROUTINE* NormalRoutine,
+                             IN PVOID* NormalContext,
+                             IN PVOID* SystemArgument1,
+                             IN PVOID* SystemArgument2
+)
+/*
+Routine Description:
+    This routine executes as a special kernel APC routine in the context of a thread for which one or more I/O requests have been completed.
+    IoCompleteRequest queues the APC only when it adds the first request to the thread's completion batch,
+    so every request completed for the thread before the APC is delivered is finished here by a single APC.
+    The batch is taken exactly once, which guarantees that the APC is never queued again before it has been delivered.
+    The requests are finished in the order in which they were completed.
+Arguments:
+    Apc - Supplies a pointer to the completion batch APC of the thread.
+    NormalRoutine - Unused.
+    NormalContext - Unused.
+    SystemArgument1 - Unused.
+    SystemArgument2 - Unused.
+*/
+{
+    PETHREAD thread;
+    PLIST_ENTRY entry;
+    PLIST_ENTRY nextEntry;
+    PLIST_ENTRY batch;
+    PIRP irp;
+    PFILE_OBJECT fileObject;
+    PVOID auxiliaryBuffer;
+
+    UNREFERENCED_PARAMETER(NormalRoutine);
+    UNREFERENCED_PARAMETER(NormalContext);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    thread = CONTAINING_RECORD(Apc, ETHREAD, IoCompletionBatchApc);
+    entry = (PLIST_ENTRY)InterlockedExchangePointer((PVOID*)&thread->IoCompletionBatch, NULL);
+
+    // The batch is pushed most recent first; reverse it so that the requests are finished in completion order.
+    batch = NULL;
+    while (entry != NULL) {
+        nextEntry = entry->Flink;
+        entry->Flink = batch;
+        batch = entry;
+        entry = nextEntry;
+    }
+
+    while (batch != NULL) {
+        irp = CONTAINING_RECORD(batch, IRP, Tail.Overlay.ListEntry);
+        batch = batch->Flink;
+        fileObject = irp->Tail.Overlay.OriginalFileObject;
+        auxiliaryBuffer = (PVOID)irp->Tail.Overlay.AuxiliaryBuffer;
+        irp->Tail.Overlay.AuxiliaryBuffer = NULL;
+        IopCompleteRequest(&irp->Tail.Apc, NULL, NULL, &fileObject, &auxiliaryBuffer);
+    }
+}
+
+
 VOID IopConnectLinkTrackingPort(IN PVOID Parameter)
 /*
 Routine Description:
@@ -4272,6 +4350,11 @@ Return Value:
 
     PAGED_CODE();
 
+    // A priority set on the handle takes precedence over the one the IRP inherited from the thread.
+    if (FileObject->Flags & FO_IO_PRIORITY_MASK) {
+        Irp->Flags = (Irp->Flags & ~IRP_IO_PRIORITY_MASK) | (IopFileObjectIoPriority(FileObject) << IRP_IO_PRIORITY_SHIFT);
+    }
+
     // Insert the packet at the head of the IRP list for the thread.
     if (!SynchronousIo) {
         IopQueueThreadIrp(Irp);
@@ -4919,8 +5002,13 @@ Return Value:
 
             // If the method is 0 we probe the output buffer for write access.
             // If the method is not 3 we probe the input buffer for read access.
+            // Buffers that extend beyond the user address space are rejected directly rather than by raising an exception from the probe.
             if (method == METHOD_BUFFERED) {
                 if (ARGUMENT_PRESENT(OutputBuffer)) {
+                    if (!ExIsUserAddressRange(OutputBuffer, OutputBufferLength)) {
+                        return STATUS_ACCESS_VIOLATION;
+                    }
+
                     ProbeForWrite(OutputBuffer, OutputBufferLength, sizeof(UCHAR));
                 } else {
                     OutputBufferLength = 0;
@@ -4929,6 +5017,10 @@ Return Value:
 
             if (method != METHOD_NEITHER) {
                 if (ARGUMENT_PRESENT(InputBuffer)) {
+                    if (!ExIsUserAddressRange(InputBuffer, InputBufferLength)) {
+                        return STATUS_ACCESS_VIOLATION;
+                    }
+
                     ProbeForRead(InputBuffer, InputBufferLength, sizeof(UCHAR));
                 } else {
                     InputBufferLength = 0;
@@ -95,10 +95,16 @@ LIST_ENTRY IopFsNotifyChangeQueueHead;
 // The "large" IRP contains 4 stack locations, the maximum in the SDK, and the "small" IRP contains a single entry, the most common case for devices other than disks and network devices.
 GENERAL_LOOKASIDE IopCompletionLookasideList;
 GENERAL_LOOKASIDE IopLargeIrpLookasideList;
+GENERAL_LOOKASIDE IopMediumIrpLookasideList;
 GENERAL_LOOKASIDE IopSmallIrpLookasideList;
 GENERAL_LOOKASIDE IopMdlLookasideList;
 ULONG IopLargeIrpStackLocations;
 
+// The following are the IRP lookaside lists of each node, indexed by node number and lookaside number.
+// They back the per processor IRP lists of the node's processors, and are where an IRP freed on another node is returned.
+// On a single node system they are the system lists above.
+PGENERAL_LOOKASIDE IopNodeIrpLookasideList[MAXIMUM_CCNUMA_NODES][LookasideMaximumList];
+
 
 // The following spinlock is used to control access to the I/O system's error log database.
 // It is initialized by the I/O system initialization code when the system is being initialized.
@@ -113,6 +119,12 @@ ULONG IopLargeIrpStackLocations;
 LIST_ENTRY IopErrorLogListHead;
 
 
+// The following are the list of buffers registered for unbuffered I/O, the spinlock which protects it, and the number of entries on it.
+KSPIN_LOCK IopRegisteredBufferLock;
+LIST_ENTRY IopRegisteredBufferListHead;
+LONG IopRegisteredBufferCount;
+
+
 // The following is used to track how much memory is allocated to I/O error log packets.
 // The spinlock is used to protect this variable.
 
@@ -219,6 +231,29 @@ PKEVENT IopLinkTrackingServiceEvent;
 HANDLE IopLinkTrackingServiceEventHandle;
 
 
+// The following variables account for the time the global cancel spin lock is held, see IOP_CANCEL_LOCK_OWNER.
+// They are only changed while the lock is held.  IopLockFreeCancelCount counts the cancels that did not need the lock.
+IOP_CANCEL_LOCK_OWNER IopCancelLockOwners[IOP_CANCEL_LOCK_OWNERS];
+PVOID IopCancelLockOwner;
+ULONG64 IopCancelLockAcquireTime;
+ULONG IopCancelLockCount;
+ULONG64 IopCancelLockHoldTime;
+ULONG IopLockFreeCancelCount;
+
+// The following array specifies, in milliseconds, how long a request of each I/O priority class may wait in a device queue.
+// IoStartPacket orders requests that are queued without a key by the time they arrive plus this budget,
+// so that more urgent requests go first while a less urgent one is never passed by requests that arrive after its budget has run out.
+// WARNING:  This array depends on the order of the values in the IO_PRIORITY_HINT enumerated type.
+ULONG IopIoPriorityDeadline[MaxIoPriorityTypes] =
+{
+    1000,   // IoPriorityBackground
+    250,    // IoPriorityLow
+    50,     // IoPriorityNormal
+    10,     // IoPriorityHigh
+    0       // IoPriorityCritical
+};
+
+
 // The following array specifies the minimum length of the FileInformation buffer for an NtQueryInformationFile service.
 
 // WARNING:  This array depends on the order of the values in the FileInformationClass enumerated type.
@@ -266,6 +301,7 @@ const UCHAR IopQueryOperationLength[] =
   0,                                         // 38 FileIdFullDiretoryInformation
   0,                                         // 39 FileValidDataLengthInformation
   0,                                         // 40 FileShortNameInformation
+  sizeof(FILE_IO_PRIORITY_HINT_INFORMATION), // 41 FileIoPriorityHintInformation
   0xff                                       //    FileMaximumInformation
 };
 
@@ -317,6 +353,7 @@ const UCHAR IopSetOperationLength[] =
   0,                                            // 38 FileIdFullDiretoryInformation
   sizeof(FILE_VALID_DATA_LENGTH_INFORMATION), // 39 FileValidDataLengthInformation
   sizeof(FILE_NAME_INFORMATION),              // 40 FileShortNameInformation
+  sizeof(FILE_IO_PRIORITY_HINT_INFORMATION),  // 41 FileIoPriorityHintInformation
   0xff                                          //    FileMaximumInformation
 };
 
@@ -368,6 +405,7 @@ const UCHAR IopQuerySetAlignmentRequirement[] =
   sizeof(LONGLONG), // 38 FileIdFullDiretoryInformation
   sizeof(LONGLONG), // 39 FileValidDataLengthInformation
   sizeof(LONG),     // 40 FileShortNameInformation
+  sizeof(LONG),     // 41 FileIoPriorityHintInformation
   0xff                //    FileMaximumInformation
 };
 
@@ -419,6 +457,7 @@ const ULONG IopQueryOperationAccess[] =
    0,                    // 38 FileIdFullDiretoryInformation
    0,                    // 39 FileValidDataLengthInformation
    0,                    // 40 FileShortNameInformation
+   0,                    // 41 FileIoPriorityHintInformation
    0xffffffff            //    FileMaximumInformation
 };
 
@@ -470,6 +509,7 @@ const ULONG IopSetOperationAccess[] =
    0,                     // 38 FileIdFullDiretoryInformation
    FILE_WRITE_DATA,       // 39 FileValidDataLengthInformation
    DELETE,                // 40 FileShortNameInformation
+   0,                     // 41 FileIoPriorityHintInformation
    0xffffffff             //    FileMaximumInformation
 };
 
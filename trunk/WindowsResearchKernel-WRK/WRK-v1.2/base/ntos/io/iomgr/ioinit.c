@@ -104,6 +104,10 @@ Return Value:
     OBJECT_ATTRIBUTES objectAttributes;
     HANDLE handle;
     PGENERAL_LOOKASIDE lookaside;
+    PGENERAL_LOOKASIDE nodeLookaside;
+    ULONG mediumPacketSize;
+    USHORT mediumIrpZoneSize;
+    ULONG Node;
     ULONG lookasideIrpLimit;
     ULONG lookasideSize;
     ULONG Index;
@@ -162,6 +166,7 @@ Return Value:
     case MmSmallSystem:
         completionZoneSize = 6;
         smallIrpZoneSize = 6;
+        mediumIrpZoneSize = 8;
         largeIrpZoneSize = 8;
         mdlZoneSize = 16;
         lookasideIrpLimit = DEFAULT_LOOKASIDE_IRP_LIMIT;
@@ -169,6 +174,7 @@ Return Value:
     case MmMediumSystem:
         completionZoneSize = 24;
         smallIrpZoneSize = 24;
+        mediumIrpZoneSize = 32;
         largeIrpZoneSize = 32;
         mdlZoneSize = 90;
         lookasideIrpLimit = DEFAULT_LOOKASIDE_IRP_LIMIT * 2;
@@ -178,12 +184,14 @@ Return Value:
         if (MmIsThisAnNtAsSystem()) {
             completionZoneSize = 96;
             smallIrpZoneSize = 96;
+            mediumIrpZoneSize = 128;
             largeIrpZoneSize = 128;
             mdlZoneSize = 256;
             lookasideIrpLimit = DEFAULT_LOOKASIDE_IRP_LIMIT * 128; // 64k
         } else {
             completionZoneSize = 32;
             smallIrpZoneSize = 32;
+            mediumIrpZoneSize = 64;
             largeIrpZoneSize = 64;
             mdlZoneSize = 128;
             lookasideIrpLimit = DEFAULT_LOOKASIDE_IRP_LIMIT * 3;
@@ -208,6 +216,35 @@ Return Value:
     smallPacketSize = (ULONG)(sizeof(IRP) + sizeof(IO_STACK_LOCATION));
     ExInitializeSystemLookasideList(&IopSmallIrpLookasideList, NonPagedPool, smallPacketSize, 'sprI', smallIrpZoneSize, &ExSystemLookasideListHead);
 
+    // Initialize the system medium IRP lookaside list.
+    mediumPacketSize = (ULONG)(sizeof(IRP) + (IOP_MEDIUM_IRP_STACK_LOCATIONS * sizeof(IO_STACK_LOCATION)));
+    ExInitializeSystemLookasideList(&IopMediumIrpLookasideList, NonPagedPool, mediumPacketSize, 'mprI', mediumIrpZoneSize, &ExSystemLookasideListHead);
+
+    // Initialize the node IRP lookaside lists.
+    // On a multinode system each node gets its own lists, so that an IRP freed on one node is not reused from another.
+    nodeLookaside = NULL;
+    if (KeNumberNodes > 1) {
+        nodeLookaside = ExAllocatePoolWithTag(NonPagedPool, 3 * KeNumberNodes * sizeof(GENERAL_LOOKASIDE), 'oI');
+    }
+
+    for (Node = 0; Node < MAXIMUM_CCNUMA_NODES; Node += 1) {
+        if ((nodeLookaside != NULL) && (Node < KeNumberNodes)) {
+            ExInitializeSystemLookasideList(nodeLookaside, NonPagedPool, smallPacketSize, 'sprI', smallIrpZoneSize, &ExSystemLookasideListHead);
+            IopNodeIrpLookasideList[Node][LookasideSmallIrpList] = nodeLookaside;
+            nodeLookaside += 1;
+            ExInitializeSystemLookasideList(nodeLookaside, NonPagedPool, mediumPacketSize, 'mprI', mediumIrpZoneSize, &ExSystemLookasideListHead);
+            IopNodeIrpLookasideList[Node][LookasideMediumIrpList] = nodeLookaside;
+            nodeLookaside += 1;
+            ExInitializeSystemLookasideList(nodeLookaside, NonPagedPool, largePacketSize, 'lprI', largeIrpZoneSize, &ExSystemLookasideListHead);
+            IopNodeIrpLookasideList[Node][LookasideLargeIrpList] = nodeLookaside;
+            nodeLookaside += 1;
+        } else {
+            IopNodeIrpLookasideList[Node][LookasideSmallIrpList] = &IopSmallIrpLookasideList;
+            IopNodeIrpLookasideList[Node][LookasideMediumIrpList] = &IopMediumIrpLookasideList;
+            IopNodeIrpLookasideList[Node][LookasideLargeIrpList] = &IopLargeIrpLookasideList;
+        }
+    }
+
     // Initialize the system MDL lookaside list.
     mdlPacketSize = (ULONG)(sizeof(MDL) + (IOP_FIXED_SIZE_MDL_PFNS * sizeof(PFN_NUMBER)));
     ExInitializeSystemLookasideList(&IopMdlLookasideList, NonPagedPool, mdlPacketSize, ' ldM', mdlZoneSize, &ExSystemLookasideListHead);
@@ -217,7 +254,7 @@ Return Value:
     // Initialize the per processor nonpaged lookaside lists and descriptors.
 
     // N.B. All the I/O related lookaside list structures are allocated at one time to make sure they are aligned, if possible, and to avoid pool overhead.
-    lookasideSize = 4 * KeNumberProcessors * sizeof(GENERAL_LOOKASIDE);
+    lookasideSize = 5 * KeNumberProcessors * sizeof(GENERAL_LOOKASIDE);
     lookaside = ExAllocatePoolWithTag(NonPagedPool, lookasideSize, 'oI');
     for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
         prcb = KiProcessorBlock[Index];
@@ -234,23 +271,35 @@ Return Value:
         }
 
         // Initialize the large IRP per processor lookaside pointers.
-        prcb->PPLookasideList[LookasideLargeIrpList].L = &IopLargeIrpLookasideList;
+        // The IRP lists are backed by the lists of the processor's node.
+        Node = prcb->ParentNode->NodeNumber;
+        prcb->PPLookasideList[LookasideLargeIrpList].L = IopNodeIrpLookasideList[Node][LookasideLargeIrpList];
         if (lookaside != NULL) {
             ExInitializeSystemLookasideList(lookaside, NonPagedPool, largePacketSize, 'LprI', largeIrpZoneSize, &ExSystemLookasideListHead);
             prcb->PPLookasideList[LookasideLargeIrpList].P = lookaside;
             lookaside += 1;
         } else {
-            prcb->PPLookasideList[LookasideLargeIrpList].P = &IopLargeIrpLookasideList;
+            prcb->PPLookasideList[LookasideLargeIrpList].P = IopNodeIrpLookasideList[Node][LookasideLargeIrpList];
+        }
+
+        // Initialize the medium IRP per processor lookaside pointers.
+        prcb->PPLookasideList[LookasideMediumIrpList].L = IopNodeIrpLookasideList[Node][LookasideMediumIrpList];
+        if (lookaside != NULL) {
+            ExInitializeSystemLookasideList(lookaside, NonPagedPool, mediumPacketSize, 'MprI', mediumIrpZoneSize, &ExSystemLookasideListHead);
+            prcb->PPLookasideList[LookasideMediumIrpList].P = lookaside;
+            lookaside += 1;
+        } else {
+            prcb->PPLookasideList[LookasideMediumIrpList].P = IopNodeIrpLookasideList[Node][LookasideMediumIrpList];
         }
 
         // Initialize the small IRP per processor lookaside pointers.
-        prcb->PPLookasideList[LookasideSmallIrpList].L = &IopSmallIrpLookasideList;
+        prcb->PPLookasideList[LookasideSmallIrpList].L = IopNodeIrpLookasideList[Node][LookasideSmallIrpList];
         if (lookaside != NULL) {
             ExInitializeSystemLookasideList(lookaside, NonPagedPool, smallPacketSize, 'SprI', smallIrpZoneSize, &ExSystemLookasideListHead);
             prcb->PPLookasideList[LookasideSmallIrpList].P = lookaside;
             lookaside += 1;
         } else {
-            prcb->PPLookasideList[LookasideSmallIrpList].P = &IopSmallIrpLookasideList;
+            prcb->PPLookasideList[LookasideSmallIrpList].P = IopNodeIrpLookasideList[Node][LookasideSmallIrpList];
         }
 
         // Initialize the MDL per processor lookaside list pointers.
@@ -267,6 +316,8 @@ Return Value:
     // Initialize the error log spin locks and log list.
     KeInitializeSpinLock(&IopErrorLogLock);
     InitializeListHead(&IopErrorLogListHead);
+    KeInitializeSpinLock(&IopRegisteredBufferLock);
+    InitializeListHead(&IopRegisteredBufferListHead);
 
     if (IopInitializeReserveIrp(&IopReserveIrpAllocator) == FALSE) {
         IopInitFailCode = 1;
@@ -135,6 +135,46 @@ extern KSPIN_LOCK IopErrorLogAllocationLock;
 extern const GENERIC_MAPPING IopFileMapping;
 
 
+// Define the buffers registered for unbuffered I/O with NtRegisterIoBuffer.
+// The list is protected by IopRegisteredBufferLock, and the count lets the read and write paths skip the lookup when it is empty.
+#define IOP_MAXIMUM_REGISTERED_BUFFERS 64
+#define IOP_MAXIMUM_REGISTERED_FILES 64
+#define IOP_NO_REGISTERED_BUFFER ((ULONG)-1)
+
+typedef struct _IOP_REGISTERED_BUFFER {
+    LIST_ENTRY Links;
+    PEPROCESS Process;
+    PCHAR Base;
+    ULONG Length;
+    ULONG ActiveCount;                  // Number of outstanding IRPs using a partial MDL of this buffer
+    BOOLEAN Deleted;                    // The process has exited; free the buffer when ActiveCount drops to zero
+    HANDLE SecureHandle;
+    PMDL Mdl;
+} IOP_REGISTERED_BUFFER, *PIOP_REGISTERED_BUFFER;
+
+// Define the per-process table of the indexes returned by NtRegisterIoBuffer and NtRegisterIoHandle, pointed to by EPROCESS.IoRegistrations.
+typedef struct _IOP_REGISTERED_FILE {
+    PFILE_OBJECT FileObject;
+    ACCESS_MASK GrantedAccess;
+} IOP_REGISTERED_FILE, *PIOP_REGISTERED_FILE;
+
+typedef struct _IOP_IO_REGISTRATION {
+    IOP_REGISTERED_FILE Files[IOP_MAXIMUM_REGISTERED_FILES];
+    PIOP_REGISTERED_BUFFER Buffers[IOP_MAXIMUM_REGISTERED_BUFFERS];
+} IOP_IO_REGISTRATION, *PIOP_IO_REGISTRATION;
+
+extern KSPIN_LOCK IopRegisteredBufferLock;
+extern LIST_ENTRY IopRegisteredBufferListHead;
+extern LONG IopRegisteredBufferCount;
+
+#define IopIsRegisteredBufferCandidate(FileObject, RequestorMode) \
+    (((FileObject)->Flags & FO_NO_INTERMEDIATE_BUFFERING) && ((RequestorMode) != KernelMode) && (IopRegisteredBufferCount != 0))
+
+
+// Define the number of entries NtRemoveIoCompletionEx and NtEnterIoRing can remove from an I/O completion object without allocating an entry array from pool.
+#define IOP_REMOVE_COMPLETION_LOCAL_COUNT 16
+
+
 // Define a dummy file object for use on stack for fast open operations.
 typedef struct _DUMMY_FILE_OBJECT {
     OBJECT_HEADER ObjectHeader;
@@ -340,6 +380,70 @@ typedef struct  _IOP_IRP_STACK_PROFILER {
 #define DEFAULT_LARGE_IRP_LOCATIONS     8
 #define BASE_STACK_COUNT                DEFAULT_LARGE_IRP_LOCATIONS
 
+// Define the number of I/O stack locations a medium IRP has.
+// IRPs needing one stack location come from the small lists, up to this many from the medium lists, and up to IopLargeIrpStackLocations from the large lists.
+#define IOP_MEDIUM_IRP_STACK_LOCATIONS  4
+
+#define IopIrpLookasideNumber(StackSize)                                   \
+    (((StackSize) == 1) ? LookasideSmallIrpList :                          \
+     (((StackSize) <= IOP_MEDIUM_IRP_STACK_LOCATIONS) ? LookasideMediumIrpList : LookasideLargeIrpList))
+
+// The node of the processor which allocated a fixed size IRP is kept in the high bits of its allocation flags,
+// so that the IRP can be returned to that node's lookaside lists when it is freed on another node.
+#define IOP_IRP_NODE_SHIFT              4
+
+#define IopIrpNodeFlags(Prcb)   ((UCHAR)((Prcb)->ParentNode->NodeNumber << IOP_IRP_NODE_SHIFT))
+#define IopIrpNode(Irp)         ((ULONG)((Irp)->AllocationFlags >> IOP_IRP_NODE_SHIFT))
+
+// A device queue in fair share mode orders the requests queued through IoStartPacket by stochastic start time fair queuing.
+// Requesting processes are hashed to one of IOP_FAIR_SHARE_BUCKETS buckets,
+// and each request is charged IOP_FAIR_SHARE_QUANTUM divided by the weight of its I/O priority class against the finish tag of its bucket.
+// A process that queues more than DepthLimit requests pays once more for each request beyond the limit.
+// The limit is halved each interval in which the queue latency never dropped below the target, and otherwise grows by one up to the maximum.
+#define IOP_FAIR_SHARE_BUCKETS          16
+#define IOP_FAIR_SHARE_QUANTUM          16
+#define IOP_FAIR_SHARE_MAX_DEPTH        32
+#define IOP_FAIR_SHARE_INTERVAL         (100 * 10000)   // 100ms in interrupt time units
+#define IOP_FAIR_SHARE_DEFAULT_LATENCY  20              // milliseconds
+
+#define IopFairShareBucket(Process)     \
+    ((ULONG)((((ULONG_PTR)(Process)) >> 6) ^ (((ULONG_PTR)(Process)) >> 12)) & (IOP_FAIR_SHARE_BUCKETS - 1))
+
+typedef struct _IOP_FAIR_SHARE_BUCKET {
+    ULONG FinishTag;    // Virtual time at which the last request queued for this bucket is done.
+    LONG Queued;        // Requests of this bucket in the device queue.
+} IOP_FAIR_SHARE_BUCKET, *PIOP_FAIR_SHARE_BUCKET;
+
+typedef struct _IOP_FAIR_SHARE_QUEUE {
+    KSPIN_LOCK Lock;
+    ULONG VirtualTime;      // Start tag of the request started last.
+    ULONG TargetLatency;    // Queue latency to aim for, in interrupt time units.
+    ULONG DepthLimit;       // Requests each bucket may queue before it is charged extra.
+    LONG Queued;            // Requests in the device queue.
+    ULONG ServiceTime;      // Moving average of the time the device takes per request, in interrupt time units.
+    ULONG LastStartTime;    // Low part of the interrupt time at which the last request was started.
+    ULONG IntervalStart;    // Low part of the interrupt time at which the current interval began.
+    ULONG MinimumLatency;   // Smallest queue latency estimated during the current interval.
+    BOOLEAN Idle;           // The device queue ran empty, so the next start does not measure the service time.
+    IOP_FAIR_SHARE_BUCKET Bucket[IOP_FAIR_SHARE_BUCKETS];
+} IOP_FAIR_SHARE_QUEUE, *PIOP_FAIR_SHARE_QUEUE;
+
+// The time the global cancel spin lock is held is accounted to the code that acquired it, so it can be told which drivers still depend on it.
+// The owner is the return address of the IoAcquireCancelSpinLock call, or the cancel routine when the lock is held for IoCancelIrp.
+// The table is hashed on the owner and updated while the lock is held; owners that find no free slot are only counted in the totals.
+#define IOP_CANCEL_LOCK_OWNERS          64
+#define IOP_CANCEL_LOCK_PROBES          4
+
+#define IopCancelLockOwnerSlot(Owner)   \
+    ((ULONG)((((ULONG_PTR)(Owner)) >> 4) ^ (((ULONG_PTR)(Owner)) >> 12)) & (IOP_CANCEL_LOCK_OWNERS - 1))
+
+typedef struct _IOP_CANCEL_LOCK_OWNER {
+    PVOID Owner;
+    ULONG Count;            // Times the owner acquired the lock.
+    ULONG64 HoldTime;       // Total cycles the owner held the lock.
+    ULONG64 MaximumHoldTime;
+} IOP_CANCEL_LOCK_OWNER, *PIOP_CANCEL_LOCK_OWNER;
+
 // Defines for IopIrpAllocatorFlags.
 #define IOP_ENABLE_AUTO_SIZING              0x1
 #define IOP_PROFILE_STACK_COUNT             0x2
@@ -374,7 +478,9 @@ extern POBJECT_TYPE IoControllerObjectType;
 extern POBJECT_TYPE IoDeviceHandlerObjectType;
 
 extern GENERAL_LOOKASIDE IopLargeIrpLookasideList;
+extern GENERAL_LOOKASIDE IopMediumIrpLookasideList;
 extern GENERAL_LOOKASIDE IopSmallIrpLookasideList;
+extern PGENERAL_LOOKASIDE IopNodeIrpLookasideList[MAXIMUM_CCNUMA_NODES][LookasideMaximumList];
 extern GENERAL_LOOKASIDE IopMdlLookasideList;
 extern GENERAL_LOOKASIDE IopCompletionLookasideList;
 
@@ -389,6 +495,15 @@ extern const ULONG IopQueryFsOperationAccess[];
 extern const ULONG IopSetFsOperationAccess[];
 extern const UCHAR IopQuerySetFsAlignmentRequirement[];
 
+extern ULONG IopIoPriorityDeadline[];
+extern IOP_CANCEL_LOCK_OWNER IopCancelLockOwners[];
+extern PVOID IopCancelLockOwner;
+extern ULONG64 IopCancelLockAcquireTime;
+extern ULONG IopCancelLockCount;
+extern ULONG64 IopCancelLockHoldTime;
+extern ULONG IopLockFreeCancelCount;
+extern const KPRIORITY IopCacheHitIncrement;
+
 extern UNICODE_STRING IoArcHalDeviceName;
 extern PUCHAR IoLoaderArcBootDeviceName;
 
@@ -421,6 +536,15 @@ extern IOP_IRP_STACK_PROFILER  IopIrpStackProfiler;
 extern POBJECT_TYPE ExEventObjectType;
 
 
+// A read or write on a positional only handle at an explicit offset, with neither an event nor an APC, does not take the file object lock.
+// It waits on a private event instead of the file object event so that it does not disturb a thread that holds the lock.
+// The file position is still updated by the file system, so it is not reliable while such requests run concurrently.
+#define IopIsPositionalIo(FileObject, ByteOffset, FileOffset, Event, ApcRoutine)  \
+    (((FileObject)->Flags & FO_POSITIONAL_IO) &&                                    \
+     ARGUMENT_PRESENT(ByteOffset) && ((FileOffset).HighPart >= 0) &&                \
+     !ARGUMENT_PRESENT(Event) && !ARGUMENT_PRESENT(ApcRoutine))
+
+
 // Define routines private to the I/O system.
 
 VOID IopAbortRequest(IN PKAPC Apc);
@@ -522,6 +646,12 @@ VOID IopCompleteRequest(IN PKAPC Apc,
                         IN PVOID* NormalContext,
                         IN PVOID* SystemArgument1,
                         IN PVOID* SystemArgument2);
+VOID IopCompleteRequestBatch(IN PKAPC Apc,
+                             IN PKNORMAL_ROUTINE* NormalRoutine,
+                             IN PVOID* NormalContext,
+                             IN PVOID* SystemArgument1,
+                             IN PVOID* SystemArgument2);
+VOID IopAbortRequestBatch(IN PKAPC Apc);
 BOOLEAN IopConfigureCrashDump(IN HANDLE HandlePagingFile);
 VOID IopConnectLinkTrackingPort(IN PVOID Parameter);
 NTSTATUS IopCreateVpb(IN PDEVICE_OBJECT DeviceObject);
@@ -551,6 +681,10 @@ VOID IopDeleteIoCompletion(IN PVOID    Object);
 
 
 #ifdef  _WIN64
+// Return the I/O priority set on a file object, as stored in the IRP_IO_PRIORITY_MASK bits of an IRP, or zero if none was set.
+#define IopFileObjectIoPriority(FileObject) \
+    (((FileObject)->Flags & FO_IO_PRIORITY_MASK) >> FO_IO_PRIORITY_SHIFT)
+
 #define IopApcRoutinePresent(ApcRoutine)    ARGUMENT_PRESENT((ULONG_PTR)(ApcRoutine) & ~1)
 #define IopIsIosb32(ApcRoutine)                ((ULONG_PTR)(ApcRoutine) & 1)
 #define IopMarkApcRoutineIfAsyncronousIo32(Iosb,ApcRoutine,synchronousIo)   \
@@ -578,6 +712,8 @@ VOID IopExceptionCleanup(IN PFILE_OBJECT FileObject,
                          IN PKEVENT EventObject OPTIONAL,
                          IN PKEVENT KernelEvent OPTIONAL);
 VOID IopErrorLogThread(IN PVOID StartContext);
+ULONG IopFairShareQueuePacket(IN PIOP_FAIR_SHARE_QUEUE FairShareQueue, IN PIRP Irp);
+VOID IopFairShareStartPacket(IN PIOP_FAIR_SHARE_QUEUE FairShareQueue, IN PIRP Irp OPTIONAL);
 VOID IopFreeIrpAndMdls(IN PIRP Irp);
 PDEVICE_OBJECT IopGetDeviceAttachmentBase(IN PDEVICE_OBJECT DeviceObject);
 NTSTATUS IopGetFileInformation(IN PFILE_OBJECT FileObject,
@@ -952,6 +1088,15 @@ Return Value:
 
 
 VOID FASTCALL IopfCompleteRequest(IN PIRP Irp, IN  CCHAR   PriorityBost);
+NTSTATUS IoPerfInit(VOID);
+NTSTATUS IoPerfReset(VOID);
+NTSTATUS FASTCALL IoPerfCallDriver(IN PDEVICE_OBJECT DeviceObject, IN OUT PIRP Irp, IN PVOID ReturnAddress);
+VOID FASTCALL IoPerfCompleteRequest(IN PIRP Irp, IN CCHAR PriorityBoost);
+NTSTATUS IopPerfCallCompletionRoutine(IN PIO_COMPLETION_ROUTINE CompletionRoutine,
+                                      IN PDEVICE_OBJECT DeviceObject,
+                                      IN PIRP Irp,
+                                      IN PVOID Context);
+VOID IopPerfLogCompleteRequestApc(IN PIRP Irp);
 PIRP IopAllocateIrpPrivate(IN  CCHAR   StackSize, IN  BOOLEAN ChargeQuota);
 VOID IopFreeIrp(IN  PIRP    Irp);
 PVOID IopAllocateErrorLogEntry(IN PDEVICE_OBJECT deviceObject, IN PDRIVER_OBJECT driverObject, IN UCHAR EntrySize);
@@ -1009,4 +1154,39 @@ NTSTATUS IopCreateSecurityDescriptorPerType(IN PSECURITY_DESCRIPTOR  Descriptor,
                                             OUT PSECURITY_INFORMATION SecurityInformation OPTIONAL);
 BOOLEAN IopReferenceVerifyVpb(IN  PDEVICE_OBJECT  DeviceObject, OUT PVPB* Vpb, OUT PDEVICE_OBJECT* FsDeviceObject);
 VOID IopDereferenceVpbAndFree(IN PVPB Vpb);
+PMDL IopAllocateRegisteredBufferMdl(IN PVOID Buffer, IN ULONG Length, IN ULONG BufferIndex, IN PIRP Irp);
+PVOID IopGetRegisteredBufferAddress(IN ULONG BufferIndex, IN ULONG BufferOffset, IN ULONG Length);
+NTSTATUS IopReferenceRegisteredFile(IN ULONG FileIndex, IN BOOLEAN ForWrite, OUT PFILE_OBJECT* FileObject, OUT PACCESS_MASK GrantedAccess OPTIONAL);
+PIOP_IO_REGISTRATION IopGetIoRegistration(IN PEPROCESS Process);
+NTSTATUS IopSubmitIoRingEntry(IN PIO_RING_SUBMISSION_ENTRY Entry, IN PIO_RING_SUBMISSION_ENTRY UserEntry);
+VOID IopCaptureCompletionEntry(PLIST_ENTRY Entry, PFILE_IO_COMPLETION_INFORMATION Information);
+NTSTATUS IopReadFile(IN PFILE_OBJECT FileObject,
+                     IN ULONG BufferIndex,
+                     IN HANDLE Event OPTIONAL,
+                     IN PIO_APC_ROUTINE ApcRoutine OPTIONAL,
+                     IN PVOID ApcContext OPTIONAL,
+                     OUT PIO_STATUS_BLOCK IoStatusBlock,
+                     OUT PVOID Buffer,
+                     IN ULONG Length,
+                     IN PLARGE_INTEGER ByteOffset OPTIONAL,
+                     IN PULONG Key OPTIONAL);
+NTSTATUS IopWriteFile(IN PFILE_OBJECT FileObject,
+                      IN ACCESS_MASK GrantedAccess,
+                      IN ULONG BufferIndex,
+                      IN HANDLE Event OPTIONAL,
+                      IN PIO_APC_ROUTINE ApcRoutine OPTIONAL,
+                      IN PVOID ApcContext OPTIONAL,
+                      OUT PIO_STATUS_BLOCK IoStatusBlock,
+                      IN PVOID Buffer,
+                      IN ULONG Length,
+                      IN PLARGE_INTEGER ByteOffset OPTIONAL,
+                      IN PULONG Key OPTIONAL);
+VOID IopReleaseRegisteredBufferMdl(IN PMDL Mdl);
+NTSTATUS IopReadWriteFileVector(IN HANDLE FileHandle,
+                                OUT PIO_STATUS_BLOCK IoStatusBlock,
+                                IN PFILE_IO_SEGMENT SegmentArray,
+                                IN ULONG NumberOfSegments,
+                                IN PLARGE_INTEGER ByteOffset OPTIONAL,
+                                IN PULONG Key OPTIONAL,
+                                IN BOOLEAN Write);
 #endif // _IOMGR_
@@ -0,0 +1,299 @@
+/*
+Copyright (c) Microsoft Corporation. All rights reserved.
+
+You may only use this code if you agree to the terms of the Windows Research Kernel Source Code License agreement (see License.txt).
+If you do not agree to the terms, do not use the code.
+
+Module Name:
+    ioperf.c
+
+Abstract:
+    This module contains the driver hooks used by the kernel logger when the PERF_DRIVERS group is enabled.
+
+    While the group is on, IofCallDriver and IofCompleteRequest are routed through IoPerfCallDriver and IoPerfCompleteRequest,
+    which log the dispatch of the request to each driver in the stack, the completion of the request by a driver, each completion
+    routine run on the way back up, and the special kernel APC that finishes the request in the requesting thread.
+    Every event carries the logger's timestamp, so the time spent in each layer can be read from the trace; the context switch
+    events of the same trace then show when the requesting thread resumed.
+
+    The hooks also keep a latency histogram for the device each request was first sent to.  The time of the first dispatch is
+    remembered in a small table hashed on the IRP, and the time from there to the completion of the request by a driver is
+    counted in the histogram of that device.  When a slot of the table is in use the request is simply not counted, so the
+    histograms are a sample when the system has more requests outstanding than the table holds.  The histograms are logged
+    when the group is turned off.
+*/
+
+#include "iomgr.h"
+
+#pragma alloc_text(PAGE, IoPerfInit)
+#pragma alloc_text(PAGE, IoPerfReset)
+
+// Define the number of outstanding requests whose dispatch time is remembered, and the number of devices which have a histogram.
+#define IOP_PERF_TRACKED_IRPS       256
+#define IOP_PERF_LATENCY_DEVICES    32
+
+#define IopPerfIrpSlot(Irp)     ((((ULONG_PTR)(Irp)) >> 4) & (IOP_PERF_TRACKED_IRPS - 1))
+
+typedef struct _IOP_PERF_TRACKED_IRP {
+    PIRP Irp;
+    PDEVICE_OBJECT DeviceObject;
+    LONGLONG DispatchTime;
+} IOP_PERF_TRACKED_IRP, *PIOP_PERF_TRACKED_IRP;
+
+IOP_PERF_TRACKED_IRP IopPerfTrackedIrps[IOP_PERF_TRACKED_IRPS];
+PERFINFO_DRIVER_LATENCY_HISTOGRAM IopPerfLatencyHistograms[IOP_PERF_LATENCY_DEVICES];
+LONGLONG IopPerfCounterFrequency;
+LONG IopPerfUniqMatchId;
+
+
+NTSTATUS IoPerfInit(VOID)
+/*
+Routine Description:
+    This routine is called by PerfInfoStartLog when the kernel logger is started with the PERF_DRIVERS group.
+    It clears the latency histograms and routes IofCallDriver and IofCompleteRequest through the logging hooks.
+Return Value:
+    STATUS_SUCCESS.
+*/
+{
+    LARGE_INTEGER frequency;
+
+    PAGED_CODE();
+
+    RtlZeroMemory(IopPerfTrackedIrps, sizeof(IopPerfTrackedIrps));
+    RtlZeroMemory(IopPerfLatencyHistograms, sizeof(IopPerfLatencyHistograms));
+    KeQueryPerformanceCounter(&frequency);
+    IopPerfCounterFrequency = frequency.QuadPart;
+
+    InterlockedExchangePointer((PVOID*)&pIofCompleteRequest, (PVOID)IoPerfCompleteRequest);
+    InterlockedExchangePointer((PVOID*)&pIofCallDriver, (PVOID)IoPerfCallDriver);
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS IoPerfReset(VOID)
+/*
+Routine Description:
+    This routine is called by PerfInfoStopLog, while the PERF_DRIVERS group is still on, and when starting the logger fails.
+    It restores the normal IofCallDriver and IofCompleteRequest paths and logs the latency histogram of each device.
+Return Value:
+    STATUS_SUCCESS.
+*/
+{
+    ULONG i;
+
+    PAGED_CODE();
+
+    InterlockedExchangePointer((PVOID*)&pIofCallDriver, NULL);
+    InterlockedExchangePointer((PVOID*)&pIofCompleteRequest, (PVOID)IopfCompleteRequest);
+
+    if (PERFINFO_IS_GROUP_ON(PERF_DRIVERS)) {
+        for (i = 0; i < IOP_PERF_LATENCY_DEVICES; i++) {
+            if (IopPerfLatencyHistograms[i].DeviceObject != NULL) {
+                PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_LATENCY_HISTOGRAM,
+                                 &IopPerfLatencyHistograms[i],
+                                 sizeof(PERFINFO_DRIVER_LATENCY_HISTOGRAM));
+            }
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+VOID IopPerfCountLatency(IN PIRP Irp)
+/*
+Routine Description:
+    This routine counts the time from the first dispatch of the specified request to its completion in the histogram of the device it was sent to.
+    Nothing is counted if the dispatch time of the request was not remembered.
+Arguments:
+    Irp - Pointer to the request being completed.
+*/
+{
+    PIOP_PERF_TRACKED_IRP trackedIrp;
+    PPERFINFO_DRIVER_LATENCY_HISTOGRAM histogram;
+    PDEVICE_OBJECT deviceObject;
+    LONGLONG dispatchTime;
+    LONGLONG microseconds;
+    ULONG bucket;
+    ULONG i;
+
+    trackedIrp = &IopPerfTrackedIrps[IopPerfIrpSlot(Irp)];
+    if (trackedIrp->Irp != Irp) {
+        return;
+    }
+
+    // Release the slot.  A request completed before IoPerfCallDriver finished filling it in is not counted.
+    dispatchTime = trackedIrp->DispatchTime;
+    deviceObject = trackedIrp->DeviceObject;
+    trackedIrp->DispatchTime = 0;
+    trackedIrp->DeviceObject = NULL;
+    InterlockedExchangePointer((PVOID*)&trackedIrp->Irp, NULL);
+    if (dispatchTime == 0 || deviceObject == NULL || IopPerfCounterFrequency == 0) {
+        return;
+    }
+
+    microseconds = ((KeQueryPerformanceCounter(NULL).QuadPart - dispatchTime) * 1000000) / IopPerfCounterFrequency;
+
+    // Bucket n counts latencies of 2^n up to 2^(n+1) microseconds; the first and last buckets also take everything below and above.
+    for (bucket = 0; bucket < PERFINFO_DRIVER_LATENCY_BUCKETS - 1 && microseconds >= 2; bucket++) {
+        microseconds >>= 1;
+    }
+
+    // Find the histogram of the device, claiming a free one the first time the device is seen.
+    for (i = 0; i < IOP_PERF_LATENCY_DEVICES; i++) {
+        histogram = &IopPerfLatencyHistograms[i];
+        if (histogram->DeviceObject == NULL) {
+            InterlockedCompareExchangePointer(&histogram->DeviceObject, deviceObject, NULL);
+        }
+
+        if (histogram->DeviceObject == deviceObject) {
+            InterlockedIncrement((PLONG)&histogram->Count[bucket]);
+            return;
+        }
+    }
+}
+
+
+NTSTATUS FASTCALL IoPerfCallDriver(IN PDEVICE_OBJECT DeviceObject, IN OUT PIRP Irp, IN PVOID ReturnAddress)
+/*
+Routine Description:
+    This routine replaces IofCallDriver while the PERF_DRIVERS group is on.
+    It logs the call to the dispatch routine of the driver and its return, and remembers the time at which a request was first dispatched.
+Arguments:
+    DeviceObject - Pointer to device object to which the IRP should be passed.
+    Irp - Pointer to IRP for request.
+    ReturnAddress - Address of the caller of IofCallDriver.
+Return Value:
+    Return status from driver's dispatch routine.
+*/
+{
+    PIO_STACK_LOCATION irpSp;
+    PIOP_PERF_TRACKED_IRP trackedIrp;
+    PERFINFO_DRIVER_MAJORFUNCTION majorFunction;
+    PERFINFO_DRIVER_MAJORFUNCTION_RET majorFunctionReturn;
+    NTSTATUS status;
+
+    UNREFERENCED_PARAMETER(ReturnAddress);
+
+    if (!PERFINFO_IS_GROUP_ON(PERF_DRIVERS)) {
+        return IopfCallDriver(DeviceObject, Irp);
+    }
+
+    // Remember the dispatch time of requests sent to the top of a stack; a request already being tracked keeps its slot.
+    if (Irp->CurrentLocation == Irp->StackCount + 1) {
+        trackedIrp = &IopPerfTrackedIrps[IopPerfIrpSlot(Irp)];
+        if (InterlockedCompareExchangePointer((PVOID*)&trackedIrp->Irp, Irp, NULL) == NULL) {
+            trackedIrp->DeviceObject = DeviceObject;
+            trackedIrp->DispatchTime = KeQueryPerformanceCounter(NULL).QuadPart;
+        }
+    }
+
+    irpSp = IoGetNextIrpStackLocation(Irp);
+    majorFunction.UniqMatchId = InterlockedIncrement(&IopPerfUniqMatchId);
+    majorFunction.RoutineAddr = (PVOID)DeviceObject->DriverObject->MajorFunction[irpSp->MajorFunction];
+    majorFunction.Irp = Irp;
+    majorFunction.MajorFunction = irpSp->MajorFunction;
+    majorFunction.MinorFunction = irpSp->MinorFunction;
+    majorFunction.FileNamePointer = (irpSp->FileObject != NULL) ? &irpSp->FileObject->FileName : NULL;
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_MAJORFUNCTION_CALL, &majorFunction, sizeof(majorFunction));
+
+    status = IopfCallDriver(DeviceObject, Irp);
+
+    // The request may have been completed and freed by now, so only its address is logged.
+    majorFunctionReturn.UniqMatchId = majorFunction.UniqMatchId;
+    majorFunctionReturn.Irp = Irp;
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_MAJORFUNCTION_RETURN, &majorFunctionReturn, sizeof(majorFunctionReturn));
+    return status;
+}
+
+
+VOID FASTCALL IoPerfCompleteRequest(IN PIRP Irp, IN CCHAR PriorityBoost)
+/*
+Routine Description:
+    This routine replaces IofCompleteRequest while the PERF_DRIVERS group is on.
+    It logs the completion of the request by the driver which owns the current stack location, counts its latency, and logs the return from completion.
+Arguments:
+    Irp - Pointer to the I/O Request Packet to complete.
+    PriorityBoost - Supplies the amount of priority boost that is to be given to the thread waiting for the I/O to complete.
+*/
+{
+    PIO_STACK_LOCATION irpSp;
+    PERFINFO_DRIVER_COMPLETE_REQUEST completeRequest;
+    PERFINFO_DRIVER_COMPLETE_REQUEST_RET completeRequestReturn;
+
+    if (!PERFINFO_IS_GROUP_ON(PERF_DRIVERS)) {
+        IopfCompleteRequest(Irp, PriorityBoost);
+        return;
+    }
+
+    IopPerfCountLatency(Irp);
+
+    completeRequest.RoutineAddr = NULL;
+    if (Irp->CurrentLocation <= Irp->StackCount) {
+        irpSp = IoGetCurrentIrpStackLocation(Irp);
+        if (irpSp->DeviceObject != NULL) {
+            completeRequest.RoutineAddr = (PVOID)irpSp->DeviceObject->DriverObject->MajorFunction[irpSp->MajorFunction];
+        }
+    }
+
+    completeRequest.Irp = Irp;
+    completeRequest.UniqMatchId = InterlockedIncrement(&IopPerfUniqMatchId);
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_COMPLETE_REQUEST, &completeRequest, sizeof(completeRequest));
+
+    IopfCompleteRequest(Irp, PriorityBoost);
+
+    completeRequestReturn.Irp = Irp;
+    completeRequestReturn.UniqMatchId = completeRequest.UniqMatchId;
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_COMPLETE_REQUEST_RETURN, &completeRequestReturn, sizeof(completeRequestReturn));
+}
+
+
+NTSTATUS IopPerfCallCompletionRoutine(IN PIO_COMPLETION_ROUTINE CompletionRoutine,
+                                      IN PDEVICE_OBJECT DeviceObject,
+                                      IN PIRP Irp,
+                                      IN PVOID Context
+)
+/*
+Routine Description:
+    This routine is used by IopfCompleteRequest while the PERF_DRIVERS group is on to invoke a completion routine and log the call and its return.
+Arguments:
+    CompletionRoutine - Supplies the completion routine of the stack location being completed.
+    DeviceObject - Supplies the device object passed to the completion routine.
+    Irp - Pointer to the request being completed.
+    Context - Supplies the context passed to the completion routine.
+Return Value:
+    The status returned by the completion routine.
+*/
+{
+    PERFINFO_DRIVER_COMPLETIONROUTINE completionRoutine;
+    PERFINFO_DRIVER_COMPLETIONROUTINE_RET completionRoutineReturn;
+    NTSTATUS status;
+
+    completionRoutine.Routine = (PVOID)CompletionRoutine;
+    completionRoutine.Irp = Irp;
+    completionRoutine.UniqMatchId = InterlockedIncrement(&IopPerfUniqMatchId);
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_COMPLETIONROUTINE_CALL, &completionRoutine, sizeof(completionRoutine));
+
+    status = CompletionRoutine(DeviceObject, Irp, Context);
+
+    completionRoutineReturn.Irp = Irp;
+    completionRoutineReturn.UniqMatchId = completionRoutine.UniqMatchId;
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_COMPLETIONROUTINE_RETURN, &completionRoutineReturn, sizeof(completionRoutineReturn));
+    return status;
+}
+
+
+VOID IopPerfLogCompleteRequestApc(IN PIRP Irp)
+/*
+Routine Description:
+    This routine logs the start of the final processing of a request in the context of the thread that issued it.
+Arguments:
+    Irp - Pointer to the request being finished.
+*/
+{
+    PERFINFO_DRIVER_COMPLETE_REQUEST_APC completeRequestApc;
+
+    completeRequestApc.Irp = Irp;
+    completeRequestApc.Status = Irp->IoStatus.Status;
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_DRIVER_COMPLETE_REQUEST_APC, &completeRequestApc, sizeof(completeRequestApc));
+}
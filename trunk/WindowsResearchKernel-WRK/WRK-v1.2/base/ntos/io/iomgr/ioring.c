@@ -0,0 +1,286 @@
+/*
+Copyright (c) Microsoft Corporation. All rights reserved.
+
+You may only use this code if you agree to the terms of the Windows Research Kernel Source Code License agreement (see License.txt).
+If you do not agree to the terms, do not use the code.
+
+Module Name:
+    ioring.c
+
+Abstract:
+    This module contains the code to implement the NtEnterIoRing system service.
+
+    An I/O ring is a block of the caller's memory holding a submission ring of read, write and device control requests and a
+    completion ring of FILE_IO_COMPLETION_INFORMATION entries.  A single call to NtEnterIoRing issues every request the caller has
+    queued, then moves completions from an I/O completion object into the completion ring, optionally waiting for a number of them.
+    The requests are issued through the ordinary read, write and device control services and complete through the I/O completion
+    object the files are associated with, so the ring only changes how many system calls a batch of I/O costs.
+*/
+
+#include "iomgr.h"
+
+#pragma alloc_text(PAGE, NtEnterIoRing)
+#pragma alloc_text(PAGE, IopSubmitIoRingEntry)
+
+
+NTSTATUS IopSubmitIoRingEntry(IN PIO_RING_SUBMISSION_ENTRY Entry, IN PIO_RING_SUBMISSION_ENTRY UserEntry)
+/*
+Routine Description:
+    This routine issues one request taken from the submission ring of an I/O ring.
+Arguments:
+    Entry - Supplies the captured submission entry.
+    UserEntry - Supplies the entry in the caller's ring.  The byte offset and key are passed by reference from it, so the services capture them as they would any caller's arguments.
+Return Value:
+    The status returned by the service which issued the request.
+*/
+{
+    PAGED_CODE();
+
+    switch (Entry->Operation) {
+    case IoRingOperationRead:
+        return NtReadFile(Entry->FileHandle,
+                          NULL,
+                          NULL,
+                          Entry->UserData,
+                          Entry->IoStatusBlock,
+                          Entry->Buffer,
+                          Entry->Length,
+                          &UserEntry->ByteOffset,
+                          &UserEntry->Key);
+    case IoRingOperationWrite:
+        return NtWriteFile(Entry->FileHandle,
+                           NULL,
+                           NULL,
+                           Entry->UserData,
+                           Entry->IoStatusBlock,
+                           Entry->Buffer,
+                           Entry->Length,
+                           &UserEntry->ByteOffset,
+                           &UserEntry->Key);
+    case IoRingOperationReadRegistered:
+        return NtReadFileRegistered(Entry->FileIndex,
+                                    NULL,
+                                    NULL,
+                                    Entry->UserData,
+                                    Entry->IoStatusBlock,
+                                    Entry->BufferIndex,
+                                    Entry->BufferOffset,
+                                    Entry->Length,
+                                    &UserEntry->ByteOffset,
+                                    &UserEntry->Key);
+    case IoRingOperationWriteRegistered:
+        return NtWriteFileRegistered(Entry->FileIndex,
+                                     NULL,
+                                     NULL,
+                                     Entry->UserData,
+                                     Entry->IoStatusBlock,
+                                     Entry->BufferIndex,
+                                     Entry->BufferOffset,
+                                     Entry->Length,
+                                     &UserEntry->ByteOffset,
+                                     &UserEntry->Key);
+    case IoRingOperationDeviceControl:
+        return NtDeviceIoControlFile(Entry->FileHandle,
+                                     NULL,
+                                     NULL,
+                                     Entry->UserData,
+                                     Entry->IoStatusBlock,
+                                     Entry->IoControlCode,
+                                     Entry->Buffer,
+                                     Entry->Length,
+                                     Entry->OutputBuffer,
+                                     Entry->OutputBufferLength);
+    default:
+        return STATUS_INVALID_PARAMETER;
+    }
+}
+
+
+NTSTATUS NtEnterIoRing(__inout PIO_RING Ring, __in HANDLE IoCompletionHandle, __in ULONG MinimumCompletions, __in_opt PLARGE_INTEGER Timeout)
+/*
+Routine Description:
+    This service issues the requests in the submission ring of an I/O ring and collects completions into its completion ring.
+
+    Every entry from SubmissionHead up to SubmissionTail is issued, and SubmissionHead is advanced past it.
+    The UserData of an entry is passed as the APC context, so it is returned in the ApcContext of the request's completion.
+    The files must be associated with the I/O completion object, and the requests complete through it as usual.
+    A request which fails before any I/O is started does not complete through the file, so a completion carrying its status is
+    queued to the I/O completion object instead; every entry thus produces exactly one completion.
+
+    Completions are then removed from the I/O completion object and written to the completion ring at CompletionTail, until the ring is
+    full or none remain, waiting until at least MinimumCompletions have been written.  The caller consumes them by advancing CompletionHead.
+Arguments:
+    Ring - Supplies the I/O ring.  The caller may only change SubmissionTail, CompletionHead and the entries it owns while this service runs.
+    IoCompletionHandle - Supplies a handle to the I/O completion object to collect completions from.
+    MinimumCompletions - Supplies the number of completions to wait for.  Zero collects only those already available.
+    Timeout - Supplies an optional time out for each wait for completions.
+Return Value:
+    STATUS_SUCCESS if the requests were issued and at least MinimumCompletions completions were collected.
+    STATUS_TIMEOUT or STATUS_USER_APC if the wait for completions ended first.
+    STATUS_INVALID_PARAMETER if the ring is malformed.  Otherwise the status of a failure to queue a completion, in which case
+    SubmissionHead is left at the entry which could not be reported.
+*/
+{
+    KPROCESSOR_MODE PreviousMode;
+    IO_RING CapturedRing;
+    PIO_RING_SUBMISSION_ENTRY Submissions;
+    PFILE_IO_COMPLETION_INFORMATION Completions;
+    IO_RING_SUBMISSION_ENTRY Entry;
+    FILE_IO_COMPLETION_INFORMATION Information;
+    PLIST_ENTRY EntryArray[IOP_REMOVE_COMPLETION_LOCAL_COUNT];
+    PLARGE_INTEGER CapturedTimeout = NULL;
+    LARGE_INTEGER TimeoutValue;
+    LARGE_INTEGER ZeroTimeout;
+    PVOID IoCompletion;
+    ULONG Head;
+    ULONG Tail;
+    ULONG CompletionHead;
+    ULONG CompletionTail;
+    ULONG Space;
+    ULONG Count;
+    ULONG Number;
+    ULONG Index;
+    ULONG Removed;
+    NTSTATUS SubmitStatus;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    // Probe and capture the ring header and the optional timeout, then probe the whole ring with the sizes the header gave.
+    PreviousMode = KeGetPreviousMode();
+    try {
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(Ring, sizeof(IO_RING), sizeof(ULONG_PTR));
+            if (ARGUMENT_PRESENT(Timeout)) {
+                TimeoutValue = ProbeAndReadLargeInteger(Timeout);
+                CapturedTimeout = &TimeoutValue;
+            }
+        } else if (ARGUMENT_PRESENT(Timeout)) {
+            TimeoutValue = *Timeout;
+            CapturedTimeout = &TimeoutValue;
+        }
+
+        CapturedRing = *Ring;
+        if ((CapturedRing.SubmissionEntries == 0) || (CapturedRing.SubmissionEntries > IO_RING_MAXIMUM_ENTRIES) ||
+            ((CapturedRing.SubmissionEntries & (CapturedRing.SubmissionEntries - 1)) != 0) ||
+            (CapturedRing.CompletionEntries == 0) || (CapturedRing.CompletionEntries > IO_RING_MAXIMUM_ENTRIES) ||
+            ((CapturedRing.CompletionEntries & (CapturedRing.CompletionEntries - 1)) != 0) ||
+            ((CapturedRing.SubmissionTail - CapturedRing.SubmissionHead) > CapturedRing.SubmissionEntries)) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(Ring, IO_RING_SIZE(CapturedRing.SubmissionEntries, CapturedRing.CompletionEntries), sizeof(ULONG_PTR));
+        }
+    } except(ExSystemExceptionFilter())
+    {
+        return GetExceptionCode();
+    }
+
+    Submissions = (PIO_RING_SUBMISSION_ENTRY)(Ring + 1);
+    Completions = (PFILE_IO_COMPLETION_INFORMATION)(Submissions + CapturedRing.SubmissionEntries);
+
+    Status = ObReferenceObjectByHandle(IoCompletionHandle, IO_COMPLETION_MODIFY_STATE, IoCompletionObjectType, PreviousMode, &IoCompletion, NULL);
+    if (!NT_SUCCESS(Status)) {
+        return Status;
+    }
+
+    // Issue every queued request.
+    // A request which fails outright is reported through the completion object so the caller sees one completion per entry.
+    Head = CapturedRing.SubmissionHead;
+    Tail = CapturedRing.SubmissionTail;
+    while (Head != Tail) {
+        try {
+            Entry = Submissions[Head & (CapturedRing.SubmissionEntries - 1)];
+        } except(ExSystemExceptionFilter())
+        {
+            Status = GetExceptionCode();
+            break;
+        }
+
+        SubmitStatus = IopSubmitIoRingEntry(&Entry, &Submissions[Head & (CapturedRing.SubmissionEntries - 1)]);
+        if (NT_ERROR(SubmitStatus)) {
+            Status = IoSetIoCompletion(IoCompletion, NULL, Entry.UserData, SubmitStatus, 0, TRUE);
+            if (!NT_SUCCESS(Status)) {
+                break;
+            }
+        }
+
+        Head += 1;
+    }
+
+    try {
+        Ring->SubmissionHead = Head;
+    } except(ExSystemExceptionFilter())
+    {
+        NOTHING;
+    }
+
+    if (!NT_SUCCESS(Status)) {
+        ObDereferenceObject(IoCompletion);
+        return Status;
+    }
+
+    // Collect completions while there is room in the completion ring.
+    // Wait with the caller's time out until the minimum has been collected, then take only what is already queued.
+    ZeroTimeout.QuadPart = 0;
+    CompletionTail = CapturedRing.CompletionTail;
+    Removed = 0;
+    for (;;) {
+        try {
+            CompletionHead = Ring->CompletionHead;
+        } except(ExSystemExceptionFilter())
+        {
+            break;
+        }
+
+        // A completion head the system could not have produced is treated as a full ring.
+        Space = CapturedRing.CompletionEntries - (CompletionTail - CompletionHead);
+        if ((Space == 0) || (Space > CapturedRing.CompletionEntries)) {
+            break;
+        }
+
+        Count = (Space < IOP_REMOVE_COMPLETION_LOCAL_COUNT) ? Space : IOP_REMOVE_COMPLETION_LOCAL_COUNT;
+        Number = KeRemoveQueueEx((PKQUEUE)IoCompletion,
+                                 PreviousMode,
+                                 (Removed < MinimumCompletions) ? CapturedTimeout : &ZeroTimeout,
+                                 EntryArray,
+                                 Count);
+
+        // N.B. If the wait did not remove any entries, then the only entry returned is STATUS_USER_APC or STATUS_TIMEOUT.
+        if (((LONG_PTR)EntryArray[0] == STATUS_TIMEOUT) || ((LONG_PTR)EntryArray[0] == STATUS_USER_APC)) {
+            if (Removed < MinimumCompletions) {
+                Status = (NTSTATUS)((LONG_PTR)EntryArray[0]);
+            }
+
+            break;
+        }
+
+        for (Index = 0; Index < Number; Index += 1) {
+            IopCaptureCompletionEntry(EntryArray[Index], &Information);
+            try {
+                Completions[CompletionTail & (CapturedRing.CompletionEntries - 1)] = Information;
+            } except(ExSystemExceptionFilter())
+            {// As with NtRemoveIoCompletionEx, the caller will take an access violation when it looks at the completion.
+                NOTHING;
+            }
+
+            CompletionTail += 1;
+        }
+
+        Removed += Number;
+        if ((Number < Count) && (Removed >= MinimumCompletions)) {
+            break;
+        }
+    }
+
+    try {
+        Ring->CompletionTail = CompletionTail;
+    } except(ExSystemExceptionFilter())
+    {
+        NOTHING;
+    }
+
+    ObDereferenceObject(IoCompletion);
+    return Status;
+}
@@ -74,6 +74,7 @@ NTSTATUS IopDeleteSessionSymLinks(IN PUNICODE_STRING LinkName);
 #pragma alloc_text(PAGE, IoGetConfigurationInformation)
 #pragma alloc_text(PAGE, IoGetDeviceObjectPointer)
 #pragma alloc_text(PAGE, IoComputeDesiredAccessFileObject)
+#pragma alloc_text(PAGE, IoInitializeThreadCompletionBatch)
 #pragma alloc_text(PAGE, IoInitializeTimer)
 #pragma alloc_text(PAGE, IoIsValidNameGraftingBuffer)
 #pragma alloc_text(PAGE, IopDoNameTransmogrify)
@@ -87,6 +88,7 @@ NTSTATUS IopDeleteSessionSymLinks(IN PUNICODE_STRING LinkName);
 #pragma alloc_text(PAGE, IoRegisterLastChanceShutdownNotification)
 #pragma alloc_text(PAGE, IoRegisterShutdownNotification)
 #pragma alloc_text(PAGE, IoRemoveShareAccess)
+#pragma alloc_text(PAGE, IoSetDeviceQueueFairShare)
 #pragma alloc_text(PAGE, IoSetInformation)
 #pragma alloc_text(PAGE, IoSetShareAccess)
 #pragma alloc_text(PAGE, IoSetSystemPartition)
@@ -126,7 +128,11 @@ Arguments:
     Irql - Address of a variable to receive the old IRQL.
 */
 {
-    *Irql = KeAcquireQueuedSpinLock(LockQueueIoCancelLock);// Simply acquire the cancel spin lock and return.
+    *Irql = KeAcquireQueuedSpinLock(LockQueueIoCancelLock);// Acquire the cancel spin lock
+
+    // Note who holds the lock and since when, IoReleaseCancelSpinLock accounts the hold time to the owner.
+    IopCancelLockOwner = _ReturnAddress();
+    IopCancelLockAcquireTime = (ULONG64)PerfGetCycleCount();
 }
 
 
@@ -469,10 +475,11 @@ Return Value:
 
     if ((StackSize <= (CCHAR)largeIrpStackLocations) && ((ChargeQuota == FALSE) || (prcb->LookasideIrpFloat > 0))) {
         fixedSize = IRP_ALLOCATED_FIXED_SIZE;
-        number = LookasideSmallIrpList;
-        if (StackSize != 1) {
+        number = IopIrpLookasideNumber(StackSize);
+        if (number == LookasideMediumIrpList) {
+            allocateSize = IoSizeOfIrp(IOP_MEDIUM_IRP_STACK_LOCATIONS);
+        } else if (number == LookasideLargeIrpList) {
             allocateSize = IoSizeOfIrp((CCHAR)largeIrpStackLocations);
-            number = LookasideLargeIrpList;
         }
 
         lookasideList = prcb->PPLookasideList[number].P;
@@ -534,11 +541,17 @@ Return Value:
     // Initialize the packet.
     // Note that irp->Size may not be equal to IoSizeOfIrp(StackSize)
     IopInitializeIrp(irp, allocateSize, StackSize);
-    irp->AllocationFlags = (fixedSize | lookasideAllocation);
+    irp->AllocationFlags = (fixedSize | lookasideAllocation | IopIrpNodeFlags(prcb));
     if (ChargeQuota) {
         irp->AllocationFlags |= IRP_QUOTA_CHARGED;
     }
 
+    // The request inherits the I/O priority of the thread it is allocated for.
+    // Above APC level the current thread is not necessarily the one the request is being issued on behalf of.
+    if (KeGetCurrentIrql() < DISPATCH_LEVEL) {
+        irp->Flags |= ((ULONG)PsGetCurrentThread()->IoPriority << IRP_IO_PRIORITY_SHIFT);
+    }
+
     return irp;
 }
 
@@ -1350,6 +1363,8 @@ Routine Description:
     and then invokes the cancel routine specified by the appropriate field in the IRP, if a routine was specified.
     It is expected that the cancel routine will release the cancel spinlock.
     If there is no cancel routine, then the cancel spin lock is released.
+    If the device the IRP is at has lock free cancel set by IoSetCancelAttributes the cancel spin lock is not acquired at all,
+    and the cancel routine is invoked at the IRQL of the caller.
 Arguments:
     Irp - Supplies a pointer to the IRP to be cancelled.
 Return Value:
@@ -1359,6 +1374,7 @@ Notes:
 */
 {
     PDRIVER_CANCEL cancelRoutine;
+    PDEVICE_OBJECT deviceObject;
     KIRQL irql;
     BOOLEAN returnValue;
 
@@ -1370,6 +1386,24 @@ Notes:
         }
     }
 
+    // A driver that opted into lock free cancel sets and clears its cancel routines with IoSetCancelRoutine under its own lock,
+    // and only owns the IRP if it got the cancel routine back.  Setting the cancel flag and exchanging the routine is then enough.
+    if (Irp->CurrentLocation <= Irp->StackCount) {
+        deviceObject = Irp->Tail.Overlay.CurrentStackLocation->DeviceObject;
+        if (deviceObject->DeviceObjectExtension->StartIoFlags & DOE_CANCEL_LOCK_FREE) {
+            Irp->Cancel = TRUE;
+            cancelRoutine = (PDRIVER_CANCEL)(ULONG_PTR)InterlockedExchangePointer((PVOID*)& Irp->CancelRoutine, NULL);
+            if (cancelRoutine == NULL) {
+                return FALSE;
+            }
+
+            InterlockedIncrement((PLONG)&IopLockFreeCancelCount);
+            Irp->CancelIrql = KeGetCurrentIrql();
+            cancelRoutine(deviceObject, Irp);
+            return TRUE;
+        }
+    }
+
     IoAcquireCancelSpinLock(&irql);// Acquire the cancel spin lock.
     Irp->Cancel = TRUE;// Set the cancel flag in the IRP.
 
@@ -1380,6 +1414,7 @@ Notes:
             KeBugCheckEx(CANCEL_STATE_IN_COMPLETED_IRP, (ULONG_PTR)Irp, (ULONG_PTR)cancelRoutine, 0, 0);
         }
 
+        IopCancelLockOwner = (PVOID)(ULONG_PTR)cancelRoutine;// The hold time is the cancel routine's, not ours
         Irp->CancelIrql = irql;
         cancelRoutine(Irp->Tail.Overlay.CurrentStackLocation->DeviceObject, Irp);
         return(TRUE);// The cancel spinlock should have been released by the cancel routine.
@@ -1390,6 +1425,29 @@ Notes:
 }
 
 
+VOID IoInitializeThreadCompletionBatch(IN PETHREAD Thread)
+/*
+Routine Description:
+    This routine initializes the completion batch of a newly created thread.
+    IoCompleteRequest collects the requests completed for the thread on the batch and finishes them with a single special kernel APC.
+Arguments:
+    Thread - Pointer to the thread being created.
+*/
+{
+    PAGED_CODE();
+
+    Thread->IoCompletionBatch = NULL;
+    KeInitializeApc(&Thread->IoCompletionBatchApc,
+                    &Thread->Tcb,
+                    OriginalApcEnvironment,
+                    IopCompleteRequestBatch,
+                    IopAbortRequestBatch,
+                    (PKNORMAL_ROUTINE)NULL,
+                    KernelMode,
+                    (PVOID)NULL);
+}
+
+
 VOID IoCancelThreadIo(IN PETHREAD Thread)
 /*
 Routine Description:
@@ -2099,7 +2157,12 @@ Arguments:
                 deviceObject = IoGetCurrentIrpStackLocation(Irp)->DeviceObject;
             }
 
-            status = stackPointer->CompletionRoutine(deviceObject, Irp, stackPointer->Context);
+            if (PERFINFO_IS_GROUP_ON(PERF_DRIVERS)) {
+                status = IopPerfCallCompletionRoutine(stackPointer->CompletionRoutine, deviceObject, Irp, stackPointer->Context);
+            } else {
+                status = stackPointer->CompletionRoutine(deviceObject, Irp, stackPointer->Context);
+            }
+
             if (status == STATUS_MORE_PROCESSING_REQUIRED) {
                 // Note:  Notice that if the driver has returned the above status value, it may have already DEALLOCATED the packet!
                 //        Therefore, do NOT touch any part of the IRP in the following code.
@@ -2228,9 +2291,14 @@ Arguments:
     // Check to see whether any pages need to be unlocked.
     if (Irp->MdlAddress != NULL) {
         // Unlock any pages that may be described by MDLs.
+        // A partial MDL of a registered buffer does not own its locked pages; release its reference on the buffer instead.
         mdl = Irp->MdlAddress;
         while (mdl != NULL) {
-            MmUnlockPages(mdl);
+            if ((Irp->Flags & IRP_REGISTERED_BUFFER) && (mdl->MdlFlags & MDL_PARTIAL)) {
+                IopReleaseRegisteredBufferMdl(mdl);
+            } else {
+                MmUnlockPages(mdl);
+            }
             mdl = mdl->Next;
         }
     }
@@ -2246,19 +2314,48 @@ Arguments:
         return;
     }
 
-    // Finally, initialize the IRP as an APC structure and queue the special kernel APC to the target thread.
+    // Finally, finish the request in the context of the target thread.
     thread = Irp->Tail.Overlay.Thread;
     fileObject = Irp->Tail.Overlay.OriginalFileObject;
     if (!Irp->Cancel) {
-        KeInitializeApc(&Irp->Tail.Apc,
-                        &thread->Tcb,
-                        Irp->ApcEnvironment,
-                        IopCompleteRequest,
-                        IopAbortRequest,
-                        (PKNORMAL_ROUTINE)NULL,
-                        KernelMode,
-                        (PVOID)NULL);
-        (VOID)KeInsertQueueApc(&Irp->Tail.Apc, fileObject, (PVOID)saveAuxiliaryPointer, PriorityBoost);
+        if (thread == PsGetCurrentThread() &&
+            thread->IoCompletionBatch == NULL &&
+            Irp->ApcEnvironment == thread->Tcb.ApcStateIndex &&
+            !KeAreAllApcsDisabled()) {
+            // The request is being completed in the context of the thread that issued it and special kernel APCs are deliverable,
+            // so an APC queued here would run as soon as it was inserted.
+            // Finish the request in line at APC level instead.
+            // This is not done while a batch is pending, so that the request does not overtake requests completed before it.
+            KeRaiseIrql(APC_LEVEL, &irql);
+            IopCompleteRequest(&Irp->Tail.Apc, NULL, NULL, &fileObject, &saveAuxiliaryPointer);
+            KeLowerIrql(irql);
+        } else if (Irp->ApcEnvironment == OriginalApcEnvironment) {
+            // Add the request to the thread's completion batch.
+            // Only the completion that finds the batch empty queues the batch APC;
+            // requests completed before the APC is delivered are finished by the same APC.
+            PLIST_ENTRY batch;
+
+            Irp->Tail.Overlay.AuxiliaryBuffer = saveAuxiliaryPointer;
+            do {
+                batch = thread->IoCompletionBatch;
+                Irp->Tail.Overlay.ListEntry.Flink = batch;
+            } while (InterlockedCompareExchangePointer((PVOID*)&thread->IoCompletionBatch, &Irp->Tail.Overlay.ListEntry, batch) != batch);
+
+            if (batch == NULL) {
+                (VOID)KeInsertQueueApc(&thread->IoCompletionBatchApc, (PVOID)NULL, (PVOID)NULL, PriorityBoost);
+            }
+        } else {
+            // The request was issued while the thread was attached to another process; it must be finished in that environment.
+            KeInitializeApc(&Irp->Tail.Apc,
+                            &thread->Tcb,
+                            Irp->ApcEnvironment,
+                            IopCompleteRequest,
+                            IopAbortRequest,
+                            (PKNORMAL_ROUTINE)NULL,
+                            KernelMode,
+                            (PVOID)NULL);
+            (VOID)KeInsertQueueApc(&Irp->Tail.Apc, fileObject, (PVOID)saveAuxiliaryPointer, PriorityBoost);
+        }
     } else {
         // This request has been cancelled.
         // Ensure that access to the thread is synchronized, 
@@ -2330,6 +2427,10 @@ Return Value:
         STATUS_SUCCESS - Everything worked successfully.
         STATUS_INVALID_PARAMETER - No processors were specified.
         STATUS_INSUFFICIENT_RESOURCES - There was not enough nonpaged pool.
+    N.B. The processor enable mask only selects the processors on which interrupt objects are connected.
+         The processor that actually receives the interrupt is chosen by the HAL when the vector is programmed and is not changed by this routine.
+         A driver that wants its completion work done near the requester should keep the ISR short and queue its DPC with KeSetTargetProcessorDpc set to the processor that issued the request,
+         for example one recorded with KeGetCurrentProcessorNumber in the dispatch routine, rather than relying on the interrupting processor.
 */
 {
     CCHAR count;
@@ -4165,7 +4266,8 @@ Arguments:
     if (!(Irp->AllocationFlags & IRP_ALLOCATED_FIXED_SIZE) || (Irp->AllocationFlags & IRP_ALLOCATED_MUST_SUCCEED)) {
         ExFreePool(Irp);
     } else {
-        if (IopIrpAutoSizingEnabled() && (Irp->Size != IoSizeOfIrp(IopLargeIrpStackLocations)) && (Irp->Size != IoSizeOfIrp(1))) {
+        if (IopIrpAutoSizingEnabled() &&
+            (Irp->Size != IoSizeOfIrp(IopLargeIrpStackLocations)) && (Irp->Size != IoSizeOfIrp(IOP_MEDIUM_IRP_STACK_LOCATIONS)) && (Irp->Size != IoSizeOfIrp(1))) {
             ExFreePool(Irp);
             return;
         }
@@ -4173,28 +4275,26 @@ Arguments:
         // Store the size in a different field as this will get overwritten by single list entry.
         Irp->IoStatus.Information = Irp->Size;
 
-        number = LookasideSmallIrpList;
-        if (Irp->StackCount != 1) {
-            number = LookasideLargeIrpList;
-        }
+        number = IopIrpLookasideNumber(Irp->StackCount);
 
-        lookasideList = prcb->PPLookasideList[number].P;
-        lookasideList->TotalFrees += 1;
-        if (ExQueryDepthSList(&lookasideList->ListHead) >= lookasideList->Depth) {
-            lookasideList->FreeMisses += 1;
-            lookasideList = prcb->PPLookasideList[number].L;
+        // An IRP allocated on another node goes back to that node's list rather than to this processor's,
+        // so that it is next used, and its memory touched, by the processors it is local to.
+        if (IopIrpNode(Irp) != prcb->ParentNode->NodeNumber) {
+            lookasideList = IopNodeIrpLookasideList[IopIrpNode(Irp)][number];
+            lookasideList->TotalFrees += 1;
+        } else {
+            lookasideList = prcb->PPLookasideList[number].P;
             lookasideList->TotalFrees += 1;
             if (ExQueryDepthSList(&lookasideList->ListHead) >= lookasideList->Depth) {
                 lookasideList->FreeMisses += 1;
-                ExFreePool(Irp);
-            } else {
-                if (Irp->AllocationFlags & IRP_QUOTA_CHARGED) {
-                    Irp->AllocationFlags ^= IRP_QUOTA_CHARGED;
-                    ExReturnPoolQuota(Irp);
-                }
-
-                InterlockedPushEntrySList(&lookasideList->ListHead, (PSLIST_ENTRY)Irp);
+                lookasideList = prcb->PPLookasideList[number].L;
+                lookasideList->TotalFrees += 1;
             }
+        }
+
+        if (ExQueryDepthSList(&lookasideList->ListHead) >= lookasideList->Depth) {
+            lookasideList->FreeMisses += 1;
+            ExFreePool(Irp);
         } else {
             if (Irp->AllocationFlags & IRP_QUOTA_CHARGED) {
                 Irp->AllocationFlags ^= IRP_QUOTA_CHARGED;
@@ -5179,15 +5279,16 @@ Return Value:
     allocateSize = packetSize;
     largeIrpStackLocations = (CCHAR)IopLargeIrpStackLocations;
 
+    prcb = KeGetCurrentPrcb();
     if (StackSize <= largeIrpStackLocations) {
         fixedSize = IRP_ALLOCATED_FIXED_SIZE;
-        number = LookasideSmallIrpList;
-        if (StackSize != 1) {
+        number = IopIrpLookasideNumber(StackSize);
+        if (number == LookasideMediumIrpList) {
+            allocateSize = IoSizeOfIrp(IOP_MEDIUM_IRP_STACK_LOCATIONS);
+        } else if (number == LookasideLargeIrpList) {
             allocateSize = IoSizeOfIrp(largeIrpStackLocations);
-            number = LookasideLargeIrpList;
         }
 
-        prcb = KeGetCurrentPrcb();
         lookasideList = prcb->PPLookasideList[number].P;
         lookasideList->TotalAllocates += 1;
         associatedIrp = (PIRP)InterlockedPopEntrySList(&lookasideList->ListHead);
@@ -5229,8 +5330,8 @@ Return Value:
     // Initialize the packet.
     IopInitializeIrp(associatedIrp, allocateSize, StackSize);
     associatedIrp->Flags |= IRP_ASSOCIATED_IRP;
-    associatedIrp->Flags |= (Irp->Flags & IRP_HIGH_PRIORITY_PAGING_IO);
-    associatedIrp->AllocationFlags |= (fixedSize);
+    associatedIrp->Flags |= (Irp->Flags & (IRP_HIGH_PRIORITY_PAGING_IO | IRP_IO_PRIORITY_MASK));
+    associatedIrp->AllocationFlags |= (fixedSize | IopIrpNodeFlags(prcb));
     associatedIrp->Tail.Overlay.Thread = Irp->Tail.Overlay.Thread;// Set the thread ID to be that of the master.
     associatedIrp->AssociatedIrp.MasterIrp = Irp;// Now make the association between this packet and the master.
     return associatedIrp;
@@ -5954,7 +6055,39 @@ Arguments:
     Irql - Supplies the IRQL value returned from acquiring the spin lock.
 */
 {
-    KeReleaseQueuedSpinLock(LockQueueIoCancelLock, Irql);// Simply release the cancel spin lock.
+    PIOP_CANCEL_LOCK_OWNER entry;
+    ULONG64 holdTime;
+    ULONG slot;
+    ULONG i;
+
+    // Account the time the lock was held to its owner before the lock is released.
+    // The lock is also taken directly at DPC level inside the I/O system, those holds are not timed.
+    if (IopCancelLockAcquireTime != 0) {
+        holdTime = (ULONG64)PerfGetCycleCount() - IopCancelLockAcquireTime;
+        IopCancelLockAcquireTime = 0;
+        IopCancelLockCount += 1;
+        IopCancelLockHoldTime += holdTime;
+
+        slot = IopCancelLockOwnerSlot(IopCancelLockOwner);
+        for (i = 0; i < IOP_CANCEL_LOCK_PROBES; i += 1) {
+            entry = &IopCancelLockOwners[(slot + i) & (IOP_CANCEL_LOCK_OWNERS - 1)];
+            if (entry->Owner == NULL) {
+                entry->Owner = IopCancelLockOwner;
+            }
+
+            if (entry->Owner == IopCancelLockOwner) {
+                entry->Count += 1;
+                entry->HoldTime += holdTime;
+                if (holdTime > entry->MaximumHoldTime) {
+                    entry->MaximumHoldTime = holdTime;
+                }
+
+                break;
+            }
+        }
+    }
+
+    KeReleaseQueuedSpinLock(LockQueueIoCancelLock, Irql);// Release the cancel spin lock.
 }
 
 
@@ -6542,6 +6675,11 @@ Arguments:
 
     // Remove the next packet from the head of the queue.  If a packet was found, then process it.
     packet = KeRemoveDeviceQueue(&DeviceObject->DeviceQueue);
+    if (DeviceObject->DeviceObjectExtension->FairShareQueue) {
+        IopFairShareStartPacket(DeviceObject->DeviceObjectExtension->FairShareQueue,
+                                packet ? CONTAINING_RECORD(packet, IRP, Tail.Overlay.DeviceQueueEntry) : NULL);
+    }
+
     if (packet) {
         irp = CONTAINING_RECORD(packet, IRP, Tail.Overlay.DeviceQueueEntry);
 
@@ -6590,6 +6728,11 @@ Arguments:
 
     // Attempt to remove the indicated packet according to the key from the device queue.  If one is found, then process it.
     packet = KeRemoveByKeyDeviceQueue(&DeviceObject->DeviceQueue, Key);
+    if (DeviceObject->DeviceObjectExtension->FairShareQueue) {
+        IopFairShareStartPacket(DeviceObject->DeviceObjectExtension->FairShareQueue,
+                                packet ? CONTAINING_RECORD(packet, IRP, Tail.Overlay.DeviceQueueEntry) : NULL);
+    }
+
     if (packet) {
         irp = CONTAINING_RECORD(packet, IRP, Tail.Overlay.DeviceQueueEntry);
 
@@ -6624,13 +6767,15 @@ Routine Description:
 Arguments:
     DeviceObject - Pointer to device object itself.
     Irp - I/O Request Packet which should be started on the device.
-    Key - Key to be used in inserting packet into device queue;  optional (if not specified, then packet is inserted at the tail).
+    Key - Key to be used in inserting packet into device queue;  optional (if not specified, then packet is inserted in deadline order, see below).
     CancelFunction - Pointer to an optional cancel routine.
 */
 {
     KIRQL oldIrql;
     KIRQL cancelIrql = PASSIVE_LEVEL;
     BOOLEAN i;
+    ULONG sortKey;
+    PIOP_FAIR_SHARE_QUEUE fairShareQueue = DeviceObject->DeviceObjectExtension->FairShareQueue;
 
     KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);// Raise the IRQL of the processor to dispatch level for synchronization.
 
@@ -6643,16 +6788,27 @@ Arguments:
     }
 
     // If a key parameter was specified, then insert the request into the work queue according to the key; 
-    // otherwise, simply insert it at the tail.
-    if (Key) {
+    // otherwise, insert it by its deadline, which is the current time in milliseconds plus the budget of its I/O priority class.
+    // Requests of the same class therefore stay in arrival order, and since the queue is nearly always appended to the insert stays cheap.
+    // The millisecond clock wraps every 49.7 days, at which point a request may briefly be queued ahead of older ones.
+    // A device in fair share mode orders all of its requests by their start tag instead, see IoSetDeviceQueueFairShare.
+    if (fairShareQueue) {
+        sortKey = IopFairShareQueuePacket(fairShareQueue, Irp);
+        i = KeInsertByKeyDeviceQueue(&DeviceObject->DeviceQueue, &Irp->Tail.Overlay.DeviceQueueEntry, sortKey);
+    } else if (Key) {
         i = KeInsertByKeyDeviceQueue(&DeviceObject->DeviceQueue, &Irp->Tail.Overlay.DeviceQueueEntry, *Key);
     } else {
-        i = KeInsertDeviceQueue(&DeviceObject->DeviceQueue, &Irp->Tail.Overlay.DeviceQueueEntry);
+        sortKey = (ULONG)(KeQueryInterruptTime() / 10000) + IopIoPriorityDeadline[IoGetIoPriorityHint(Irp)];
+        i = KeInsertByKeyDeviceQueue(&DeviceObject->DeviceQueue, &Irp->Tail.Overlay.DeviceQueueEntry, sortKey);
     }
 
     // If the packet was not inserted into the queue, then this request is now the current packet for this device.
     // Indicate so by storing its address in the current IRP field, and begin processing the request.
     if (!i) {
+        if (fairShareQueue) {
+            IopFairShareStartPacket(fairShareQueue, Irp);
+        }
+
         DeviceObject->CurrentIrp = Irp;
         if (CancelFunction) {
             // If the driver does not want the IRP in the cancelable state then set the routine to NULL
@@ -6769,6 +6925,26 @@ Arguments:
 }
 
 
+VOID IoSetCancelAttributes(IN PDEVICE_OBJECT DeviceObject, IN BOOLEAN LockFreeCancel)
+/*
+Routine Description:
+    This routine sets the cancel attributes of a device.
+    With lock free cancel IoCancelIrp does not acquire the cancel spin lock for IRPs at the device,
+    and the cancel routine is invoked at the IRQL of the caller of IoCancelIrp without the lock to release.
+    The driver must only use IoSetCancelRoutine to set and clear cancel routines, and own an IRP only when it got the routine back,
+    which is what the cancel safe queue routines do.  It must not pass a cancel function to IoStartPacket.
+    The attribute must be set before the first IRP is sent to the device and cannot be cleared.
+Arguments:
+    DeviceObject - Pointer to device object itself.
+    LockFreeCancel - If TRUE cancel routines for IRPs at the device are invoked without the cancel spin lock.
+*/
+{
+    if (LockFreeCancel) {
+        DeviceObject->DeviceObjectExtension->StartIoFlags |= DOE_CANCEL_LOCK_FREE;
+    }
+}
+
+
 VOID IoSetStartIoAttributes(IN PDEVICE_OBJECT DeviceObject, IN BOOLEAN DeferredStartIo, IN BOOLEAN NonCancelable)
 /*
 Routine Description:
@@ -6789,6 +6965,187 @@ Arguments:
 }
 
 
+NTSTATUS IoSetDeviceQueueFairShare(IN PDEVICE_OBJECT DeviceObject, IN ULONG TargetLatency)
+/*
+Routine Description:
+    This routine puts the device queue of a device in fair share mode, so that a burst of requests from one process cannot starve the others.
+    Requests queued by IoStartPacket are then ordered by start time fair queuing between the requesting processes,
+    each request weighted by its I/O priority class, and the key passed to IoStartPacket is ignored.
+    A process that keeps more requests queued than the current depth limit is charged extra for them;
+    the limit adapts so that the time requests spend in the queue stays near the target latency.
+    Fair share mode is meant for drivers that start their requests with IoStartPacket and IoStartNextPacket,
+    and should be set before the device receives any requests.  It cannot be turned off again.
+Arguments:
+    DeviceObject - Pointer to device object itself.
+    TargetLatency - The queue latency to aim for, in milliseconds, or zero for the default.
+Return Value:
+    STATUS_SUCCESS, or STATUS_INSUFFICIENT_RESOURCES if the fair share state could not be allocated.
+*/
+{
+    PIOP_FAIR_SHARE_QUEUE fairShareQueue;
+
+    PAGED_CODE();
+
+    if (TargetLatency == 0) {
+        TargetLatency = IOP_FAIR_SHARE_DEFAULT_LATENCY;
+    }
+
+    // If the device is already in fair share mode then only update the target.
+    fairShareQueue = DeviceObject->DeviceObjectExtension->FairShareQueue;
+    if (fairShareQueue) {
+        fairShareQueue->TargetLatency = TargetLatency * 10000;
+        return STATUS_SUCCESS;
+    }
+
+    fairShareQueue = ExAllocatePoolWithTag(NonPagedPool, sizeof(IOP_FAIR_SHARE_QUEUE), 'qFoI');
+    if (fairShareQueue == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(fairShareQueue, sizeof(IOP_FAIR_SHARE_QUEUE));
+    KeInitializeSpinLock(&fairShareQueue->Lock);
+    fairShareQueue->TargetLatency = TargetLatency * 10000;
+    fairShareQueue->DepthLimit = IOP_FAIR_SHARE_MAX_DEPTH;
+    fairShareQueue->MinimumLatency = MAXULONG;
+    fairShareQueue->IntervalStart = (ULONG)KeQueryInterruptTime();
+    fairShareQueue->Idle = TRUE;
+
+    if (InterlockedCompareExchangePointer(&DeviceObject->DeviceObjectExtension->FairShareQueue, fairShareQueue, NULL) != NULL) {
+        ExFreePool(fairShareQueue);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+ULONG IopFairShareQueuePacket(IN PIOP_FAIR_SHARE_QUEUE FairShareQueue, IN PIRP Irp)
+/*
+Routine Description:
+    This routine charges a request that is about to be queued to a device in fair share mode to the bucket of its process,
+    and returns the start tag by which it is to be sorted into the device queue.
+    The caller is at DISPATCH_LEVEL.
+Arguments:
+    FairShareQueue - The fair share state of the device.
+    Irp - The request being queued.
+Return Value:
+    The start tag of the request.
+*/
+{
+    PIOP_FAIR_SHARE_BUCKET bucket;
+    IO_PRIORITY_HINT priority;
+    ULONG startTag;
+    ULONG cost;
+    LONG excess;
+
+    priority = IoGetIoPriorityHint(Irp);
+    bucket = &FairShareQueue->Bucket[IopFairShareBucket(IoGetRequestorProcess(Irp))];
+
+    KeAcquireSpinLockAtDpcLevel(&FairShareQueue->Lock);
+
+    // Critical requests, such as high priority paging I/O, are not charged and go ahead of every request that has not started yet.
+    // Otherwise the request starts when the previous request of its bucket is done, or now if the bucket has been idle.
+    // Tags are compared by their difference so that the virtual clock may wrap, although the device queue may then briefly sort a few requests out of order.
+    if (priority == IoPriorityCritical) {
+        startTag = FairShareQueue->VirtualTime;
+    } else {
+        startTag = bucket->FinishTag;
+        if ((LONG)(startTag - FairShareQueue->VirtualTime) < 0) {
+            startTag = FairShareQueue->VirtualTime;
+        }
+
+        // The weight of a priority class doubles with each class, so background is charged the full quantum and high an eighth of it.
+        cost = IOP_FAIR_SHARE_QUANTUM >> priority;
+        excess = bucket->Queued - (LONG)FairShareQueue->DepthLimit;
+        if (excess >= 0) {
+            cost *= (ULONG)excess + 2;
+        }
+
+        bucket->FinishTag = startTag + cost;
+    }
+
+    bucket->Queued += 1;
+    FairShareQueue->Queued += 1;
+
+    KeReleaseSpinLockFromDpcLevel(&FairShareQueue->Lock);
+    return startTag;
+}
+
+
+VOID IopFairShareStartPacket(IN PIOP_FAIR_SHARE_QUEUE FairShareQueue, IN PIRP Irp OPTIONAL)
+/*
+Routine Description:
+    This routine is invoked when a request of a device in fair share mode is started, or when its device queue was found empty.
+    It advances the virtual clock to the start tag of the request, measures the service time of the device, and adapts the depth limit.
+    The caller is at DISPATCH_LEVEL.
+Arguments:
+    FairShareQueue - The fair share state of the device.
+    Irp - The request being started, or NULL if the device queue is empty.
+*/
+{
+    PIOP_FAIR_SHARE_BUCKET bucket;
+    ULONG now = (ULONG)KeQueryInterruptTime();
+    ULONG startTag;
+    ULONGLONG latency;
+    ULONG i;
+
+    KeAcquireSpinLockAtDpcLevel(&FairShareQueue->Lock);
+
+    // Once the queue runs empty, reset the counts, which also drops any request a cancel routine removed from the queue.
+    if (Irp == NULL) {
+        FairShareQueue->Queued = 0;
+        for (i = 0; i < IOP_FAIR_SHARE_BUCKETS; i++) {
+            FairShareQueue->Bucket[i].Queued = 0;
+        }
+
+        FairShareQueue->Idle = TRUE;
+        KeReleaseSpinLockFromDpcLevel(&FairShareQueue->Lock);
+        return;
+    }
+
+    bucket = &FairShareQueue->Bucket[IopFairShareBucket(IoGetRequestorProcess(Irp))];
+    if (bucket->Queued > 0) {
+        bucket->Queued -= 1;
+    }
+
+    if (FairShareQueue->Queued > 0) {
+        FairShareQueue->Queued -= 1;
+    }
+
+    startTag = Irp->Tail.Overlay.DeviceQueueEntry.SortKey;
+    if ((LONG)(startTag - FairShareQueue->VirtualTime) > 0) {
+        FairShareQueue->VirtualTime = startTag;
+    }
+
+    // The device was busy since the previous start, so the time between the two is what the previous request took.
+    if (!FairShareQueue->Idle) {
+        FairShareQueue->ServiceTime = FairShareQueue->ServiceTime - (FairShareQueue->ServiceTime / 8) + ((now - FairShareQueue->LastStartTime) / 8);
+    }
+
+    FairShareQueue->Idle = FALSE;
+    FairShareQueue->LastStartTime = now;
+
+    // Estimate how long the requests left in the queue will wait, and keep the smallest estimate of the interval.
+    // A queue that stayed above the target for a whole interval is a standing queue, so halve the depth limit; otherwise let it grow again.
+    latency = (ULONGLONG)FairShareQueue->Queued * FairShareQueue->ServiceTime;
+    if (latency < FairShareQueue->MinimumLatency) {
+        FairShareQueue->MinimumLatency = (ULONG)latency;
+    }
+
+    if (now - FairShareQueue->IntervalStart >= IOP_FAIR_SHARE_INTERVAL) {
+        if (FairShareQueue->MinimumLatency > FairShareQueue->TargetLatency) {
+            FairShareQueue->DepthLimit = (FairShareQueue->DepthLimit > 1) ? FairShareQueue->DepthLimit / 2 : 1;
+        } else if (FairShareQueue->DepthLimit < IOP_FAIR_SHARE_MAX_DEPTH) {
+            FairShareQueue->DepthLimit += 1;
+        }
+
+        FairShareQueue->IntervalStart = now;
+        FairShareQueue->MinimumLatency = MAXULONG;
+    }
+
+    KeReleaseSpinLockFromDpcLevel(&FairShareQueue->Lock);
+}
+
+
 VOID IoStartTimer(IN PDEVICE_OBJECT DeviceObject)
 /*
 Routine Description:
@@ -8499,6 +8856,53 @@ Return Value:
 }
 
 
+IO_PRIORITY_HINT FASTCALL IoGetIoPriorityHint(IN PIRP Irp)
+/*
+Routine Description:
+    This routine returns the I/O priority class of an IRP.
+    The priority comes from the handle or the thread the request was issued on;
+    requests that have none are normal priority, except for high priority paging I/O, which is critical.
+Arguments:
+    Irp - Pointer to the IRP.
+Return Value:
+    Returns IO_PRIORITY_HINT
+*/
+{
+    ULONG priority = (Irp->Flags & IRP_IO_PRIORITY_MASK) >> IRP_IO_PRIORITY_SHIFT;
+
+    if (priority != 0) {
+        return (IO_PRIORITY_HINT)(priority - 1);
+    }
+
+    if (Irp->Flags & IRP_HIGH_PRIORITY_PAGING_IO) {
+        return IoPriorityCritical;
+    }
+
+    return IoPriorityNormal;
+}
+
+
+NTSTATUS FASTCALL IoSetIoPriorityHint(IN PIRP Irp, IN IO_PRIORITY_HINT PriorityHint)
+/*
+Routine Description:
+    This routine sets the I/O priority class of an IRP, replacing the one it inherited from its thread or handle.
+    Drivers that build their own requests may use it before passing the IRP on.
+Arguments:
+    Irp - Pointer to the IRP.
+    PriorityHint - The priority class for the request.
+Return Value:
+    STATUS_SUCCESS, or STATUS_INVALID_PARAMETER if the priority class is not valid.
+*/
+{
+    if ((ULONG)PriorityHint >= MaxIoPriorityTypes) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Irp->Flags = (Irp->Flags & ~IRP_IO_PRIORITY_MASK) | (((ULONG)PriorityHint + 1) << IRP_IO_PRIORITY_SHIFT);
+    return STATUS_SUCCESS;
+}
+
+
 PDEVICE_OBJECT IoFindDeviceThatFailedIrp(IN  PIRP Irp)
 /*
 Routine Description:
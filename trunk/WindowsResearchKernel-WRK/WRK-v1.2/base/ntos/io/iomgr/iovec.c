@@ -0,0 +1,375 @@
+/*
+Copyright (c) Microsoft Corporation. All rights reserved.
+
+You may only use this code if you agree to the terms of the Windows Research Kernel Source Code License agreement (see License.txt).
+If you do not agree to the terms, do not use the code.
+
+Module Name:
+    iovec.c
+
+Abstract:
+    This module contains the code to implement the NtReadFileVector and NtWriteFileVector system services.
+
+    A vectored read or write transfers a contiguous range of a file to or from an array of arbitrary (buffer, length) segments in a
+    single system call.  Unlike NtReadFileScatter and NtWriteFileGather the segments need not be pages, and the file may be cached.
+    While the file is cached, each segment is copied through the fast I/O path, and hence the Cache Manager, with the file object lock
+    held across all of them, so the transfer is not interleaved with other requests made through the same handle.
+    Segments that fast I/O declines go through the ordinary read and write paths, one request each.
+*/
+
+#include "iomgr.h"
+
+#pragma alloc_text(PAGE, IopReadWriteFileVector)
+#pragma alloc_text(PAGE, NtReadFileVector)
+#pragma alloc_text(PAGE, NtWriteFileVector)
+
+// Number of segments captured on the stack; longer arrays are captured into paged pool.
+#define IOP_VECTOR_LOCAL_SEGMENTS 16
+
+
+NTSTATUS IopReadWriteFileVector(
+    IN HANDLE FileHandle,
+    OUT PIO_STATUS_BLOCK IoStatusBlock,
+    IN PFILE_IO_SEGMENT SegmentArray,
+    IN ULONG NumberOfSegments,
+    IN PLARGE_INTEGER ByteOffset OPTIONAL,
+    IN PULONG Key OPTIONAL,
+    IN BOOLEAN Write
+)
+/*
+Routine Description:
+    This routine performs the work of NtReadFileVector and NtWriteFileVector.
+Arguments:
+    Write - Supplies TRUE to write the segments to the file, FALSE to read the file into them.
+    The remaining arguments are those of NtReadFileVector.
+Return Value:
+    The status returned is the same as for NtReadFileVector.
+*/
+{
+    NTSTATUS status;
+    NTSTATUS exceptionCode;
+    PFILE_OBJECT fileObject;
+    PDEVICE_OBJECT deviceObject;
+    PFAST_IO_DISPATCH fastIoDispatch;
+    KPROCESSOR_MODE requestorMode;
+    OBJECT_HANDLE_INFORMATION handleInformation;
+    FILE_IO_SEGMENT localSegments[IOP_VECTOR_LOCAL_SEGMENTS];
+    PFILE_IO_SEGMENT segments = localSegments;
+    IO_STATUS_BLOCK localIoStatus;
+    LARGE_INTEGER fileOffset = {0,0};
+    ULONG keyValue = 0;
+    ULONG totalLength = 0;
+    ULONG transferred = 0;
+    ULONG information;
+    ULONG i;
+    BOOLEAN interrupted;
+    BOOLEAN appending;
+    BOOLEAN positioned = FALSE;
+    BOOLEAN done = FALSE;
+    PETHREAD CurrentThread;
+
+    PAGED_CODE();
+
+    CurrentThread = PsGetCurrentThread();
+    requestorMode = KeGetPreviousModeByThread(&CurrentThread->Tcb);
+
+    if (NumberOfSegments == 0 || NumberOfSegments > IO_VECTOR_MAXIMUM_SEGMENTS) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    // Reference the file object.  Note that if the caller does not have the access the transfer needs, the operation will fail.
+    if (Write) {
+        status = ObReferenceFileObjectForWrite(FileHandle, requestorMode, (PVOID*)& fileObject, &handleInformation);
+    } else {
+        status = ObReferenceObjectByHandle(FileHandle, FILE_READ_DATA, IoFileObjectType, requestorMode, (PVOID*)& fileObject, NULL);
+        handleInformation.GrantedAccess = 0;
+    }
+
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    // The segments are transferred one after another at the file position, so the file must be open for synchronous I/O.
+    if (!(fileObject->Flags & FO_SYNCHRONOUS_IO)) {
+        ObDereferenceObject(fileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (NumberOfSegments > IOP_VECTOR_LOCAL_SEGMENTS) {
+        segments = ExAllocatePoolWithQuotaTag(PagedPool | POOL_QUOTA_FAIL_INSTEAD_OF_RAISE, NumberOfSegments * sizeof(FILE_IO_SEGMENT), 'vIoI');
+        if (segments == NULL) {
+            ObDereferenceObject(fileObject);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    // Capture the segment array and the other arguments, probing them if the caller is not in kernel mode.
+    // The segments are not locked here, the fast I/O and IRP paths take care of that; they are probed so that a kernel address cannot be passed.
+    exceptionCode = STATUS_SUCCESS;
+    try {
+        if (requestorMode != KernelMode) {
+            ProbeForWriteIoStatus(IoStatusBlock);
+            ProbeForRead(SegmentArray, NumberOfSegments * sizeof(FILE_IO_SEGMENT), TYPE_ALIGNMENT(FILE_IO_SEGMENT));
+        }
+
+        RtlCopyMemory(segments, SegmentArray, NumberOfSegments * sizeof(FILE_IO_SEGMENT));
+
+        for (i = 0; i < NumberOfSegments; i++) {
+            if (requestorMode != KernelMode) {
+                if (Write) {
+                    ProbeForRead(segments[i].Buffer, segments[i].Length, sizeof(UCHAR));
+                } else {
+                    ProbeForWrite(segments[i].Buffer, segments[i].Length, sizeof(UCHAR));
+                }
+            }
+
+            // The total must fit in the Information field of a single transfer.
+            if (totalLength + segments[i].Length < totalLength) {
+                ExRaiseStatus(STATUS_INVALID_PARAMETER);
+            }
+
+            totalLength += segments[i].Length;
+        }
+
+        if (ARGUMENT_PRESENT(ByteOffset)) {
+            if (requestorMode != KernelMode) {
+                ProbeForReadSmallStructure(ByteOffset, sizeof(LARGE_INTEGER), sizeof(ULONG));
+            }
+
+            fileOffset = *ByteOffset;
+        }
+
+        if (ARGUMENT_PRESENT(Key)) {
+            keyValue = (requestorMode != KernelMode) ? ProbeAndReadUlong(Key) : *Key;
+        }
+    } except(IopExceptionFilter(GetExceptionInformation(), &exceptionCode))
+    {
+        if (segments != localSegments) {
+            ExFreePool(segments);
+        }
+
+        ObDereferenceObject(fileObject);
+        return exceptionCode;
+    }
+
+    deviceObject = IoGetRelatedDeviceObject(fileObject);
+    fastIoDispatch = deviceObject->DriverObject->FastIoDispatch;
+
+    // Wait until the file is owned by the current thread, as NtReadFile and NtWriteFile do.
+    if (!IopAcquireFastLock(fileObject)) {
+        status = IopAcquireFileObjectLock(fileObject, requestorMode, (BOOLEAN)((fileObject->Flags & FO_ALERTABLE_IO) != 0), &interrupted);
+        if (interrupted) {
+            if (segments != localSegments) {
+                ExFreePool(segments);
+            }
+
+            ObDereferenceObject(fileObject);
+            return status;
+        }
+    }
+
+    // Determine where the transfer starts.  A write may instead append each segment in turn to the end of the file,
+    // which it must if the caller has only append access to the file, as in NtWriteFile.
+    if (Write && SeComputeGrantedAccesses(handleInformation.GrantedAccess, FILE_APPEND_DATA | FILE_WRITE_DATA) == FILE_APPEND_DATA) {
+        fileOffset.LowPart = FILE_WRITE_TO_END_OF_FILE;
+        fileOffset.HighPart = -1;
+    } else if (!ARGUMENT_PRESENT(ByteOffset) || (fileOffset.LowPart == FILE_USE_FILE_POINTER_POSITION && fileOffset.HighPart == -1)) {
+        fileOffset = fileObject->CurrentByteOffset;
+    }
+
+    appending = (BOOLEAN)(Write && fileOffset.LowPart == FILE_WRITE_TO_END_OF_FILE && fileOffset.HighPart == -1);
+
+    //  Negative file offsets are illegal.
+    if (fileOffset.HighPart < 0 && !appending) {
+        IopReleaseFileObjectLock(fileObject);
+        if (segments != localSegments) {
+            ExFreePool(segments);
+        }
+
+        ObDereferenceObject(fileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    // While the file is cached, copy the segments through fast I/O.
+    // Note if fast I/O returns FALSE or fails, the remaining segments go the "long way" below.
+    // Fast I/O moves the file position past each segment, which is where the long way continues from.
+    status = STATUS_SUCCESS;
+    i = 0;
+    while (i < NumberOfSegments && fileObject->PrivateCacheMap) {
+        if (segments[i].Length == 0) {
+            i += 1;
+            continue;
+        }
+
+        if (Write) {
+            ASSERT(fastIoDispatch && fastIoDispatch->FastIoWrite);
+            if (!fastIoDispatch->FastIoWrite(fileObject, &fileOffset, segments[i].Length, TRUE, keyValue, segments[i].Buffer, &localIoStatus, deviceObject) ||
+                localIoStatus.Status != STATUS_SUCCESS) {
+                break;
+            }
+
+            IopUpdateWriteOperationCount();
+            IopUpdateWriteTransferCount((ULONG)localIoStatus.Information);
+        } else {
+            ASSERT(fastIoDispatch && fastIoDispatch->FastIoRead);
+            if (!fastIoDispatch->FastIoRead(fileObject, &fileOffset, segments[i].Length, TRUE, keyValue, segments[i].Buffer, &localIoStatus, deviceObject) ||
+                ((localIoStatus.Status != STATUS_SUCCESS) && (localIoStatus.Status != STATUS_BUFFER_OVERFLOW) && (localIoStatus.Status != STATUS_END_OF_FILE))) {
+                break;
+            }
+
+            IopUpdateReadOperationCount();
+            IopUpdateReadTransferCount((ULONG)localIoStatus.Information);
+        }
+
+        positioned = TRUE;
+        information = (ULONG)localIoStatus.Information;
+        transferred += information;
+
+        // A short transfer means the end of the file was reached, so the rest of the segments are left untouched.
+        if (information < segments[i].Length) {
+            status = (transferred == 0) ? localIoStatus.Status : STATUS_SUCCESS;
+            done = TRUE;
+            break;
+        }
+
+        if (!appending) {
+            fileOffset.QuadPart += information;
+        }
+
+        i += 1;
+    }
+
+    if (positioned && !Write && IopCacheHitIncrement) {
+        KeBoostPriorityThread(&CurrentThread->Tcb, IopCacheHitIncrement);
+    }
+
+    IopReleaseFileObjectLock(fileObject);
+
+    // Issue the remaining segments as ordinary requests.
+    // Each one is written to the caller's I/O status block as it completes, and the totals are written once all are done.
+    // The first request starts at the caller's offset unless a segment has already been transferred, and the rest continue at the file position.
+    // Appending requests keep passing the caller's offset, so each goes to the end of the file.
+    while (!done && i < NumberOfSegments) {
+        if (segments[i].Length == 0) {
+            i += 1;
+            continue;
+        }
+
+        ObReferenceObject(fileObject);
+        if (Write) {
+            status = IopWriteFile(fileObject, handleInformation.GrantedAccess, IOP_NO_REGISTERED_BUFFER, NULL, NULL, NULL, IoStatusBlock,
+                                  segments[i].Buffer, segments[i].Length, (positioned && !appending) ? NULL : ByteOffset, Key);
+        } else {
+            status = IopReadFile(fileObject, IOP_NO_REGISTERED_BUFFER, NULL, NULL, NULL, IoStatusBlock,
+                                 segments[i].Buffer, segments[i].Length, (positioned && !appending) ? NULL : ByteOffset, Key);
+        }
+
+        // Stop at the first failure or short transfer.  A failure after part of the data was transferred is reported as a short transfer.
+        if (!NT_SUCCESS(status) || status == STATUS_END_OF_FILE) {
+            if (transferred != 0) {
+                status = STATUS_SUCCESS;
+            }
+
+            break;
+        }
+
+        try {
+            information = (ULONG)IoStatusBlock->Information;
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            information = 0;
+        }
+
+        positioned = TRUE;
+        transferred += information;
+        if (information < segments[i].Length) {
+            status = STATUS_SUCCESS;
+            break;
+        }
+
+        i += 1;
+    }
+
+    if (segments != localSegments) {
+        ExFreePool(segments);
+    }
+
+    ObDereferenceObject(fileObject);
+
+    // Carefully return the I/O status for the whole transfer.
+    try {
+        IoStatusBlock->Status = status;
+        IoStatusBlock->Information = transferred;
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        NOTHING;
+    }
+
+    return status;
+}
+
+
+NTSTATUS NtReadFileVector(
+    __in HANDLE FileHandle,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_ecount(NumberOfSegments) PFILE_IO_SEGMENT SegmentArray,
+    __in ULONG NumberOfSegments,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+)
+/*
+Routine Description:
+    This service reads data from the file associated with FileHandle starting at ByteOffset into the caller's buffer segments, in order,
+    filling each before moving to the next.  The segments may be of any length and alignment, except that a file opened without
+    intermediate buffering imposes the same requirements on each segment as NtReadFile does on its buffer.
+    If the end of the file is reached before all of the segments have been filled, then the operation terminates.
+    The total length of the data read from the file is returned in the second longword of the IoStatusBlock.
+Arguments:
+    FileHandle - Supplies a handle to the file to be read.  The file must be open for synchronous I/O.
+    IoStatusBlock - Address of the caller's I/O status block.
+    SegmentArray - Supplies the array of buffer segments to receive the data.
+    NumberOfSegments - Supplies the number of segments in the array, at most IO_VECTOR_MAXIMUM_SEGMENTS.
+    ByteOffset - Optionally specifies the starting byte offset within the file to begin the read operation.  If not specified, then the current file position is used.
+    Key - Optionally specifies a key to be used if there are locks associated with the file.
+Return Value:
+    The status of the operation.  If some of the data was read before a failure, the status is success and the second longword of the
+    IoStatusBlock tells how much was read.
+*/
+{
+    PAGED_CODE();
+
+    return IopReadWriteFileVector(FileHandle, IoStatusBlock, SegmentArray, NumberOfSegments, ByteOffset, Key, FALSE);
+}
+
+
+NTSTATUS NtWriteFileVector(
+    __in HANDLE FileHandle,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_ecount(NumberOfSegments) PFILE_IO_SEGMENT SegmentArray,
+    __in ULONG NumberOfSegments,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+)
+/*
+Routine Description:
+    This service writes the caller's buffer segments, in order, to the file associated with FileHandle starting at ByteOffset.
+    The segments may be of any length and alignment, except that a file opened without intermediate buffering imposes the same
+    requirements on each segment as NtWriteFile does on its buffer.
+    The total length of the data written to the file is returned in the second longword of the IoStatusBlock.
+Arguments:
+    FileHandle - Supplies a handle to the file to be written.  The file must be open for synchronous I/O.
+    IoStatusBlock - Address of the caller's I/O status block.
+    SegmentArray - Supplies the array of buffer segments holding the data.
+    NumberOfSegments - Supplies the number of segments in the array, at most IO_VECTOR_MAXIMUM_SEGMENTS.
+    ByteOffset - Optionally specifies the starting byte offset within the file to begin the write operation.
+        If not specified, then the current file position is used.  FILE_WRITE_TO_END_OF_FILE appends the segments to the file.
+    Key - Optionally specifies a key to be used if there are locks associated with the file.
+Return Value:
+    The status of the operation.  If some of the data was written before a failure, the status is success and the second longword
+    of the IoStatusBlock tells how much was written.
+*/
+{
+    PAGED_CODE();
+
+    return IopReadWriteFileVector(FileHandle, IoStatusBlock, SegmentArray, NumberOfSegments, ByteOffset, Key, TRUE);
+}
@@ -475,6 +475,10 @@ Arguments:
         ExFreePool(vpb);
     }
 
+    if (deviceObject->DeviceObjectExtension->FairShareQueue != NULL) {
+        ExFreePool(deviceObject->DeviceObjectExtension->FairShareQueue);
+    }
+
     if (deviceObject->DriverObject != NULL) {
         ObDereferenceObject(deviceObject->DriverObject);
     }
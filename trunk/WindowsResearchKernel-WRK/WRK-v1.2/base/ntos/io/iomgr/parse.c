@@ -648,7 +648,7 @@ reparse_loop:
     // Also fill in the NtCreateFile service's caller's parameters.
     irp->Overlay.AllocationSize = op->AllocationSize;
     irp->AssociatedIrp.SystemBuffer = op->EaBuffer;
-    irpSp->Parameters.Create.Options = (op->Disposition << 24) | (op->CreateOptions & 0x00ffffff);
+    irpSp->Parameters.Create.Options = (op->Disposition << 24) | (op->CreateOptions & 0x00ffffff & ~FILE_POSITIONAL_IO_ONLY);
     irpSp->Parameters.Create.FileAttributes = op->FileAttributes;
     irpSp->Parameters.Create.ShareAccess = op->ShareAccess;
     irpSp->Parameters.Create.SecurityContext = &securityContext;
@@ -695,6 +695,9 @@ reparse_loop:
             if (op->CreateOptions & FILE_SYNCHRONOUS_IO_ALERT) {
                 fileObject->Flags |= FO_ALERTABLE_IO;
             }
+            if (op->CreateOptions & FILE_POSITIONAL_IO_ONLY) {
+                fileObject->Flags |= FO_POSITIONAL_IO;
+            }
         }
 
         if (op->InternalFlags & (IOP_CREATE_USE_TOP_DEVICE_OBJECT_HINT | IOP_CREATE_IGNORE_SHARE_ACCESS_CHECK | IOP_CREATE_DEVICE_OBJECT_EXTENSION)) {
@@ -362,6 +362,16 @@ NTSTATUS NtQueryInformationFile(__in HANDLE FileHandle,
         // Complete the I/O operation.
         irp->IoStatus.Information = sizeof(FILE_MODE_INFORMATION);
         skipDriver = TRUE;
+    } else if (FileInformationClass == FileIoPriorityHintInformation) {
+        PFILE_IO_PRIORITY_HINT_INFORMATION priorityBuffer = irp->AssociatedIrp.SystemBuffer;
+        ULONG priority = IopFileObjectIoPriority(fileObject);
+
+        // Return the priority set on this handle, or normal priority if none was.
+        priorityBuffer->PriorityHint = (priority != 0) ? (IO_PRIORITY_HINT)(priority - 1) : IoPriorityNormal;
+
+        // Complete the I/O operation.
+        irp->IoStatus.Information = sizeof(FILE_IO_PRIORITY_HINT_INFORMATION);
+        skipDriver = TRUE;
     } else if (FileInformationClass == FileAlignmentInformation) {
         PFILE_ALIGNMENT_INFORMATION alignmentInformation = irp->AssociatedIrp.SystemBuffer;
         alignmentInformation->AlignmentRequirement = deviceObject->AlignmentRequirement;// Return the alignment information for this file.
@@ -784,6 +794,23 @@ Return Value:
             status = STATUS_SUCCESS;
         }
 
+        // Complete the I/O operation.
+        irp->IoStatus.Status = status;
+        irp->IoStatus.Information = 0L;
+    } else if (FileInformationClass == FileIoPriorityHintInformation) {
+        PFILE_IO_PRIORITY_HINT_INFORMATION priorityBuffer = irp->AssociatedIrp.SystemBuffer;
+
+        // Set the priority for all further requests made through this handle.
+        // Raising it above normal priority takes the same privilege as raising the priority of a thread.
+        if ((ULONG)priorityBuffer->PriorityHint >= MaxIoPriorityTypes) {
+            status = STATUS_INVALID_PARAMETER;
+        } else if (priorityBuffer->PriorityHint > IoPriorityNormal && !SeSinglePrivilegeCheck(SeIncreaseBasePriorityPrivilege, requestorMode)) {
+            status = STATUS_PRIVILEGE_NOT_HELD;
+        } else {
+            fileObject->Flags = (fileObject->Flags & ~FO_IO_PRIORITY_MASK) | (((ULONG)priorityBuffer->PriorityHint + 1) << FO_IO_PRIORITY_SHIFT);
+            status = STATUS_SUCCESS;
+        }
+
         // Complete the I/O operation.
         irp->IoStatus.Status = status;
         irp->IoStatus.Information = 0L;
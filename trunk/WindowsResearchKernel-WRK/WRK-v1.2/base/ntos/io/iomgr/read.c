@@ -8,7 +8,7 @@ Module Name:
     read.c
 
 Abstract:
-    This module contains the code to implement the NtReadFile system service.
+    This module contains the code to implement the NtReadFile and NtReadFileRegistered system services.
 */
 
 #include "iomgr.h"
@@ -19,41 +19,33 @@ Abstract:
 
 const KPRIORITY IopCacheHitIncrement = IO_NO_INCREMENT;
 
+#pragma alloc_text(PAGE, IopReadFile)
 #pragma alloc_text(PAGE, NtReadFile)
+#pragma alloc_text(PAGE, NtReadFileRegistered)
 #pragma alloc_text(PAGE, NtReadFileScatter)
 
 
-NTSTATUS NtReadFile(
-    __in HANDLE FileHandle,
-    __in_opt HANDLE Event,
-    __in_opt PIO_APC_ROUTINE ApcRoutine,
-    __in_opt PVOID ApcContext,
-    __out PIO_STATUS_BLOCK IoStatusBlock,
-    __out_bcount(Length) PVOID Buffer,
-    __in ULONG Length,
-    __in_opt PLARGE_INTEGER ByteOffset,
-    __in_opt PULONG Key
+NTSTATUS IopReadFile(
+    IN PFILE_OBJECT FileObject,
+    IN ULONG BufferIndex,
+    IN HANDLE Event OPTIONAL,
+    IN PIO_APC_ROUTINE ApcRoutine OPTIONAL,
+    IN PVOID ApcContext OPTIONAL,
+    OUT PIO_STATUS_BLOCK IoStatusBlock,
+    OUT PVOID Buffer,
+    IN ULONG Length,
+    IN PLARGE_INTEGER ByteOffset OPTIONAL,
+    IN PULONG Key OPTIONAL
 )
 /*
 Routine Description:
-    This service reads Length bytes of data from the file associated with FileHandle starting at ByteOffset and puts the data into the caller's Buffer.
-    If the end of the file is reached before Length bytes have been read, then the operation will terminate.
-    The actual length of the data read from the file will be returned in the second longword of the IoStatusBlock.
+    This routine performs the work of NtReadFile and NtReadFileRegistered once the file object has been referenced.
 Arguments:
-    FileHandle - Supplies a handle to the file to be read.
-    Event - Optionally supplies an event to be signaled when the read operation is complete.
-    ApcRoutine - Optionally supplies an APC routine to be executed when the read operation is complete.
-    ApcContext - Supplies a context parameter to be passed to the ApcRoutine, if an ApcRoutine was specified.
-    IoStatusBlock - Address of the caller's I/O status block.
-    Buffer - Address of buffer to receive the data read from the file.
-    Length - Supplies the length, in bytes, of the data to read from the file.
-    ByteOffset - Optionally specifies the starting byte offset within the file to begin the read operation.
-        If not specified and the file is open for synchronous I/O, then the current file position is used.
-        If the file is not opened for synchronous I/O and the parameter is not specified, then it is an error.
-    Key - Optionally specifies a key to be used if there are locks associated with the file.
+    FileObject - Supplies the referenced file object.  The reference is released by this routine or by I/O completion.
+    BufferIndex - Supplies the index of the registered buffer containing Buffer, or IOP_NO_REGISTERED_BUFFER.
+    The remaining arguments are those of NtReadFile.
 Return Value:
-    The status returned is success if the read operation was properly queued to the I/O system.
-    Once the read completes the status of the operation can be determined by examining the Status field of the I/O status block.
+    The status returned is the same as for NtReadFile.
 */
 {
     PIRP irp;
@@ -65,6 +57,9 @@ Return Value:
     PIO_STACK_LOCATION irpSp;
     NTSTATUS exceptionCode;
     BOOLEAN synchronousIo;
+    BOOLEAN positionalIo;
+    PKEVENT positionalEvent = (PKEVENT)NULL;
+    IO_STATUS_BLOCK positionalIoStatus;
     PKEVENT eventObject = (PKEVENT)NULL;
     ULONG keyValue = 0;
     LARGE_INTEGER fileOffset = {0,0};
@@ -76,12 +71,7 @@ Return Value:
     CurrentThread = PsGetCurrentThread();
     requestorMode = KeGetPreviousModeByThread(&CurrentThread->Tcb);// Get the previous mode;  i.e., the mode of the caller.
 
-    // Reference the file object so the target device can be found.  Note that if the caller does not have read access to the file, the operation will fail.
-    status = ObReferenceObjectByHandle(FileHandle, FILE_READ_DATA, IoFileObjectType, requestorMode, (PVOID*)& fileObject, NULL);
-    if (!NT_SUCCESS(status)) {
-        return status;
-    }
-
+    fileObject = FileObject;
     deviceObject = IoGetRelatedDeviceObject(fileObject);// Get the address of the target device object.
     if (requestorMode != KernelMode) {
         // The caller's access mode is not kernel so probe each of the arguments and capture them as necessary.
@@ -99,6 +89,12 @@ Return Value:
             // This check ensures that this is the case.
             // Since the buffer address is captured, the caller cannot change it, even though he/she can change the protection from another thread.
             // This error will be caught by the probe/lock or buffer copy operations later.
+            // A buffer that extends beyond the user address space is rejected directly rather than by raising an exception from the probe.
+            if (!ExIsUserAddressRange(Buffer, Length)) {
+                ObDereferenceObject(fileObject);
+                return STATUS_ACCESS_VIOLATION;
+            }
+
             ProbeForWrite(Buffer, Length, sizeof(UCHAR));
 
             // If this file has an I/O completion port associated w/it, then
@@ -198,9 +194,20 @@ Return Value:
 
     // Make a special check here to determine whether this is a synchronous I/O operation.
     // If it is, then wait here until the file is owned by the current thread.
+    // A positional only handle does not serialize a request at an explicit offset, which waits for itself on a private event.
+    positionalIo = IopIsPositionalIo(fileObject, ByteOffset, fileOffset, Event, ApcRoutine);
+    if (positionalIo) {
+        positionalEvent = ExAllocatePool(NonPagedPool, sizeof(KEVENT));
+        if (positionalEvent == NULL) {
+            ObDereferenceObject(fileObject);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        KeInitializeEvent(positionalEvent, SynchronizationEvent, FALSE);
+    }
+
     if (fileObject->Flags & FO_SYNCHRONOUS_IO) {
         BOOLEAN interrupted;
-        if (!IopAcquireFastLock(fileObject)) {
+        if (!positionalIo && !IopAcquireFastLock(fileObject)) {
             status = IopAcquireFileObjectLock(fileObject, requestorMode, (BOOLEAN)((fileObject->Flags & FO_ALERTABLE_IO) != 0), &interrupted);
             if (interrupted) {
                 if (eventObject) {
@@ -227,7 +234,11 @@ Return Value:
                 if (eventObject) {
                     ObDereferenceObject(eventObject);
                 }
-                IopReleaseFileObjectLock(fileObject);
+                if (positionalIo) {
+                    ExFreePool(positionalEvent);
+                } else {
+                    IopReleaseFileObjectLock(fileObject);
+                }
                 ObDereferenceObject(fileObject);
                 return STATUS_INVALID_PARAMETER;
             }
@@ -260,13 +271,17 @@ Return Value:
                 // Note that the file object event need not be set to the Signaled state, as it is already set.
 
                 // Cleanup and return.
-                IopReleaseFileObjectLock(fileObject);
+                if (positionalIo) {
+                    ExFreePool(positionalEvent);
+                } else {
+                    IopReleaseFileObjectLock(fileObject);
+                }
                 ObDereferenceObject(fileObject);
                 return localIoStatus.Status;
             }
         }
 
-        synchronousIo = TRUE;
+        synchronousIo = (BOOLEAN)!positionalIo;
     } else if (!ARGUMENT_PRESENT(ByteOffset) && !(fileObject->Flags & (FO_NAMED_PIPE | FO_MAILSLOT))) {
         // The file is not open for synchronous I/O operations, but the caller did not specify a ByteOffset parameter.
         if (eventObject) {
@@ -290,12 +305,17 @@ Return Value:
         return STATUS_INVALID_PARAMETER;
     }
 
-    KeClearEvent(&fileObject->Event);// Set the file object to the Not-Signaled state.
+    if (!positionalIo) {
+        KeClearEvent(&fileObject->Event);// Set the file object to the Not-Signaled state.
+    }
 
     // Allocate and initialize the I/O Request Packet (IRP) for this operation.
     // The allocation is performed with an exception handler in case the caller does not have enough quota to allocate the packet.
     irp = IopAllocateIrp(deviceObject->StackSize, !synchronousIo);
     if (!irp) {// An IRP could not be allocated.  Cleanup and return an appropriate error status code.
+        if (positionalEvent) {
+            ExFreePool(positionalEvent);
+        }
         IopAllocateIrpCleanup(fileObject, eventObject);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
@@ -310,6 +330,10 @@ Return Value:
     // Fill in the service independent parameters in the IRP.
     irp->UserEvent = eventObject;
     irp->UserIosb = IoStatusBlock;
+    if (positionalIo) {// The request is finished like a synchronous API on a handle opened for asynchronous I/O
+        irp->UserEvent = positionalEvent;
+        irp->UserIosb = &positionalIoStatus;
+    }
     irp->Overlay.AsynchronousParameters.UserApcRoutine = ApcRoutine;
     irp->Overlay.AsynchronousParameters.UserApcContext = ApcContext;
 
@@ -343,7 +367,7 @@ Return Value:
             {
                 // An exception was incurred while either probing the caller's buffer or allocating the system buffer.
                 // Determine what actually happened, clean everything up, and return an appropriate error status code.
-                IopExceptionCleanup(fileObject, irp, eventObject, (PKEVENT)NULL);
+                IopExceptionCleanup(fileObject, irp, eventObject, positionalEvent);
                 return GetExceptionCode();
             }
 
@@ -366,23 +390,35 @@ Return Value:
         irp->Flags = 0;
         if (Length) {
             try {
-                // Allocate an MDL, charging quota for it, and hang it off of the IRP.
+                // If the caller's buffer is registered, its pages are already locked and a partial MDL of them is used.
+                // Otherwise allocate an MDL, charging quota for it, and hang it off of the IRP.
                 // Probe and lock the pages associated with the caller's buffer for write access and fill in the MDL with the PFNs of those pages.
-                mdl = IoAllocateMdl(Buffer, Length, FALSE, TRUE, irp);
+                mdl = NULL;
+                if (IopIsRegisteredBufferCandidate(fileObject, requestorMode)) {
+                    mdl = IopAllocateRegisteredBufferMdl(Buffer, Length, BufferIndex, irp);
+                }
                 if (mdl == NULL) {
-                    ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+                    mdl = IoAllocateMdl(Buffer, Length, FALSE, TRUE, irp);
+                    if (mdl == NULL) {
+                        ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+                    }
+                    MmProbeAndLockPages(mdl, requestorMode, IoWriteAccess);
                 }
-                MmProbeAndLockPages(mdl, requestorMode, IoWriteAccess);
             } except(EXCEPTION_EXECUTE_HANDLER)
             {// An exception was incurred while either probing the caller's buffer or allocating the MDL.
 // Determine what actually happened, clean everything up, and return an appropriate error status code.
-                IopExceptionCleanup(fileObject, irp, eventObject, (PKEVENT)NULL);
+                IopExceptionCleanup(fileObject, irp, eventObject, positionalEvent);
                 return GetExceptionCode();
             }
         }
     } else {// Pass the address of the user's buffer so the driver has access to it.  It is now the driver's responsibility to do everything.
         irp->Flags = 0;
         irp->UserBuffer = Buffer;
+
+        // If the buffer is registered, also pass a partial MDL of its locked pages so the driver need not lock them itself.
+        if (Length && IopIsRegisteredBufferCandidate(fileObject, requestorMode)) {
+            (VOID)IopAllocateRegisteredBufferMdl(Buffer, Length, BufferIndex, irp);
+        }
     }
 
     // If this read operation is supposed to be performed with caching disabled set the disable flag in the IRP so no caching is performed.
@@ -398,11 +434,115 @@ Return Value:
     irpSp->Parameters.Read.ByteOffset = fileOffset;
 
     // Queue the packet, call the driver, and synchronize appropriately with I/O completion.
+    if (positionalIo) {
+        irp->Flags |= IRP_SYNCHRONOUS_API;
+    }
+
     status = IopSynchronousServiceTail(deviceObject, irp, fileObject, TRUE, requestorMode, synchronousIo, ReadTransfer);
+    if (positionalIo) {
+        status = IopSynchronousApiServiceTail(status, positionalEvent, irp, requestorMode, &positionalIoStatus, IoStatusBlock);
+    }
     return status;
 }
 
 
+NTSTATUS NtReadFile(
+    __in HANDLE FileHandle,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __out_bcount(Length) PVOID Buffer,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+)
+/*
+Routine Description:
+    This service reads Length bytes of data from the file associated with FileHandle starting at ByteOffset and puts the data into the caller's Buffer.
+    If the end of the file is reached before Length bytes have been read, then the operation will terminate.
+    The actual length of the data read from the file will be returned in the second longword of the IoStatusBlock.
+Arguments:
+    FileHandle - Supplies a handle to the file to be read.
+    Event - Optionally supplies an event to be signaled when the read operation is complete.
+    ApcRoutine - Optionally supplies an APC routine to be executed when the read operation is complete.
+    ApcContext - Supplies a context parameter to be passed to the ApcRoutine, if an ApcRoutine was specified.
+    IoStatusBlock - Address of the caller's I/O status block.
+    Buffer - Address of buffer to receive the data read from the file.
+    Length - Supplies the length, in bytes, of the data to read from the file.
+    ByteOffset - Optionally specifies the starting byte offset within the file to begin the read operation.
+        If not specified and the file is open for synchronous I/O, then the current file position is used.
+        If the file is not opened for synchronous I/O and the parameter is not specified, then it is an error.
+    Key - Optionally specifies a key to be used if there are locks associated with the file.
+Return Value:
+    The status returned is success if the read operation was properly queued to the I/O system.
+    Once the read completes the status of the operation can be determined by examining the Status field of the I/O status block.
+*/
+{
+    NTSTATUS status;
+    PFILE_OBJECT fileObject;
+
+    PAGED_CODE();
+
+    // Reference the file object so the target device can be found.  Note that if the caller does not have read access to the file, the operation will fail.
+    status = ObReferenceObjectByHandle(FileHandle, FILE_READ_DATA, IoFileObjectType, KeGetPreviousMode(), (PVOID*)& fileObject, NULL);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    return IopReadFile(fileObject, IOP_NO_REGISTERED_BUFFER, Event, ApcRoutine, ApcContext, IoStatusBlock, Buffer, Length, ByteOffset, Key);
+}
+
+
+NTSTATUS NtReadFileRegistered(
+    __in ULONG FileIndex,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in ULONG BufferIndex,
+    __in ULONG BufferOffset,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+)
+/*
+Routine Description:
+    This service is the same as NtReadFile, except that the file and the buffer are named by the indexes returned when they were
+    registered with NtRegisterIoHandle and NtRegisterIoBuffer.  No handle lookup is made, and if the file was opened for unbuffered I/O
+    the registered buffer's locked pages are used without being probed and locked again.
+Arguments:
+    FileIndex - Supplies the index of the registered file to be read.  The handle it was registered from must have had read access.
+    BufferIndex - Supplies the index of the registered buffer to receive the data.
+    BufferOffset - Supplies the offset within the registered buffer at which to place the data.
+    The remaining arguments are those of NtReadFile.
+Return Value:
+    The status returned is the same as for NtReadFile.
+    STATUS_INVALID_HANDLE is returned if no file is registered at FileIndex, and STATUS_INVALID_PARAMETER if the range is not
+    within the registered buffer.
+*/
+{
+    NTSTATUS status;
+    PFILE_OBJECT fileObject;
+    PVOID buffer;
+
+    PAGED_CODE();
+
+    status = IopReferenceRegisteredFile(FileIndex, FALSE, &fileObject, NULL);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    buffer = IopGetRegisteredBufferAddress(BufferIndex, BufferOffset, Length);
+    if (buffer == NULL) {
+        ObDereferenceObject(fileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return IopReadFile(fileObject, BufferIndex, Event, ApcRoutine, ApcContext, IoStatusBlock, buffer, Length, ByteOffset, Key);
+}
+
+
 NTSTATUS NtReadFileScatter(
     __in HANDLE FileHandle,
     __in_opt HANDLE Event,
@@ -0,0 +1,710 @@
+/*
+Copyright (c) Microsoft Corporation. All rights reserved.
+
+You may only use this code if you agree to the terms of the Windows Research Kernel Source Code License agreement (see License.txt).
+If you do not agree to the terms, do not use the code.
+
+Module Name:
+    regbuf.c
+
+Abstract:
+    This module contains the code to implement the NtRegisterIoBuffer, NtUnregisterIoBuffer, NtRegisterIoHandle and NtUnregisterIoHandle
+    system services for the NT I/O system.
+
+    A process which repeatedly performs unbuffered I/O from the same buffers may register them.
+    The pages of a registered buffer are probed and locked once, and its address range is secured so it cannot be freed or
+    have its protection changed.  Reads and writes on handles opened for unbuffered I/O whose buffer lies within a registered
+    buffer are then given a partial MDL built from the locked one, instead of probing and locking the caller's pages again.
+
+    A process may also register file handles.  The file object is referenced once, and NtReadFileRegistered and NtWriteFileRegistered
+    name the file and the buffer by the indexes returned at registration, so the hot path makes no handle table lookup and no search
+    for the buffer.  The indexes are kept in a table hung off the process, protected by IopRegisteredBufferLock.
+*/
+
+#include "iomgr.h"
+
+#pragma alloc_text(PAGE, NtRegisterIoBuffer)
+#pragma alloc_text(PAGE, NtUnregisterIoBuffer)
+#pragma alloc_text(PAGE, IoRundownRegisteredBuffers)
+#pragma alloc_text(PAGE, IopGetIoRegistration)
+#pragma alloc_text(PAGE, NtRegisterIoHandle)
+#pragma alloc_text(PAGE, NtUnregisterIoHandle)
+#pragma alloc_text(PAGE, IopReferenceRegisteredFile)
+
+
+PIOP_REGISTERED_BUFFER IopFindRegisteredBuffer(IN PEPROCESS Process, IN PVOID Buffer, IN ULONG Length)
+/*
+Routine Description:
+    This routine looks up the registered buffer of the specified process which contains the specified range.
+Arguments:
+    Process - Supplies the process which registered the buffer.
+    Buffer - Supplies the start of the range.
+    Length - Supplies the length of the range.
+Return Value:
+    The registered buffer containing the range, or NULL if there is none.
+Environment:
+    The IopRegisteredBufferLock must be held.
+*/
+{
+    PLIST_ENTRY Entry;
+    PIOP_REGISTERED_BUFFER Registration;
+
+    for (Entry = IopRegisteredBufferListHead.Flink; Entry != &IopRegisteredBufferListHead; Entry = Entry->Flink) {
+        Registration = CONTAINING_RECORD(Entry, IOP_REGISTERED_BUFFER, Links);
+        if ((Registration->Process == Process) &&
+            ((PCHAR)Buffer >= Registration->Base) &&
+            (((ULONG_PTR)Buffer - (ULONG_PTR)Registration->Base) + Length <= Registration->Length)) {
+            return Registration;
+        }
+    }
+
+    return NULL;
+}
+
+
+VOID IopFreeRegisteredBuffer(IN PIOP_REGISTERED_BUFFER Registration)
+/*
+Routine Description:
+    This routine unlocks the pages of a registered buffer which has been removed from the list, and frees it.
+    The address range must already have been unsecured.
+Arguments:
+    Registration - Supplies the registered buffer to free.
+*/
+{
+    ASSERT(Registration->ActiveCount == 0);
+    ASSERT(Registration->SecureHandle == NULL);
+
+    MmUnlockPages(Registration->Mdl);
+    IoFreeMdl(Registration->Mdl);
+    ExFreePool(Registration);
+}
+
+
+VOID IopClearRegisteredBufferIndex(IN PIOP_IO_REGISTRATION Registrations, IN PIOP_REGISTERED_BUFFER Registration)
+/*
+Routine Description:
+    This routine frees the index of a registered buffer which is being unregistered.
+Arguments:
+    Registrations - Supplies the registration table of the process which registered the buffer.
+    Registration - Supplies the registered buffer.
+Environment:
+    The IopRegisteredBufferLock must be held.
+*/
+{
+    ULONG Index;
+
+    if (Registrations == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < IOP_MAXIMUM_REGISTERED_BUFFERS; Index += 1) {
+        if (Registrations->Buffers[Index] == Registration) {
+            Registrations->Buffers[Index] = NULL;
+            return;
+        }
+    }
+}
+
+
+PIOP_IO_REGISTRATION IopGetIoRegistration(IN PEPROCESS Process)
+/*
+Routine Description:
+    This routine returns the registration table of the specified process, allocating it on first use.
+Arguments:
+    Process - Supplies the current process.
+Return Value:
+    The registration table, or NULL if it could not be allocated.
+*/
+{
+    PIOP_IO_REGISTRATION Registrations;
+    PIOP_IO_REGISTRATION OldRegistrations;
+
+    PAGED_CODE();
+
+    Registrations = Process->IoRegistrations;
+    if (Registrations != NULL) {
+        return Registrations;
+    }
+
+    Registrations = ExAllocatePoolWithQuotaTag(NonPagedPool | POOL_QUOTA_FAIL_INSTEAD_OF_RAISE, sizeof(IOP_IO_REGISTRATION), 'tRoI');
+    if (Registrations == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory(Registrations, sizeof(IOP_IO_REGISTRATION));
+
+    // Another thread of the process may have raced us here.
+    OldRegistrations = InterlockedCompareExchangePointer(&Process->IoRegistrations, Registrations, NULL);
+    if (OldRegistrations != NULL) {
+        ExFreePool(Registrations);
+        Registrations = OldRegistrations;
+    }
+
+    return Registrations;
+}
+
+
+NTSTATUS NtRegisterIoBuffer(__in_bcount(Length) PVOID Buffer, __in ULONG Length, __out_opt PULONG BufferIndex)
+/*
+Routine Description:
+    This service registers a buffer of the current process for unbuffered I/O.
+    The pages of the buffer are locked in memory until it is unregistered or the process exits,
+    so the caller must hold SeLockMemoryPrivilege.
+    The buffer must be writable, since it may be the target of reads.
+Arguments:
+    Buffer - Supplies the address of the buffer.
+    Length - Supplies the length of the buffer in bytes.
+    BufferIndex - Optionally receives the index naming the buffer to NtReadFileRegistered and NtWriteFileRegistered.
+Return Value:
+    The status returned is the final completion status of the operation.
+    STATUS_CONFLICTING_ADDRESSES is returned if the buffer overlaps one already registered,
+    and STATUS_QUOTA_EXCEEDED if the process already has IOP_MAXIMUM_REGISTERED_BUFFERS registered.
+*/
+{
+    KPROCESSOR_MODE PreviousMode;
+    PIOP_REGISTERED_BUFFER Registration;
+    PMDL Mdl = NULL;
+    HANDLE SecureHandle = NULL;
+    PIOP_IO_REGISTRATION Registrations;
+    PLIST_ENTRY Entry;
+    PIOP_REGISTERED_BUFFER Other;
+    ULONG Index;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    PreviousMode = KeGetPreviousMode();
+    if ((Length == 0) || ((ULONG_PTR)Buffer + Length < (ULONG_PTR)Buffer)) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (!SeSinglePrivilegeCheck(SeLockMemoryPrivilege, PreviousMode)) {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    if (ARGUMENT_PRESENT(BufferIndex) && (PreviousMode != KernelMode)) {
+        try {
+            ProbeForWriteUlong(BufferIndex);
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            return GetExceptionCode();
+        }
+    }
+
+    Registrations = IopGetIoRegistration(PsGetCurrentProcess());
+    if (Registrations == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Registration = ExAllocatePoolWithQuotaTag(NonPagedPool | POOL_QUOTA_FAIL_INSTEAD_OF_RAISE, sizeof(IOP_REGISTERED_BUFFER), 'bRoI');
+    if (Registration == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    // Secure the range so it cannot be freed or reprotected while it is registered, then lock its pages.
+    try {
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(Buffer, Length, sizeof(UCHAR));
+        }
+
+        SecureHandle = MmSecureVirtualMemory(Buffer, Length, PAGE_READWRITE);
+        if (SecureHandle == NULL) {
+            ExRaiseStatus(STATUS_INVALID_USER_BUFFER);
+        }
+
+        Mdl = IoAllocateMdl(Buffer, Length, FALSE, FALSE, NULL);
+        if (Mdl == NULL) {
+            ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+        }
+
+        MmProbeAndLockPages(Mdl, PreviousMode, IoWriteAccess);
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        if (Mdl != NULL) {
+            IoFreeMdl(Mdl);
+        }
+
+        if (SecureHandle != NULL) {
+            MmUnsecureVirtualMemory(SecureHandle);
+        }
+
+        ExFreePool(Registration);
+        return GetExceptionCode();
+    }
+
+    Registration->Process = PsGetCurrentProcess();
+    Registration->Base = (PCHAR)Buffer;
+    Registration->Length = Length;
+    Registration->ActiveCount = 0;
+    Registration->Deleted = FALSE;
+    Registration->SecureHandle = SecureHandle;
+    Registration->Mdl = Mdl;
+
+    // Insert the buffer unless it overlaps another registration or the process has no free index.
+    Status = STATUS_SUCCESS;
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    for (Entry = IopRegisteredBufferListHead.Flink; Entry != &IopRegisteredBufferListHead; Entry = Entry->Flink) {
+        Other = CONTAINING_RECORD(Entry, IOP_REGISTERED_BUFFER, Links);
+        if ((Other->Process == Registration->Process) && !Other->Deleted &&
+            (Registration->Base < Other->Base + Other->Length) && (Other->Base < Registration->Base + Registration->Length)) {
+            Status = STATUS_CONFLICTING_ADDRESSES;
+            break;
+        }
+    }
+
+    for (Index = 0; Index < IOP_MAXIMUM_REGISTERED_BUFFERS; Index += 1) {
+        if (Registrations->Buffers[Index] == NULL) {
+            break;
+        }
+    }
+
+    if (NT_SUCCESS(Status) && (Index == IOP_MAXIMUM_REGISTERED_BUFFERS)) {
+        Status = STATUS_QUOTA_EXCEEDED;
+    }
+
+    if (NT_SUCCESS(Status)) {
+        InsertTailList(&IopRegisteredBufferListHead, &Registration->Links);
+        InterlockedIncrement(&IopRegisteredBufferCount);
+        Registrations->Buffers[Index] = Registration;
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (!NT_SUCCESS(Status)) {
+        MmUnsecureVirtualMemory(SecureHandle);
+        Registration->SecureHandle = NULL;
+        IopFreeRegisteredBuffer(Registration);
+        return Status;
+    }
+
+    // The buffer stays registered if the index cannot be returned; it can still be unregistered by address.
+    if (ARGUMENT_PRESENT(BufferIndex)) {
+        try {
+            *BufferIndex = Index;
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Status = GetExceptionCode();
+        }
+    }
+
+    return Status;
+}
+
+
+NTSTATUS NtUnregisterIoBuffer(__in PVOID Buffer)
+/*
+Routine Description:
+    This service unregisters a buffer registered by the current process with NtRegisterIoBuffer, unlocking its pages.
+Arguments:
+    Buffer - Supplies the address the buffer was registered with.
+Return Value:
+    STATUS_SUCCESS, STATUS_NOT_FOUND if no buffer is registered at that address,
+    or STATUS_DEVICE_BUSY if I/O using the buffer is still outstanding.
+*/
+{
+    PIOP_REGISTERED_BUFFER Registration;
+    KIRQL OldIrql;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    PAGED_CODE();
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Registration = IopFindRegisteredBuffer(PsGetCurrentProcess(), Buffer, 1);
+    if ((Registration == NULL) || Registration->Deleted || (Registration->Base != (PCHAR)Buffer)) {
+        Status = STATUS_NOT_FOUND;
+    } else if (Registration->ActiveCount != 0) {
+        Status = STATUS_DEVICE_BUSY;
+    } else {
+        RemoveEntryList(&Registration->Links);
+        InterlockedDecrement(&IopRegisteredBufferCount);
+        IopClearRegisteredBufferIndex(PsGetCurrentProcess()->IoRegistrations, Registration);
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (NT_SUCCESS(Status)) {
+        MmUnsecureVirtualMemory(Registration->SecureHandle);
+        Registration->SecureHandle = NULL;
+        IopFreeRegisteredBuffer(Registration);
+    }
+
+    return Status;
+}
+
+
+PMDL IopAllocateRegisteredBufferMdl(IN PVOID Buffer, IN ULONG Length, IN ULONG BufferIndex, IN PIRP Irp)
+/*
+Routine Description:
+    This routine is called by the read and write services for unbuffered handles.
+    If the caller's buffer lies within a buffer registered by the current process, a partial MDL describing it is
+    built from the registered buffer's locked MDL and attached to the IRP, and the IRP is marked so that completion
+    releases the partial MDL instead of unlocking its pages.
+Arguments:
+    Buffer - Supplies the caller's buffer.
+    Length - Supplies the length of the transfer.
+    BufferIndex - Supplies the index of the registered buffer given by the caller, or IOP_NO_REGISTERED_BUFFER to search for it.
+    Irp - Supplies the IRP for the transfer.
+Return Value:
+    The partial MDL, or NULL if the buffer is not registered and must be probed and locked as usual.
+*/
+{
+    PIOP_IO_REGISTRATION Registrations;
+    PIOP_REGISTERED_BUFFER Registration;
+    PMDL Mdl;
+    KIRQL OldIrql;
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Registrations = PsGetCurrentProcess()->IoRegistrations;
+    if ((BufferIndex < IOP_MAXIMUM_REGISTERED_BUFFERS) && (Registrations != NULL)) {
+        Registration = Registrations->Buffers[BufferIndex];
+        if ((Registration != NULL) &&
+            (((PCHAR)Buffer < Registration->Base) ||
+             (((ULONG_PTR)Buffer - (ULONG_PTR)Registration->Base) + Length > Registration->Length))) {
+            Registration = NULL;
+        }
+    } else {
+        Registration = IopFindRegisteredBuffer(PsGetCurrentProcess(), Buffer, Length);
+    }
+
+    if ((Registration != NULL) && !Registration->Deleted) {
+        Registration->ActiveCount += 1;
+    } else {
+        Registration = NULL;
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (Registration == NULL) {
+        return NULL;
+    }
+
+    Mdl = IoAllocateMdl(Buffer, Length, FALSE, TRUE, Irp);
+    if (Mdl == NULL) {
+        ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+        Registration->ActiveCount -= 1;
+        ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+        return NULL;
+    }
+
+    IoBuildPartialMdl(Registration->Mdl, Mdl, Buffer, Length);
+    Irp->Flags |= IRP_REGISTERED_BUFFER;
+    return Mdl;
+}
+
+
+VOID IopReleaseRegisteredBufferMdl(IN PMDL Mdl)
+/*
+Routine Description:
+    This routine is called when an IRP using a registered buffer completes, in place of unlocking the pages of its partial MDL.
+    If the buffer was run down by process exit while the I/O was outstanding, its pages are unlocked now.
+Arguments:
+    Mdl - Supplies the partial MDL built by IopAllocateRegisteredBufferMdl.  The caller frees it.
+Environment:
+    IRQL <= DISPATCH_LEVEL.
+*/
+{
+    PIOP_REGISTERED_BUFFER Registration;
+    PIOP_REGISTERED_BUFFER RegistrationToFree = NULL;
+    KIRQL OldIrql;
+
+    ASSERT(Mdl->MdlFlags & MDL_PARTIAL);
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Registration = IopFindRegisteredBuffer(Mdl->Process, MmGetMdlVirtualAddress(Mdl), MmGetMdlByteCount(Mdl));
+    ASSERT((Registration != NULL) && (Registration->ActiveCount != 0));
+    Registration->ActiveCount -= 1;
+    if ((Registration->ActiveCount == 0) && Registration->Deleted) {
+        RemoveEntryList(&Registration->Links);
+        InterlockedDecrement(&IopRegisteredBufferCount);
+        RegistrationToFree = Registration;
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (RegistrationToFree != NULL) {
+        IopFreeRegisteredBuffer(RegistrationToFree);
+    }
+}
+
+
+VOID IoRundownRegisteredBuffers(IN PEPROCESS Process)
+/*
+Routine Description:
+    This routine is called when the last thread of a process exits, before its address space is cleaned,
+    to unregister all of the buffers it registered.
+    A buffer with I/O still outstanding is unsecured now and freed when the last of that I/O completes.
+    The registered file objects are dereferenced and the registration table is freed.
+Arguments:
+    Process - Supplies the exiting process, which must be the current process.
+*/
+{
+    PIOP_IO_REGISTRATION Registrations;
+    PLIST_ENTRY Entry;
+    PIOP_REGISTERED_BUFFER Registration;
+    HANDLE SecureHandle;
+    LOGICAL Free;
+    ULONG Index;
+    KIRQL OldIrql;
+
+    PAGED_CODE();
+
+    ASSERT(Process == PsGetCurrentProcess());
+
+    Registrations = Process->IoRegistrations;
+    if (Registrations == NULL) {
+        return;
+    }
+
+    // Detach the table so no further lookups can find it.  The lock orders this against lookups already in progress.
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Process->IoRegistrations = NULL;
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    for (Index = 0; Index < IOP_MAXIMUM_REGISTERED_FILES; Index += 1) {
+        if (Registrations->Files[Index].FileObject != NULL) {
+            ObDereferenceObject(Registrations->Files[Index].FileObject);
+        }
+    }
+
+    ExFreePool(Registrations);
+
+    while (IopRegisteredBufferCount != 0) {
+        Registration = NULL;
+        Free = FALSE;
+
+        ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+        for (Entry = IopRegisteredBufferListHead.Flink; Entry != &IopRegisteredBufferListHead; Entry = Entry->Flink) {
+            Registration = CONTAINING_RECORD(Entry, IOP_REGISTERED_BUFFER, Links);
+            if ((Registration->Process == Process) && !Registration->Deleted) {
+                break;
+            }
+
+            Registration = NULL;
+        }
+
+        if (Registration != NULL) {
+            if (Registration->ActiveCount == 0) {
+                RemoveEntryList(&Registration->Links);
+                InterlockedDecrement(&IopRegisteredBufferCount);
+                Free = TRUE;
+            } else {
+                Registration->Deleted = TRUE;
+            }
+
+            SecureHandle = Registration->SecureHandle;
+            Registration->SecureHandle = NULL;
+        }
+        ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+        if (Registration == NULL) {
+            break;
+        }
+
+        MmUnsecureVirtualMemory(SecureHandle);
+        if (Free) {
+            IopFreeRegisteredBuffer(Registration);
+        }
+    }
+}
+
+
+PVOID IopGetRegisteredBufferAddress(IN ULONG BufferIndex, IN ULONG BufferOffset, IN ULONG Length)
+/*
+Routine Description:
+    This routine translates an offset within a registered buffer of the current process to an address.
+Arguments:
+    BufferIndex - Supplies the index returned by NtRegisterIoBuffer.
+    BufferOffset - Supplies the offset of the range within the buffer.
+    Length - Supplies the length of the range.
+Return Value:
+    The address of the range, or NULL if the index does not name a registered buffer or the range is not within it.
+*/
+{
+    PIOP_IO_REGISTRATION Registrations;
+    PIOP_REGISTERED_BUFFER Registration;
+    PVOID Buffer = NULL;
+    KIRQL OldIrql;
+
+    if (BufferIndex >= IOP_MAXIMUM_REGISTERED_BUFFERS) {
+        return NULL;
+    }
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Registrations = PsGetCurrentProcess()->IoRegistrations;
+    if (Registrations != NULL) {
+        Registration = Registrations->Buffers[BufferIndex];
+        if ((Registration != NULL) && (BufferOffset <= Registration->Length) && (Length <= Registration->Length - BufferOffset)) {
+            Buffer = Registration->Base + BufferOffset;
+        }
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    return Buffer;
+}
+
+
+NTSTATUS NtRegisterIoHandle(__in HANDLE FileHandle, __out PULONG FileIndex)
+/*
+Routine Description:
+    This service registers a file handle of the current process so that NtReadFileRegistered and NtWriteFileRegistered can name the file
+    by an index rather than a handle.  The file object is referenced until it is unregistered or the process exits; closing the handle
+    does not unregister it, although the file system will fail I/O on it once the last handle has been closed.
+Arguments:
+    FileHandle - Supplies a handle to the file.  The access granted to it is checked by each I/O using the index.
+    FileIndex - Receives the index naming the file.
+Return Value:
+    The status returned is the final completion status of the operation.
+    STATUS_QUOTA_EXCEEDED is returned if the process already has IOP_MAXIMUM_REGISTERED_FILES registered.
+*/
+{
+    KPROCESSOR_MODE PreviousMode;
+    PIOP_IO_REGISTRATION Registrations;
+    PFILE_OBJECT FileObject;
+    OBJECT_HANDLE_INFORMATION HandleInformation;
+    ULONG Index;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    PreviousMode = KeGetPreviousMode();
+    if (PreviousMode != KernelMode) {
+        try {
+            ProbeForWriteUlong(FileIndex);
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            return GetExceptionCode();
+        }
+    }
+
+    Registrations = IopGetIoRegistration(PsGetCurrentProcess());
+    if (Registrations == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Status = ObReferenceObjectByHandle(FileHandle, 0, IoFileObjectType, PreviousMode, (PVOID*)&FileObject, &HandleInformation);
+    if (!NT_SUCCESS(Status)) {
+        return Status;
+    }
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    for (Index = 0; Index < IOP_MAXIMUM_REGISTERED_FILES; Index += 1) {
+        if (Registrations->Files[Index].FileObject == NULL) {
+            Registrations->Files[Index].FileObject = FileObject;
+            Registrations->Files[Index].GrantedAccess = HandleInformation.GrantedAccess;
+            break;
+        }
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (Index == IOP_MAXIMUM_REGISTERED_FILES) {
+        ObDereferenceObject(FileObject);
+        return STATUS_QUOTA_EXCEEDED;
+    }
+
+    // The file stays registered if the index cannot be returned; it is released when the process exits.
+    try {
+        *FileIndex = Index;
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        return GetExceptionCode();
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS NtUnregisterIoHandle(__in ULONG FileIndex)
+/*
+Routine Description:
+    This service unregisters a file registered by the current process with NtRegisterIoHandle, releasing its reference to the file object.
+    I/O already issued through the index is not affected.
+Arguments:
+    FileIndex - Supplies the index returned by NtRegisterIoHandle.
+Return Value:
+    STATUS_SUCCESS, or STATUS_INVALID_HANDLE if no file is registered at that index.
+*/
+{
+    PIOP_IO_REGISTRATION Registrations;
+    PFILE_OBJECT FileObject = NULL;
+    KIRQL OldIrql;
+
+    PAGED_CODE();
+
+    if (FileIndex >= IOP_MAXIMUM_REGISTERED_FILES) {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Registrations = PsGetCurrentProcess()->IoRegistrations;
+    if (Registrations != NULL) {
+        FileObject = Registrations->Files[FileIndex].FileObject;
+        Registrations->Files[FileIndex].FileObject = NULL;
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (FileObject == NULL) {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    ObDereferenceObject(FileObject);
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS IopReferenceRegisteredFile(IN ULONG FileIndex, IN BOOLEAN ForWrite, OUT PFILE_OBJECT* FileObject, OUT PACCESS_MASK GrantedAccess OPTIONAL)
+/*
+Routine Description:
+    This routine references the file object registered by the current process at the specified index, in place of ObReferenceObjectByHandle.
+    The access granted to the handle it was registered from is checked the same way the handle would have been.
+Arguments:
+    FileIndex - Supplies the index returned by NtRegisterIoHandle.
+    ForWrite - Supplies TRUE to require write or append access, as ObReferenceFileObjectForWrite does, or FALSE to require read access.
+    FileObject - Receives the referenced file object.
+    GrantedAccess - Optionally receives the access granted to the handle.
+Return Value:
+    STATUS_SUCCESS, STATUS_INVALID_HANDLE if no file is registered at the index, or STATUS_ACCESS_DENIED.
+*/
+{
+    PIOP_IO_REGISTRATION Registrations;
+    PFILE_OBJECT fileObject = NULL;
+    ACCESS_MASK grantedAccess = 0;
+    ACCESS_MASK desiredAccess;
+    KIRQL OldIrql;
+
+    PAGED_CODE();
+
+    if (FileIndex >= IOP_MAXIMUM_REGISTERED_FILES) {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    ExAcquireSpinLock(&IopRegisteredBufferLock, &OldIrql);
+    Registrations = PsGetCurrentProcess()->IoRegistrations;
+    if (Registrations != NULL) {
+        fileObject = Registrations->Files[FileIndex].FileObject;
+        if (fileObject != NULL) {
+            grantedAccess = Registrations->Files[FileIndex].GrantedAccess;
+            ObReferenceObject(fileObject);
+        }
+    }
+    ExReleaseSpinLock(&IopRegisteredBufferLock, OldIrql);
+
+    if (fileObject == NULL) {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (ForWrite) {
+        (VOID)IoComputeDesiredAccessFileObject(fileObject, (PNTSTATUS)&desiredAccess);
+    } else {
+        desiredAccess = FILE_READ_DATA;
+    }
+
+    if (!SeComputeGrantedAccesses(grantedAccess, desiredAccess)) {
+        ObDereferenceObject(fileObject);
+        return STATUS_ACCESS_DENIED;
+    }
+
+    *FileObject = fileObject;
+    if (ARGUMENT_PRESENT(GrantedAccess)) {
+        *GrantedAccess = grantedAccess;
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -8,48 +8,40 @@ Module Name:
     write.c
 
 Abstract:
-    This module contains the code to implement the NtWriteFile system service.
+    This module contains the code to implement the NtWriteFile and NtWriteFileRegistered system services.
 */
 
 #include "iomgr.h"
 
+#pragma alloc_text(PAGE, IopWriteFile)
 #pragma alloc_text(PAGE, NtWriteFile)
+#pragma alloc_text(PAGE, NtWriteFileRegistered)
 #pragma alloc_text(PAGE, NtWriteFileGather)
 
 
-NTSTATUS NtWriteFile(
-    __in HANDLE FileHandle,
-    __in_opt HANDLE Event,
-    __in_opt PIO_APC_ROUTINE ApcRoutine,
-    __in_opt PVOID ApcContext,
-    __out PIO_STATUS_BLOCK IoStatusBlock,
-    __in_bcount(Length) PVOID Buffer,
-    __in ULONG Length,
-    __in_opt PLARGE_INTEGER ByteOffset,
-    __in_opt PULONG Key
+NTSTATUS IopWriteFile(
+    IN PFILE_OBJECT FileObject,
+    IN ACCESS_MASK GrantedAccess,
+    IN ULONG BufferIndex,
+    IN HANDLE Event OPTIONAL,
+    IN PIO_APC_ROUTINE ApcRoutine OPTIONAL,
+    IN PVOID ApcContext OPTIONAL,
+    OUT PIO_STATUS_BLOCK IoStatusBlock,
+    IN PVOID Buffer,
+    IN ULONG Length,
+    IN PLARGE_INTEGER ByteOffset OPTIONAL,
+    IN PULONG Key OPTIONAL
 )
 /*
 Routine Description:
-    This service writes Length bytes of data from the caller's Buffer to the file associated with FileHandle starting at StartingBlock|ByteOffset.
-    The actual number of bytes written to the file will be returned in the second longword of the IoStatusBlock.
-
-    If the writer has the file open for APPEND access, then the data will be written to the current EOF mark.
-    The StartingBlock and ByteOffset are ignored if the caller has APPEND access.
+    This routine performs the work of NtWriteFile and NtWriteFileRegistered once the file object has been referenced for write.
 Arguments:
-    FileHandle - Supplies a handle to the file to be written.
-    Event - Optionally supplies an event to be set to the Signaled state when the write operation is complete.
-    ApcRoutine - Optionally supplies an APC routine to be executed when the write operation is complete.
-    ApcContext - Supplies a context parameter to be passed to the APC routine when it is invoked, if an APC routine was specified.
-    IoStatusBlock - Supplies the address of the caller's I/O status block.
-    Buffer - Supplies the address of the buffer containing data to be written to the file.
-    Length - Length, in bytes, of the data to be written to the file.
-    ByteOffset - Specifies the starting byte offset within the file to begin the write operation.
-        If not specified and the file is open for synchronous I/O, then the current file position is used.
-        If the file is not opened for synchronous I/O and the parameter is not specified, then it is in error.
-    Key - Optionally specifies a key to be used if there are locks associated with the file.
+    FileObject - Supplies the referenced file object.  The reference is released by this routine or by I/O completion.
+    GrantedAccess - Supplies the access granted to the handle through which the file object was referenced.
+    BufferIndex - Supplies the index of the registered buffer containing Buffer, or IOP_NO_REGISTERED_BUFFER.
+    The remaining arguments are those of NtWriteFile.
 Return Value:
-    The status returned is success if the write operation was properly queued to the I/O system.
-    Once the write completes the status of the operation can be determined by examining the Status field of the I/O status block.
+    The status returned is the same as for NtWriteFile.
 */
 {
     PIRP irp;
@@ -61,9 +53,11 @@ Return Value:
     PMDL mdl;
     PIO_STACK_LOCATION irpSp;
     ACCESS_MASK grantedAccess;
-    OBJECT_HANDLE_INFORMATION handleInformation;
     NTSTATUS exceptionCode;
     BOOLEAN synchronousIo;
+    BOOLEAN positionalIo;
+    PKEVENT positionalEvent = (PKEVENT)NULL;
+    IO_STATUS_BLOCK positionalIoStatus;
     PKEVENT eventObject = (PKEVENT)NULL;
     ULONG keyValue = 0;
     LARGE_INTEGER fileOffset = {0,0};
@@ -75,14 +69,8 @@ Return Value:
     CurrentThread = PsGetCurrentThread();
     requestorMode = KeGetPreviousModeByThread(&CurrentThread->Tcb);// Get the previous mode;  i.e., the mode of the caller.
 
-    // Reference the file object so the target device can be found and the access rights mask can be used in the following checks for callers in user mode.
-    // Note that if the handle does not refer to a file object, then it will fail.
-    status = ObReferenceFileObjectForWrite(FileHandle, requestorMode, (PVOID*)& fileObject, &handleInformation);
-    if (!NT_SUCCESS(status)) {
-        return status;
-    }
-
-    grantedAccess = handleInformation.GrantedAccess;
+    fileObject = FileObject;
+    grantedAccess = GrantedAccess;
     deviceObject = IoGetRelatedDeviceObject(fileObject);// Get the address of the target device object.
     if (requestorMode != KernelMode) {// Check to see if the requestor mode was user.  If so, perform a bunch of extra checks.
         // The caller's access mode is not kernel so probe each of the arguments and capture them as necessary.
@@ -99,6 +87,12 @@ Return Value:
             // This check ensures that this is the case.
             // Since the buffer address is captured, the caller cannot change it, even though he/she can change the protection from another thread.
             // This error will be caught by the probe/lock or buffer copy operations later.
+            // A buffer that extends beyond the user address space is rejected directly rather than by raising an exception from the probe.
+            if (!ExIsUserAddressRange(Buffer, Length)) {
+                ObDereferenceObject(fileObject);
+                return STATUS_ACCESS_VIOLATION;
+            }
+
             ProbeForRead(Buffer, Length, sizeof(UCHAR));
 
             // If this file has an I/O completion port associated w/it, then ensure that the caller did not supply an APC routine, as the two are mutually exclusive methods for I/O completion notification.
@@ -221,10 +215,21 @@ Return Value:
     // If everything works, then check to see whether a ByteOffset parameter was supplied.
     // If not, or if it was and it is set to the "use file pointer position", then initialize the file offset to be whatever
     // the current byte offset into the file is according to the file pointer context information in the file object.
+    // A positional only handle does not serialize a request at an explicit offset, which waits for itself on a private event.
+    positionalIo = IopIsPositionalIo(fileObject, ByteOffset, fileOffset, Event, ApcRoutine);
+    if (positionalIo) {
+        positionalEvent = ExAllocatePool(NonPagedPool, sizeof(KEVENT));
+        if (positionalEvent == NULL) {
+            ObDereferenceObject(fileObject);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        KeInitializeEvent(positionalEvent, SynchronizationEvent, FALSE);
+    }
+
     if (fileObject->Flags & FO_SYNCHRONOUS_IO) {
         BOOLEAN interrupted;
 
-        if (!IopAcquireFastLock(fileObject)) {
+        if (!positionalIo && !IopAcquireFastLock(fileObject)) {
             status = IopAcquireFileObjectLock(fileObject, requestorMode, (BOOLEAN)((fileObject->Flags & FO_ALERTABLE_IO) != 0), &interrupted);
             if (interrupted) {
                 if (eventObject) {
@@ -235,7 +240,7 @@ Return Value:
             }
         }
 
-        synchronousIo = TRUE;
+        synchronousIo = (BOOLEAN)!positionalIo;
 
         if ((!ARGUMENT_PRESENT(ByteOffset) && !fileOffset.LowPart) || (fileOffset.LowPart == FILE_USE_FILE_POINTER_POSITION && fileOffset.HighPart == -1)) {
             fileOffset = fileObject->CurrentByteOffset;
@@ -254,7 +259,11 @@ Return Value:
                 if (eventObject) {
                     ObDereferenceObject(eventObject);
                 }
-                IopReleaseFileObjectLock(fileObject);
+                if (positionalIo) {
+                    ExFreePool(positionalEvent);
+                } else {
+                    IopReleaseFileObjectLock(fileObject);
+                }
                 ObDereferenceObject(fileObject);
                 return STATUS_INVALID_PARAMETER;
             }
@@ -280,7 +289,11 @@ Return Value:
 
                 // Note that the file object event need not be set to the Signaled state, as it is already set.
                 // Cleanup and return.
-                IopReleaseFileObjectLock(fileObject);
+                if (positionalIo) {
+                    ExFreePool(positionalEvent);
+                } else {
+                    IopReleaseFileObjectLock(fileObject);
+                }
                 ObDereferenceObject(fileObject);
                 return localIoStatus.Status;
             }
@@ -309,12 +322,17 @@ Return Value:
         return STATUS_INVALID_PARAMETER;
     }
 
-    KeClearEvent(&fileObject->Event);// Set the file object to the Not-Signaled state.
+    if (!positionalIo) {
+        KeClearEvent(&fileObject->Event);// Set the file object to the Not-Signaled state.
+    }
 
     // Allocate and initialize the I/O Request Packet (IRP) for this operation.
     // The allocation is performed with an exception handler in case the caller does not have enough quota to allocate the packet.
     irp = IopAllocateIrp(deviceObject->StackSize, !synchronousIo);
     if (!irp) {// An IRP could not be allocated.  Cleanup and return an appropriate error status code.
+        if (positionalEvent) {
+            ExFreePool(positionalEvent);
+        }
         IopAllocateIrpCleanup(fileObject, eventObject);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
@@ -329,6 +347,10 @@ Return Value:
     // Fill in the service independent parameters in the IRP.
     irp->UserEvent = eventObject;
     irp->UserIosb = IoStatusBlock;
+    if (positionalIo) {// The request is finished like a synchronous API on a handle opened for asynchronous I/O
+        irp->UserEvent = positionalEvent;
+        irp->UserIosb = &positionalIoStatus;
+    }
     irp->Overlay.AsynchronousParameters.UserApcRoutine = ApcRoutine;
     irp->Overlay.AsynchronousParameters.UserApcContext = ApcContext;
 
@@ -366,7 +388,7 @@ Return Value:
             {
                 // An exception was incurred while either probing the caller's buffer, allocating the system buffer, or copying the data from the caller's buffer to the system buffer.
                 // Determine what actually happened, clean everything up, and return an appropriate error status code.
-                IopExceptionCleanup(fileObject, irp, eventObject, (PKEVENT)NULL);
+                IopExceptionCleanup(fileObject, irp, eventObject, positionalEvent);
                 return GetExceptionCode();
             }
 
@@ -388,18 +410,25 @@ Return Value:
         irp->Flags = 0;
         if (Length) {
             try {
-                // Allocate an MDL, charging quota for it, and hang it off of the IRP.
+                // If the caller's buffer is registered, its pages are already locked and a partial MDL of them is used.
+                // Otherwise allocate an MDL, charging quota for it, and hang it off of the IRP.
                 // Probe and lock the pages associated with the caller's buffer for read access and fill in the MDL with the PFNs of those pages.
-                mdl = IoAllocateMdl(Buffer, Length, FALSE, TRUE, irp);
-                if (mdl == NULL) {
-                    ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+                if (IopIsRegisteredBufferCandidate(fileObject, requestorMode)) {
+                    mdl = IopAllocateRegisteredBufferMdl(Buffer, Length, BufferIndex, irp);
                 }
 
-                MmProbeAndLockPages(mdl, requestorMode, IoReadAccess);
+                if (mdl == NULL) {
+                    mdl = IoAllocateMdl(Buffer, Length, FALSE, TRUE, irp);
+                    if (mdl == NULL) {
+                        ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+                    }
+
+                    MmProbeAndLockPages(mdl, requestorMode, IoReadAccess);
+                }
             } except(EXCEPTION_EXECUTE_HANDLER)
             {// An exception was incurred while either allocating the MDL or while attempting to probe and lock the caller's buffer.
 // Determine what actually happened, clean everything up, and return an appropriate error status code.
-                IopExceptionCleanup(fileObject, irp, eventObject, (PKEVENT)NULL);
+                IopExceptionCleanup(fileObject, irp, eventObject, positionalEvent);
                 return GetExceptionCode();
             }
         }
@@ -407,6 +436,11 @@ Return Value:
         // Pass the address of the caller's buffer to the device driver.  It is now up to the driver to do everything.
         irp->Flags = 0;
         irp->UserBuffer = Buffer;
+
+        // If the buffer is registered, also pass a partial MDL of its locked pages so the driver need not lock them itself.
+        if (Length && IopIsRegisteredBufferCandidate(fileObject, requestorMode)) {
+            (VOID)IopAllocateRegisteredBufferMdl(Buffer, Length, BufferIndex, irp);
+        }
     }
 
     // If this write operation is to be performed without any caching, set the appropriate flag in the IRP so no caching is performed.
@@ -422,11 +456,120 @@ Return Value:
     irpSp->Parameters.Write.ByteOffset = fileOffset;
 
     // Queue the packet, call the driver, and synchronize appropriately with I/O completion.
+    if (positionalIo) {
+        irp->Flags |= IRP_SYNCHRONOUS_API;
+    }
+
     status = IopSynchronousServiceTail(deviceObject, irp, fileObject, TRUE, requestorMode, synchronousIo, WriteTransfer);
+    if (positionalIo) {
+        status = IopSynchronousApiServiceTail(status, positionalEvent, irp, requestorMode, &positionalIoStatus, IoStatusBlock);
+    }
     return status;
 }
 
 
+NTSTATUS NtWriteFile(
+    __in HANDLE FileHandle,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_bcount(Length) PVOID Buffer,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+)
+/*
+Routine Description:
+    This service writes Length bytes of data from the caller's Buffer to the file associated with FileHandle starting at StartingBlock|ByteOffset.
+    The actual number of bytes written to the file will be returned in the second longword of the IoStatusBlock.
+
+    If the writer has the file open for APPEND access, then the data will be written to the current EOF mark.
+    The StartingBlock and ByteOffset are ignored if the caller has APPEND access.
+Arguments:
+    FileHandle - Supplies a handle to the file to be written.
+    Event - Optionally supplies an event to be set to the Signaled state when the write operation is complete.
+    ApcRoutine - Optionally supplies an APC routine to be executed when the write operation is complete.
+    ApcContext - Supplies a context parameter to be passed to the APC routine when it is invoked, if an APC routine was specified.
+    IoStatusBlock - Supplies the address of the caller's I/O status block.
+    Buffer - Supplies the address of the buffer containing data to be written to the file.
+    Length - Length, in bytes, of the data to be written to the file.
+    ByteOffset - Specifies the starting byte offset within the file to begin the write operation.
+        If not specified and the file is open for synchronous I/O, then the current file position is used.
+        If the file is not opened for synchronous I/O and the parameter is not specified, then it is in error.
+    Key - Optionally specifies a key to be used if there are locks associated with the file.
+Return Value:
+    The status returned is success if the write operation was properly queued to the I/O system.
+    Once the write completes the status of the operation can be determined by examining the Status field of the I/O status block.
+*/
+{
+    NTSTATUS status;
+    PFILE_OBJECT fileObject;
+    OBJECT_HANDLE_INFORMATION handleInformation;
+
+    PAGED_CODE();
+
+    // Reference the file object so the target device can be found and the access rights mask can be used in the following checks for callers in user mode.
+    // Note that if the handle does not refer to a file object, then it will fail.
+    status = ObReferenceFileObjectForWrite(FileHandle, KeGetPreviousMode(), (PVOID*)& fileObject, &handleInformation);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    return IopWriteFile(fileObject, handleInformation.GrantedAccess, IOP_NO_REGISTERED_BUFFER, Event, ApcRoutine, ApcContext, IoStatusBlock, Buffer, Length, ByteOffset, Key);
+}
+
+
+NTSTATUS NtWriteFileRegistered(
+    __in ULONG FileIndex,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in ULONG BufferIndex,
+    __in ULONG BufferOffset,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+)
+/*
+Routine Description:
+    This service is the same as NtWriteFile, except that the file and the buffer are named by the indexes returned when they were
+    registered with NtRegisterIoHandle and NtRegisterIoBuffer.  No handle lookup is made, and if the file was opened for unbuffered I/O
+    the registered buffer's locked pages are used without being probed and locked again.
+Arguments:
+    FileIndex - Supplies the index of the registered file to be written.  The handle it was registered from must have had write or append access.
+    BufferIndex - Supplies the index of the registered buffer containing the data.
+    BufferOffset - Supplies the offset within the registered buffer of the data.
+    The remaining arguments are those of NtWriteFile.
+Return Value:
+    The status returned is the same as for NtWriteFile.
+    STATUS_INVALID_HANDLE is returned if no file is registered at FileIndex, and STATUS_INVALID_PARAMETER if the range is not
+    within the registered buffer.
+*/
+{
+    NTSTATUS status;
+    PFILE_OBJECT fileObject;
+    ACCESS_MASK grantedAccess;
+    PVOID buffer;
+
+    PAGED_CODE();
+
+    status = IopReferenceRegisteredFile(FileIndex, TRUE, &fileObject, &grantedAccess);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    buffer = IopGetRegisteredBufferAddress(BufferIndex, BufferOffset, Length);
+    if (buffer == NULL) {
+        ObDereferenceObject(fileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return IopWriteFile(fileObject, grantedAccess, BufferIndex, Event, ApcRoutine, ApcContext, IoStatusBlock, buffer, Length, ByteOffset, Key);
+}
+
+
 NTSTATUS NtWriteFileGather(
     __in HANDLE FileHandle,
     __in_opt HANDLE Event,
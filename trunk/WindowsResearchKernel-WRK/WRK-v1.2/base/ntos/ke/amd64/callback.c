@@ -75,6 +75,8 @@ Return Value:
         return GetExceptionCode();//then always handle the exception and return the exception code as the status value.
     }
 
+    // N.B. KiCallUserMode only grows the kernel stack when less than KERNEL_LARGE_STACK_COMMIT bytes remain below the current frame.
+    //      The pages stay committed for the life of the thread, so repeated callbacks at the same depth do not grow the stack again.
     TrapFrame->Rsp = (ULONG64)CalloutFrame;
     Status = KiCallUserMode(OutputBuffer, OutputLength);// Call user mode.
 
@@ -327,6 +327,11 @@ endif
 ; If the current thread NPX state is switch, then save the legacy floating
 ; point state.
 
+; N.B. The nonvolatile XMM registers have already been saved in the exception
+;      frame. When fast floating save/restore is enabled (see KiSetFeatureBits),
+;      the fxsave below and the fxrstor on the new thread skip the XMM
+;      registers entirely and only move the x87/MMX state.
+
 
 KiSC05: cmp     byte ptr ThNpxState[rdi], LEGACY_STATE_SWITCH ; check if switched
         jne     short KiSC10            ; if ne, legacy state not switched
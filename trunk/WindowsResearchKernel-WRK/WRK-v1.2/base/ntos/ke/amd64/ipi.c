@@ -13,6 +13,10 @@ Abstract:
 
 #include "ki.h"
 
+// Define the number of TB entries that may be flushed individually by a batch of flush requests from several senders before the batch is
+// merged into a single flush of the entire TB.
+#define KI_FLUSH_BATCH_MAXIMUM FLUSH_MULTIPLE_MAXIMUM
+
 
 VOID KiRestoreProcessorState(IN PKTRAP_FRAME TrapFrame, IN PKEXCEPTION_FRAME ExceptionFrame)
 /*
@@ -73,10 +77,17 @@ DECLSPEC_NOINLINE VOID KiIpiProcessRequests(VOID)
 /*
 Routine Description:
     This routine processes interprocessor requests and returns a summary of the requests that were processed.
+
+    N.B. The flush requests of all senders that are present in the sender summary are processed as a batch.
+         Each sender has written its page table entries before setting its bit in the sender summary,
+         hence a single flush performed after the sender summary is captured satisfies every flush request in the batch.
 */
 {
 #if !defined(NT_UP)
     PVOID *End;
+    ULONG64 FlushCount;
+    BOOLEAN FlushedAll;
+    BOOLEAN FlushedProcess;
     ULONG64 Number;
     PKPRCB Packet;
     PKPRCB Prcb;
@@ -95,6 +106,33 @@ Routine Description:
     TargetSet = ReadForWriteAccess(&Prcb->SenderSummary);
     SetMember = Prcb->SetMember;
     while (TargetSet != 0) {
+        // If more than one sender has a request pending, then scan the mailboxes and determine whether any sender requested an entire
+        // TB flush or the combined number of entries to flush exceeds the batch maximum. If so, flush the entire TB once for the batch.
+        FlushedAll = FALSE;
+        FlushedProcess = FALSE;
+        if ((TargetSet & (TargetSet - 1)) != 0) {
+            FlushCount = 0;
+            SummarySet = TargetSet;
+            BitScanForward64(&Processor, SummarySet);
+            do {
+                Request.Summary = Prcb->RequestMailbox[Processor].RequestSummary;
+                if ((Request.IpiRequest == IPI_FLUSH_MULTIPLE_IMMEDIATE) || (Request.IpiRequest == IPI_FLUSH_MULTIPLE)) {
+                    FlushCount += Request.Count;
+                } else if (Request.IpiRequest == IPI_FLUSH_SINGLE) {
+                    FlushCount += 1;
+                } else if (Request.IpiRequest == IPI_FLUSH_ALL) {
+                    FlushCount += KI_FLUSH_BATCH_MAXIMUM;
+                }
+
+                SummarySet ^= AFFINITY_MASK(Processor);
+            } while (BitScanForward64(&Processor, SummarySet) != FALSE);
+
+            if (FlushCount >= KI_FLUSH_BATCH_MAXIMUM) {
+                KeFlushCurrentTb();
+                FlushedAll = TRUE;
+            }
+        }
+
         SummarySet = TargetSet;
         BitScanForward64(&Processor, SummarySet);
         do {
@@ -115,7 +153,10 @@ Routine Description:
                     Source->TargetSet = 0;
                 }
 
-                if (Request.IpiRequest == IPI_FLUSH_MULTIPLE_IMMEDIATE) {
+                // If the entire TB has already been flushed for this batch, then there is nothing more to do.
+                if (FlushedAll != FALSE) {
+                    NOTHING;
+                } else if (Request.IpiRequest == IPI_FLUSH_MULTIPLE_IMMEDIATE) {
                     Number = Request.Count;
                     Virtual = &RequestMailbox->Virtual[0];
                     End = Virtual + Number;
@@ -124,12 +165,16 @@ Routine Description:
                         Virtual += 1;
                     } while (Virtual < End);
                 } else if (Request.IpiRequest == IPI_FLUSH_PROCESS) {
-                    KiFlushProcessTb();
+                    if (FlushedProcess == FALSE) {
+                        KiFlushProcessTb();
+                        FlushedProcess = TRUE;
+                    }
                 } else if (Request.IpiRequest == IPI_FLUSH_SINGLE) {
                     KiFlushSingleTb((PVOID)Request.Parameter);
                 } else {
                     ASSERT(Request.IpiRequest == IPI_FLUSH_ALL);
                     KeFlushCurrentTb();
+                    FlushedAll = TRUE;
                 }
             } else {
                 // If the request type is packet ready, then call the worker function. Otherwise, the request must be either a flush multiple or a cache invalidate.
@@ -143,13 +188,15 @@ Routine Description:
                     (RequestPacket->WorkerRoutine)((PKIPI_CONTEXT)Packet, RequestPacket->CurrentPacket[0], RequestPacket->CurrentPacket[1], RequestPacket->CurrentPacket[2]);
                 } else {
                     if (Request.IpiRequest == IPI_FLUSH_MULTIPLE) {
-                        Number = Request.Count;
-                        Virtual = (PVOID *)Request.Parameter;
-                        End = Virtual + Number;
-                        do {
-                            KiFlushSingleTb(*Virtual);
-                            Virtual += 1;
-                        } while (Virtual < End);
+                        if (FlushedAll == FALSE) {
+                            Number = Request.Count;
+                            Virtual = (PVOID *)Request.Parameter;
+                            End = Virtual + Number;
+                            do {
+                                KiFlushSingleTb(*Virtual);
+                                Virtual += 1;
+                            } while (Virtual < End);
+                        }
                     } else if (Request.IpiRequest == IPI_INVALIDATE_ALL) {
                         WritebackInvalidate();
                     } else {
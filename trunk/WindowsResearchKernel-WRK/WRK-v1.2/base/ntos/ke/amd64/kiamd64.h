@@ -47,6 +47,47 @@ typedef struct _REQUEST_SUMMARY {
 // Define get current ready summary macro.
 #define KiGetCurrentReadySummary()  __readgsdword(FIELD_OFFSET(KPCR, Prcb.ReadySummary))
 
+// Define queued spin lock profile structures.
+
+// When lock profiling is enabled each processor records, per lock address and call site, the number of acquires,
+// the number of contended acquires, the cycles spent waiting for ownership, and the maximum cycles the lock was held.
+
+// N.B. Queued spin locks are acquired and released at or above DISPATCH_LEVEL on the same processor, so the locks
+//      currently held by a processor are tracked in a small per processor stack that is used to compute hold times.
+#define LOCK_PROFILE_ENTRIES 256
+#define LOCK_PROFILE_PROBES 8
+#define LOCK_PROFILE_HELD 8
+
+C_ASSERT((LOCK_PROFILE_ENTRIES & (LOCK_PROFILE_ENTRIES - 1)) == 0);
+
+typedef struct _KLOCK_PROFILE_ENTRY {
+    PVOID Lock;
+    PVOID CallSite;
+    ULONG64 AcquireCount;
+    ULONG64 ContentionCount;
+    ULONG64 SpinCycles;
+    ULONG64 MaximumHoldCycles;
+} KLOCK_PROFILE_ENTRY, *PKLOCK_PROFILE_ENTRY;
+
+typedef struct _KLOCK_PROFILE_HOLD {
+    PKSPIN_LOCK_QUEUE LockQueue;
+    PKLOCK_PROFILE_ENTRY Entry;
+    ULONG64 AcquireTime;
+} KLOCK_PROFILE_HOLD, *PKLOCK_PROFILE_HOLD;
+
+typedef struct DECLSPEC_CACHEALIGN _KLOCK_PROFILE_BUFFER {
+    ULONG HeldCount;
+    ULONG DroppedCount;
+    KLOCK_PROFILE_HOLD Held[LOCK_PROFILE_HELD];
+    KLOCK_PROFILE_ENTRY Entry[LOCK_PROFILE_ENTRIES];
+} KLOCK_PROFILE_BUFFER, *PKLOCK_PROFILE_BUFFER;
+
+extern volatile BOOLEAN KiLockProfileEnabled;
+extern PKLOCK_PROFILE_BUFFER KiLockProfileBuffer[MAXIMUM_PROCESSORS];
+
+NTSTATUS KiSetLockProfile (IN BOOLEAN Enable);
+NTSTATUS KiQueryLockProfile (OUT PVOID Buffer, IN ULONG BufferLength, OUT PULONG ReturnLength);
+
 // Define function prototypes.
 
 VOID KiAcquireSpinLockCheckForFreeze (IN PKSPIN_LOCK SpinLock, IN PKTRAP_FRAME TrapFrame, IN PKEXCEPTION_FRAME ExceptionFrame);
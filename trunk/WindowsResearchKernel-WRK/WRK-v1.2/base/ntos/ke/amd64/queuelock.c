@@ -13,6 +13,128 @@ Abstract:
 
 #include "ki.h"
 
+#pragma alloc_text(PAGE, KiSetLockProfile)
+#pragma alloc_text(PAGE, KiQueryLockProfile)
+
+// KiLockProfileEnabled - Indicates whether queued spin lock acquires and releases are recorded in the per processor lock profile buffers.
+volatile BOOLEAN KiLockProfileEnabled = FALSE;
+
+// KiLockProfileBuffer - This is the array of per processor lock profile buffers. A buffer is allocated for each processor when lock profiling is first enabled.
+PKLOCK_PROFILE_BUFFER KiLockProfileBuffer[MAXIMUM_PROCESSORS];
+
+
+DECLSPEC_NOINLINE VOID KiLockProfileAcquire(IN PKSPIN_LOCK_QUEUE LockQueue, IN PKSPIN_LOCK SpinLock, IN PVOID CallSite, IN ULONG64 StartTime, IN LOGICAL Contended)
+/*
+Routine Description:
+    This function records the acquisition of a queued spin lock in the lock profile buffer of the current processor.
+    N.B. This function is called at or above DISPATCH_LEVEL with the specified lock owned.
+Arguments:
+    LockQueue - Supplies a pointer to the lock queue entry used to acquire the lock.
+    SpinLock - Supplies a pointer to the spin lock that was acquired.
+    CallSite - Supplies the address from which the lock was acquired.
+    StartTime - Supplies the time stamp counter value sampled before the acquisition was attempted.
+    Contended - Supplies a logical value that determines whether the acquirer had to wait for ownership.
+*/
+{
+    PKLOCK_PROFILE_BUFFER Buffer;
+    BOOLEAN Enable;
+    PKLOCK_PROFILE_ENTRY Entry;
+    PKLOCK_PROFILE_HOLD Hold;
+    ULONG Index;
+    ULONG64 Now;
+    ULONG Probe;
+
+    // Disable interrupts so an interrupt that acquires a queued spin lock on the current processor cannot interleave with the buffer update.
+    Now = ReadTimeStampCounter();
+    Enable = KeDisableInterrupts();
+    Buffer = KiLockProfileBuffer[KeGetCurrentProcessorNumber()];
+    if (Buffer != NULL) {
+        // Look up the entry for the lock address and call site using linear probing. If the entry is not found within the probe limit, then the acquire is dropped.
+        Entry = NULL;
+        Index = (ULONG)(((ULONG_PTR)SpinLock ^ ((ULONG_PTR)CallSite >> 4)) >> 3);
+        for (Probe = 0; Probe < LOCK_PROFILE_PROBES; Probe += 1) {
+            Entry = &Buffer->Entry[(Index + Probe) & (LOCK_PROFILE_ENTRIES - 1)];
+            if (Entry->Lock == NULL) {
+                Entry->Lock = SpinLock;
+                Entry->CallSite = CallSite;
+                break;
+            }
+
+            if ((Entry->Lock == SpinLock) && (Entry->CallSite == CallSite)) {
+                break;
+            }
+
+            Entry = NULL;
+        }
+
+        if (Entry != NULL) {
+            Entry->AcquireCount += 1;
+            if (Contended != FALSE) {
+                Entry->ContentionCount += 1;
+                Entry->SpinCycles += Now - StartTime;
+            }
+        } else {
+            Buffer->DroppedCount += 1;
+        }
+
+        // Push the lock on the held lock stack so the hold time can be computed when the lock is released.
+        if (Buffer->HeldCount < LOCK_PROFILE_HELD) {
+            Hold = &Buffer->Held[Buffer->HeldCount];
+            Hold->LockQueue = LockQueue;
+            Hold->Entry = Entry;
+            Hold->AcquireTime = Now;
+            Buffer->HeldCount += 1;
+        }
+    }
+
+    if (Enable != FALSE) {
+        _enable();
+    }
+}
+
+
+DECLSPEC_NOINLINE VOID KiLockProfileRelease(IN PKSPIN_LOCK_QUEUE LockQueue)
+/*
+Routine Description:
+    This function records the hold time of a queued spin lock that is about to be released by the current processor.
+Arguments:
+    LockQueue - Supplies a pointer to the lock queue entry used to acquire the lock.
+*/
+{
+    PKLOCK_PROFILE_BUFFER Buffer;
+    BOOLEAN Enable;
+    ULONG64 HoldCycles;
+    ULONG Index;
+    ULONG64 Now;
+
+    Now = ReadTimeStampCounter();
+    Enable = KeDisableInterrupts();
+    Buffer = KiLockProfileBuffer[KeGetCurrentProcessorNumber()];
+    if (Buffer != NULL) {
+        // Search the held lock stack from the most recent acquire and remove the matching entry by replacing it with the top of the stack.
+        Index = Buffer->HeldCount;
+        while (Index != 0) {
+            Index -= 1;
+            if (Buffer->Held[Index].LockQueue == LockQueue) {
+                if (Buffer->Held[Index].Entry != NULL) {
+                    HoldCycles = Now - Buffer->Held[Index].AcquireTime;
+                    if (HoldCycles > Buffer->Held[Index].Entry->MaximumHoldCycles) {
+                        Buffer->Held[Index].Entry->MaximumHoldCycles = HoldCycles;
+                    }
+                }
+
+                Buffer->HeldCount -= 1;
+                Buffer->Held[Index] = Buffer->Held[Buffer->HeldCount];
+                break;
+            }
+        }
+    }
+
+    if (Enable != FALSE) {
+        _enable();
+    }
+}
+
 
 DECLSPEC_NOINLINE PKSPIN_LOCK_QUEUE KxWaitForLockChainValid(__inout PKSPIN_LOCK_QUEUE LockQueue)
 /*
@@ -75,8 +197,21 @@ Arguments:
     // If the list was previously empty, then lock ownership is immediately granted.
     // Otherwise, wait for ownership of the lock to be granted.
 #if !defined(NT_UP)
+    ULONG64 StartTime;
     PKSPIN_LOCK_QUEUE TailQueue;
 
+    // If lock profiling is enabled, then time the acquisition and record it for the lock and the caller.
+    if (KiLockProfileEnabled != FALSE) {
+        StartTime = ReadTimeStampCounter();
+        TailQueue = InterlockedExchangePointer((PVOID *)SpinLock, LockQueue);
+        if (TailQueue != NULL) {
+            KxWaitForLockOwnerShip(LockQueue, TailQueue);
+        }
+
+        KiLockProfileAcquire(LockQueue, SpinLock, _ReturnAddress(), StartTime, (TailQueue != NULL));
+        return;
+    }
+
     TailQueue = InterlockedExchangePointer((PVOID *)SpinLock, LockQueue);
     if (TailQueue != NULL) {
         KxWaitForLockOwnerShip(LockQueue, TailQueue);
@@ -108,6 +243,10 @@ Return Value:
         KeYieldProcessor();
         return FALSE;
     }
+
+    if (KiLockProfileEnabled != FALSE) {
+        KiLockProfileAcquire(LockQueue, SpinLock, _ReturnAddress(), 0, FALSE);
+    }
 #else
     UNREFERENCED_PARAMETER(LockQueue);
     UNREFERENCED_PARAMETER(SpinLock);
@@ -129,6 +268,10 @@ Arguments:
 #if !defined(NT_UP)
     PKSPIN_LOCK_QUEUE NextQueue;
 
+    if (KiLockProfileEnabled != FALSE) {
+        KiLockProfileRelease(LockQueue);
+    }
+
     NextQueue = ReadForWriteAccess(&LockQueue->Next);
     if (NextQueue == NULL) {
         if (InterlockedCompareExchangePointer((PVOID *)LockQueue->Lock, NULL, LockQueue) == LockQueue) {
@@ -500,4 +643,125 @@ Return Value:
     }
 
     return TRUE;
-}
\ No newline at end of file
+}
+
+
+NTSTATUS KiSetLockProfile(IN BOOLEAN Enable)
+/*
+Routine Description:
+    This function enables or disables queued spin lock profiling.
+    When profiling is enabled, a profile buffer is allocated for each processor that does not already have one and all profile buffers are cleared.
+    N.B. Profile buffers are never freed since a processor may be recording into its buffer while profiling is disabled.
+Arguments:
+    Enable - Supplies a boolean value that determines whether lock profiling is enabled or disabled.
+Return Value:
+    STATUS_SUCCESS is returned if the profile state is changed. Otherwise, STATUS_INSUFFICIENT_RESOURCES is returned.
+*/
+{
+    PKLOCK_PROFILE_BUFFER Buffer;
+    ULONG Index;
+
+    PAGED_CODE();
+
+    if (Enable == FALSE) {
+        KiLockProfileEnabled = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    // Allocate a profile buffer for each processor that does not have one and clear all profile buffers.
+    for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+        if (KiLockProfileBuffer[Index] == NULL) {
+            Buffer = ExAllocatePoolWithTag(NonPagedPool, sizeof(KLOCK_PROFILE_BUFFER), 'lPeK');
+            if (Buffer == NULL) {
+                return STATUS_INSUFFICIENT_RESOURCES;
+            }
+
+            RtlZeroMemory(Buffer, sizeof(KLOCK_PROFILE_BUFFER));
+            if (InterlockedCompareExchangePointer(&KiLockProfileBuffer[Index], Buffer, NULL) != NULL) {
+                ExFreePool(Buffer);
+            }
+        } else {
+            RtlZeroMemory(KiLockProfileBuffer[Index], sizeof(KLOCK_PROFILE_BUFFER));
+        }
+    }
+
+    KeMemoryBarrier();
+    KiLockProfileEnabled = TRUE;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS KiQueryLockProfile(OUT PVOID Buffer, IN ULONG BufferLength, OUT PULONG ReturnLength)
+/*
+Routine Description:
+    This function copies the contents of the per processor lock profile buffers to the specified buffer.
+    N.B. The specified buffer may be a user mode buffer. The caller is expected to handle exceptions raised by accessing the buffer.
+Arguments:
+    Buffer - Supplies a pointer to a buffer that receives a system lock profile information structure.
+    BufferLength - Supplies the length of the buffer in bytes.
+    ReturnLength - Supplies a pointer to a variable that receives the number of bytes required to return all of the profile entries.
+Return Value:
+    STATUS_SUCCESS is returned if all of the profile entries fit in the specified buffer. Otherwise, STATUS_INFO_LENGTH_MISMATCH is returned.
+*/
+{
+    ULONG Count;
+    ULONG Dropped;
+    PKLOCK_PROFILE_ENTRY Entry;
+    ULONG Index;
+    PSYSTEM_LOCK_PROFILE_INFORMATION Information;
+    ULONG Length;
+    PKLOCK_PROFILE_BUFFER ProfileBuffer;
+    ULONG Processor;
+    PSYSTEM_LOCK_PROFILE_ENTRY SystemEntry;
+
+    PAGED_CODE();
+
+    if (BufferLength < FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries)) {
+        *ReturnLength = FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    // Copy each recorded entry while the output buffer has room, and count the entries to compute the required length.
+    Information = (PSYSTEM_LOCK_PROFILE_INFORMATION)Buffer;
+    Count = 0;
+    Dropped = 0;
+    Length = FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Entries);
+    for (Processor = 0; Processor < (ULONG)KeNumberProcessors; Processor += 1) {
+        ProfileBuffer = KiLockProfileBuffer[Processor];
+        if (ProfileBuffer == NULL) {
+            continue;
+        }
+
+        Dropped += ProfileBuffer->DroppedCount;
+        for (Index = 0; Index < LOCK_PROFILE_ENTRIES; Index += 1) {
+            Entry = &ProfileBuffer->Entry[Index];
+            if (Entry->Lock == NULL) {
+                continue;
+            }
+
+            if ((Length + sizeof(SYSTEM_LOCK_PROFILE_ENTRY)) <= BufferLength) {
+                SystemEntry = &Information->Entries[Count];
+                SystemEntry->Lock = Entry->Lock;
+                SystemEntry->CallSite = Entry->CallSite;
+                SystemEntry->Processor = Processor;
+                SystemEntry->Reserved = 0;
+                SystemEntry->AcquireCount = Entry->AcquireCount;
+                SystemEntry->ContentionCount = Entry->ContentionCount;
+                SystemEntry->SpinCycles = Entry->SpinCycles;
+                SystemEntry->MaximumHoldCycles = Entry->MaximumHoldCycles;
+                Count += 1;
+            }
+
+            Length += sizeof(SYSTEM_LOCK_PROFILE_ENTRY);
+        }
+    }
+
+    Information->NumberOfEntries = Count;
+    Information->DroppedCount = Dropped;
+    *ReturnLength = Length;
+    if (Length > BufferLength) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -13,6 +13,80 @@ Abstract:
 
 #include "ki.h"
 
+// Define the maximum number of clock ticks that may be deferred while a processor is idle.
+// The deferred runtime and DPC moderation updates are caught up on the first tick that is not deferred.
+#define KI_IDLE_TICK_SKIP_LIMIT 16
+
+
+FORCEINLINE VOID KiUpdateDpcModeration(IN PKPRCB Prcb)
+/*
+Routine Description:
+    This function updates the DPC request rate and performs DPC moderation for a single clock tick.
+Arguments:
+    Prcb - Supplies a pointer to the current processor block.
+*/
+{
+    // Update the DPC request rate which is computed as the average of the previous rate and the current rate.
+    Prcb->DpcRequestRate += (Prcb->DpcData[DPC_NORMAL].DpcCount - Prcb->DpcLastCount);
+    Prcb->DpcRequestRate >>= 1;
+    Prcb->DpcLastCount = Prcb->DpcData[DPC_NORMAL].DpcCount;
+
+    // If the current DPC queue depth is not zero, a DPC routine is not active, and a DPC interrupt has not been requested,
+    // then request a dispatch interrupt, decrement the maximum DPC queue depth, and reset the threshold counter if appropriate.
+    // Otherwise, count down the adjustment threshold and if the count reaches zero, then increment the maximum DPC queue depth,
+    // but not above the initial value and reset the adjustment threshold value.
+    if ((Prcb->DpcData[DPC_NORMAL].DpcQueueDepth != 0) && (Prcb->DpcRoutineActive == FALSE) && (Prcb->DpcInterruptRequested == FALSE)) {
+        KiRequestSoftwareInterrupt(DISPATCH_LEVEL);
+        Prcb->AdjustDpcThreshold = KiAdjustDpcThreshold;
+
+        // If the DPC request rate is less than the ideal rate and the DPC queue depth is not one, then decrement the maximum queue depth.
+        if ((Prcb->DpcRequestRate < KiIdealDpcRate) && (Prcb->MaximumDpcQueueDepth != 1)) {
+            Prcb->MaximumDpcQueueDepth -= 1;
+        }
+    } else {
+        if ((Prcb->AdjustDpcThreshold -= 1) == 0) {
+            Prcb->AdjustDpcThreshold = KiAdjustDpcThreshold;
+            if (Prcb->MaximumDpcQueueDepth != KiMaximumDpcQueueDepth) {
+                Prcb->MaximumDpcQueueDepth += 1;
+            }
+        }
+    }
+}
+
+
+FORCEINLINE VOID KiCatchUpIdleTicks(IN PKPRCB Prcb)
+/*
+Routine Description:
+    This function charges the clock ticks that were deferred while the current processor was idle to the idle thread
+    and replays the DPC moderation updates that were skipped.
+    N.B. This function is called at CLOCK_LEVEL on the current processor.
+Arguments:
+    Prcb - Supplies a pointer to the current processor block.
+*/
+{
+    ULONG Skipped;
+
+    Skipped = Prcb->IdleTickSkip;
+    Prcb->IdleTickSkip = 0;
+    Prcb->KernelTime += Skipped;
+    Prcb->IdleThread->KernelTime += Skipped;
+
+    // The DPC queue was empty on each deferred tick, so the request rate decays by half per tick and the adjustment threshold counts down.
+    Prcb->DpcRequestRate += (Prcb->DpcData[DPC_NORMAL].DpcCount - Prcb->DpcLastCount);
+    Prcb->DpcRequestRate >>= Skipped;
+    Prcb->DpcLastCount = Prcb->DpcData[DPC_NORMAL].DpcCount;
+    do {
+        if ((Prcb->AdjustDpcThreshold -= 1) == 0) {
+            Prcb->AdjustDpcThreshold = KiAdjustDpcThreshold;
+            if (Prcb->MaximumDpcQueueDepth != KiMaximumDpcQueueDepth) {
+                Prcb->MaximumDpcQueueDepth += 1;
+            }
+        }
+
+        Skipped -= 1;
+    } while (Skipped != 0);
+}
+
 
 VOID KeUpdateRunTime(IN PKTRAP_FRAME TrapFrame, IN LONG Increment)
 /*
@@ -45,6 +119,25 @@ Arguments:
         // Update the appropriate time counter based on previous mode, IRQL, and whether there is currently a DPC active.
         Prcb->TickOffset += KeMaximumIncrement;
         Thread = KeGetCurrentThread();
+
+        // If the tick interrupted the idle loop with no DPC work pending, then defer the runtime and DPC moderation updates.
+        // The processor has no quantum to decrement, so the only work for the tick is accounting which can be done in bulk.
+        if ((Thread == Prcb->IdleThread) &&
+            ((TrapFrame->SegCs & MODE_MASK) == 0) &&
+            (Prcb->NestingLevel == 1) &&
+            (Prcb->DpcRoutineActive == FALSE) &&
+            (Prcb->DpcData[DPC_NORMAL].DpcQueueDepth == 0) &&
+            (KdDebuggerEnabled == FALSE) &&
+            (Prcb->IdleTickSkip < KI_IDLE_TICK_SKIP_LIMIT)) {
+            Prcb->IdleTickSkip += 1;
+            return;
+        }
+
+        // If ticks were deferred while the processor was idle, then catch up the idle runtime and DPC moderation state.
+        if (Prcb->IdleTickSkip != 0) {
+            KiCatchUpIdleTicks(Prcb);
+        }
+
         if ((TrapFrame->SegCs & MODE_MASK) == 0) {
             // Update the total time spent in kernel mode.
 
@@ -77,31 +170,7 @@ Arguments:
             Thread->UserTime += 1;
         }
 
-        // Update the DPC request rate which is computed as the average of the previous rate and the current rate.
-        Prcb->DpcRequestRate += (Prcb->DpcData[DPC_NORMAL].DpcCount - Prcb->DpcLastCount);
-        Prcb->DpcRequestRate >>= 1;
-        Prcb->DpcLastCount = Prcb->DpcData[DPC_NORMAL].DpcCount;
-
-        // If the current DPC queue depth is not zero, a DPC routine is not active, and a DPC interrupt has not been requested,
-        // then request a dispatch interrupt, decrement the maximum DPC queue depth, and reset the threshold counter if appropriate.
-        // Otherwise, count down the adjustment threshold and if the count reaches zero, then increment the maximum DPC queue depth,
-        // but not above the initial value and reset the adjustment threshold value.
-        if ((Prcb->DpcData[DPC_NORMAL].DpcQueueDepth != 0) && (Prcb->DpcRoutineActive == FALSE) && (Prcb->DpcInterruptRequested == FALSE)) {
-            KiRequestSoftwareInterrupt(DISPATCH_LEVEL);
-            Prcb->AdjustDpcThreshold = KiAdjustDpcThreshold;
-
-            // If the DPC request rate is less than the ideal rate and the DPC queue depth is not one, then decrement the maximum queue depth.
-            if ((Prcb->DpcRequestRate < KiIdealDpcRate) && (Prcb->MaximumDpcQueueDepth != 1)) {
-                Prcb->MaximumDpcQueueDepth -= 1;
-            }
-        } else {
-            if ((Prcb->AdjustDpcThreshold -= 1) == 0) {
-                Prcb->AdjustDpcThreshold = KiAdjustDpcThreshold;
-                if (Prcb->MaximumDpcQueueDepth != KiMaximumDpcQueueDepth) {
-                    Prcb->MaximumDpcQueueDepth += 1;
-                }
-            }
-        }
+        KiUpdateDpcModeration(Prcb);
 
         // If the current thread is not the idle thread, then decrement the thread quantum.
 
@@ -2527,5 +2527,109 @@ SYSSTUBS_ENTRY5  295, WaitLowEventPair, 0
 SYSSTUBS_ENTRY6  295, WaitLowEventPair, 0
 SYSSTUBS_ENTRY7  295, WaitLowEventPair, 0
 SYSSTUBS_ENTRY8  295, WaitLowEventPair, 0
+SYSSTUBS_ENTRY1  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY2  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY3  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY4  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY5  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY6  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY7  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY8  296, RemoveIoCompletionEx, 1
+SYSSTUBS_ENTRY1  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY2  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY3  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY4  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY5  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY6  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY7  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY8  297, PrefetchVirtualMemory, 0
+SYSSTUBS_ENTRY1  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY2  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY3  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY4  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY5  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY6  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY7  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY8  298, AllocateVirtualMemoryRanges, 2
+SYSSTUBS_ENTRY1  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY2  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY3  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY4  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY5  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY6  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY7  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY8  299, FreeVirtualMemoryRanges, 1
+SYSSTUBS_ENTRY1  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY2  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY3  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY4  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY5  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY6  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY7  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY8  300, RegisterIoBuffer, 0
+SYSSTUBS_ENTRY1  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY2  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY3  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY4  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY5  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY6  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY7  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY8  301, UnregisterIoBuffer, 0
+SYSSTUBS_ENTRY1  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY2  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY3  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY4  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY5  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY6  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY7  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY8  302, RegisterIoHandle, 0
+SYSSTUBS_ENTRY1  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY2  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY3  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY4  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY5  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY6  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY7  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY8  303, UnregisterIoHandle, 0
+SYSSTUBS_ENTRY1  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY2  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY3  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY4  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY5  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY6  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY7  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY8  304, ReadFileRegistered, 6
+SYSSTUBS_ENTRY1  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY2  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY3  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY4  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY5  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY6  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY7  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY8  305, WriteFileRegistered, 6
+SYSSTUBS_ENTRY1  306, EnterIoRing, 0
+SYSSTUBS_ENTRY2  306, EnterIoRing, 0
+SYSSTUBS_ENTRY3  306, EnterIoRing, 0
+SYSSTUBS_ENTRY4  306, EnterIoRing, 0
+SYSSTUBS_ENTRY5  306, EnterIoRing, 0
+SYSSTUBS_ENTRY6  306, EnterIoRing, 0
+SYSSTUBS_ENTRY7  306, EnterIoRing, 0
+SYSSTUBS_ENTRY8  306, EnterIoRing, 0
+SYSSTUBS_ENTRY1  307, ReadFileVector, 2
+SYSSTUBS_ENTRY2  307, ReadFileVector, 2
+SYSSTUBS_ENTRY3  307, ReadFileVector, 2
+SYSSTUBS_ENTRY4  307, ReadFileVector, 2
+SYSSTUBS_ENTRY5  307, ReadFileVector, 2
+SYSSTUBS_ENTRY6  307, ReadFileVector, 2
+SYSSTUBS_ENTRY7  307, ReadFileVector, 2
+SYSSTUBS_ENTRY8  307, ReadFileVector, 2
+SYSSTUBS_ENTRY1  308, WriteFileVector, 2
+SYSSTUBS_ENTRY2  308, WriteFileVector, 2
+SYSSTUBS_ENTRY3  308, WriteFileVector, 2
+SYSSTUBS_ENTRY4  308, WriteFileVector, 2
+SYSSTUBS_ENTRY5  308, WriteFileVector, 2
+SYSSTUBS_ENTRY6  308, WriteFileVector, 2
+SYSSTUBS_ENTRY7  308, WriteFileVector, 2
+SYSSTUBS_ENTRY8  308, WriteFileVector, 2
 
 STUBS_END
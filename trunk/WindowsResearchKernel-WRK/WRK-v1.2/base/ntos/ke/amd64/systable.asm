@@ -371,8 +371,21 @@ TABLE_ENTRY  WaitForDebugEvent, 0, 0
 TABLE_ENTRY  WaitForKeyedEvent, 0, 0
 TABLE_ENTRY  WaitHighEventPair, 0, 0
 TABLE_ENTRY  WaitLowEventPair, 0, 0
+TABLE_ENTRY  RemoveIoCompletionEx, 1, 1
+TABLE_ENTRY  PrefetchVirtualMemory, 0, 0
+TABLE_ENTRY  AllocateVirtualMemoryRanges, 1, 2
+TABLE_ENTRY  FreeVirtualMemoryRanges, 1, 1
+TABLE_ENTRY  RegisterIoBuffer, 0, 0
+TABLE_ENTRY  UnregisterIoBuffer, 0, 0
+TABLE_ENTRY  RegisterIoHandle, 0, 0
+TABLE_ENTRY  UnregisterIoHandle, 0, 0
+TABLE_ENTRY  ReadFileRegistered, 1, 6
+TABLE_ENTRY  WriteFileRegistered, 1, 6
+TABLE_ENTRY  EnterIoRing, 0, 0
+TABLE_ENTRY  ReadFileVector, 1, 2
+TABLE_ENTRY  WriteFileVector, 1, 2
 
-TABLE_END 295
+TABLE_END 308
 
 ARGTBL_BEGIN
 ARGTBL_ENTRY 0,0,0,20,24,20,4,0
@@ -412,5 +425,7 @@ ARGTBL_ENTRY 0,0,0,4,0,0,0,0
 ARGTBL_ENTRY 0,0,4,0,0,0,0,0
 ARGTBL_ENTRY 0,8,0,0,0,0,0,0
 ARGTBL_ENTRY 0,4,0,0,0,0,0,0
+ARGTBL_ENTRY 4,0,8,4,0,0,0,0
+ARGTBL_ENTRY 24,24,0,8,8,0,0,0
 
 ARGTBL_END
@@ -133,4 +133,37 @@ KiCP20: movdqa  xmm0, [rdx + rax + 16 * 0]
         ret
 
         LEAF_END KeCopyPage, _TEXT$00
+
+
+; VOID KeCopySinglePage (IN PVOID Destination, IN PVOID Source)
+; Routine Description:
+;   This routine copies a page of memory using normal moves so that the target page is left in the cache.
+;   It is used when the caller is about to touch the target page, e.g. to resolve a copy on write fault.
+; Arguments:
+;   Destination (rcx) - Supplies the address of the target page.
+;   Source (rdx) - Supplies the address of the source page.
+
+        LEAF_ENTRY KeCopySinglePage, _TEXT$00
+
+; Set rcx and rdx to the end of their respective pages
+
+        add     rcx, PAGE_SIZE
+        add     rdx, PAGE_SIZE
+        mov     rax, -PAGE_SIZE
+
+        align   16
+
+KiCS10: movdqa  xmm0, [rdx + rax + 16 * 0]
+        movdqa  xmm1, [rdx + rax + 16 * 1]
+        movdqa  xmm2, [rdx + rax + 16 * 2]
+        movdqa  xmm3, [rdx + rax + 16 * 3]
+        movdqa  [rcx + rax + 16 * 0], xmm0
+        movdqa  [rcx + rax + 16 * 1], xmm1
+        movdqa  [rcx + rax + 16 * 2], xmm2
+        movdqa  [rcx + rax + 16 * 3], xmm3
+        add     rax, 16*4
+        jnz     short KiCS10
+        ret
+
+        LEAF_END KeCopySinglePage, _TEXT$00
         end
\ No newline at end of file
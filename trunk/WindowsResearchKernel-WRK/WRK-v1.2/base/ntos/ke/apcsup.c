@@ -167,6 +167,9 @@ Arguments:
 
         // N.B. There is no race condition associated with checking the APC queue outside the APC lock.
         //      User APCs are always delivered at system exit and never interrupt the execution of the thread in the kernel.
+
+        // N.B. Only one user APC is delivered per exit. The user mode dispatcher returns through NtContinue with test alert set,
+        //      which sets user APC pending again if more entries are queued, so the remaining APCs are delivered on that exit.
         if ((PreviousMode == UserMode) && (IsListEmpty(&Thread->ApcState.ApcListHead[UserMode]) == FALSE) && (Thread->ApcState.UserApcPending != FALSE)) {
             // Raise IRQL to dispatcher level, lock the APC queue, and deliver a user mode APC.
             KeAcquireInStackQueuedSpinLock(&Thread->ApcQueueLock, &LockHandle);
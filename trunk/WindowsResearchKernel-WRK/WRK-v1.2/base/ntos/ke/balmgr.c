@@ -43,6 +43,15 @@ typedef enum _BALANCE_OBJECT{
 ULONG KiStackProtectTime;
 
 
+// Define the per-thread stack protect time scaling.
+// A thread that wakes within twice its protect time of its wait starting had its stack out swapped too early and gets a longer protect time.
+// A thread that stays waiting much longer than its protect time gets a shorter one again.
+// The wait list scan skips threads still within their own protect time, bounded so the dispatcher lock isn't held for long.
+#define MAXIMUM_STACK_PROTECT_SHIFT 3
+#define STACK_PROTECT_LONG_WAIT_SHIFT 3
+#define MAXIMUM_THREAD_STACK_SCAN (MAXIMUM_THREAD_STACKS * 8)
+
+
 // Define number of threads to scan each period and the priority boost bias.
 #define THREAD_BOOST_BIAS 1
 #define THREAD_BOOST_PRIORITY (LOW_REALTIME_PRIORITY - THREAD_BOOST_BIAS)
@@ -56,6 +65,14 @@ ULONG KiLastProcessor = 0;
 ULONG KiReadyScanLast = 0;
 
 
+// Define the per-node ready queue scan DPCs and the last processor examined in each node.
+// N.B. On multinode systems each node scans only the ready queues of its own processors, and the scan runs on a processor of that node.
+#if defined(KE_MULTINODE)
+KDPC KiNodeScanDpc[MAXIMUM_CCNUMA_NODES];
+ULONG KiNodeScanLast[MAXIMUM_CCNUMA_NODES];
+#endif
+
+
 // Define local procedure prototypes.
 VOID KiAdjustIrpCredits(VOID);
 VOID KiInSwapKernelStacks(IN PSINGLE_LIST_ENTRY SwapEntry);
@@ -64,6 +81,10 @@ VOID KiOutSwapKernelStacks(VOID);
 VOID KiOutSwapProcesses(IN PSINGLE_LIST_ENTRY SwapEntry);
 VOID KiScanReadyQueues(IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2);
 
+#if defined(KE_MULTINODE)
+VOID KiQueueNodeReadyScans(IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2);
+#endif
+
 
 LONG KiStackOutSwapRequest = FALSE;// Define swap request flag.
 
@@ -78,6 +99,11 @@ Arguments:
 */
 {
     LARGE_INTEGER DueTime;
+#if defined(KE_MULTINODE)
+    ULONG Index;
+    PKNODE Node;
+#endif
+
     KIRQL OldIrql;
     KTIMER PeriodTimer;
     KDPC ScanDpc;
@@ -95,6 +121,24 @@ Arguments:
     // Initialize the periodic timer, initialize the ready queue scan DPC, and set the periodic timer it to expire one period from now.
     KeInitializeTimerEx(&PeriodTimer, SynchronizationTimer);
     KeInitializeDpc(&ScanDpc, &KiScanReadyQueues, &KiReadyScanLast);
+
+    // If this is a multinode system, then initialize a ready queue scan DPC for each node that targets the first processor in the node,
+    // and have the periodic timer queue the node DPCs instead of scanning the ready queues of all processors from one processor.
+#if defined(KE_MULTINODE)
+    if (KeNumberNodes > 1) {
+        for (Index = 0; Index < KeNumberNodes; Index += 1) {
+            Node = KeNodeBlock[Index];
+            if (Node->ProcessorMask != 0) {
+                KeFindFirstSetLeftAffinity(Node->ProcessorMask, &KiNodeScanLast[Index]);
+                KeInitializeDpc(&KiNodeScanDpc[Index], &KiScanReadyQueues, &KiNodeScanLast[Index]);
+                KeSetTargetProcessorDpc(&KiNodeScanDpc[Index], (CCHAR)KiNodeScanLast[Index]);
+            }
+        }
+
+        KeInitializeDpc(&ScanDpc, &KiQueueNodeReadyScans, NULL);
+    }
+#endif
+
     DueTime.QuadPart = -PERIODIC_INTERVAL;
     KeSetTimerEx(&PeriodTimer, DueTime, PERIODIC_INTERVAL / (10 * 1000), &ScanDpc);
 
@@ -160,10 +204,12 @@ VOID KeSwapProcessOrStack(IN PVOID Context)
 Routine Description:
     This thread controls the swapping of processes and kernel stacks.
     The order of evaluation is:
+        Inswap kernel stacks
         Outswap kernel stacks
         Outswap processes
         Inswap processes
         Inswap kernel stacks
+    Kernel stack inswaps are done first since the threads are ready to run and only waiting for their stacks.
 Arguments:
     Context - Supplies a pointer to the routine context - not used.
 */
@@ -185,6 +231,12 @@ Arguments:
         // The following events are processed one after the other.
         // If another event of a particular type arrives after having processed the respective event type, 
         // them the swap event will have been set and the above wait will immediately be satisfied.
+        // Check if there are any kernel stack in swap requests pending.
+        SwapEntry = InterlockedFlushSingleList(&KiStackInSwapListHead);
+        if (SwapEntry != NULL) {
+            KiInSwapKernelStacks(SwapEntry);
+        }
+
         // Check to determine if there is a kernel stack out swap scan request pending.
         if (InterlockedCompareExchange(&KiStackOutSwapRequest, FALSE, TRUE) == TRUE) {
             KiOutSwapKernelStacks();
@@ -274,6 +326,8 @@ Arguments:
 {
     KIRQL OldIrql;
     PKTHREAD Thread;
+    ULONG WaitTime;
+    ULONG ProtectTime;
 
     // Process the stack in swap SLIST and for each thread removed from the SLIST, 
     // make its kernel stack resident, and ready it for execution.
@@ -281,6 +335,20 @@ Arguments:
         Thread = CONTAINING_RECORD(SwapEntry, KTHREAD, SwapListEntry);
         ASSERT(Thread->KernelStackResident == FALSE);
         SwapEntry = SwapEntry->Next;
+
+        // Adjust the protect time of the thread by how long it waited after its stack became eligible for out swapping.
+        WaitTime = KiQueryLowTickCount() - Thread->WaitTime;
+        ProtectTime = KiStackProtectTime << Thread->StackProtectShift;
+        if (WaitTime < (ProtectTime * 2)) {
+            if (Thread->StackProtectShift < MAXIMUM_STACK_PROTECT_SHIFT) {
+                Thread->StackProtectShift += 1;
+            }
+        } else if (WaitTime > (ProtectTime << STACK_PROTECT_LONG_WAIT_SHIFT)) {
+            if (Thread->StackProtectShift != 0) {
+                Thread->StackProtectShift -= 1;
+            }
+        }
+
         MmInPageKernelStack(Thread);
         KiLockDispatcherDatabase(&OldIrql);
         Thread->KernelStackResident = TRUE;
@@ -330,10 +398,13 @@ VOID KiOutSwapKernelStacks(VOID)
 /*
 Routine Description:
     This function attempts to out swap the kernel stack for threads whose wait mode is user and which have been waiting longer than the stack protect time.
+    Threads that have recently woken soon after having their stacks out swapped are protected for a longer time.
 */
 {
     PLIST_ENTRY NextEntry;
     ULONG NumberOfThreads;
+    ULONG NumberScanned;
+    ULONG TickCount;
     KIRQL OldIrql;
     PKPRCB Prcb;
     PKPROCESS Process;
@@ -348,14 +419,17 @@ Routine Description:
 
     // Raise IRQL and lock the dispatcher database.
     NumberOfThreads = 0;
+    NumberScanned = 0;
     Prcb = KiProcessorBlock[KiLastProcessor];
-    WaitLimit = KiQueryLowTickCount() - KiStackProtectTime;
+    TickCount = KiQueryLowTickCount();
+    WaitLimit = TickCount - KiStackProtectTime;
     KiLockDispatcherDatabase(&OldIrql);
     NextEntry = Prcb->WaitListHead.Flink;
-    while ((NextEntry != &Prcb->WaitListHead) && (NumberOfThreads < MAXIMUM_THREAD_STACKS)) {
+    while ((NextEntry != &Prcb->WaitListHead) && (NumberOfThreads < MAXIMUM_THREAD_STACKS) && (NumberScanned < MAXIMUM_THREAD_STACK_SCAN)) {
         Thread = CONTAINING_RECORD(NextEntry, KTHREAD, WaitListEntry);
         ASSERT(Thread->WaitMode == UserMode);
         NextEntry = NextEntry->Flink;
+        NumberScanned += 1;
 
         // Threads are inserted at the end of the wait list in very nearly reverse time order, 
         // i.e., the longest waiting thread is at the beginning of the list followed by the next oldest, etc.
@@ -364,8 +438,11 @@ Routine Description:
 
         // N.B. It is possible due to a race condition in wait that a high priority thread was placed in the wait list.
         //      If this occurs, then the thread is removed from the wait list without swapping the stack.
+        //      Threads with a scaled protect time that have not waited that long yet are skipped.
         if (WaitLimit < Thread->WaitTime) {
             break;
+        } else if ((TickCount - (KiStackProtectTime << Thread->StackProtectShift)) < Thread->WaitTime) {
+            continue;
         } else if (Thread->Priority >= (LOW_REALTIME_PRIORITY + 9)) {
             RemoveEntryList(&Thread->WaitListEntry);
             Thread->WaitListEntry.Flink = NULL;
@@ -579,13 +656,41 @@ Arguments:
         Prcb->QueueIndex = Index;
     }
 
-    ScanIndex += 1;// Increment the processor number.
-    if (ScanIndex == (ULONG)KeNumberProcessors) {
-        ScanIndex = 0;
-    }
+    // Select the next processor in the node of the scanned processor.
+    // N.B. On single node systems the node contains all active processors.
+    *ScanLast = KeFindNextRightSetAffinity(ScanIndex, Prcb->ParentNode->ProcessorMask);
+}
+
+
+#if defined(KE_MULTINODE)
+VOID KiQueueNodeReadyScans(IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2)
+/*
+Routine Description:
+    This function queues the ready queue scan DPC of each node in the host system.
+    N.B. This function is executed as a DPC from the periodic timer that drives the balance set manager on multinode systems.
+Arguments:
+    Dpc - Supplies a pointer to a DPC object - not used.
+    DeferredContext - Supplies the DPC context - not used.
+    SystemArgument1 - Supplies the first system argument - not used.
+    SystemArgument2 - Supplies the second system argument - not used.
+*/
+{
+    ULONG Index;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(DeferredContext);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
 
-    *ScanLast = ScanIndex;
+    // Queue the scan DPC of each node that has processors.
+    // N.B. If the previous scan of a node has not run yet, then the DPC is already queued and is not queued again.
+    for (Index = 0; Index < KeNumberNodes; Index += 1) {
+        if (KeNodeBlock[Index]->ProcessorMask != 0) {
+            KeInsertQueueDpc(&KiNodeScanDpc[Index], NULL, NULL);
+        }
+    }
 }
+#endif
 
 
 #if defined(_AMD64_)
@@ -35,9 +35,9 @@ Return Value:
     The address of the appropriate DPC data structure is returned.
 */
 {
-    // If the DPC is a threaded DPC and thread DPCs are enabled, then set the address of the threaded DPC data. 
-    // Otherwise, set the address of the normal DPC structure.
-    if ((Dpc->Type == (UCHAR)ThreadedDpcObject) && (Prcb->ThreadDpcEnable != FALSE)) {
+    // If the DPC is a threaded DPC or a normal DPC whose deferred routine has been offloaded and thread DPCs are enabled,
+    // then set the address of the threaded DPC data. Otherwise, set the address of the normal DPC structure.
+    if (((Dpc->Type == (UCHAR)ThreadedDpcObject) || (KiIsDpcOffloaded(Dpc) != FALSE)) && (Prcb->ThreadDpcEnable != FALSE)) {
         return &Prcb->DpcData[DPC_THREADED];
     } else {
         return &Prcb->DpcData[DPC_NORMAL];
@@ -124,6 +124,13 @@ Return Value:
 
     ASSERT_DPC(Dpc);
 
+    // If the DPC object is already in a DPC queue, then return without raising IRQL or acquiring the DPC queue lock of the target processor.
+    // This avoids pulling the DPC lock of a remote processor into the cache when a device repeatedly queues a DPC that has not run yet.
+    // N.B. The DPC data address is only cleared when the DPC is removed from its queue, so the DPC object was queued at the time of the check.
+    if (*((PVOID volatile *)&Dpc->DpcData) != NULL) {
+        return FALSE;
+    }
+
     // Disable interrupts and acquire the DPC queue lock for the specified target processor.
     // N.B. Disable interrupt cannot be used here since it causes the software interrupt request code to get confused on some platforms.
     RequestInterrupt = FALSE;
@@ -153,6 +160,12 @@ Return Value:
     if (InterlockedCompareExchangePointer(&Dpc->DpcData, DpcData, NULL) == NULL) {
         DpcData->DpcQueueDepth += 1;
         DpcData->DpcCount += 1;
+
+        // If DPC histograms are enabled and the normal DPC queue was empty, then capture the time at which the queue became nonempty.
+        if ((KiDpcHistogramEnabled != FALSE) && (DpcData->DpcQueueDepth == 1) && (DpcData == &TargetPrcb->DpcData[DPC_NORMAL])) {
+            KiDpcHistogram[TargetPrcb->Number].QueueTime = KiReadDpcTimeStamp();
+        }
+
         Dpc->SystemArgument1 = SystemArgument1;
         Dpc->SystemArgument2 = SystemArgument2;
 
@@ -48,8 +48,10 @@ Arguments:
     PLIST_ENTRY Entry;
     PLIST_ENTRY ListHead;
     LOGICAL Logging;
+    BOOLEAN Offloaded;
     KIRQL OldIrql;
     PKPRCB Prcb;
+    ULONG64 StartTime;
     PVOID SystemArgument1;
     PVOID SystemArgument2;
     PKTHREAD Thread;
@@ -92,6 +94,7 @@ Arguments:
                     DeferredContext = Dpc->DeferredContext;
                     SystemArgument1 = Dpc->SystemArgument1;
                     SystemArgument2 = Dpc->SystemArgument2;
+                    Offloaded = (BOOLEAN)(Dpc->Type != (UCHAR)ThreadedDpcObject);
                     Dpc->DpcData = NULL;
                     Prcb->DpcData[DPC_THREADED].DpcQueueDepth -= 1;
                     KeReleaseSpinLockFromDpcLevel(&Prcb->DpcData[DPC_THREADED].DpcLock);
@@ -101,7 +104,23 @@ Arguments:
                         PerfTimeStamp(TimeStamp);
                     }
 
-                    (DeferredRoutine)(Dpc, DeferredContext, SystemArgument1, SystemArgument2);// Call the DPC routine.
+                    // If the DPC is a normal DPC that has been offloaded to the DPC thread, then call the DPC routine at DISPATCH_LEVEL as it expects.
+                    // N.B. Only the execution of the DPC routine is at DISPATCH_LEVEL. The DPC thread is schedulable between offloaded DPCs,
+                    //      so long running routines are no longer executed back to back from the dispatch interrupt.
+                    if (Offloaded != FALSE) {
+                        KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+                        StartTime = KiReadDpcTimeStamp();
+                        (DeferredRoutine)(Dpc, DeferredContext, SystemArgument1, SystemArgument2);// Call the DPC routine.
+                        ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+
+                        if (KiDpcHistogramEnabled != FALSE) {
+                            KiRecordDpcHistogram(&KiDpcHistogram[Prcb->Number].ExecutionTime[0], KiReadDpcTimeStamp() - StartTime);
+                        }
+
+                        KeLowerIrql(OldIrql);
+                    } else {
+                        (DeferredRoutine)(Dpc, DeferredContext, SystemArgument1, SystemArgument2);// Call the DPC routine.
+                    }
 
                     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
                     ASSERT(Thread->Affinity == Prcb->SetMember);
@@ -633,14 +652,18 @@ Arguments:
     PKDPC_DATA DpcData;
     PVOID DeferredContext;
     PKDEFERRED_ROUTINE DeferredRoutine;
+    PKDPC_HISTOGRAM Histogram;
     PERFINFO_DPC_INFORMATION DpcInformation;
+    ULONG64 ElapsedTime;
     PLIST_ENTRY Entry;
     PLIST_ENTRY ListHead;
     LOGICAL Logging;
+    ULONG64 StartTime = 0;
     PVOID SystemArgument1;
     PVOID SystemArgument2;
     ULONG_PTR TimerHand;
     LARGE_INTEGER TimeStamp = {0};
+    LOGICAL Timing;
 
     // Loop processing DPC list entries until the specified DPC list is empty.
     // N.B. This following code appears to have a redundant loop, but it does not.
@@ -648,6 +671,8 @@ Arguments:
     DpcData = &Prcb->DpcData[DPC_NORMAL];
     ListHead = &DpcData->DpcListHead;
     Logging = PERFINFO_IS_GROUP_ON(PERF_DPC);
+    Histogram = &KiDpcHistogram[Prcb->Number];
+    Timing = (KiDpcHistogramEnabled != FALSE) || ((KiDpcOffloadThreshold != 0) && (Prcb->ThreadDpcEnable != FALSE));
     do {
         Prcb->DpcRoutineActive = TRUE;
        
@@ -681,6 +706,19 @@ Arguments:
                     Prcb->DebugDpcTime = 0;
 #endif
 
+                    // If timing is enabled, then capture the start time and, if this is the first DPC since the queue became nonempty,
+                    // count the queue to execute latency.
+                    if (Timing != FALSE) {
+                        StartTime = KiReadDpcTimeStamp();
+                        if ((KiDpcHistogramEnabled != FALSE) && (Histogram->QueueTime != 0)) {
+                            if (StartTime > Histogram->QueueTime) {
+                                KiRecordDpcHistogram(&Histogram->QueueLatency[0], StartTime - Histogram->QueueTime);
+                            }
+
+                            Histogram->QueueTime = 0;
+                        }
+                    }
+
                     KeReleaseSpinLockFromDpcLevel(&DpcData->DpcLock);
 
                     _enable();
@@ -691,6 +729,20 @@ Arguments:
                     
                     (DeferredRoutine)(Dpc, DeferredContext, SystemArgument1, SystemArgument2);// Call the DPC routine.
                     ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+
+                    // If timing is enabled, then count the execution time and offload the deferred routine to the DPC thread if it ran too long.
+                    // N.B. The DPC object may have been freed by the deferred routine and must not be referenced.
+                    if (Timing != FALSE) {
+                        ElapsedTime = KiReadDpcTimeStamp() - StartTime;
+                        if (KiDpcHistogramEnabled != FALSE) {
+                            KiRecordDpcHistogram(&Histogram->ExecutionTime[0], ElapsedTime);
+                        }
+
+                        if ((KiDpcOffloadThreshold != 0) && (ElapsedTime > KiDpcOffloadThreshold) && (Prcb->ThreadDpcEnable != FALSE)) {
+                            KiOffloadDpcRoutine(DeferredRoutine);
+                            Histogram->OffloadCount += 1;
+                        }
+                    }
                     
                     if (Logging != FALSE) {// If event tracing is enabled, then log the start time and routine address.
                         DpcInformation.InitialTime = TimeStamp.QuadPart;
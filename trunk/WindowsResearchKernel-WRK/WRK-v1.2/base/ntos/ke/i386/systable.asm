@@ -389,8 +389,21 @@ TABLE_ENTRY  WaitForKeyedEvent, 1, 4
 TABLE_ENTRY  QueryPortInformationProcess, 0, 0
 TABLE_ENTRY  GetCurrentProcessorNumber, 0, 0
 TABLE_ENTRY  WaitForMultipleObjects32, 1, 5
+TABLE_ENTRY  RemoveIoCompletionEx, 1, 5
+TABLE_ENTRY  PrefetchVirtualMemory, 1, 3
+TABLE_ENTRY  AllocateVirtualMemoryRanges, 1, 6
+TABLE_ENTRY  FreeVirtualMemoryRanges, 1, 5
+TABLE_ENTRY  RegisterIoBuffer, 1, 3
+TABLE_ENTRY  UnregisterIoBuffer, 1, 1
+TABLE_ENTRY  RegisterIoHandle, 1, 2
+TABLE_ENTRY  UnregisterIoHandle, 1, 1
+TABLE_ENTRY  ReadFileRegistered, 1, 10
+TABLE_ENTRY  WriteFileRegistered, 1, 10
+TABLE_ENTRY  EnterIoRing, 1, 4
+TABLE_ENTRY  ReadFileVector, 1, 6
+TABLE_ENTRY  WriteFileVector, 1, 6
 
-TABLE_END 295
+TABLE_END 308
 
 ARGTBL_BEGIN
 ARGTBL_ENTRY 24,32,44,44,64,44,64,68
@@ -430,5 +443,7 @@ ARGTBL_ENTRY 24,8,8,8,0,16,16,4
 ARGTBL_ENTRY 4,8,8,20,16,8,8,16
 ARGTBL_ENTRY 20,12,4,4,36,36,24,20
 ARGTBL_ENTRY 0,16,12,16,16,0,0,20
+ARGTBL_ENTRY 20,12,24,20,12,4,8,4
+ARGTBL_ENTRY 40,40,16,24,24,0,0,0
 
 ARGTBL_END
@@ -17,6 +17,46 @@ Abstract:
 
 
 #if !defined(NT_UP)
+
+// Define the number of rings searched when stealing work from another processor (SMT set, node, system).
+#define KI_STEAL_RINGS 3
+
+
+FORCEINLINE PKPRCB KiFindBusiestProcessor (IN KAFFINITY Candidates)
+/*
+Routine Description:
+    This function selects the processor from the specified candidate set whose dispatcher ready queues hold the most urgent work.
+    The ready summary of each candidate is sampled without acquiring the PRCB lock.
+    Since bit n of the summary is set when priority n is populated, comparing summaries as integers orders processors by their highest ready priority and
+    then by the number of lower priority levels that are populated.
+    N.B. The sample is only a hint. The caller must revalidate the ready queues with the respective PRCB lock held.
+Arguments:
+    Candidates - Supplies the set of processors to examine.
+Return Value:
+    If a candidate has a nonempty ready summary, then the address of its PRCB is returned. Otherwise, NULL is returned.
+*/
+{
+    ULONG BestSummary;
+    PKPRCB BestPrcb;
+    ULONG Number;
+    ULONG ReadySummary;
+
+    BestPrcb = NULL;
+    BestSummary = 0;
+    while (Candidates != 0) {
+        KeFindFirstSetLeftAffinity(Candidates, &Number);
+        Candidates ^= AFFINITY_MASK(Number);
+        ReadySummary = *((volatile ULONG *)&KiProcessorBlock[Number]->ReadySummary);
+        if (ReadySummary > BestSummary) {
+            BestSummary = ReadySummary;
+            BestPrcb = KiProcessorBlock[Number];
+        }
+    }
+
+    return BestPrcb;
+}
+
+
 PKTHREAD FASTCALL KiIdleSchedule(PKPRCB CurrentPrcb)
 /*
 Routine Description:
@@ -32,11 +72,12 @@ Return Value:
     N.B. If a thread is found, then IRQL is returned at SYNCH_LEVEL. If a thread is not found, then IRQL is returned at DISPATCH_LEVEL.
 */
 {
-    LONG Index;
-    LONG Limit;
-    LONG Number;
+    KAFFINITY Candidates;
     PKTHREAD NewThread;
     ULONG Processor;
+    ULONG Ring;
+    KAFFINITY Scanned;
+    KAFFINITY SearchSet[KI_STEAL_RINGS];
     PKPRCB TargetPrcb;
 
     ASSERT(CurrentPrcb == KeGetCurrentPrcb());
@@ -68,70 +109,68 @@ Return Value:
             CurrentPrcb->CurrentThread = NewThread;
             NewThread->State = Running;
         } else {
-            // Release the current PRCB lock and attempt to select a thread from any processor dispatcher ready queues.
-            // If this is a multinode system, then start with the processors on the same node. Otherwise, start with the current processor.
+            // Release the current PRCB lock and attempt to steal a thread from another processor dispatcher ready queues.
+            // The search proceeds in widening rings: SMT siblings of the current processor, processors on the same node, and then all active processors.
+            // Within each ring the processor with the most urgent ready work is chosen first so the most loaded sibling is relieved before lightly loaded ones.
             KiReleasePrcbLock(CurrentPrcb);
             Processor = CurrentPrcb->Number;
-            Index = Processor;
-            if (KeNumberNodes > 1) {
-                KeFindFirstSetLeftAffinity(CurrentPrcb->ParentNode->ProcessorMask, (PULONG)&Index);
-            }
-
-            Limit = KeNumberProcessors - 1;
-            Number = Limit;
-            do {
-                TargetPrcb = KiProcessorBlock[Index];
-                if (CurrentPrcb != TargetPrcb) {
-                    if (TargetPrcb->ReadySummary != 0) {
-                        KiAcquireTwoPrcbLocks(CurrentPrcb, TargetPrcb);// Acquire the current and target PRCB locks.
-
-                        // If a new thread has not been selected to run on the current processor, then attempt to select a thread to run on the current processor.
-                        if ((NewThread = CurrentPrcb->NextThread) == NULL) {
-                            if ((TargetPrcb->ReadySummary != 0) && (NewThread = KiFindReadyThread(Processor, TargetPrcb)) != NULL) {
-                                // A new thread has been found to run on the current processor.
-                                NewThread->State = Running;
-                                KiReleasePrcbLock(TargetPrcb);
-                                CurrentPrcb->NextThread = NULL;
-                                CurrentPrcb->CurrentThread = NewThread;
-
-                                // Clear idle on the current processor and update the idle SMT summary set to indicate the set is not idle.
-                                KiClearIdleSummary(AFFINITY_MASK(Processor));
-                                KiClearSMTSummary(CurrentPrcb->MultiThreadProcessorSet);
-                                goto ThreadFound;
-                            } else {
-                                KiReleasePrcbLock(CurrentPrcb);
-                                KiReleasePrcbLock(TargetPrcb);
-                            }
+            Scanned = CurrentPrcb->SetMember;
+
+#if defined(NT_SMT)
+            SearchSet[0] = CurrentPrcb->MultiThreadProcessorSet;
+#else
+            SearchSet[0] = 0;
+#endif
+
+            SearchSet[1] = CurrentPrcb->ParentNode->ProcessorMask;
+            SearchSet[2] = KeActiveProcessors;
+            for (Ring = 0; Ring < KI_STEAL_RINGS; Ring += 1) {
+                Candidates = SearchSet[Ring] & ~Scanned;
+                Scanned |= Candidates;
+                while ((TargetPrcb = KiFindBusiestProcessor(Candidates)) != NULL) {
+                    Candidates &= ~TargetPrcb->SetMember;
+                    KiAcquireTwoPrcbLocks(CurrentPrcb, TargetPrcb);// Acquire the current and target PRCB locks.
+
+                    // If a new thread has not been selected to run on the current processor, then attempt to select a thread to run on the current processor.
+                    if ((NewThread = CurrentPrcb->NextThread) == NULL) {
+                        if ((TargetPrcb->ReadySummary != 0) && (NewThread = KiFindReadyThread(Processor, TargetPrcb)) != NULL) {
+                            // A new thread has been found to run on the current processor.
+                            NewThread->State = Running;
+                            KiReleasePrcbLock(TargetPrcb);
+                            CurrentPrcb->NextThread = NULL;
+                            CurrentPrcb->CurrentThread = NewThread;
+
+                            // Clear idle on the current processor and update the idle SMT summary set to indicate the set is not idle.
+                            KiClearIdleSummary(AFFINITY_MASK(Processor));
+                            KiClearSMTSummary(CurrentPrcb->MultiThreadProcessorSet);
+                            goto ThreadFound;
                         } else {
-                            // A thread has already been selected to run on the current processor.
-                            // It is possible that the thread is the idle thread due to a state change that made a scheduled runable thread unrunable.
-
-                            // N.B. If the idle thread is selected, then the current processor is idle.
-                            //      Otherwise, the current processor is not idle.
-                            if (NewThread == CurrentPrcb->IdleThread) {
-                                CurrentPrcb->NextThread = NULL;
-                                CurrentPrcb->IdleSchedule = FALSE;
-                                KiReleasePrcbLock(CurrentPrcb);
-                                KiReleasePrcbLock(TargetPrcb);
-                                continue;
-                            } else {
-                                NewThread->State = Running;
-                                KiReleasePrcbLock(TargetPrcb);
-                                CurrentPrcb->NextThread = NULL;
-                                CurrentPrcb->CurrentThread = NewThread;
-                                goto ThreadFound;
-                            }
+                            KiReleasePrcbLock(CurrentPrcb);
+                            KiReleasePrcbLock(TargetPrcb);
+                        }
+                    } else {
+                        // A thread has already been selected to run on the current processor.
+                        // It is possible that the thread is the idle thread due to a state change that made a scheduled runable thread unrunable.
+
+                        // N.B. If the idle thread is selected, then the current processor is idle.
+                        //      Otherwise, the current processor is not idle.
+                        if (NewThread == CurrentPrcb->IdleThread) {
+                            NewThread = NULL;
+                            CurrentPrcb->NextThread = NULL;
+                            CurrentPrcb->IdleSchedule = FALSE;
+                            KiReleasePrcbLock(CurrentPrcb);
+                            KiReleasePrcbLock(TargetPrcb);
+                            continue;
+                        } else {
+                            NewThread->State = Running;
+                            KiReleasePrcbLock(TargetPrcb);
+                            CurrentPrcb->NextThread = NULL;
+                            CurrentPrcb->CurrentThread = NewThread;
+                            goto ThreadFound;
                         }
                     }
                 }
-
-                Index -= 1;
-                if (Index < 0) {
-                    Index = Limit;
-                }
-
-                Number -= 1;
-            } while (Number >= 0);
+            }
         }
     }
 
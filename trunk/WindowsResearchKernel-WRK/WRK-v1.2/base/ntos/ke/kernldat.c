@@ -16,6 +16,14 @@ Abstract:
 // KiTimerTableListHead - This is an array of tiemr table entries that anchor the individual timer lists.
 DECLSPEC_CACHEALIGN KTIMER_TABLE_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
 
+// KiTimerWheel - This is the second level timer wheel that holds timers which are due beyond the next rotation of the timer table. It is partitioned by timer table lock.
+DECLSPEC_CACHEALIGN KTIMER_WHEEL KiTimerWheel[LOCK_QUEUE_TIMER_TABLE_LOCKS];
+
+KDPC KiTimerWheelDpc;// KiTimerWheelDpc - This is the DPC object that cascades timer wheel slots into the timer table.
+KTIMER KiTimerWheelTimer;// KiTimerWheelTimer - This is the periodic timer that drives the timer wheel cascade.
+volatile BOOLEAN KiTimerWheelActive = FALSE;// KiTimerWheelActive - Indicates whether long dated timers are inserted in the timer wheel.
+volatile LONG KiTimerCoalescedExpirations = 0;// KiTimerCoalescedExpirations - This is the number of timers inserted with the same due time as a timer already in the timer table.
+
 // KiQueuedLockTableSize - This is the size of the PRCB based numbered queued lock table used by the kernel debugger extensions.
 #if defined(_WIN64)
 #pragma comment(linker, "/include:KiQueuedLockTableSize")
@@ -165,6 +173,21 @@ KNODE KiNode0;// KeNodeBlock - This is an array of pointers to KNODE structures.
 
 UCHAR KeProcessNodeSeed;
 
+// KiAdaptiveSpinLimit - This is the number of iterations a contended mutant or guarded mutex acquire spins while the owner is running before blocking.
+//      The limit is tuned by the outcome of each spin.
+ULONG KiAdaptiveSpinLimit = 1024;
+
+// KiDpcHistogram - This is an array of per-processor histograms of DPC queue to execute latency and DPC execution time.
+//      The histograms are only collected when KiDpcHistogramEnabled is TRUE.
+DECLSPEC_CACHEALIGN KDPC_HISTOGRAM KiDpcHistogram[MAXIMUM_PROCESSORS];
+BOOLEAN KiDpcHistogramEnabled = FALSE;
+
+// KiDpcOffloadThreshold - This is the execution time in time stamp counter cycles beyond which the deferred routine of a normal DPC
+//      is recorded in KiDpcOffloadRoutine and subsequent DPCs for the routine are executed by the DPC thread. A value of zero disables offload.
+ULONG64 KiDpcOffloadThreshold = 0;
+PKDEFERRED_ROUTINE KiDpcOffloadRoutine[DPC_OFFLOAD_ENTRIES];
+volatile LONG KiDpcOffloadIndex = -1;
+
 #if defined(KE_MULTINODE)
 DECLSPEC_CACHEALIGN PKNODE KeNodeBlock[MAXIMUM_CCNUMA_NODES];
 #else
@@ -116,7 +116,13 @@ Return Value:
     ASSERT((Thread->PriorityDecrement >= 0) && (Thread->PriorityDecrement <= Thread->Priority));
     ASSERT((Thread->Priority < LOW_REALTIME_PRIORITY) ? TRUE : (Thread->PriorityDecrement == 0));
 
+    // If the thread has inherited the priority of a thread waiting for an object it owns, then the priority does not decay
+    // until the inherited priority is removed when the object is released.
     Priority = Thread->Priority;
+    if (Thread->PriorityInherited != FALSE) {
+        return Priority;
+    }
+
     if (Priority < LOW_REALTIME_PRIORITY) {
         Priority = Priority - Thread->PriorityDecrement - Adjustment;
         if (Priority < Thread->BasePriority) {
@@ -995,6 +1001,50 @@ typedef struct _KTIMER_TABLE_ENTRY {
 
 extern DECLSPEC_CACHEALIGN KTIMER_TABLE_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
 
+// Define the timer wheel.
+
+// The timer table holds timers that are due in the current or next rotation of the timer table hand.
+// Timers that are due further in the future are held unsorted in a second level wheel whose slots each span one full rotation of the timer table.
+// The wheel is partitioned by timer table lock so that a timer in the wheel is protected by the same lock as the timer table list selected by its hand.
+// Each partition records the latest rotation whose slot has been cascaded into the timer table.
+#define TIMER_WHEEL_SIZE 64
+
+C_ASSERT((TIMER_WHEEL_SIZE & (TIMER_WHEEL_SIZE - 1)) == 0);
+
+typedef struct _KTIMER_WHEEL {
+    ULONG64 Rotation;
+    LIST_ENTRY SlotListHead[TIMER_WHEEL_SIZE];
+} KTIMER_WHEEL, *PKTIMER_WHEEL;
+
+extern DECLSPEC_CACHEALIGN KTIMER_WHEEL KiTimerWheel[LOCK_QUEUE_TIMER_TABLE_LOCKS];
+extern KDPC KiTimerWheelDpc;
+extern KTIMER KiTimerWheelTimer;
+extern volatile BOOLEAN KiTimerWheelActive;
+extern volatile LONG KiTimerCoalescedExpirations;
+
+#define KiComputeTimerWheelPartition(Hand) \
+    (((Hand) >> LOCK_QUEUE_TIMER_LOCK_SHIFT) & (LOCK_QUEUE_TIMER_TABLE_LOCKS - 1))
+
+
+FORCEINLINE ULONG64 KiComputeTimerRotation (IN ULONG64 DueTime)
+/*
+Routine Description:
+    This function computes the timer table rotation in which the specified due time falls.
+    The formula for the rotation calculation is:
+    Rotation = (Due Time / Maximum time increment) / Table Size
+Arguments:
+    DueTime - Supplies the timer due time.
+Return Value:
+    The timer table rotation is returned as the function value.
+*/
+{
+#if defined(_WIN64)
+    return UnsignedMultiplyHigh(DueTime, KiTimeIncrementReciprocal.QuadPart) >> (KiTimeIncrementShiftCount + TIMER_TABLE_SHIFT);
+#else
+    return (DueTime / KeMaximumIncrement) >> TIMER_TABLE_SHIFT;
+#endif
+}
+
 
 FORCEINLINE VOID KiRemoveEntryTimer (__inout PKTIMER Timer)
 /*
@@ -1515,6 +1565,8 @@ BOOLEAN KiSwapProcess (IN PKPROCESS NewProcess, IN PKPROCESS OldProcess);
 LONG_PTR FASTCALL KiSwapThread (IN PKTHREAD OldThread, IN PKPRCB CurrentPrcb);
 VOID KiThreadStartup (IN PVOID StartContext);
 VOID KiTimerExpiration (IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2);
+VOID KiTimerWheelCascade (IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2);
+VOID KiStartTimerWheel (VOID);
 VOID FASTCALL KiTimerListExpire (IN PLIST_ENTRY ExpiredListHead, IN KIRQL OldIrql);
 VOID KiUnexpectedInterrupt (VOID);
 
@@ -1722,6 +1774,106 @@ IN KPROCESSOR_MODE PreviousMode,
 IN BOOLEAN FirstChance,
 OUT BOOLEAN *ExceptionForwarded);
 
+// Define DPC latency histogram and offload parameters.
+
+// N.B. Bucket N of a histogram counts samples of [2^N, 2^(N+1)) units of 2^DPC_HISTOGRAM_SHIFT time stamp counter cycles.
+//      Shorter samples are counted in the first bucket and longer samples are counted in the last bucket.
+#define DPC_HISTOGRAM_BUCKETS 16
+#define DPC_HISTOGRAM_SHIFT 10
+#define DPC_OFFLOAD_ENTRIES 8
+
+typedef struct _KDPC_HISTOGRAM {
+    ULONG64 QueueTime;
+    ULONG QueueLatency[DPC_HISTOGRAM_BUCKETS];
+    ULONG ExecutionTime[DPC_HISTOGRAM_BUCKETS];
+    ULONG OffloadCount;
+} KDPC_HISTOGRAM, *PKDPC_HISTOGRAM;
+
+#if defined(_AMD64_)
+#define KiReadDpcTimeStamp() ReadTimeStampCounter()
+#else
+#define KiReadDpcTimeStamp() ((ULONG64)RDTSC())
+#endif
+
+extern DECLSPEC_CACHEALIGN KDPC_HISTOGRAM KiDpcHistogram[MAXIMUM_PROCESSORS];
+extern BOOLEAN KiDpcHistogramEnabled;
+extern ULONG64 KiDpcOffloadThreshold;
+extern PKDEFERRED_ROUTINE KiDpcOffloadRoutine[DPC_OFFLOAD_ENTRIES];
+extern volatile LONG KiDpcOffloadIndex;
+
+
+FORCEINLINE VOID KiRecordDpcHistogram (IN PULONG Histogram, IN ULONG64 Cycles)
+/*
+Routine Description:
+    This function counts the specified number of cycles in the appropriate bucket of the specified histogram.
+Arguments:
+    Histogram - Supplies a pointer to an array of DPC_HISTOGRAM_BUCKETS counters.
+    Cycles - Supplies the sample in time stamp counter cycles.
+*/
+{
+    ULONG Index;
+
+    Cycles >>= DPC_HISTOGRAM_SHIFT;
+    if (Cycles == 0) {
+        Index = 0;
+    } else if (Cycles >= ((ULONG64)1 << (DPC_HISTOGRAM_BUCKETS - 1))) {
+        Index = DPC_HISTOGRAM_BUCKETS - 1;
+    } else {
+        BitScanReverse(&Index, (ULONG)Cycles);
+    }
+
+    Histogram[Index] += 1;
+}
+
+
+FORCEINLINE BOOLEAN KiIsDpcOffloaded (IN PKDPC Dpc)
+/*
+Routine Description:
+    This function determines whether the deferred routine of the specified normal DPC has exceeded the offload threshold
+    and should be executed by the DPC thread.
+Arguments:
+    Dpc - Supplies a pointer to a control object of type DPC.
+Return Value:
+    If the DPC should be executed by the DPC thread, then a value of TRUE is returned. Otherwise, a value of FALSE is returned.
+*/
+{
+    ULONG Index;
+
+    if ((KiDpcOffloadThreshold == 0) || (Dpc->Type != (UCHAR)DpcObject)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < DPC_OFFLOAD_ENTRIES; Index += 1) {
+        if (KiDpcOffloadRoutine[Index] == Dpc->DeferredRoutine) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+FORCEINLINE VOID KiOffloadDpcRoutine (IN PKDEFERRED_ROUTINE DeferredRoutine)
+/*
+Routine Description:
+    This function records the specified deferred routine as one whose DPCs are executed by the DPC thread.
+    The oldest entry is replaced if the offload table is full.
+Arguments:
+    DeferredRoutine - Supplies the address of the deferred routine that exceeded the offload threshold.
+*/
+{
+    ULONG Index;
+
+    for (Index = 0; Index < DPC_OFFLOAD_ENTRIES; Index += 1) {
+        if (KiDpcOffloadRoutine[Index] == DeferredRoutine) {
+            return;
+        }
+    }
+
+    Index = (ULONG)InterlockedIncrement(&KiDpcOffloadIndex) % DPC_OFFLOAD_ENTRIES;
+    KiDpcOffloadRoutine[Index] = DeferredRoutine;
+}
+
 // External references to private kernel data structures
 extern PMESSAGE_RESOURCE_DATA  KiBugCodeMessages;
 extern FAST_MUTEX KiGenericCallDpcMutex;
@@ -1730,6 +1882,7 @@ extern ULONG KiIdealDpcRate;
 extern LONG KiMaximumDpcQueueDepth;
 extern ULONG KiMinimumDpcRate;
 extern ULONG KiAdjustDpcThreshold;
+extern ULONG KiAdaptiveSpinLimit;
 extern PKDEBUG_ROUTINE KiDebugRoutine;
 extern PKDEBUG_SWITCH_ROUTINE KiDebugSwitchRoutine;
 extern CALL_PERFORMANCE_DATA KiFlushSingleCallData;
@@ -60,6 +60,8 @@ Return Value:
     PKPRCB Prcb;
     NTSTATUS Status;
 
+    KiStartTimerWheel();// Start cascading long dated timers through the timer wheel.
+
     // If threaded DPCs are enabled for the host system, then create a DPC thread for each processor.
     if (KeThreadDpcEnable != FALSE) {
         Index = 0;
@@ -241,6 +243,12 @@ Routine Description:
         KiTimerTableListHead[Index].Time.LowPart = 0;
     }
 
+    // Initialize the timer wheel slot listheads.
+    // N.B. The timer wheel is not used until it is started during phase 1 initialization.
+    for (Index = 0; Index < (LOCK_QUEUE_TIMER_TABLE_LOCKS * TIMER_WHEEL_SIZE); Index += 1) {
+        InitializeListHead(&KiTimerWheel[Index / TIMER_WHEEL_SIZE].SlotListHead[Index % TIMER_WHEEL_SIZE]);
+    }
+
     // Initialize the swap event, the process inswap listhead, the process outswap listhead, and the kernel stack inswap listhead.
     KeInitializeEvent(&KiSwapEvent, SynchronizationEvent, FALSE);
     KiProcessInSwapListHead.Next = NULL;
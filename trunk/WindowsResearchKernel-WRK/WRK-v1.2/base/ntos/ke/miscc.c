@@ -189,6 +189,23 @@ Arguments:
             KiReleaseTimerTableLock(LockQueue);
         }
 
+        // Remove all absolute timers from the timer wheel.
+        for (Index = 0; Index < (LOCK_QUEUE_TIMER_TABLE_LOCKS * TIMER_WHEEL_SIZE); Index += 1) {
+            ListHead = &KiTimerWheel[Index / TIMER_WHEEL_SIZE].SlotListHead[Index % TIMER_WHEEL_SIZE];
+            LockQueue = KiAcquireTimerTableLock((Index / TIMER_WHEEL_SIZE) << LOCK_QUEUE_TIMER_LOCK_SHIFT);
+            NextEntry = ListHead->Flink;
+            while (NextEntry != ListHead) {
+                Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
+                NextEntry = NextEntry->Flink;
+                if (Timer->Header.Absolute != FALSE) {
+                    KiRemoveEntryTimer(Timer);
+                    InsertTailList(&AbsoluteListHead, &Timer->TimerListEntry);
+                }
+            }
+
+            KiReleaseTimerTableLock(LockQueue);
+        }
+
         // Recompute the due time and reinsert all absolute timers in the timer tree. If a timer has already expired, then insert the timer in the expired timer list.
         InitializeListHead(&ExpiredListHead);
         while (AbsoluteListHead.Flink != &AbsoluteListHead) {
@@ -153,6 +153,11 @@ Return Value:
         if (OldState <= 0) {
             RemoveEntryList(&Mutant->MutantListEntry);
             LeaveCriticalRegion = Mutant->ApcDisable;
+
+            // If the owner thread inherited priority from a waiter, then remove the inherited priority now that the mutant is released.
+            if (Mutant->OwnerThread->PriorityInherited != FALSE) {
+                KiRemoveInheritedPriority(Mutant->OwnerThread);
+            }
         }
 
         Mutant->OwnerThread = (PKTHREAD)NULL;
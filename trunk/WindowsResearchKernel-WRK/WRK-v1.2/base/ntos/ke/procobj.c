@@ -572,8 +572,10 @@ Return Value:
     Process->Affinity = Affinity;
 
     // If the new affinity does not intersect with the process ideal node affinity, then select a new process ideal node.
+    // N.B. A preferred node that does not intersect the new affinity is discarded.
 #if !defined(NT_UP)
     if ((Affinity & KeNodeBlock[Process->IdealNode]->ProcessorMask) == 0) {
+        InterlockedBitTestAndReset(&Process->ProcessFlags, KPROCESS_PREFERRED_NODE_BIT);
         KiSetIdealNodeProcess(Process, Affinity);
     }
 #endif
@@ -594,6 +596,87 @@ Return Value:
 }
 
 
+BOOLEAN KeSetIdealNodeProcess(__inout PKPROCESS Process, __in ULONG NodeNumber)
+/*
+Routine Description:
+    This function sets the preferred node of a process.
+    The preferred node becomes the ideal node of the process, threads of the process whose ideal processor is not on the preferred node are given an ideal processor on the node,
+    and page and pool allocations made from the context of the process threads are satisfied from the memory local to the node when possible.
+    N.B. The preferred node is discarded if the process affinity is later changed so that it does not intersect the node.
+Arguments:
+    Process - Supplies a pointer to a dispatcher object of type process.
+    NodeNumber - Supplies the number of the preferred node.
+Return Value:
+    If the specified node exists and intersects the process affinity, then a value of TRUE is returned. Otherwise, a value of FALSE is returned.
+*/
+{
+
+#if !defined(NT_UP)
+    ULONG IdealProcessor;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PLIST_ENTRY NextEntry;
+    PKNODE Node;
+    KAFFINITY PreferredSet;
+    PKTHREAD Thread;
+#endif
+
+    ASSERT_PROCESS(Process);
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+#if defined(NT_UP)
+    return (BOOLEAN)(NodeNumber == 0);
+#else
+    if (NodeNumber >= KeNumberNodes) {
+        return FALSE;
+    }
+
+    // Raise IRQL to SYNCH_LEVEL, acquire the process lock, and acquire the dispatcher database lock at SYNCH_LEVEL.
+    KeAcquireInStackQueuedSpinLockRaiseToSynch(&Process->ProcessLock, &LockHandle);
+    KiLockDispatcherDatabaseAtSynchLevel();
+
+    // If the node does not intersect the process affinity, then the node cannot be preferred.
+    Node = KeNodeBlock[NodeNumber];
+    if ((Node->ProcessorMask & Process->Affinity) == 0) {
+        KiUnlockDispatcherDatabaseFromSynchLevel();
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
+        return FALSE;
+    }
+
+    // Set the ideal node of the process and mark it as preferred.
+    if (Process->IdealNode != (UCHAR)NodeNumber) {
+        Process->IdealNode = (UCHAR)NodeNumber;
+        Process->ThreadSeed = (UCHAR)KeFindNextRightSetAffinity(Node->Seed, Node->ProcessorMask & Process->Affinity);
+        Node->Seed = Process->ThreadSeed;
+    }
+
+    InterlockedBitTestAndSet(&Process->ProcessFlags, KPROCESS_PREFERRED_NODE_BIT);
+
+    // Move the ideal processor of each process thread that is not on the preferred node to the node, distributing the threads across the node processors.
+
+    // N.B. Threads whose user affinity does not intersect the node and threads running with system affinity are not changed.
+    NextEntry = Process->ThreadListHead.Flink;
+    while (NextEntry != &Process->ThreadListHead) {
+        Thread = CONTAINING_RECORD(NextEntry, KTHREAD, ThreadListEntry);
+        PreferredSet = Node->ProcessorMask & Thread->UserAffinity;
+        if ((Thread->SystemAffinityActive == FALSE) && (PreferredSet != 0) && ((PreferredSet & AFFINITY_MASK(Thread->UserIdealProcessor)) == 0)) {
+            IdealProcessor = KeFindNextRightSetAffinity(Process->ThreadSeed, PreferredSet);
+            Process->ThreadSeed = (UCHAR)IdealProcessor;
+            Thread->UserIdealProcessor = (UCHAR)IdealProcessor;
+            Thread->IdealProcessor = (UCHAR)IdealProcessor;
+        }
+
+        NextEntry = NextEntry->Flink;
+    }
+
+    // Unlock dispatcher database, unlock the process lock, and lower IRQL to its previous value.
+    KiUnlockDispatcherDatabaseFromSynchLevel();
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+    return TRUE;
+#endif
+
+}
+
+
 KPRIORITY KeSetPriorityAndQuantumProcess(__inout PKPROCESS Process, __in KPRIORITY NewBase, __in SCHAR QuantumReset)
 /*
 Routine Description:
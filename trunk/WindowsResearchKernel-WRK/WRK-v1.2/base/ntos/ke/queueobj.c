@@ -145,6 +145,44 @@ Return Value:
     Thread->WaitTime= KiQueryLowTickCount()
 
 
+FORCEINLINE ULONG KiRemoveQueueEntries(IN OUT PRKQUEUE Queue, OUT PLIST_ENTRY* EntryArray, IN ULONG Number, IN ULONG Count)
+/*
+Routine Description:
+    This function removes entries from the Queue object entry list until the list is empty or the entry array is full.
+    N.B. This function must be called with the dispatcher database locked.
+    N.B. The entries are removed on behalf of a thread that is already counted as active, so the current count is not changed.
+Arguments:
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+    EntryArray - Supplies a pointer to an array that receives the addresses of the removed entries.
+    Number - Supplies the number of entries already stored in the entry array.
+    Count - Supplies the number of elements in the entry array.
+Return Value:
+    The number of entries stored in the entry array.
+*/
+{
+    PLIST_ENTRY Entry;
+
+    while (Number < Count) {
+        Entry = Queue->EntryListHead.Flink;
+        if (Entry == &Queue->EntryListHead) {
+            break;
+        }
+
+        Queue->Header.SignalState -= 1;
+        if ((Entry->Flink == NULL) || (Entry->Blink == NULL)) {
+            KeBugCheckEx(INVALID_WORK_QUEUE_ITEM, (ULONG_PTR)Entry, (ULONG_PTR)Queue, (ULONG_PTR)&ExWorkerQueue[0], (ULONG_PTR)((PWORK_QUEUE_ITEM)Entry)->WorkerRoutine);
+        }
+
+        RemoveEntryList(Entry);
+        Entry->Flink = NULL;
+        EntryArray[Number] = Entry;
+        Number += 1;
+    }
+
+    return Number;
+}
+
+
 PLIST_ENTRY KeRemoveQueue(__inout PRKQUEUE Queue, __in KPROCESSOR_MODE WaitMode, __in_opt PLARGE_INTEGER Timeout)
 /*
 Routine Description:
@@ -159,12 +197,43 @@ Return Value:
     The address of the entry removed from the Queue object entry list or STATUS_TIMEOUT.
     N.B. These values can easily be distinguished by the fact that all addresses in kernel mode have the high order bit set.
 */
+{
+    PLIST_ENTRY Entry;
+
+    KeRemoveQueueEx(Queue, WaitMode, Timeout, &Entry, 1);
+    return Entry;
+}
+
+
+ULONG KeRemoveQueueEx(__inout PRKQUEUE Queue,
+                      __in KPROCESSOR_MODE WaitMode,
+                      __in_opt PLARGE_INTEGER Timeout,
+                      __out_ecount(Count) PLIST_ENTRY* EntryArray,
+                      __in ULONG Count
+)
+/*
+Routine Description:
+    This function removes up to the specified number of entries from the Queue object entry list.
+    If no list entry is available, then the calling thread is put in a wait state until at least one entry is available.
+    All of the entries are removed with a single acquisition of the dispatcher database lock, and the calling thread is counted as one active thread of the queue regardless of the number of entries it removes.
+    N.B. The wait discipline for Queue object LIFO.
+Arguments:
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+    WaitMode  - Supplies the processor mode in which the wait is to occur.
+    Timeout - Supplies a pointer to an optional absolute of relative time over which the wait is to occur.
+    EntryArray - Supplies a pointer to an array that receives the addresses of the entries removed from the Queue object entry list.
+    Count - Supplies the number of elements in the entry array. This value must be at least one.
+Return Value:
+    The number of entries stored in the entry array.
+    N.B. If the wait is ended by a timeout or a user APC, then one is returned and the first element of the entry array receives STATUS_TIMEOUT or STATUS_USER_APC.
+*/
 {
     PKPRCB CurrentPrcb;
     LARGE_INTEGER DueTime;
     PLIST_ENTRY Entry;
     ULONG Hand;
     LARGE_INTEGER NewTime;
+    ULONG Number;
     PRKQUEUE OldQueue;
     PLARGE_INTEGER OriginalTime;
     LOGICAL StackSwappable;
@@ -175,9 +244,11 @@ Return Value:
     PRKWAIT_BLOCK WaitTimer;
 
     ASSERT_QUEUE(Queue);
+    ASSERT(Count != 0);
 
     // Set constant variables.
     Hand = 0;
+    Number = 1;
     OriginalTime = Timeout;
     Thread = KeGetCurrentThread();
     Timer = &Thread->Timer;
@@ -232,6 +303,8 @@ Return Value:
 
             RemoveEntryList(Entry);
             Entry->Flink = NULL;
+            EntryArray[0] = Entry;
+            Number = KiRemoveQueueEntries(Queue, EntryArray, 1, Count);// Remove any further entries that fit in the entry array.
             break;
         } else {
             // Test to determine if a kernel APC is pending.
@@ -249,7 +322,7 @@ Return Value:
             } else {
                 // Test if a user APC is pending.
                 if ((WaitMode != KernelMode) && (Thread->ApcState.UserApcPending)) {
-                    Entry = (PLIST_ENTRY)ULongToPtr(STATUS_USER_APC);
+                    EntryArray[0] = (PLIST_ENTRY)ULongToPtr(STATUS_USER_APC);
                     Queue->CurrentCount += 1;
                     break;
                 }
@@ -261,7 +334,7 @@ Return Value:
                     // N.B. The constant fields of the timer wait block are initialized when the thread is initialized.
                     //      The constant fields include the wait object, wait key, wait type, and the wait list entry link pointers.
                     if (KiCheckDueTime(Timer) == FALSE) {
-                        Entry = (PLIST_ENTRY)ULongToPtr(STATUS_TIMEOUT);
+                        EntryArray[0] = (PLIST_ENTRY)ULongToPtr(STATUS_TIMEOUT);
                         Queue->CurrentCount += 1;
                         break;
                     }
@@ -290,9 +363,24 @@ Return Value:
                 WaitStatus = KiSwapThread(Thread, CurrentPrcb);
 
                 // If the thread was not awakened to deliver a kernel mode APC, then return wait status.
+
+                // N.B. A thread that is awakened by the insertion of an entry receives the entry as its wait status.
+                //      If more entries were inserted before the thread ran and the entry array has room for them, then remove them too.
                 Thread->WaitReason = 0;
                 if (WaitStatus != STATUS_KERNEL_APC) {
-                    return (PLIST_ENTRY)WaitStatus;
+                    EntryArray[0] = (PLIST_ENTRY)WaitStatus;
+                    if ((Count > 1) &&
+                        (WaitStatus != STATUS_TIMEOUT) &&
+                        (WaitStatus != STATUS_USER_APC) &&
+                        (Queue->EntryListHead.Flink != &Queue->EntryListHead)) {
+                        Thread->WaitIrql = KeRaiseIrqlToSynchLevel();
+                        KiLockDispatcherDatabaseAtSynchLevel();
+                        Number = KiRemoveQueueEntries(Queue, EntryArray, 1, Count);
+                        KiUnlockDispatcherDatabaseFromSynchLevel();
+                        KiExitDispatcher(Thread->WaitIrql);
+                    }
+
+                    return Number;
                 }
 
                 if (ARGUMENT_PRESENT(Timeout)) {
@@ -309,10 +397,10 @@ Return Value:
         }
     } while (TRUE);
 
-    // Unlock the dispatcher database, exit the dispatcher, and return the list entry address or a status of timeout.
+    // Unlock the dispatcher database, exit the dispatcher, and return the number of entries removed or a status of timeout.
     KiUnlockDispatcherDatabaseFromSynchLevel();
     KiExitDispatcher(Thread->WaitIrql);
-    return Entry;
+    return Number;
 }
 
 
@@ -106,4 +106,58 @@ Return Value:
     }
 
     return OldState;// Return previous signal state of semaphore object.
-}
\ No newline at end of file
+}
+
+
+LONG KeReleaseSemaphoreHandoff (__inout PRKSEMAPHORE Semaphore, __in KPRIORITY Increment, __in LONG Adjustment)
+/*
+Routine Description:
+    This function releases a semaphore like KeReleaseSemaphore and hands the current processor to the thread whose wait is satisfied.
+    It is used by callers that release a semaphore and then immediately wait for the released thread to answer,
+    such as a synchronous LPC request and its reply. Instead of dispatching the released thread to another processor and
+    blocking the current one, the released thread is selected to run next on the current processor.
+    N.B. The priorities of both threads are respected. If the released thread cannot run on the current processor,
+         or a higher priority thread is ready on the current processor, it is readied normally.
+Arguments:
+    Semaphore - Supplies a pointer to a dispatcher object of type semaphore.
+    Increment - Supplies the priority increment that is to be applied if releasing the semaphore causes a Wait to be satisfied.
+    Adjustment - Supplies value that is to be added to the current semaphore count.
+Return Value:
+    The previous signal state of the semaphore object.
+*/
+{
+    LONG NewState;
+    KIRQL OldIrql;
+    LONG OldState;
+    PRKTHREAD Thread;
+
+    ASSERT_SEMAPHORE( Semaphore );
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    Thread = KeGetCurrentThread();
+    KiLockDispatcherDatabase(&OldIrql);// Raise IRQL to dispatcher level and lock dispatcher database.
+
+    // Capture the current signal state of the semaphore object and compute the new count value.
+    OldState = ReadForWriteAccess(&Semaphore->Header.SignalState);
+    NewState = OldState + Adjustment;
+
+    // If the new state value is greater than the limit or a carry occurs, then unlock the dispatcher database, and raise an exception.
+    if ((NewState > Semaphore->Limit) || (NewState < OldState)) {
+        KiUnlockDispatcherDatabase(OldIrql);
+        ExRaiseStatus(STATUS_SEMAPHORE_LIMIT_EXCEEDED);
+    }
+
+    // Set the new signal state of the semaphore object.
+    // If the previous signal state was Not-Signaled (i.e. the count was zero), and the wait queue is not empty,
+    // then satisfy the waits with a direct handoff requested for the current thread.
+    Semaphore->Header.SignalState = NewState;
+    if ((OldState == 0) && (IsListEmpty(&Semaphore->Header.WaitListHead) == FALSE)) {
+        Thread->DirectHandoff = TRUE;
+        KiWaitTest(Semaphore, Increment);
+    }
+
+    // Unlock the dispatcher database. The deferred ready list is processed on the way out, so the handoff, if taken, happens here.
+    KiUnlockDispatcherDatabase(OldIrql);
+    Thread->DirectHandoff = FALSE;
+    return OldState;// Return previous signal state of semaphore object.
+}
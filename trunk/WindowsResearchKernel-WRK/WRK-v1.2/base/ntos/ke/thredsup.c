@@ -16,6 +16,12 @@ Environment:
 
 #include "ki.h"
 
+// Define the minimum number of entries in the deferred ready list for which the batched deferred ready path is used.
+#define KI_DEFERRED_READY_BATCH_MINIMUM 8
+
+// Define the maximum number of owner threads a priority inheritance chain is followed through.
+#define KI_PRIORITY_INHERITANCE_DEPTH 8
+
 
 VOID KiSuspendNop(IN PKAPC Apc, IN OUT PKNORMAL_ROUTINE *NormalRoutine, IN OUT PVOID *NormalContext, IN OUT PVOID *SystemArgument1, IN OUT PVOID *SystemArgument2)
 /*
@@ -54,50 +60,17 @@ Arguments:
 }
 
 
-VOID FASTCALL KiDeferredReadyThread(IN PKTHREAD Thread)
+FORCEINLINE VOID KiAdjustDeferredReadyPriority(IN PKTHREAD Thread)
 /*
 Routine Description:
-    This function readies a thread for execution and attempts to dispatch the thread for execution by either assigning the thread to an idle processor or preempting another lower priority thread.
-
-    If the thread can be assigned to an idle processor, then the thread enters the standby state and the target processor will switch to the thread on its next iteration of the idle loop.
-
-    If a lower priority thread can be preempted, then the thread enters the standby state and the target processor is requested to dispatch.
-
-    If the thread cannot be assigned to an idle processor and another thread cannot be preempted,
-    then the specified thread is inserted at the head or tail of the dispatcher ready selected by its priority depending on whether it was preempted or not.
-
+    This function applies the priority and quantum adjustment that was requested when the specified thread was placed in the deferred ready state.
     N.B. This function is called at SYNCH level with no PRCB locks held.
-    N.B. This function may be called with the dispatcher database lock held.
-    N.B. Neither the priority nor the affinity of a thread in the deferred ready state can be changed outside the PRCB lock of the respective processor.
 Arguments:
     Thread - Supplies a pointer to a dispatcher object of type thread.
 */
 {
-    PKPRCB CurrentPrcb;
-    BOOLEAN Preempted;
     KPRIORITY Priority;
     PKPROCESS Process;
-    ULONG Processor;
-    PKPRCB TargetPrcb;
-    KPRIORITY ThreadPriority;
-    PKTHREAD Thread1;
-
-#if !defined(NT_UP)
-    KAFFINITY Affinity;
-    ULONG IdealProcessor;
-    KAFFINITY IdleSummary;
-
-#if defined(NT_SMT)
-    KAFFINITY FavoredSMTSet;
-    KAFFINITY IdleSMTSet;
-#endif
-
-    KAFFINITY IdleSet;
-    PKNODE Node;
-#endif
-
-    ASSERT(Thread->State == DeferredReady);
-    ASSERT((Thread->Priority >= 0) && (Thread->Priority <= HIGH_PRIORITY));
 
     // Check if a priority adjustment is requested.
     if (Thread->AdjustReason == AdjustNone) {
@@ -200,6 +173,55 @@ Arguments:
         ASSERT(FALSE);
         Thread->AdjustReason = AdjustNone;
     }
+}
+
+
+VOID FASTCALL KiDeferredReadyThread(IN PKTHREAD Thread)
+/*
+Routine Description:
+    This function readies a thread for execution and attempts to dispatch the thread for execution by either assigning the thread to an idle processor or preempting another lower priority thread.
+
+    If the current thread requested a direct handoff, then the thread enters the standby state on the current processor and runs as soon as the current thread leaves the dispatcher.
+
+    If the thread can be assigned to an idle processor, then the thread enters the standby state and the target processor will switch to the thread on its next iteration of the idle loop.
+
+    If a lower priority thread can be preempted, then the thread enters the standby state and the target processor is requested to dispatch.
+
+    If the thread cannot be assigned to an idle processor and another thread cannot be preempted,
+    then the specified thread is inserted at the head or tail of the dispatcher ready selected by its priority depending on whether it was preempted or not.
+
+    N.B. This function is called at SYNCH level with no PRCB locks held.
+    N.B. This function may be called with the dispatcher database lock held.
+    N.B. Neither the priority nor the affinity of a thread in the deferred ready state can be changed outside the PRCB lock of the respective processor.
+Arguments:
+    Thread - Supplies a pointer to a dispatcher object of type thread.
+*/
+{
+    PKPRCB CurrentPrcb;
+    BOOLEAN Preempted;
+    ULONG Processor;
+    PKPRCB TargetPrcb;
+    KPRIORITY ThreadPriority;
+    PKTHREAD Thread1;
+
+#if !defined(NT_UP)
+    KAFFINITY Affinity;
+    ULONG IdealProcessor;
+    KAFFINITY IdleSummary;
+
+#if defined(NT_SMT)
+    KAFFINITY FavoredSMTSet;
+    KAFFINITY IdleSMTSet;
+#endif
+
+    KAFFINITY IdleSet;
+    PKNODE Node;
+#endif
+
+    ASSERT(Thread->State == DeferredReady);
+    ASSERT((Thread->Priority >= 0) && (Thread->Priority <= HIGH_PRIORITY));
+
+    KiAdjustDeferredReadyPriority(Thread);// Apply any pending priority adjustment.
 
     // Save the value of thread's preempted flag and set thread preempted FALSE,
     Preempted = Thread->Preempted;
@@ -227,8 +249,27 @@ Arguments:
     ThreadPriority = Thread->Priority;
 #else
 
-    CurrentPrcb = KeGetCurrentPrcb();// Attempt to assign the thread on an idle processor.
+    CurrentPrcb = KeGetCurrentPrcb();
+
+    // If the current thread released the object the thread waited on and is about to wait for the thread's answer, then hand the current processor to the thread.
+    // The handoff is only done once per request, and only if no ready thread on the current processor has a higher priority.
+    Thread1 = CurrentPrcb->CurrentThread;
+    if ((Thread1->DirectHandoff != FALSE) && ((Thread->Affinity & CurrentPrcb->SetMember) != 0)) {
+        Thread1->DirectHandoff = FALSE;
+        KiAcquirePrcbLock(CurrentPrcb);
+        ThreadPriority = Thread->Priority;
+        if ((CurrentPrcb->NextThread == NULL) && (((CurrentPrcb->ReadySummary >> ThreadPriority) >> 1) == 0)) {
+            Thread->State = Standby;
+            Thread->NextProcessor = (UCHAR)CurrentPrcb->Number;
+            CurrentPrcb->NextThread = Thread;
+            KiReleasePrcbLock(CurrentPrcb);
+            return;
+        }
+
+        KiReleasePrcbLock(CurrentPrcb);
+    }
 
+    // Attempt to assign the thread on an idle processor.
 IdleAssignment:
     Affinity = Thread->Affinity;
     do {
@@ -238,13 +279,8 @@ IdleAssignment:
             if ((IdleSet & AFFINITY_MASK(Processor)) == 0) {
                 // Ideal processor is not available.
 
-                // If the intersection of the idle set and the node affinity is nonzero, then reduce the set of idle processors by the node affinity.
-                Node = KiProcessorBlock[Processor]->ParentNode;
-                if ((IdleSet & Node->ProcessorMask) != 0) {
-                    IdleSet &= Node->ProcessorMask;
-                }
-
                 // If the intersection of the idle set and the SMT idle set is nonzero, then reduce the set of idle processors by the SMT idle set.
+                // N.B. The SMT reduction is made before the node reduction so that a fully idle physical processor is preferred over an idle sibling of a busy physical processor, even when the latter is on the ideal node.
 #if defined(NT_SMT)
                 IdleSMTSet = KiIdleSMTSummary;
                 if ((IdleSet & IdleSMTSet) != 0) {
@@ -252,6 +288,12 @@ IdleAssignment:
                 }
 #endif
 
+                // If the intersection of the idle set and the node affinity is nonzero, then reduce the set of idle processors by the node affinity.
+                Node = KiProcessorBlock[Processor]->ParentNode;
+                if ((IdleSet & Node->ProcessorMask) != 0) {
+                    IdleSet &= Node->ProcessorMask;
+                }
+
                 // If the last processor the thread ran on is included in the idle set, then attempt to select that processor.
                 IdealProcessor = Processor;
                 Processor = Thread->NextProcessor;
@@ -439,6 +481,9 @@ VOID FASTCALL KiProcessDeferredReadyList(IN PKPRCB CurrentPrcb)
 /*
 Routine Description:
     This function is called to process the deferred ready list.
+    If the list holds a wakeup burst (e.g., a notification event with many waiters was set), then the threads that cannot be assigned to an idle processor are
+    sorted by target processor and each batch is delivered with one acquisition of the target PRCB lock and at most one dispatch interrupt per target.
+    Otherwise, each thread is readied individually.
     N.B. This function is called at SYNCH level with no locks held.
     N.B. This routine is only called when it is known that the deferred ready list is not empty.
     N.B. The deferred ready list is a per processor list and items are only inserted and removed from the respective processor. Thus no synchronization of the list is required.
@@ -446,22 +491,146 @@ Arguments:
     CurrentPrcb - Supplies a pointer to the current processor's PRCB.
 */
 {
+    SINGLE_LIST_ENTRY BatchListHead[MAXIMUM_PROCESSORS];
+    ULONG Count;
+    PSINGLE_LIST_ENTRY FirstEntry;
     PSINGLE_LIST_ENTRY NextEntry;
+    BOOLEAN Preempted;
+    ULONG Processor;
+    BOOLEAN RequestInterrupt;
+    SINGLE_LIST_ENTRY RetryListHead;
+    KAFFINITY TargetSet;
+    PKPRCB TargetPrcb;
     PKTHREAD Thread;
+    PKTHREAD Thread1;
+    KPRIORITY ThreadPriority;
 
     ASSERT(CurrentPrcb->DeferredReadyListHead.Next != NULL);
 
     // Save the address of the first entry in the deferred ready list and set the list to empty.
-    NextEntry = CurrentPrcb->DeferredReadyListHead.Next;
+    FirstEntry = CurrentPrcb->DeferredReadyListHead.Next;
     CurrentPrcb->DeferredReadyListHead.Next = NULL;
 
-    // Process each entry in deferred ready list and ready the specified thread for execution.
+    // If the deferred ready list is short, then process each entry in deferred ready list and ready the specified thread for execution.
+    Count = 0;
+    NextEntry = FirstEntry;
+    do {
+        Count += 1;
+        NextEntry = NextEntry->Next;
+    } while ((NextEntry != NULL) && (Count < KI_DEFERRED_READY_BATCH_MINIMUM));
+
+    NextEntry = FirstEntry;
+    if (Count < KI_DEFERRED_READY_BATCH_MINIMUM) {
+        do {
+            Thread = CONTAINING_RECORD(NextEntry, KTHREAD, SwapListEntry);
+            NextEntry = NextEntry->Next;
+            KiDeferredReadyThread(Thread);
+        } while (NextEntry != NULL);
+
+        ASSERT(CurrentPrcb->DeferredReadyListHead.Next == NULL);
+        return;
+    }
+
+    // The deferred ready list holds a wakeup burst.
+
+    // Threads that can run on an idle processor are readied individually since each one claims a different idle processor.
+    // The remaining threads can only be queued on or preempt their ideal processor and are sorted into per processor batches.
+    TargetSet = 0;
     do {
         Thread = CONTAINING_RECORD(NextEntry, KTHREAD, SwapListEntry);
         NextEntry = NextEntry->Next;
-        KiDeferredReadyThread(Thread);
+        if ((KiIdleSummary & Thread->Affinity) != 0) {
+            KiDeferredReadyThread(Thread);
+        } else {
+            KiAdjustDeferredReadyPriority(Thread);
+            Processor = Thread->IdealProcessor;
+            if ((TargetSet & AFFINITY_MASK(Processor)) == 0) {
+                TargetSet |= AFFINITY_MASK(Processor);
+                BatchListHead[Processor].Next = NULL;
+            }
+
+            PushEntryList(&BatchListHead[Processor], &Thread->SwapListEntry);
+        }
     } while (NextEntry != NULL);
 
+    // Deliver each batch under a single acquisition of the current and target PRCB locks.
+
+    // N.B. Threads whose target processor became idle or whose ideal processor changed, and standby threads that are displaced by a higher priority thread,
+    //      are collected in the retry list and readied individually after the locks are released.
+    RetryListHead.Next = NULL;
+    while (TargetSet != 0) {
+        KeFindFirstSetLeftAffinity(TargetSet, &Processor);
+        TargetSet ^= AFFINITY_MASK(Processor);
+        TargetPrcb = KiProcessorBlock[Processor];
+        RequestInterrupt = FALSE;
+        NextEntry = BatchListHead[Processor].Next;
+        KiAcquireTwoPrcbLocks(CurrentPrcb, TargetPrcb);
+        do {
+            Thread = CONTAINING_RECORD(NextEntry, KTHREAD, SwapListEntry);
+            NextEntry = NextEntry->Next;
+            if (((KiIdleSummary & TargetPrcb->SetMember) != 0) || (Thread->IdealProcessor != Processor)) {
+                PushEntryList(&RetryListHead, &Thread->SwapListEntry);
+                continue;
+            }
+
+            ASSERT((Thread->Affinity & TargetPrcb->SetMember) != 0);
+
+            Preempted = Thread->Preempted;
+            Thread->Preempted = FALSE;
+            Thread->NextProcessor = (UCHAR)Processor;
+            ThreadPriority = Thread->Priority;
+            if ((Thread1 = TargetPrcb->NextThread) != NULL) {
+                ASSERT(Thread1->State == Standby);
+                if (ThreadPriority > Thread1->Priority) {
+                    Thread1->Preempted = TRUE;
+                    Thread->State = Standby;
+                    TargetPrcb->NextThread = Thread;
+                    Thread1->State = DeferredReady;
+                    Thread1->DeferredProcessor = CurrentPrcb->Number;
+                    PushEntryList(&RetryListHead, &Thread1->SwapListEntry);
+                    continue;
+                }
+            } else {
+                Thread1 = TargetPrcb->CurrentThread;
+                if (ThreadPriority > Thread1->Priority) {
+                    if (Thread1->State == Running) {
+                        Thread1->Preempted = TRUE;
+                    }
+
+                    Thread->State = Standby;
+                    TargetPrcb->NextThread = Thread;
+                    RequestInterrupt = TRUE;
+                    continue;
+                }
+            }
+
+            // No thread can be preempted. Insert the thread in the dispatcher ready queue selected by its priority.
+            ASSERT((ThreadPriority >= 0) && (ThreadPriority <= HIGH_PRIORITY));
+            Thread->State = Ready;
+            Thread->WaitTime = KiQueryLowTickCount();
+            if (Preempted != FALSE) {
+                InsertHeadList(&TargetPrcb->DispatcherReadyListHead[ThreadPriority], &Thread->WaitListEntry);
+            } else {
+                InsertTailList(&TargetPrcb->DispatcherReadyListHead[ThreadPriority], &Thread->WaitListEntry);
+            }
+
+            TargetPrcb->ReadySummary |= PRIORITY_MASK(ThreadPriority);
+        } while (NextEntry != NULL);
+
+        KiReleaseTwoPrcbLocks(CurrentPrcb, TargetPrcb);
+        if (RequestInterrupt != FALSE) {
+            KiRequestDispatchInterrupt(Processor);
+        }
+    }
+
+    // Ready any threads that could not be delivered as part of a batch.
+    NextEntry = RetryListHead.Next;
+    while (NextEntry != NULL) {
+        Thread = CONTAINING_RECORD(NextEntry, KTHREAD, SwapListEntry);
+        NextEntry = NextEntry->Next;
+        KiDeferredReadyThread(Thread);
+    }
+
     ASSERT(CurrentPrcb->DeferredReadyListHead.Next == NULL);
 }
 #endif
@@ -913,6 +1082,90 @@ Arguments:
 }
 
 
+VOID FASTCALL KiInheritPriorityThread(__inout PKTHREAD Thread, __in KPRIORITY Priority)
+/*
+Routine Description:
+    This function raises the priority of the specified owner thread to the priority of a thread that is waiting for an object the owner holds.
+    The inherited priority does not decay at quantum end and is removed by KiRemoveInheritedPriority when the owner releases the object.
+    N.B. The dispatcher database lock is held on entry and exit to this function.
+    N.B. Only threads in the variable priority class inherit priority and the inherited priority is limited to the variable priority class.
+Arguments:
+    Thread - Supplies a pointer to the owner thread object.
+    Priority - Supplies the priority of the waiting thread.
+*/
+{
+    if (Priority >= LOW_REALTIME_PRIORITY) {
+        Priority = LOW_REALTIME_PRIORITY - 1;
+    }
+
+    // If the owner thread is running at a lower priority, then raise its priority by the difference and record the raise
+    // in the priority decrement so it is removed when the inherited priority is removed.
+    KiAcquireThreadLock(Thread);
+    if (Thread->Priority < Priority) {
+        ASSERT((Thread->PriorityDecrement >= 0) && (Thread->PriorityDecrement <= Thread->Priority));
+
+        Thread->PriorityDecrement += (SCHAR)(Priority - Thread->Priority);
+        Thread->Quantum = Thread->QuantumReset;
+        InterlockedBitTestAndSet(&Thread->ThreadFlags, KTHREAD_PRIORITY_INHERITED_BIT);
+        KiSetPriorityThread(Thread, Priority);
+    }
+
+    KiReleaseThreadLock(Thread);
+}
+
+
+VOID FASTCALL KiInheritPriorityChain(__inout PKTHREAD Thread, __in KPRIORITY Priority)
+/*
+Routine Description:
+    This function raises the priority of the specified owner thread to the specified priority and, if the owner is itself waiting for a mutant that
+    is owned by another thread, follows the chain of mutant owners so the priority is inherited transitively.
+    N.B. The dispatcher database lock is held on entry and exit to this function. The length of the chain is limited so a deadlock cannot loop.
+Arguments:
+    Thread - Supplies a pointer to the owner thread object.
+    Priority - Supplies the priority of the waiting thread.
+*/
+{
+    ULONG Depth;
+    PKMUTANT Mutant;
+
+    Depth = 0;
+    do {
+        KiInheritPriorityThread(Thread, Priority);
+
+        // If the owner thread is waiting for a mutant, then continue with the owner of the mutant.
+        if (Thread->State != Waiting) {
+            break;
+        }
+
+        Mutant = (PKMUTANT)Thread->WaitBlockList->Object;
+        if (Mutant->Header.Type != MutantObject) {
+            break;
+        }
+
+        Thread = Mutant->OwnerThread;
+        Depth += 1;
+    } while ((Thread != NULL) && (Depth < KI_PRIORITY_INHERITANCE_DEPTH));
+}
+
+
+VOID FASTCALL KiRemoveInheritedPriority(__inout PKTHREAD Thread)
+/*
+Routine Description:
+    This function removes the priority the specified thread has inherited from the waiters of an object it has released.
+    N.B. The dispatcher database lock is held on entry and exit to this function.
+Arguments:
+    Thread - Supplies a pointer to the owner thread object.
+*/
+{
+    KiAcquireThreadLock(Thread);
+    if (InterlockedBitTestAndReset(&Thread->ThreadFlags, KTHREAD_PRIORITY_INHERITED_BIT) != FALSE) {
+        KiSetPriorityThread(Thread, KiComputeNewPriority(Thread, 0));
+    }
+
+    KiReleaseThreadLock(Thread);
+}
+
+
 VOID KiSuspendThread(IN PVOID NormalContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2)
 /*
 Routine Description:
@@ -24,6 +24,9 @@ ULONG KeTimerCheckFlags = KE_TIMER_CHECK_FREES;
            ((E)->Header.Type == TimerSynchronizationObject));                \
 }
 
+// Define the maximum coalescing granularity as a power of two multiple of the maximum time increment.
+#define KI_MAXIMUM_COALESCING_SHIFT 6
+
 
 VOID KeInitializeTimer(__out PKTIMER Timer)
 /*
@@ -152,6 +155,65 @@ Arguments:
 Return Value:
     A boolean value of TRUE is returned if the the specified timer was currently set. Otherwise, a value of FALSE is returned.
 */
+{
+    return KeSetCoalescableTimer(Timer, DueTime, Period, 0, Dpc);// Set the timer with a tolerable delay of zero.
+}
+
+
+FORCEINLINE VOID KiCoalesceDueTime(IN PKTIMER Timer, IN ULONG TolerableDelay, OUT PULONG Hand)
+/*
+Routine Description:
+    This function delays the due time of the specified timer, by no more than the tolerable delay, to the next coalescing boundary.
+    The coalescing granularity is the largest power of two multiple of the maximum time increment that does not exceed the tolerable delay.
+    Timers that are rounded to the same boundary are inserted in the same timer table list with the same due time and expire in the same pass.
+Arguments:
+    Timer - Supplies a pointer to a dispatcher object of type timer whose due time has been computed.
+    TolerableDelay - Supplies the tolerable delay in milliseconds.
+    Hand - Supplies a pointer to a variable that receives the recomputed hand value.
+*/
+{
+    ULONG64 DueTime;
+    ULONG64 Granularity;
+    ULONG Shift;
+    ULONG64 Tolerance;
+
+    // If the tolerable delay is less than one clock tick, then the timer cannot be coalesced beyond the tick in which it is due.
+    Tolerance = (ULONG64)TolerableDelay * (10 * 1000);
+    Granularity = KeMaximumIncrement;
+    if (Tolerance < Granularity) {
+        return;
+    }
+
+    Shift = 0;
+    while (((Granularity << 1) <= Tolerance) && (Shift < KI_MAXIMUM_COALESCING_SHIFT)) {
+        Granularity <<= 1;
+        Shift += 1;
+    }
+
+    DueTime = ((Timer->DueTime.QuadPart + Granularity - 1) / Granularity) * Granularity;
+    Timer->DueTime.QuadPart = DueTime;
+    *Hand = KiComputeTimerTableIndex(DueTime);
+    Timer->Header.Hand = (UCHAR)*Hand;
+}
+
+
+BOOLEAN KeSetCoalescableTimer(__inout PKTIMER Timer, __in LARGE_INTEGER DueTime, __in LONG Period, __in ULONG TolerableDelay, __in_opt PKDPC Dpc)
+/*
+Routine Description:
+    This function sets a timer to expire at a specified time, or later by no more than the specified tolerable delay.
+    If the timer is already set, then it is implicitly canceled before it is set to expire at the specified time.
+    Setting a timer causes its due time to be computed, its state to be set to Not-Signaled, and the timer object itself to be inserted in the timer list.
+    N.B. The tolerable delay is applied to the initial due time.
+         Periodic timers with the same period that are coalesced into the same expiration are reinserted together on each subsequent expiration.
+Arguments:
+    Timer - Supplies a pointer to a dispatcher object of type timer.
+    DueTime - Supplies an absolute or relative time at which the timer is to expire.
+    Period - Supplies an optional period for the timer in milliseconds.
+    TolerableDelay - Supplies the delay in milliseconds by which the expiration of the timer may be deferred to coalesce it with other timers.
+    Dpc - Supplies an optional pointer to a control object of type DPC.
+Return Value:
+    A boolean value of TRUE is returned if the the specified timer was currently set. Otherwise, a value of FALSE is returned.
+*/
 {
     ULONG Hand;
     BOOLEAN Inserted;
@@ -172,7 +234,7 @@ Return Value:
 
     // Set the DPC address, set the period, and compute the timer due time.
     // If the timer has already expired, then signal the timer.
-    // Otherwise, set the signal state to false and attempt to insert the timer in the timer table.
+    // Otherwise, set the signal state to false, coalesce the due time if a tolerable delay is specified, and attempt to insert the timer in the timer table.
 
     // N.B. The signal state must be cleared before it is inserted in the timer table in case the period is not zero.
     Timer->Dpc = Dpc;
@@ -184,6 +246,10 @@ Return Value:
             KiRequestSoftwareInterrupt(DISPATCH_LEVEL);
         }
     } else {
+        if (TolerableDelay != 0) {
+            KiCoalesceDueTime(Timer, TolerableDelay, &Hand);
+        }
+
         Timer->Header.SignalState = FALSE;
         KiInsertOrSignalTimer(Timer, Hand);
     }
@@ -222,6 +288,46 @@ Return Value:
 }
 
 
+FORCEINLINE VOID KiCheckTimerList(IN PLIST_ENTRY ListHead, IN PUCHAR Start, IN PUCHAR End)
+/*
+Routine Description:
+    This function checks to determine if any timer in the specified timer list overlaps the specified block of memory.
+    N.B. This function is called with the respective timer table lock held.
+Arguments:
+    ListHead - Supplies a pointer to the timer list to check.
+    Start - Supplies the starting address of the block of memory.
+    End - Supplies the ending address of the block of memory.
+*/
+{
+    PUCHAR Address;
+    PLIST_ENTRY NextEntry;
+    PKTIMER Timer;
+
+    NextEntry = ListHead->Flink;
+    while (NextEntry != ListHead) {
+        Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
+        Address = (PUCHAR)Timer;
+        NextEntry = NextEntry->Flink;
+
+        if ((Address > (Start - sizeof(KTIMER))) && (Address < End)) {// Check that the timer object is not in the range.
+            KeBugCheckEx(TIMER_OR_DPC_INVALID, 0x0, (ULONG_PTR)Address, (ULONG_PTR)Start, (ULONG_PTR)End);
+        }
+
+        if (Timer->Dpc) {
+            Address = (PUCHAR)Timer->Dpc;
+            if ((Address > (Start - sizeof(KDPC))) && (Address < End)) {// Check that the timer DPC object is not in the range.
+                KeBugCheckEx(TIMER_OR_DPC_INVALID, 0x1, (ULONG_PTR)Address, (ULONG_PTR)Start, (ULONG_PTR)End);
+            }
+
+            Address = (PUCHAR)(ULONG_PTR)Timer->Dpc->DeferredRoutine;
+            if (Address >= Start && Address < End) {// Check that the timer DPC routine is not in the range.
+                KeBugCheckEx(TIMER_OR_DPC_INVALID, 0x2, (ULONG_PTR)Address, (ULONG_PTR)Start, (ULONG_PTR)End);
+            }
+        }
+    }
+}
+
+
 VOID KeCheckForTimer(__in_bcount(BlockSize) PVOID BlockStart, __in SIZE_T BlockSize)
 /*
 Routine Description:
@@ -231,14 +337,11 @@ Arguments:
     BlockSize - Supplies the size, in bytes, of the block of memory to check.
 */
 {
-    PUCHAR Address;
     PUCHAR End;
     ULONG Index;
     PLIST_ENTRY ListHead;
     PKSPIN_LOCK_QUEUE LockQueue;
-    PLIST_ENTRY NextEntry;
     KIRQL OldIrql;
-    PKTIMER Timer;
     PUCHAR Start;
 
     // Make sure timer checks are enabled before proceeding.
@@ -257,31 +360,20 @@ Arguments:
     do {
         ListHead = &KiTimerTableListHead[Index].Entry;
         LockQueue = KiAcquireTimerTableLock(Index);
-        NextEntry = ListHead->Flink;
-        while (NextEntry != ListHead) {
-            Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
-            Address = (PUCHAR)Timer;
-            NextEntry = NextEntry->Flink;
-
-            if ((Address > (Start - sizeof(KTIMER))) && (Address < End)) {// Check that the timer object is not in the range.
-                KeBugCheckEx(TIMER_OR_DPC_INVALID, 0x0, (ULONG_PTR)Address, (ULONG_PTR)Start, (ULONG_PTR)End);
-            }
-
-            if (Timer->Dpc) {
-                Address = (PUCHAR)Timer->Dpc;
-                if ((Address > (Start - sizeof(KDPC))) && (Address < End)) {// Check that the timer DPC object is not in the range.
-                    KeBugCheckEx(TIMER_OR_DPC_INVALID, 0x1, (ULONG_PTR)Address, (ULONG_PTR)Start, (ULONG_PTR)End);
-                }
-
-                Address = (PUCHAR)(ULONG_PTR)Timer->Dpc->DeferredRoutine;
-                if (Address >= Start && Address < End) {// Check that the timer DPC routine is not in the range.
-                    KeBugCheckEx(TIMER_OR_DPC_INVALID, 0x2, (ULONG_PTR)Address, (ULONG_PTR)Start, (ULONG_PTR)End);
-                }
-            }
-        }
-
+        KiCheckTimerList(ListHead, Start, End);
         KiReleaseTimerTableLock(LockQueue);
         Index += 1;
     } while (Index < TIMER_TABLE_SIZE);
+
+    // Scan the timer wheel for long dated timers in the specified memory block.
+    Index = 0;
+    do {
+        ListHead = &KiTimerWheel[Index / TIMER_WHEEL_SIZE].SlotListHead[Index % TIMER_WHEEL_SIZE];
+        LockQueue = KiAcquireTimerTableLock((Index / TIMER_WHEEL_SIZE) << LOCK_QUEUE_TIMER_LOCK_SHIFT);
+        KiCheckTimerList(ListHead, Start, End);
+        KiReleaseTimerTableLock(LockQueue);
+        Index += 1;
+    } while (Index < (LOCK_QUEUE_TIMER_TABLE_LOCKS * TIMER_WHEEL_SIZE));
+
     KiUnlockDispatcherDatabase(OldIrql);// Unlock the dispatcher database and lower IRQL to its previous value
 }
\ No newline at end of file
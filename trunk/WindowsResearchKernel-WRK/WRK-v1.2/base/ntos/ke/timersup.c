@@ -13,6 +13,8 @@ Abstract:
 
 #include "ki.h"
 
+#pragma alloc_text(INIT, KiStartTimerWheel)
+
 
 VOID FASTCALL KiCompleteTimer(__inout PKTIMER Timer, __inout PKSPIN_LOCK_QUEUE LockQueue)
 /*
@@ -67,6 +69,8 @@ Return Value:
     PLIST_ENTRY ListHead;
     PLIST_ENTRY NextEntry;
     PKTIMER NextTimer;
+    ULONG64 Rotation;
+    PKTIMER_WHEEL Wheel;
 
     // Set the signal state to FALSE if the period is zero.
 
@@ -82,6 +86,21 @@ Return Value:
     // N.B. The sequence of operations below is critical to avoid the race condition that exists between this code and the clock interrupt code that examines the timer table lists to detemine when timers expire.
     DueTime = Timer->DueTime.QuadPart;
     ASSERT(Hand == KiComputeTimerTableIndex(DueTime));
+
+    // If the timer is due after the latest rotation that has been cascaded into the timer table, then insert the timer at the tail of the timer wheel slot selected by its rotation.
+    // The timer is moved into the timer table by the timer wheel cascade before the timer table hand reaches the rotation in which the timer is due.
+
+    // N.B. The timer wheel partition is protected by the timer table lock of the specified hand.
+    //      A timer in the timer wheel cannot have expired.
+    if (KiTimerWheelActive != FALSE) {
+        Rotation = KiComputeTimerRotation(DueTime);
+        Wheel = &KiTimerWheel[KiComputeTimerWheelPartition(Hand)];
+        if (Rotation > Wheel->Rotation) {
+            InsertTailList(&Wheel->SlotListHead[Rotation & (TIMER_WHEEL_SIZE - 1)], &Timer->TimerListEntry);
+            return FALSE;
+        }
+    }
+
     ListHead = &KiTimerTableListHead[Hand].Entry;
     NextEntry = ListHead->Blink;
     while (NextEntry != ListHead) {
@@ -94,6 +113,11 @@ Return Value:
         NextEntry = NextEntry->Blink;
     }
 
+    // If the timer is due at the same time as the timer it is inserted behind, then the timer expires in the same expiration pass.
+    if ((NextEntry != ListHead) && (DueTime == (ULONG64)NextTimer->DueTime.QuadPart)) {
+        InterlockedIncrement(&KiTimerCoalescedExpirations);
+    }
+
     InsertHeadList(NextEntry, &Timer->TimerListEntry);
     if (NextEntry == ListHead) {
         // The computed list is empty or the timer is due to expire before the first entry in the list.
@@ -171,4 +195,119 @@ Return Value:
     }
 
     return RequestInterrupt;
-}
\ No newline at end of file
+}
+
+
+VOID KiTimerWheelCascade(IN PKDPC Dpc, IN PVOID DeferredContext, IN PVOID SystemArgument1, IN PVOID SystemArgument2)
+/*
+Routine Description:
+    This function is called periodically to move timers from the timer wheel into the timer table as the timer table hand approaches the rotation in which they are due.
+    Each timer wheel partition is advanced to the rotation that follows the current rotation. Timers in a slot that are due in a later lap of the wheel remain in the slot.
+    N.B. If the cascade has fallen more than a full lap of the wheel behind (e.g., a large interrupt time adjustment), then each slot is visited once.
+Arguments:
+    Dpc - Not used.
+    DeferredContext - Not used.
+    SystemArgument1 - Not used.
+    SystemArgument2 - Not used.
+*/
+{
+    LIST_ENTRY ExpiredListHead;
+    ULONG Hand;
+    ULARGE_INTEGER InterruptTime;
+    PLIST_ENTRY ListHead;
+    PKSPIN_LOCK_QUEUE LockQueue;
+    PLIST_ENTRY NextEntry;
+    KIRQL OldIrql;
+    ULONG Partition;
+    ULONG64 TargetRotation;
+    PKTIMER Timer;
+    PKTIMER_WHEEL Wheel;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(DeferredContext);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    // Compute the rotation through which the timer wheel must be cascaded.
+    KiQueryInterruptTime((PLARGE_INTEGER)&InterruptTime);
+    TargetRotation = KiComputeTimerRotation(InterruptTime.QuadPart) + 1;
+
+    // Acquire the dispatcher database lock and cascade each timer wheel partition under its respective timer table lock.
+    // If a cascaded timer has already expired, then remove it from the timer table and insert it in the expired timer list.
+    InitializeListHead(&ExpiredListHead);
+    KiLockDispatcherDatabase(&OldIrql);
+    for (Partition = 0; Partition < LOCK_QUEUE_TIMER_TABLE_LOCKS; Partition += 1) {
+        Wheel = &KiTimerWheel[Partition];
+        LockQueue = KiAcquireTimerTableLock(Partition << LOCK_QUEUE_TIMER_LOCK_SHIFT);
+        if ((TargetRotation - Wheel->Rotation) > TIMER_WHEEL_SIZE) {
+            Wheel->Rotation = TargetRotation - TIMER_WHEEL_SIZE;
+        }
+
+        while (Wheel->Rotation < TargetRotation) {
+            Wheel->Rotation += 1;
+            ListHead = &Wheel->SlotListHead[Wheel->Rotation & (TIMER_WHEEL_SIZE - 1)];
+            NextEntry = ListHead->Flink;
+            while (NextEntry != ListHead) {
+                Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
+                NextEntry = NextEntry->Flink;
+                if (KiComputeTimerRotation(Timer->DueTime.QuadPart) <= Wheel->Rotation) {
+                    RemoveEntryList(&Timer->TimerListEntry);
+                    Hand = KiComputeTimerTableIndex(Timer->DueTime.QuadPart);
+                    ASSERT(KiComputeTimerWheelPartition(Hand) == Partition);
+                    if (KiInsertTimerTable(Timer, Hand) == TRUE) {
+                        KiRemoveEntryTimer(Timer);
+                        InsertTailList(&ExpiredListHead, &Timer->TimerListEntry);
+                    }
+                }
+            }
+        }
+
+        KiReleaseTimerTableLock(LockQueue);
+    }
+
+    // Process any timers that expired before they could be cascaded.
+    // N.B. The following function returns with the dispatcher database unlocked.
+    KiTimerListExpire(&ExpiredListHead, OldIrql);
+}
+
+
+VOID KiStartTimerWheel(VOID)
+/*
+Routine Description:
+    This function starts the timer wheel.
+    Each partition is set to the rotation that follows the current rotation, the cascade timer is set to fire twice per rotation of the timer table,
+    and insertion of long dated timers into the timer wheel is enabled.
+    N.B. This function is called during phase 1 initialization.
+*/
+{
+    LARGE_INTEGER DueTime;
+    ULARGE_INTEGER InterruptTime;
+    PKSPIN_LOCK_QUEUE LockQueue;
+    KIRQL OldIrql;
+    ULONG Partition;
+    LONG Period;
+    ULONG64 Rotation;
+
+    // Compute the cascade period in milliseconds as one half of a rotation of the timer table.
+    Period = (LONG)max((KeMaximumIncrement * (TIMER_TABLE_SIZE / 2)) / (10 * 1000), 1);
+    DueTime.QuadPart = Int32x32To64(Period, -10 * 1000);
+
+    // Initialize the rotation of each timer wheel partition.
+    KiQueryInterruptTime((PLARGE_INTEGER)&InterruptTime);
+    Rotation = KiComputeTimerRotation(InterruptTime.QuadPart) + 1;
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+    for (Partition = 0; Partition < LOCK_QUEUE_TIMER_TABLE_LOCKS; Partition += 1) {
+        LockQueue = KiAcquireTimerTableLock(Partition << LOCK_QUEUE_TIMER_LOCK_SHIFT);
+        KiTimerWheel[Partition].Rotation = Rotation;
+        KiReleaseTimerTableLock(LockQueue);
+    }
+
+    KeLowerIrql(OldIrql);
+
+    // Start the cascade timer and enable the timer wheel.
+    KeInitializeDpc(&KiTimerWheelDpc, KiTimerWheelCascade, NULL);
+    KeInitializeTimerEx(&KiTimerWheelTimer, NotificationTimer);
+    KeSetTimerEx(&KiTimerWheelTimer, DueTime, Period, &KiTimerWheelDpc);
+    KeMemoryBarrier();
+    KiTimerWheelActive = TRUE;
+}
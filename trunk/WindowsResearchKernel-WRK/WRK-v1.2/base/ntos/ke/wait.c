@@ -21,6 +21,105 @@ Abstract:
 
 #pragma alloc_text(PAGE, KeIsWaitListEmpty)
 
+// Define the bounds of the adaptive spin limit.
+#define KI_ADAPTIVE_SPIN_MINIMUM 64
+#define KI_ADAPTIVE_SPIN_MAXIMUM 16384
+
+
+#if !defined(NT_UP)
+FORCEINLINE VOID KiTuneAdaptiveSpin(IN ULONG Limit, IN ULONG SpinCount, IN LOGICAL Acquired)
+/*
+Routine Description:
+    This function tunes the adaptive spin limit based on the outcome of a spin.
+    If the object became available after more than half the limit was consumed, then the limit is raised.
+    If the limit was exhausted while the owner was still running, then the limit is lowered.
+    N.B. The limit is updated without synchronization since it is only a hint.
+Arguments:
+    Limit - Supplies the spin limit that was in effect for the spin.
+    SpinCount - Supplies the number of iterations that were executed.
+    Acquired - Supplies a logical value that determines whether the object became available during the spin.
+*/
+{
+    if (Acquired != FALSE) {
+        if ((SpinCount > (Limit / 2)) && (Limit < KI_ADAPTIVE_SPIN_MAXIMUM)) {
+            KiAdaptiveSpinLimit = Limit + (Limit / 4);
+        }
+    } else if ((SpinCount >= Limit) && (Limit > KI_ADAPTIVE_SPIN_MINIMUM)) {
+        KiAdaptiveSpinLimit = Limit - (Limit / 4);
+    }
+}
+
+
+FORCEINLINE VOID KiAdaptiveSpinMutant(IN PKMUTANT Mutant, IN PKTHREAD Thread)
+/*
+Routine Description:
+    This function spins waiting for the specified mutant to become signaled as long as its owner is running on another processor.
+    The spin ends when the mutant is signaled, the owner stops running, or the adaptive spin limit is reached.
+    N.B. This function is called without the dispatcher lock held. The caller must acquire the dispatcher lock and retest the mutant.
+    N.B. The owner thread cannot be deleted while it owns the mutant since mutants are abandoned during thread rundown.
+Arguments:
+    Mutant - Supplies a pointer to a dispatcher object of type mutant.
+    Thread - Supplies a pointer to the current thread.
+*/
+{
+    ULONG Limit;
+    PKTHREAD Owner;
+    ULONG SpinCount;
+
+    Limit = KiAdaptiveSpinLimit;
+    for (SpinCount = 0; SpinCount < Limit; SpinCount += 1) {
+        if (*((LONG volatile *)&Mutant->Header.SignalState) > 0) {
+            KiTuneAdaptiveSpin(Limit, SpinCount, TRUE);
+            return;
+        }
+
+        Owner = *((PKTHREAD volatile *)&Mutant->OwnerThread);
+        if ((Owner == NULL) || (Owner == Thread) || (Owner->State != Running)) {
+            return;
+        }
+
+        KeYieldProcessor();
+    }
+
+    KiTuneAdaptiveSpin(Limit, SpinCount, FALSE);
+}
+
+
+FORCEINLINE VOID KiAdaptiveSpinLock(IN LONG volatile *Count, IN LONG LockBit, IN PKTHREAD volatile *Owner)
+/*
+Routine Description:
+    This function spins waiting for the lock bit of a fast or guarded mutex to be set, which indicates the mutex is free,
+    as long as the mutex owner is running on another processor.
+    The spin ends when the mutex is free, the owner stops running, or the adaptive spin limit is reached.
+Arguments:
+    Count - Supplies a pointer to the mutex count.
+    LockBit - Supplies the lock bit which is set when the mutex is free.
+    Owner - Supplies a pointer to the mutex owner.
+*/
+{
+    ULONG Limit;
+    PKTHREAD OwnerThread;
+    ULONG SpinCount;
+
+    Limit = KiAdaptiveSpinLimit;
+    for (SpinCount = 0; SpinCount < Limit; SpinCount += 1) {
+        if ((*Count & LockBit) != 0) {
+            KiTuneAdaptiveSpin(Limit, SpinCount, TRUE);
+            return;
+        }
+
+        OwnerThread = *Owner;
+        if ((OwnerThread == NULL) || (OwnerThread->State != Running)) {
+            return;
+        }
+
+        KeYieldProcessor();
+    }
+
+    KiTuneAdaptiveSpin(Limit, SpinCount, FALSE);
+}
+#endif
+
 
 // Test for alertable condition.
 // If alertable is TRUE and the thread is alerted for a processor mode that is equal to the wait mode, then return immediately with a wait completion status of ALERTED.
@@ -646,6 +745,18 @@ Return Value:
     // If the dispatcher database is already held, then initialize the thread local variables.
     // Otherwise, raise IRQL to DPC level, initialize the thread local variables, and lock the dispatcher database.
     if (ReadForWriteAccess(&Thread->WaitNext) == FALSE) {
+        // If the object is a mutant that is owned by a thread running on another processor, then spin briefly before acquiring the dispatcher lock
+        // since a short held mutant is likely to be released before a context switch to another thread could complete.
+#if !defined(NT_UP)
+        if ((Objectx->Header.Type == MutantObject) &&
+            (Objectx->Header.SignalState <= 0) &&
+            (KeNumberProcessors > 1) &&
+            (KeGetCurrentIrql() < DISPATCH_LEVEL) &&
+            ((Timeout == NULL) || (Timeout->QuadPart != 0))) {
+            KiAdaptiveSpinMutant(Objectx, Thread);
+        }
+#endif
+
         goto WaitStart;
     }
 
@@ -706,6 +817,11 @@ Return Value:
 
             InsertTailList(&Objectx->Header.WaitListHead, &WaitBlock->WaitListEntry);// Insert wait block in object wait list.
 
+            // If the object is a mutant that is owned by another thread, then the owner inherits the priority of the current thread until it releases the mutant.
+            if ((Objectx->Header.Type == MutantObject) && (Objectx->OwnerThread != NULL)) {
+                KiInheritPriorityChain(Objectx->OwnerThread, Thread->Priority);
+            }
+
             // If the current thread is processing a queue entry, then attempt to activate another thread that is blocked on the queue object.
             Queue = Thread->Queue;
             if (Queue != NULL) {
@@ -804,6 +920,13 @@ Arguments:
     KeWaitForSingleObject(&Mutex->Gate, WrMutex, KernelMode, FALSE, NULL);
 #else
 
+    // If the owner is running on another processor, then spin briefly in the hope that the fast mutex is released before this thread must block.
+#if !defined(NT_UP)
+    if (KeNumberProcessors > 1) {
+        KiAdaptiveSpinLock(&Mutex->Count, FM_LOCK_BIT, &Mutex->Owner);
+    }
+#endif
+
     BitsToChange = FM_LOCK_BIT;
     WaitIncrement = FM_LOCK_WAITER_INC;
     do {
@@ -854,7 +977,15 @@ Arguments:
     LONG WaitIncrement;
 
     // Increment the contention count and wait or acquire the guarded mutex.
+    // If the owner is running on another processor, then spin briefly in the hope that the guarded mutex is released before this thread must block.
     Mutex->Contention += 1;
+
+#if !defined(NT_UP)
+    if (KeNumberProcessors > 1) {
+        KiAdaptiveSpinLock(&Mutex->Count, GM_LOCK_BIT, &Mutex->Owner);
+    }
+#endif
+
     BitsToChange = GM_LOCK_BIT;
     WaitIncrement = GM_LOCK_WAITER_INC;
     do {
@@ -74,6 +74,26 @@ Arguments:
     Increment - Supplies the priority increment that is to be applied to the thread's priority.
 */
 {
+    WMI_READYTHREAD ReadyThread;
+
+    // If context swaps are being traced, log who ended the wait and how long it lasted so that the swap in of this thread can be attributed.
+    if (PERFINFO_IS_GROUP_ON(PERF_CONTEXT_SWITCH)) {
+        ReadyThread.ThreadId = HandleToUlong(((PETHREAD)Thread)->Cid.UniqueThread);
+        if (KeIsExecutingDpc() != FALSE) {
+            ReadyThread.ReadyingThreadId = 0;
+        } else {
+            ReadyThread.ReadyingThreadId = HandleToUlong(PsGetCurrentThread()->Cid.UniqueThread);
+        }
+
+        ReadyThread.WaitTime = KiQueryLowTickCount() - Thread->WaitTime;
+        ReadyThread.WaitStatus = (LONG)WaitStatus;
+        ReadyThread.WaitReason = Thread->WaitReason;
+        ReadyThread.WaitMode = Thread->WaitMode;
+        ReadyThread.AdjustIncrement = (CHAR)Increment;
+        ReadyThread.Reserved = 0;
+        PerfInfoLogBytes(PERFINFO_LOG_TYPE_READYTHREAD, &ReadyThread, sizeof(ReadyThread));
+    }
+
     KiUnlinkThread(Thread, WaitStatus);// Unlink thread from the appropriate wait queues and set the wait completion status.
 
     ASSERT(Increment >= 0);// Set unwait priority adjustment parameters.
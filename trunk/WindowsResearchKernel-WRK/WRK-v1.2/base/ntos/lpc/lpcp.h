@@ -196,7 +196,10 @@ char * LpcpGetCreatorName (PLPCP_PORT_OBJECT PortObject);
 #endif // ENABLE_LPC_TRACING
 
 extern PAGED_LOOKASIDE_LIST LpcpMessagesLookaside;
+extern PEX_OBJECT_CACHE LpcpMessageCache;
 
+//  Messages come from a per processor object cache, so sends and replies on different processors don't share a list head.
+//  The lookaside list is only used if the cache could not be created.
 __forceinline PLPCP_MESSAGE LpcpAllocateFromPortZone (ULONG Size)
 {
     PLPCP_MESSAGE Msg;
@@ -205,7 +208,12 @@ __forceinline PLPCP_MESSAGE LpcpAllocateFromPortZone (ULONG Size)
 
     UNREFERENCED_PARAMETER (Size);
 
-    Msg = ExAllocateFromPagedLookasideList( &LpcpMessagesLookaside );
+    if (LpcpMessageCache != NULL) {
+        Msg = ExAllocateFromObjectCache( LpcpMessageCache, LpcpMaxMessageSize );
+    } else {
+        Msg = ExAllocateFromPagedLookasideList( &LpcpMessagesLookaside );
+    }
+
     if (Msg != NULL) {
         LpcpTrace(( "Allocate Msg %lx\n", Msg ));
 
@@ -32,6 +32,7 @@ Abstract:
 ULONG LpcpTotalNumberOfMessages = 0;
 ULONG LpcpMaxMessageSize = 0;
 PAGED_LOOKASIDE_LIST LpcpMessagesLookaside;
+PEX_OBJECT_CACHE LpcpMessageCache;
 
 
 #ifdef ALLOC_DATA_PRAGMA
@@ -192,9 +193,20 @@ Return Value:
 
 VOID LpcpInitializePortZone(IN ULONG MaxEntrySize)
 {
+    PEX_OBJECT_CACHE MessageCache;
+
     LpcpMaxMessageSize = MaxEntrySize;
 
     ExInitializePagedLookasideList(&LpcpMessagesLookaside, NULL, NULL, 0, MaxEntrySize, 'McpL', 32);
+
+    MessageCache = ExAllocatePoolWithTag(NonPagedPoolCacheAligned, sizeof(EX_OBJECT_CACHE), 'CcpL');
+    if (MessageCache != NULL) {
+        if (NT_SUCCESS(ExInitializeObjectCache(MessageCache, PagedPool, MaxEntrySize, 'McpL', NULL, NULL, NULL))) {
+            LpcpMessageCache = MessageCache;
+        } else {
+            ExFreePoolWithTag(MessageCache, 'CcpL');
+        }
+    }
 }
 
 
@@ -203,11 +215,19 @@ VOID FASTCALL LpcpFreeToPortZone(IN PLPCP_MESSAGE Msg, IN ULONG MutexFlags)
     PLPCP_CONNECTION_MESSAGE ConnectMsg;
     PETHREAD RepliedToThread = NULL;
     PLPCP_PORT_OBJECT ClientPort = NULL;
+    BOOLEAN LockHeld;
 
     PAGED_CODE();
     
+    //  A message that is not on any queue is only known to the caller that is freeing it,
+    //  so it can be torn down without the global lock.
+    LockHeld = TRUE;
     if ((MutexFlags & LPCP_MUTEX_OWNED) == 0) {
-        LpcpAcquireLpcpLock();//  Acquire the global lock if necessary
+        if (IsListEmpty(&Msg->Entry)) {
+            LockHeld = FALSE;
+        } else {
+            LpcpAcquireLpcpLock();//  Acquire the global lock if necessary
+        }
     }
 
     //  A entry field connects the message to the message queue of the owning port object.  
@@ -234,7 +254,9 @@ VOID FASTCALL LpcpFreeToPortZone(IN PLPCP_MESSAGE Msg, IN ULONG MutexFlags)
         }
     }
 
-    LpcpReleaseLpcpLock();
+    if (LockHeld) {
+        LpcpReleaseLpcpLock();
+    }
 
     if (ClientPort) {
         ObDereferenceObject(ClientPort);
@@ -244,7 +266,11 @@ VOID FASTCALL LpcpFreeToPortZone(IN PLPCP_MESSAGE Msg, IN ULONG MutexFlags)
         ObDereferenceObject(RepliedToThread);
     }
 
-    ExFreeToPagedLookasideList(&LpcpMessagesLookaside, Msg);
+    if (LpcpMessageCache != NULL) {
+        ExFreeToObjectCache(Msg);
+    } else {
+        ExFreeToPagedLookasideList(&LpcpMessagesLookaside, Msg);
+    }
 
     if ((MutexFlags & LPCP_MUTEX_OWNED) && ((MutexFlags & LPCP_MUTEX_RELEASE_ON_RETURN) == 0)) {
         LpcpAcquireLpcpLock();
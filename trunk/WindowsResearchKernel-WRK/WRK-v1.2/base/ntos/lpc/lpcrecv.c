@@ -288,7 +288,8 @@ Return Value:
         LpcpReleaseLpcpLock();
 
         //  Wake up the thread that is waiting for an answer to its request inside of NtRequestWaitReplyPort or NtReplyWaitReplyPort
-        KeReleaseSemaphore(&WakeupThread->LpcReplySemaphore, 1, 1, FALSE);
+        //  and hand it this processor, since we are going back to waiting for the next request
+        KeReleaseSemaphoreHandoff(&WakeupThread->LpcReplySemaphore, 1, 1);
         ObDereferenceObject(WakeupThread);
     }
 
@@ -400,8 +400,8 @@ Return Value:
     LpcpReleaseLpcpLock();
 
     //  Wake up the thread that is waiting for an answer to its request inside of NtRequestWaitReplyPort or NtReplyWaitReplyPort.  
-    //  That will dereference itself when it wakes up.
-    KeReleaseSemaphore(&WakeupThread->LpcReplySemaphore, 1, 1, FALSE);
+    //  That will dereference itself when it wakes up. It is handed this processor since we wait for a reply next.
+    KeReleaseSemaphoreHandoff(&WakeupThread->LpcReplySemaphore, 1, 1);
     ObDereferenceObject(WakeupThread);
 
     //  And wait for a reply
@@ -552,6 +552,8 @@ NTSTATUS LpcpCopyRequestData(IN BOOLEAN WriteToMessageData,
 /*
 Routine Description:
     This routine will copy data to or from the user supplied buffer and the port message data information buffer
+    The data moves directly between the two address spaces. Above the pool move threshold MmCopyVirtualMemory locks and maps the source pages,
+    so large data entries are copied once and never staged in the message or in pool.
 Arguments:
     WriteToMessageData - TRUE if the data is to be copied from the user buffer to the message and FALSE otherwise
     PortHandle - Supplies the port into which the message is being manipulated
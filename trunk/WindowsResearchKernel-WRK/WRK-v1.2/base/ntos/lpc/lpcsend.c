@@ -616,8 +616,8 @@ Return Value:
     }
 
     //  At this point we've enqueued our request and if necessary set ourselves up for the callback or reply.
-    //  So now wake up the other end
-    Status = KeReleaseSemaphore(ReleaseSemaphore, 1, 1, FALSE);
+    //  So now wake up the other end, handing it this processor since we are about to wait for its reply
+    Status = KeReleaseSemaphoreHandoff(ReleaseSemaphore, 1, 1);
     KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
     if (CallbackRequest) {
         ObDereferenceObject(WakeupThread);
@@ -1086,8 +1086,8 @@ Return Value:
 
     //  At this point we've enqueued our request and if necessary set ourselves up for the callback or reply.
 
-    //  So now wake up the other end
-    Status = KeReleaseSemaphore(ReleaseSemaphore, 1, 1, FALSE);
+    //  So now wake up the other end, handing it this processor since we are about to wait for its reply
+    Status = KeReleaseSemaphoreHandoff(ReleaseSemaphore, 1, 1);
     KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
     if (CallbackRequest) {
         ObDereferenceObject(WakeupThread);
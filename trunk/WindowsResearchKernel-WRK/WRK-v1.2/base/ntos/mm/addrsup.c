@@ -17,6 +17,7 @@ Abstract:
     - Caller allocates the pool to reduce mutex hold times.
     - Various VAD-specific customizations/optimizations.
     - Hints.
+    - Each node records the largest free gap in its subtree so that empty range searches skip the subtrees that cannot hold the range.
 
 Environment:
     Kernel mode only, working set mutex held, APCs disabled.
@@ -42,12 +43,16 @@ PMMADDRESS_NODE MiRealSuccessor(IN PMMADDRESS_NODE Links);
 PMMADDRESS_NODE MiRealPredecessor(IN PMMADDRESS_NODE Links);
 VOID MiInitializeVadTableAvl(IN PMM_AVL_TABLE Table);
 PVOID MiEnumerateGenericTableWithoutSplayingAvl(IN PMM_AVL_TABLE Table, IN PVOID *RestartKey);
+PMMADDRESS_NODE MiGetNextGapNode(IN PMMADDRESS_NODE Node, IN ULONG_PTR Gap);
+PMMADDRESS_NODE MiGetPreviousGapNode(IN PMMADDRESS_NODE Node, IN ULONG_PTR Gap);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,MiCheckForConflictingNode)
 #pragma alloc_text(PAGE,MiRealSuccessor)
 #pragma alloc_text(PAGE,MiRealPredecessor)
 #pragma alloc_text(PAGE,MiInitializeVadTableAvl)
+#pragma alloc_text(PAGE,MiGetNextGapNode)
+#pragma alloc_text(PAGE,MiGetPreviousGapNode)
 #pragma alloc_text(PAGE,MiFindEmptyAddressRangeInTree)
 #pragma alloc_text(PAGE,MiFindEmptyAddressRangeDownTree)
 #pragma alloc_text(PAGE,MiFindEmptyAddressRangeDownBasedTree)
@@ -120,6 +125,87 @@ ULONG MiWorstCaseFill[33] = {
 #endif
 
 
+FORCEINLINE ULONG_PTR MiGapBeforeNode(IN PMMADDRESS_NODE Node)
+/*
+Routine Description:
+    This routine returns the size of the free gap between the predecessor of the node and the node.
+    The gap of the first node in the tree is measured from zero.
+Arguments:
+    Node - Supplies the node, which must be linked into its tree.
+*/
+{
+    PMMADDRESS_NODE Previous;
+
+    Previous = MiGetPreviousNode(Node);
+    if (Previous == NULL) {
+        return Node->StartingVpn;
+    }
+
+    ASSERT(Previous->EndingVpn < Node->StartingVpn);
+    return Node->StartingVpn - Previous->EndingVpn - 1;
+}
+
+
+FORCEINLINE VOID MiUpdateSubtreeGap(IN PMMADDRESS_NODE Node)
+/*
+Routine Description:
+    This routine recomputes the largest gap of the subtree rooted at the node from its own gap and the largest gaps of its children.
+Arguments:
+    Node - Supplies the node, whose children must already be up to date.
+*/
+{
+    ULONG_PTR LargestGap;
+
+    LargestGap = MiGapBeforeNode(Node);
+    if ((Node->LeftChild != NULL) && (Node->LeftChild->LargestGap > LargestGap)) {
+        LargestGap = Node->LeftChild->LargestGap;
+    }
+
+    if ((Node->RightChild != NULL) && (Node->RightChild->LargestGap > LargestGap)) {
+        LargestGap = Node->RightChild->LargestGap;
+    }
+
+    Node->LargestGap = LargestGap;
+}
+
+
+VOID MiUpdateGapsToRoot(IN PMMADDRESS_NODE Node)
+/*
+Routine Description:
+    This routine recomputes the largest gap of the node and of each of its ancestors.
+Arguments:
+    Node - Supplies the node to start at, which may be the balanced root of the table itself.
+*/
+{
+    // The balanced root is its own parent and does not take part.
+    while (SANITIZE_PARENT_NODE(Node->u1.Parent) != Node) {
+        MiUpdateSubtreeGap(Node);
+        Node = SANITIZE_PARENT_NODE(Node->u1.Parent);
+    }
+}
+
+
+VOID FASTCALL MiUpdateNodeGaps(IN PMMADDRESS_NODE Node)
+/*
+Routine Description:
+    This routine brings the largest gaps of the tree up to date after the starting or ending address of a node was changed in place.
+    A new start changes the gap of the node itself, and a new end changes the gap of its successor.
+Arguments:
+    Node - Supplies the node whose range changed.
+Environment:
+    Kernel mode, with the locks required to insert a node into the tree held.
+*/
+{
+    PMMADDRESS_NODE Next;
+
+    MiUpdateGapsToRoot(Node);
+    Next = MiGetNextNode(Node);
+    if (Next != NULL) {
+        MiUpdateGapsToRoot(Next);
+    }
+}
+
+
 TABLE_SEARCH_RESULT MiFindNodeOrParent(IN PMM_AVL_TABLE Table, IN ULONG_PTR StartingVpn, OUT PMMADDRESS_NODE *NodeOrParent)
 /*
 Routine Description:
@@ -265,7 +351,7 @@ Routine Description:
 
     Note that the pointer to the root node of the tree is assumed to be contained in a MMADDRESS_NODE structure itself, to allow the algorithms below to change the root of the tree without checking for special cases.
     Note also that this is an internal routine, and the caller guarantees that it never requests to promote the root itself.
-    This routine only updates the tree links; the caller must update the balance factors as appropriate.
+    This routine only updates the tree links and the largest gaps of the two nodes; the caller must update the balance factors as appropriate.
 Arguments:
     C - pointer to the child node to be promoted in the tree.
 */
@@ -324,6 +410,10 @@ Arguments:
         G->RightChild = C;
     }
     C->u1.Parent = MI_MAKE_PARENT(G, C->u1.Balance);
+
+    // P and C are the only nodes whose subtrees changed, and P is now below C.
+    MiUpdateSubtreeGap(P);
+    MiUpdateSubtreeGap(C);
 }
 
 
@@ -491,8 +581,13 @@ Environment:
     PMMADDRESS_NODE Parent;
     PMMADDRESS_NODE EasyDelete;
     PMMADDRESS_NODE P;
+    PMMADDRESS_NODE GapParent;
+    PMMADDRESS_NODE Successor;
     SCHAR a;
 
+    // The successor inherits the gap of the NodeToDelete, so capture it while the NodeToDelete is still linked in.
+    Successor = MiGetNextNode(NodeToDelete);
+
     // If the NodeToDelete has at least one NULL child pointer, then we can delete it directly.
     if ((NodeToDelete->LeftChild == NULL) || (NodeToDelete->RightChild == NULL)) {
         EasyDelete = NodeToDelete;
@@ -546,6 +641,13 @@ Environment:
         EasyDelete->LeftChild->u1.Parent = MI_MAKE_PARENT(Parent, EasyDelete->LeftChild->u1.Balance);
     }
 
+    // Every subtree that lost the EasyDelete lies on the path from its parent to the root.
+    // If the parent is the NodeToDelete, that path will start at the EasyDelete once it has replaced the NodeToDelete below.
+    GapParent = Parent;
+    if (GapParent == NodeToDelete) {
+        GapParent = EasyDelete;
+    }
+
     // For delete rebalancing, set the balance at the root to 0 to properly terminate the rebalance without special tests, and to be able to detect if the depth of the tree actually decreased.
     Table->BalancedRoot.u1.Balance = 0;
     P = SANITIZE_PARENT_NODE(EasyDelete->u1.Parent);
@@ -618,6 +720,12 @@ Environment:
 
     Table->NumberGenericTableElements -= 1;
 
+    // Rebalancing kept the largest gaps of the rotated nodes up to date, now fix up the path that lost a node and the gap of the successor.
+    MiUpdateGapsToRoot(GapParent);
+    if (Successor != NULL) {
+        MiUpdateGapsToRoot(Successor);
+    }
+
     // Sanity check tree size and depth.
     ASSERT((Table->NumberGenericTableElements >= MiWorstCaseFill[Table->DepthOfTree]) &&
         (Table->NumberGenericTableElements <= MiBestCaseFill[Table->DepthOfTree]));
@@ -814,6 +922,7 @@ Environment:
         ASSERT(NodeToInsert->u1.Balance == 0);
         ASSERT(Table->DepthOfTree == 0);
         Table->DepthOfTree = 1;
+        NodeToInsert->LargestGap = NodeToInsert->StartingVpn;
 
         ASSERT((Table->NumberGenericTableElements >= MiWorstCaseFill[Table->DepthOfTree]) &&
             (Table->NumberGenericTableElements <= MiBestCaseFill[Table->DepthOfTree]));
@@ -830,6 +939,9 @@ Environment:
         NodeToInsert->u1.Parent = NodeOrParent;
         ASSERT(NodeToInsert->u1.Balance == 0);
 
+        // The new node must have a valid gap before any rotation looks at it.
+        NodeToInsert->LargestGap = MiGapBeforeNode(NodeToInsert);
+
         // The above completes the standard binary tree insertion, which happens to correspond to steps A1-A5 of Knuth's "balanced tree search and insertion" algorithm.
         // Now comes the time to adjust balance factors and possibly do a single or double rotation as in steps A6-A10.
 
@@ -886,6 +998,13 @@ Environment:
             PRINT("LW 3: Table %p, Bal %x, %x\n", Table, Table->BalancedRoot.u1.Balance, -1);
         } while (TRUE);
         PRINT("LW 4: Table %p, Bal %x, %x\n", Table, Table->BalancedRoot.u1.Balance, -1);
+
+        // The new node added to the subtrees of its ancestors and split the gap of its successor.
+        MiUpdateGapsToRoot(NodeToInsert);
+        S = MiGetNextNode(NodeToInsert);
+        if (S != NULL) {
+            MiUpdateGapsToRoot(S);
+        }
     }
 
     // Sanity check tree size and depth.
@@ -1034,6 +1153,120 @@ Return Value:
 }
 
 
+PMMADDRESS_NODE MiGetNextGapNode(IN PMMADDRESS_NODE Node, IN ULONG_PTR Gap)
+/*
+Routine Description:
+    This function locates the first node following the specified node whose preceding free gap is at least the specified size.
+    Subtrees whose largest gap is too small are skipped without being visited.
+Arguments:
+    Node - Supplies a pointer to a node in the tree.
+    Gap - Supplies the smallest gap of interest, in the units of the tree.
+Return Value:
+    Returns a pointer to the node, NULL if none.
+*/
+{
+    PMMADDRESS_NODE Parent;
+    PMMADDRESS_NODE Subtree;
+
+    Subtree = NULL;
+    if ((Node->RightChild != NULL) && (Node->RightChild->LargestGap >= Gap)) {
+        Subtree = Node->RightChild;
+    } else {
+        // Climb until an ancestor of which this node is a left descendant has a big enough gap itself or in its right subtree.
+        do {
+            Parent = SANITIZE_PARENT_NODE(Node->u1.Parent);
+            if (Parent == Node) {
+                return NULL;
+            }
+
+            if ((Parent->LeftChild == Node) && (Parent->LargestGap >= Gap)) {
+                if (MiGapBeforeNode(Parent) >= Gap) {
+                    return Parent;
+                }
+
+                if ((Parent->RightChild != NULL) && (Parent->RightChild->LargestGap >= Gap)) {
+                    Subtree = Parent->RightChild;
+                    break;
+                }
+            }
+
+            Node = Parent;
+        } while (TRUE);
+    }
+
+    // Descend to the lowest node of the subtree with a big enough gap.
+    while (Subtree != NULL) {
+        ASSERT(Subtree->LargestGap >= Gap);
+        if ((Subtree->LeftChild != NULL) && (Subtree->LeftChild->LargestGap >= Gap)) {
+            Subtree = Subtree->LeftChild;
+        } else if (MiGapBeforeNode(Subtree) >= Gap) {
+            return Subtree;
+        } else {
+            Subtree = Subtree->RightChild;
+        }
+    }
+
+    return NULL;
+}
+
+
+PMMADDRESS_NODE MiGetPreviousGapNode(IN PMMADDRESS_NODE Node, IN ULONG_PTR Gap)
+/*
+Routine Description:
+    This function locates the last node preceding the specified node whose preceding free gap is at least the specified size.
+    Subtrees whose largest gap is too small are skipped without being visited.
+Arguments:
+    Node - Supplies a pointer to a node in the tree.
+    Gap - Supplies the smallest gap of interest, in the units of the tree.
+Return Value:
+    Returns a pointer to the node, NULL if none.
+*/
+{
+    PMMADDRESS_NODE Parent;
+    PMMADDRESS_NODE Subtree;
+
+    Subtree = NULL;
+    if ((Node->LeftChild != NULL) && (Node->LeftChild->LargestGap >= Gap)) {
+        Subtree = Node->LeftChild;
+    } else {
+        // Climb until an ancestor of which this node is a right descendant has a big enough gap itself or in its left subtree.
+        do {
+            Parent = SANITIZE_PARENT_NODE(Node->u1.Parent);
+            if ((Parent == Node) || (Parent == SANITIZE_PARENT_NODE(Parent->u1.Parent))) {
+                return NULL;
+            }
+
+            if ((Parent->RightChild == Node) && (Parent->LargestGap >= Gap)) {
+                if (MiGapBeforeNode(Parent) >= Gap) {
+                    return Parent;
+                }
+
+                if ((Parent->LeftChild != NULL) && (Parent->LeftChild->LargestGap >= Gap)) {
+                    Subtree = Parent->LeftChild;
+                    break;
+                }
+            }
+
+            Node = Parent;
+        } while (TRUE);
+    }
+
+    // Descend to the highest node of the subtree with a big enough gap.
+    while (Subtree != NULL) {
+        ASSERT(Subtree->LargestGap >= Gap);
+        if ((Subtree->RightChild != NULL) && (Subtree->RightChild->LargestGap >= Gap)) {
+            Subtree = Subtree->RightChild;
+        } else if (MiGapBeforeNode(Subtree) >= Gap) {
+            return Subtree;
+        } else {
+            Subtree = Subtree->LeftChild;
+        }
+    }
+
+    return NULL;
+}
+
+
 PMMADDRESS_NODE FASTCALL MiLocateAddressInTree(IN ULONG_PTR Vpn, IN PMM_AVL_TABLE Table)
 /*
 Routine Description:
@@ -1101,8 +1334,10 @@ Arguments:
     }
 
     do {
-        NextNode = MiGetNextNode(Node);
+        // Only a node whose preceding gap is big enough before alignment can start a fit, so skip straight to the next such node.
+        NextNode = MiGetNextGapNode(Node, SizeOfRangeVpn);
         if (NextNode != NULL) {
+            Node = MiGetPreviousNode(NextNode);
             if (SizeOfRangeVpn <= ((ULONG_PTR)NextNode->StartingVpn - MI_ROUND_TO_SIZE(1 + Node->EndingVpn, AlignmentVpn))) {
                 // Check to ensure that the ending address aligned upwards is not greater than the starting address.
                 if ((ULONG_PTR)NextNode->StartingVpn > MI_ROUND_TO_SIZE(1 + Node->EndingVpn, AlignmentVpn)) {
@@ -1112,7 +1347,12 @@ Arguments:
                 }
             }
         } else {
-            // No more descriptors, check to see if this fits into the remainder of the address space.
+            // No more descriptors, check to see if this fits into the remainder of the address space after the highest one.
+            Node = Table->BalancedRoot.RightChild;
+            while (Node->RightChild != NULL) {
+                Node = Node->RightChild;
+            }
+
             if ((((ULONG_PTR)Node->EndingVpn + MI_VA_TO_VPN(X64K)) < MI_VA_TO_VPN(MM_HIGHEST_VAD_ADDRESS)) &&
                 (SizeOfRange <= ((ULONG_PTR)MM_HIGHEST_VAD_ADDRESS - (ULONG_PTR)MI_ROUND_TO_SIZE((ULONG_PTR)MI_VPN_TO_VA(Node->EndingVpn), Alignment)))) {
                 *PreviousVad = Node;
@@ -1145,6 +1385,7 @@ Arguments:
 {
     PMMADDRESS_NODE Node;
     PMMADDRESS_NODE PreviousNode;
+    PMMADDRESS_NODE GapNode;
     ULONG_PTR AlignedEndingVa;
     PVOID OptimalStart;
     ULONG_PTR OptimalStartVpn;
@@ -1189,6 +1430,17 @@ Arguments:
     OptimalStartVpn = MI_VA_TO_VPN(OptimalStart);
     AlignmentVpn = MI_VA_TO_VPN(Alignment);
     do {
+        // Only a node whose preceding gap is big enough before alignment can end a fit, so skip straight down to the next such node.
+        // If there is none, then not even the range below the lowest node is big enough.
+        if (MiGapBeforeNode(Node) < (SizeOfRange >> PAGE_SHIFT)) {
+            GapNode = MiGetPreviousGapNode(Node, SizeOfRange >> PAGE_SHIFT);
+            if (GapNode == NULL) {
+                return STATUS_NO_MEMORY;
+            }
+
+            Node = GapNode;
+        }
+
         PreviousNode = MiGetPreviousNode(Node);
         if (PreviousNode != NULL) {
             // Is the ending Va below the top of the address to end at.
@@ -1339,14 +1591,34 @@ Arguments:
     Table - Supplies the table describing the tree.
 Return Value:
     Returns a pointer to the virtual address descriptor which contains the supplied virtual address or NULL if none was located.
+Environment:
+    Kernel mode, address space or working set mutex held.
 */
 {
     PMMVAD FoundVad;
+    PMMVAD Neighbor;
     ULONG_PTR Vpn;
     PMM_AVL_TABLE Table;
     TABLE_SEARCH_RESULT SearchResult;
+    PETHREAD Thread;
+    PEPROCESS Process;
+    LOGICAL OwnProcess;
 
-    Table = &PsGetCurrentProcess()->VadRoot;
+    Thread = PsGetCurrentThread();
+    Process = PsGetCurrentProcessByThread(Thread);
+    Table = &Process->VadRoot;
+    Vpn = MI_VA_TO_VPN(VirtualAddress);
+
+    // Threads faulting in different regions of the process would keep rewriting the shared hint below, so check the hint of this thread first.
+    // No VAD can leave the tree without the sequence advancing, and the sequence cannot advance while either mutex is held,
+    // so a hint captured with the current sequence still points at a VAD in the tree.
+    OwnProcess = (LOGICAL)(Process == THREAD_TO_PROCESS(Thread));
+    if (OwnProcess && (Thread->VadHintSequence == Process->VadSequence)) {
+        FoundVad = (PMMVAD)Thread->VadHint;
+        if ((FoundVad != NULL) && (Vpn >= FoundVad->StartingVpn) && (Vpn <= FoundVad->EndingVpn)) {
+            return FoundVad;
+        }
+    }
 
     // Note the NodeHint *MUST* be captured locally - see the synchronization comment below for details.
     FoundVad = (PMMVAD)Table->NodeHint;
@@ -1354,9 +1626,29 @@ Return Value:
         return NULL;
     }
 
-    Vpn = MI_VA_TO_VPN(VirtualAddress);
     if ((Vpn >= FoundVad->StartingVpn) && (Vpn <= FoundVad->EndingVpn)) {
-        return FoundVad;
+        goto Found;
+    }
+
+    // Lookups tend to move to an adjacent VAD, so try the neighbor of the hint on the side of the address before searching the tree.
+    // The neighbor also answers a lookup of an address that falls in the gap next to the hint.
+    // This is as safe as the tree search below since either holds the same locks and only follows the links.
+    if (Vpn > FoundVad->EndingVpn) {
+        Neighbor = (PMMVAD)MiGetNextNode((PMMADDRESS_NODE)FoundVad);
+        if ((Neighbor == NULL) || (Vpn < Neighbor->StartingVpn)) {
+            return NULL;
+        }
+    } else {
+        Neighbor = (PMMVAD)MiGetPreviousNode((PMMADDRESS_NODE)FoundVad);
+        if ((Neighbor == NULL) || (Vpn > Neighbor->EndingVpn)) {
+            return NULL;
+        }
+    }
+
+    if ((Vpn >= Neighbor->StartingVpn) && (Vpn <= Neighbor->EndingVpn)) {
+        Table->NodeHint = (PVOID)Neighbor;
+        FoundVad = Neighbor;
+        goto Found;
     }
 
     // Lookup the element and save the result.
@@ -1373,6 +1665,13 @@ Return Value:
     // It is ok that the update is not synchronized - as long as care is taken above that it is read into a local variable and then referenced.
     // Because no VAD can be removed from the tree without holding both the address space & working set.
     Table->NodeHint = (PVOID)FoundVad;
+
+Found:
+    if (OwnProcess) {
+        Thread->VadHint = (PVOID)FoundVad;
+        Thread->VadHintSequence = Process->VadSequence;
+    }
+
     return FoundVad;// Return the VAD.
 }
 #endif
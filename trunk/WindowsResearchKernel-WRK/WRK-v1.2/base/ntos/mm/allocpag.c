@@ -18,6 +18,8 @@ extern ULONG MiShowStuckPages;
 #endif
 
 PVOID MiFindContiguousMemoryInPool(IN PFN_NUMBER LowestPfn, IN PFN_NUMBER HighestPfn, IN PFN_NUMBER BoundaryPfn, IN PFN_NUMBER SizeInPages, IN PVOID CallingAddress);
+LOGICAL MiCompactContiguousPages(IN PFN_NUMBER LowestPfn, IN PFN_NUMBER HighestPfn, IN PFN_NUMBER BoundaryPfn, IN PFN_NUMBER SizeInPages, IN MI_PFN_CACHE_ATTRIBUTE CacheAttribute);
+LOGICAL MiRelocateModifiedPage(IN PMMPFN Pfn1, IN PFN_NUMBER LowestAvoidPfn, IN PFN_NUMBER HighestAvoidPfn, IN PVOID Buffer);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT, MiInitializeNonPagedPool)
@@ -42,9 +44,24 @@ PVOID MiFindContiguousMemoryInPool(IN PFN_NUMBER LowestPfn, IN PFN_NUMBER Highes
 
 ULONG MmPagedPoolCommit;        // used by the debugger
 
-SLIST_HEADER MiNonPagedPoolSListHead;
+// Freed single page nonpaged pool allocations are cached per node so they are only handed back out to callers on the node whose memory backs them.
+SLIST_HEADER MiNonPagedPoolSListHead[MAXIMUM_CCNUMA_NODES];
 ULONG MiNonPagedPoolSListMaximum = 4;
 
+#if defined(MI_MULTINODE)
+#define MI_NONPAGED_POOL_SLIST_NODE(Pfn)    ((Pfn)->u3.e1.PageColor)
+#else
+#define MI_NONPAGED_POOL_SLIST_NODE(Pfn)    0
+#endif
+
+// Freed nonpaged pool allocations whose size is a power of 2 pages (from 2 pages up to MI_NONPAGED_POOL_SIZE_CLASSES doublings) are cached by size class.
+// This lets steady large buffer churn recycle allocations without acquiring the nonpaged pool lock or rescanning the free lists.
+// The pages stay allocated while they are cached, so the cache depth is only made nonzero on large memory machines.
+#define MI_NONPAGED_POOL_SIZE_CLASSES 8
+
+SLIST_HEADER MiNonPagedPoolSizeClassSListHead[MI_NONPAGED_POOL_SIZE_CLASSES];
+ULONG MiNonPagedPoolSizeClassSListMaximum;
+
 SLIST_HEADER MiPagedPoolSListHead;
 ULONG MiPagedPoolSListMaximum = 8;
 
@@ -66,6 +83,23 @@ extern KGUARDED_MUTEX MmPagedPoolMutex;
 
 #define MM_SMALL_ALLOCATIONS 4
 
+// A page on the free, zeroed or standby list that a contiguous allocation can take as it is.
+#define MI_CONTIGUOUS_PAGE_AVAILABLE(Pfn, CacheAttribute) \
+    (((Pfn)->u3.e1.PageLocation <= StandbyPageList) && ((Pfn)->u1.Flink != 0) && ((Pfn)->u2.Blink != 0) && ((Pfn)->u3.e2.ReferenceCount == 0) && (((CacheAttribute) == MiCached) || ((Pfn)->u4.MustBeCached == 0)))
+
+// A page on a modified list whose contents can be moved to another page so that a contiguous allocation can take it.
+// Page table pages are never moved as the PFN entries of the pages they map refer to them by frame number.
+#define MI_CONTIGUOUS_PAGE_RELOCATABLE(Pfn, CacheAttribute) \
+    ((((Pfn)->u3.e1.PageLocation == ModifiedPageList) || ((Pfn)->u3.e1.PageLocation == ModifiedNoWritePageList)) && ((Pfn)->u3.e2.ReferenceCount == 0) && \
+     ((Pfn)->u3.e1.RemovalRequested == 0) && ((Pfn)->u4.InPageError == 0) && (((CacheAttribute) == MiCached) || ((Pfn)->u4.MustBeCached == 0)) && \
+     (((Pfn)->u3.e1.PrototypePte == 1) || (!MI_IS_PAGE_TABLE_ADDRESS(MiGetVirtualAddressMappedByPte((Pfn)->PteAddress)))))
+
+// Relocation releases the PFN lock after this many pages so that a large window does not hold it for long.
+#define MI_RELOCATION_BATCH 16
+
+// The most windows a single contiguous allocation empties by relocation before it falls back to trimming and writing.
+#define MI_CONTIGUOUS_COMPACTION_PASSES 8
+
 #if DBG
 ULONG MiClearCache;
 
@@ -763,6 +797,31 @@ Environment:
 }
 
 
+FORCEINLINE ULONG MiNonPagedPoolSizeClass(IN PFN_NUMBER SizeInPages)
+/*
+Routine Description:
+    This function determines the size class cache that nonpaged pool allocations of the specified size are cached in.
+Arguments:
+    SizeInPages - Supplies the size of the allocation in pages.
+Return Value:
+    The index of the size class, or MI_NONPAGED_POOL_SIZE_CLASSES if allocations of this size are not cached.
+*/
+{
+    ULONG SizeClass;
+
+    if ((SizeInPages < 2) || (SizeInPages > ((PFN_NUMBER)1 << MI_NONPAGED_POOL_SIZE_CLASSES)) || ((SizeInPages & (SizeInPages - 1)) != 0)) {
+        return MI_NONPAGED_POOL_SIZE_CLASSES;
+    }
+
+    SizeClass = 0;
+    while (((PFN_NUMBER)2 << SizeClass) != SizeInPages) {
+        SizeClass += 1;
+    }
+
+    return SizeClass;
+}
+
+
 PVOID MiAllocatePoolPages(IN POOL_TYPE PoolType, IN SIZE_T SizeInBytes)
 /*
 Routine Description:
@@ -807,6 +866,9 @@ Environment:
     ULONG FlushCount;
     PVOID VaFlushList[MM_MAXIMUM_FLUSH_COUNT];
     LOGICAL PreviousPteNeededFlush;
+    ULONG NodeNumber;
+    PSLIST_HEADER SListHead;
+    ULONG SizeClass;
 
     SizeInPages = BYTES_TO_PAGES(SizeInBytes);
 
@@ -817,8 +879,34 @@ Environment:
 #endif
 
     if ((PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool) {
-        if ((SizeInPages == 1) && (ExQueryDepthSList(&MiNonPagedPoolSListHead) != 0)) {
-            BaseVa = InterlockedPopEntrySList(&MiNonPagedPoolSListHead);
+        // Supply pages from the same node the pool allocator selected its descriptor for, i.e. the preferred node of the current process or else the node of the current processor.
+        // This must be captured before any locks are acquired as the preferred node is only honored below DISPATCH_LEVEL.
+        NodeNumber = KeGetPreferredNode()->NodeNumber;
+        SListHead = &MiNonPagedPoolSListHead[NodeNumber];
+        if ((SizeInPages == 1) && (ExQueryDepthSList(SListHead) != 0)) {
+            BaseVa = InterlockedPopEntrySList(SListHead);
+            if (BaseVa != NULL) {
+                if (PoolType & POOL_VERIFIER_MASK) {
+                    if (MI_IS_PHYSICAL_ADDRESS(BaseVa)) {
+                        PageFrameIndex = MI_CONVERT_PHYSICAL_TO_PFN(BaseVa);
+                    } else {
+                        PointerPte = MiGetPteAddress(BaseVa);
+                        ASSERT(PointerPte->u.Hard.Valid == 1);
+                        PageFrameIndex = MI_GET_PAGE_FRAME_FROM_PTE(PointerPte);
+                    }
+                    Pfn1 = MI_PFN_ELEMENT(PageFrameIndex);
+                    Pfn1->u4.VerifierAllocation = 1;
+                }
+
+                return BaseVa;
+            }
+        }
+
+        // Recycle a cached allocation of exactly the same size if there is one.
+        // The verifier tags the allocation in the start PFN just as for single pages.
+        SizeClass = MiNonPagedPoolSizeClass(SizeInPages);
+        if ((SizeClass < MI_NONPAGED_POOL_SIZE_CLASSES) && (ExQueryDepthSList(&MiNonPagedPoolSizeClassSListHead[SizeClass]) != 0)) {
+            BaseVa = InterlockedPopEntrySList(&MiNonPagedPoolSizeClassSListHead[SizeClass]);
             if (BaseVa != NULL) {
                 if (PoolType & POOL_VERIFIER_MASK) {
                     if (MI_IS_PHYSICAL_ADDRESS(BaseVa)) {
@@ -1139,7 +1227,7 @@ Environment:
         // Expand the pool.
         FlushedTb = FALSE;
         do {
-            PageFrameIndex = MiRemoveAnyPage(MI_GET_PAGE_COLOR_FROM_PTE(PointerPte));
+            PageFrameIndex = MiRemoveAnyPage(MI_GET_PAGE_COLOR_NODE(NodeNumber));
 
             Pfn1 = MI_PFN_ELEMENT(PageFrameIndex);
             Pfn1->u3.e2.ReferenceCount = 1;
@@ -1233,6 +1321,13 @@ Environment:
         KeAcquireGuardedMutex(&MmPagedPoolMutex);
     } else {
         SessionSpace = SESSION_GLOBAL(MmSessionSpace);
+        if ((SizeInPages == 1) && (ExQueryDepthSList(&SessionSpace->PagedPoolSListHead) != 0)) {
+            BaseVa = InterlockedPopEntrySList(&SessionSpace->PagedPoolSListHead);
+            if (BaseVa != NULL) {
+                return BaseVa;
+            }
+        }
+
         PagedPoolInfo = &SessionSpace->PagedPoolInfo;
         KeAcquireGuardedMutex(&SessionSpace->PagedPoolMutex);
     }
@@ -1604,6 +1699,7 @@ Environment:
     PULONG BitMap;
     PKGUARDED_MUTEX PoolMutex;
     PFN_NUMBER FreePoolInPages;
+    ULONG SizeClass;
 #if DBG
     PMMPTE DebugPte;
     PMMPFN DebugPfn;
@@ -1656,12 +1752,12 @@ Environment:
 
         ASSERT(Pfn1->u4.PteFrame != MI_MAGIC_AWE_PTEFRAME);
 
-        // Hang single page allocations off our slist header.
+        // Hang single page allocations off the slist header of the node whose memory backs the page.
         if ((Pfn1->u3.e1.EndOfAllocation == 1) &&
             (Pfn1->u4.VerifierAllocation == 0) &&
             (Pfn1->u3.e1.LargeSessionAllocation == 0) &&
-            (ExQueryDepthSList(&MiNonPagedPoolSListHead) < MiNonPagedPoolSListMaximum)) {
-            InterlockedPushEntrySList(&MiNonPagedPoolSListHead, (PSLIST_ENTRY)StartingAddress);
+            (ExQueryDepthSList(&MiNonPagedPoolSListHead[MI_NONPAGED_POOL_SLIST_NODE(Pfn1)]) < MiNonPagedPoolSListMaximum)) {
+            InterlockedPushEntrySList(&MiNonPagedPoolSListHead[MI_NONPAGED_POOL_SLIST_NODE(Pfn1)], (PSLIST_ENTRY)StartingAddress);
             return 1;
         }
 
@@ -1719,6 +1815,17 @@ Environment:
         }
 #endif
 
+        // Hang power of 2 sized multipage allocations off the slist header of their size class.
+        // The allocation remains intact (including its start and end of allocation marks) so it can be handed straight back out.
+        SizeClass = MiNonPagedPoolSizeClass(NumberOfPages);
+        if ((SizeClass < MI_NONPAGED_POOL_SIZE_CLASSES) &&
+            (VerifierAllocation == 0) &&
+            (OriginalPfnFlags.LargeSessionAllocation == 0) &&
+            (ExQueryDepthSList(&MiNonPagedPoolSizeClassSListHead[SizeClass]) < MiNonPagedPoolSizeClassSListMaximum)) {
+            InterlockedPushEntrySList(&MiNonPagedPoolSizeClassSListHead[SizeClass], (PSLIST_ENTRY)StartingAddress);
+            return (ULONG)NumberOfPages;
+        }
+
         OldIrql = KeAcquireQueuedSpinLock(LockQueueMmNonPagedPoolLock);
 
         StartPfn->u3.e1.StartOfAllocation = 0;
@@ -2058,6 +2165,13 @@ Environment:
             KeReleaseGuardedMutex(&MmPagedPoolMutex);
             return (ULONG)NumberOfPages;
         }
+    } else if ((NumberOfPages == 1) &&
+               (SessionSpace->u.Flags.DeletePending == 0) &&
+               (ExQueryDepthSList(&SessionSpace->PagedPoolSListHead) < MiPagedPoolSListMaximum)) {
+        // Each session keeps its own freed single pages so win32k allocation churn neither takes the session paged pool mutex nor refaults the page.
+        // The session drains the list once deletion is pending.
+        InterlockedPushEntrySList(&SessionSpace->PagedPoolSListHead, (PSLIST_ENTRY)StartingAddress);
+        return 1;
     }
 
     PointerPte = PagedPoolInfo->FirstPteForPagedPool + StartPosition;
@@ -2169,11 +2283,18 @@ Environment:
 
     // Initialize the slist heads for free pages (both paged & nonpaged).
     InitializeSListHead(&MiPagedPoolSListHead);
-    InitializeSListHead(&MiNonPagedPoolSListHead);
+    for (Index = 0; Index < MAXIMUM_CCNUMA_NODES; Index += 1) {
+        InitializeSListHead(&MiNonPagedPoolSListHead[Index]);
+    }
+
+    for (Index = 0; Index < MI_NONPAGED_POOL_SIZE_CLASSES; Index += 1) {
+        InitializeSListHead(&MiNonPagedPoolSizeClassSListHead[Index]);
+    }
 
     if (MmNumberOfPhysicalPages >= (2 * 1024 * ((1024 * 1024) / PAGE_SIZE))) {
         MiNonPagedPoolSListMaximum <<= 3;
         MiPagedPoolSListMaximum <<= 3;
+        MiNonPagedPoolSizeClassSListMaximum = 2;
     } else if (MmNumberOfPhysicalPages >= (1 * 1024 * ((1024 * 1024) / PAGE_SIZE))) {
         MiNonPagedPoolSListMaximum <<= 1;
         MiPagedPoolSListMaximum <<= 1;
@@ -2182,6 +2303,7 @@ Environment:
     // If the verifier or special pool is enabled, then disable lookasides so driver bugs can be found more quickly.
     if ((MmVerifyDriverBufferLength != (ULONG)-1) || (MmProtectFreedNonPagedPool == TRUE) || ((MmSpecialPoolTag != 0) && (MmSpecialPoolTag != (ULONG)-1))) {
         MiNonPagedPoolSListMaximum = 0;
+        MiNonPagedPoolSizeClassSListMaximum = 0;
         MiPagedPoolSListMaximum = 0;
     }
 
@@ -2545,6 +2667,7 @@ Environment:
 
     SessionGlobal = SESSION_GLOBAL(MmSessionSpace);
     KeInitializeGuardedMutex(&SessionGlobal->PagedPoolMutex);
+    InitializeSListHead(&SessionGlobal->PagedPoolSListHead);
     PoolDescriptor = &MmSessionSpace->PagedPool;
     ExInitializePoolDescriptor(PoolDescriptor, PagedPoolSession, 0, 0, &SessionGlobal->PagedPoolMutex);
     MmSessionSpace->PagedPoolStart = (PVOID)MiSessionPoolStart;
@@ -2979,6 +3102,7 @@ Environment:
     PFN_NUMBER PageFrameIndex;
     MI_PFN_CACHE_ATTRIBUTE CacheAttribute;
     ULONG RetryCount;
+    ULONG CompactionPasses;
     LOGICAL FlushedTb;
 
     PAGED_CODE();
@@ -3021,6 +3145,7 @@ Environment:
     MI_DECREMENT_RESIDENT_AVAILABLE(SizeInPages, MM_RESAVAIL_ALLOCATE_CONTIGUOUS);
     UNLOCK_PFN(OldIrql);
     RetryCount = 4;
+    CompactionPasses = MI_CONTIGUOUS_COMPACTION_PASSES;
 
 Retry:
     start = 0;
@@ -3044,7 +3169,15 @@ Retry:
             found = 0;
             Pfn1 = MI_PFN_ELEMENT(Page);
             for (; Page < LastPage; Page += 1, Pfn1 += 1) {
-                if ((Pfn1->u3.e1.PageLocation <= StandbyPageList) && (Pfn1->u1.Flink != 0) && (Pfn1->u2.Blink != 0) && (Pfn1->u3.e2.ReferenceCount == 0) && ((CacheAttribute == MiCached) || (Pfn1->u4.MustBeCached == 0))) {
+                // Skip aligned groups of 32 pages that are all off the available lists without touching their PFN entries.
+                if (((Page & 31) == 0) && (Page + 32 <= LastPage) && (MiAvailablePfnBitMap.Buffer != NULL) && (((PULONG)MiAvailablePfnBitMap.Buffer)[Page / 32] == 0)) {
+                    found = 0;
+                    Page += 31;
+                    Pfn1 += 31;
+                    continue;
+                }
+
+                if (MI_PFN_MAY_BE_AVAILABLE(Page) && MI_CONTIGUOUS_PAGE_AVAILABLE(Pfn1, CacheAttribute)) {
                     // Before starting a new run, ensure that it can satisfy the boundary requirements (if any).
                     if ((found == 0) && (BoundaryPfn != 0)) {
                         if (((Page ^ (Page + SizeInPages - 1)) & BoundaryMask) != 0) {
@@ -3060,7 +3193,7 @@ Retry:
                         Page -= (found - 1);
                         LOCK_PFN(OldIrql);
                         do {
-                            if ((Pfn1->u3.e1.PageLocation <= StandbyPageList) && (Pfn1->u1.Flink != 0) && (Pfn1->u2.Blink != 0) && (Pfn1->u3.e2.ReferenceCount == 0) && ((CacheAttribute == MiCached) || (Pfn1->u4.MustBeCached == 0))) {
+                            if (MI_CONTIGUOUS_PAGE_AVAILABLE(Pfn1, CacheAttribute)) {
                                 NOTHING;            // Good page
                             } else {
                                 break;
@@ -3094,6 +3227,13 @@ Retry:
         goto Failed;
     }
 
+    // Modified pages are often all that stands in the way of a fit.
+    // Moving them out of a window is far cheaper than writing every modified page in the system, so try that first at each step.
+    if ((CompactionPasses != 0) && (MiCompactContiguousPages(LowestPfn, HighestPfn, BoundaryPfn, SizeInPages, CacheAttribute))) {
+        CompactionPasses -= 1;
+        goto Retry;
+    }
+
     InterlockedIncrement(&MiDelayPageFaults);
 
     // Attempt to move pages to the standby list.
@@ -3223,6 +3363,222 @@ Success:
 }
 
 
+LOGICAL MiRelocateModifiedPage(IN PMMPFN Pfn1, IN PFN_NUMBER LowestAvoidPfn, IN PFN_NUMBER HighestAvoidPfn, IN PVOID Buffer)
+/*
+Routine Description:
+    This function moves the contents of a page on the modified or modified no write list to another page and frees the original page.
+    The transition PTE (which may be a prototype PTE) is pointed at the new page, which takes the place of the original page on its list.
+    The paging file space or file offset the page is bound for moves to the new page along with its contents.
+Arguments:
+    Pfn1 - Supplies the PFN element of the page to move.
+    LowestAvoidPfn - Supplies the first page of the range that the new page must not be taken from.
+    HighestAvoidPfn - Supplies the page following the range that the new page must not be taken from.
+    Buffer - Supplies a page of nonpaged pool to copy the contents through.
+Return Value:
+    TRUE if the page was moved, FALSE if not.
+Environment:
+    Kernel mode, PFN lock held.
+*/
+{
+    PMMPFN Pfn2;
+    PMMPTE PointerPte;
+    MMPTE TempPte;
+    PEPROCESS Process;
+    PVOID Va;
+    PMMPFNLIST ListHead;
+    PFN_NUMBER OldPage;
+    PFN_NUMBER NewPage;
+    LOGICAL Mapped;
+
+    MM_PFN_LOCK_ASSERT();
+    ASSERT(MI_CONTIGUOUS_PAGE_RELOCATABLE(Pfn1, MiCached));
+
+    if (MmAvailablePages < MM_HIGH_LIMIT) {
+        return FALSE;
+    }
+
+    OldPage = MI_PFN_ELEMENT_TO_INDEX(Pfn1);
+    NewPage = MiRemoveAnyPage(MI_GET_COLOR_FROM_LIST_ENTRY(OldPage, Pfn1));
+    Pfn2 = MI_PFN_ELEMENT(NewPage);
+
+    // A page from the range being emptied would make no progress, and one last mapped with another cache attribute would need the entire TB flushed.
+    if (((NewPage >= LowestAvoidPfn) && (NewPage < HighestAvoidPfn)) || (Pfn2->u3.e1.CacheAttribute != Pfn1->u3.e1.CacheAttribute)) {
+        MiInsertPageInFreeList(NewPage);
+        return FALSE;
+    }
+
+    // The page is not mapped anywhere and the PFN lock keeps it off the I/O paths, so nothing can change it during the copy.
+    Process = PsGetCurrentProcess();
+    Va = MiMapPageInHyperSpaceAtDpc(Process, OldPage);
+    RtlCopyMemory(Buffer, Va, PAGE_SIZE);
+    MiUnmapPageInHyperSpaceFromDpc(Process, Va);
+
+    Va = MiMapPageInHyperSpaceAtDpc(Process, NewPage);
+    RtlCopyMemory(Va, Buffer, PAGE_SIZE);
+    MiUnmapPageInHyperSpaceFromDpc(Process, Va);
+
+    // Point the transition PTE at the new page.  It is reached the same way MiRestoreTransitionPte reaches it.
+    PointerPte = Pfn1->PteAddress;
+    if (Pfn1->u3.e1.PrototypePte) {
+        Mapped = !MiIsProtoAddressValid(PointerPte);
+    } else {
+        Mapped = ((PointerPte < MiGetPteAddress((PVOID)MM_SYSTEM_SPACE_START)) || MI_IS_SESSION_PTE(PointerPte));
+    }
+
+    if (Mapped) {
+        PointerPte = MiMapPageInHyperSpaceAtDpc(Process, Pfn1->u4.PteFrame);
+        PointerPte = (PMMPTE)((PCHAR)PointerPte + MiGetByteOffset(Pfn1->PteAddress));
+    }
+
+    ASSERT((MI_GET_PAGE_FRAME_FROM_TRANSITION_PTE(PointerPte) == OldPage) && (PointerPte->u.Hard.Valid == 0));
+
+    TempPte = *PointerPte;
+    TempPte.u.Trans.PageFrameNumber = NewPage;
+    MI_WRITE_INVALID_PTE_WITHOUT_WS(PointerPte, TempPte);
+    if (Mapped) {
+        MiUnmapPageInHyperSpaceFromDpc(Process, PointerPte);
+    }
+
+    // The new page takes over everything the PTE and the page table (or prototype PTE) page know about the original page.
+    // The share count of the containing page and the PFN references of the control area are unchanged as there is still exactly one page.
+    ListHead = MmPageLocationList[Pfn1->u3.e1.PageLocation];
+    MiUnlinkPageFromList(Pfn1);
+
+    Pfn2->PteAddress = Pfn1->PteAddress;
+    Pfn2->OriginalPte = Pfn1->OriginalPte;
+    Pfn2->u4.PteFrame = Pfn1->u4.PteFrame;
+    MI_SET_PFN_PRIORITY(Pfn2, MI_GET_PFN_PRIORITY(Pfn1));
+    Pfn2->u3.e1.PrototypePte = Pfn1->u3.e1.PrototypePte;
+    Pfn2->u3.e1.Modified = 1;
+    Pfn2->u3.e2.ReferenceCount = 0;
+    Pfn2->u2.ShareCount = 0;
+    MiInsertPageInList(ListHead, NewPage);
+
+    // The original page is freed without releasing the paging file space as that belongs to the new page now.
+    MI_SET_PFN_DELETED(Pfn1);
+    Pfn1->u3.e1.Modified = 0;
+    Pfn1->u3.e1.PrototypePte = 0;
+    MiInsertPageInFreeList(OldPage);
+    return TRUE;
+}
+
+
+LOGICAL MiCompactContiguousPages(IN PFN_NUMBER LowestPfn, IN PFN_NUMBER HighestPfn, IN PFN_NUMBER BoundaryPfn, IN PFN_NUMBER SizeInPages, IN MI_PFN_CACHE_ATTRIBUTE CacheAttribute)
+/*
+Routine Description:
+    This function searches the PFN database for a window of pages that satisfies a contiguous request once its modified pages are moved elsewhere, then moves them.
+    The freed pages go to the free list where MiFindContiguousPages takes them on its next scan.
+
+    Active pages are not moved here as that would need the working set lock of whatever process maps them.
+    The caller trims the working sets instead, after which private pages sit on the standby or modified lists where they are taken or moved.
+Arguments:
+    LowestPfn - Supplies the lowest acceptable physical page number.
+    HighestPfn - Supplies the highest acceptable physical page number.
+    BoundaryPfn - Supplies the page frame number multiple the allocation must not cross.  0 indicates it can cross any boundary.
+    SizeInPages - Supplies the number of pages to allocate.
+    CacheAttribute - Supplies the cache attribute the memory will be mapped with.
+Return Value:
+    TRUE if a window was emptied, FALSE if not.
+Environment:
+    Kernel mode, IRQL of APC_LEVEL or below.
+*/
+{
+    PMMPFN Pfn1;
+    KIRQL OldIrql;
+    ULONG start;
+    PFN_NUMBER count;
+    PFN_NUMBER Page;
+    PFN_NUMBER LastPage;
+    PFN_NUMBER found;
+    PFN_NUMBER WindowPage;
+    PFN_NUMBER BoundaryMask;
+    ULONG Batch;
+    PVOID Buffer;
+    LOGICAL Emptied;
+
+    Buffer = ExAllocatePoolWithTag(NonPagedPool, PAGE_SIZE, 'pCmM');
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    BoundaryMask = ~(BoundaryPfn - 1);
+    Emptied = FALSE;
+    start = 0;
+    do {
+        count = MmPhysicalMemoryBlock->Run[start].PageCount;
+        Page = MmPhysicalMemoryBlock->Run[start].BasePage;
+        LastPage = Page + count;
+        if (LastPage - 1 > HighestPfn) {
+            LastPage = HighestPfn + 1;
+        }
+
+        if (Page < LowestPfn) {
+            Page = LowestPfn;
+        }
+
+        if ((count != 0) && (Page + SizeInPages <= LastPage)) {
+            found = 0;
+            Pfn1 = MI_PFN_ELEMENT(Page);
+            for (; Page < LastPage; Page += 1, Pfn1 += 1) {
+                if ((MI_CONTIGUOUS_PAGE_AVAILABLE(Pfn1, CacheAttribute) == FALSE) && (MI_CONTIGUOUS_PAGE_RELOCATABLE(Pfn1, CacheAttribute) == FALSE)) {
+                    found = 0;
+                    continue;
+                }
+
+                if ((found == 0) && (BoundaryPfn != 0)) {
+                    if (((Page ^ (Page + SizeInPages - 1)) & BoundaryMask) != 0) {
+                        continue;
+                    }
+                }
+
+                found += 1;
+                if (found != SizeInPages) {
+                    continue;
+                }
+
+                // Move the modified pages out of the window, checking each page again now that the PFN lock is held.
+                WindowPage = Page - SizeInPages + 1;
+                Pfn1 -= (SizeInPages - 1);
+                Batch = 0;
+                LOCK_PFN(OldIrql);
+                for (; WindowPage <= Page; WindowPage += 1, Pfn1 += 1) {
+                    if (MI_CONTIGUOUS_PAGE_AVAILABLE(Pfn1, CacheAttribute)) {
+                        continue;
+                    }
+
+                    if ((MI_CONTIGUOUS_PAGE_RELOCATABLE(Pfn1, CacheAttribute) == FALSE) || (MiRelocateModifiedPage(Pfn1, Page - SizeInPages + 1, Page + 1, Buffer) == FALSE)) {
+                        break;
+                    }
+
+                    Batch += 1;
+                    if (Batch == MI_RELOCATION_BATCH) {
+                        UNLOCK_PFN(OldIrql);
+                        Batch = 0;
+                        LOCK_PFN(OldIrql);
+                    }
+                }
+                UNLOCK_PFN(OldIrql);
+
+                if (WindowPage > Page) {
+                    Emptied = TRUE;
+                    goto Done;
+                }
+
+                // The pages moved so far are simply free now.  Carry on with the page that could not be moved.
+                Page = WindowPage;
+                found = 0;
+            }
+        }
+
+        start += 1;
+    } while (start != MmPhysicalMemoryBlock->NumberOfRuns);
+
+Done:
+    ExFreePool(Buffer);
+    return Emptied;
+}
+
+
 VOID MiFreeContiguousPages(IN PFN_NUMBER PageFrameIndex, IN PFN_NUMBER SizeInPages)
 /*
 Routine Description:
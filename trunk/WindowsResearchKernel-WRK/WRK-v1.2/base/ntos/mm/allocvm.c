@@ -8,7 +8,7 @@ Module Name:
    allocvm.c
 
 Abstract:
-    This module contains the routines which implement the NtAllocateVirtualMemory service.
+    This module contains the routines which implement the NtAllocateVirtualMemory and NtAllocateVirtualMemoryRanges services.
 */
 
 #include "mi.h"
@@ -16,11 +16,31 @@ Abstract:
 const ULONG MMVADKEY = ' daV'; //Vad
 
 NTSTATUS MiResetVirtualMemory(IN PVOID StartingAddress, IN PVOID EndingAddress, IN PMMVAD Vad, IN PEPROCESS Process);
+NTSTATUS MiAdviseVirtualMemory(IN PVOID StartingAddress, IN PVOID EndingAddress, IN PMMVAD Vad, IN PEPROCESS Process, IN ULONG Advice);
+NTSTATUS MiCommitPrivateVirtualMemory(IN PEPROCESS Process,
+                                      IN PMMVAD FoundVad,
+                                      IN PVOID StartingAddress,
+                                      IN PVOID EndingAddress,
+                                      IN ULONG Protect,
+                                      IN MM_PROTECTION_MASK ProtectionMask,
+                                      IN OUT PULONG ChangeProtection,
+                                      IN OUT PMI_DEFERRED_CHARGES Charges);
+NTSTATUS MiAllocateVirtualMemoryRange(IN PEPROCESS Process,
+                                      IN OUT PMEMORY_RANGE_ENTRY Range,
+                                      IN ULONG AllocationType,
+                                      IN ULONG Protect,
+                                      IN MM_PROTECTION_MASK ProtectionMask,
+                                      IN OUT PULONG ChangeProtection,
+                                      IN OUT PMI_DEFERRED_CHARGES Charges);
 VOID MiFlushAcquire(IN PCONTROL_AREA ControlArea);
 VOID MiFlushRelease(IN PCONTROL_AREA ControlArea);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,MmCommitSessionMappedView)
+#pragma alloc_text(PAGE,NtAllocateVirtualMemoryRanges)
+#pragma alloc_text(PAGE,MiAllocateVirtualMemoryRange)
+#pragma alloc_text(PAGE,MiAdviseVirtualMemory)
+#pragma alloc_text(PAGE,MiCommitPrivateVirtualMemory)
 #pragma alloc_text(PAGELK,MiResetVirtualMemory)
 #if defined (_WIN64)
 #pragma alloc_text(PAGELK,MiCreatePageDirectoriesForPhysicalRange)
@@ -29,6 +49,15 @@ VOID MiFlushRelease(IN PCONTROL_AREA ControlArea);
 
 SIZE_T MmTotalProcessCommit;        // Only used for debugging
 
+// Read-write private allocations that are reserved and committed together and are at least this large are backed with large pages when
+// contiguous memory is available, without the caller asking for MEM_LARGE_PAGES or holding the lock memory privilege.
+// The size must be a multiple of the large page size. Zero disables this.
+// N.B. Large page regions are nonpageable and cannot be decommitted, partially freed or reprotected, so this is off by default.
+SIZE_T MmTransparentLargePageMinimum;
+
+ULONG MmTransparentLargePageAllocations;
+ULONG MmTransparentLargePageFallbacks;
+
 
 NTSTATUS NtAllocateVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID *BaseAddress, __in ULONG_PTR ZeroBits, __inout PSIZE_T RegionSize, __in ULONG AllocationType, __in ULONG Protect)
 /*
@@ -67,6 +96,13 @@ Arguments:
 
                      The Protect argument is ignored, but a valid protection must be specified.
 
+         MEM_ADVISE - Advise how the region of previously reserved pages will be used. The Protect argument supplies the advice instead of a protection:
+                      MEM_ADVICE_NORMAL, MEM_ADVICE_RANDOM or MEM_ADVICE_SEQUENTIAL set the access pattern the page fault clustering assumes
+                      for the whole allocation or view containing the region.
+                      MEM_ADVICE_WILLNEED queues a read of the mapped file pages of the region.
+                      MEM_ADVICE_DONTNEED resets the region as MEM_RESET does.
+                      MEM_ADVISE may not be combined with any other flag.
+
          MEM_PHYSICAL - The specified region of pages will map physical memory directly via the AWE APIs.
          MEM_LARGE_PAGES - The specified region of pages will be allocated from physically contiguous (non-paged) pages and be mapped with a large TB entry.
          MEM_WRITE_WATCH - The specified private region is to be used for write-watch purposes.
@@ -100,23 +136,17 @@ Return Value:
     SIZE_T CapturedRegionSize;
     SIZE_T NumberOfPages;
     PMMPTE PointerPte;
-    PMMPTE CommitLimitPte;
     MM_PROTECTION_MASK ProtectionMask;
     PMMPTE LastPte;
-    PMMPTE PointerPde;
     PMMPTE StartingPte;
     MMPTE TempPte;
     ULONG OldProtect;
     SIZE_T QuotaCharge;
-    SIZE_T ExcessCharge;
     SIZE_T QuotaFree;
     SIZE_T CopyOnWriteCharge;
     LOGICAL Attached;
     LOGICAL ChargedExactQuota;
-    MMPTE DecommittedPte;
     ULONG ChangeProtection;
-    PVOID UsedPageTableHandle;
-    PUCHAR Va;
     LOGICAL ChargedJobCommit;
     PMI_PHYSICAL_VIEW PhysicalView;
     PRTL_BITMAP BitMap;
@@ -129,10 +159,14 @@ Return Value:
     PSEGMENT Segment;
     PETHREAD CurrentThread;
     PEPROCESS CurrentProcess;
+    LOGICAL TransparentLargePages;
+    MI_DEFERRED_CHARGES Charges;
+    MEMORY_RANGE_ENTRY PrefetchRange;
 
     PAGED_CODE();
 
     Attached = FALSE;
+    TransparentLargePages = FALSE;
 
     // Check the zero bits argument for correctness.
 
@@ -149,12 +183,12 @@ Return Value:
     }
 
     // Check the AllocationType for correctness.
-    if ((AllocationType & ~(MEM_COMMIT | MEM_RESERVE | MEM_PHYSICAL | MEM_LARGE_PAGES | MEM_TOP_DOWN | MEM_RESET | MEM_WRITE_WATCH)) != 0) {
+    if ((AllocationType & ~(MEM_COMMIT | MEM_RESERVE | MEM_PHYSICAL | MEM_LARGE_PAGES | MEM_TOP_DOWN | MEM_RESET | MEM_WRITE_WATCH | MEM_ADVISE)) != 0) {
         return STATUS_INVALID_PARAMETER_5;
     }
 
-    // One of MEM_COMMIT, MEM_RESET or MEM_RESERVE must be set.
-    if ((AllocationType & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) == 0) {
+    // One of MEM_COMMIT, MEM_RESET, MEM_ADVISE or MEM_RESERVE must be set.
+    if ((AllocationType & (MEM_COMMIT | MEM_RESERVE | MEM_RESET | MEM_ADVISE)) == 0) {
         return STATUS_INVALID_PARAMETER_5;
     }
 
@@ -162,6 +196,10 @@ Return Value:
         return STATUS_INVALID_PARAMETER_5;// MEM_RESET may not be used with any other flag.
     }
 
+    if ((AllocationType & MEM_ADVISE) && (AllocationType != MEM_ADVISE)) {
+        return STATUS_INVALID_PARAMETER_5;// MEM_ADVISE may not be used with any other flag.
+    }
+
     // All of these flags are generally rare so check for any of them being set with one test.
     if (AllocationType & (MEM_LARGE_PAGES | MEM_WRITE_WATCH | MEM_PHYSICAL)) {
         if (AllocationType & MEM_LARGE_PAGES) {
@@ -205,12 +243,20 @@ Return Value:
         }
     }
 
-    // Check the protection field.
-    ProtectionMask = MiMakeProtectionMask(Protect);
-    if (ProtectionMask == MM_INVALID_PROTECTION) {
-        return STATUS_INVALID_PAGE_PROTECTION;
+    // Check the protection field.  The Protect argument of MEM_ADVISE carries the advice instead.
+    if (AllocationType == MEM_ADVISE) {
+        if (Protect > MEM_ADVICE_DONTNEED) {
+            return STATUS_INVALID_PARAMETER_6;
+        }
+        ProtectionMask = MM_NOACCESS;
+    } else {
+        ProtectionMask = MiMakeProtectionMask(Protect);
+        if (ProtectionMask == MM_INVALID_PROTECTION) {
+            return STATUS_INVALID_PAGE_PROTECTION;
+        }
     }
     ChangeProtection = FALSE;
+    RtlZeroMemory(&Charges, sizeof(Charges));
     CurrentThread = PsGetCurrentThread();
     CurrentProcess = PsGetCurrentProcessByThread(CurrentThread);
     PreviousMode = KeGetPreviousModeByThread(&CurrentThread->Tcb);
@@ -242,6 +288,10 @@ Return Value:
         return STATUS_INVALID_PARAMETER_4;// Region size cannot be 0.
     }
 
+    if ((AllocationType == MEM_ADVISE) && (CapturedBase == NULL)) {
+        return STATUS_INVALID_PARAMETER_2;// Advice only applies to reserved pages.
+    }
+
     // Reference the specified process handle for VM_OPERATION access.
     if (ProcessHandle == NtCurrentProcess()) {
         Process = CurrentProcess;
@@ -301,6 +351,23 @@ Return Value:
             NumberOfPages = BYTES_TO_PAGES(CapturedRegionSize);
             SATISFY_OVERZEALOUS_COMPILER(StartingAddress = NULL);
             SATISFY_OVERZEALOUS_COMPILER(EndingAddress = NULL);
+
+            // Try large pages for a big enough read-write region that is committed up front.
+            // Any failure to get an aligned range or contiguous memory falls back to ordinary pages below.
+            if ((MmTransparentLargePageMinimum != 0) &&
+                ((AllocationType & ~MEM_TOP_DOWN) == (MEM_COMMIT | MEM_RESERVE)) &&
+                (ProtectionMask == MM_READWRITE) &&
+                (CapturedRegionSize >= MmTransparentLargePageMinimum) &&
+                ((CapturedRegionSize % MM_MINIMUM_VA_FOR_LARGE_PAGE) == 0)) {
+#ifdef _X86_
+                if (KeFeatureBits & KF_LARGE_PAGE)
+#endif
+                {
+                    AllocationType |= MEM_LARGE_PAGES;
+                    TransparentLargePages = TRUE;
+                }
+            }
+
             if (AllocationType & MEM_LARGE_PAGES) {
 #ifdef _X86_
                 if ((KeFeatureBits & KF_LARGE_PAGE) == 0) {
@@ -477,12 +544,26 @@ Return Value:
 
         // Find a (or validate the) starting address.
         if (CapturedBase == NULL) {
-            if (AllocationType & MEM_TOP_DOWN) {
-                // Start from the top of memory downward.
-                Status = MiFindEmptyAddressRangeDown(&Process->VadRoot, CapturedRegionSize, TopAddress, Alignment, &StartingAddress);
-            } else {
-                Status = MiFindEmptyAddressRange(CapturedRegionSize, Alignment, (ULONG)ZeroBits, &StartingAddress);
-            }
+            do {
+                if (AllocationType & MEM_TOP_DOWN) {
+                    // Start from the top of memory downward.
+                    Status = MiFindEmptyAddressRangeDown(&Process->VadRoot, CapturedRegionSize, TopAddress, Alignment, &StartingAddress);
+                } else {
+                    Status = MiFindEmptyAddressRange(CapturedRegionSize, Alignment, (ULONG)ZeroBits, &StartingAddress);
+                }
+
+                if ((NT_SUCCESS(Status)) || (TransparentLargePages == FALSE)) {
+                    break;
+                }
+
+                // There is no naturally aligned range free, so look again for ordinary pages at the usual alignment.
+                TransparentLargePages = FALSE;
+                AllocationType &= ~MEM_LARGE_PAGES;
+                Alignment = X64K;
+                Vad->u.VadFlags.VadType = VadNone;
+                ExFreePool(PhysicalView);
+                InterlockedIncrement((PLONG)&MmTransparentLargePageFallbacks);
+            } while (TRUE);
 
             if (!NT_SUCCESS(Status)) {
                 goto ErrorReleaseVad;
@@ -540,6 +621,20 @@ Return Value:
                 // Restore the correct protection.
                 LOCK_WS_UNSAFE(CurrentThread, Process);
                 Vad->u.VadFlags.Protection = ProtectionMask;
+
+                if (TransparentLargePages) {
+                    if (!NT_SUCCESS(Status)) {
+                        // Contiguous memory is not available, so the range is backed with ordinary pages instead.
+                        // Nothing has been mapped yet and the VAD charges are the same for both.
+                        Vad->u.VadFlags.VadType = VadNone;
+                        UNLOCK_WS_UNSAFE(CurrentThread, Process);
+                        ExFreePool(PhysicalView);
+                        InterlockedIncrement((PLONG)&MmTransparentLargePageFallbacks);
+                        goto Inserted;
+                    }
+
+                    InterlockedIncrement((PLONG)&MmTransparentLargePageAllocations);
+                }
             } else if (MiCreatePageTablesForPhysicalRange(Process, StartingAddress, EndingAddress) == FALSE) {
                 Status = STATUS_INSUFFICIENT_RESOURCES;
             }
@@ -610,7 +705,7 @@ Return Value:
     }
 
     // Commit previously reserved pages.  Note that these pages could be either private or a section.
-    if (AllocationType == MEM_RESET) {
+    if ((AllocationType == MEM_RESET) || ((AllocationType == MEM_ADVISE) && (Protect == MEM_ADVICE_DONTNEED))) {
         // Round up to page boundaries so good data is not reset.
         EndingAddress = (PVOID)((ULONG_PTR)PAGE_ALIGN((ULONG_PTR)CapturedBase + CapturedRegionSize) - 1);
         StartingAddress = (PVOID)PAGE_ALIGN((PUCHAR)CapturedBase + PAGE_SIZE - 1);
@@ -665,6 +760,17 @@ Return Value:
         goto done;
     }
 
+    if (AllocationType == MEM_ADVISE) {
+        Status = MiAdviseVirtualMemory(StartingAddress, EndingAddress, FoundVad, Process, Protect);
+        UNLOCK_ADDRESS_SPACE(Process);
+        if (NT_SUCCESS(Status) && (Protect == MEM_ADVICE_WILLNEED)) {
+            PrefetchRange.VirtualAddress = StartingAddress;
+            PrefetchRange.NumberOfBytes = CapturedRegionSize;
+            MiPrefetchVirtualMemory(Process, 1, &PrefetchRange, PreviousMode);
+        }
+        goto done;
+    }
+
     if (FoundVad->u.VadFlags.PrivateMemory == 0) {
         if (FoundVad->u.VadFlags.VadType == VadLargePageSection) {
             Status = STATUS_INVALID_PAGE_PROTECTION;
@@ -959,10 +1065,429 @@ Return Value:
 
     ASSERT(FoundVad->u.VadFlags.VadType != VadRotatePhysical);
 
+    Status = MiCommitPrivateVirtualMemory(Process, FoundVad, StartingAddress, EndingAddress, Protect, ProtectionMask, &ChangeProtection, &Charges);
+    if (!NT_SUCCESS(Status)) {
+        goto ErrorReturn0;
+    }
+
+    UNLOCK_ADDRESS_SPACE(Process);
+
+    // Return the excess charges after releasing the mutex to reduce contention.
+    MiReturnDeferredCharges(Process, &Charges);
+
+    // Previously reserved pages have been committed or an error occurred.
+    // Detach, dereference process and return status.
+
+done:
+    if (ChangeProtection) {
+        PVOID Start;
+        SIZE_T Size;
+        ULONG LastProtect;
+
+        Start = StartingAddress;
+        Size = CapturedRegionSize;
+        MiProtectVirtualMemory(Process, &Start, &Size, Protect, &LastProtect);
+    }
+
+    if (Attached == TRUE) {
+        KeUnstackDetachProcess(&ApcState);
+    }
+
+    if (ProcessHandle != NtCurrentProcess()) {
+        ObDereferenceObject(Process);
+    }
+
+    // Establish an exception handler and write the size and base address.
+    try {
+        *RegionSize = CapturedRegionSize;
+        *BaseAddress = StartingAddress;
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        return GetExceptionCode();
+    }
+
+    return Status;
+
+ErrorReturn0:
+    UNLOCK_ADDRESS_SPACE(Process);
+
+ErrorReturn1:
+    if (Attached == TRUE) {
+        KeUnstackDetachProcess(&ApcState);
+    }
+    if (ProcessHandle != NtCurrentProcess()) {
+        ObDereferenceObject(Process);
+    }
+    return Status;
+}
+
+
+NTSTATUS NtAllocateVirtualMemoryRanges(__in HANDLE ProcessHandle,
+                                       __in ULONG_PTR NumberOfEntries,
+                                       __inout_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY Ranges,
+                                       __in ULONG AllocationType,
+                                       __in ULONG Protect,
+                                       __out_opt PULONG_PTR NumberOfEntriesProcessed
+)
+/*
+Routine Description:
+    This function commits, resets or advises a number of regions of previously reserved pages within the virtual address space of a subject process.
+    All the regions are processed with a single acquisition of the address space mutex and the excess charges are returned once for all of them,
+    which is cheaper for a heap or garbage collector than making one call per region.
+    The regions are processed in order and processing stops at the first region that fails.
+Arguments:
+    ProcessHandle - Supplies an open handle to a process object.
+    NumberOfEntries - Supplies the number of regions, up to MM_MAXIMUM_VIRTUAL_MEMORY_RANGES.
+    Ranges - Supplies the base address and size of each region. The base address may not be NULL.
+             Each processed entry receives the page aligned base address and size the operation applied to.
+    AllocationType - Supplies one of the following, applied to every region:
+         MEM_COMMIT - Commit the pages of a private region. Regions of section views must be committed with NtAllocateVirtualMemory.
+         MEM_RESET - Reset the pages as for NtAllocateVirtualMemory.
+         MEM_ADVISE - Apply the MEM_ADVICE_* value given in the Protect argument as for NtAllocateVirtualMemory.
+    Protect - Supplies the protection for MEM_COMMIT or the advice for MEM_ADVISE. A valid protection must be given for MEM_RESET.
+    NumberOfEntriesProcessed - Optionally receives the number of regions that were processed.
+Return Value:
+    NTSTATUS. If a region fails the status is the one NtAllocateVirtualMemory would have returned for it,
+    and all the regions before it have been processed.
+*/
+{
+    KAPC_STATE ApcState;
+    PEPROCESS Process;
+    KPROCESSOR_MODE PreviousMode;
+    NTSTATUS Status;
+    LOGICAL Attached;
+    MM_PROTECTION_MASK ProtectionMask;
+    ULONG ChangeProtection;
+    PMEMORY_RANGE_ENTRY CapturedRanges;
+    MEMORY_RANGE_ENTRY LocalRanges[MM_VIRTUAL_MEMORY_RANGES_ON_STACK];
+    MI_DEFERRED_CHARGES Charges;
+    ULONG_PTR Processed;
+    ULONG_PTR i;
+    PVOID Start;
+    SIZE_T Size;
+    ULONG LastProtect;
+    PETHREAD CurrentThread;
+    PEPROCESS CurrentProcess;
+
+    PAGED_CODE();
+
+    if ((AllocationType != MEM_COMMIT) && (AllocationType != MEM_RESET) && (AllocationType != MEM_ADVISE)) {
+        return STATUS_INVALID_PARAMETER_4;
+    }
+
+    // Check the protection field.  The Protect argument of MEM_ADVISE carries the advice instead.
+    if (AllocationType == MEM_ADVISE) {
+        if (Protect > MEM_ADVICE_DONTNEED) {
+            return STATUS_INVALID_PARAMETER_5;
+        }
+        ProtectionMask = MM_NOACCESS;
+    } else {
+        ProtectionMask = MiMakeProtectionMask(Protect);
+        if (ProtectionMask == MM_INVALID_PROTECTION) {
+            return STATUS_INVALID_PAGE_PROTECTION;
+        }
+    }
+
+    if ((NumberOfEntries == 0) || (NumberOfEntries > MM_MAXIMUM_VIRTUAL_MEMORY_RANGES)) {
+        return STATUS_INVALID_PARAMETER_2;
+    }
+
+    CurrentThread = PsGetCurrentThread();
+    CurrentProcess = PsGetCurrentProcessByThread(CurrentThread);
+    PreviousMode = KeGetPreviousModeByThread(&CurrentThread->Tcb);
+
+    if (NumberOfEntries <= MM_VIRTUAL_MEMORY_RANGES_ON_STACK) {
+        CapturedRanges = LocalRanges;
+    } else {
+        CapturedRanges = ExAllocatePoolWithTag(PagedPool, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY), 'rVmM');
+        if (CapturedRanges == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    // Establish an exception handler, probe the specified ranges for write access and capture the initial values.
+    try {
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(Ranges, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY), sizeof(PVOID));
+            if (ARGUMENT_PRESENT(NumberOfEntriesProcessed)) {
+                ProbeForWriteUlong_ptr(NumberOfEntriesProcessed);
+            }
+        }
+
+        RtlCopyMemory(CapturedRanges, Ranges, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY));
+    } except(ExSystemExceptionFilter())
+    {
+        Status = GetExceptionCode();
+        goto FreeRanges;
+    }
+
+    // Make sure all the regions are within the user part of the virtual address space.
+    for (i = 0; i < NumberOfEntries; i += 1) {
+        if ((CapturedRanges[i].VirtualAddress == NULL) ||
+            (CapturedRanges[i].VirtualAddress > MM_HIGHEST_VAD_ADDRESS) ||
+            (CapturedRanges[i].NumberOfBytes == 0) ||
+            ((((ULONG_PTR)MM_HIGHEST_VAD_ADDRESS + 1) - (ULONG_PTR)CapturedRanges[i].VirtualAddress) < CapturedRanges[i].NumberOfBytes)) {
+            Status = STATUS_INVALID_PARAMETER_3;
+            goto FreeRanges;
+        }
+    }
+
+    Attached = FALSE;
+    if (ProcessHandle == NtCurrentProcess()) {
+        Process = CurrentProcess;
+    } else {
+        // Reference the specified process handle for VM_OPERATION access.
+        Status = ObReferenceObjectByHandle(ProcessHandle, PROCESS_VM_OPERATION, PsProcessType, PreviousMode, (PVOID *)&Process, NULL);
+        if (!NT_SUCCESS(Status)) {
+            goto FreeRanges;
+        }
+
+        // If the specified process is not the current process, attach to the specified process.
+        if (CurrentProcess != Process) {
+            KeStackAttachProcess(&Process->Pcb, &ApcState);
+            Attached = TRUE;
+        }
+    }
+
+    RtlZeroMemory(&Charges, sizeof(Charges));
+    ChangeProtection = FALSE;
+    Processed = 0;
+    Status = STATUS_SUCCESS;
+
+    LOCK_ADDRESS_SPACE(Process);
+
+    // Make sure the address space was not deleted, if so, return an error.
+    if (Process->Flags & PS_PROCESS_FLAGS_VM_DELETED) {
+        Status = STATUS_PROCESS_IS_TERMINATING;
+    } else {
+        for (; Processed < NumberOfEntries; Processed += 1) {
+            Status = MiAllocateVirtualMemoryRange(Process, &CapturedRanges[Processed], AllocationType, Protect, ProtectionMask, &ChangeProtection, &Charges);
+            if (!NT_SUCCESS(Status)) {
+                break;
+            }
+        }
+    }
+
+    UNLOCK_ADDRESS_SPACE(Process);
+
+    MiReturnDeferredCharges(Process, &Charges);
+
+    // Recommitted pages with a different protection are reprotected as NtAllocateVirtualMemory does.
+    // The range that needed it is not tracked so all the committed ranges are reprotected.
+    if (ChangeProtection) {
+        for (i = 0; i < Processed; i += 1) {
+            Start = CapturedRanges[i].VirtualAddress;
+            Size = CapturedRanges[i].NumberOfBytes;
+            MiProtectVirtualMemory(Process, &Start, &Size, Protect, &LastProtect);
+        }
+    }
+
+    if ((AllocationType == MEM_ADVISE) && (Protect == MEM_ADVICE_WILLNEED) && (Processed != 0)) {
+        MiPrefetchVirtualMemory(Process, (ULONG)Processed, CapturedRanges, PreviousMode);
+    }
+
+    if (Attached == TRUE) {
+        KeUnstackDetachProcess(&ApcState);
+    }
+
+    if (ProcessHandle != NtCurrentProcess()) {
+        ObDereferenceObject(Process);
+    }
+
+    // Establish an exception handler and write the processed regions.
+    try {
+        RtlCopyMemory(Ranges, CapturedRanges, Processed * sizeof(MEMORY_RANGE_ENTRY));
+        if (ARGUMENT_PRESENT(NumberOfEntriesProcessed)) {
+            *NumberOfEntriesProcessed = Processed;
+        }
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        NOTHING;
+    }
+
+FreeRanges:
+    if (CapturedRanges != LocalRanges) {
+        ExFreePool(CapturedRanges);
+    }
+
+    return Status;
+}
+
+
+NTSTATUS MiAllocateVirtualMemoryRange(IN PEPROCESS Process,
+                                      IN OUT PMEMORY_RANGE_ENTRY Range,
+                                      IN ULONG AllocationType,
+                                      IN ULONG Protect,
+                                      IN MM_PROTECTION_MASK ProtectionMask,
+                                      IN OUT PULONG ChangeProtection,
+                                      IN OUT PMI_DEFERRED_CHARGES Charges
+)
+/*
+Routine Description:
+    This routine commits, resets or advises one region of previously reserved pages for NtAllocateVirtualMemoryRanges.
+    The checks made on the region are the ones NtAllocateVirtualMemory makes.
+Arguments:
+    Process - Supplies the current process.
+    Range - Supplies the captured region and receives the page aligned region the operation applied to.
+    AllocationType - Supplies MEM_COMMIT, MEM_RESET or MEM_ADVISE.
+    Protect - Supplies the protection for MEM_COMMIT or the advice for MEM_ADVISE.
+    ProtectionMask - Supplies the protection mask for Protect.
+    ChangeProtection - Set to TRUE if already committed pages of the region have a different protection.
+    Charges - Supplies the deferred charges to accumulate into.
+Return Value:
+    NTSTATUS.
+Environment:
+    Kernel mode, APCs disabled, AddressCreation mutex held, the address space has not been deleted.
+*/
+{
+    PMMVAD FoundVad;
+    PVOID StartingAddress;
+    PVOID EndingAddress;
+    NTSTATUS Status;
+
+    if ((AllocationType == MEM_RESET) || ((AllocationType == MEM_ADVISE) && (Protect == MEM_ADVICE_DONTNEED))) {
+        // Round up to page boundaries so good data is not reset.
+        EndingAddress = (PVOID)((ULONG_PTR)PAGE_ALIGN((ULONG_PTR)Range->VirtualAddress + Range->NumberOfBytes) - 1);
+        StartingAddress = (PVOID)PAGE_ALIGN((PUCHAR)Range->VirtualAddress + PAGE_SIZE - 1);
+        if (StartingAddress > EndingAddress) {
+            return STATUS_CONFLICTING_ADDRESSES;
+        }
+    } else {
+        EndingAddress = (PVOID)(((ULONG_PTR)Range->VirtualAddress + Range->NumberOfBytes - 1) | (PAGE_SIZE - 1));
+        StartingAddress = (PVOID)PAGE_ALIGN(Range->VirtualAddress);
+    }
+
+    FoundVad = MiCheckForConflictingVad(Process, StartingAddress, EndingAddress);
+    if (FoundVad == NULL) {
+        return STATUS_CONFLICTING_ADDRESSES;// No virtual address is reserved at the specified base address, return an error.
+    }
+
+    if ((FoundVad->u.VadFlags.VadType == VadAwe) ||
+        (FoundVad->u.VadFlags.VadType == VadDevicePhysicalMemory) ||
+        (FoundVad->u.VadFlags.VadType == VadLargePages)) {
+        return STATUS_CONFLICTING_ADDRESSES;
+    }
+
+    // Ensure that the starting and ending addresses are all within the same virtual address descriptor.
+    if ((MI_VA_TO_VPN(StartingAddress) < FoundVad->StartingVpn) || (MI_VA_TO_VPN(EndingAddress) > FoundVad->EndingVpn)) {
+        return STATUS_CONFLICTING_ADDRESSES;
+    }
+
+    if (FoundVad->u.VadFlags.CommitCharge == MM_MAX_COMMIT) {
+        return STATUS_CONFLICTING_ADDRESSES;// This is a special VAD, don't let any commits occur.
+    }
+
+    if (AllocationType == MEM_RESET) {
+        Status = MiResetVirtualMemory(StartingAddress, EndingAddress, FoundVad, Process);
+    } else if (AllocationType == MEM_ADVISE) {
+        Status = MiAdviseVirtualMemory(StartingAddress, EndingAddress, FoundVad, Process, Protect);
+    } else if (FoundVad->u.VadFlags.PrivateMemory == 0) {
+        // Committing a view may extend the file behind it, which releases the address space mutex, so views are not committed here.
+        return STATUS_CONFLICTING_ADDRESSES;
+    } else {
+        Status = MiCommitPrivateVirtualMemory(Process, FoundVad, StartingAddress, EndingAddress, Protect, ProtectionMask, ChangeProtection, Charges);
+    }
+
+    if (NT_SUCCESS(Status)) {
+        Range->VirtualAddress = StartingAddress;
+        Range->NumberOfBytes = (PCHAR)EndingAddress - (PCHAR)StartingAddress + 1;
+    }
+
+    return Status;
+}
+
+
+NTSTATUS MiAdviseVirtualMemory(IN PVOID StartingAddress, IN PVOID EndingAddress, IN PMMVAD Vad, IN PEPROCESS Process, IN ULONG Advice)
+/*
+Routine Description:
+    This routine applies MEM_ADVISE advice to a range of pages.
+    The access pattern advice is recorded in the virtual address descriptor containing the range, where the page fault clustering
+    finds it, so it applies to the whole allocation or view and not just to the given pages.
+    Pages that are not needed are reset as for MEM_RESET.  Pages that will be needed are prefetched by the caller
+    once the address space mutex is released.
+Arguments:
+    StartingAddress - Supplies the starting address of the range.
+    EndingAddress - Supplies the ending address of the range.
+    Vad - Supplies the relevant VAD for the range.
+    Process - Supplies the current process.
+    Advice - Supplies one of the MEM_ADVICE_* values.
+Return Value:
+    NTSTATUS.
+Environment:
+    Kernel mode, APCs disabled, AddressCreation mutex held.
+*/
+{
+    PETHREAD CurrentThread;
+
+    switch (Advice) {
+    case MEM_ADVICE_DONTNEED:
+        return MiResetVirtualMemory(StartingAddress, EndingAddress, Vad, Process);
+    case MEM_ADVICE_WILLNEED:
+        return STATUS_SUCCESS;
+    default:
+        ASSERT(Advice <= MEM_ADVICE_SEQUENTIAL);
+
+        // The fault path reads the hint holding only the working set pushlock.
+        CurrentThread = PsGetCurrentThread();
+        LOCK_WS_UNSAFE(CurrentThread, Process);
+        Vad->u.VadFlags.AccessHint = Advice;
+        UNLOCK_WS_UNSAFE(CurrentThread, Process);
+        return STATUS_SUCCESS;
+    }
+}
+
+
+NTSTATUS MiCommitPrivateVirtualMemory(IN PEPROCESS Process,
+                                      IN PMMVAD FoundVad,
+                                      IN PVOID StartingAddress,
+                                      IN PVOID EndingAddress,
+                                      IN ULONG Protect,
+                                      IN MM_PROTECTION_MASK ProtectionMask,
+                                      IN OUT PULONG ChangeProtection,
+                                      IN OUT PMI_DEFERRED_CHARGES Charges
+)
+/*
+Routine Description:
+    This routine commits a range of previously reserved private pages.
+    Commitment and quota are charged for the entire range and the excess for pages that were already committed
+    is accumulated in the deferred charges, so the caller returns it once after releasing the address space mutex.
+Arguments:
+    Process - Supplies the current process.
+    FoundVad - Supplies the private VAD containing the range.
+    StartingAddress - Supplies the starting address of the range.
+    EndingAddress - Supplies the ending address of the range.
+    Protect - Supplies the protection desired for the committed pages.
+    ProtectionMask - Supplies the protection mask for Protect.
+    ChangeProtection - Set to TRUE if already committed pages of the range have a different protection.
+    Charges - Supplies the deferred charges to accumulate into.
+Return Value:
+    NTSTATUS.
+Environment:
+    Kernel mode, APCs disabled, AddressCreation mutex held.
+*/
+{
+    PMMPTE PointerPte;
+    PMMPTE CommitLimitPte;
+    PMMPTE LastPte;
+    PMMPTE PointerPde;
+    MMPTE TempPte;
+    MMPTE DecommittedPte;
+    SIZE_T QuotaCharge;
+    SIZE_T ExcessCharge;
+    SIZE_T QuotaFree;
+    LOGICAL ChargedExactQuota;
+    LOGICAL ChargedJobCommit;
+    PVOID UsedPageTableHandle;
+    PUCHAR Va;
+    NTSTATUS Status;
+    PETHREAD CurrentThread;
+
+    CurrentThread = PsGetCurrentThread();
+
     // PAGE_WRITECOPY is not valid for private pages.
     if ((Protect & PAGE_WRITECOPY) || (Protect & PAGE_EXECUTE_WRITECOPY)) {
         Status = STATUS_INVALID_PAGE_PROTECTION;
-        goto ErrorReturn0;
+        return Status;
     }
 
     // Build a demand zero PTE with the proper protection.
@@ -992,7 +1517,7 @@ Return Value:
                 PsReportProcessMemoryLimitViolation();
             }
             Status = STATUS_COMMITMENT_LIMIT;
-            goto ErrorReturn0;
+            return Status;
         }
     }
 
@@ -1001,7 +1526,7 @@ Return Value:
     if (Process->JobStatus & PS_JOB_STATUS_REPORT_COMMIT_CHANGES) {
         if (PsChangeJobMemoryUsage(PS_JOB_STATUS_REPORT_COMMIT_CHANGES, QuotaCharge) == FALSE) {
             Status = STATUS_COMMITMENT_LIMIT;
-            goto ErrorReturn0;
+            return Status;
         }
         ChargedJobCommit = TRUE;
     }
@@ -1011,7 +1536,7 @@ Return Value:
         if (ChargedJobCommit == TRUE) {
             PsChangeJobMemoryUsage(PS_JOB_STATUS_REPORT_COMMIT_CHANGES, 0 - QuotaCharge);
         }
-        goto ErrorReturn0;
+        return Status;
     }
 
     ChargedExactQuota = FALSE;
@@ -1044,7 +1569,7 @@ Return Value:
             }
 
             Status = STATUS_COMMITMENT_LIMIT;
-            goto ErrorReturn0;
+            return Status;
         }
     }
 
@@ -1085,7 +1610,7 @@ Return Value:
                 QuotaFree += 1;
 
                 // Make sure the protection for the page is right.
-                if (!ChangeProtection) {
+                if (!*ChangeProtection) {
                     LOGICAL MayHaveReleasedWs;
                     if ((PointerPte->u.Soft.Valid == 0) &&
                         (PointerPte->u.Soft.Prototype == 1) &&
@@ -1098,7 +1623,7 @@ Return Value:
                     }
 
                     if (Protect != MiGetPageProtection(PointerPte)) {
-                        ChangeProtection = TRUE;
+                        *ChangeProtection = TRUE;
                     }
 
                     if (MayHaveReleasedWs == TRUE) {
@@ -1116,73 +1641,23 @@ Return Value:
         ExcessCharge = QuotaFree;
     }
 
+    // The excess is returned by the caller after the address space mutex is released.
     if (ExcessCharge != 0) {
         if (ChargedExactQuota == FALSE) {
             FoundVad->u.VadFlags.CommitCharge -= ExcessCharge;
             ASSERT((LONG_PTR)FoundVad->u.VadFlags.CommitCharge >= 0);
             Process->CommitCharge -= ExcessCharge;
-        }
-
-        UNLOCK_ADDRESS_SPACE(Process);
-
-        if (ChargedExactQuota == FALSE) {
-            MI_INCREMENT_TOTAL_PROCESS_COMMIT(0 - ExcessCharge);
-            MiReturnCommitment(ExcessCharge);
+            Charges->Commitment += ExcessCharge;
             MM_TRACK_COMMIT(MM_DBG_COMMIT_RETURN_ALLOCVM2, ExcessCharge);
         }
 
-        PsReturnProcessPageFileQuota(Process, ExcessCharge);
+        Charges->PageFileQuota += ExcessCharge;
         if (ChargedJobCommit) {
-            PsChangeJobMemoryUsage(PS_JOB_STATUS_REPORT_COMMIT_CHANGES, -(SSIZE_T)ExcessCharge);
+            Charges->JobCommit += ExcessCharge;
         }
-    } else {
-        UNLOCK_ADDRESS_SPACE(Process);
-    }
-
-    // Previously reserved pages have been committed or an error occurred.
-    // Detach, dereference process and return status.
-
-done:
-    if (ChangeProtection) {
-        PVOID Start;
-        SIZE_T Size;
-        ULONG LastProtect;
-
-        Start = StartingAddress;
-        Size = CapturedRegionSize;
-        MiProtectVirtualMemory(Process, &Start, &Size, Protect, &LastProtect);
-    }
-
-    if (Attached == TRUE) {
-        KeUnstackDetachProcess(&ApcState);
-    }
-
-    if (ProcessHandle != NtCurrentProcess()) {
-        ObDereferenceObject(Process);
-    }
-
-    // Establish an exception handler and write the size and base address.
-    try {
-        *RegionSize = CapturedRegionSize;
-        *BaseAddress = StartingAddress;
-    } except(EXCEPTION_EXECUTE_HANDLER)
-    {
-        return GetExceptionCode();
     }
 
-    return Status;
-
-ErrorReturn0:
-    UNLOCK_ADDRESS_SPACE(Process);
-
-ErrorReturn1:
-    if (Attached == TRUE) {
-        KeUnstackDetachProcess(&ApcState);
-    }
-    if (ProcessHandle != NtCurrentProcess()) {
-        ObDereferenceObject(Process);
-    }
-    return Status;
+    return STATUS_SUCCESS;
 }
 
 
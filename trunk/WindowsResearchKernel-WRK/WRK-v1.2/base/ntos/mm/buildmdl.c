@@ -17,6 +17,9 @@ Abstract:
 
     Upon conclusion of the I/O, control is returned to the calling thread.
     All pages are referenced counted as though they were probed and locked, regardless of whether they are currently valid or transition.
+
+    NtPrefetchVirtualMemory and MmPrefetchSectionRanges build on the same path to prefetch ranges of the current process or of a data section
+    without faulting and without blocking the caller. The ranges are read by a delayed worker thread and the pages are left in transition on the standby list.
 */
 
 #include "mi.h"
@@ -48,10 +51,49 @@ NTSTATUS MiCcCompletePrefetchIos(PMI_READ_INFO MiReadInfo);
 VOID MiRemoveUserPages(VOID);
 VOID MiPfFreeDummyPage(IN PMMPFN DummyPagePfn);
 
+// Asynchronous prefetch requests are read in chunks of this size so a single request never holds a large locked MDL.
+#define MI_PREFETCH_CHUNK_SIZE (256 * 1024)
+
+// Prefetching is only a hint so requests beyond these limits are refused rather than queued.
+#define MI_PREFETCH_MAXIMUM_REQUESTS 8
+#define MI_PREFETCH_MAXIMUM_RANGES 256
+
+typedef struct _MI_PREFETCH_RANGE {
+    ULONGLONG Start;
+    SIZE_T Length;
+} MI_PREFETCH_RANGE, *PMI_PREFETCH_RANGE;
+
+// Either Process is set and the ranges are virtual addresses in that process, or Section is set and the ranges are offsets in that data section.
+// Both are referenced until the worker is done with the request.
+typedef struct _MI_PREFETCH_REQUEST {
+    WORK_QUEUE_ITEM WorkItem;
+    PEPROCESS Process;
+    PSECTION Section;
+    ULONG NumberOfRanges;
+    MI_PREFETCH_RANGE Ranges[1];
+} MI_PREFETCH_REQUEST, *PMI_PREFETCH_REQUEST;
+
+LONG MiPrefetchRequests;
+
+PMI_PREFETCH_REQUEST MiAllocatePrefetchRequest(IN ULONG NumberOfRanges, IN KPROCESSOR_MODE PreviousMode);
+VOID MiQueuePrefetchRequest(IN PMI_PREFETCH_REQUEST Request);
+VOID MiPrefetchWorker(IN PVOID Context);
+VOID MiPrefetchFileRange(IN PCONTROL_AREA ControlArea, IN ULONGLONG FileOffset, IN SIZE_T Length);
+VOID MiPrefetchVirtualRange(IN PEPROCESS Process, IN ULONG_PTR StartingAddress, IN SIZE_T Length);
+VOID MiReleasePrefetchMdl(IN PMDL Mdl);
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (PAGE, MmPrefetchPagesIntoLockedMdl)
 #pragma alloc_text (PAGE, MiCcPrepareReadInfo)
 #pragma alloc_text (PAGE, MiCcReleasePrefetchResources)
+#pragma alloc_text (PAGE, NtPrefetchVirtualMemory)
+#pragma alloc_text (PAGE, MiPrefetchVirtualMemory)
+#pragma alloc_text (PAGE, MmPrefetchSectionRanges)
+#pragma alloc_text (PAGE, MiAllocatePrefetchRequest)
+#pragma alloc_text (PAGE, MiQueuePrefetchRequest)
+#pragma alloc_text (PAGE, MiPrefetchWorker)
+#pragma alloc_text (PAGE, MiPrefetchFileRange)
+#pragma alloc_text (PAGE, MiPrefetchVirtualRange)
 #endif
 
 
@@ -852,4 +894,445 @@ Environment:
     MiFreeInPageSupportBlock(InPageSupport);
     MiReadInfo->InPageSupport = NULL;
     return status;
-}
\ No newline at end of file
+}
+
+
+NTSTATUS NtPrefetchVirtualMemory(__in ULONG_PTR NumberOfEntries, __in_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY VirtualAddresses, __in ULONG Flags)
+/*
+Routine Description:
+    This function queues the read of the specified ranges of the current process so that later accesses resolve without waiting for I/O.
+    The call returns as soon as the request is queued. Pages of mapped data files are read in clusters by a worker thread
+    and left in transition, so nothing is added to the working set and no fault is taken.
+    N.B. Ranges that are not views of a data file (private, pagefile-backed or image memory) have no file offset to read from and are skipped.
+Arguments:
+    NumberOfEntries - Supplies the number of entries in the VirtualAddresses array.
+    VirtualAddresses - Supplies the ranges of the current process to prefetch.
+    Flags - Reserved, must be zero.
+Return Value:
+    NTSTATUS.
+    STATUS_INSUFFICIENT_RESOURCES - Too many prefetch requests are outstanding or the request could not be allocated.
+*/
+{
+    PMI_PREFETCH_REQUEST Request;
+    KPROCESSOR_MODE PreviousMode;
+    ULONG_PTR Start;
+    SIZE_T Length;
+    ULONG i;
+
+    PAGED_CODE();
+
+    if (Flags != 0) {
+        return STATUS_INVALID_PARAMETER_3;
+    }
+
+    if ((NumberOfEntries == 0) || (NumberOfEntries > MI_PREFETCH_MAXIMUM_RANGES)) {
+        return STATUS_INVALID_PARAMETER_1;
+    }
+
+    PreviousMode = KeGetPreviousMode();
+    Request = MiAllocatePrefetchRequest((ULONG)NumberOfEntries, PreviousMode);
+    if (Request == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    try {
+        if (PreviousMode != KernelMode) {
+            ProbeForRead(VirtualAddresses, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY), sizeof(PVOID));
+        }
+
+        for (i = 0; i < (ULONG)NumberOfEntries; i += 1) {
+            Request->Ranges[i].Start = (ULONG_PTR)VirtualAddresses[i].VirtualAddress;
+            Request->Ranges[i].Length = VirtualAddresses[i].NumberOfBytes;
+        }
+    }
+    except(ExSystemExceptionFilter())
+    {
+        ExFreePool(Request);
+        MiQueuePrefetchRequest(NULL);
+        return GetExceptionCode();
+    }
+
+    // The ranges must lie entirely in the user portion of the address space.
+    for (i = 0; i < (ULONG)NumberOfEntries; i += 1) {
+        Start = (ULONG_PTR)Request->Ranges[i].Start;
+        Length = Request->Ranges[i].Length;
+        if ((Start > (ULONG_PTR)MM_HIGHEST_USER_ADDRESS) || (Length > (ULONG_PTR)MM_HIGHEST_USER_ADDRESS - Start + 1)) {
+            ExFreePool(Request);
+            MiQueuePrefetchRequest(NULL);
+            return STATUS_INVALID_PARAMETER_2;
+        }
+    }
+
+    Request->Process = PsGetCurrentProcess();
+    ObReferenceObject(Request->Process);
+    MiQueuePrefetchRequest(Request);
+    return STATUS_SUCCESS;
+}
+
+
+VOID MiPrefetchVirtualMemory(IN PEPROCESS Process, IN ULONG NumberOfEntries, IN PMEMORY_RANGE_ENTRY Ranges, IN KPROCESSOR_MODE PreviousMode)
+/*
+Routine Description:
+    This routine queues the read of ranges of a process that were advised with MEM_ADVICE_WILLNEED.
+    The advice is only a hint, so ranges beyond what one request holds are dropped and nothing is queued
+    if too many requests are outstanding.
+Arguments:
+    Process - Supplies the process the ranges belong to.
+    NumberOfEntries - Supplies the number of entries in the Ranges array.
+    Ranges - Supplies the captured and validated ranges of the process.
+    PreviousMode - Supplies the mode the advice came from, user mode requests are charged to the quota of the caller.
+Environment:
+    Kernel mode, PASSIVE_LEVEL, AddressCreation mutex not held.
+*/
+{
+    PMI_PREFETCH_REQUEST Request;
+    ULONG i;
+
+    PAGED_CODE();
+
+    if (NumberOfEntries > MI_PREFETCH_MAXIMUM_RANGES) {
+        NumberOfEntries = MI_PREFETCH_MAXIMUM_RANGES;
+    }
+
+    Request = MiAllocatePrefetchRequest(NumberOfEntries, PreviousMode);
+    if (Request == NULL) {
+        return;
+    }
+
+    for (i = 0; i < NumberOfEntries; i += 1) {
+        Request->Ranges[i].Start = (ULONG_PTR)Ranges[i].VirtualAddress;
+        Request->Ranges[i].Length = Ranges[i].NumberOfBytes;
+    }
+
+    Request->Process = Process;
+    ObReferenceObject(Process);
+    MiQueuePrefetchRequest(Request);
+}
+
+
+NTSTATUS MmPrefetchSectionRanges(__in PVOID SectionObject, __in ULONG NumberOfEntries, __in_ecount(NumberOfEntries) PMM_SECTION_RANGE_ENTRY Ranges)
+/*
+Routine Description:
+    This function queues the read of the specified ranges of a data section so that later accesses to any view of it resolve without waiting for I/O.
+    The call returns as soon as the request is queued and the pages are left in transition when they have been read.
+Arguments:
+    SectionObject - Supplies a referenced pointer to a section backed by a data file.
+    NumberOfEntries - Supplies the number of entries in the Ranges array.
+    Ranges - Supplies the byte offsets and lengths within the section to prefetch.
+Return Value:
+    NTSTATUS.
+    STATUS_INVALID_PARAMETER_1 - The section is not backed by a data file.
+    STATUS_INSUFFICIENT_RESOURCES - Too many prefetch requests are outstanding or the request could not be allocated.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    PCONTROL_AREA ControlArea;
+    PMI_PREFETCH_REQUEST Request;
+    ULONG i;
+
+    PAGED_CODE();
+
+    ControlArea = ((PSECTION)SectionObject)->Segment->ControlArea;
+    if ((ControlArea->u.Flags.Image == 1) || (ControlArea->u.Flags.PhysicalMemory == 1) ||
+        (ControlArea->u.Flags.Rom == 1) || (ControlArea->FilePointer == NULL)) {
+        return STATUS_INVALID_PARAMETER_1;
+    }
+
+    if ((NumberOfEntries == 0) || (NumberOfEntries > MI_PREFETCH_MAXIMUM_RANGES)) {
+        return STATUS_INVALID_PARAMETER_2;
+    }
+
+    Request = MiAllocatePrefetchRequest(NumberOfEntries, KernelMode);
+    if (Request == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    for (i = 0; i < NumberOfEntries; i += 1) {
+        if (Ranges[i].SectionOffset.QuadPart < 0) {
+            ExFreePool(Request);
+            MiQueuePrefetchRequest(NULL);
+            return STATUS_INVALID_PARAMETER_3;
+        }
+
+        Request->Ranges[i].Start = (ULONGLONG)Ranges[i].SectionOffset.QuadPart;
+        Request->Ranges[i].Length = Ranges[i].NumberOfBytes;
+    }
+
+    Request->Section = (PSECTION)SectionObject;
+    ObReferenceObject(SectionObject);
+    MiQueuePrefetchRequest(Request);
+    return STATUS_SUCCESS;
+}
+
+
+PMI_PREFETCH_REQUEST MiAllocatePrefetchRequest(IN ULONG NumberOfRanges, IN KPROCESSOR_MODE PreviousMode)
+/*
+Routine Description:
+    This routine counts a new outstanding prefetch request and allocates it.
+    Requests made from user mode are charged to the current process.
+    N.B. A request that is freed without being queued must be uncounted by calling MiQueuePrefetchRequest with NULL.
+Arguments:
+    NumberOfRanges - Supplies the number of ranges the request will hold.
+    PreviousMode - Supplies the mode of the caller.
+Return Value:
+    The zeroed request, or NULL if too many requests are outstanding or pool or quota is not available.
+*/
+{
+    PMI_PREFETCH_REQUEST Request;
+    SIZE_T Size;
+
+    if (InterlockedIncrement(&MiPrefetchRequests) > MI_PREFETCH_MAXIMUM_REQUESTS) {
+        InterlockedDecrement(&MiPrefetchRequests);
+        return NULL;
+    }
+
+    Size = FIELD_OFFSET(MI_PREFETCH_REQUEST, Ranges) + NumberOfRanges * sizeof(MI_PREFETCH_RANGE);
+    if (PreviousMode != KernelMode) {
+        Request = ExAllocatePoolWithQuotaTag(PagedPool | POOL_QUOTA_FAIL_INSTEAD_OF_RAISE, Size, 'fPmM');
+    } else {
+        Request = ExAllocatePoolWithTag(PagedPool, Size, 'fPmM');
+    }
+
+    if (Request == NULL) {
+        InterlockedDecrement(&MiPrefetchRequests);
+        return NULL;
+    }
+
+    RtlZeroMemory(Request, Size);
+    Request->NumberOfRanges = NumberOfRanges;
+    return Request;
+}
+
+
+VOID MiQueuePrefetchRequest(IN PMI_PREFETCH_REQUEST Request)
+/*
+Routine Description:
+    This routine hands a prefetch request to a delayed worker thread.
+Arguments:
+    Request - Supplies the request to queue, or NULL if the request was freed without being queued.
+*/
+{
+    if (Request == NULL) {
+        InterlockedDecrement(&MiPrefetchRequests);
+        return;
+    }
+
+    ExInitializeWorkItem(&Request->WorkItem, MiPrefetchWorker, (PVOID)Request);
+    ExQueueWorkItem(&Request->WorkItem, DelayedWorkQueue);
+}
+
+
+VOID MiPrefetchWorker(IN PVOID Context)
+/*
+Routine Description:
+    This routine reads the ranges of a prefetch request in the context of a delayed worker thread.
+Arguments:
+    Context - Supplies the prefetch request, which is freed here.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    KAPC_STATE ApcState;
+    PMI_PREFETCH_REQUEST Request;
+    ULONG i;
+
+    PAGED_CODE();
+
+    Request = (PMI_PREFETCH_REQUEST)Context;
+    if (Request->Process != NULL) {
+        KeStackAttachProcess(&Request->Process->Pcb, &ApcState);
+        for (i = 0; i < Request->NumberOfRanges; i += 1) {
+            MiPrefetchVirtualRange(Request->Process, (ULONG_PTR)Request->Ranges[i].Start, Request->Ranges[i].Length);
+        }
+
+        KeUnstackDetachProcess(&ApcState);
+        ObDereferenceObject(Request->Process);
+    } else {
+        for (i = 0; i < Request->NumberOfRanges; i += 1) {
+            MiPrefetchFileRange(Request->Section->Segment->ControlArea, Request->Ranges[i].Start, Request->Ranges[i].Length);
+        }
+
+        ObDereferenceObject(Request->Section);
+    }
+
+    ExFreePool(Request);
+    InterlockedDecrement(&MiPrefetchRequests);
+}
+
+
+VOID MiPrefetchFileRange(IN PCONTROL_AREA ControlArea, IN ULONGLONG FileOffset, IN SIZE_T Length)
+/*
+Routine Description:
+    This routine reads a range of a data file into transition pages, one chunk at a time.
+    The range is clipped to the end of the segment and the read stops early if memory becomes scarce or an error occurs.
+Arguments:
+    ControlArea - Supplies the referenced control area of the data file.
+    FileOffset - Supplies the byte offset in the file of the start of the range.
+    Length - Supplies the length of the range in bytes.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    ULONGLONG EndOffset;
+    ULONGLONG SegmentSize;
+    LARGE_INTEGER ChunkOffset;
+    SIZE_T ChunkSize;
+    PMDL Mdl;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    if (Length == 0) {
+        return;
+    }
+
+    // The prefetch path walks the subsections of the segment so the range must not extend beyond them.
+    SegmentSize = (ULONGLONG)ControlArea->Segment->TotalNumberOfPtes << PAGE_SHIFT;
+    EndOffset = FileOffset + Length;
+    if (EndOffset < FileOffset) {
+        EndOffset = SegmentSize;
+    }
+
+    FileOffset &= ~((ULONGLONG)PAGE_SIZE - 1);
+    if (EndOffset > SegmentSize) {
+        EndOffset = SegmentSize;
+    }
+
+    while (FileOffset < EndOffset) {
+        ChunkSize = MI_PREFETCH_CHUNK_SIZE;
+        if (EndOffset - FileOffset < ChunkSize) {
+            ChunkSize = (SIZE_T)(EndOffset - FileOffset);
+        }
+
+        // Don't push out pages that are in use to satisfy a hint.
+        if (!MmIsMemoryAvailable(BYTES_TO_PAGES(ChunkSize))) {
+            return;
+        }
+
+        ChunkOffset.QuadPart = (LONGLONG)FileOffset;
+        Status = MmPrefetchPagesIntoLockedMdl(ControlArea->FilePointer, &ChunkOffset, ChunkSize, &Mdl);
+        if (!NT_SUCCESS(Status)) {
+            return;
+        }
+
+        MiReleasePrefetchMdl(Mdl);
+        FileOffset += ROUND_TO_PAGES(ChunkSize);
+    }
+}
+
+
+VOID MiPrefetchVirtualRange(IN PEPROCESS Process, IN ULONG_PTR StartingAddress, IN SIZE_T Length)
+/*
+Routine Description:
+    This routine reads the pages of the mapped data file views in a range of the current process into transition pages.
+    Each view is translated into a file range under the address space lock and the control area is referenced so that the lock need not be held across the I/O.
+Arguments:
+    Process - Supplies the current process.
+    StartingAddress - Supplies the starting address of the range.
+    Length - Supplies the length of the range in bytes.
+Environment:
+    Kernel mode, PASSIVE_LEVEL, attached to the process.
+*/
+{
+    PCONTROL_AREA ControlArea;
+    PVOID EndingAddress;
+    PVOID LastAddress;
+    ULONGLONG FileOffset;
+    KIRQL OldIrql;
+    PSUBSECTION Subsection;
+    PVOID Va;
+    PMMVAD Vad;
+
+    PAGED_CODE();
+
+    if (Length == 0) {
+        return;
+    }
+
+    Va = PAGE_ALIGN(StartingAddress);
+    EndingAddress = (PVOID)((StartingAddress + Length - 1) | (PAGE_SIZE - 1));
+    while (TRUE) {
+        LOCK_ADDRESS_SPACE(Process);
+        if (Process->Flags & PS_PROCESS_FLAGS_VM_DELETED) {
+            UNLOCK_ADDRESS_SPACE(Process);
+            return;
+        }
+
+        Vad = MiLocateAddress(Va);
+        if (Vad == NULL) {
+            UNLOCK_ADDRESS_SPACE(Process);
+            return;
+        }
+
+        LastAddress = MI_VPN_TO_VA_ENDING(Vad->EndingVpn);
+        if (LastAddress > EndingAddress) {
+            LastAddress = EndingAddress;
+        }
+
+        ControlArea = NULL;
+        FileOffset = 0;
+        if ((Vad->u.VadFlags.PrivateMemory == 0) && (Vad->u.VadFlags.VadType == VadNone) && (Vad->ControlArea != NULL) &&
+            (Vad->ControlArea->u.Flags.Image == 0) && (Vad->ControlArea->u.Flags.PhysicalMemory == 0) &&
+            (Vad->ControlArea->u.Flags.Rom == 0) && (Vad->ControlArea->FilePointer != NULL)) {
+            Subsection = MiLocateSubsection(Vad, MI_VA_TO_VPN(Va));
+            if (Subsection != NULL) {
+                // The view is contiguous in the file so the offset of its first page gives the whole file range.
+                FileOffset = (ULONGLONG)MiStartingOffset(Subsection, MiGetProtoPteAddress(Vad, MI_VA_TO_VPN(Va)));
+
+                LOCK_PFN(OldIrql);
+                if (!(Vad->ControlArea->u.Flags.BeingCreated || Vad->ControlArea->u.Flags.BeingDeleted)) {
+                    ControlArea = Vad->ControlArea;
+                    ControlArea->NumberOfSectionReferences += 1;
+                }
+                UNLOCK_PFN(OldIrql);
+            }
+        }
+
+        UNLOCK_ADDRESS_SPACE(Process);
+
+        if (ControlArea != NULL) {
+            MiPrefetchFileRange(ControlArea, FileOffset, (PCHAR)LastAddress - (PCHAR)Va + 1);
+            MiDereferenceControlAreaBySection(ControlArea, 0);
+        }
+
+        if (LastAddress == EndingAddress) {
+            return;
+        }
+
+        Va = (PVOID)((PCHAR)LastAddress + 1);
+    }
+}
+
+
+VOID MiReleasePrefetchMdl(IN PMDL Mdl)
+/*
+Routine Description:
+    This routine releases the pages of an MDL returned by MmPrefetchPagesIntoLockedMdl and frees the MDL.
+    Pages that are not otherwise in use go to the standby list in transition.
+    N.B. The pages were locked without a process so MmUnlockPages can't be used.
+Arguments:
+    Mdl - Supplies the MDL to release.
+Environment:
+    Kernel mode, IRQL <= DISPATCH_LEVEL.
+*/
+{
+    PPFN_NUMBER Page;
+    PFN_NUMBER NumberOfPages;
+    KIRQL OldIrql;
+    PMMPFN Pfn1;
+
+    Page = (PPFN_NUMBER)(Mdl + 1);
+    NumberOfPages = Mdl->ByteCount >> PAGE_SHIFT;
+
+    LOCK_PFN(OldIrql);
+    while (NumberOfPages != 0) {
+        Pfn1 = MI_PFN_ELEMENT(*Page);
+        MI_REMOVE_LOCKED_PAGE_CHARGE_AND_DECREF(Pfn1);
+        Page += 1;
+        NumberOfPages -= 1;
+    }
+    UNLOCK_PFN(OldIrql);
+
+    ExFreePool(Mdl);
+}
@@ -0,0 +1,370 @@
+/*
+Copyright (c) Microsoft Corporation. All rights reserved.
+
+You may only use this code if you agree to the terms of the Windows Research Kernel Source Code License agreement (see License.txt).
+If you do not agree to the terms, do not use the code.
+
+Module Name:
+    compress.c
+
+Abstract:
+    This module contains the compressed store for memory management.
+    The modified page writer keeps clusters bound for a paging file compressed in nonpaged pool instead of writing them,
+    and the page fault handler decompresses them instead of reading the paging file.
+
+    A stored page is found by the paging file number and offset that its PTE refers to.
+    The paging file space is allocated and released exactly as if the page had been written,
+    so the PTEs, the PFN database and the paging file bitmaps need not know whether a page is in the store or in the paging file.
+    A cluster that cannot be stored in full is written to the paging file as usual.
+
+    N.B. The paging file does not hold the contents of a stored page,
+         so a stored page must never be read from the paging file, not even as part of a read cluster.
+
+    An entry only leaves the store when the paging file space it stands for is released.
+    Since that space cannot be released while a read of it is in progress, the reader uses an entry without holding the store lock.
+*/
+
+#include "mi.h"
+
+typedef struct _MI_COMPRESSED_PAGE {
+    struct _MI_COMPRESSED_PAGE* Next;
+    ULONG PageFileNumber;
+    ULONG PageFileOffset;
+    ULONG Size;                 // Zero if the page was all zeroes
+    UCHAR Data[1];
+} MI_COMPRESSED_PAGE, *PMI_COMPRESSED_PAGE;
+
+#define MI_COMPRESSION_FORMAT (COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD)
+
+// A page that does not compress to half its size is written to the paging file as storing it saves too little memory.
+#define MI_COMPRESSED_PAGE_MAXIMUM (PAGE_SIZE / 2)
+
+#define MI_COMPRESSED_STORE_MINIMUM_BUCKETS 256
+#define MI_COMPRESSED_STORE_MAXIMUM_BUCKETS (64 * 1024)
+
+// Consecutive offsets of a paging file, which is what a cluster holds, go to consecutive buckets.
+#define MI_COMPRESSED_STORE_HASH(PageFileNumber, PageFileOffset) ((((PageFileOffset) * MAX_PAGE_FILES) + (PageFileNumber)) & MiCompressedStoreMask)
+
+// The most pages of nonpaged pool the store may hold.
+// Zero selects a default of an eighth of physical memory, held to a quarter of nonpaged pool.
+PFN_NUMBER MmCompressedStorePages;
+
+PMI_COMPRESSED_PAGE* MiCompressedStoreBuckets;
+ULONG MiCompressedStoreMask;
+KSPIN_LOCK MiCompressedStoreLock;
+ULONG MiCompressionWorkSpaceSize;
+
+SIZE_T MiCompressedStoreLimit;
+SIZE_T MiCompressedStoreBytes;
+ULONG MiCompressedStoreEntries;
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(INIT,MiInitializeCompressedStore)
+#pragma alloc_text(PAGE,MiStoreCompressedPages)
+#endif
+
+
+VOID MiInitializeCompressedStore(VOID)
+/*
+Routine Description:
+    This routine sizes the compressed store and allocates its hash table.
+    If the table cannot be allocated the store stays disabled and all modified pages are written to the paging files.
+Environment:
+    Kernel mode, phase 1 initialization.
+*/
+{
+    ULONG CompressFragmentWorkSpaceSize;
+    SIZE_T Limit;
+    ULONG Buckets;
+
+    KeInitializeSpinLock(&MiCompressedStoreLock);
+    if (!NT_SUCCESS(RtlGetCompressionWorkSpaceSize(MI_COMPRESSION_FORMAT, &MiCompressionWorkSpaceSize, &CompressFragmentWorkSpaceSize))) {
+        return;
+    }
+
+    if (MmCompressedStorePages != 0) {
+        Limit = MmCompressedStorePages << PAGE_SHIFT;
+    } else {
+        Limit = (MmNumberOfPhysicalPages / 8) << PAGE_SHIFT;
+        if (Limit > MmMaximumNonPagedPoolInBytes / 4) {
+            Limit = MmMaximumNonPagedPoolInBytes / 4;
+        }
+    }
+
+    // Size the table for entries of about a quarter of a page each.
+    Buckets = MI_COMPRESSED_STORE_MINIMUM_BUCKETS;
+    while ((Buckets < MI_COMPRESSED_STORE_MAXIMUM_BUCKETS) && (((SIZE_T)Buckets << (PAGE_SHIFT - 2)) < Limit)) {
+        Buckets <<= 1;
+    }
+
+    MiCompressedStoreBuckets = ExAllocatePoolWithTag(NonPagedPool, Buckets * sizeof(PMI_COMPRESSED_PAGE), 'hCmM');
+    if (MiCompressedStoreBuckets == NULL) {
+        return;
+    }
+
+    RtlZeroMemory(MiCompressedStoreBuckets, Buckets * sizeof(PMI_COMPRESSED_PAGE));
+    MiCompressedStoreMask = Buckets - 1;
+    MiCompressedStoreLimit = Limit;
+}
+
+
+FORCEINLINE PMI_COMPRESSED_PAGE MiLookupCompressedPage(IN ULONG PageFileNumber, IN ULONG PageFileOffset)
+/*
+Routine Description:
+    This routine finds the store entry for the specified paging file offset.
+Environment:
+    Kernel mode, compressed store lock held.
+*/
+{
+    PMI_COMPRESSED_PAGE Entry;
+
+    Entry = MiCompressedStoreBuckets[MI_COMPRESSED_STORE_HASH(PageFileNumber, PageFileOffset)];
+    while (Entry != NULL) {
+        if ((Entry->PageFileOffset == PageFileOffset) && (Entry->PageFileNumber == PageFileNumber)) {
+            break;
+        }
+
+        Entry = Entry->Next;
+    }
+
+    return Entry;
+}
+
+
+LOGICAL MiStoreCompressedPages(IN PMDL Mdl, IN ULONG PageFileNumber, IN ULONG PageFileOffset)
+/*
+Routine Description:
+    This routine compresses a cluster of pages that is about to be written to a paging file and keeps it in the compressed store.
+    Either all the pages are stored or none are.
+Arguments:
+    Mdl - Supplies the MDL of the cluster write. It may be left mapped, the write completion unmaps it.
+    PageFileNumber - Supplies the paging file the cluster was allocated in.
+    PageFileOffset - Supplies the paging file offset of the first page of the cluster.
+Return Value:
+    TRUE if the cluster was stored and need not be written, FALSE if it must be written to the paging file.
+Environment:
+    Kernel mode, PASSIVE_LEVEL. The pages are write-in-progress so their contents cannot change.
+*/
+{
+    PUCHAR WorkSpace;
+    PUCHAR Buffer;
+    PUCHAR Va;
+    PFN_NUMBER NumberOfPages;
+    PMI_COMPRESSED_PAGE Chain;
+    PMI_COMPRESSED_PAGE Entry;
+    PMI_COMPRESSED_PAGE* Bucket;
+    SIZE_T Bytes;
+    ULONG Size;
+    PFN_NUMBER i;
+    NTSTATUS Status;
+    KLOCK_QUEUE_HANDLE LockHandle;
+
+    PAGED_CODE();
+
+    if ((MiCompressedStoreBuckets == NULL) || (MiCompressedStoreBytes >= MiCompressedStoreLimit)) {
+        return FALSE;
+    }
+
+    Va = MmGetSystemAddressForMdlSafe(Mdl, HighPagePriority);
+    if (Va == NULL) {
+        return FALSE;
+    }
+
+    WorkSpace = ExAllocatePoolWithTag(PagedPool, MiCompressionWorkSpaceSize + MI_COMPRESSED_PAGE_MAXIMUM, 'wCmM');
+    if (WorkSpace == NULL) {
+        return FALSE;
+    }
+
+    Buffer = WorkSpace + MiCompressionWorkSpaceSize;
+    NumberOfPages = Mdl->ByteCount >> PAGE_SHIFT;
+    Chain = NULL;
+    Bytes = 0;
+    for (i = 0; i < NumberOfPages; i += 1, Va += PAGE_SIZE) {
+        Status = RtlCompressBuffer(MI_COMPRESSION_FORMAT, Va, PAGE_SIZE, Buffer, MI_COMPRESSED_PAGE_MAXIMUM, PAGE_SIZE, &Size, WorkSpace);
+        if (Status == STATUS_BUFFER_ALL_ZEROS) {
+            Size = 0;
+        } else if (Status != STATUS_SUCCESS) {
+            break;
+        }
+
+        Entry = ExAllocatePoolWithTag(NonPagedPool, FIELD_OFFSET(MI_COMPRESSED_PAGE, Data) + Size, 'pCmM');
+        if (Entry == NULL) {
+            break;
+        }
+
+        Entry->PageFileNumber = PageFileNumber;
+        Entry->PageFileOffset = PageFileOffset + (ULONG)i;
+        Entry->Size = Size;
+        RtlCopyMemory(Entry->Data, Buffer, Size);
+        Entry->Next = Chain;
+        Chain = Entry;
+        Bytes += FIELD_OFFSET(MI_COMPRESSED_PAGE, Data) + Size;
+    }
+
+    ExFreePool(WorkSpace);
+
+    if (i == NumberOfPages) {
+        KeAcquireInStackQueuedSpinLock(&MiCompressedStoreLock, &LockHandle);
+        if (MiCompressedStoreBytes + Bytes <= MiCompressedStoreLimit) {
+            while (Chain != NULL) {
+                Entry = Chain;
+                Chain = Chain->Next;
+                ASSERT(MiLookupCompressedPage(Entry->PageFileNumber, Entry->PageFileOffset) == NULL);
+                Bucket = &MiCompressedStoreBuckets[MI_COMPRESSED_STORE_HASH(Entry->PageFileNumber, Entry->PageFileOffset)];
+                Entry->Next = *Bucket;
+                *Bucket = Entry;
+            }
+
+            MiCompressedStoreBytes += Bytes;
+            MiCompressedStoreEntries += (ULONG)NumberOfPages;
+        }
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
+    }
+
+    // Anything left on the chain could not be stored, so the whole cluster goes to the paging file.
+    if (Chain != NULL) {
+        do {
+            Entry = Chain;
+            Chain = Chain->Next;
+            ExFreePool(Entry);
+        } while (Chain != NULL);
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+LOGICAL MiIsPageCompressed(IN ULONG PageFileNumber, IN ULONG PageFileOffset)
+/*
+Routine Description:
+    This routine determines whether the contents of the specified paging file offset are in the compressed store.
+Arguments:
+    PageFileNumber - Supplies the paging file number.
+    PageFileOffset - Supplies the offset within the paging file.
+Return Value:
+    TRUE if the page is stored, in which case it must not be read from the paging file.
+Environment:
+    Kernel mode, PFN lock held.
+*/
+{
+    PMI_COMPRESSED_PAGE Entry;
+    KLOCK_QUEUE_HANDLE LockHandle;
+
+    MM_PFN_LOCK_ASSERT();
+
+    // Entries are inserted before the write of their pages completes, which is under the PFN lock,
+    // so an empty store seen here cannot hold the entry for a page that has been written.
+    if (MiCompressedStoreEntries == 0) {
+        return FALSE;
+    }
+
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&MiCompressedStoreLock, &LockHandle);
+    Entry = MiLookupCompressedPage(PageFileNumber, PageFileOffset);
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+    return (LOGICAL)(Entry != NULL);
+}
+
+
+NTSTATUS MiReadCompressedPage(IN PMDL Mdl, IN ULONG PageFileNumber, IN ULONG PageFileOffset, OUT PIO_STATUS_BLOCK IoStatus)
+/*
+Routine Description:
+    This routine fills a page being read in from the specified paging file offset from the compressed store.
+Arguments:
+    Mdl - Supplies the single page MDL of the read.
+    PageFileNumber - Supplies the paging file number.
+    PageFileOffset - Supplies the offset within the paging file.
+    IoStatus - Receives the status of the read as if it had been done from the paging file.
+Return Value:
+    STATUS_NOT_FOUND if the page is not stored and must be read from the paging file, otherwise the status of the read.
+Environment:
+    Kernel mode, APC_LEVEL or below, no working set lock held.
+    The read of the paging file offset is in progress so its space cannot be released.
+*/
+{
+    PMI_COMPRESSED_PAGE Entry;
+    PVOID Va;
+    ULONG Size;
+    NTSTATUS Status;
+    KLOCK_QUEUE_HANDLE LockHandle;
+
+    if (MiCompressedStoreEntries == 0) {
+        return STATUS_NOT_FOUND;
+    }
+
+    KeAcquireInStackQueuedSpinLock(&MiCompressedStoreLock, &LockHandle);
+    Entry = MiLookupCompressedPage(PageFileNumber, PageFileOffset);
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+    if (Entry == NULL) {
+        return STATUS_NOT_FOUND;
+    }
+
+    ASSERT(Mdl->ByteCount == PAGE_SIZE);
+    Va = MmGetSystemAddressForMdlSafe(Mdl, HighPagePriority);
+    if (Va == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+    } else {
+        if (Entry->Size == 0) {
+            KeZeroPages(Va, PAGE_SIZE);
+            Status = STATUS_SUCCESS;
+            Size = PAGE_SIZE;
+        } else {
+            Status = RtlDecompressBuffer(COMPRESSION_FORMAT_LZNT1, Va, PAGE_SIZE, Entry->Data, Entry->Size, &Size);
+        }
+
+        MmUnmapLockedPages(Va, Mdl);
+    }
+
+    // A page that does not come back whole is reported like a failed paging file read.
+    // Insufficient resources is retried by the caller like any paging read that fails for lack of resources.
+    if ((NT_SUCCESS(Status)) && (Size != PAGE_SIZE)) {
+        Status = STATUS_DATA_ERROR;
+    }
+
+    IoStatus->Status = Status;
+    IoStatus->Information = NT_SUCCESS(Status) ? PAGE_SIZE : 0;
+    return Status;
+}
+
+
+VOID MiRemoveCompressedPage(IN ULONG PageFileNumber, IN ULONG PageFileOffset)
+/*
+Routine Description:
+    This routine discards the store entry for the specified paging file offset, if there is one, as its paging file space is being released.
+Arguments:
+    PageFileNumber - Supplies the paging file number.
+    PageFileOffset - Supplies the offset within the paging file.
+Environment:
+    Kernel mode, PFN lock held.
+*/
+{
+    PMI_COMPRESSED_PAGE Entry;
+    PMI_COMPRESSED_PAGE* Link;
+    KLOCK_QUEUE_HANDLE LockHandle;
+
+    MM_PFN_LOCK_ASSERT();
+
+    if (MiCompressedStoreEntries == 0) {
+        return;
+    }
+
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&MiCompressedStoreLock, &LockHandle);
+    Link = &MiCompressedStoreBuckets[MI_COMPRESSED_STORE_HASH(PageFileNumber, PageFileOffset)];
+    while ((Entry = *Link) != NULL) {
+        if ((Entry->PageFileOffset == PageFileOffset) && (Entry->PageFileNumber == PageFileNumber)) {
+            *Link = Entry->Next;
+            MiCompressedStoreBytes -= FIELD_OFFSET(MI_COMPRESSED_PAGE, Data) + Entry->Size;
+            MiCompressedStoreEntries -= 1;
+            break;
+        }
+
+        Link = &Entry->Next;
+    }
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+    if (Entry != NULL) {
+        ExFreePool(Entry);
+    }
+}
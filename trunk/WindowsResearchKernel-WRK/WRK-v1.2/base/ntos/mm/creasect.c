@@ -1343,7 +1343,7 @@ Arguments:
     RtlZeroMemory(ControlArea, sizeof(CONTROL_AREA) + sizeof(SUBSECTION));
     ASSERT(ControlArea->u.Flags.GlobalOnlyPerSession == 0);
     Subsection = (PSUBSECTION)(ControlArea + 1);
-    SizeOfSegment = sizeof(SEGMENT) + (sizeof(MMPTE) * ((ULONG)NumberOfPtes - 1)) + sizeof(SECTION_IMAGE_INFORMATION);
+    SizeOfSegment = sizeof(SEGMENT) + (sizeof(MMPTE) * ((ULONG)NumberOfPtes - 1)) + sizeof(SECTION_IMAGE_INFORMATION) + sizeof(MI_IMAGE_PEB_INFORMATION);
     NewSegment = ExAllocatePoolWithTag(PagedPool | POOL_MM_ALLOCATION, SizeOfSegment, MMSECT);
     if (NewSegment == NULL) {
         // The requested pool could not be allocated.
@@ -1362,7 +1362,7 @@ Arguments:
     NewSegment->TotalNumberOfPtes = (ULONG)NumberOfPtes;
     NewSegment->NonExtendedPtes = (ULONG)NumberOfPtes;
     NewSegment->SizeOfSegment = NumberOfPtes * PAGE_SIZE;
-    RtlZeroMemory(NewSegment->u2.ImageInformation, sizeof(SECTION_IMAGE_INFORMATION));
+    RtlZeroMemory(NewSegment->u2.ImageInformation, sizeof(SECTION_IMAGE_INFORMATION) + sizeof(MI_IMAGE_PEB_INFORMATION));
     NewSegment->u2.ImageInformation->ImageFileSize = EndOfFile.LowPart;
 
 #if DBG
@@ -1787,7 +1787,7 @@ Arguments:
         // Check that the new number of PTEs of PTEs cannot cause the segment prototype PTE allocation size to wrap.
         // Since originally the number of PTEs came from the ULONG SizeOfImage in the OptionalHeader, we know it was ok then.
         // But adding various subsection counts above may have pushed it over the limit.
-        if (((MAXULONG_PTR - (sizeof(SEGMENT) + sizeof(SECTION_IMAGE_INFORMATION))) / sizeof(MMPTE)) < OrigNumberOfPtes + AdditionalBasePtes + AdditionalPtes - 1) {
+        if (((MAXULONG_PTR - (sizeof(SEGMENT) + sizeof(SECTION_IMAGE_INFORMATION) + sizeof(MI_IMAGE_PEB_INFORMATION))) / sizeof(MMPTE)) < OrigNumberOfPtes + AdditionalBasePtes + AdditionalPtes - 1) {
             MI_BAD_IMAGE(0x33);
             Status = STATUS_INSUFFICIENT_RESOURCES;
             goto BadPeImageSegment;
@@ -1814,7 +1814,7 @@ Arguments:
         OldSegment = NewSegment;
         OrigNumberOfPtes += AdditionalBasePtes;
         PointerPte += AdditionalBasePtes;
-        SizeOfSegment = sizeof(SEGMENT) + (sizeof(MMPTE) * (OrigNumberOfPtes + AdditionalPtes - 1)) + sizeof(SECTION_IMAGE_INFORMATION);
+        SizeOfSegment = sizeof(SEGMENT) + (sizeof(MMPTE) * (OrigNumberOfPtes + AdditionalPtes - 1)) + sizeof(SECTION_IMAGE_INFORMATION) + sizeof(MI_IMAGE_PEB_INFORMATION);
         NewSegment = ExAllocatePoolWithTag(PagedPool | POOL_MM_ALLOCATION, SizeOfSegment, MMSECT);
         if (NewSegment == NULL) {
             // The requested pool could not be allocated.
@@ -1841,7 +1841,7 @@ Arguments:
         NewSegment->TotalNumberOfPtes = (ULONG)(OrigNumberOfPtes + AdditionalPtes);
         NewSegment->NonExtendedPtes = (ULONG)(OrigNumberOfPtes + AdditionalPtes);
         NewSegment->SizeOfSegment = (UINT64)(OrigNumberOfPtes + AdditionalPtes) * PAGE_SIZE;
-        RtlCopyMemory(NewSegment->u2.ImageInformation, OldSegment->u2.ImageInformation, sizeof(SECTION_IMAGE_INFORMATION));
+        RtlCopyMemory(NewSegment->u2.ImageInformation, OldSegment->u2.ImageInformation, sizeof(SECTION_IMAGE_INFORMATION) + sizeof(MI_IMAGE_PEB_INFORMATION));
 
         // Adjust the prototype PTE pointer of the PE header page to point at the new segment.
         ASSERT(Pfn1->u2.Blink == (PFN_NUMBER)OldSegment->PrototypePte);
@@ -145,7 +145,7 @@ Environment:
     PSUBSECTION Subsection;
     PVOID UsedPageTableHandle;
     KIRQL OldIrql;
-    MMPTE_FLUSH_LIST FlushList;
+    MI_FLUSH_GATHER FlushGather;
     ULONG Waited;
     LOGICAL Skipped;
     LOGICAL AddressSpaceDeletion;
@@ -160,7 +160,8 @@ Environment:
     PVOID TempHandle;
 #endif
 
-    FlushList.Count = 0;
+    // The TB flush for the whole range is gathered and done once at the end, or earlier if the held pages are needed.
+    MiInitializeFlushGather(&FlushGather, (EndingAddress - Va) >> PAGE_SHIFT);
 
     CurrentProcess = PsGetCurrentProcess();
 
@@ -204,7 +205,7 @@ Environment:
                    PointerPte = MiGetVirtualAddressMappedByPte(PointerPde);
                    Va = MiGetVirtualAddressMappedByPte(PointerPte);
                    if (Va > EndingAddress) {
-                       return;// All done, return.
+                       goto AllDone;
                    }
                }
 
@@ -216,7 +217,7 @@ Environment:
                    PointerPte = MiGetVirtualAddressMappedByPte(PointerPde);
                    Va = MiGetVirtualAddressMappedByPte(PointerPte);
                    if (Va > EndingAddress) {
-                       return;// All done, return.
+                       goto AllDone;
                    }
 
 #if (_MI_PAGING_LEVELS >= 4)
@@ -241,7 +242,7 @@ Environment:
                    PointerPte = MiGetVirtualAddressMappedByPte(PointerPde);
                    Va = MiGetVirtualAddressMappedByPte(PointerPte);
                    if (Va > EndingAddress) {
-                       return;// All done, return.
+                       goto AllDone;
                    }
 
 #if (_MI_PAGING_LEVELS >= 3)
@@ -404,7 +405,7 @@ Environment:
                                    LOCK_PFN(OldIrql);
                                }
 
-                               Waited = MiDeletePte(PointerPte, (PVOID)Va, AddressSpaceDeletion, CurrentProcess, ProtoPte, &FlushList, OldIrql);
+                               Waited = MiDeletePte(PointerPte, (PVOID)Va, AddressSpaceDeletion, CurrentProcess, ProtoPte, &FlushGather, OldIrql);
 
 #if (_MI_PAGING_LEVELS >= 3)
                                // This must be recalculated here if MiDeletePte dropped the PFN lock (this can happen when dealing with POSIX forked pages).
@@ -426,15 +427,14 @@ Environment:
 
                    if (InvalidPtes == 16) {
                        if (PfnHeld == TRUE) {
-                           if (FlushList.Count != 0) {
-                               MiFlushPteList(&FlushList);
+                           // The held pages are only given back early if the system is running low on pages.
+                           if (MmAvailablePages < MM_HIGH_LIMIT) {
+                               MiFlushGather(&FlushGather);
                            }
 
                            ASSERT(OldIrql != MM_NOIRQL);
                            UNLOCK_PFN(OldIrql);
                            PfnHeld = FALSE;
-                       } else {
-                           ASSERT(FlushList.Count == 0);
                        }
 
                        InvalidPtes = 0;
@@ -452,18 +452,9 @@ Environment:
 
                // The virtual address is on a page directory boundary:
 
-               // 1. Flush the PTEs for the previous page table page.
-               // 2. Delete the previous page directory & page table if appropriate.
-               // 3. Attempt to leap forward skipping over empty page directories and page tables where possible.
-
-               // If all the entries have been eliminated from the previous page table page, delete the page table page itself.
-               if (PfnHeld == TRUE) {
-                   if (FlushList.Count != 0) {
-                       MiFlushPteList(&FlushList);
-                   }
-               } else {
-                   ASSERT(FlushList.Count == 0);
-               }
+               // 1. Delete the previous page directory & page table if appropriate.
+               //    The page table pages are held by the flush gather like the pages they mapped.
+               // 2. Attempt to leap forward skipping over empty page directories and page tables where possible.
 
                // If all the entries have been eliminated from the previous page table page, delete the page table page itself.
                ASSERT64(PointerPpe->u.Hard.Valid == 1);
@@ -485,7 +476,7 @@ Environment:
 #endif
 
                    TempVa = MiGetVirtualAddressMappedByPte(PointerPde);
-                   MiDeletePte(PointerPde, TempVa, FALSE, CurrentProcess, NULL, NULL, OldIrql);
+                   MiDeletePte(PointerPde, TempVa, FALSE, CurrentProcess, NULL, &FlushGather, OldIrql);
 
 #if (_MI_PAGING_LEVELS >= 3)
                    if ((MI_GET_USED_PTES_FROM_HANDLE(UsedPageDirectoryHandle) == 0) && (PointerPpe->u.Long != 0)) {
@@ -495,12 +486,12 @@ Environment:
 #endif
 
                        TempVa = MiGetVirtualAddressMappedByPte(PointerPpe);
-                       MiDeletePte(PointerPpe, TempVa, FALSE, CurrentProcess, NULL, NULL, OldIrql);
+                       MiDeletePte(PointerPpe, TempVa, FALSE, CurrentProcess, NULL, &FlushGather, OldIrql);
 
 #if (_MI_PAGING_LEVELS >= 4)
                        if ((MI_GET_USED_PTES_FROM_HANDLE(UsedPageDirectoryHandle) == 0) && (PointerPxe->u.Long != 0)) {
                            TempVa = MiGetVirtualAddressMappedByPte(PointerPxe);
-                           MiDeletePte(PointerPxe, TempVa, FALSE, CurrentProcess, NULL, NULL, OldIrql);
+                           MiDeletePte(PointerPxe, TempVa, FALSE, CurrentProcess, NULL, &FlushGather, OldIrql);
                        }
 #endif
                    }
@@ -517,7 +508,7 @@ Environment:
                }
 
                if (Va > EndingAddress) {
-                   return;// All done, return.
+                   goto AllDone;
                }
 
                PointerPde = MiGetPdeAddress(Va);
@@ -526,10 +517,130 @@ Environment:
 
                Skipped = FALSE;
     } while (TRUE);
+
+AllDone:
+
+    // Flush the TB for everything deleted and give back the held pages.
+    if ((FlushGather.FlushList.Count != 0) || (FlushGather.Count != 0)) {
+        LOCK_PFN(OldIrql);
+        MiFlushGather(&FlushGather);
+        UNLOCK_PFN(OldIrql);
+    }
+
+    MiFreeFlushGather(&FlushGather);
+}
+
+
+VOID MiInitializeFlushGather(OUT PMI_FLUSH_GATHER FlushGather, IN PFN_NUMBER NumberOfPages)
+/*
+Routine Description:
+    This routine initializes a flush gather for the deletion of the specified number of pages.
+    Large deletions get a pool array for the held pages so that the flush is done less often.
+    If there is no pool, the array in the gather itself is used.
+Arguments:
+    FlushGather - Supplies the flush gather to initialize.
+    NumberOfPages - Supplies the number of pages that are going to be deleted, zero if unknown.
+Environment:
+    Kernel mode, APC_LEVEL or below, PFN lock not held.
+*/
+{
+    PPFN_NUMBER Pages;
+
+    FlushGather->FlushList.Count = 0;
+    FlushGather->Count = 0;
+    FlushGather->Maximum = MI_FLUSH_GATHER_STACK_PAGES;
+    FlushGather->Pages = FlushGather->StackPages;
+
+    if (NumberOfPages > MI_FLUSH_GATHER_STACK_PAGES) {
+        // The page table pages of the range may be held too.
+        NumberOfPages += (NumberOfPages / PTE_PER_PAGE) + 1;
+        if (NumberOfPages > MI_FLUSH_GATHER_MAXIMUM_PAGES) {
+            NumberOfPages = MI_FLUSH_GATHER_MAXIMUM_PAGES;
+        }
+
+        Pages = ExAllocatePoolWithTag(NonPagedPool, NumberOfPages * sizeof(PFN_NUMBER), 'gFmM');
+        if (Pages != NULL) {
+            FlushGather->Maximum = (ULONG)NumberOfPages;
+            FlushGather->Pages = Pages;
+        }
+    }
+}
+
+
+VOID MiFlushGather(IN PMI_FLUSH_GATHER FlushGather)
+/*
+Routine Description:
+    This routine flushes the TB for the PTEs in the flush gather and then releases the pages it holds.
+    The pages which are no longer mapped anywhere go to the free, standby or modified lists.
+Arguments:
+    FlushGather - Supplies the flush gather to flush.
+Environment:
+    Kernel mode, PFN lock held, current process is the one the gathered PTEs belong to.
+*/
+{
+    PFN_NUMBER PageFrameIndex;
+    ULONG i;
+
+    MM_PFN_LOCK_ASSERT();
+
+    if (FlushGather->FlushList.Count != 0) {
+        MiFlushPteList(&FlushGather->FlushList);
+    }
+
+    for (i = 0; i < FlushGather->Count; i += 1) {
+        PageFrameIndex = FlushGather->Pages[i];
+        MiDecrementReferenceCount(MI_PFN_ELEMENT(PageFrameIndex), PageFrameIndex);
+    }
+
+    FlushGather->Count = 0;
+}
+
+
+VOID MiFreeFlushGather(IN PMI_FLUSH_GATHER FlushGather)
+/*
+Routine Description:
+    This routine frees the pool array of a flush gather which has been flushed.
+Arguments:
+    FlushGather - Supplies the flush gather to free.
+Environment:
+    Kernel mode, APC_LEVEL or below, PFN lock not held.
+*/
+{
+    ASSERT(FlushGather->FlushList.Count == 0);
+    ASSERT(FlushGather->Count == 0);
+
+    if (FlushGather->Pages != FlushGather->StackPages) {
+        ExFreePool(FlushGather->Pages);
+    }
+}
+
+
+FORCEINLINE VOID MiHoldPageForFlush(IN PMI_FLUSH_GATHER FlushGather, IN PMMPFN Pfn1, IN PFN_NUMBER PageFrameIndex)
+/*
+Routine Description:
+    This routine references a page whose last mapping is being deleted so that it is not reused before the gathered TB flush.
+    If the gather is full, it is flushed first.
+Arguments:
+    FlushGather - Supplies the flush gather to hold the page in.
+    Pfn1 - Supplies the PFN database entry of the page.
+    PageFrameIndex - Supplies the physical page number.
+Environment:
+    Kernel mode, PFN lock held.
+*/
+{
+    MM_PFN_LOCK_ASSERT();
+
+    if (FlushGather->Count == FlushGather->Maximum) {
+        MiFlushGather(FlushGather);
+    }
+
+    InterlockedIncrementPfn((PSHORT)&Pfn1->u3.e2.ReferenceCount);
+    FlushGather->Pages[FlushGather->Count] = PageFrameIndex;
+    FlushGather->Count += 1;
 }
 
 
-ULONG MiDeletePte(IN PMMPTE PointerPte, IN PVOID VirtualAddress, IN ULONG AddressSpaceDeletion, IN PEPROCESS CurrentProcess, IN PMMPTE PrototypePte, IN PMMPTE_FLUSH_LIST PteFlushList OPTIONAL, IN KIRQL OldIrql)
+ULONG MiDeletePte(IN PMMPTE PointerPte, IN PVOID VirtualAddress, IN ULONG AddressSpaceDeletion, IN PEPROCESS CurrentProcess, IN PMMPTE PrototypePte, IN PMI_FLUSH_GATHER FlushGather OPTIONAL, IN KIRQL OldIrql)
 /*
 Routine Description:
     This routine deletes the contents of the specified PTE.
@@ -547,7 +658,8 @@ Arguments:
     CurrentProcess - Supplies a pointer to the current process.
     PrototypePte - Supplies a pointer to the prototype PTE which currently or originally mapped this page.
                    This is used to determine if the PTE is a fork PTE and should have its reference block decremented.
-    PteFlushList - Supplies a flush list to use if the TB flush can be deferred to the caller.
+    FlushGather - Supplies a flush gather to use if the TB flush can be deferred to the caller.
+                  The page is then held by the gather until the flush instead of being freed here.
     OldIrql - Supplies the IRQL the caller acquired the PFN lock at.
 Return Value:
     Nonzero if this routine released mutexes and locks, FALSE if not.
@@ -565,10 +677,12 @@ Environment:
     ULONG DroppedLocks;
     PFN_NUMBER PageFrameIndex;
     PFN_NUMBER PageTableFrameIndex;
+    PMMPTE_FLUSH_LIST PteFlushList;
 
     MM_PFN_LOCK_ASSERT();
 
     DroppedLocks = 0;
+    PteFlushList = ARGUMENT_PRESENT(FlushGather) ? &FlushGather->FlushList : NULL;
     PteContents = *PointerPte;
     if (PteContents.u.Hard.Valid == 1) {
 #ifdef _X86_
@@ -605,6 +719,12 @@ Environment:
             PageTableFrameIndex = MI_GET_PAGE_FRAME_FROM_PTE(PointerPde);
             Pfn2 = MI_PFN_ELEMENT(PageTableFrameIndex);
             MiDecrementShareCountInline(Pfn2, PageTableFrameIndex);
+
+            // If this is the last mapping the page could be reused once it leaves the transition state, so hold it until the TB flush.
+            if ((Pfn1->u2.ShareCount == 1) && ARGUMENT_PRESENT(FlushGather)) {
+                MiHoldPageForFlush(FlushGather, Pfn1, PageFrameIndex);
+            }
+
             MiDecrementShareCountInline(Pfn1, PageFrameIndex);// Decrement the share count for the physical page.
             if (PointerPte <= MiHighestUserPte) {// Check to see if this is a fork prototype PTE and if so update the clone descriptor address.
                 if (PrototypePte != Pfn1->PteAddress) {
@@ -637,7 +757,11 @@ Environment:
             MI_SET_PFN_DELETED(Pfn1);
 
             // Decrement the share count for the physical page.
-            // As the page is private it will be put on the free list.
+            // As the page is private it will be put on the free list, after the TB flush if a flush gather is holding it.
+            if (ARGUMENT_PRESENT(FlushGather)) {
+                MiHoldPageForFlush(FlushGather, Pfn1, PageFrameIndex);
+            }
+
             MiDecrementShareCount(Pfn1, PageFrameIndex);
 
             CurrentProcess->NumberOfPrivatePages -= 1;// Decrement the count for the number of private pages.
@@ -851,6 +975,7 @@ Environment:
 #endif
 
     PageFile = MmPagingFile[PageFileNumber];
+    MiRemoveCompressedPage(PageFileNumber, FreeBit);
     MI_CLEAR_BIT(PageFile->Bitmap->Buffer, FreeBit);
 
     PageFile->FreeSpace += 1;
@@ -884,7 +1009,7 @@ Environment:
             ASSERT(MmPagingFile[PageFileNumber]->Entry[i]->Links.Flink != MM_IO_IN_PROGRESS);
             WriterEntry = MmPagingFile[PageFileNumber]->Entry[i];
             RemoveEntryList(&WriterEntry->Links);// Remove this entry and put it on the active list.
-            WriterEntry->CurrentList = &MmPagingFileHeader.ListHead;
+            WriterEntry->CurrentList = &WriterEntry->PagingListHead->ListHead;
             KeSetEvent(&WriterEntry->PagingListHead->Event, 0, FALSE);
             InsertTailList(&WriterEntry->PagingListHead->ListHead, &WriterEntry->Links);
             MmNumberOfActiveMdlEntries += 1;
@@ -20,6 +20,7 @@ VOID MiUpForkPageShareCount(IN PMMPFN PfnForkPtePage);
 ULONG MiHandleForkTransitionPte(IN PMMPTE PointerPte, IN PMMPTE PointerNewPte, IN PMMCLONE_BLOCK ForkProtoPte);
 VOID MiDownShareCountFlushEntireTb(IN PFN_NUMBER PageFrameIndex);
 VOID MiBuildForkPageTable(IN PFN_NUMBER PageFrameIndex, IN PMMPTE PointerPde, IN PMMPTE PointerNewPde, IN PFN_NUMBER PdePhysicalPage, IN PMMPFN PfnPdPage, IN LOGICAL MakeValid);
+LOGICAL MiIsForkPteFromView(IN PMMVAD Vad, IN PMMPTE PointerPte, IN MMPTE PteContents);
 
 #define MM_FORK_SUCCEEDED 0
 #define MM_FORK_FAILED 1
@@ -106,6 +107,8 @@ Environment:
     PVOID UsedPageTableEntries;
     ULONG ReleasedWorkingSetMutex;
     ULONG FirstTime;
+    LOGICAL LazyView;
+    LOGICAL NewTableBuilt;
     ULONG Waited;
     ULONG PpePdeOffset;
     PFN_NUMBER HyperPhysicalPage;
@@ -572,6 +575,19 @@ RetryPrivatePageAllocations:
             PointerPte = MiGetPteAddress(MI_VPN_TO_VA(Vad->StartingVpn));
             LastPte = MiGetPteAddress(MI_VPN_TO_VA(Vad->EndingVpn));
             FirstTime = TRUE;
+            NewTableBuilt = FALSE;
+
+            // PTEs of a shared view that only point at the prototype PTEs of the view are not copied, the new process faults them in from its VAD.
+            // Page table pages for the new process are only built once a PTE has to be copied into them, so views which are mapped but
+            // not copied on write cost the fork no page table pages at all.
+            if ((Vad->u.VadFlags.PrivateMemory == 0) &&
+                ((Vad->u.VadFlags.VadType == VadNone) || (Vad->u.VadFlags.VadType == VadImageMap)) &&
+                (Vad->u2.VadFlags2.ExtendableFile == 0) &&
+                (Vad->FirstPrototypePte != NULL)) {
+                LazyView = TRUE;
+            } else {
+                LazyView = FALSE;
+            }
 
             do {
                 // For each PTE contained in the VAD check the page table page, and if non-zero, make the appropriate modifications to copy the PTE to the new process.
@@ -632,7 +648,19 @@ RetryPrivatePageAllocations:
                     } while (Waited != 0);
 
                     FirstTime = FALSE;
+                    NewTableBuilt = FALSE;
+                }
 
+                MiMakeSystemAddressValid(PointerPte, CurrentProcess);
+                PteContents = *PointerPte;
+
+                if ((LazyView) && ((PteContents.u.Long == 0) || (MiIsForkPteFromView(Vad, PointerPte, PteContents)))) {
+                    PointerPte += 1;
+                    PointerNewPte += 1;
+                    continue;
+                }
+
+                if (NewTableBuilt == FALSE) {
 #if (_MI_PAGING_LEVELS >= 4)
                     // Calculate the address of the PXE in the new process's extended page directory parent page.
                     PointerNewPxe = &PxeBase[MiGetPpeOffset(PointerPte)];
@@ -806,10 +834,12 @@ RetryPrivatePageAllocations:
                     UsedPageTableEntries = (PVOID)&HyperWsl->UsedPageTableEntries[MiGetPdeIndex(MiGetVirtualAddressMappedByPte(PointerPte))];
 #endif
 #endif
-                }
+                    NewTableBuilt = TRUE;
 
-                MiMakeSystemAddressValid(PointerPte, CurrentProcess);
-                PteContents = *PointerPte;
+                    // The working set pushlock may have been released to get the page table pages, so read the PTE again.
+                    MiMakeSystemAddressValid(PointerPte, CurrentProcess);
+                    PteContents = *PointerPte;
+                }
 
                 // Check each PTE.
                 if (PteContents.u.Long == 0) {
@@ -1913,4 +1943,52 @@ VOID MiBuildForkPageTable(IN PFN_NUMBER PageFrameIndex, IN PMMPTE PointerPde, IN
         MI_SET_OWNER_IN_PTE(PointerNewPde, MI_PTE_OWNER_USER);
         PointerNewPde->u.Trans.PageFrameNumber = PageFrameIndex;
     }
+}
+
+
+LOGICAL MiIsForkPteFromView(IN PMMVAD Vad, IN PMMPTE PointerPte, IN MMPTE PteContents)
+/*
+Routine Description:
+    This routine determines whether a PTE of a shared view can be left zero in a forked process.
+    This is the case when the PTE maps the prototype PTE of the view at its address with the protection of the prototype PTE,
+    which is exactly what a fault through the VAD of the new process produces.
+Arguments:
+    Vad - Supplies the VAD of the view being cloned.
+    PointerPte - Supplies the PTE in the process being cloned.
+    PteContents - Supplies the contents of the PTE.
+Return Value:
+    TRUE if the new process does not need a copy of the PTE, FALSE if it does.
+Environment:
+    Kernel mode, APCs disabled, working set pushlock held, page table page resident.
+*/
+{
+    PVOID VirtualAddress;
+    PMMPTE ProtoPte;
+    PMMPFN Pfn1;
+    WSLE_NUMBER WorkingSetIndex;
+
+    VirtualAddress = MiGetVirtualAddressMappedByPte(PointerPte);
+    ProtoPte = MiGetProtoPteAddress(Vad, MI_VA_TO_VPN(VirtualAddress));
+    if (ProtoPte == NULL) {
+        return FALSE;
+    }
+
+    if (PteContents.u.Hard.Valid == 1) {
+        // Private copy on write pages and fork prototype PTEs always need copying.
+        Pfn1 = MI_PFN_ELEMENT(MI_GET_PAGE_FRAME_FROM_PTE(&PteContents));
+        if ((Pfn1->u3.e1.PrototypePte == 0) || (Pfn1->PteAddress != ProtoPte)) {
+            return FALSE;
+        }
+
+        // A protection in the WSLE was set on this page only.
+        WorkingSetIndex = MiLocateWsle(VirtualAddress, MmWorkingSetList, Pfn1->u1.WsIndex, FALSE);
+        ASSERT(WorkingSetIndex != WSLE_NULL_INDEX);
+        return (LOGICAL)(MmWsle[WorkingSetIndex].u1.e1.Protection == MM_ZERO_ACCESS);
+    }
+
+    if ((PteContents.u.Soft.Prototype == 1) && (PteContents.u.Soft.PageFileHigh != MI_PTE_LOOKUP_NEEDED)) {
+        return (LOGICAL)(MiPteToProto(&PteContents) == ProtoPte);
+    }
+
+    return FALSE;
 }
\ No newline at end of file
@@ -8,7 +8,7 @@ Module Name:
    freevm.c
 
 Abstract:
-    This module contains the routines which implement the NtFreeVirtualMemory service.
+    This module contains the routines which implement the NtFreeVirtualMemory and NtFreeVirtualMemoryRanges services.
 */
 
 #include "mi.h"
@@ -19,6 +19,37 @@ MMPTE MmDecommittedPte = {MM_DECOMMIT << MM_PROTECT_FIELD_SHIFT};
 
 VOID MiProcessValidPteList(IN PMMPTE *PteList, IN ULONG Count);
 ULONG MiDecommitPages(IN PVOID StartingAddress, IN PMMPTE EndingPte, IN PEPROCESS Process, IN PMMVAD_SHORT Vad);
+VOID MiReclaimDecommittedPageTables(IN PVOID StartingAddress, IN PVOID EndingAddress, IN PEPROCESS Process, IN PMMVAD_SHORT Vad);
+NTSTATUS MiFreeVirtualMemory(IN PEPROCESS Process,
+                             IN PVOID CapturedBase,
+                             IN OUT PSIZE_T RegionSize,
+                             IN ULONG FreeType,
+                             OUT PVOID *FreedBase,
+                             IN OUT PMI_DEFERRED_CHARGES Charges);
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE,NtFreeVirtualMemoryRanges)
+#pragma alloc_text(PAGE,MiFreeVirtualMemory)
+#pragma alloc_text(PAGE,MiReturnDeferredCharges)
+#endif
+
+
+FORCEINLINE VOID MiDeferCommitReturn(IN PEPROCESS Process, IN OUT PMI_DEFERRED_CHARGES Charges, IN SIZE_T CommitReduction)
+/*
+Routine Description:
+    This routine accumulates commitment given back by a free so that the caller returns it after releasing the address space mutex.
+Arguments:
+    Process - Supplies the process the commitment was charged to.
+    Charges - Supplies the deferred charges to accumulate into.
+    CommitReduction - Supplies the number of pages of commitment given back.
+*/
+{
+    Charges->Commitment += CommitReduction;
+    Charges->PageFileQuota += CommitReduction;
+    if (Process->JobStatus & PS_JOB_STATUS_REPORT_COMMIT_CHANGES) {
+        Charges->JobCommit += CommitReduction;
+    }
+}
 
 
 NTSTATUS NtFreeVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID *BaseAddress, __inout PSIZE_T RegionSize, __in ULONG FreeType)
@@ -37,25 +68,14 @@ Arguments:
 */
 {
     KAPC_STATE ApcState;
-    PMMVAD_SHORT Vad;
-    PMMVAD_SHORT NewVad;
-    PMMVAD PreviousVad;
-    PMMVAD NextVad;
-    PMMVAD ChargedVad;
     PEPROCESS Process;
     KPROCESSOR_MODE PreviousMode;
-    PVOID StartingAddress;
-    PVOID EndingAddress;
     NTSTATUS Status;
     LOGICAL Attached;
     SIZE_T CapturedRegionSize;
     PVOID CapturedBase;
-    PMMPTE StartingPte;
-    PMMPTE EndingPte;
-    SIZE_T OldQuota;
-    SIZE_T QuotaCharge;
-    SIZE_T CommitReduction;
-    LOGICAL UserPhysicalPages;
+    PVOID FreedBase;
+    MI_DEFERRED_CHARGES Charges;
     PETHREAD CurrentThread;
     PEPROCESS CurrentProcess;
 
@@ -98,8 +118,6 @@ Arguments:
         return STATUS_INVALID_PARAMETER_3;// Invalid region size;
     }
 
-    EndingAddress = (PVOID)(((LONG_PTR)CapturedBase + CapturedRegionSize - 1) | (PAGE_SIZE - 1));
-    StartingAddress = PAGE_ALIGN(CapturedBase);
     Attached = FALSE;
     if (ProcessHandle == NtCurrentProcess()) {
         Process = CurrentProcess;
@@ -117,39 +135,274 @@ Arguments:
         }
     }
 
-    CommitReduction = 0;
+    RtlZeroMemory(&Charges, sizeof(Charges));
+
+    // Get the address creation mutex to block multiple threads from creating or deleting address space at the same time.
+    LOCK_ADDRESS_SPACE(Process);
+
+    // Make sure the address space was not deleted.
+    if (Process->Flags & PS_PROCESS_FLAGS_VM_DELETED) {
+        Status = STATUS_PROCESS_IS_TERMINATING;
+    } else {
+        Status = MiFreeVirtualMemory(Process, CapturedBase, &CapturedRegionSize, FreeType, &FreedBase, &Charges);
+    }
+
+    UNLOCK_ADDRESS_SPACE(Process);
+
+    // Return the commitment and free the VAD pool after releasing the mutex to reduce contention.
+    MiReturnDeferredCharges(Process, &Charges);
+
+    if (Attached == TRUE) {
+        KeUnstackDetachProcess(&ApcState);
+    }
+
+    if (ProcessHandle != NtCurrentProcess()) {
+        ObDereferenceObject(Process);
+    }
+
+    if (NT_SUCCESS(Status)) {
+        // Establish an exception handler and write the size and base address.
+        try {
+            *RegionSize = CapturedRegionSize;
+            *BaseAddress = FreedBase;
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            // An exception occurred, don't take any action (just handle the exception and return success.
+        }
+    }
+
+    return Status;
+}
+
+
+NTSTATUS NtFreeVirtualMemoryRanges(__in HANDLE ProcessHandle,
+                                   __in ULONG_PTR NumberOfEntries,
+                                   __inout_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY Ranges,
+                                   __in ULONG FreeType,
+                                   __out_opt PULONG_PTR NumberOfEntriesProcessed
+)
+/*
+Routine Description:
+    This function decommits or releases a number of regions of pages within the virtual address space of a subject process.
+    All the regions are freed with a single acquisition of the address space mutex and the commitment is returned once for all of them,
+    which is cheaper for a heap or garbage collector than freeing the regions one call at a time.
+    The regions are freed in order and processing stops at the first region that cannot be freed.
+Arguments:
+    ProcessHandle - An open handle to a process object.
+    NumberOfEntries - Supplies the number of regions, up to MM_MAXIMUM_VIRTUAL_MEMORY_RANGES.
+    Ranges - Supplies the base address and size of each region, interpreted as for NtFreeVirtualMemory.
+             Each processed entry receives the base address and size of the region actually freed.
+    FreeType - Supplies MEM_DECOMMIT or MEM_RELEASE, applied to every region.
+    NumberOfEntriesProcessed - Optionally receives the number of regions that were freed.
+Return Value:
+    NTSTATUS. If a region cannot be freed the status is the one NtFreeVirtualMemory would have returned for it,
+    and all the regions before it have been freed.
+*/
+{
+    KAPC_STATE ApcState;
+    PEPROCESS Process;
+    KPROCESSOR_MODE PreviousMode;
+    NTSTATUS Status;
+    LOGICAL Attached;
+    PMEMORY_RANGE_ENTRY CapturedRanges;
+    MEMORY_RANGE_ENTRY LocalRanges[MM_VIRTUAL_MEMORY_RANGES_ON_STACK];
+    MI_DEFERRED_CHARGES Charges;
+    ULONG_PTR Processed;
+    ULONG_PTR i;
+    PETHREAD CurrentThread;
+    PEPROCESS CurrentProcess;
+
+    PAGED_CODE();
+
+    // Check to make sure FreeType is good.
+    if ((FreeType & ~(MEM_DECOMMIT | MEM_RELEASE)) != 0) {
+        return STATUS_INVALID_PARAMETER_4;
+    }
+
+    // One of MEM_DECOMMIT or MEM_RELEASE must be specified, but not both.
+    if (((FreeType & (MEM_DECOMMIT | MEM_RELEASE)) == 0) || ((FreeType & (MEM_DECOMMIT | MEM_RELEASE)) == (MEM_DECOMMIT | MEM_RELEASE))) {
+        return STATUS_INVALID_PARAMETER_4;
+    }
+
+    if ((NumberOfEntries == 0) || (NumberOfEntries > MM_MAXIMUM_VIRTUAL_MEMORY_RANGES)) {
+        return STATUS_INVALID_PARAMETER_2;
+    }
+
+    CurrentThread = PsGetCurrentThread();
+    CurrentProcess = PsGetCurrentProcessByThread(CurrentThread);
+    PreviousMode = KeGetPreviousModeByThread(&CurrentThread->Tcb);
+
+    if (NumberOfEntries <= MM_VIRTUAL_MEMORY_RANGES_ON_STACK) {
+        CapturedRanges = LocalRanges;
+    } else {
+        CapturedRanges = ExAllocatePoolWithTag(PagedPool, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY), 'rVmM');
+        if (CapturedRanges == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    // Establish an exception handler, probe the specified ranges for write access and capture the initial values.
+    try {
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(Ranges, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY), sizeof(PVOID));
+            if (ARGUMENT_PRESENT(NumberOfEntriesProcessed)) {
+                ProbeForWriteUlong_ptr(NumberOfEntriesProcessed);
+            }
+        }
+
+        RtlCopyMemory(CapturedRanges, Ranges, NumberOfEntries * sizeof(MEMORY_RANGE_ENTRY));
+    } except(ExSystemExceptionFilter())
+    {
+        Status = GetExceptionCode();
+        goto FreeRanges;
+    }
+
+    // Make sure all the regions are within the user part of the virtual address space.
+    for (i = 0; i < NumberOfEntries; i += 1) {
+        if ((CapturedRanges[i].VirtualAddress > MM_HIGHEST_USER_ADDRESS) ||
+            ((ULONG_PTR)MM_HIGHEST_USER_ADDRESS - (ULONG_PTR)CapturedRanges[i].VirtualAddress < CapturedRanges[i].NumberOfBytes)) {
+            Status = STATUS_INVALID_PARAMETER_3;
+            goto FreeRanges;
+        }
+    }
+
+    Attached = FALSE;
+    if (ProcessHandle == NtCurrentProcess()) {
+        Process = CurrentProcess;
+    } else {
+        // Reference the specified process handle for VM_OPERATION access.
+        Status = ObReferenceObjectByHandle(ProcessHandle, PROCESS_VM_OPERATION, PsProcessType, PreviousMode, (PVOID *)&Process, NULL);
+        if (!NT_SUCCESS(Status)) {
+            goto FreeRanges;
+        }
+
+        // If the specified process is not the current process, attach to the specified process.
+        if (CurrentProcess != Process) {
+            KeStackAttachProcess(&Process->Pcb, &ApcState);
+            Attached = TRUE;
+        }
+    }
+
+    RtlZeroMemory(&Charges, sizeof(Charges));
+    Processed = 0;
+    Status = STATUS_SUCCESS;
 
-    // Get the address creation mutex to block multiple threads from creating or 
-    // deleting address space at the same time and get the working set mutex so virtual address descriptors can be inserted and walked.
-    // Block APCs to prevent page faults while we own the working set mutex.
     LOCK_ADDRESS_SPACE(Process);
 
     // Make sure the address space was not deleted.
     if (Process->Flags & PS_PROCESS_FLAGS_VM_DELETED) {
         Status = STATUS_PROCESS_IS_TERMINATING;
-        goto ErrorReturn;
+    } else {
+        for (; Processed < NumberOfEntries; Processed += 1) {
+            Status = MiFreeVirtualMemory(Process,
+                                         CapturedRanges[Processed].VirtualAddress,
+                                         &CapturedRanges[Processed].NumberOfBytes,
+                                         FreeType,
+                                         &CapturedRanges[Processed].VirtualAddress,
+                                         &Charges);
+            if (!NT_SUCCESS(Status)) {
+                break;
+            }
+        }
+    }
+
+    UNLOCK_ADDRESS_SPACE(Process);
+
+    MiReturnDeferredCharges(Process, &Charges);
+
+    if (Attached == TRUE) {
+        KeUnstackDetachProcess(&ApcState);
     }
 
+    if (ProcessHandle != NtCurrentProcess()) {
+        ObDereferenceObject(Process);
+    }
+
+    // Establish an exception handler and write the freed regions.
+    try {
+        RtlCopyMemory(Ranges, CapturedRanges, Processed * sizeof(MEMORY_RANGE_ENTRY));
+        if (ARGUMENT_PRESENT(NumberOfEntriesProcessed)) {
+            *NumberOfEntriesProcessed = Processed;
+        }
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        NOTHING;
+    }
+
+FreeRanges:
+    if (CapturedRanges != LocalRanges) {
+        ExFreePool(CapturedRanges);
+    }
+
+    return Status;
+}
+
+
+NTSTATUS MiFreeVirtualMemory(IN PEPROCESS Process,
+                             IN PVOID CapturedBase,
+                             IN OUT PSIZE_T RegionSize,
+                             IN ULONG FreeType,
+                             OUT PVOID *FreedBase,
+                             IN OUT PMI_DEFERRED_CHARGES Charges
+)
+/*
+Routine Description:
+    This routine decommits or releases a region of pages within the virtual address space of the current process.
+    The commitment given back and any virtual address descriptor that is deleted are accumulated in the deferred charges
+    so that the caller can return them once after releasing the address space mutex, even when it frees many regions.
+Arguments:
+    Process - Supplies the current process.
+    CapturedBase - Supplies the captured base address of the region, already checked to be a user address.
+    RegionSize - Supplies the captured size of the region and receives the size actually freed.
+    FreeType - Supplies MEM_DECOMMIT or MEM_RELEASE.
+    FreedBase - Receives the base address of the region actually freed.
+    Charges - Supplies the deferred charges to accumulate into.
+Return Value:
+    NTSTATUS.
+Environment:
+    Kernel mode, APCs disabled, AddressCreation mutex held, the address space has not been deleted.
+*/
+{
+    PMMVAD_SHORT Vad;
+    PMMVAD_SHORT NewVad;
+    PMMVAD PreviousVad;
+    PMMVAD NextVad;
+    PMMVAD ChargedVad;
+    PVOID StartingAddress;
+    PVOID EndingAddress;
+    NTSTATUS Status;
+    SIZE_T CapturedRegionSize;
+    PMMPTE StartingPte;
+    PMMPTE EndingPte;
+    SIZE_T OldQuota;
+    SIZE_T QuotaCharge;
+    SIZE_T CommitReduction;
+    LOGICAL UserPhysicalPages;
+    PETHREAD CurrentThread;
+
+    CurrentThread = PsGetCurrentThread();
+    CapturedRegionSize = *RegionSize;
+    EndingAddress = (PVOID)(((LONG_PTR)CapturedBase + CapturedRegionSize - 1) | (PAGE_SIZE - 1));
+    StartingAddress = PAGE_ALIGN(CapturedBase);
+    CommitReduction = 0;
+
     Vad = (PMMVAD_SHORT)MiLocateAddress(StartingAddress);
     if (Vad == NULL) {
         // No Virtual Address Descriptor located for Base Address.
-        Status = STATUS_MEMORY_NOT_ALLOCATED;
-        goto ErrorReturn;
+        return STATUS_MEMORY_NOT_ALLOCATED;
     }
 
     // Found the associated Virtual Address Descriptor.
     if (Vad->EndingVpn < MI_VA_TO_VPN(EndingAddress)) {
         // The entire range to delete is not contained within a single virtual address descriptor.
         // Return an error.
-        Status = STATUS_UNABLE_TO_FREE_VM;
-        goto ErrorReturn;
+        return STATUS_UNABLE_TO_FREE_VM;
     }
 
     // Check to ensure this Vad is deletable.
     // Delete is required for both decommit and release.
     if (((Vad->u.VadFlags.PrivateMemory == 0) && (Vad->u.VadFlags.VadType != VadRotatePhysical)) || (Vad->u.VadFlags.VadType == VadDevicePhysicalMemory)) {
-        Status = STATUS_UNABLE_TO_DELETE_SECTION;
-        goto ErrorReturn;
+        return STATUS_UNABLE_TO_DELETE_SECTION;
     }
 
     if (Vad->u.VadFlags.NoChange == 1) {
@@ -161,7 +414,7 @@ Arguments:
             Status = MiCheckSecuredVad((PMMVAD)Vad, CapturedBase, CapturedRegionSize, MM_SECURE_DELETE_CHECK);
         }
         if (!NT_SUCCESS(Status)) {
-            goto ErrorReturn;
+            return Status;
         }
     }
 
@@ -180,8 +433,7 @@ Arguments:
         if (CapturedRegionSize == 0) {
             // If the region size is specified as 0, the base address must be the starting address for the region.
             if (MI_VA_TO_VPN(CapturedBase) != Vad->StartingVpn) {
-                Status = STATUS_FREE_VM_NOT_AT_BASE;
-                goto ErrorReturn;
+                return STATUS_FREE_VM_NOT_AT_BASE;
             }
 
             // This Virtual Address Descriptor has been deleted.
@@ -189,10 +441,9 @@ Arguments:
             EndingAddress = MI_VPN_TO_VA_ENDING(Vad->EndingVpn);
             if (Vad->u.VadFlags.VadType == VadRotatePhysical) {
                 Status = MiUnmapViewOfSection(Process, CapturedBase, UNMAP_ADDRESS_SPACE_HELD | UNMAP_ROTATE_PHYSICAL_OK);
-                ASSERT(CommitReduction == 0);
-                Vad = NULL;
-                CapturedRegionSize = 1 + (PCHAR)EndingAddress - (PCHAR)StartingAddress;
-                goto AllDone;
+                *RegionSize = 1 + (PCHAR)EndingAddress - (PCHAR)StartingAddress;
+                *FreedBase = StartingAddress;
+                return Status;
             }
 
             // Free all the physical pages that this VAD might be mapping.
@@ -226,10 +477,9 @@ Arguments:
                     // Free all the physical pages that this VAD might be mapping.
                     if (Vad->u.VadFlags.VadType == VadRotatePhysical) {
                         Status = MiUnmapViewOfSection(Process, CapturedBase, UNMAP_ADDRESS_SPACE_HELD | UNMAP_ROTATE_PHYSICAL_OK);
-                        ASSERT(CommitReduction == 0);
-                        Vad = NULL;
-                        CapturedRegionSize = 1 + (PCHAR)EndingAddress - (PCHAR)StartingAddress;
-                        goto AllDone;
+                        *RegionSize = 1 + (PCHAR)EndingAddress - (PCHAR)StartingAddress;
+                        *FreedBase = StartingAddress;
+                        return Status;
                     }
 
                     if (Vad->u.VadFlags.VadType == VadLargePages) {
@@ -259,8 +509,7 @@ Arguments:
                         (Vad->u.VadFlags.VadType == VadRotatePhysical) ||
                         (Vad->u.VadFlags.VadType == VadWriteWatch)) {
                         // Splitting or chopping a physical VAD, large page VAD or a write-watch VAD is not allowed.
-                        Status = STATUS_FREE_VM_NOT_AT_BASE;
-                        goto ErrorReturn;
+                        return STATUS_FREE_VM_NOT_AT_BASE;
                     }
 
                     LOCK_WS_UNSAFE(CurrentThread, Process);
@@ -268,6 +517,7 @@ Arguments:
                     // This Virtual Address Descriptor has a new starting address.
                     CommitReduction = MiCalculatePageCommitment(StartingAddress, EndingAddress, (PMMVAD)Vad, Process);
                     Vad->StartingVpn = MI_VA_TO_VPN((PCHAR)EndingAddress + 1);
+                    MiUpdateNodeGaps((PMMADDRESS_NODE)Vad);
                     Vad->u.VadFlags.CommitCharge -= CommitReduction;
                     ASSERT((SSIZE_T)Vad->u.VadFlags.CommitCharge >= 0);
                     NextVad = (PMMVAD)Vad;
@@ -278,8 +528,7 @@ Arguments:
                     (Vad->u.VadFlags.VadType == VadLargePages) ||
                     (Vad->u.VadFlags.VadType == VadRotatePhysical) ||
                     (Vad->u.VadFlags.VadType == VadWriteWatch)) {
-                    Status = STATUS_FREE_VM_NOT_AT_BASE;// Splitting or chopping a physical VAD, large page VAD or a write-watch VAD is not allowed.
-                    goto ErrorReturn;
+                    return STATUS_FREE_VM_NOT_AT_BASE;// Splitting or chopping a physical VAD, large page VAD or a write-watch VAD is not allowed.
                 }
 
                 // Starting address is greater than start of VAD.
@@ -290,13 +539,13 @@ Arguments:
                     CommitReduction = MiCalculatePageCommitment(StartingAddress, EndingAddress, (PMMVAD)Vad, Process);
                     Vad->u.VadFlags.CommitCharge -= CommitReduction;
                     Vad->EndingVpn = MI_VA_TO_VPN((PCHAR)StartingAddress - 1);
+                    MiUpdateNodeGaps((PMMADDRESS_NODE)Vad);
                     PreviousVad = (PMMVAD)Vad;
                 } else {
                     // Split this VAD as the address range is within the VAD.
                     NewVad = ExAllocatePoolWithTag(NonPagedPool, sizeof(MMVAD_SHORT), 'FdaV');
                     if (NewVad == NULL) {
-                        Status = STATUS_INSUFFICIENT_RESOURCES;
-                        goto ErrorReturn;
+                        return STATUS_INSUFFICIENT_RESOURCES;
                     }
 
                     *NewVad = *Vad;
@@ -306,9 +555,8 @@ Arguments:
                     // Insert the VAD, this could fail due to quota charges.
                     Status = MiInsertVadCharges((PMMVAD)NewVad, Process);
                     if (!NT_SUCCESS(Status)) {
-                        UNLOCK_ADDRESS_SPACE(Process);// The quota charging failed, free the new VAD and return an error.
-                        ExFreePool(NewVad);
-                        goto ErrorReturn2;
+                        ExFreePool(NewVad);// The quota charging failed, free the new VAD and return an error.
+                        return Status;
                     }
 
                     LOCK_WS_UNSAFE(CurrentThread, Process);
@@ -353,63 +601,37 @@ Arguments:
         // Update the virtual size in the process header.
         Process->VirtualSize -= CapturedRegionSize;
         Process->CommitCharge -= CommitReduction;
-        Status = STATUS_SUCCESS;
-
-    AllDone:
-        UNLOCK_ADDRESS_SPACE(Process);
 
         if (CommitReduction != 0) {
-            MI_INCREMENT_TOTAL_PROCESS_COMMIT(0 - CommitReduction);
             ASSERT(Vad == NULL);
-            PsReturnProcessPageFileQuota(Process, CommitReduction);
-            MiReturnCommitment(CommitReduction);
-            if (Process->JobStatus & PS_JOB_STATUS_REPORT_COMMIT_CHANGES) {
-                PsChangeJobMemoryUsage(PS_JOB_STATUS_REPORT_COMMIT_CHANGES, -(SSIZE_T)CommitReduction);
-            }
-
+            MiDeferCommitReturn(Process, Charges, CommitReduction);
             MM_TRACK_COMMIT(MM_DBG_COMMIT_RETURN_NTFREEVM1, CommitReduction);
         } else if (Vad != NULL) {
-            ExFreePool(Vad);
-        }
-
-        if (Attached == TRUE) {
-            KeUnstackDetachProcess(&ApcState);
-        }
-
-        if (ProcessHandle != NtCurrentProcess()) {
-            ObDereferenceObject(Process);
-        }
-
-        // Establish an exception handler and write the size and base address.
-        try {
-            *RegionSize = CapturedRegionSize;
-            *BaseAddress = StartingAddress;
-        } except(EXCEPTION_EXECUTE_HANDLER)
-        {
-            // An exception occurred, don't take any action (just handle the exception and return success.
+            // The deleted descriptor is out of the tree so its left child link can chain it for the caller to free.
+            Vad->LeftChild = (PMMVAD)Charges->FreeVads;
+            Charges->FreeVads = Vad;
         }
 
-        return Status;
+        *RegionSize = CapturedRegionSize;
+        *FreedBase = StartingAddress;
+        return STATUS_SUCCESS;
     }
 
     // MEM_DECOMMIT was specified.
     if (Vad->u.VadFlags.VadType == VadAwe) {
         // Pages from a physical VAD must be released via NtFreeUserPhysicalPages, not this routine.
-        Status = STATUS_MEMORY_NOT_ALLOCATED;
-        goto ErrorReturn;
+        return STATUS_MEMORY_NOT_ALLOCATED;
     }
 
     if ((Vad->u.VadFlags.VadType == VadLargePages) || (Vad->u.VadFlags.VadType == VadRotatePhysical)) {
         // Pages from a large page or rotate physical VAD must be released - they cannot be merely decommitted.
-        Status = STATUS_MEMORY_NOT_ALLOCATED;
-        goto ErrorReturn;
+        return STATUS_MEMORY_NOT_ALLOCATED;
     }
 
     // Check to ensure the complete range of pages is already committed.
     if (CapturedRegionSize == 0) {
         if (MI_VA_TO_VPN(CapturedBase) != Vad->StartingVpn) {
-            Status = STATUS_FREE_VM_NOT_AT_BASE;
-            goto ErrorReturn;
+            return STATUS_FREE_VM_NOT_AT_BASE;
         }
         EndingAddress = MI_VPN_TO_VA_ENDING(Vad->EndingVpn);
     }
@@ -424,59 +646,60 @@ Arguments:
     // Check to see if the entire range can be decommitted by just updating the virtual address descriptor.
     CommitReduction -= MiDecommitPages(StartingAddress, EndingPte, Process, Vad);
 
+    // Sparse reserve-then-commit users would otherwise keep page table pages full of decommitted PTEs until the whole VAD is freed.
+    if (Vad->u.VadFlags.MemCommit == 0) {
+        MiReclaimDecommittedPageTables(StartingAddress, EndingAddress, Process, Vad);
+    }
+
     // Adjust the quota charges.
     ASSERT((LONG)CommitReduction >= 0);
     Vad->u.VadFlags.CommitCharge -= CommitReduction;
     ASSERT((LONG)Vad->u.VadFlags.CommitCharge >= 0);
-    Vad = NULL;
     Process->CommitCharge -= CommitReduction;
-    UNLOCK_ADDRESS_SPACE(Process);
 
     if (CommitReduction != 0) {
-        MI_INCREMENT_TOTAL_PROCESS_COMMIT(0 - CommitReduction);
-        PsReturnProcessPageFileQuota(Process, CommitReduction);
-        MiReturnCommitment(CommitReduction);
-        if (Process->JobStatus & PS_JOB_STATUS_REPORT_COMMIT_CHANGES) {
-            PsChangeJobMemoryUsage(PS_JOB_STATUS_REPORT_COMMIT_CHANGES, -(SSIZE_T)CommitReduction);
-        }
-
+        MiDeferCommitReturn(Process, Charges, CommitReduction);
         MM_TRACK_COMMIT(MM_DBG_COMMIT_RETURN_NTFREEVM2, CommitReduction);
-    } else if (Vad != NULL) {
-        ExFreePool(Vad);
-    }
-
-    if (Attached == TRUE) {
-        KeUnstackDetachProcess(&ApcState);
     }
 
-    if (ProcessHandle != NtCurrentProcess()) {
-        ObDereferenceObject(Process);
-    }
+    *RegionSize = 1 + (PCHAR)EndingAddress - (PCHAR)StartingAddress;
+    *FreedBase = StartingAddress;
+    return STATUS_SUCCESS;
+}
 
-    // Establish an exception handler and write the size and base address.
-    try {
-        *RegionSize = 1 + (PCHAR)EndingAddress - (PCHAR)StartingAddress;
-        *BaseAddress = StartingAddress;
-    } except(EXCEPTION_EXECUTE_HANDLER)
-    {
-        NOTHING;
-    }
 
-    return STATUS_SUCCESS;
+VOID MiReturnDeferredCharges(IN PEPROCESS Process, IN PMI_DEFERRED_CHARGES Charges)
+/*
+Routine Description:
+    This routine returns the commitment, page file quota and job commitment that were accumulated while the address space mutex was held,
+    and frees the virtual address descriptors that were deleted.
+Arguments:
+    Process - Supplies the process the charges belong to.
+    Charges - Supplies the accumulated charges.
+Environment:
+    Kernel mode, APCs enabled, AddressCreation mutex not held.
+*/
+{
+    PMMVAD_SHORT Vad;
 
-ErrorReturn:
-    UNLOCK_ADDRESS_SPACE(Process);
+    if (Charges->Commitment != 0) {
+        MI_INCREMENT_TOTAL_PROCESS_COMMIT(0 - Charges->Commitment);
+        MiReturnCommitment(Charges->Commitment);
+    }
 
-ErrorReturn2:
-    if (Attached == TRUE) {
-        KeUnstackDetachProcess(&ApcState);
+    if (Charges->PageFileQuota != 0) {
+        PsReturnProcessPageFileQuota(Process, Charges->PageFileQuota);
     }
 
-    if (ProcessHandle != NtCurrentProcess()) {
-        ObDereferenceObject(Process);
+    if (Charges->JobCommit != 0) {
+        PsChangeJobMemoryUsage(PS_JOB_STATUS_REPORT_COMMIT_CHANGES, -(SSIZE_T)Charges->JobCommit);
     }
 
-    return Status;
+    while (Charges->FreeVads != NULL) {
+        Vad = Charges->FreeVads;
+        Charges->FreeVads = (PMMVAD_SHORT)Vad->LeftChild;
+        ExFreePool(Vad);
+    }
 }
 
 
@@ -837,6 +1060,159 @@ Environment:
 }
 
 
+VOID MiReclaimDecommittedPageTables(IN PVOID StartingAddress, IN PVOID EndingAddress, IN PEPROCESS Process, IN PMMVAD_SHORT Vad)
+/*
+Routine Description:
+    This routine deletes the page table pages of a just decommitted range which no longer map anything.
+    Within a VAD that was not committed at creation a zero PTE and a decommitted PTE both mean reserved,
+    so a page table page holding only those can be freed and recreated on demand like any other.
+    Only page table pages that map nothing outside the VAD are considered.
+    The TB flush for all the deleted page table pages is gathered and done once at the end.
+Arguments:
+    StartingAddress - Supplies the starting address of the decommitted range.
+    EndingAddress - Supplies the ending address of the decommitted range.
+    Process - Supplies the current process.
+    Vad - Supplies the virtual address descriptor which describes the range.
+Return Value:
+    None.
+Environment:
+    Kernel mode, APCs disabled, AddressCreation mutex held.
+*/
+{
+    PMMPTE PointerPde;
+    PMMPTE LastPde;
+    PMMPTE PointerPte;
+    PMMPTE LastPte;
+    PMMPTE NextPte;
+#if (_MI_PAGING_LEVELS >= 3)
+    PMMPTE PointerPpe;
+#endif
+#if (_MI_PAGING_LEVELS >= 4)
+    PMMPTE PointerPxe;
+#endif
+    PVOID VadStart;
+    PVOID VadEnd;
+    PVOID Va;
+    PVOID TempVa;
+    PVOID UsedPageTableHandle;
+#if (_MI_PAGING_LEVELS >= 3)
+    PVOID UsedPageDirectoryHandle;
+#endif
+    KIRQL OldIrql;
+    PETHREAD CurrentThread;
+    MI_FLUSH_GATHER FlushGather;
+
+    ASSERT(Vad->u.VadFlags.MemCommit == 0);
+
+    VadStart = MI_VPN_TO_VA(Vad->StartingVpn);
+    VadEnd = MI_VPN_TO_VA_ENDING(Vad->EndingVpn);
+    PointerPde = MiGetPdeAddress(StartingAddress);
+    LastPde = MiGetPdeAddress(EndingAddress);
+
+    // Trim the ends so only page table pages lying entirely within the VAD remain.
+    if (MiGetVirtualAddressMappedByPte(MiGetVirtualAddressMappedByPte(PointerPde)) < VadStart) {
+        PointerPde += 1;
+    }
+
+    if ((PCHAR)MiGetVirtualAddressMappedByPte(MiGetVirtualAddressMappedByPte(LastPde + 1)) - 1 > (PCHAR)VadEnd) {
+        LastPde -= 1;
+    }
+
+    if (PointerPde > LastPde) {
+        return;
+    }
+
+    MiInitializeFlushGather(&FlushGather, 0);
+    CurrentThread = PsGetCurrentThread();
+
+    LOCK_WS_UNSAFE(CurrentThread, Process);
+    for (; PointerPde <= LastPde; PointerPde += 1) {
+        // A page table page which is not resident is not costing any memory, leave it alone rather than faulting it back in.
+#if (_MI_PAGING_LEVELS >= 4)
+        PointerPxe = MiGetPdeAddress(PointerPde);
+        if (PointerPxe->u.Hard.Valid == 0) {
+            continue;
+        }
+#endif
+#if (_MI_PAGING_LEVELS >= 3)
+        PointerPpe = MiGetPteAddress(PointerPde);
+        if (PointerPpe->u.Hard.Valid == 0) {
+            continue;
+        }
+#endif
+        if (PointerPde->u.Hard.Valid == 0) {
+            continue;
+        }
+
+        PointerPte = MiGetVirtualAddressMappedByPte(PointerPde);
+        LastPte = PointerPte + PTE_PER_PAGE;
+        for (NextPte = PointerPte; NextPte < LastPte; NextPte += 1) {
+            if ((NextPte->u.Long != 0) && (NextPte->u.Long != MmDecommittedPte.u.Long)) {
+                break;
+            }
+        }
+
+        if (NextPte != LastPte) {
+            continue;
+        }
+
+        // Every PTE is reserved, zero the decommitted ones so the used count drops to zero.
+        Va = MiGetVirtualAddressMappedByPte(PointerPte);
+        UsedPageTableHandle = MI_GET_USED_PTES_HANDLE(Va);
+        for (NextPte = PointerPte; NextPte < LastPte; NextPte += 1) {
+            if (NextPte->u.Long != 0) {
+                MI_WRITE_INVALID_PTE(NextPte, ZeroPte);
+                MI_DECREMENT_USED_PTES_BY_HANDLE(UsedPageTableHandle);
+            }
+        }
+
+        ASSERT(MI_GET_USED_PTES_FROM_HANDLE(UsedPageTableHandle) == 0);
+
+        LOCK_PFN(OldIrql);
+
+#if (_MI_PAGING_LEVELS >= 3)
+        UsedPageDirectoryHandle = MI_GET_USED_PTES_HANDLE(PointerPte);
+        MI_DECREMENT_USED_PTES_BY_HANDLE(UsedPageDirectoryHandle);
+#endif
+
+        TempVa = MiGetVirtualAddressMappedByPte(PointerPde);
+        MiDeletePte(PointerPde, TempVa, FALSE, Process, NULL, &FlushGather, OldIrql);
+
+#if (_MI_PAGING_LEVELS >= 3)
+        if ((MI_GET_USED_PTES_FROM_HANDLE(UsedPageDirectoryHandle) == 0) && (PointerPpe->u.Long != 0)) {
+#if (_MI_PAGING_LEVELS >= 4)
+            UsedPageDirectoryHandle = MI_GET_USED_PTES_HANDLE(PointerPde);
+            MI_DECREMENT_USED_PTES_BY_HANDLE(UsedPageDirectoryHandle);
+#endif
+
+            TempVa = MiGetVirtualAddressMappedByPte(PointerPpe);
+            MiDeletePte(PointerPpe, TempVa, FALSE, Process, NULL, &FlushGather, OldIrql);
+
+#if (_MI_PAGING_LEVELS >= 4)
+            if ((MI_GET_USED_PTES_FROM_HANDLE(UsedPageDirectoryHandle) == 0) && (PointerPxe->u.Long != 0)) {
+                TempVa = MiGetVirtualAddressMappedByPte(PointerPxe);
+                MiDeletePte(PointerPxe, TempVa, FALSE, Process, NULL, &FlushGather, OldIrql);
+            }
+#endif
+        }
+#endif
+
+        UNLOCK_PFN(OldIrql);
+    }
+
+    // Flush the TB for everything deleted and give back the held page table pages.
+    if ((FlushGather.FlushList.Count != 0) || (FlushGather.Count != 0)) {
+        LOCK_PFN(OldIrql);
+        MiFlushGather(&FlushGather);
+        UNLOCK_PFN(OldIrql);
+    }
+
+    UNLOCK_WS_UNSAFE(CurrentThread, Process);
+
+    MiFreeFlushGather(&FlushGather);
+}
+
+
 VOID MiProcessValidPteList(IN PMMPTE *ValidPteList, IN ULONG Count)
 /*
 Routine Description:
@@ -7083,7 +7083,7 @@ PMDL MiAllocatePagesForMdl(
     }
 
     // Walk the transition lists looking for pages satisfying the constraints as walking the physical memory block can be draining.
-    for (ListHead = &MmStandbyPageListByPriority[0]; ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES]; ListHead += 1) {
+    for (ListHead = &MmStandbyPageListByPriority[0]; ListHead < &MmStandbyPageListByPriority[MI_STANDBY_LISTS]; ListHead += 1) {
         if (ListHead->Flink == MM_EMPTY_LIST) {
             continue;
         }
@@ -7096,7 +7096,7 @@ PMDL MiAllocatePagesForMdl(
 
             // Explicitly check MmAvailablePages instead (and recheck whenever the PFN lock is released and reacquired).
             if (MmAvailablePages < MM_HIGH_LIMIT) {
-                ListHead = &MmStandbyPageListByPriority[MI_PFN_PRIORITIES];
+                ListHead = &MmStandbyPageListByPriority[MI_STANDBY_LISTS];
                 break;
             }
 
@@ -7177,7 +7177,7 @@ PMDL MiAllocatePagesForMdl(
                 MdlPage += 1;
 
                 if (found == SizeInPages) {// All the pages requested are available.
-                    ListHead = &MmStandbyPageListByPriority[MI_PFN_PRIORITIES];
+                    ListHead = &MmStandbyPageListByPriority[MI_STANDBY_LISTS];
                     break;
                 }
             }
@@ -9244,7 +9244,7 @@ Environment:
         // Check the lists explicitly in order to provide our caller with the maximum number of pages.
         AvailablePages = MmZeroedPageListHead.Total + MmFreePageListHead.Total;
         for (ListHead = &MmStandbyPageListByPriority[0];
-             ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES];
+             ListHead < &MmStandbyPageListByPriority[MI_STANDBY_LISTS];
              ListHead += 1) {
             AvailablePages += ListHead->Total;
         }
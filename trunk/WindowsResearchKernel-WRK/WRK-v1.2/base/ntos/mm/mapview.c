@@ -3394,11 +3394,14 @@ Environment:
     StartBit = (ULONG)(((ULONG_PTR)MappedBase - (ULONG_PTR)Session->SystemSpaceViewStart) >> 16);
     LOCK_SYSTEM_VIEW_SPACE(Session);
     Size = MiRemoveFromSystemSpace(Session, MappedBase, &ControlArea);
-    RtlClearBits(Session->SystemSpaceBitMap, StartBit, Size);
+    UNLOCK_SYSTEM_VIEW_SPACE(Session);
+
+    // Zero PTEs without holding the view space mutex so that other mappers are not held up behind the PTE walk and the TB flush.
+    // The view is already out of the hash table so no commit can find it, and its bitmap range stays allocated until the PTEs are gone so it cannot be handed out again.
+    MiRemoveMappedPtes(MappedBase, Size * (X64K >> PAGE_SHIFT), ControlArea, Ws);
 
-    // Zero PTEs.
-    Size = Size * (X64K >> PAGE_SHIFT);
-    MiRemoveMappedPtes(MappedBase, Size, ControlArea, Ws);
+    LOCK_SYSTEM_VIEW_SPACE(Session);
+    RtlClearBits(Session->SystemSpaceBitMap, StartBit, Size);
     UNLOCK_SYSTEM_VIEW_SPACE(Session);
     return STATUS_SUCCESS;
 }
@@ -4050,6 +4053,9 @@ EditVad:
             Process->VadRoot.NodeHint = (PMMVAD)NewVad;
         }
 
+        // The old VAD is about to be freed, so invalidate the VAD hints of the threads of this process.
+        Process->VadSequence += 1;
+
         if (Process->VadFreeHint == Vad) {
             Process->VadFreeHint = (PMMVAD)NewVad;
         }
@@ -1137,6 +1137,12 @@ typedef struct _MMPFNENTRY {
 
 #define MI_GET_PFN_PRIORITY(Pfn)                                ((ULONG)(Pfn)->u4.Priority)
 
+// Pages read in by threads running with MM_PAGE_PRIORITY_LOW, and pages the cache manager asks to be put at the front of the standby list.
+#define MI_LOW_PFN_PRIORITY     1
+
+#define MI_GET_THREAD_PFN_PRIORITY(Thread)                      \
+    (((Thread)->PagePriority == MM_PAGE_PRIORITY_LOW) ? MI_LOW_PFN_PRIORITY : MI_DEFAULT_PFN_PRIORITY)
+
 
 // Reset the PFN priority to the default when a page is reused.
 
@@ -1497,10 +1503,11 @@ extern LONG MiDelayPageFaults;
 #define MM_TRACK_COMMIT_REDUCTION(_index, bump)
 #define MI_INCREMENT_TOTAL_PROCESS_COMMIT(_charge)
 
+// Small returns go to the commit reserve of the current processor, see MiReturnCommitmentToReserve.
 #define MiReturnCommitment(_QuotaCharge)                                \
             ASSERT ((SSIZE_T)(_QuotaCharge) >= 0);                      \
             ASSERT (MmTotalCommittedPages >= (_QuotaCharge));           \
-            InterlockedExchangeAddSizeT (&MmTotalCommittedPages, 0-((SIZE_T)(_QuotaCharge))); \
+            MiReturnCommitmentToReserve ((SIZE_T)(_QuotaCharge));       \
             MM_TRACK_COMMIT (MM_DBG_COMMIT_RETURN_NORMAL, (_QuotaCharge));
 
 
@@ -2210,6 +2217,22 @@ typedef struct _SEGMENT {
 
 } SEGMENT, * PSEGMENT;
 
+// Values MmCreatePeb takes from the headers and load configuration of an executable image.
+// They are captured by the first process created from the image and kept behind the image information of its segment,
+// so later processes created from the same image do not read the image pages to build their PEB.
+typedef struct _MI_IMAGE_PEB_INFORMATION {
+    LONG Captured;
+    USHORT Characteristics;
+    USHORT CSDVersion;
+    ULONG ImageSubsystem;
+    ULONG ImageSubsystemMajorVersion;
+    ULONG ImageSubsystemMinorVersion;
+    ULONG Win32VersionValue;
+    ULONG_PTR ProcessAffinityMask;
+} MI_IMAGE_PEB_INFORMATION, * PMI_IMAGE_PEB_INFORMATION;
+
+#define MI_GET_IMAGE_PEB_INFORMATION(Segment) ((PMI_IMAGE_PEB_INFORMATION)((Segment)->u2.ImageInformation + 1))
+
 typedef struct _MAPPED_FILE_SEGMENT {
     struct _CONTROL_AREA* ControlArea;
     ULONG TotalNumberOfPtes;
@@ -2294,6 +2317,11 @@ typedef struct _CONTROL_AREA {
     USHORT ModifiedWriteCount;
     USHORT FlushInProgressCount;
     ULONG WritableUserReferences;
+    PMMPTE NextSequentialPte;           // PTE following the last user in-page read
+    USHORT ReadAheadCluster;            // adaptive user read cluster, in pages
+    USHORT LastReadAhead;               // pages read ahead by the last read
+    ULONG ReadAheadPages;
+    ULONG ReadAheadHits;
 #if !defined (_WIN64)
     ULONG QuadwordPad;
 #endif
@@ -2317,6 +2345,11 @@ typedef struct _LARGE_CONTROL_AREA {
     USHORT ModifiedWriteCount;
     USHORT FlushInProgressCount;
     ULONG WritableUserReferences;
+    PMMPTE NextSequentialPte;           // PTE following the last user in-page read
+    USHORT ReadAheadCluster;            // adaptive user read cluster, in pages
+    USHORT LastReadAhead;               // pages read ahead by the last read
+    ULONG ReadAheadPages;
+    ULONG ReadAheadHits;
 #if !defined (_WIN64)
     ULONG QuadwordPad;
 #endif
@@ -2463,7 +2496,7 @@ typedef struct _MMWORKING_SET_EXPANSION_HEAD {
 
 typedef struct _MMINPAGE_FLAGS {
     ULONG_PTR Completed : 1;
-    ULONG_PTR Available1 : 1;
+    ULONG_PTR Compressed : 1;       // The page is read from the compressed store
     ULONG_PTR Available2 : 1;
 #if defined (_WIN64)
     ULONG_PTR PrefetchMdlHighBits : 61;
@@ -2568,10 +2601,15 @@ typedef struct _MMVAD_FLAGS {
     ULONG_PTR VadType : 3;
     ULONG_PTR MemCommit : 1;
     ULONG_PTR Protection : 5;
-    ULONG_PTR Spare : 2;
+    ULONG_PTR AccessHint : 2;       // access pattern advised with MEM_ADVISE
     ULONG_PTR PrivateMemory : 1;    // used to tell VAD from VAD_SHORT
 } MMVAD_FLAGS;
 
+// Access hints kept in the VAD, these are the values of the matching MEM_ADVICE_* advice.
+#define MI_VAD_ACCESS_NORMAL        MEM_ADVICE_NORMAL
+#define MI_VAD_ACCESS_RANDOM        MEM_ADVICE_RANDOM
+#define MI_VAD_ACCESS_SEQUENTIAL    MEM_ADVICE_SEQUENTIAL
+
 typedef struct _MMVAD_FLAGS2 {
     unsigned FileOffset : 24;       // number of 64k units into file
     unsigned SecNoChange : 1;       // set if SEC_NOCHANGE specified
@@ -2619,6 +2657,7 @@ typedef struct _MMVAD {
     struct _MMVAD* RightChild;
     ULONG_PTR StartingVpn;
     ULONG_PTR EndingVpn;
+    ULONG_PTR LargestGap;
 
     union {
         ULONG_PTR LongFlags;
@@ -2642,6 +2681,7 @@ typedef struct _MMVAD_LONG {
     struct _MMVAD* RightChild;
     ULONG_PTR StartingVpn;
     ULONG_PTR EndingVpn;
+    ULONG_PTR LargestGap;
 
     union {
         ULONG_PTR LongFlags;
@@ -2673,6 +2713,7 @@ typedef struct _MMVAD_SHORT {
     struct _MMVAD* RightChild;
     ULONG_PTR StartingVpn;
     ULONG_PTR EndingVpn;
+    ULONG_PTR LargestGap;
 
     union {
         ULONG_PTR LongFlags;
@@ -2691,6 +2732,7 @@ typedef struct _MI_PHYSICAL_VIEW {
     struct _MMADDRESS_NODE* RightChild;
     ULONG_PTR StartingVpn;      // Actually a virtual address, not a VPN
     ULONG_PTR EndingVpn;        // Actually a virtual address, not a VPN
+    ULONG_PTR LargestGap;
     PMMVAD Vad;
     MI_VAD_TYPE VadType;
     union {
@@ -2763,6 +2805,7 @@ typedef struct _MMCLONE_DESCRIPTOR {
     struct _MMADDRESS_NODE* RightChild;
     ULONG_PTR StartingVpn;
     ULONG_PTR EndingVpn;
+    ULONG_PTR LargestGap;
     ULONG NumberOfPtes;
     PMMCLONE_HEADER CloneHeader;
     LONG NumberOfReferences;
@@ -2823,7 +2866,8 @@ typedef struct _MMMOD_WRITER_MDL_ENTRY {
 } MMMOD_WRITER_MDL_ENTRY, * PMMMOD_WRITER_MDL_ENTRY;
 
 
-#define MM_PAGING_FILE_MDLS 2
+// Each paging file has this many MDLs so that several cluster writes to it can be outstanding at once.
+#define MM_PAGING_FILE_MDLS 4
 
 typedef struct _MMPAGING_FILE {
     PFN_NUMBER Size;
@@ -2844,6 +2888,9 @@ typedef struct _MMPAGING_FILE {
         ULONG Reserved : 23;
     };
     HANDLE FileHandle;
+
+    // The free MDLs of a paging file with a writer thread of its own are kept here instead of on MmPagingFileHeader.
+    MMMOD_WRITER_LISTHEAD WriterHeader;
 } MMPAGING_FILE, * PMMPAGING_FILE;
 
 
@@ -2899,6 +2946,21 @@ typedef struct _MMPTE_FLUSH_LIST {
 } MMPTE_FLUSH_LIST, * PMMPTE_FLUSH_LIST;
 
 
+// Gather for deferring the TB flush of deleted user PTEs.
+// Each page whose last mapping is deleted is held with a reference until the flush so that it cannot be reused while another processor may still have a stale translation for it.
+// This lets the flush be deferred past releases of the PFN lock. The flush list switches to a flush of the whole process TB once it overflows so any number of PTEs can be gathered, only the held pages are bounded.
+#define MI_FLUSH_GATHER_STACK_PAGES 32
+#define MI_FLUSH_GATHER_MAXIMUM_PAGES 16384
+
+typedef struct _MI_FLUSH_GATHER {
+    MMPTE_FLUSH_LIST FlushList;
+    ULONG Count;
+    ULONG Maximum;
+    PPFN_NUMBER Pages;
+    PFN_NUMBER StackPages[MI_FLUSH_GATHER_STACK_PAGES];
+} MI_FLUSH_GATHER, *PMI_FLUSH_GATHER;
+
+
 // List for flushing WSLEs and TBs singularly.
 typedef struct _MMWSLE_FLUSH_LIST {
     ULONG Count;
@@ -3056,7 +3118,8 @@ VOID FASTCALL MiDecrementShareCount(IN PMMPFN Pfn1, IN PFN_NUMBER PageFrameIndex
 VOID FASTCALL MiInsertPageInList(IN PMMPFNLIST ListHead, IN PFN_NUMBER PageFrameIndex);
 VOID FASTCALL MiInsertPageInFreeList(IN PFN_NUMBER PageFrameIndex);
 VOID FASTCALL MiInsertZeroListAtBack(IN PFN_NUMBER PageFrameIndex);
-VOID FASTCALL MiInsertStandbyListAtFront(IN PFN_NUMBER PageFrameIndex);
+VOID FASTCALL MiInsertStandbyListAtFront(IN PFN_NUMBER PageFrameIndex, IN ULONG Priority);
+PFN_NUMBER FASTCALL MiRemoveStandbyPage(IN ULONG Color);
 PFN_NUMBER FASTCALL MiRemovePageFromList(IN PMMPFNLIST ListHead);
 VOID FASTCALL MiUnlinkPageFromList(IN PMMPFN Pfn);
 VOID MiUnlinkFreeOrZeroedPage(IN PMMPFN Pfn);
@@ -3078,6 +3141,20 @@ ULONG FASTCALL MiEnsureAvailablePageOrWait(IN PEPROCESS Process, IN KIRQL OldIrq
 PFN_NUMBER MiAllocatePfn(IN PMMPTE PointerPte, IN ULONG Protection);
 PFN_NUMBER FASTCALL MiRemoveAnyPage(IN ULONG PageColor);
 PFN_NUMBER FASTCALL MiRemoveZeroPage(IN ULONG PageColor);
+PFN_NUMBER FASTCALL MiRemoveCachedZeroPage(IN ULONG PageColor);
+VOID MiDrainPageCaches(VOID);
+
+// Each processor caches a batch of zeroed pages taken off the colored lists under a single PFN lock hold.
+// Cached pages are not on any list and are not counted in MmAvailablePages. The caches are only touched with the PFN lock held.
+#define MI_PAGE_CACHE_DEPTH 32
+
+typedef struct DECLSPEC_CACHEALIGN _MI_PAGE_CACHE {
+    ULONG Count;
+    PFN_NUMBER Page[MI_PAGE_CACHE_DEPTH];
+} MI_PAGE_CACHE, *PMI_PAGE_CACHE;
+
+extern MI_PAGE_CACHE MiPageCaches[MAXIMUM_PROCESSORS];
+extern PFN_NUMBER MiCachedZeroPages;
 
 typedef struct _COLORED_PAGE_INFO {
     union {
@@ -3094,6 +3171,11 @@ typedef struct _COLORED_PAGE_INFO {
 
 VOID MiZeroInParallel(IN PCOLORED_PAGE_INFO ColoredPageInfoBase);
 VOID MiStartZeroPageWorkers(VOID);
+PFN_COUNT MiRemovePagesToZero(IN OUT PULONG Color, IN PFN_COUNT MaximumPagesToZero, OUT PMMPFN *PfnAllocation);
+LOGICAL MiZeroPagesInSystemSpace(IN PMMPFN PfnAllocation, IN PFN_COUNT PagesToZero);
+#if defined(MI_MULTINODE)
+VOID MiStartZeroNodeThreads(VOID);
+#endif
 VOID MiPurgeTransitionList(VOID);
 
 typedef struct _MM_LDW_WORK_CONTEXT {
@@ -3301,6 +3383,7 @@ PMMADDRESS_NODE FASTCALL MiGetFirstNode(IN PMM_AVL_TABLE Root);
 PMMADDRESS_NODE MiGetLastNode(IN PMM_AVL_TABLE Root);
 VOID FASTCALL MiInsertNode(IN PMMADDRESS_NODE Node, IN PMM_AVL_TABLE Root);
 VOID FASTCALL MiRemoveNode(IN PMMADDRESS_NODE Node, IN PMM_AVL_TABLE Root);
+VOID FASTCALL MiUpdateNodeGaps(IN PMMADDRESS_NODE Node);
 PMMADDRESS_NODE FASTCALL MiLocateAddressInTree(IN ULONG_PTR Vpn, IN PMM_AVL_TABLE Root);
 PMMADDRESS_NODE MiCheckForConflictingNode(IN ULONG_PTR StartVpn, IN ULONG_PTR EndVpn, IN PMM_AVL_TABLE Root);
 NTSTATUS MiFindEmptyAddressRangeInTree(IN SIZE_T SizeOfRange, IN ULONG_PTR Alignment, IN PMM_AVL_TABLE Root, OUT PMMADDRESS_NODE* PreviousVad, OUT PVOID* Base);
@@ -3355,6 +3438,9 @@ Arguments:
     ASSERT(Root->NumberGenericTableElements >= 1);
     MiRemoveNode((PMMADDRESS_NODE)Vad, Root);
 
+    // Invalidate the VAD hints of the threads of this process.
+    CurrentProcess->VadSequence += 1;
+
     // If the hint points at the removed VAD, change the hint.
     if (Root->NodeHint == Vad) {
         Root->NodeHint = Root->BalancedRoot.RightChild;
@@ -3429,6 +3515,7 @@ PKLDR_DATA_TABLE_ENTRY MiLookupDataTableEntry(IN PVOID AddressWithinSection, IN
 VOID MiObtainFreePages(VOID);
 VOID MiModifiedPageWriter(IN PVOID StartContext);
 VOID MiMappedPageWriter(IN PVOID StartContext);
+VOID MiPagingFileWriter(IN PVOID StartContext);
 LOGICAL MiIssuePageExtendRequest(IN PMMPAGE_FILE_EXPANSION PageExtend);
 VOID MiIssuePageExtendRequestNoWait(IN PFN_NUMBER SizeInPages);
 SIZE_T MiExtendPagingFiles(IN PMMPAGE_FILE_EXPANSION PageExpand);
@@ -3437,6 +3524,14 @@ VOID MiAttemptPageFileReduction(VOID);
 LOGICAL MiCancelWriteOfMappedPfn(IN PFN_NUMBER PageToStop, IN KIRQL OldIrql);
 
 
+// Compressed store for pages bound for the paging files.
+VOID MiInitializeCompressedStore(VOID);
+LOGICAL MiStoreCompressedPages(IN PMDL Mdl, IN ULONG PageFileNumber, IN ULONG PageFileOffset);
+LOGICAL MiIsPageCompressed(IN ULONG PageFileNumber, IN ULONG PageFileOffset);
+NTSTATUS MiReadCompressedPage(IN PMDL Mdl, IN ULONG PageFileNumber, IN ULONG PageFileOffset, OUT PIO_STATUS_BLOCK IoStatus);
+VOID MiRemoveCompressedPage(IN ULONG PageFileNumber, IN ULONG PageFileOffset);
+
+
 // Routines to delete address space.
 VOID MiDeletePteRange(IN PMMSUPPORT WsInfo, IN PMMPTE PointerPte, IN PMMPTE LastPte, IN LOGICAL AddressSpaceDeletion);
 VOID MiDeleteVirtualAddresses(IN PUCHAR StartingAddress, IN PUCHAR EndingAddress, IN PMMVAD Vad);
@@ -3445,9 +3540,12 @@ ULONG MiDeletePte(IN PMMPTE PointerPte,
                   IN ULONG AddressSpaceDeletion,
                   IN PEPROCESS CurrentProcess,
                   IN PMMPTE PrototypePte,
-                  IN PMMPTE_FLUSH_LIST PteFlushList OPTIONAL,
+                  IN PMI_FLUSH_GATHER FlushGather OPTIONAL,
                   IN KIRQL OldIrql
 );
+VOID MiInitializeFlushGather(OUT PMI_FLUSH_GATHER FlushGather, IN PFN_NUMBER NumberOfPages);
+VOID MiFlushGather(IN PMI_FLUSH_GATHER FlushGather);
+VOID MiFreeFlushGather(IN PMI_FLUSH_GATHER FlushGather);
 VOID MiDeleteValidSystemPte(IN PMMPTE PointerPte,
                             IN PVOID VirtualAddress,
                             IN PMMSUPPORT WsInfo,
@@ -3525,6 +3623,11 @@ extern PKNODE KeNodeBlock[];
 #define MiRemoveZeroPageIfAny(COLOR)                                        \
         KeNumberNodes > 1 ? (KeGetCurrentNode()->FreeCount[ZeroedPageList] != 0) ? MiRemoveZeroPage(COLOR) : 0 : (MmFreePagesByColor[ZeroedPageList][COLOR].Flink != MM_EMPTY_LIST) ? MiRemoveZeroPage(COLOR) : 0
 #define MI_GET_PAGE_COLOR_NODE(n)                          (((MI_SYSTEM_PAGE_COLOR++) & MmSecondaryColorMask) | KeNodeBlock[n]->MmShiftedColor)
+
+// The process page color counter is embedded in the process so the process, and hence its preferred node if any, can be recovered from the counter address.
+#define MI_PROCESS_FROM_PAGE_COLOR(COLOR)                                   CONTAINING_RECORD((COLOR), EPROCESS, NextPageColor)
+#define MI_PROCESS_NODE_COLOR(COLOR)                                        \
+        ((MI_PROCESS_FROM_PAGE_COLOR(COLOR)->Pcb.PreferredNode != 0) ? KeNodeBlock[MI_PROCESS_FROM_PAGE_COLOR(COLOR)->Pcb.IdealNode]->MmShiftedColor : MI_CURRENT_NODE_COLOR)
 #else
 #define MI_NODE_FROM_COLOR(c)
 #define MI_GET_COLOR_FROM_LIST_ENTRY(index,pfn)   ((ULONG)MI_GET_SECONDARY_COLOR((index),(pfn)))
@@ -3532,6 +3635,7 @@ extern PKNODE KeNodeBlock[];
 #define MI_CURRENT_NODE_COLOR                      0
 #define MiRemoveZeroPageIfAny(COLOR)              (MmFreePagesByColor[ZeroedPageList][COLOR].Flink != MM_EMPTY_LIST) ? MiRemoveZeroPage(COLOR) : 0
 #define MI_GET_PAGE_COLOR_NODE(n)                 ((MI_SYSTEM_PAGE_COLOR++) & MmSecondaryColorMask)
+#define MI_PROCESS_NODE_COLOR(COLOR)              0
 #endif
 
 
@@ -3871,6 +3975,8 @@ VOID MiTrimSegmentCache(VOID);
 VOID MiInitializeCommitment(VOID);
 LOGICAL FASTCALL MiChargeCommitment(IN SIZE_T QuotaCharge, IN PEPROCESS Process OPTIONAL);
 LOGICAL FASTCALL MiChargeCommitmentCantExpand(IN SIZE_T QuotaCharge, IN ULONG MustSucceed);
+VOID FASTCALL MiReturnCommitmentToReserve(IN SIZE_T QuotaCharge);
+LOGICAL MiDrainCommitReserves(VOID);
 LOGICAL FASTCALL MiChargeTemporaryCommitmentForReduction(IN SIZE_T QuotaCharge);
 VOID MiCauseOverCommitPopup(VOID);
 
@@ -3886,6 +3992,23 @@ VOID MiReturnPageTablePageCommitment(IN PVOID StartingAddress,
                                      IN PEPROCESS CurrentProcess,
                                      IN PMMVAD PreviousVad,
                                      IN PMMVAD NextVad);
+
+// Charges given back while the address space mutex is held, returned once by the caller after the mutex is released.
+// Deleted VADs are chained through their left child links so they are freed outside the mutex as well.
+typedef struct _MI_DEFERRED_CHARGES {
+    SIZE_T Commitment;
+    SIZE_T PageFileQuota;
+    SIZE_T JobCommit;
+    PMMVAD_SHORT FreeVads;
+} MI_DEFERRED_CHARGES, *PMI_DEFERRED_CHARGES;
+
+VOID MiReturnDeferredCharges(IN PEPROCESS Process, IN PMI_DEFERRED_CHARGES Charges);
+
+// Most ranges NtAllocateVirtualMemoryRanges and NtFreeVirtualMemoryRanges take in one call, and the most captured on the stack.
+#define MM_MAXIMUM_VIRTUAL_MEMORY_RANGES    1024
+#define MM_VIRTUAL_MEMORY_RANGES_ON_STACK   16
+
+VOID MiPrefetchVirtualMemory(IN PEPROCESS Process, IN ULONG NumberOfEntries, IN PMEMORY_RANGE_ENTRY Ranges, IN KPROCESSOR_MODE PreviousMode);
 VOID MiFlushAllPages(VOID);
 VOID MiModifiedPageWriterTimerDispatch(IN PKDPC Dpc,
                                        IN PVOID DeferredContext,
@@ -4258,6 +4381,9 @@ extern SIZE_T MmResTrack[MM_BUMP_COUNTER_MAX];
     InterlockedExchangeAddSizeT (&MmResTrack[_index], (SIZE_T)(bump));
 
 extern ULONG MmLargePageMinimum;
+extern SIZE_T MmTransparentLargePageMinimum;
+extern ULONG MmTransparentLargePageAllocations;
+extern ULONG MmTransparentLargePageFallbacks;
 extern const MMPTE ZeroPte;
 extern const MMPTE ZeroKernelPte;
 extern const MMPTE ValidKernelPteLocal;
@@ -4315,6 +4441,27 @@ extern PFN_NUMBER MmHighestPossiblePhysicalPage;// Highest possible physical pag
 #define MI_BLADE_MAX_PAGES ((PFN_NUMBER)(((ULONG64)2 * 1024 * 1024 * 1024) >> PAGE_SHIFT))
 
 extern RTL_BITMAP MiPfnBitMap;
+extern RTL_BITMAP MiAvailablePfnBitMap;
+
+// The list routines keep a bit set in MiAvailablePfnBitMap for each page on the zeroed, free or standby lists (with the PFN lock held).
+// Physical memory scans test the bitmap before the PFN entry so that runs of pages in use are skipped without bringing their PFN entries into the cache.
+// The bitmap is created once the lists are built in phase 0, until then every page may be available.
+#define MI_NOTE_PFN_LIST(PageFrameIndex, ListName)                          \
+    if (MiAvailablePfnBitMap.Buffer != NULL) {                              \
+        if ((ListName) <= StandbyPageList) {                                \
+            MI_SET_BIT(MiAvailablePfnBitMap.Buffer, PageFrameIndex);        \
+        } else {                                                            \
+            MI_CLEAR_BIT(MiAvailablePfnBitMap.Buffer, PageFrameIndex);      \
+        }                                                                   \
+    }
+
+#define MI_NOTE_PFN_UNLINKED(PageFrameIndex)                                \
+    if (MiAvailablePfnBitMap.Buffer != NULL) {                              \
+        MI_CLEAR_BIT(MiAvailablePfnBitMap.Buffer, PageFrameIndex);          \
+    }
+
+#define MI_PFN_MAY_BE_AVAILABLE(PageFrameIndex) \
+    ((MiAvailablePfnBitMap.Buffer == NULL) || (MI_CHECK_BIT(MiAvailablePfnBitMap.Buffer, PageFrameIndex) != 0))
 
 
 FORCEINLINE LOGICAL MI_IS_PFN(IN PFN_NUMBER PageFrameIndex)
@@ -4340,7 +4487,22 @@ Environment:
 extern MMPFNLIST MmZeroedPageListHead;
 extern MMPFNLIST MmFreePageListHead;
 extern MMPFNLIST MmStandbyPageListHead;
-extern MMPFNLIST MmStandbyPageListByPriority[MI_PFN_PRIORITIES];
+
+// There is a standby list for each page priority on each node.
+// The lists of a priority are adjacent so that walking the array visits the priorities from the lowest up.
+#if defined(MI_MULTINODE)
+#define MI_STANDBY_NODES            MAXIMUM_CCNUMA_NODES
+#define MI_GET_PFN_NODE(Pfn)        ((ULONG)(Pfn)->u3.e1.PageColor)
+#else
+#define MI_STANDBY_NODES            1
+#define MI_GET_PFN_NODE(Pfn)        0
+#endif
+
+#define MI_STANDBY_LISTS            (MI_PFN_PRIORITIES * MI_STANDBY_NODES)
+#define MI_STANDBY_LIST(Priority, Node)     (&MmStandbyPageListByPriority[(Priority) * MI_STANDBY_NODES + (Node)])
+#define MI_STANDBY_LIST_FOR_PFN(Pfn)        MI_STANDBY_LIST(MI_GET_PFN_PRIORITY(Pfn), MI_GET_PFN_NODE(Pfn))
+
+extern MMPFNLIST MmStandbyPageListByPriority[MI_STANDBY_LISTS];
 extern MMPFNLIST MmRomPageListHead;
 extern MMPFNLIST MmModifiedPageListHead;
 extern MMPFNLIST MmModifiedNoWritePageListHead;
@@ -4572,6 +4734,7 @@ extern LIST_ENTRY MmUnusedSubsectionList;
 extern KEVENT MmUnusedSegmentCleanup;
 extern ULONG MmConsumedPoolPercentage;
 extern ULONG MmUnusedSegmentCount;
+extern ULONG MmUnusedImageSegmentMaximum;
 extern ULONG MmUnusedSubsectionCount;
 extern ULONG MmUnusedSubsectionCountPeak;
 extern SIZE_T MiUnusedSubsectionPagedPool;
@@ -4609,6 +4772,23 @@ extern SIZE_T MiUnusedSubsectionPagedPoolPeak;
 VOID MiConvertStaticSubsections(IN PCONTROL_AREA ControlArea);
 
 
+// LOGICAL MI_RETAIN_UNUSED_IMAGE_SEGMENT (IN PCONTROL_AREA _ControlArea);
+// Routine Description:
+//    This routine determines whether an image segment with no views, section references or resident pages should be kept on the unused segment list.
+//    Keeping it lets the next map of the image reuse the segment instead of parsing the image header and building the prototype PTEs again.
+//    Such segments are trimmed with the rest of the unused segments once pool usage calls for it.
+// Arguments
+//    _ControlArea - Supplies the control area to check.
+// Return Value:
+//    TRUE if the segment should be kept, FALSE if it should be deleted.
+#define MI_RETAIN_UNUSED_IMAGE_SEGMENT(_ControlArea)                         \
+        (((_ControlArea)->u.Flags.Image == 1) &&                             \
+         ((_ControlArea)->u.Flags.GlobalMemory == 0) &&                      \
+         ((_ControlArea)->u.Flags.DeleteOnClose == 0) &&                     \
+         ((_ControlArea)->u.Flags.BeingDeleted == 0) &&                      \
+         (!MI_UNUSED_SEGMENTS_SURPLUS()))
+
+
 // VOID MI_INSERT_UNUSED_SEGMENT (IN PCONTROL_AREA _ControlArea);
 // Routine Description:
 //    This routine inserts a control area into the unused segment list, also managing the associated pool charges.
@@ -4692,6 +4872,7 @@ Environment:
     }
 #endif
 
+    MiRemoveCompressedPage(PageFileNumber, FreeBit);
     MI_CLEAR_BIT(PageFile->Bitmap->Buffer, FreeBit);
 
     PageFile->FreeSpace += 1;
@@ -5069,6 +5250,7 @@ typedef struct _MM_SESSION_SPACE {
     // Session space paged pool support.
     KGUARDED_MUTEX PagedPoolMutex;
     MM_PAGED_POOL_INFO PagedPoolInfo;
+    SLIST_HEADER PagedPoolSListHead;    // Freed single pages kept for reuse without the paged pool mutex
 
     // Working set information.
     MMSUPPORT  Vm;
@@ -5360,7 +5542,7 @@ FORCEINLINE ULONG MmGetNodeColor(VOID)
 //   COLOR  Value from which color is determined.   This variable is incremented.
 // Return Value:
 //    The page's color.
-#define MI_PAGE_COLOR_PTE_PROCESS(PTE,COLOR)           (((ULONG)(++(*(COLOR))) & MmSecondaryColorMask) | MI_CURRENT_NODE_COLOR)
+#define MI_PAGE_COLOR_PTE_PROCESS(PTE,COLOR)           (((ULONG)(++(*(COLOR))) & MmSecondaryColorMask) | MI_PROCESS_NODE_COLOR(COLOR))
 
 
 // ULONG MI_PAGE_COLOR_VA_PROCESS (IN PVOID ADDRESS, IN PEPROCESS COLOR);
@@ -5370,6 +5552,6 @@ FORCEINLINE ULONG MmGetNodeColor(VOID)
 //    ADDRESS - Supplies the address the page is (or was) mapped at.
 // Return Value:
 //    The pages color.
-#define MI_PAGE_COLOR_VA_PROCESS(ADDRESS,COLOR)          (((ULONG)(++(*(COLOR))) & MmSecondaryColorMask) | MI_CURRENT_NODE_COLOR)
+#define MI_PAGE_COLOR_VA_PROCESS(ADDRESS,COLOR)          (((ULONG)(++(*(COLOR))) & MmSecondaryColorMask) | MI_PROCESS_NODE_COLOR(COLOR))
 
 #endif  // MI
\ No newline at end of file
@@ -79,7 +79,7 @@ MMPFNLIST MmStandbyPageListHead = {
                     MM_EMPTY_LIST  // Blink
 };
 
-MMPFNLIST MmStandbyPageListByPriority[MI_PFN_PRIORITIES];
+MMPFNLIST MmStandbyPageListByPriority[MI_STANDBY_LISTS];
 
 MMPFNLIST MmModifiedPageListHead = {
                     0, // Total
@@ -216,6 +216,7 @@ PFN_NUMBER MmSystemCacheWsMinimum = 288;
 
 
 // Cells to track unused thread kernel stacks to avoid TB flushes every time a thread terminates.
+// The maximum is per node and is raised on larger systems during initialization.
 ULONG MmMaximumDeadKernelStacks = 5;
 SLIST_HEADER MmDeadStackSListHead;
 
@@ -248,6 +249,9 @@ LIST_ENTRY MmUnusedSegmentList;
 LIST_ENTRY MmUnusedSubsectionList;
 KEVENT MmUnusedSegmentCleanup;
 ULONG MmUnusedSegmentCount;
+
+// The unused segment list only takes image segments without resident pages while it holds fewer segments than this.
+ULONG MmUnusedImageSegmentMaximum = 512;
 ULONG MmUnusedSubsectionCount;
 ULONG MmUnusedSubsectionCountPeak;
 SIZE_T MiUnusedSubsectionPagedPool;
@@ -40,6 +40,7 @@ ULONG MiFullyInitialized;
 LOGICAL MiSafeBooted = FALSE;
 PFN_NUMBER MmFreedExpansionPoolMaximum;
 RTL_BITMAP MiPfnBitMap;
+RTL_BITMAP MiAvailablePfnBitMap;
 
 VOID MiMapBBTMemory(IN PLOADER_PARAMETER_BLOCK LoaderBlock);
 VOID MiEnablePagingTheExecutive(VOID);
@@ -249,6 +250,7 @@ Environment:
     LOGICAL AutosizingFragment;
     PULONG Bitmap;
     PPHYSICAL_MEMORY_RUN Run;
+    PMMPFNLIST ListHead;
     ULONG VerifierFlags;
 #if DBG
     MMPTE Pointer;
@@ -668,7 +670,7 @@ Environment:
         // End of sanity checks.
 #endif
 
-        for (i = 0; i < MI_PFN_PRIORITIES; i += 1) {
+        for (i = 0; i < MI_STANDBY_LISTS; i += 1) {
             MmStandbyPageListByPriority[i].Total = 0;
             MmStandbyPageListByPriority[i].ListName = StandbyPageList;
             MmStandbyPageListByPriority[i].Flink = MM_EMPTY_LIST;
@@ -952,6 +954,30 @@ Environment:
             }
         }
 
+        // Create the bitmap of the pages on the zeroed, free and standby lists from the lists built so far, the list routines keep it current from here on.
+        // It is sized like the PFN bitmap (rounded to a quadword for the 64-bit bit instructions) so hotadds do not reallocate it.
+        // If it cannot be allocated, the physical memory scans examine every PFN entry instead.
+        j = (((MmHighestPossiblePhysicalPage + 1) + 63) / 64) * 8;
+        Bitmap = ExAllocatePoolWithTag(NonPagedPool, j, 'aPmM');
+        if (Bitmap != NULL) {
+            RtlZeroMemory(Bitmap, j);
+            for (i = 0; i < MI_STANDBY_LISTS + 2; i += 1) {
+                if (i == 0) {
+                    ListHead = &MmZeroedPageListHead;
+                } else if (i == 1) {
+                    ListHead = &MmFreePageListHead;
+                } else {
+                    ListHead = &MmStandbyPageListByPriority[i - 2];
+                }
+
+                for (PageFrameIndex = ListHead->Flink; PageFrameIndex != MM_EMPTY_LIST; PageFrameIndex = MI_PFN_ELEMENT(PageFrameIndex)->u1.Flink) {
+                    MI_SET_BIT(Bitmap, PageFrameIndex);
+                }
+            }
+
+            RtlInitializeBitMap(&MiAvailablePfnBitMap, Bitmap, (ULONG)(MmHighestPossiblePhysicalPage + 1));
+        }
+
         MiSyncCachedRanges();
 
 #if defined(_X86_) || defined(_AMD64_)
@@ -1086,6 +1112,18 @@ Environment:
             MmFreedExpansionPoolMaximum = 100;
         }
 
+        // Servers that create a thread per connection delete and create threads at a high rate,
+        // so keep more dead kernel stacks per node on systems that can afford the resident memory.
+        if (MmNumberOfPhysicalPages > ((1000 * 1024 * 1024) / PAGE_SIZE)) {
+            if (MmProductType == 0x00690057) {
+                MmMaximumDeadKernelStacks = 16;
+            } else {
+                MmMaximumDeadKernelStacks = 64;
+            }
+        } else if (MmNumberOfPhysicalPages > ((255 * 1024 * 1024) / PAGE_SIZE)) {
+            MmMaximumDeadKernelStacks = 16;
+        }
+
         ASSERT(SharedUserData->NumberOfPhysicalPages == 0);
         SharedUserData->NumberOfPhysicalPages = (ULONG)MmNumberOfPhysicalPages;
         SharedUserData->LargePageMinimum = 0;
@@ -1467,6 +1505,7 @@ Environment:
         MiSessionWideInitializeAddresses();
         MiInitializeSessionWsSupport();
         MiInitializeSessionIds();
+        MiInitializeCompressedStore();
 
         // Start the modified page writer.
         InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
@@ -29,6 +29,143 @@ extern ULONG_PTR MmAllocatedPagedPool;
 
 SIZE_T MmSystemCommitReserve = (5 * 1024 * 1024) / PAGE_SIZE;
 
+// Each processor keeps a reserve of commitment already charged to MmTotalCommittedPages.
+// Small charges are taken from the reserve and small returns go back to it so that they don't all contend for the global counter.
+// MmTotalCommittedPages therefore includes the reserves, at most MI_COMMIT_RESERVE_MAXIMUM pages per processor.
+// The reserves are only refilled while commit is well below the limit and are drained back before a charge is failed,
+// so near the limit the accounting is exact.
+#define MI_COMMIT_RESERVE_CHUNK 64
+#define MI_COMMIT_RESERVE_MAXIMUM (2 * MI_COMMIT_RESERVE_CHUNK)
+
+typedef struct DECLSPEC_CACHEALIGN _MI_COMMIT_RESERVE {
+    SIZE_T Pages;
+} MI_COMMIT_RESERVE, *PMI_COMMIT_RESERVE;
+
+MI_COMMIT_RESERVE MiCommitReserves[MAXIMUM_PROCESSORS];
+
+// Commit must be below this for the reserves to be refilled or to take returns.
+#define MI_COMMIT_RESERVES_USABLE()                                              \
+    (MmTotalCommittedPages + MmSystemCommitReserve +                             \
+     (MI_COMMIT_RESERVE_MAXIMUM * (SIZE_T)KeNumberProcessors) < ((MmTotalCommitLimit / 10) * 9))
+
+#if defined(_WIN64)
+#define MI_COMPARE_EXCHANGE_COMMIT(Target, New, Old) (SIZE_T)InterlockedCompareExchange64((PLONGLONG)(Target), (LONGLONG)(New), (LONGLONG)(Old))
+#else
+#define MI_COMPARE_EXCHANGE_COMMIT(Target, New, Old) (SIZE_T)InterlockedCompareExchange((PLONG)(Target), (LONG)(New), (LONG)(Old))
+#endif
+
+
+LOGICAL MiChargeCommitmentFromReserve(IN SIZE_T QuotaCharge)
+/*
+Routine Description:
+    This routine charges commitment from the reserve of the current processor, refilling the reserve if it is empty and commit is well below the limit.
+    The reserve is updated with interlocked operations as the thread may be switched to another processor at any point, which only costs locality.
+Arguments:
+    QuotaCharge - Supplies the quota amount to charge, no more than MI_COMMIT_RESERVE_CHUNK.
+Return Value:
+    TRUE if the charge was taken from the reserve, FALSE if it must be charged to MmTotalCommittedPages.
+Environment:
+    Kernel mode, any IRQL at or below DISPATCH_LEVEL.
+*/
+{
+    PMI_COMMIT_RESERVE Reserve;
+    SIZE_T OldPages;
+    SIZE_T NewPages;
+    SIZE_T OldCommitValue;
+
+    ASSERT(QuotaCharge <= MI_COMMIT_RESERVE_CHUNK);
+
+    Reserve = &MiCommitReserves[KeGetCurrentProcessorNumber()];
+    OldPages = Reserve->Pages;
+    while (OldPages >= QuotaCharge) {
+        NewPages = MI_COMPARE_EXCHANGE_COMMIT(&Reserve->Pages, OldPages - QuotaCharge, OldPages);
+        if (NewPages == OldPages) {
+            return TRUE;
+        }
+
+        OldPages = NewPages;
+    }
+
+    // Charge a whole chunk globally, this charge comes out of it and the rest goes in the reserve.
+    do {
+        if (!MI_COMMIT_RESERVES_USABLE()) {
+            return FALSE;
+        }
+
+        OldCommitValue = MmTotalCommittedPages;
+    } while (MI_COMPARE_EXCHANGE_COMMIT(&MmTotalCommittedPages, OldCommitValue + MI_COMMIT_RESERVE_CHUNK, OldCommitValue) != OldCommitValue);
+
+    if (MmTotalCommittedPages > MmPeakCommitment) {
+        MmPeakCommitment = MmTotalCommittedPages;
+    }
+
+    InterlockedExchangeAddSizeT(&Reserve->Pages, MI_COMMIT_RESERVE_CHUNK - QuotaCharge);
+    return TRUE;
+}
+
+
+VOID FASTCALL MiReturnCommitmentToReserve(IN SIZE_T QuotaCharge)
+/*
+Routine Description:
+    This routine returns commitment, keeping small returns in the reserve of the current processor while commit is well below the limit.
+    Anything which doesn't fit in the reserve is returned to MmTotalCommittedPages.
+Arguments:
+    QuotaCharge - Supplies the quota amount to return.
+Environment:
+    Kernel mode, any IRQL at or below DISPATCH_LEVEL.
+*/
+{
+    PMI_COMMIT_RESERVE Reserve;
+    SIZE_T OldPages;
+    SIZE_T NewPages;
+
+    if ((QuotaCharge != 0) && (QuotaCharge <= MI_COMMIT_RESERVE_CHUNK) && (MI_COMMIT_RESERVES_USABLE())) {
+        Reserve = &MiCommitReserves[KeGetCurrentProcessorNumber()];
+        OldPages = Reserve->Pages;
+        while (OldPages + QuotaCharge <= MI_COMMIT_RESERVE_MAXIMUM) {
+            NewPages = MI_COMPARE_EXCHANGE_COMMIT(&Reserve->Pages, OldPages + QuotaCharge, OldPages);
+            if (NewPages == OldPages) {
+                return;
+            }
+
+            OldPages = NewPages;
+        }
+    }
+
+    ASSERT(MmTotalCommittedPages >= QuotaCharge);
+    InterlockedExchangeAddSizeT(&MmTotalCommittedPages, 0 - QuotaCharge);
+}
+
+
+LOGICAL MiDrainCommitReserves(VOID)
+/*
+Routine Description:
+    This routine returns the commit reserves of all the processors to MmTotalCommittedPages so that it is exact.
+Return Value:
+    TRUE if any commitment was returned, FALSE if the reserves were all empty.
+Environment:
+    Kernel mode, any IRQL at or below DISPATCH_LEVEL.
+*/
+{
+    SIZE_T Pages;
+    LOGICAL Drained;
+    ULONG i;
+
+    Drained = FALSE;
+    for (i = 0; i < (ULONG)KeNumberProcessors; i += 1) {
+        if (MiCommitReserves[i].Pages != 0) {
+            Pages = (SIZE_T)InterlockedExchangePointer((PVOID *)&MiCommitReserves[i].Pages, NULL);
+            if (Pages != 0) {
+                ASSERT(MmTotalCommittedPages >= Pages);
+                InterlockedExchangeAddSizeT(&MmTotalCommittedPages, 0 - Pages);
+                Drained = TRUE;
+            }
+        }
+    }
+
+    return Drained;
+}
+
 
 VOID MiInitializeCommitment(VOID)
 {
@@ -75,6 +212,11 @@ Environment:
     }
 #endif
 
+    if ((QuotaCharge <= MI_COMMIT_RESERVE_CHUNK) && (MiChargeCommitmentFromReserve(QuotaCharge))) {
+        MM_TRACK_COMMIT(MM_DBG_COMMIT_CHARGE_NORMAL, QuotaCharge);
+        return TRUE;
+    }
+
     // Initializing WsHeldSafe is not needed for correctness, but without it the compiler cannot compile this code W4 to check for use of uninitialized variables.
     WsHeldSafe = FALSE;
     WsHeldShared = FALSE;
@@ -82,6 +224,13 @@ Environment:
         OldCommitValue = MmTotalCommittedPages;
         NewCommitValue = OldCommitValue + QuotaCharge;
         while (NewCommitValue + MmSystemCommitReserve > MmTotalCommitLimit) {
+            // Give back what the processors hold in reserve before trying anything else.
+            if (MiDrainCommitReserves()) {
+                OldCommitValue = MmTotalCommittedPages;
+                NewCommitValue = OldCommitValue + QuotaCharge;
+                continue;
+            }
+
             // If the pagefiles are already at the maximum, then don't bother trying to extend them, but do trim the cache.
             if (MmTotalCommitLimit + 100 >= MmTotalCommitLimitMaximum) {
                 MiChargeCommitmentFailures[1] += 1;
@@ -188,6 +337,10 @@ Environment:
         OldCommitValue = ReadForWriteAccess(&MmTotalCommittedPages);
         NewCommitValue = OldCommitValue + QuotaCharge;
         if ((NewCommitValue > MmTotalCommitLimit) && (!MustSucceed)) {
+            if (MiDrainCommitReserves()) {
+                continue;
+            }
+
             if ((NewCommitValue < MmTotalCommittedPages) || (MmTotalCommitLimit + 100 >= MmTotalCommitLimitMaximum)) {
                 MiChargeCommitmentFailures[1] += 1;
                 MI_LOG_COMMIT_FAILURE(NewCommitValue, QuotaCharge);
@@ -252,6 +405,10 @@ Environment:
         OldCommitValue = ReadForWriteAccess(&MmTotalCommittedPages);
         NewCommitValue = OldCommitValue + QuotaCharge;
         if (NewCommitValue > MmTotalCommitLimit) {
+            if (MiDrainCommitReserves()) {
+                continue;
+            }
+
             return FALSE;
         }
 
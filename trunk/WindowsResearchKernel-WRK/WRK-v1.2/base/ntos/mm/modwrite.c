@@ -56,12 +56,31 @@ NTSTATUS MiLastModifiedWriteError;
 NTSTATUS MiLastMappedWriteError;
 
 // Keep separate counters for the mapped and modified writer threads.  This way they can both be read and updated without locks.
+// Several writer threads of each kind may update them at once, but they only choose write priorities so a lost update is harmless.
 
 #define MI_MAXIMUM_PRIORITY_BURST   32
 
 ULONG MiMappedWriteBurstCount;
 ULONG MiModifiedWriteBurstCount;
 
+// Write statistics. The statistics of each paging file and those of the mapped files each have a single writer at any time,
+// so they are updated without locks. The pages written in the current one second window are counted by all the writers.
+typedef struct _MI_WRITE_STATISTICS
+{
+    ULONGLONG PagesWritten;
+    ULONGLONG Writes;
+    ULONG ClusterHistogram[SYSTEM_WRITE_CLUSTER_HISTOGRAM];
+} MI_WRITE_STATISTICS, *PMI_WRITE_STATISTICS;
+
+MI_WRITE_STATISTICS MiPagingFileWriteStatistics[MAX_PAGE_FILES];
+MI_WRITE_STATISTICS MiMappedWriteStatistics;
+
+LONG MiWriteWindowPages;
+ULONG MiWriteWindowStart;
+ULONG MiPagesWrittenPerSecond;
+
+#define MI_WRITE_WINDOW (10 * 1000 * 1000)  // one second in 100ns units
+
 VOID MiClusterWritePages(IN PMMPFN Pfn1, IN PFN_NUMBER PageFrameIndex, IN PMM_WRITE_CLUSTER WriteCluster, IN ULONG Size);
 VOID MiExtendPagingFileMaximum(IN ULONG PageFileNumber, IN PRTL_BITMAP NewBitmap);
 SIZE_T MiAttemptPageFileExtension(IN ULONG PageFileNumber, IN SIZE_T SizeNeeded, IN LOGICAL Maximum);
@@ -75,6 +94,7 @@ NTSTATUS MiZeroPageFileFirstPage(IN PFILE_OBJECT File);
 #pragma alloc_text(PAGE,MiAttemptPageFileExtension)
 #pragma alloc_text(PAGE,MiExtendPagingFiles)
 #pragma alloc_text(PAGE,MiZeroPageFileFirstPage)
+#pragma alloc_text(PAGE,MmGetModifiedWriterInformation)
 #pragma alloc_text(PAGELK,MiModifiedPageWriter)
 #endif
 
@@ -82,8 +102,14 @@ NTSTATUS MiZeroPageFileFirstPage(IN PFILE_OBJECT File);
 extern POBJECT_TYPE IoFileObjectType;
 extern SIZE_T MmSystemCommitReserve;
 
-LIST_ENTRY MmMappedPageWriterList;
-KEVENT MmMappedPageWriterEvent;
+// Mapped file writes are queued to one of several mapped page writer threads chosen by the volume being written,
+// so that a file system blocking the writer of one volume doesn't hold up the writes to the other volumes.
+#define MI_MAPPED_PAGE_WRITERS 4
+
+MMMOD_WRITER_LISTHEAD MiMappedPageWriterQueue[MI_MAPPED_PAGE_WRITERS];
+
+#define MI_MAPPED_PAGE_WRITER_QUEUE(File) (&MiMappedPageWriterQueue[((ULONG_PTR)(File)->DeviceObject >> 4) % MI_MAPPED_PAGE_WRITERS])
+
 KEVENT MmMappedFileIoComplete;
 ULONG MmSystemShutdown;
 BOOLEAN MmSystemPageFileLocated;
@@ -216,6 +242,44 @@ Arguments:
 }
 
 
+VOID FORCEINLINE MiRecordWrite(IN PMI_WRITE_STATISTICS Statistics, IN PFN_NUMBER ClusterSize)
+/*
+Routine Description:
+    This routine accounts for a cluster write that is being issued.
+Arguments:
+    Statistics - Supplies the statistics of the paging file or of the mapped files being written.
+    ClusterSize - Supplies the number of pages in the write.
+Environment:
+    Kernel mode, the caller is the only writer of the statistics.
+*/
+{
+    ULONG Bucket;
+    ULONGLONG Elapsed;
+    LONG Pages;
+    LARGE_INTEGER TickCount;
+    ULONG WindowStart;
+
+    Statistics->PagesWritten += ClusterSize;
+    Statistics->Writes += 1;
+    Bucket = 0;
+    while ((Bucket < SYSTEM_WRITE_CLUSTER_HISTOGRAM - 1) && ((ClusterSize >> (Bucket + 1)) != 0)) {
+        Bucket += 1;
+    }
+    Statistics->ClusterHistogram[Bucket] += 1;
+
+    // The writer that closes a window publishes its rate and starts the next one.
+    InterlockedExchangeAdd(&MiWriteWindowPages, (LONG)ClusterSize);
+    KeQueryTickCount(&TickCount);
+    WindowStart = MiWriteWindowStart;
+    Elapsed = (ULONGLONG)(TickCount.LowPart - WindowStart) * KeMaximumIncrement;
+    if ((Elapsed >= MI_WRITE_WINDOW) &&
+        (InterlockedCompareExchange((PLONG)&MiWriteWindowStart, (LONG)TickCount.LowPart, (LONG)WindowStart) == (LONG)WindowStart)) {
+        Pages = InterlockedExchange(&MiWriteWindowPages, 0);
+        MiPagesWrittenPerSecond = (ULONG)(((ULONGLONG)Pages * MI_WRITE_WINDOW) / Elapsed);
+    }
+}
+
+
 NTSTATUS NtCreatePagingFile(__in PUNICODE_STRING PageFileName,
                             __in PLARGE_INTEGER MinimumSize,
                             __in PLARGE_INTEGER MaximumSize,
@@ -258,6 +322,8 @@ Arguments:
     SECURITY_DESCRIPTOR SecurityDescriptor;
     ULONG DaclLength;
     PACL Dacl;
+    HANDLE ThreadHandle;
+    OBJECT_ATTRIBUTES ObjectAttributes;
 
     DBG_UNREFERENCED_PARAMETER(Priority);
 
@@ -658,8 +724,9 @@ Arguments:
 
     if (NewPagingFile->Bitmap == NULL) {
         // Allocate pool failed.
-        ExFreePool(NewPagingFile->Entry[0]);
-        ExFreePool(NewPagingFile->Entry[1]);
+        for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
+            ExFreePool(NewPagingFile->Entry[i]);
+        }
         ExFreePool(NewPagingFile);
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto ErrorReturn3;
@@ -687,6 +754,23 @@ Arguments:
         NewPagingFile->BootPartition = 0;
     }
 
+    // Every paging file after the first gets a writer thread of its own so that writes to paging files on separate devices proceed in parallel.
+    // The modified page writer writes to the first paging file and to any paging file whose thread could not be created.
+    // N.B. The count is checked without the creation mutex. If files are created at the same time, more or fewer of them than need be
+    //      may get a thread, which is harmless.
+    if (MmNumberOfPagingFiles != 0) {
+        KeInitializeEvent(&NewPagingFile->WriterHeader.Event, NotificationEvent, FALSE);
+        InitializeListHead(&NewPagingFile->WriterHeader.ListHead);
+        InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+        Status = PsCreateSystemThread(&ThreadHandle, THREAD_ALL_ACCESS, &ObjectAttributes, 0L, NULL, MiPagingFileWriter, NewPagingFile);
+        if (NT_SUCCESS(Status)) {
+            ZwClose(ThreadHandle);
+            for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
+                NewPagingFile->Entry[i]->PagingListHead = &NewPagingFile->WriterHeader;
+            }
+        }
+    }
+
     // Acquire the global page file creation mutex.
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
     PageFileNumber = MmNumberOfPagingFiles;
@@ -1541,7 +1625,7 @@ Environment:
                     }
 
                     InsertTailList(&WriterEntry->PagingListHead->ListHead, &WriterEntry->Links);
-                    WriterEntry->CurrentList = &MmPagingFileHeader.ListHead;
+                    WriterEntry->CurrentList = &WriterEntry->PagingListHead->ListHead;
                     MmNumberOfActiveMdlEntries += 1;
                 }
 
@@ -1654,28 +1738,33 @@ Environment:
 */
 {
     ULONG i;
+    ULONG Queue;
     ULONG PageCount;
     PPFN_NUMBER Page;
     PLIST_ENTRY NextEntry;
+    PLIST_ENTRY ListHead;
     PMDL MemoryDescriptorList;
     PMMMOD_WRITER_MDL_ENTRY ModWriterEntry;
 
-    // Walk the MmMappedPageWriterList looking for an MDL which contains the argument page.  If found, remove it and cancel the write.
-    NextEntry = MmMappedPageWriterList.Flink;
-    while (NextEntry != &MmMappedPageWriterList) {
-        ModWriterEntry = CONTAINING_RECORD(NextEntry, MMMOD_WRITER_MDL_ENTRY, Links);
-        MemoryDescriptorList = &ModWriterEntry->Mdl;
-        PageCount = (MemoryDescriptorList->ByteCount >> PAGE_SHIFT);
-        Page = (PPFN_NUMBER)(MemoryDescriptorList + 1);
-        for (i = 0; i < PageCount; i += 1) {
-            if (*Page == PageToStop) {
-                RemoveEntryList(NextEntry);
-                goto CancelWrite;
+    // Walk the mapped page writer queues looking for an MDL which contains the argument page.  If found, remove it and cancel the write.
+    for (Queue = 0; Queue < MI_MAPPED_PAGE_WRITERS; Queue += 1) {
+        ListHead = &MiMappedPageWriterQueue[Queue].ListHead;
+        NextEntry = ListHead->Flink;
+        while (NextEntry != ListHead) {
+            ModWriterEntry = CONTAINING_RECORD(NextEntry, MMMOD_WRITER_MDL_ENTRY, Links);
+            MemoryDescriptorList = &ModWriterEntry->Mdl;
+            PageCount = (MemoryDescriptorList->ByteCount >> PAGE_SHIFT);
+            Page = (PPFN_NUMBER)(MemoryDescriptorList + 1);
+            for (i = 0; i < PageCount; i += 1) {
+                if (*Page == PageToStop) {
+                    RemoveEntryList(NextEntry);
+                    goto CancelWrite;
+                }
+                Page += 1;
             }
-            Page += 1;
-        }
 
-        NextEntry = NextEntry->Flink;
+            NextEntry = NextEntry->Flink;
+        }
     }
 
     return FALSE;
@@ -1746,19 +1835,22 @@ Environment:
     // Make this a real time thread.
     KeSetPriorityThread(KeGetCurrentThread(), LOW_REALTIME_PRIORITY + 1);
 
-    // Start a secondary thread for writing mapped file pages.
+    // Start the secondary threads for writing mapped file pages.
     // This is required as the writing of mapped file pages could cause page faults resulting in requests for free pages.
     // But there could be no free pages - hence a dead lock.
     // Rather than deadlock the whole system waiting on the modified page writer, 
-    // creating a secondary thread allows that thread to block without affecting on going page file writes.
-    KeInitializeEvent(&MmMappedPageWriterEvent, NotificationEvent, FALSE);
-    InitializeListHead(&MmMappedPageWriterList);
+    // creating secondary threads allows them to block without affecting on going page file writes.
+    // Each thread serves its own queue so that a volume that blocks its writer doesn't hold up the others.
     InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
-    Status = PsCreateSystemThread(&ThreadHandle, THREAD_ALL_ACCESS, &ObjectAttributes, 0L, NULL, MiMappedPageWriter, NULL);
-    if (!NT_SUCCESS(Status)) {
-        KeBugCheckEx(MEMORY_MANAGEMENT, 0x41288, Status, 0, 0);
+    for (i = 0; i < MI_MAPPED_PAGE_WRITERS; i += 1) {
+        KeInitializeEvent(&MiMappedPageWriterQueue[i].Event, NotificationEvent, FALSE);
+        InitializeListHead(&MiMappedPageWriterQueue[i].ListHead);
+        Status = PsCreateSystemThread(&ThreadHandle, THREAD_ALL_ACCESS, &ObjectAttributes, 0L, NULL, MiMappedPageWriter, &MiMappedPageWriterQueue[i]);
+        if (!NT_SUCCESS(Status)) {
+            KeBugCheckEx(MEMORY_MANAGEMENT, 0x41288, Status, i, 0);
+        }
+        ZwClose(ThreadHandle);
     }
-    ZwClose(ThreadHandle);
 
     MiModifiedPageWriterWorker();
 
@@ -2018,6 +2110,7 @@ Environment:
     PMMPFN Pfn1;
     PFN_NUMBER PageFrameIndex;
     PKPRCB Prcb;
+    PMMMOD_WRITER_LISTHEAD WriterQueue;
 
     PageFrameIndex = MmModifiedPageListHead.Flink;
     ASSERT(PageFrameIndex != MM_EMPTY_LIST);
@@ -2219,6 +2312,7 @@ Environment:
     Prcb = KeGetCurrentPrcb();
     Prcb->MmMappedWriteIoCount += 1;
     Prcb->MmMappedPagesWriteCount += (ULONG)PagesWritten;
+    MiRecordWrite(&MiMappedWriteStatistics, PagesWritten);
 
     // Increment the count of modified page writes outstanding in the control area.
     ControlArea->ModifiedWriteCount += 1;
@@ -2236,9 +2330,10 @@ Environment:
         return;
     }
 
-    // Send the entry to the MappedPageWriter.
-    InsertTailList(&MmMappedPageWriterList, &ModWriterEntry->Links);
-    KeSetEvent(&MmMappedPageWriterEvent, 0, FALSE);
+    // Send the entry to the MappedPageWriter for the volume.
+    WriterQueue = MI_MAPPED_PAGE_WRITER_QUEUE(ModWriterEntry->File);
+    InsertTailList(&WriterQueue->ListHead, &ModWriterEntry->Links);
+    KeSetEvent(&WriterQueue->Event, 0, FALSE);
     UNLOCK_PFN(OldIrql);
 }
 
@@ -2483,11 +2578,23 @@ Environment:
     // Release the PFN lock and wait for the write to complete.
     UNLOCK_PFN(OldIrql);
 
+    ModWriterEntry->Mdl.ByteCount = (ULONG)(ClusterSize * PAGE_SIZE);
+    KeQuerySystemTime(&ModWriterEntry->IssueTime);
+
+    // If the whole cluster fits in the compressed store then the write is complete without any I/O.
+    if (MiStoreCompressedPages(&ModWriterEntry->Mdl, CurrentPagingFile->PageFileNumber, (ULONG)(StartingOffset.QuadPart >> PAGE_SHIFT))) {
+        ModWriterEntry->u.IoStatus.Status = STATUS_SUCCESS;
+        ModWriterEntry->u.IoStatus.Information = ModWriterEntry->Mdl.ByteCount;
+        KeRaiseIrql(APC_LEVEL, &OldIrql);
+        MiWriteComplete((PVOID)ModWriterEntry, &ModWriterEntry->u.IoStatus, 0);
+        KeLowerIrql(OldIrql);
+        goto complete;
+    }
+
     Prcb = KeGetCurrentPrcb();
     InterlockedIncrement(&Prcb->MmDirtyWriteIoCount);
     InterlockedExchangeAdd(&Prcb->MmDirtyPagesWriteCount, (LONG)ClusterSize);
-    ModWriterEntry->Mdl.ByteCount = (ULONG)(ClusterSize * PAGE_SIZE);
-    KeQuerySystemTime(&ModWriterEntry->IssueTime);
+    MiRecordWrite(&MiPagingFileWriteStatistics[CurrentPagingFile->PageFileNumber], ClusterSize);
     IrpPriority = IoPagingPriorityNormal;
     if (MiModifiedWriteBurstCount != 0) {
         if (MmAvailablePages < MM_PLENTY_FREE_LIMIT) {
@@ -2526,6 +2633,7 @@ Environment:
         KeLowerIrql(OldIrql);
     }
 
+complete:
     if ((Bitmap != NULL) && (Bitmap != CurrentPagingFile->Bitmap)) {
         // The paging file has been extended so free the entry bitmap.
         MiRemoveBitMap(&Bitmap);
@@ -2546,8 +2654,9 @@ Routine Description:
     But there could be no free pages - hence a deadlock.
     Rather than deadlock the whole system waiting on the modified page writer, 
     creating a secondary thread allows that thread to block without affecting ongoing page file writes.
+    There is one of these threads for each mapped page writer queue.
 Arguments:
-    StartContext - not used.
+    StartContext - Supplies the mapped page writer queue served by this thread.
 Environment:
     Kernel mode.
 */
@@ -2558,8 +2667,9 @@ Environment:
     PETHREAD CurrentThread;
     IO_PAGING_PRIORITY IrpPriority;
     PMMMOD_WRITER_MDL_ENTRY ModWriterEntry;
+    PMMMOD_WRITER_LISTHEAD WriterQueue;
 
-    UNREFERENCED_PARAMETER(StartContext);
+    WriterQueue = (PMMMOD_WRITER_LISTHEAD)StartContext;
 
     // Make this a real time thread.
     CurrentThread = PsGetCurrentThread();
@@ -2570,15 +2680,15 @@ Environment:
     FsRtlSetTopLevelIrpForModWriter();
     KeInitializeEvent(&TempEvent, NotificationEvent, FALSE);
     while (TRUE) {
-        KeWaitForSingleObject(&MmMappedPageWriterEvent, WrVirtualMemory, KernelMode, FALSE, NULL);
+        KeWaitForSingleObject(&WriterQueue->Event, WrVirtualMemory, KernelMode, FALSE, NULL);
 
         LOCK_PFN(OldIrql);
 
-        if (IsListEmpty(&MmMappedPageWriterList)) {
-            KeClearEvent(&MmMappedPageWriterEvent);
+        if (IsListEmpty(&WriterQueue->ListHead)) {
+            KeClearEvent(&WriterQueue->Event);
             UNLOCK_PFN(OldIrql);
         } else {
-            ModWriterEntry = (PMMMOD_WRITER_MDL_ENTRY)RemoveHeadList(&MmMappedPageWriterList);
+            ModWriterEntry = (PMMMOD_WRITER_MDL_ENTRY)RemoveHeadList(&WriterQueue->ListHead);
 
             UNLOCK_PFN(OldIrql);
 
@@ -2634,6 +2744,128 @@ Environment:
 }
 
 
+VOID MiPagingFileWriter(IN PVOID StartContext)
+/*
+Routine Description:
+    Implements the writer thread of a paging file.
+    Every paging file after the first has one of these so that pages destined for paging files on separate devices are gathered and written in parallel.
+    The thread runs while the modified page writer event is set, and writes clusters to its own paging file using the MDLs of that file.
+    Since only this thread takes the MDLs of the file, at most one scan of the paging file bitmap is in progress at a time as before.
+Arguments:
+    StartContext - Supplies the paging file to write to.
+Environment:
+    Kernel mode.
+*/
+{
+    PRTL_BITMAP Bitmap;
+    KIRQL OldIrql;
+    LARGE_INTEGER Forever;
+    PMMPAGING_FILE PagingFile;
+    PMMMOD_WRITER_LISTHEAD WriterHeader;
+    PMMMOD_WRITER_MDL_ENTRY ModWriterEntry;
+
+    PagingFile = (PMMPAGING_FILE)StartContext;
+    WriterHeader = &PagingFile->WriterHeader;
+
+    // Make this a real time thread.
+    KeSetPriorityThread(KeGetCurrentThread(), LOW_REALTIME_PRIORITY + 1);
+    PsGetCurrentThread()->MemoryMaker = 1;
+
+    for (;;) {
+        KeWaitForSingleObject(&MmModifiedPageWriterEvent, WrFreePage, KernelMode, FALSE, NULL);
+
+        LOCK_PFN(OldIrql);
+
+        if (MmSystemShutdown) {
+            // Shutdown has returned.  Stop writing to this paging file.
+            UNLOCK_PFN(OldIrql);
+            break;
+        }
+
+        if ((MiFirstPageFileCreatedAndReady == FALSE) ||
+            (MmTotalPagesForPagingFile == 0) ||
+            ((MmTotalPagesForPagingFile < MmModifiedWriteClusterSize) && (MmWriteAllModifiedPages == 0))) {
+            // There are not enough pages destined for the paging files to fill a cluster, leave them to the modified page writer for now.
+            UNLOCK_PFN(OldIrql);
+            KeDelayExecutionThread(KernelMode, FALSE, (PLARGE_INTEGER)&MmShortTime);
+            continue;
+        }
+
+        if (IsListEmpty(&WriterHeader->ListHead)) {
+            // Reset the event indicating no MDLs of this paging file in the list, drop the PFN lock and wait for an I/O operation to complete.
+            KeClearEvent(&WriterHeader->Event);
+            UNLOCK_PFN(OldIrql);
+            KeWaitForSingleObject(&WriterHeader->Event, WrPageOut, KernelMode, FALSE, (PLARGE_INTEGER)&Mm30Milliseconds);
+            continue;
+        }
+
+        ModWriterEntry = (PMMMOD_WRITER_MDL_ENTRY)RemoveHeadList(&WriterHeader->ListHead);
+#if DBG
+        ModWriterEntry->Links.Flink = MM_IO_IN_PROGRESS;
+#endif
+        // Increment the reference count under PFN lock protection.
+        ASSERT(ModWriterEntry->PagingFile == PagingFile);
+        ASSERT(PagingFile->ReferenceCount == 0);
+        PagingFile->ReferenceCount += 1;
+        Bitmap = PagingFile->Bitmap;
+        UNLOCK_PFN(OldIrql);
+        MiGatherPagefilePages(ModWriterEntry, Bitmap);
+    }
+
+    // System has shutdown, go into LONG wait.
+    Forever.LowPart = 0;
+    Forever.HighPart = 0xF000000;
+    KeDelayExecutionThread(KernelMode, FALSE, &Forever);
+}
+
+
+NTSTATUS MmGetModifiedWriterInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length)
+/*
+Routine Description:
+    This routine returns the write statistics of the modified and mapped page writers.
+Arguments:
+    SystemInformation - Returns the modified writer information.
+    SystemInformationLength - Supplies the length of the SystemInformation buffer.
+    Length - Returns the length of the information placed in the buffer.
+Return Value:
+    Returns the status of the operation.
+Environment:
+    Kernel mode, PASSIVE_LEVEL. The buffer has been probed and the caller handles exceptions.
+*/
+{
+    ULONG i;
+    ULONG NumberOfPagingFiles;
+    LARGE_INTEGER TickCount;
+    PSYSTEM_MODIFIED_WRITER_INFORMATION WriterInfo;
+
+    PAGED_CODE();
+
+    NumberOfPagingFiles = MmNumberOfPagingFiles;
+    *Length = FIELD_OFFSET(SYSTEM_MODIFIED_WRITER_INFORMATION, PagingFile) + NumberOfPagingFiles * sizeof(SYSTEM_WRITE_STATISTICS);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    WriterInfo = (PSYSTEM_MODIFIED_WRITER_INFORMATION)SystemInformation;
+
+    // The rate is only published when a write closes a window, so report no writes if none closed one lately.
+    KeQueryTickCount(&TickCount);
+    if ((ULONGLONG)(TickCount.LowPart - MiWriteWindowStart) * KeMaximumIncrement < 2 * MI_WRITE_WINDOW) {
+        WriterInfo->PagesWrittenPerSecond = MiPagesWrittenPerSecond;
+    } else {
+        WriterInfo->PagesWrittenPerSecond = 0;
+    }
+
+    WriterInfo->NumberOfPagingFiles = NumberOfPagingFiles;
+    RtlCopyMemory(&WriterInfo->MappedFiles, &MiMappedWriteStatistics, sizeof(SYSTEM_WRITE_STATISTICS));
+    for (i = 0; i < NumberOfPagingFiles; i += 1) {
+        RtlCopyMemory(&WriterInfo->PagingFile[i], &MiPagingFileWriteStatistics[i], sizeof(SYSTEM_WRITE_STATISTICS));
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
 BOOLEAN MmDisableModifiedWriteOfSection(__in PSECTION_OBJECT_POINTERS SectionObjectPointer)
 /*
 Routine Description:
@@ -2823,24 +3055,28 @@ Return Value:
     KIRQL OldIrql;
     SIZE_T FreeSpace;
     SIZE_T MaximumSize;
+    PMMMOD_WRITER_LISTHEAD WriterHeader;
 
     LOCK_PFN(OldIrql);
 
     MmNumberOfPagingFiles += 1;
 
-    if (IsListEmpty(&MmPagingFileHeader.ListHead)) {
-        KeSetEvent(&MmPagingFileHeader.Event, 0, FALSE);
+    // The MDLs go on the list of the thread that writes to this paging file.
+    WriterHeader = MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[0]->PagingListHead;
+    if (IsListEmpty(&WriterHeader->ListHead)) {
+        KeSetEvent(&WriterHeader->Event, 0, FALSE);
     }
 
     for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
-        InsertTailList(&MmPagingFileHeader.ListHead, &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->Links);
-        MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->CurrentList = &MmPagingFileHeader.ListHead;
+        ASSERT(MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->PagingListHead == WriterHeader);
+        InsertTailList(&WriterHeader->ListHead, &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->Links);
+        MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->CurrentList = &WriterHeader->ListHead;
     }
 
     FreeSpace = MmPagingFile[MmNumberOfPagingFiles - 1]->FreeSpace;
     MaximumSize = MmPagingFile[MmNumberOfPagingFiles - 1]->MaximumSize;
     MmPagingFile[MmNumberOfPagingFiles - 1]->ReferenceCount = 0;
-    MmNumberOfActiveMdlEntries += 2;
+    MmNumberOfActiveMdlEntries += MM_PAGING_FILE_MDLS;
     UNLOCK_PFN(OldIrql);
 
     // Increase the systemwide commit limit maximum first.  Then increase the current limit.
@@ -54,7 +54,7 @@ MiResolveProtoPteFault(
 );
 
 VOID MiHandleBankedSection(IN PVOID VirtualAddress, IN PMMVAD Vad);
-NTSTATUS MiResolveMappedFileFault(IN PMMPTE PointerPte, IN PMMINPAGE_SUPPORT *ReadBlock, IN PEPROCESS Process, IN KIRQL OldIrql);
+NTSTATUS MiResolveMappedFileFault(IN PVOID FaultingAddress, IN PMMPTE PointerPte, IN PMMINPAGE_SUPPORT *ReadBlock, IN PEPROCESS Process, IN KIRQL OldIrql);
 NTSTATUS MiResolveTransitionFault(IN PVOID FaultingAddress, IN PMMPTE PointerPte, IN PEPROCESS Process, IN KIRQL OldIrql, OUT PMMINPAGE_SUPPORT *InPageBlock);
 
 NTSTATUS
@@ -67,8 +67,13 @@ MiCompleteProtoPteFault(
     IN OUT PMMPFN *LockedProtoPfn
 );
 
+VOID MiFaultAroundImagePtes(IN PVOID VirtualAddress, IN PMMPTE PointerPte, IN PMMPTE PointerProtoPte, IN PEPROCESS Process, IN PMMVAD Vad);
+
 ULONG MmMaxTransitionCluster = 8;
 
+// The maximum number of PTEs (including the faulting one) that a soft fault on an image view makes valid.
+ULONG MmMaxFaultAroundCluster = 16;
+
 
 NTSTATUS MiDispatchFault(
     IN ULONG_PTR FaultStatus,
@@ -630,6 +635,12 @@ Environment:
         ReadPte = PointerProtoPte;
         ASSERT(KeGetCurrentIrql() <= APC_LEVEL);
         ASSERT(KeAreAllApcsDisabled() == TRUE);
+
+        // Image views are not transition clustered above since each page takes its protection from its own prototype PTE.
+        // Map the neighboring image pages that are already resident now that the faulting page is valid.
+        if ((status == STATUS_SUCCESS) && (VirtualAddress <= MM_HIGHEST_USER_ADDRESS) && (MmMaxFaultAroundCluster > 1)) {
+            MiFaultAroundImagePtes(VirtualAddress, PointerPte, PointerProtoPte, Process, Vad);
+        }
     } else {
     NonProtoFault:
         TempPte = *PointerPte;
@@ -728,8 +739,20 @@ Environment:
         // Assert no reads issued here are marked as prefetched.
         ASSERT(ReadBlock->u1.e1.PrefetchMdlHighBits == 0);
 
-        // Issue the read request.
-        status = IoPageRead(ReadBlock->FilePointer, &ReadBlock->Mdl, &ReadBlock->ReadOffset, &ReadBlock->Event, &ReadBlock->IoStatus);
+        // Issue the read request, or fill the page from the compressed store.
+        if (ReadBlock->u1.e1.Compressed) {
+            status = MiReadCompressedPage(&ReadBlock->Mdl,
+                                          GET_PAGING_FILE_NUMBER(ReadBlock->Pfn->OriginalPte),
+                                          GET_PAGING_FILE_OFFSET(ReadBlock->Pfn->OriginalPte),
+                                          &ReadBlock->IoStatus);
+            ASSERT(status != STATUS_NOT_FOUND);
+            if (NT_SUCCESS(status)) {
+                KeSetEvent(&ReadBlock->Event, 0, FALSE);
+            }
+        } else {
+            status = IoPageRead(ReadBlock->FilePointer, &ReadBlock->Mdl, &ReadBlock->ReadOffset, &ReadBlock->Event, &ReadBlock->IoStatus);
+        }
+
         if (!NT_SUCCESS(status)) {
             // Set the event as the I/O system doesn't set it on errors.
             ReadBlock->IoStatus.Status = status;
@@ -833,6 +856,17 @@ Environment:
                 LOCK_WORKING_SET(WsThread, SessionWs);
             }
 
+            // The faulting thread paid for the read even though the fault did not complete, so log it too.
+            // ByteCount is what was actually transferred, which is zero for a failed read.
+            if (VariousFlags & VARIOUS_FLAGS_LOG_HARD_FAULT) {
+                HardFaultEvent.ReadOffset = ReadBlock->ReadOffset;
+                HardFaultEvent.VirtualAddress = VirtualAddress;
+                HardFaultEvent.FileObject = ReadBlock->FilePointer;
+                HardFaultEvent.ThreadId = HandleToUlong(WsThread->Cid.UniqueThread);
+                HardFaultEvent.ByteCount = (ULONG)ReadBlock->IoStatus.Information;
+                PerfInfoLogBytes(PERFINFO_LOG_TYPE_HARDFAULT, &HardFaultEvent, sizeof(HardFaultEvent));
+            }
+
             MiFreeInPageSupportBlock(CapturedEvent);
 
             if (status == STATUS_PTE_CHANGED) {
@@ -1031,7 +1065,7 @@ Environment:
     if ((MmAvailablePages >= MM_HIGH_LIMIT) || (!MiEnsureAvailablePageOrWait(Process, OldIrql))) {
         if (PageColor != 0xFFFFFFFF) {
             // This page is for a user process and so must be zeroed.
-            PageFrameIndex = MiRemoveZeroPageIfAny(PageColor);
+            PageFrameIndex = MiRemoveCachedZeroPage(PageColor);
             if (PageFrameIndex) {
                 // This barrier check is needed after zeroing the page and before setting the PTE valid.
                 // Note since the PFN database entry is used to hold the sequence timestamp, it must be captured now.
@@ -1370,6 +1404,12 @@ Environment:
         } else {
             MiUnlinkPageFromList(Pfn1);
 
+            // A page that is used again from a transition list has shown that it is not read only once,
+            // so it gets at least the priority of this thread. This must be done while the page is off the lists.
+            if (MI_GET_PFN_PRIORITY(Pfn1) < MI_GET_THREAD_PFN_PRIORITY(PsGetCurrentThread())) {
+                MI_SET_PFN_PRIORITY(Pfn1, MI_GET_THREAD_PFN_PRIORITY(PsGetCurrentThread()));
+            }
+
             // Update the PFN database - the reference count must be incremented as the share count is going to go from zero to 1.
             ASSERT(Pfn1->u2.ShareCount == 0);
 
@@ -1456,6 +1496,34 @@ Environment:
 }
 
 
+FORCEINLINE ULONG MiGetVadAccessHint(IN PVOID FaultingAddress, IN PEPROCESS Process)
+/*
+Routine Description:
+    This routine returns the access pattern advised with MEM_ADVISE for the user allocation or view containing a faulting address.
+Arguments:
+    FaultingAddress - Supplies the faulting address.
+    Process - Supplies the process argument of the fault, NULL or HYDRA_PROCESS for system and session space.
+Return Value:
+    One of the MI_VAD_ACCESS_* values.
+Environment:
+    Kernel mode, working set pushlock held.
+*/
+{
+    PMMVAD Vad;
+
+    if ((Process == NULL) || (Process == HYDRA_PROCESS) || (FaultingAddress > MM_HIGHEST_USER_ADDRESS)) {
+        return MI_VAD_ACCESS_NORMAL;
+    }
+
+    Vad = MiLocateAddress(FaultingAddress);
+    if (Vad == NULL) {
+        return MI_VAD_ACCESS_NORMAL;
+    }
+
+    return (ULONG)Vad->u.VadFlags.AccessHint;
+}
+
+
 NTSTATUS MiResolvePageFileFault(
     IN PVOID FaultingAddress,
     IN PMMPTE PointerPte,
@@ -1511,6 +1579,7 @@ Environment:
     MMPTE ComparePte;
     PMMINPAGE_SUPPORT ReadBlockLocal;
     PETHREAD CurrentThread;
+    ULONG AccessHint;
     PMMVAD Vad;
     NTSTATUS Status;
     PKPRCB Prcb;
@@ -1560,6 +1629,12 @@ Environment:
     ClusterSize = MmClusterPageFileReads;
     ASSERT(ClusterSize <= MM_MAXIMUM_READ_CLUSTER_SIZE);
 
+    // A page in the compressed store is brought back by itself from the store.
+    if (MiIsPageCompressed(GET_PAGING_FILE_NUMBER(TempPte), GET_PAGING_FILE_OFFSET(TempPte))) {
+        ReadBlockLocal->u1.e1.Compressed = 1;
+        ClusterSize = 0;
+    }
+
     if (MiInPageSinglePages != 0) {
         MiInPageSinglePages -= 1;
     } else if ((ClusterSize > 1) && (MmAvailablePages > MM_PLENTY_FREE_LIMIT)) {
@@ -1603,8 +1678,14 @@ Environment:
             }
         }
 
+        // Pages advised as randomly accessed are read by themselves and sequentially accessed pages are only clustered forward.
+        AccessHint = MiGetVadAccessHint(FaultingAddress, Process);
+        if (AccessHint == MI_VAD_ACCESS_RANDOM) {
+            ClusterSize = 0;
+        }
+
         CurrentThread = PsGetCurrentThread();
-        if (CurrentThread->ForwardClusterOnly) {
+        if ((CurrentThread->ForwardClusterOnly) || (AccessHint == MI_VAD_ACCESS_SEQUENTIAL)) {
             MaxBackwardPageCount = 0;
             if (MaxForwardPageCount == 0) {
                 // This PTE is the last one in the page table page and no backwards clustering is enabled for this thread so no clustering can be done.
@@ -1629,6 +1710,11 @@ Environment:
                     break;
                 }
 
+                // The paging file does not hold the pages kept in the compressed store.
+                if (MiIsPageCompressed(GET_PAGING_FILE_NUMBER(ComparePte), GET_PAGING_FILE_OFFSET(ComparePte))) {
+                    break;
+                }
+
                 ForwardPageCount -= 1;
                 CheckPte += 1;
             }
@@ -1654,6 +1740,10 @@ Environment:
                     break;
                 }
 
+                if (MiIsPageCompressed(GET_PAGING_FILE_NUMBER(ComparePte), GET_PAGING_FILE_OFFSET(ComparePte))) {
+                    break;
+                }
+
                 BackwardPageCount -= 1;
             }
 
@@ -1927,7 +2017,7 @@ done:
 
     if (TempPte.u.Soft.Prototype == 1) {
         // Mapped File.
-        status = MiResolveMappedFileFault(PointerProtoPte, ReadBlock, Process, OldIrql);
+        status = MiResolveMappedFileFault(FaultingAddress, PointerProtoPte, ReadBlock, Process, OldIrql);
         if (status == STATUS_ISSUE_PAGING_IO) {
             *CapturedPteContents = *PointerProtoPte;
             ASSERT(CapturedPteContents->u.Hard.Valid == 0);
@@ -1989,6 +2079,209 @@ done:
 }
 
 
+VOID MiFaultAroundImagePtes(IN PVOID VirtualAddress, IN PMMPTE PointerPte, IN PMMPTE PointerProtoPte, IN PEPROCESS Process, IN PMMVAD Vad)
+/*
+Routine Description:
+    This routine makes valid the PTEs following a resolved fault in an image view whose prototype PTEs refer to pages that are already resident,
+    either valid or in transition on the standby or modified lists.
+    This saves the process a soft fault on each of these pages, which matters most while an image is starting up.
+    Each page is mapped with the protection in its own prototype PTE, so only PTEs that take their protection from the prototype PTE are considered.
+    The pages are only mapped for read in the sense that nothing is marked dirty, a write to them faults or sets the dirty bit as usual.
+    N.B. Mapping these pages is purely optional, so the scan stops at the first PTE that is not trivially resolved.
+Arguments:
+    VirtualAddress - Supplies the faulting address.
+    PointerPte - Supplies the PTE for the faulting address, which is now valid.
+    PointerProtoPte - Supplies the prototype PTE for the faulting address.
+    Process - Supplies a pointer to the process object.
+    Vad - Supplies the VAD for the faulting address if the caller has it, NULL if not.
+Environment:
+    Kernel mode, APCs disabled, working set pushlock held.
+*/
+{
+    ULONG_PTR i;
+    ULONG_PTR MaxProtos;
+    ULONG_PTR NumberOfProtos;
+    KIRQL OldIrql;
+    PMMPTE CheckPte;
+    PMMPTE NextPte;
+    PMMPTE NextProtoPte;
+    MMPTE NewPteContents;
+    MMPTE ProtoPteContents;
+    MMPTE TempPte;
+    PFN_NUMBER PageFrameIndex;
+    PMMPFN Pfn1;
+    PMMPFN Pfn2;
+    MM_PROTECTION_MASK Protection;
+    PVOID UsedPageTableHandle;
+    WSLE_NUMBER WorkingSetIndex;
+
+    ASSERT(VirtualAddress <= MM_HIGHEST_USER_ADDRESS);
+
+    if ((Process <= PREFETCH_PROCESS) ||
+        (Process->CloneRoot != NULL) ||
+        (MmAvailablePages <= MM_ENORMOUS_LIMIT) ||
+        ((Process->Vm.Flags.MaximumWorkingSetHard != 0) && (Process->Vm.WorkingSetSize + MmMaxFaultAroundCluster > Process->Vm.MaximumWorkingSetSize))) {
+        return;
+    }
+
+    if (PointerPte->u.Hard.Valid == 0) {
+        return;
+    }
+
+    if (Vad == NULL) {
+        Vad = MiLocateAddress(VirtualAddress);
+        if (Vad == NULL) {
+            return;
+        }
+    }
+
+    if ((Vad->u.VadFlags.VadType != VadImageMap) || (PointerProtoPte > Vad->LastContiguousPte)) {
+        return;
+    }
+
+    NumberOfProtos = MmMaxFaultAroundCluster;
+
+    // Ensure the cluster doesn't cross the VAD contiguous PTE limits.
+    MaxProtos = Vad->LastContiguousPte - PointerProtoPte + 1;
+    if (NumberOfProtos > MaxProtos) {
+        NumberOfProtos = MaxProtos;
+    }
+
+    // Ensure the cluster doesn't cross the page table page.
+    MaxProtos = (PAGE_SIZE - BYTE_OFFSET(PointerPte)) / sizeof(MMPTE);
+    if (NumberOfProtos > MaxProtos) {
+        NumberOfProtos = MaxProtos;
+    }
+
+    // Ensure the cluster doesn't cross the page containing the prototype PTEs as only that page is checked for residency below.
+    MaxProtos = (PAGE_SIZE - BYTE_OFFSET(PointerProtoPte)) / sizeof(MMPTE);
+    if (NumberOfProtos > MaxProtos) {
+        NumberOfProtos = MaxProtos;
+    }
+
+    // Ensure the cluster doesn't cross the VAD limits.
+    MaxProtos = Vad->EndingVpn - MI_VA_TO_VPN(VirtualAddress) + 1;
+    if (NumberOfProtos > MaxProtos) {
+        NumberOfProtos = MaxProtos;
+    }
+
+    // Ensure enough WSLEs are available so we cannot fail to insert the cluster later.
+    MaxProtos = 1;
+    WorkingSetIndex = MmWorkingSetList->FirstFree;
+    if ((NumberOfProtos > 1) && (WorkingSetIndex != WSLE_NULL_INDEX)) {
+        do {
+            if (MmWsle[WorkingSetIndex].u1.Long == (WSLE_NULL_INDEX << MM_FREE_WSLE_SHIFT)) {
+                break;
+            }
+            MaxProtos += 1;
+            WorkingSetIndex = (WSLE_NUMBER)(MmWsle[WorkingSetIndex].u1.Long >> MM_FREE_WSLE_SHIFT);
+        } while (MaxProtos < NumberOfProtos);
+    }
+
+    if (NumberOfProtos > MaxProtos) {
+        NumberOfProtos = MaxProtos;
+    }
+
+    if (NumberOfProtos <= 1) {
+        return;
+    }
+
+    UsedPageTableHandle = MI_GET_USED_PTES_HANDLE(VirtualAddress);
+    Pfn2 = MI_PFN_ELEMENT(MiGetPteAddress(PointerPte)->u.Hard.PageFrameNumber);
+    CheckPte = MiGetPteAddress(PointerProtoPte);
+
+    // Acquire the PFN lock to synchronize access to prototype PTEs and make sure the page of prototype PTEs is still resident.
+    LOCK_PFN(OldIrql);
+    if (CheckPte->u.Hard.Valid == 0) {
+        UNLOCK_PFN(OldIrql);
+        return;
+    }
+
+    for (i = 1; i < NumberOfProtos; i += 1) {
+        NextPte = PointerPte + i;
+        NextProtoPte = PointerProtoPte + i;
+
+        // The PTE must either be untouched or refer to the prototype PTE for its protection.
+        TempPte = *NextPte;
+        if ((TempPte.u.Long != MM_ZERO_PTE) && (TempPte.u.Long != MiProtoAddressForPte(NextProtoPte))) {
+            break;
+        }
+
+        ProtoPteContents = *NextProtoPte;
+        if (ProtoPteContents.u.Hard.Valid == 1) {
+            PageFrameIndex = MI_GET_PAGE_FRAME_FROM_PTE(&ProtoPteContents);
+            Pfn1 = MI_PFN_ELEMENT(PageFrameIndex);
+        } else if ((ProtoPteContents.u.Soft.Prototype == 0) && (ProtoPteContents.u.Soft.Transition == 1)) {
+            PageFrameIndex = MI_GET_PAGE_FRAME_FROM_TRANSITION_PTE(&ProtoPteContents);
+            Pfn1 = MI_PFN_ELEMENT(PageFrameIndex);
+            ASSERT(Pfn1->u3.e1.PageLocation != ActiveAndValid);
+            if ((Pfn1->u3.e1.ReadInProgress == 1) || (Pfn1->u4.InPageError == 1) || (MmAvailablePages < MM_HIGH_LIMIT)) {
+                break;
+            }
+        } else {
+            break;
+        }
+
+        // Only plain protections are mapped, anything with guard, no access or caching modifiers is left to a real fault.
+        Protection = (MM_PROTECTION_MASK)MI_GET_PROTECTION_FROM_SOFT_PTE(&Pfn1->OriginalPte);
+        if ((Protection == MM_ZERO_ACCESS) || ((Protection & ~MM_PROTECTION_OPERATION_MASK) != 0)) {
+            break;
+        }
+
+        if (ProtoPteContents.u.Hard.Valid == 1) {
+            Pfn1->u2.ShareCount += 1;
+        } else {
+            // Make the prototype PTE valid exactly as a transition fault on it would.
+            MiUnlinkPageFromList(Pfn1);
+            ASSERT(Pfn1->u2.ShareCount == 0);
+            InterlockedIncrementPfn((PSHORT)&Pfn1->u3.e2.ReferenceCount);
+            Pfn1->u2.ShareCount += 1;
+            Pfn1->u3.e1.PageLocation = ActiveAndValid;
+            MI_MAKE_TRANSITION_PROTOPTE_VALID(ProtoPteContents, NextProtoPte);
+            if ((Pfn1->u3.e1.Modified) && (ProtoPteContents.u.Hard.Write) && (ProtoPteContents.u.Hard.CopyOnWrite == 0)) {
+                MI_SET_PTE_DIRTY(ProtoPteContents);
+            } else {
+                MI_SET_PTE_CLEAN(ProtoPteContents);
+            }
+
+            MI_WRITE_VALID_PTE(NextProtoPte, ProtoPteContents);
+        }
+
+        Pfn1->u3.e1.PrototypePte = 1;
+
+        // A PTE just went from not present, not transition to present.
+        // The share count and valid count must be updated in the page table page which contains this PTE.
+        Pfn2->u2.ShareCount += 1;
+        if (TempPte.u.Long == MM_ZERO_PTE) {
+            MI_INCREMENT_USED_PTES_BY_HANDLE(UsedPageTableHandle);
+        }
+
+        // Ensure the user's attributes do not conflict with the PFN attributes.
+        if (Pfn1->u3.e1.CacheAttribute == MiNonCached) {
+            Protection |= MM_NOCACHE;
+        } else if (Pfn1->u3.e1.CacheAttribute == MiWriteCombined) {
+            Protection |= MM_WRITECOMBINE;
+        }
+
+        MI_MAKE_VALID_USER_PTE(NewPteContents, PageFrameIndex, Protection, NextPte);
+        MI_WRITE_VALID_PTE(NextPte, NewPteContents);
+    }
+
+    UNLOCK_PFN(OldIrql);
+
+    // Add working set entries for the pages that were mapped.
+    // Note because we checked the WSLE list above (and the working set pushlock has never been released), the insertions below cannot fail.
+    NumberOfProtos = i;
+    for (i = 1; i < NumberOfProtos; i += 1) {
+        NextPte = PointerPte + i;
+        ASSERT(NextPte->u.Hard.Valid == 1);
+        Pfn1 = MI_PFN_ELEMENT(MI_GET_PAGE_FRAME_FROM_PTE(NextPte));
+        WorkingSetIndex = MiAllocateWsle(&Process->Vm, NextPte, Pfn1, 0);
+        ASSERT(WorkingSetIndex != 0);
+    }
+}
+
+
 NTSTATUS MiCompleteProtoPteFault(
     IN ULONG_PTR StoreInstruction,
     IN PVOID FaultingAddress,
@@ -2203,11 +2496,12 @@ Environment:
 }
 
 
-NTSTATUS MiResolveMappedFileFault(IN PMMPTE PointerPte, OUT PMMINPAGE_SUPPORT *ReadBlock, IN PEPROCESS Process, IN KIRQL OldIrql)
+NTSTATUS MiResolveMappedFileFault(IN PVOID FaultingAddress, IN PMMPTE PointerPte, OUT PMMINPAGE_SUPPORT *ReadBlock, IN PEPROCESS Process, IN KIRQL OldIrql)
 /*
 Routine Description:
     This routine builds the MDL and other structures to allow a read operation on a mapped file for a page fault.
 Arguments:
+    FaultingAddress - Supplies the faulting address.
     PointerPte - Supplies the PTE for the faulting address.
     ReadBlock - Supplies a pointer to put the address of the read block which needs to be completed before an I/O can be issued.
     Process - Supplies a pointer to the process object.
@@ -2240,8 +2534,11 @@ Environment:
     PFN_NUMBER AvailablePages;
     NTSTATUS Status;
     PKPRCB Prcb;
+    LOGICAL AdaptCluster;
+    ULONG AccessHint;
 
     ClusterSize = 0;
+    AdaptCluster = FALSE;
 
     ASSERT(PointerPte->u.Soft.Prototype == 1);
 
@@ -2303,6 +2600,35 @@ Environment:
             if (ControlArea->u.Flags.Image == 0) {
                 ASSERT(CurrentThread->ReadClusterSize <= MM_MAXIMUM_READ_CLUSTER_SIZE);
                 ClusterSize = CurrentThread->ReadClusterSize;
+
+                // User views of data files adapt the cluster to the access pattern of the section.
+                // A read that starts where the last one ended is sequential and doubles the cluster, any other read halves it
+                // so that random faulters end up reading single pages. System cache faults keep the read ahead the cache manager asked for.
+                // A view advised with MEM_ADVISE skips the adaptation and reads single pages or the largest cluster right away.
+                AccessHint = MiGetVadAccessHint(FaultingAddress, Process);
+                if (AccessHint == MI_VAD_ACCESS_RANDOM) {
+                    ClusterSize = 0;
+                } else if (AccessHint == MI_VAD_ACCESS_SEQUENTIAL) {
+                    ClusterSize = MM_MAXIMUM_READ_CLUSTER_SIZE;
+                } else if ((Process != NULL) && (Process != HYDRA_PROCESS)) {
+                    AdaptCluster = TRUE;
+                    if (ControlArea->NextSequentialPte == NULL) {
+                        NOTHING;
+                    } else if (PointerPte == ControlArea->NextSequentialPte) {
+                        ControlArea->ReadAheadHits += ControlArea->LastReadAhead;
+                        if (ClusterSize < ControlArea->ReadAheadCluster) {
+                            ClusterSize = ControlArea->ReadAheadCluster;
+                        }
+                        ClusterSize = ClusterSize * 2 + 1;
+                        if (ClusterSize > MM_MAXIMUM_READ_CLUSTER_SIZE) {
+                            ClusterSize = MM_MAXIMUM_READ_CLUSTER_SIZE;
+                        }
+                    } else {
+                        ClusterSize = ControlArea->ReadAheadCluster / 2;
+                    }
+
+                    ControlArea->ReadAheadCluster = (USHORT)ClusterSize;
+                }
             } else {
                 ClusterSize = MmDataClusterSize;
                 if (Subsection->u.SubsectionFlags.Protection & MM_PROTECTION_EXECUTE_MASK) {
@@ -2339,6 +2665,12 @@ Environment:
         }
     }
 
+    if (AdaptCluster) {
+        ControlArea->NextSequentialPte = BasePte + (ReadSize >> PAGE_SHIFT);
+        ControlArea->LastReadAhead = (USHORT)((ReadSize >> PAGE_SHIFT) - 1);
+        ControlArea->ReadAheadPages += ControlArea->LastReadAhead;
+    }
+
     // Calculate the offset to read into the file.
     //  offset = base + ((thispte - basepte) << PAGE_SHIFT)
     StartingOffset.QuadPart = MiStartingOffset(Subsection, BasePte);
@@ -3289,6 +3621,7 @@ Environment:
     }
 
     Pfn1->u4.InPageError = 0;
+    MI_SET_PFN_PRIORITY(Pfn1, MI_GET_THREAD_PFN_PRIORITY(PsGetCurrentThread()));
 
     // Determine the page frame number of the page table page which contains this PTE.
     PteFramePointer = MiGetPteAddress(BasePte);
@@ -3340,12 +3673,14 @@ Environment:
     MM_PROTECTION_MASK Protection;
     MI_PFN_CACHE_ATTRIBUTE NewCacheAttribute;
     LOGICAL TbFlushNeeded;
+    ULONG Priority;
 
     TbFlushNeeded = FALSE;
     PteFramePage = 0;
     PteFramePointer = 0;
     SATISFY_OVERZEALOUS_COMPILER(NewCacheAttribute = MiCached);
     MM_PFN_LOCK_ASSERT();
+    Priority = MI_GET_THREAD_PFN_PRIORITY(PsGetCurrentThread());
     Page = (PPFN_NUMBER)(Mdl + 1);
     NumberOfBytes = Mdl->ByteCount;
     while (NumberOfBytes > 0) {
@@ -3372,6 +3707,7 @@ Environment:
             Pfn1->u3.e1.CacheAttribute = NewCacheAttribute;
         }
         Pfn1->u4.InPageError = 0;
+        MI_SET_PFN_PRIORITY(Pfn1, Priority);
         if ((PteFramePage == 0) || (MiIsPteOnPdeBoundary(BasePte))) {
             // Determine the page frame number of the page table page which contains this PTE.
             if (PteFramePage == 0) {
@@ -173,7 +173,8 @@ Environment:
         if (!MmFrontOfList) {
             MiInsertPageInList(&MmStandbyPageListHead, PageFrameIndex);
         } else {
-            MiInsertStandbyListAtFront(PageFrameIndex);
+            // The cache manager is done with these pages, so make them the first to be repurposed.
+            MiInsertStandbyListAtFront(PageFrameIndex, MI_LOW_PFN_PRIORITY);
         }
     }
 }
@@ -49,6 +49,12 @@ MM_LDW_WORK_CONTEXT MiLastChanceLdwContext;
 ULONG MiAvailablePagesEventLowSets;
 ULONG MiAvailablePagesEventHighSets;
 
+MI_PAGE_CACHE MiPageCaches[MAXIMUM_PROCESSORS];
+PFN_NUMBER MiCachedZeroPages;
+
+// A processor cache is only refilled while this many pages would remain available afterwards.
+#define MI_PAGE_CACHE_REFILL_LIMIT (MmMinimumFreePages + MM_HIGH_LIMIT + MI_PAGE_CACHE_DEPTH)
+
 extern ULONG MmSystemShutdown;
 extern NTSTATUS MiLastModifiedWriteError;
 extern NTSTATUS MiLastMappedWriteError;
@@ -176,6 +182,7 @@ Environment:
     Pfn1->u1.Flink = MM_EMPTY_LIST;
     Pfn1->u2.Blink = last;
     Pfn1->u3.e1.PageLocation = ListName;
+    MI_NOTE_PFN_LIST(PageFrameIndex, ListName);
     Pfn1->u4.InPageError = 0;
     Pfn1->u4.AweAllocation = 0;
 
@@ -310,7 +317,7 @@ Environment:
     ASSERT(Pfn1->u3.e2.ReferenceCount == 0);
     ASSERT(Pfn1->u3.e1.Rom != 1);
     if (ListHead == &MmStandbyPageListHead) {
-        ListHead = &MmStandbyPageListByPriority[Pfn1->u4.Priority];
+        ListHead = MI_STANDBY_LIST_FOR_PFN(Pfn1);
         ASSERT(ListHead->ListName == ListName);
     }
 
@@ -382,6 +389,7 @@ Environment:
     }
 
     Pfn1->u3.e1.PageLocation = ListName;
+    MI_NOTE_PFN_LIST(PageFrameIndex, ListName);
 
     // If the page was placed on the standby or zeroed list, update the count of usable pages in the system.
     // If the count transitions from 0 to 1, the event associated with available pages should become true.
@@ -526,6 +534,7 @@ Environment:
     Pfn1->u1.Flink = MM_EMPTY_LIST;
     Pfn1->u2.Blink = last;
     Pfn1->u3.e1.PageLocation = ListName;
+    MI_NOTE_PFN_LIST(PageFrameIndex, ListName);
     if (ListHead == &MmBadPageListHead) {
         return;
     }
@@ -585,12 +594,13 @@ Environment:
 }
 
 
-VOID FASTCALL MiInsertStandbyListAtFront(IN PFN_NUMBER PageFrameIndex)
+VOID FASTCALL MiInsertStandbyListAtFront(IN PFN_NUMBER PageFrameIndex, IN ULONG Priority)
 /*
 Routine Description:
     This procedure inserts a page at the front of the standby list.
 Arguments:
     PageFrameIndex - Supplies the physical page number to insert in the list.
+    Priority - Supplies the highest priority the page may keep. A page of a higher priority is lowered to this one.
 Environment:
     PFN lock held.
 */
@@ -641,7 +651,11 @@ Environment:
     ASSERT(Pfn1->u3.e1.Rom != 1);
 
     MmTransitionSharedPages += 1;
-    ListHead = &MmStandbyPageListByPriority[Pfn1->u4.Priority];
+    if (MI_GET_PFN_PRIORITY(Pfn1) > Priority) {
+        MI_SET_PFN_PRIORITY(Pfn1, Priority);
+    }
+
+    ListHead = MI_STANDBY_LIST_FOR_PFN(Pfn1);
     ListHead->Total += 1;  // One more page on the list.
     first = ListHead->Flink;
     if (first == MM_EMPTY_LIST) {
@@ -655,6 +669,7 @@ Environment:
     Pfn1->u2.Blink = MM_EMPTY_LIST;
     Pfn1->u1.Flink = first;
     Pfn1->u3.e1.PageLocation = StandbyPageList;
+    MI_NOTE_PFN_LIST(PageFrameIndex, StandbyPageList);
 
     // If the page was placed on the free, standby or zeroed list, update the count of usable pages in the system.
     // If the count transitions from 0 to 1, the event associated with available pages should become true.
@@ -680,6 +695,52 @@ Environment:
 }
 
 
+PFN_NUMBER FASTCALL MiRemoveStandbyPage(IN ULONG Color)
+/*
+Routine Description:
+    This procedure repurposes a page from the standby lists.
+    The page comes from the lowest priority that has any standby pages.
+    Within that priority the pages of the node of the requested color are preferred so that the page is local to the processors that will use it.
+Arguments:
+    Color - Supplies the page color for which this page is destined.
+Return Value:
+    The physical page number removed from the standby lists.
+Environment:
+    Must be holding the PFN database lock. The caller has checked that there are standby pages.
+*/
+{
+    PMMPFNLIST ListHead;
+    ULONG Node;
+    ULONG Priority;
+    ULONG i;
+
+    MM_PFN_LOCK_ASSERT();
+
+#if defined(MI_MULTINODE)
+    Node = Color >> MmSecondaryColorNodeShift;
+#else
+    UNREFERENCED_PARAMETER(Color);
+    Node = 0;
+#endif
+
+    for (Priority = 0; Priority < MI_PFN_PRIORITIES; Priority += 1) {
+        ListHead = MI_STANDBY_LIST(Priority, Node);
+        if (ListHead->Total != 0) {
+            return MiRemovePageFromList(ListHead);
+        }
+
+        for (i = 0; i < MI_STANDBY_NODES; i += 1) {
+            ListHead = MI_STANDBY_LIST(Priority, i);
+            if (ListHead->Total != 0) {
+                return MiRemovePageFromList(ListHead);
+            }
+        }
+    }
+
+    KeBugCheckEx(PFN_LIST_CORRUPT, 1, (ULONG_PTR)&MmStandbyPageListHead, MmAvailablePages, 0);
+}
+
+
 PFN_NUMBER FASTCALL MiRemovePageFromList(IN PMMPFNLIST ListHead)
 /*
 Routine Description:
@@ -724,6 +785,7 @@ Environment:
     // Zero the flink and blink in the PFN database element.
     Pfn1->u1.Flink = 0;         // Assumes Flink width is >= WsIndex width
     Pfn1->u2.Blink = 0;
+    MI_NOTE_PFN_UNLINKED(PageFrameIndex);
 
     // If the last page was removed (the ListHead->Flink is now MM_EMPTY_LIST) make the Listhead->Blink MM_EMPTY_LIST as well.
     if (ListHead->Flink != MM_EMPTY_LIST) {
@@ -820,7 +882,7 @@ Environment:
     ASSERT(ListHead->ListName >= StandbyPageList);
     if (ListHead == &MmStandbyPageListHead) {
         ASSERT(Pfn->u3.e1.Rom == 0);
-        ListHead = &MmStandbyPageListByPriority[Pfn->u4.Priority];
+        ListHead = MI_STANDBY_LIST_FOR_PFN(Pfn);
         // Signal if allocating this page caused a threshold cross.
         if (MmAvailablePages == MmHighMemoryThreshold) {
             KeClearEvent(MiHighMemoryEvent);
@@ -876,6 +938,7 @@ Environment:
 
     Pfn->u1.Flink = 0;         // Assumes Flink width is >= WsIndex width
     Pfn->u2.Blink = 0;
+    MI_NOTE_PFN_UNLINKED(MI_PFN_ELEMENT_TO_INDEX(Pfn));
     ListHead->Total -= 1;
 }
 
@@ -952,6 +1015,7 @@ Environment:
 
     Pfn->u1.Flink = 0;         // Assumes Flink width is >= WsIndex width
     Pfn->u2.Blink = 0;
+    MI_NOTE_PFN_UNLINKED(Page);
     ASSERT(ColorHead->Count >= 1);
     ColorHead->Count -= 1;
 
@@ -1201,6 +1265,14 @@ Environment:
         return FALSE;
     }
 
+    // Put the pages cached by the processors back before waiting for pages.
+    if (MiCachedZeroPages != 0) {
+        MiDrainPageCaches();
+        if (MmAvailablePages >= MM_HIGH_LIMIT) {
+            return FALSE;
+        }
+    }
+
     // If this thread has explicitly disabled APCs (FsRtlEnterFileSystem does this), then it may be holding resources or mutexes that may in turn be blocking memory making threads from making progress.
     // We'd like to detect this but cannot (without changing the FsRtlEnterFileSystem macro) since other components (win32k for example) also enter critical regions and then access paged pool.
     // At least give system threads a free pass as they may be worker threads processing potentially blocking items drivers have queued.
@@ -1302,7 +1374,6 @@ Environment:
     PFN_NUMBER Page;
     PMMPFN Pfn1;
     PMMCOLOR_TABLES FreePagesByColor;
-    PMMPFNLIST ListHead;
 #if MI_BARRIER_SUPPORTED
     ULONG BarrierStamp;
 #endif
@@ -1446,14 +1517,7 @@ Environment:
     ASSERT(MmFreePageListHead.Total == 0);
 
     // Remove a page from the standby list and restore the original contents of the PTE to free the last reference to the physical page.
-    for (ListHead = &MmStandbyPageListByPriority[0]; ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES]; ListHead += 1) {
-        if (ListHead->Total != 0) {
-            Page = MiRemovePageFromList(ListHead);
-            break;
-        }
-    }
-
-    ASSERT(ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES]);
+    Page = MiRemoveStandbyPage(Color);
     ASSERT((MI_PFN_ELEMENT(Page))->u4.PteFrame != MI_MAGIC_AWE_PTEFRAME);
     MmStandbyRePurposed += 1;
 
@@ -1475,6 +1539,104 @@ ZeroPage:
 }
 
 
+PFN_NUMBER FASTCALL MiRemoveCachedZeroPage(IN ULONG Color)
+/*
+Routine Description:
+    This procedure returns a zeroed page from the page cache of the current processor if there is one,
+    refilling the cache from the zeroed lists when it is empty.
+    The refill takes a batch of pages of the consecutive colors following the requested color,
+    so the cache hands out the colors a process asks for as its page color advances.
+Arguments:
+    Color - Supplies the page color for which this page is destined.
+Return Value:
+    The physical page number of a zeroed page, or zero if no zeroed page is available.
+    The zero return leaves the caller to take any page and zero it, as for MiRemoveZeroPageIfAny.
+Environment:
+    Must be holding the PFN database lock.
+*/
+{
+    PMI_PAGE_CACHE Cache;
+    ULONG CachedColor;
+    ULONG Count;
+    PFN_NUMBER Page;
+    PFN_NUMBER Batch[MI_PAGE_CACHE_DEPTH];
+    ULONG i;
+
+    MM_PFN_LOCK_ASSERT();
+
+    // The PFN lock keeps this thread on the current processor while the cache is used.
+    Cache = &MiPageCaches[KeGetCurrentProcessorNumber()];
+    if (Cache->Count != 0) {
+        Page = Cache->Page[Cache->Count - 1];
+
+#if defined(MI_MULTINODE)
+        // Pages of another node are left in the cache for the processes that prefer that node.
+        if (MI_PFN_ELEMENT(Page)->u3.e1.PageColor != (Color >> MmSecondaryColorNodeShift)) {
+            return MiRemoveZeroPageIfAny(Color);
+        }
+#endif
+
+        Cache->Count -= 1;
+        MiCachedZeroPages -= 1;
+        return Page;
+    }
+
+    if (MmAvailablePages < MI_PAGE_CACHE_REFILL_LIMIT) {
+        return MiRemoveZeroPageIfAny(Color);
+    }
+
+    // Take zeroed pages of the requested color and the colors after it, stopping at the first color that has none.
+    Count = 0;
+    for (i = 0; i < MI_PAGE_CACHE_DEPTH; i += 1) {
+        CachedColor = (Color & ~MmSecondaryColorMask) | ((Color + i) & MmSecondaryColorMask);
+        if (MmFreePagesByColor[ZeroedPageList][CachedColor].Flink == MM_EMPTY_LIST) {
+            break;
+        }
+
+        Batch[Count] = MiRemoveZeroPage(CachedColor);
+        Count += 1;
+    }
+
+    if (Count == 0) {
+        return MiRemoveZeroPageIfAny(Color);
+    }
+
+    // Hand out the first page now and stack the rest so that they come back in color order.
+    for (i = 1; i < Count; i += 1) {
+        Cache->Page[Count - 1 - i] = Batch[i];
+    }
+
+    Cache->Count = Count - 1;
+    MiCachedZeroPages += Count - 1;
+    return Batch[0];
+}
+
+
+VOID MiDrainPageCaches(VOID)
+/*
+Routine Description:
+    This procedure returns the pages cached by all the processors to the zeroed list so that they are available again.
+Environment:
+    Must be holding the PFN database lock.
+*/
+{
+    PMI_PAGE_CACHE Cache;
+    ULONG Index;
+
+    MM_PFN_LOCK_ASSERT();
+    for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+        Cache = &MiPageCaches[Index];
+        while (Cache->Count != 0) {
+            Cache->Count -= 1;
+            MiCachedZeroPages -= 1;
+            MiInsertPageInList(&MmZeroedPageListHead, Cache->Page[Cache->Count]);
+        }
+    }
+
+    ASSERT(MiCachedZeroPages == 0);
+}
+
+
 PFN_NUMBER FASTCALL MiRemoveAnyPage(IN ULONG Color)
 /*
 Routine Description:
@@ -1502,7 +1664,6 @@ Environment:
 */
 {
     PFN_NUMBER Page;
-    PMMPFNLIST ListHead;
 #if DBG
     PMMPFN Pfn1;
 #endif
@@ -1611,15 +1772,7 @@ Environment:
     ASSERT(MmZeroedPageListHead.Total == 0);
 
     // No pages exist on the free or zeroed list, use the standby list.
-    SATISFY_OVERZEALOUS_COMPILER(Page = MM_EMPTY_LIST);
-    for (ListHead = &MmStandbyPageListByPriority[0]; ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES]; ListHead += 1) {
-        if (ListHead->Total != 0) {
-            Page = MiRemovePageFromList(ListHead);
-            break;
-        }
-    }
-
-    ASSERT(ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES]);
+    Page = MiRemoveStandbyPage(Color);
     ASSERT((MI_PFN_ELEMENT(Page))->u4.PteFrame != MI_MAGIC_AWE_PTEFRAME);
     MmStandbyRePurposed += 1;
 
@@ -1701,6 +1854,7 @@ Environment:
     Pfn1->u3.e1.CacheAttribute = CacheAttribute;
     Pfn1->u1.Flink = 0;         // Assumes Flink width is >= WsIndex width
     Pfn1->u2.Blink = 0;
+    MI_NOTE_PFN_UNLINKED(Page);
 
     // Update the color lists.
     ASSERT(Color < MmSecondaryColors);
@@ -1831,7 +1985,7 @@ VOID MiPurgeTransitionList(VOID)
     PMMPFNLIST ListHead;
 
     // Run the transition list and free all the entries so transition faults are not satisfied for any of the non modified pages that were freed.
-    for (ListHead = &MmStandbyPageListByPriority[0]; ListHead < &MmStandbyPageListByPriority[MI_PFN_PRIORITIES]; ListHead += 1) {
+    for (ListHead = &MmStandbyPageListByPriority[0]; ListHead < &MmStandbyPageListByPriority[MI_STANDBY_LISTS]; ListHead += 1) {
         if (ListHead->Total == 0) {
             continue;
         }
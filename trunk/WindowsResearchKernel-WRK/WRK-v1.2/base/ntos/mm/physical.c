@@ -56,6 +56,7 @@ NTSTATUS MiCaptureUlongPtrArray(OUT PVOID Destination, IN PVOID Source, IN ULONG
 #pragma alloc_text(PAGE,MiAweViewRemover)
 #pragma alloc_text(PAGE,MiReleasePhysicalCharges)
 #pragma alloc_text(PAGE,MmSetPhysicalPagesLimit)
+#pragma alloc_text(PAGE,MmGetAweMapInformation)
 #pragma alloc_text(PAGELK,MiAllocateLargeZeroPages)
 #endif
 
@@ -80,6 +81,68 @@ extern ULONG MiShowStuckPages;
 
 #define MI_WRITE_ZERO_PTE_NO_LOGGING(PointerPte)    PointerPte->u.Long = 0
 
+// Counters for the AWE map calls, kept per processor so the remap path never shares a cache line.
+// The counters are updated without interlocks and a thread preempted in the middle of an update may lose a count.
+#define MI_AWE_MAP_LATENCY_BUCKETS 16
+#define MI_AWE_MAP_LATENCY_SHIFT 10
+
+typedef struct _MI_AWE_MAP_STATISTICS {
+    ULONG64 Calls;
+    ULONG64 PagesMapped;
+    ULONG64 PagesUnmapped;
+    ULONG64 TbFlushes;
+    ULONG64 Cycles;
+    ULONG Latency[MI_AWE_MAP_LATENCY_BUCKETS];
+} MI_AWE_MAP_STATISTICS, *PMI_AWE_MAP_STATISTICS;
+
+DECLSPEC_CACHEALIGN MI_AWE_MAP_STATISTICS MiAweMapStatistics[MAXIMUM_PROCESSORS];
+
+#if defined(_AMD64_)
+#define MI_READ_CYCLE_COUNTER() ReadTimeStampCounter()
+#else
+ULONG64 __rdtsc(VOID);
+#pragma intrinsic(__rdtsc)
+#define MI_READ_CYCLE_COUNTER() __rdtsc()
+#endif
+
+
+FORCEINLINE VOID MiRecordAweMap(IN ULONG64 StartTime, IN ULONG_PTR PagesMapped, IN ULONG_PTR PagesUnmapped, IN LOGICAL TbFlushed)
+/*
+Routine Description:
+    This routine counts a completed AWE map call in the current processor's statistics.
+Arguments:
+    StartTime - Supplies the cycle counter value read when the call started.
+    PagesMapped - Supplies the number of frames mapped by the call.
+    PagesUnmapped - Supplies the number of valid mappings the call replaced or removed.
+    TbFlushed - Supplies TRUE if the call flushed the TB.
+*/
+{
+    ULONG Index;
+    ULONG64 Cycles;
+    PMI_AWE_MAP_STATISTICS Statistics;
+
+    Cycles = MI_READ_CYCLE_COUNTER() - StartTime;
+    Statistics = &MiAweMapStatistics[KeGetCurrentProcessorNumber()];
+    Statistics->Calls += 1;
+    Statistics->PagesMapped += PagesMapped;
+    Statistics->PagesUnmapped += PagesUnmapped;
+    Statistics->Cycles += Cycles;
+    if (TbFlushed) {
+        Statistics->TbFlushes += 1;
+    }
+
+    Cycles >>= MI_AWE_MAP_LATENCY_SHIFT;
+    if (Cycles == 0) {
+        Index = 0;
+    } else if (Cycles >= ((ULONG64)1 << (MI_AWE_MAP_LATENCY_BUCKETS - 1))) {
+        Index = MI_AWE_MAP_LATENCY_BUCKETS - 1;
+    } else {
+        BitScanReverse(&Index, (ULONG)Cycles);
+    }
+
+    Statistics->Latency[Index] += 1;
+}
+
 
 NTSTATUS NtMapUserPhysicalPages(__in PVOID VirtualAddress, __in ULONG_PTR NumberOfPages, __in_ecount_opt(NumberOfPages) PULONG_PTR UserPfnArray)
 /*
@@ -120,9 +183,14 @@ Return Value:
     PEX_PUSH_LOCK PushLock;
     PETHREAD CurrentThread;
     TABLE_SEARCH_RESULT SearchResult;
+    ULONG64 StartTime;
+    ULONG_PTR PagesUnmapped;
 
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
 
+    StartTime = MI_READ_CYCLE_COUNTER();
+    PagesUnmapped = 0;
+
     if (NumberOfPages > (MAXULONG_PTR / PAGE_SIZE)) {
         return STATUS_INVALID_PARAMETER_2;
     }
@@ -306,6 +374,7 @@ Return Value:
                 ASSERT(Pfn1->u2.ShareCount == 1);
                 ASSERT(MI_PFN_IS_AWE(Pfn1));
                 InterlockedZeroPointer(Pfn1->PteAddress);
+                PagesUnmapped += 1;
                 if (PteFlushList.Count != MM_MAXIMUM_FLUSH_COUNT) {
                     PteFlushList.FlushVa[PteFlushList.Count] = VirtualAddress;
                     PteFlushList.Count += 1;
@@ -338,6 +407,7 @@ Return Value:
                 ASSERT(Pfn1->PteAddress != NULL);
                 ASSERT(Pfn1->u2.ShareCount == 1);
                 InterlockedZeroPointer(Pfn1->PteAddress);
+                PagesUnmapped += 1;
                 if (PteFlushList.Count != MM_MAXIMUM_FLUSH_COUNT) {
                     PteFlushList.FlushVa[PteFlushList.Count] = VirtualAddress;
                     PteFlushList.Count += 1;
@@ -356,6 +426,7 @@ Return Value:
     // Note this can be done without holding the AWE pushlock because the PTEs have already been filled so any concurrent (bogus) map/unmap call will see the right entries.
     // AND any free of the physical pages will also see the right
     // entries (although the free must do a TB flush while holding the AWE pushlock exclusive to ensure no thread gets to continue using a stale mapping to the page being freed prior to the flush below).
+    MiRecordAweMap(StartTime, ARGUMENT_PRESENT(UserPfnArray) ? NumberOfPages : 0, PagesUnmapped, PteFlushList.Count != 0);
     if (PteFlushList.Count != 0) {
         MiFlushPteList(&PteFlushList);
     }
@@ -435,9 +506,16 @@ Return Value:
     PEX_PUSH_LOCK PushLock;
     PETHREAD CurrentThread;
     TABLE_SEARCH_RESULT SearchResult;
+    ULONG64 StartTime;
+    ULONG_PTR PagesMapped;
+    ULONG_PTR PagesUnmapped;
 
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
 
+    StartTime = MI_READ_CYCLE_COUNTER();
+    PagesMapped = 0;
+    PagesUnmapped = 0;
+
     if (NumberOfPages > (MAXULONG_PTR / PAGE_SIZE)) {
         return STATUS_INVALID_PARAMETER_2;
     }
@@ -667,6 +745,7 @@ Return Value:
             if (PageFrameIndex != 0) {
                 NewPteContents = NewPteContents0;
                 NewPteContents.u.Hard.PageFrameNumber = PageFrameIndex;
+                PagesMapped += 1;
             } else {
                 NewPteContents.u.Long = 0;
             }
@@ -694,6 +773,7 @@ Return Value:
                 ASSERT(Pfn1->u2.ShareCount == 1);
                 ASSERT(MI_PFN_IS_AWE(Pfn1));
                 InterlockedZeroPointer(Pfn1->PteAddress);
+                PagesUnmapped += 1;
                 if (PteFlushList.Count != MM_MAXIMUM_FLUSH_COUNT) {
                     PteFlushList.FlushVa[PteFlushList.Count] = VirtualAddress;
                     PteFlushList.Count += 1;
@@ -724,6 +804,7 @@ Return Value:
                 ASSERT(Pfn1->u2.ShareCount == 1);
                 ASSERT(MI_PFN_IS_AWE(Pfn1));
                 InterlockedZeroPointer(Pfn1->PteAddress);
+                PagesUnmapped += 1;
                 if (PteFlushList.Count != MM_MAXIMUM_FLUSH_COUNT) {
                     PteFlushList.FlushVa[PteFlushList.Count] = VirtualAddress;
                     PteFlushList.Count += 1;
@@ -741,6 +822,7 @@ Return Value:
     // Note this can be done without holding the AWE pushlock because the PTEs have already been filled so any concurrent (bogus) map/unmap call will see the right entries.
     // AND any free of the physical pages will also see the right entries (although the free must do a TB flush while holding the AWE pushlock exclusive to ensure no thread gets to continue using a
     // stale mapping to the page being freed prior to the flush below).
+    MiRecordAweMap(StartTime, PagesMapped, PagesUnmapped, PteFlushList.Count != 0);
     if (PteFlushList.Count != 0) {
         MiFlushPteList(&PteFlushList);
     }
@@ -772,6 +854,52 @@ ErrorReturn0:
 }
 
 
+NTSTATUS MmGetAweMapInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length)
+/*
+Routine Description:
+    This routine returns the AWE map counters summed over all the processors.
+Arguments:
+    SystemInformation - Returns the AWE map information.
+    SystemInformationLength - Supplies the length of the SystemInformation buffer.
+    Length - Returns the length of the information placed in the buffer.
+Return Value:
+    Returns the status of the operation.
+Environment:
+    Kernel mode, PASSIVE_LEVEL. The buffer has been probed and the caller handles exceptions.
+*/
+{
+    ULONG i;
+    ULONG j;
+    PMI_AWE_MAP_STATISTICS Statistics;
+    SYSTEM_AWE_MAP_INFORMATION AweMapInfo;
+
+    PAGED_CODE();
+
+    C_ASSERT(SYSTEM_AWE_MAP_LATENCY_BUCKETS == MI_AWE_MAP_LATENCY_BUCKETS);
+
+    *Length = sizeof(SYSTEM_AWE_MAP_INFORMATION);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    RtlZeroMemory(&AweMapInfo, sizeof(AweMapInfo));
+    for (i = 0; i < (ULONG)KeNumberProcessors; i += 1) {
+        Statistics = &MiAweMapStatistics[i];
+        AweMapInfo.Calls += Statistics->Calls;
+        AweMapInfo.PagesMapped += Statistics->PagesMapped;
+        AweMapInfo.PagesUnmapped += Statistics->PagesUnmapped;
+        AweMapInfo.TbFlushes += Statistics->TbFlushes;
+        AweMapInfo.Cycles += Statistics->Cycles;
+        for (j = 0; j < MI_AWE_MAP_LATENCY_BUCKETS; j += 1) {
+            AweMapInfo.Latency[j] += Statistics->Latency[j];
+        }
+    }
+
+    RtlCopyMemory(SystemInformation, &AweMapInfo, sizeof(AweMapInfo));
+    return STATUS_SUCCESS;
+}
+
+
 PVOID MiAllocateAweInfo(VOID)
 /*
 Routine Description:
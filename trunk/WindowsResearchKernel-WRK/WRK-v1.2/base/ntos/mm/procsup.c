@@ -1381,6 +1381,7 @@ Environment:
     PVOID TempVa;
     KIRQL OldIrql;
     MMPTE_FLUSH_LIST PteFlushList;
+    MI_FLUSH_GATHER FlushGather;
     PFN_NUMBER CommittedPages;
     PEPROCESS Process;
     BOOLEAN AllProcessors;
@@ -1412,6 +1413,9 @@ Environment:
     SATISFY_OVERZEALOUS_COMPILER(PteFlushList.FlushVa[0] = NULL);
     PointerPde = MiGetPteAddress(PointerPte);
 
+    // The PTEs of a process are flushed together once the whole range is deleted, the page table pages included.
+    MiInitializeFlushGather(&FlushGather, 0);
+
     LOCK_PFN(OldIrql);
 
 #if (_MI_PAGING_LEVELS >= 3)
@@ -1431,7 +1435,7 @@ Environment:
             ASSERT(PointerPte->u.Hard.Valid == 1);
             TempVa = MiGetVirtualAddressMappedByPte(PointerPte);
             if (Process != NULL) {
-                MiDeletePte(PointerPte, TempVa, AddressSpaceDeletion, Process, NULL, &PteFlushList, OldIrql);
+                MiDeletePte(PointerPte, TempVa, AddressSpaceDeletion, Process, NULL, &FlushGather, OldIrql);
                 Process->NumberOfPrivatePages += 1;
             } else {
                 MiDeleteValidSystemPte(PointerPte, TempVa, WsInfo, &PteFlushList);
@@ -1463,7 +1467,7 @@ Environment:
             }
 
             if ((Boundary == TRUE) || (FinalPte == TRUE)) {
-                if (PteFlushList.Count == 0) {
+                if ((Process != NULL) || (PteFlushList.Count == 0)) {
                     NOTHING;
                 } else if (PteFlushList.Count == 1) {
                     MI_FLUSH_SINGLE_TB(PteFlushList.FlushVa[0], AllProcessors);
@@ -1482,7 +1486,7 @@ Environment:
                 Pfn1 = MI_PFN_ELEMENT(MI_GET_PAGE_FRAME_FROM_PTE(PointerPde));
                 if ((Pfn1->u2.ShareCount == 1) && (Pfn1->u3.e2.ReferenceCount == 1) && (Pfn1->u1.WsIndex != 0)) {
                     if (Process != NULL) {
-                        MiDeletePte(PointerPde, PointerPte - 1, AddressSpaceDeletion, Process, NULL, NULL, OldIrql);
+                        MiDeletePte(PointerPde, PointerPte - 1, AddressSpaceDeletion, Process, NULL, &FlushGather, OldIrql);
                         Process->NumberOfPrivatePages += 1;
                     } else {
                         MiDeleteValidSystemPte(PointerPde, PointerPte - 1, WsInfo, &PteFlushList);
@@ -1497,7 +1501,7 @@ Environment:
                         Pfn1 = MI_PFN_ELEMENT(MI_GET_PAGE_FRAME_FROM_PTE(PointerPpe));
                         if (Pfn1->u2.ShareCount == 1 && Pfn1->u3.e2.ReferenceCount == 1) {
                             if (Process != NULL) {
-                                MiDeletePte(PointerPpe, PointerPde, AddressSpaceDeletion, Process, NULL, NULL, OldIrql);
+                                MiDeletePte(PointerPpe, PointerPde, AddressSpaceDeletion, Process, NULL, &FlushGather, OldIrql);
                                 Process->NumberOfPrivatePages += 1;
                             } else {
                                 MiDeleteValidSystemPte(PointerPpe, PointerPde, WsInfo, &PteFlushList);
@@ -1511,7 +1515,7 @@ Environment:
                                 Pfn1 = MI_PFN_ELEMENT(MI_GET_PAGE_FRAME_FROM_PTE(PointerPxe));
                                 if (Pfn1->u2.ShareCount == 1 && Pfn1->u3.e2.ReferenceCount == 1) {
                                     if (Process != NULL) {
-                                        MiDeletePte(PointerPxe, PointerPpe, AddressSpaceDeletion, Process, NULL, NULL, OldIrql);
+                                        MiDeletePte(PointerPxe, PointerPpe, AddressSpaceDeletion, Process, NULL, &FlushGather, OldIrql);
                                         Process->NumberOfPrivatePages += 1;
                                     } else {
                                         MiDeleteValidSystemPte(PointerPxe, PointerPpe, WsInfo, &PteFlushList);
@@ -1546,7 +1550,9 @@ Environment:
         }
     }
 
+    MiFlushGather(&FlushGather);
     UNLOCK_PFN(OldIrql);
+    MiFreeFlushGather(&FlushGather);
 
     if (CommittedPages != 0) {
         MiReturnCommitment(CommittedPages);
@@ -3683,6 +3689,10 @@ Environment:
     ULONG ReturnedSize;
     PIMAGE_LOAD_CONFIG_DIRECTORY ImageConfigData;
     ULONG_PTR ProcessAffinityMask;
+    PSECTION Section;
+    PMI_IMAGE_PEB_INFORMATION CapturedInformation;
+    MI_IMAGE_PEB_INFORMATION PebInformation;
+    LOGICAL NativeImage;
 
     ViewBase = NULL;
     SectionOffset.LowPart = 0;
@@ -3755,20 +3765,41 @@ Environment:
         return GetExceptionCode();
     }
 
-    // Every reference to NtHeaders (including the call to RtlImageNtHeader) must be wrapped in try-except in case the inpage fails.
-    // The inpage can fail for any reason including network failures, disk errors, low resources, etc.
-    try {
-        NtHeaders = RtlImageNtHeader(PebBase->ImageBaseAddress);
-        Magic = NtHeaders->OptionalHeader.Magic;
-        Characteristics = NtHeaders->FileHeader.Characteristics;
-    } except(EXCEPTION_EXECUTE_HANDLER)
+    // A process created from an image section whose PEB values were captured by an earlier process skips the image headers and load configuration.
+    // Wow64 processes always build their PEB32 from the image.
+    CapturedInformation = NULL;
+#if defined(_WIN64)
+    if (TargetProcess->Wow64Process == NULL)
+#endif
     {
-        KeDetachProcess();
-        return STATUS_INVALID_IMAGE_PROTECT;
+        Section = (PSECTION)TargetProcess->SectionObject;
+        if (Section != NULL && Section->u.Flags.Image) {
+            CapturedInformation = MI_GET_IMAGE_PEB_INFORMATION(Section->Segment);
+        }
     }
 
-    if (NtHeaders != NULL) {
-        ProcessAffinityMask = 0;
+    NativeImage = FALSE;
+    if (CapturedInformation != NULL && CapturedInformation->Captured) {
+        PebInformation = *CapturedInformation;
+        NativeImage = TRUE;
+    } else {
+        // Every reference to NtHeaders (including the call to RtlImageNtHeader) must be wrapped in try-except in case the inpage fails.
+        // The inpage can fail for any reason including network failures, disk errors, low resources, etc.
+        try {
+            NtHeaders = RtlImageNtHeader(PebBase->ImageBaseAddress);
+            Magic = NtHeaders->OptionalHeader.Magic;
+            Characteristics = NtHeaders->FileHeader.Characteristics;
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            KeDetachProcess();
+            return STATUS_INVALID_IMAGE_PROTECT;
+        }
+
+        if (NtHeaders == NULL) {
+            KeDetachProcess();
+            *Base = PebBase;
+            return STATUS_SUCCESS;
+        }
 
 #if defined(_WIN64)
         if (TargetProcess->Wow64Process) {
@@ -3777,6 +3808,9 @@ Environment:
                 KeDetachProcess();
                 return Status;
             }
+
+            PebInformation.Characteristics = Characteristics;
+            PebInformation.ProcessAffinityMask = 0;
         } else      // a PE32+ image
 #endif
         {
@@ -3786,37 +3820,60 @@ Environment:
                     ProbeForReadSmallStructure((PVOID)ImageConfigData, sizeof(*ImageConfigData), PROBE_ALIGNMENT(IMAGE_LOAD_CONFIG_DIRECTORY));
                 }
 
-                MI_INIT_PEB_FROM_IMAGE(NtHeaders, ImageConfigData);
-
-                if (ImageConfigData != NULL && ImageConfigData->ProcessAffinityMask != 0) {
-                    ProcessAffinityMask = ImageConfigData->ProcessAffinityMask;
+                PebInformation.Characteristics = Characteristics;
+                PebInformation.ImageSubsystem = NtHeaders->OptionalHeader.Subsystem;
+                PebInformation.ImageSubsystemMajorVersion = NtHeaders->OptionalHeader.MajorSubsystemVersion;
+                PebInformation.ImageSubsystemMinorVersion = NtHeaders->OptionalHeader.MinorSubsystemVersion;
+                PebInformation.Win32VersionValue = NtHeaders->OptionalHeader.Win32VersionValue;
+                PebInformation.CSDVersion = 0;
+                PebInformation.ProcessAffinityMask = 0;
+                if (ImageConfigData != NULL) {
+                    PebInformation.CSDVersion = ImageConfigData->CSDVersion;
+                    PebInformation.ProcessAffinityMask = ImageConfigData->ProcessAffinityMask;
                 }
             } except(EXCEPTION_EXECUTE_HANDLER)
             {
                 KeDetachProcess();
                 return STATUS_INVALID_IMAGE_PROTECT;
             }
+
+            NativeImage = TRUE;
+
+            // Publish the values for the next process created from this image.
+            // Concurrent creators capture identical values, so it does not matter which of them stores last.
+            if (CapturedInformation != NULL) {
+                CapturedInformation->Characteristics = PebInformation.Characteristics;
+                CapturedInformation->CSDVersion = PebInformation.CSDVersion;
+                CapturedInformation->ImageSubsystem = PebInformation.ImageSubsystem;
+                CapturedInformation->ImageSubsystemMajorVersion = PebInformation.ImageSubsystemMajorVersion;
+                CapturedInformation->ImageSubsystemMinorVersion = PebInformation.ImageSubsystemMinorVersion;
+                CapturedInformation->Win32VersionValue = PebInformation.Win32VersionValue;
+                CapturedInformation->ProcessAffinityMask = PebInformation.ProcessAffinityMask;
+                InterlockedExchange(&CapturedInformation->Captured, TRUE);
+            }
         }
+    }
 
-        // Note NT4 examined the NtHeaders->FileHeader.Characteristics for the IMAGE_FILE_AGGRESIVE_WS_TRIM bit, 
-		// but this is not needed or used for NT5 and above.
+    Characteristics = PebInformation.Characteristics;
+    ProcessAffinityMask = PebInformation.ProcessAffinityMask;
 
-        // See if image wants to override the default processor affinity mask.
+    if (NativeImage) {
+        // This is MI_INIT_PEB_FROM_IMAGE applied to the captured values.
         try {
-            if (Characteristics & IMAGE_FILE_UP_SYSTEM_ONLY) {
-                // Image is NOT MP safe.
-				// Assign it a processor on a rotating basis to spread these processes around on MP systems.
-                do {
-                    PebBase->ImageProcessAffinityMask = ((KAFFINITY)0x1 << MmRotatingUniprocessorNumber);
-                    if (++MmRotatingUniprocessorNumber >= KeNumberProcessors) {
-                        MmRotatingUniprocessorNumber = 0;
-                    }
-                } while ((PebBase->ImageProcessAffinityMask & KeActiveProcessors) == 0);
-            } else {
-                if (ProcessAffinityMask != 0) {
-                    // Pass the affinity mask from the image header to LdrpInitializeProcess via the PEB.
-                    PebBase->ImageProcessAffinityMask = ProcessAffinityMask;
+            PebBase->ImageSubsystem = PebInformation.ImageSubsystem;
+            PebBase->ImageSubsystemMajorVersion = PebInformation.ImageSubsystemMajorVersion;
+            PebBase->ImageSubsystemMinorVersion = PebInformation.ImageSubsystemMinorVersion;
+
+            // See if this image wants GetVersion to lie about who the system is. If so, capture the lie into the PEB for the process.
+            if (PebInformation.Win32VersionValue != 0) {
+                PebBase->OSMajorVersion = PebInformation.Win32VersionValue & 0xFF;
+                PebBase->OSMinorVersion = (PebInformation.Win32VersionValue >> 8) & 0xFF;
+                PebBase->OSBuildNumber = (USHORT)((PebInformation.Win32VersionValue >> 16) & 0x3FFF);
+                if (PebInformation.CSDVersion != 0) {
+                    PebBase->OSCSDVersion = PebInformation.CSDVersion;
                 }
+
+                PebBase->OSPlatformId = (PebInformation.Win32VersionValue >> 30) ^ 0x2;
             }
         } except(EXCEPTION_EXECUTE_HANDLER)
         {
@@ -3825,6 +3882,32 @@ Environment:
         }
     }
 
+    // Note NT4 examined the NtHeaders->FileHeader.Characteristics for the IMAGE_FILE_AGGRESIVE_WS_TRIM bit, 
+    // but this is not needed or used for NT5 and above.
+
+    // See if image wants to override the default processor affinity mask.
+    try {
+        if (Characteristics & IMAGE_FILE_UP_SYSTEM_ONLY) {
+            // Image is NOT MP safe.
+            // Assign it a processor on a rotating basis to spread these processes around on MP systems.
+            do {
+                PebBase->ImageProcessAffinityMask = ((KAFFINITY)0x1 << MmRotatingUniprocessorNumber);
+                if (++MmRotatingUniprocessorNumber >= KeNumberProcessors) {
+                    MmRotatingUniprocessorNumber = 0;
+                }
+            } while ((PebBase->ImageProcessAffinityMask & KeActiveProcessors) == 0);
+        } else {
+            if (ProcessAffinityMask != 0) {
+                // Pass the affinity mask from the image header to LdrpInitializeProcess via the PEB.
+                PebBase->ImageProcessAffinityMask = ProcessAffinityMask;
+            }
+        }
+    } except(EXCEPTION_EXECUTE_HANDLER)
+    {
+        KeDetachProcess();
+        return STATUS_INVALID_IMAGE_PROTECT;
+    }
+
     KeDetachProcess();
     *Base = PebBase;
     return STATUS_SUCCESS;
@@ -4314,7 +4397,11 @@ restart:
         RefaultCount = 0;
 
     Refault:
-        Status = IoPageRead(MmPagingFile[PageFileNumber]->File, Mdl, &StartingOffset, &Event, &IoStatus);
+        Status = MiReadCompressedPage(Mdl, PageFileNumber, GET_PAGING_FILE_OFFSET(TempPte), &IoStatus);
+        if (Status == STATUS_NOT_FOUND) {
+            Status = IoPageRead(MmPagingFile[PageFileNumber]->File, Mdl, &StartingOffset, &Event, &IoStatus);
+        }
+
         if (Status == STATUS_PENDING) {
             KeWaitForSingleObject(&Event, WrPageIn, KernelMode, FALSE, (PLARGE_INTEGER)NULL);
             Status = IoStatus.Status;
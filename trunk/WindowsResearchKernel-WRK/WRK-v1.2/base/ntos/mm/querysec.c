@@ -50,6 +50,9 @@ NTSTATUS NtQuerySection(__in HANDLE SectionHandle,
 
             SECTION_IMAGE_INFORMATION
 
+            SectionReadAheadInformation - Data type is PSECTION_READ_AHEAD_INFORMATION.
+                Returns how well the in-page read clustering of user views of a data file section matches the way they fault.
+
         SectionInformationLength - Specifies the length in bytes of the section information buffer.
         ReturnLength - An optional pointer which, if specified, receives the number of bytes placed in the section information buffer.
     */
@@ -79,7 +82,9 @@ NTSTATUS NtQuerySection(__in HANDLE SectionHandle,
     }
 
     // Check argument validity.
-    if ((SectionInformationClass != SectionBasicInformation) && (SectionInformationClass != SectionImageInformation)) {
+    if ((SectionInformationClass != SectionBasicInformation) &&
+        (SectionInformationClass != SectionImageInformation) &&
+        (SectionInformationClass != SectionReadAheadInformation)) {
         return STATUS_INVALID_INFO_CLASS;
     }
 
@@ -87,6 +92,10 @@ NTSTATUS NtQuerySection(__in HANDLE SectionHandle,
         if (SectionInformationLength < (ULONG)sizeof(SECTION_BASIC_INFORMATION)) {
             return STATUS_INFO_LENGTH_MISMATCH;
         }
+    } else if (SectionInformationClass == SectionReadAheadInformation) {
+        if (SectionInformationLength < (ULONG)sizeof(SECTION_READ_AHEAD_INFORMATION)) {
+            return STATUS_INFO_LENGTH_MISMATCH;
+        }
     } else {
         if (SectionInformationLength < (ULONG)sizeof(SECTION_IMAGE_INFORMATION)) {
             return STATUS_INFO_LENGTH_MISMATCH;
@@ -128,6 +137,20 @@ NTSTATUS NtQuerySection(__in HANDLE SectionHandle,
                 if (ARGUMENT_PRESENT(ReturnLength)) {
                     *ReturnLength = sizeof(SECTION_BASIC_INFORMATION);
                 }
+            } else if (SectionInformationClass == SectionReadAheadInformation) {
+                PCONTROL_AREA ControlArea;
+                PSECTION_READ_AHEAD_INFORMATION ReadAheadInfo;
+
+                // The counters are updated under the PFN lock, a snapshot without it is good enough here.
+                ControlArea = Section->Segment->ControlArea;
+                ReadAheadInfo = (PSECTION_READ_AHEAD_INFORMATION)SectionInformation;
+                ReadAheadInfo->ClusterSize = ControlArea->ReadAheadCluster;
+                ReadAheadInfo->ReadAheadPages = ControlArea->ReadAheadPages;
+                ReadAheadInfo->ReadAheadHits = ControlArea->ReadAheadHits;
+                ReadAheadInfo->PendingPages = ControlArea->LastReadAhead;
+                if (ARGUMENT_PRESENT(ReturnLength)) {
+                    *ReturnLength = sizeof(SECTION_READ_AHEAD_INFORMATION);
+                }
             } else {
                 if (Section->u.Flags.Image == 0) {
                     Status = STATUS_SECTION_NOT_IMAGE;
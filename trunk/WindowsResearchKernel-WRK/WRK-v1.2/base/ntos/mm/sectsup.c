@@ -1443,7 +1443,9 @@ Environment:
     if ((ControlArea->NumberOfMappedViews == 0) && (ControlArea->NumberOfSectionReferences == 0)) {
         ASSERT(ControlArea->NumberOfUserReferences == 0);
         if (ControlArea->FilePointer != NULL) {
-            if (ControlArea->NumberOfPfnReferences == 0) {
+            // An image segment may be kept on the unused segment list without any resident pages so that mapping the image again is cheap.
+            if ((ControlArea->NumberOfPfnReferences == 0) &&
+                ((!MI_RETAIN_UNUSED_IMAGE_SEGMENT(ControlArea)) || ((ControlArea->DereferenceList.Flink == NULL) && (MmUnusedSegmentCount >= MmUnusedImageSegmentMaximum)))) {
                 // There are no views and no physical pages referenced by the Segment, dereference the Segment object.
                 ControlArea->u.Flags.BeingDeleted = 1;
                 Action |= DEREF_SEGMENT;
@@ -1554,6 +1556,11 @@ Environment:
 
     MM_PFN_LOCK_ASSERT();
     if ((ControlArea->NumberOfPfnReferences == 0) && (ControlArea->NumberOfMappedViews == 0) && (ControlArea->NumberOfSectionReferences == 0)) {
+        // An image segment already on the unused segment list stays there after its last page is reclaimed, see MiCheckControlArea.
+        if ((ControlArea->DereferenceList.Flink != NULL) && (MI_RETAIN_UNUSED_IMAGE_SEGMENT(ControlArea))) {
+            return;
+        }
+
         // This segment is no longer mapped in any address space nor are there any prototype PTEs within the segment
         // which are valid or in a transition state.  Queue the segment to the segment-dereferencer thread
         // which will dereference the segment object, potentially causing the segment to be deleted.
@@ -1323,6 +1323,7 @@ Environment:
     PMMPTE GlobalPteEntrySave;
     PMMPTE StartPde;
     PMM_SESSION_SPACE SessionGlobal;
+    PSLIST_ENTRY SingleListEntry;
     ULONG AttachCount;
     PEPROCESS Process;
     PKTHREAD CurrentThread;
@@ -1423,6 +1424,17 @@ Environment:
     // Complete all deferred pool block deallocations.
     ExDeferredFreePool(&MmSessionSpace->PagedPool);
 
+    // Free the session pool pages kept for reuse, deletion is pending so none are added back.
+    ASSERT(MmSessionSpace->u.Flags.DeletePending == 1);
+    do {
+        SingleListEntry = InterlockedPopEntrySList(&SessionGlobal->PagedPoolSListHead);
+        if (SingleListEntry == NULL) {
+            break;
+        }
+
+        MiFreePoolPages(SingleListEntry);
+    } while (TRUE);
+
     // Now that all modules have had their unload routine(s) called, check for pool leaks before unloading the images.
     MiCheckSessionPoolAllocations();
     ASSERT(MmSessionSpace->ReferenceCount == 0);
@@ -609,6 +609,9 @@ Environment:
     // Free the physical memory descriptor block.
     ExFreePool(MmPhysicalMemoryBlock);
     ExFreePool(MiPfnBitMap.Buffer);
+    if (MiAvailablePfnBitMap.Buffer != NULL) {
+        ExFreePool(MiAvailablePfnBitMap.Buffer);
+    }
 
     // Free the system views structure.
     if (MmSession.SystemSpaceViewTable != NULL) {
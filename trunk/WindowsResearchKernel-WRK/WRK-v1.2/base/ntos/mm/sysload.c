@@ -75,6 +75,9 @@ ULONG MiSetProtectionOnTransitionPte(IN PMMPTE PointerPte, IN ULONG ProtectionMa
 NTSTATUS MiDereferenceImports(IN PLOAD_IMPORTS ImportList);
 LOGICAL MiCallDllUnloadAndUnloadDll(IN PKLDR_DATA_TABLE_ENTRY DataTableEntry);
 PVOID MiLocateExportName(IN PVOID DllBase, IN PCHAR FunctionName);
+VOID MiInsertExportHash(IN PVOID DllBase);
+LONG MiLookupExportName(IN PVOID DllBase, IN PIMAGE_EXPORT_DIRECTORY ExportDirectory, IN PCHAR FunctionName);
+VOID MiDeleteExportHash(IN PVOID DllBase);
 VOID MiRememberUnloadedDriver(IN PUNICODE_STRING DriverName, IN PVOID Address, IN ULONG Length);
 VOID MiWriteProtectSystemImage(IN PVOID DllBase);
 VOID MiLocateKernelSections(IN PKLDR_DATA_TABLE_ENTRY DataTableEntry);
@@ -97,6 +100,9 @@ MM_PROTECTION_MASK MiComputeDriverProtection(IN LOGICAL SessionDriver, IN ULONG
 #pragma alloc_text(PAGE,MiDereferenceImports)
 #pragma alloc_text(PAGE,MiCallDllUnloadAndUnloadDll)
 #pragma alloc_text(PAGE,MiLocateExportName)
+#pragma alloc_text(PAGE,MiInsertExportHash)
+#pragma alloc_text(PAGE,MiLookupExportName)
+#pragma alloc_text(PAGE,MiDeleteExportHash)
 #pragma alloc_text(PAGE,MiClearImports)
 #pragma alloc_text(PAGE,MmGetSystemRoutineAddress)
 #pragma alloc_text(PAGE,MiFindExportedRoutineByName)
@@ -130,12 +136,20 @@ Arguments:
     DataTableEntry - Supplies the loaded module list entry to insert/remove.
     Insert - Supplies TRUE if the entry should be inserted, FALSE if the entry should be removed.
 Environment:
-    Kernel mode.  Normal APCs disabled (critical region held).
+    Kernel mode, APC_LEVEL or below.  Normal APCs disabled (critical region held).
 */
 {
     KIRQL OldIrql;
 
     ExAcquireResourceExclusiveLite(&PsLoadedModuleResource, TRUE);
+
+    // The export name hash of the image comes and goes with its entry so lookups under either lock see a stable hash list.
+    if (Insert == TRUE) {
+        MiInsertExportHash(DataTableEntry->DllBase);
+    } else {
+        MiDeleteExportHash(DataTableEntry->DllBase);
+    }
+
     OldIrql = KeRaiseIrqlToSynchLevel();
     ExAcquireSpinLockAtDpcLevel(&PsLoadedModuleSpinLock);
 
@@ -2668,20 +2682,29 @@ Return Value:
         NameTableBase = (PULONG)((PCHAR)DllBase + (ULONG)ExportDirectory->AddressOfNames);
         NameOrdinalTableBase = (PUSHORT)((PCHAR)DllBase + (ULONG)ExportDirectory->AddressOfNameOrdinals);
 
-        // Look in the export name table for the specified function name.
-        Low = 0;
-        Middle = 0;
-        High = ExportDirectory->NumberOfNames - 1;
-        while (High >= Low) {
-            // Compute the next probe index and compare the export name entry with the specified function name.
-            Middle = (Low + High) >> 1;
-            Result = strcmp(FunctionName, (PCHAR)((PCHAR)DllBase + NameTableBase[Middle]));
-            if (Result < 0) {
-                High = Middle - 1;
-            } else if (Result > 0) {
-                Low = Middle + 1;
-            } else {
-                break;
+        // Look in the export name hash of the image for the specified function name, or in the export name table if it has no hash.
+        Middle = MiLookupExportName(DllBase, ExportDirectory, FunctionName);
+        if (Middle >= 0) {
+            Low = Middle;
+            High = Middle;
+        } else if (Middle == -1) {
+            Low = 0;
+            High = -1;
+        } else {
+            Low = 0;
+            Middle = 0;
+            High = ExportDirectory->NumberOfNames - 1;
+            while (High >= Low) {
+                // Compute the next probe index and compare the export name entry with the specified function name.
+                Middle = (Low + High) >> 1;
+                Result = strcmp(FunctionName, (PCHAR)((PCHAR)DllBase + NameTableBase[Middle]));
+                if (Result < 0) {
+                    High = Middle - 1;
+                } else if (Result > 0) {
+                    Low = Middle + 1;
+                } else {
+                    break;
+                }
             }
         }
 
@@ -3199,6 +3222,173 @@ Return Value:
 }
 
 
+// Names are looked up through a hash of the export names of each loaded image, built when the image is inserted in the loaded module list.
+// The hash list is changed with both the system load lock and the loaded module resource held, so either one is enough to look a name up.
+typedef struct _MI_EXPORT_HASH {
+    struct _MI_EXPORT_HASH* Next;
+    PVOID DllBase;
+    ULONG Mask;
+    ULONG Slot[1];              // Index in the name table plus one, zero if the slot is free
+} MI_EXPORT_HASH, *PMI_EXPORT_HASH;
+
+PMI_EXPORT_HASH MiExportHashList;
+
+// Images with fewer names than this are searched directly as a hash would save little.
+#define MI_EXPORT_HASH_MINIMUM_NAMES 64
+
+#define MI_HASH_EXPORT_NAME(Hash, Name)                   \
+    {                                                     \
+        PUCHAR _Next = (PUCHAR)(Name);                    \
+        Hash = 2166136261;                                \
+        while (*_Next != 0) {                             \
+            Hash = (Hash ^ *_Next) * 16777619;            \
+            _Next += 1;                                   \
+        }                                                 \
+    }
+
+
+VOID MiInsertExportHash(IN PVOID DllBase)
+/*
+Routine Description:
+    This function builds the hash of the export names of an image and inserts it in the hash list.
+    Images that export few names, session images and images the hash cannot be allocated for are left without one.
+Arguments:
+    DllBase - Supplies the base address of the image.
+Environment:
+    Kernel mode, APC_LEVEL or below, system load lock and loaded module resource held (or phase 0 initialization).
+*/
+{
+    PMI_EXPORT_HASH ExportHash;
+    PIMAGE_EXPORT_DIRECTORY ExportDirectory;
+    PULONG NameTableBase;
+    ULONG ExportSize;
+    ULONG NumberOfSlots;
+    ULONG Hash;
+    ULONG i;
+
+    PAGED_CODE();
+
+    if (MI_IS_SESSION_IMAGE_ADDRESS(DllBase)) {
+        return;
+    }
+
+    ExportDirectory = (PIMAGE_EXPORT_DIRECTORY)RtlImageDirectoryEntryToData(DllBase,
+                                                                            TRUE,
+                                                                            IMAGE_DIRECTORY_ENTRY_EXPORT,
+                                                                            &ExportSize);
+    if ((ExportDirectory == NULL) || (ExportDirectory->NumberOfNames < MI_EXPORT_HASH_MINIMUM_NAMES)) {
+        return;
+    }
+
+    // Size the table to at least twice the number of names so the probe sequences stay short.
+    NumberOfSlots = MI_EXPORT_HASH_MINIMUM_NAMES;
+    while (NumberOfSlots < 2 * ExportDirectory->NumberOfNames) {
+        NumberOfSlots <<= 1;
+    }
+
+    ExportHash = ExAllocatePoolWithTag(PagedPool, FIELD_OFFSET(MI_EXPORT_HASH, Slot) + NumberOfSlots * sizeof(ULONG), 'hEmM');
+    if (ExportHash == NULL) {
+        return;
+    }
+
+    RtlZeroMemory(ExportHash->Slot, NumberOfSlots * sizeof(ULONG));
+    ExportHash->DllBase = DllBase;
+    ExportHash->Mask = NumberOfSlots - 1;
+    NameTableBase = (PULONG)((PCHAR)DllBase + (ULONG)ExportDirectory->AddressOfNames);
+    for (i = 0; i < ExportDirectory->NumberOfNames; i += 1) {
+        MI_HASH_EXPORT_NAME(Hash, (PCHAR)DllBase + NameTableBase[i]);
+        Hash &= ExportHash->Mask;
+        while (ExportHash->Slot[Hash] != 0) {
+            Hash = (Hash + 1) & ExportHash->Mask;
+        }
+
+        ExportHash->Slot[Hash] = i + 1;
+    }
+
+    ExportHash->Next = MiExportHashList;
+    MiExportHashList = ExportHash;
+}
+
+
+LONG MiLookupExportName(IN PVOID DllBase, IN PIMAGE_EXPORT_DIRECTORY ExportDirectory, IN PCHAR FunctionName)
+/*
+Routine Description:
+    This function looks up a name in the export name table of an image, using the hash of the image's export names.
+Arguments:
+    DllBase - Supplies the base address of the exporting image.
+    ExportDirectory - Supplies the export directory of the image.
+    FunctionName - Supplies the name to look up.
+Return Value:
+    The index of the name in the export name table, -1 if the image does not export the name, or -2 if the image has no hash and the caller must search the table itself.
+Environment:
+    Kernel mode, APC_LEVEL or below, system load lock or loaded module resource held (or phase 0 initialization).
+*/
+{
+    PMI_EXPORT_HASH ExportHash;
+    PULONG NameTableBase;
+    ULONG Hash;
+    ULONG i;
+
+    PAGED_CODE();
+
+    if (ExportDirectory->NumberOfNames < MI_EXPORT_HASH_MINIMUM_NAMES) {
+        return -2;
+    }
+
+    for (ExportHash = MiExportHashList; ExportHash != NULL; ExportHash = ExportHash->Next) {
+        if (ExportHash->DllBase == DllBase) {
+            break;
+        }
+    }
+
+    if (ExportHash == NULL) {
+        return -2;
+    }
+
+    NameTableBase = (PULONG)((PCHAR)DllBase + (ULONG)ExportDirectory->AddressOfNames);
+    MI_HASH_EXPORT_NAME(Hash, FunctionName);
+    Hash &= ExportHash->Mask;
+    while (ExportHash->Slot[Hash] != 0) {
+        i = ExportHash->Slot[Hash] - 1;
+        if (strcmp(FunctionName, (PCHAR)DllBase + NameTableBase[i]) == 0) {
+            return (LONG)i;
+        }
+
+        Hash = (Hash + 1) & ExportHash->Mask;
+    }
+
+    return -1;
+}
+
+
+VOID MiDeleteExportHash(IN PVOID DllBase)
+/*
+Routine Description:
+    This function frees the export name hash of an image that is being unloaded, if it has one.
+Arguments:
+    DllBase - Supplies the base address of the image.
+Environment:
+    Kernel mode, APC_LEVEL or below, system load lock and loaded module resource held.
+*/
+{
+    PMI_EXPORT_HASH ExportHash;
+    PMI_EXPORT_HASH* Previous;
+
+    PAGED_CODE();
+
+    Previous = &MiExportHashList;
+    for (ExportHash = MiExportHashList; ExportHash != NULL; ExportHash = ExportHash->Next) {
+        if (ExportHash->DllBase == DllBase) {
+            *Previous = ExportHash->Next;
+            ExFreePool(ExportHash);
+            return;
+        }
+
+        Previous = &ExportHash->Next;
+    }
+}
+
+
 NTSTATUS MiSnapThunk(IN PVOID DllBase,
                      IN PVOID ImageBase,
                      IN PIMAGE_THUNK_DATA NameThunk,
@@ -3264,29 +3454,39 @@ Return Value:
             !strcmp((PSZ)((PIMAGE_IMPORT_BY_NAME)NameThunk->u1.AddressOfData)->Name, (PSZ)((PCHAR)DllBase + NameTableBase[HintIndex]))) {
             OrdinalNumber = NameOrdinalTableBase[HintIndex];
         } else {
-            // Lookup the import name in the name table using a binary search.
-            Low = 0;
-            Middle = 0;
-            High = ExportDirectory->NumberOfNames - 1;
-            while (High >= Low) {
-                // Compute the next probe index and compare the import name with the export name entry.
-                Middle = (Low + High) >> 1;
-                Result = strcmp((const PCHAR)&((PIMAGE_IMPORT_BY_NAME)NameThunk->u1.AddressOfData)->Name[0], (PCHAR)((PCHAR)DllBase + NameTableBase[Middle]));
-                if (Result < 0) {
-                    High = Middle - 1;
-                } else if (Result > 0) {
-                    Low = Middle + 1;
-                } else {
-                    break;
-                }
+            // Lookup the import name in the export name hash of the image, if it has one.
+            Middle = MiLookupExportName(DllBase, ExportDirectory, (PCHAR)&((PIMAGE_IMPORT_BY_NAME)NameThunk->u1.AddressOfData)->Name[0]);
+            if (Middle == -1) {
+                return STATUS_DRIVER_ENTRYPOINT_NOT_FOUND;
             }
 
-            // If the high index is less than the low index, then a matching table entry was not found. 
-            // Otherwise, get the ordinal number from the ordinal table.
-            if (High < Low) {
-                return STATUS_DRIVER_ENTRYPOINT_NOT_FOUND;
-            } else {
+            if (Middle >= 0) {
                 OrdinalNumber = NameOrdinalTableBase[Middle];
+            } else {
+                // Lookup the import name in the name table using a binary search.
+                Low = 0;
+                Middle = 0;
+                High = ExportDirectory->NumberOfNames - 1;
+                while (High >= Low) {
+                    // Compute the next probe index and compare the import name with the export name entry.
+                    Middle = (Low + High) >> 1;
+                    Result = strcmp((const PCHAR)&((PIMAGE_IMPORT_BY_NAME)NameThunk->u1.AddressOfData)->Name[0], (PCHAR)((PCHAR)DllBase + NameTableBase[Middle]));
+                    if (Result < 0) {
+                        High = Middle - 1;
+                    } else if (Result > 0) {
+                        Low = Middle + 1;
+                    } else {
+                        break;
+                    }
+                }
+
+                // If the high index is less than the low index, then a matching table entry was not found. 
+                // Otherwise, get the ordinal number from the ordinal table.
+                if (High < Low) {
+                    return STATUS_DRIVER_ENTRYPOINT_NOT_FOUND;
+                } else {
+                    OrdinalNumber = NameOrdinalTableBase[Middle];
+                }
             }
         }
     }
@@ -5012,6 +5212,7 @@ Environment:
 
         // Insert the data table entry in the load order list in the order they are specified.
         InsertTailList(&PsLoadedModuleList, &DataTableEntry1->InLoadOrderLinks);
+        MiInsertExportHash(DataTableEntry1->DllBase);
 
 #if defined (_WIN64)
         RtlInsertInvertedFunctionTable(&PsInvertedFunctionTable, DataTableEntry1->DllBase, DataTableEntry1->SizeOfImage);
@@ -5203,6 +5404,8 @@ Arguments:
     AnsiImageRoutineName - Supplies the ANSI routine name being searched for.
 Return Value:
     The virtual address of the requested routine or NULL if not found.
+Environment:
+    Kernel mode, APC_LEVEL or below, loaded module resource held.
 */
 {
     USHORT OrdinalNumber;
@@ -5230,26 +5433,33 @@ Return Value:
     NameTableBase = (PULONG)((PCHAR)DllBase + (ULONG)ExportDirectory->AddressOfNames);// Initialize the pointer to the array of RVA-based ansi export strings.
     NameOrdinalTableBase = (PUSHORT)((PCHAR)DllBase + (ULONG)ExportDirectory->AddressOfNameOrdinals);// Initialize the pointer to the array of USHORT ordinal numbers.
 
-    // Lookup the desired name in the name table using a binary search.
-    Low = 0;
-    Middle = 0;
-    High = ExportDirectory->NumberOfNames - 1;
-    while (High >= Low) {
-        Middle = (Low + High) >> 1;// Compute the next probe index and compare the import name with the export name entry.
-        Result = strcmp(AnsiImageRoutineName->Buffer, (PCHAR)DllBase + NameTableBase[Middle]);
-        if (Result < 0) {
-            High = Middle - 1;
-        } else if (Result > 0) {
-            Low = Middle + 1;
-        } else {
-            break;
-        }
+    // Lookup the desired name in the export name hash of the image, or in the name table using a binary search if it has no hash.
+    Middle = MiLookupExportName(DllBase, ExportDirectory, AnsiImageRoutineName->Buffer);
+    if (Middle == -1) {
+        return NULL;
     }
 
-    // If the high index is less than the low index, then a matching table entry was not found. 
-    // Otherwise, get the ordinal number from the ordinal table.
-    if (High < Low) {
-        return NULL;
+    if (Middle == -2) {
+        Low = 0;
+        Middle = 0;
+        High = ExportDirectory->NumberOfNames - 1;
+        while (High >= Low) {
+            Middle = (Low + High) >> 1;// Compute the next probe index and compare the import name with the export name entry.
+            Result = strcmp(AnsiImageRoutineName->Buffer, (PCHAR)DllBase + NameTableBase[Middle]);
+            if (Result < 0) {
+                High = Middle - 1;
+            } else if (Result > 0) {
+                Low = Middle + 1;
+            } else {
+                break;
+            }
+        }
+
+        // If the high index is less than the low index, then a matching table entry was not found. 
+        // Otherwise, get the ordinal number from the ordinal table.
+        if (High < Low) {
+            return NULL;
+        }
     }
 
     OrdinalNumber = NameOrdinalTableBase[Middle];
@@ -19,6 +19,7 @@ ULONG MiFlushType[MI_TB_FLUSH_TYPE_MAX];
 #endif
 
 VOID MiFeedSysPtePool(IN ULONG Index);
+LOGICAL MiDrainSystemPteCaches(VOID);
 ULONG MiGetSystemPteListCount(IN ULONG ListSize);
 VOID MiPteSListExpansionWorker(IN PVOID Context);
 LOGICAL MiRecoverExtraPtes(ULONG NumberOfPtes);
@@ -35,6 +36,7 @@ extern ULONG MiSpecialPoolExtraCount;
 #pragma alloc_text(MISYSPTE,MiFeedSysPtePool)
 #pragma alloc_text(MISYSPTE,MiReleaseSystemPtes)
 #pragma alloc_text(MISYSPTE,MiGetSystemPteListCount)
+#pragma alloc_text(MISYSPTE,MiDrainSystemPteCaches)
 #endif
 
 PVOID MiLowestSystemPteVirtualAddress;
@@ -118,6 +120,19 @@ typedef struct _MM_PTE_SLIST_EXPANSION_WORK_CONTEXT
 
 MM_PTE_SLIST_EXPANSION_WORK_CONTEXT MiPteSListExpand;
 
+// Each processor caches a few free runs of each of the binned sizes so that mapping and unmapping small MDLs
+// stays off the nonblocking queues and the system space lock shared by all the processors.
+// A slot holds a packed PTE pointer and TB flush time stamp, or zero, and is claimed with an interlocked compare exchange
+// so any processor can drain the cache of another.  The time stamp defers the TB flush to reuse as for the queues.
+#define MI_SYSTEM_PTE_CACHE_DEPTH 8
+
+typedef struct DECLSPEC_CACHEALIGN _MI_SYSTEM_PTE_CACHE {
+    LONG64 Slot[MM_SYS_PTE_TABLES_MAX][MI_SYSTEM_PTE_CACHE_DEPTH];
+} MI_SYSTEM_PTE_CACHE, *PMI_SYSTEM_PTE_CACHE;
+
+MI_SYSTEM_PTE_CACHE MiSystemPteCaches[MAXIMUM_PROCESSORS];
+LONG MiSystemPteCacheDrains;
+
 VOID MiDumpSystemPtes(IN MMSYSTEM_PTE_POOL_TYPE SystemPtePoolType);
 ULONG MiCountFreeSystemPtes(IN MMSYSTEM_PTE_POOL_TYPE SystemPtePoolType);
 PVOID MiGetHighestPteConsumer(OUT PULONG_PTR NumberOfPtes);
@@ -223,6 +238,108 @@ __inline ULONG UnpackPTETimeStamp(IN PPTE_QUEUE_POINTER Entry)
 }
 
 
+__inline LOGICAL MiInsertSystemPteCache(IN ULONG Index, IN PPTE_QUEUE_POINTER Value)
+/*
+Routine Description:
+    This routine places a free run of binned size in the system PTE cache of the current processor.
+Arguments:
+    Index - Supplies the size index of the run.
+    Value - Supplies the packed PTE pointer and TB flush time stamp of the run.
+Return Value:
+    TRUE if the run was cached, FALSE if it must be queued the usual way.
+*/
+{
+    PLONG64 Slots;
+    ULONG i;
+
+    // No runs are cached while the caches are being drained to satisfy a request that failed.
+    if (MiSystemPteCacheDrains != 0) {
+        return FALSE;
+    }
+
+    Slots = MiSystemPteCaches[KeGetCurrentProcessorNumber()].Slot[Index];
+    for (i = 0; i < MI_SYSTEM_PTE_CACHE_DEPTH; i += 1) {
+        if ((Slots[i] == 0) && (InterlockedCompareExchange64(&Slots[i], Value->Data, 0) == 0)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+__inline LOGICAL MiRemoveSystemPteCache(IN ULONG Index, OUT PPTE_QUEUE_POINTER Value)
+/*
+Routine Description:
+    This routine takes a free run of binned size out of the system PTE cache of the current processor.
+Arguments:
+    Index - Supplies the size index of the run.
+    Value - Receives the packed PTE pointer and TB flush time stamp of the run.
+Return Value:
+    TRUE if a run was taken, FALSE if the cache has none of this size.
+*/
+{
+    PLONG64 Slots;
+    LONG64 Data;
+    ULONG i;
+
+    Slots = MiSystemPteCaches[KeGetCurrentProcessorNumber()].Slot[Index];
+    for (i = 0; i < MI_SYSTEM_PTE_CACHE_DEPTH; i += 1) {
+        Data = Slots[i];
+        if ((Data != 0) && (InterlockedCompareExchange64(&Slots[i], 0, Data) == Data)) {
+            Value->Data = Data;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+LOGICAL MiDrainSystemPteCaches(VOID)
+/*
+Routine Description:
+    This routine releases the runs cached by all the processors back to the system PTE pool so that they can be coalesced with their neighbors.
+    It is called when a reservation could not be satisfied.
+Return Value:
+    TRUE if any runs were released, FALSE if the caches were empty.
+Environment:
+    Kernel mode, DISPATCH_LEVEL or below.
+*/
+{
+    PLONG64 Slots;
+    LONG64 Data;
+    PTE_QUEUE_POINTER Value;
+    ULONG Processor;
+    ULONG Index;
+    ULONG i;
+    LOGICAL Released;
+
+    Released = FALSE;
+    InterlockedIncrement(&MiSystemPteCacheDrains);
+    for (Processor = 0; Processor < (ULONG)KeNumberProcessors; Processor += 1) {
+        for (Index = 0; Index < MM_SYS_PTE_TABLES_MAX; Index += 1) {
+            Slots = MiSystemPteCaches[Processor].Slot[Index];
+            for (i = 0; i < MI_SYSTEM_PTE_CACHE_DEPTH; i += 1) {
+                Data = Slots[i];
+                if ((Data != 0) && (InterlockedCompareExchange64(&Slots[i], 0, Data) == Data)) {
+                    Value.Data = Data;
+                    if (MmTrackPtes & 0x2) {
+                        MiCheckPteReserve(UnpackPTEPointer(&Value), MmSysPteIndex[Index]);
+                    }
+
+                    MiReleaseSystemPtes(UnpackPTEPointer(&Value), MmSysPteIndex[Index], SystemPteSpace);
+                    Released = TRUE;
+                }
+            }
+        }
+    }
+
+    InterlockedDecrement(&MiSystemPteCacheDrains);
+    return Released;
+}
+
+
 PMMPTE MiReserveSystemPtes(IN ULONG NumberOfPtes, IN MMSYSTEM_PTE_POOL_TYPE SystemPtePoolType)
 /*
 Routine Description:
@@ -242,13 +359,18 @@ Environment:
     ULONG Index;
     ULONG TimeStamp;
     PTE_QUEUE_POINTER Value;
+    LOGICAL Cached;
 
     if (SystemPtePoolType == SystemPteSpace) {
         if (NumberOfPtes <= MM_PTE_TABLE_LIMIT) {
             Index = MmSysPteTables[NumberOfPtes];
             ASSERT(NumberOfPtes <= MmSysPteIndex[Index]);
-            if (ExRemoveHeadNBQueue(MiSystemPteNBHead[Index], (PULONG64)&Value) == TRUE) {
-                InterlockedDecrement((PLONG)&MmSysPteListBySizeCount[Index]);
+            Cached = MiRemoveSystemPteCache(Index, &Value);
+            if ((Cached) || (ExRemoveHeadNBQueue(MiSystemPteNBHead[Index], (PULONG64)&Value) == TRUE)) {
+                if (Cached == FALSE) {
+                    InterlockedDecrement((PLONG)&MmSysPteListBySizeCount[Index]);
+                }
+
                 PointerPte = UnpackPTEPointer(&Value);
                 TimeStamp = UnpackPTETimeStamp(&Value);
                 ASSERT(PointerPte >= MmSystemPtesStart[SystemPtePoolType]);
@@ -289,6 +411,12 @@ Environment:
     }
 
     PointerPte = MiReserveAlignedSystemPtes(NumberOfPtes, SystemPtePoolType, 0);
+
+    // Runs cached by the processors may be all that keeps the free runs from coalescing into one that fits.
+    if ((PointerPte == NULL) && (SystemPtePoolType == SystemPteSpace) && (MiDrainSystemPteCaches())) {
+        PointerPte = MiReserveAlignedSystemPtes(NumberOfPtes, SystemPtePoolType, 0);
+    }
+
     if (PointerPte == NULL) {
         MiSystemPteAllocationFailed += 1;
     }
@@ -747,6 +875,7 @@ Environment:
     ULONG i;
     ULONG TimeStamp;
     PTE_QUEUE_POINTER Value;
+    LOGICAL Cached;
     ULONG Index;
     KIRQL OldIrql;
     CSHORT IoMapping;
@@ -821,8 +950,12 @@ Environment:
         if (NumberOfPages <= MM_PTE_TABLE_LIMIT) {
             Index = MmSysPteTables[NumberOfPages];
             ASSERT(NumberOfPages <= MmSysPteIndex[Index]);
-            if (ExRemoveHeadNBQueue(MiSystemPteNBHead[Index], (PULONG64)&Value) == TRUE) {
-                InterlockedDecrement((PLONG)&MmSysPteListBySizeCount[Index]);
+            Cached = MiRemoveSystemPteCache(Index, &Value);
+            if ((Cached) || (ExRemoveHeadNBQueue(MiSystemPteNBHead[Index], (PULONG64)&Value) == TRUE)) {
+                if (Cached == FALSE) {
+                    InterlockedDecrement((PLONG)&MmSysPteListBySizeCount[Index]);
+                }
+
                 PointerPte = UnpackPTEPointer(&Value);
                 ASSERT(PointerPte >= MmSystemPtesStart[SystemPteSpace]);
                 ASSERT(PointerPte <= MmSystemPtesEnd[SystemPteSpace]);
@@ -1082,6 +1215,16 @@ Environment:
             Index = MmSysPteTables[NumberOfPages];
             ASSERT(NumberOfPages <= MmSysPteIndex[Index]);
             if (MmTotalFreeSystemPtes[SystemPteSpace] >= MM_MIN_SYSPTE_FREE) {
+                // Zero PTEs, then encode the PTE pointer and the TB flush counter into Value.
+                MiZeroMemoryPte(PointerPte, NumberOfPages);
+                TimeStamp = KeReadTbFlushTimeStamp();
+                PackPTEValue(&Value, PointerPte, TimeStamp);
+
+                // Keep the PTEs on this processor if its cache has room for this size.
+                if (MiInsertSystemPteCache(Index, &Value)) {
+                    return;
+                }
+
                 // Add to the pool if the size is less than 15 + the minimum.
                 i = MmSysPteMinimumFree[Index];
                 if (MmTotalFreeSystemPtes[SystemPteSpace] >= MM_MAX_SYSPTE_FREE) {
@@ -1091,10 +1234,6 @@ Environment:
                 i += 15;
 
                 if (MmSysPteListBySizeCount[Index] <= i) {
-                    // Zero PTEs, then encode the PTE pointer and the TB flush counter into Value.
-                    MiZeroMemoryPte(PointerPte, NumberOfPages);
-                    TimeStamp = KeReadTbFlushTimeStamp();
-                    PackPTEValue(&Value, PointerPte, TimeStamp);
                     if (ExInsertTailNBQueue(MiSystemPteNBHead[Index], Value.Data) == TRUE) {
                         InterlockedIncrement((PLONG)&MmSysPteListBySizeCount[Index]);
                         return;
@@ -1162,6 +1301,11 @@ Environment:
         Index = MmSysPteTables[NumberOfPtes];
         ASSERT(NumberOfPtes <= MmSysPteIndex[Index]);
         if (MmTotalFreeSystemPtes[SystemPteSpace] >= MM_MIN_SYSPTE_FREE) {
+            // Keep the PTEs on this processor if its cache has room for this size.
+            if (MiInsertSystemPteCache(Index, &Value)) {
+                return;
+            }
+
             // Add to the pool if the size is less than 15 + the minimum.
             i = MmSysPteMinimumFree[Index];
             if (MmTotalFreeSystemPtes[SystemPteSpace] >= MM_MAX_SYSPTE_FREE) {
@@ -257,7 +257,7 @@ Environment:
     PMMPTE LastPte;
     PFN_NUMBER PdePage;
     PVOID TempVa;
-    MMPTE_FLUSH_LIST PteFlushList;
+    MI_FLUSH_GATHER FlushGather;
     PVOID UsedPageTableHandle;
     PMMPFN Pfn2;
     PSUBSECTION FirstSubsection;
@@ -293,7 +293,8 @@ Environment:
         MiPhysicalViewRemover(CurrentProcess, Vad);
 
         // Set count so only flush entire TB operations are performed.
-        PteFlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
+        MiInitializeFlushGather(&FlushGather, 0);
+        FlushGather.FlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
         PointerPde = MiGetPdeAddress(MI_VPN_TO_VA(Vad->StartingVpn));
         PointerPte = MiGetPteAddress(MI_VPN_TO_VA(Vad->StartingVpn));
         LastPte = MiGetPteAddress(MI_VPN_TO_VA(Vad->EndingVpn));
@@ -324,28 +325,28 @@ Environment:
                 // And if this results in an empty page directory page, then delete that too.
                 if (MI_GET_USED_PTES_FROM_HANDLE(UsedPageTableHandle) == 0) {
                     TempVa = MiGetVirtualAddressMappedByPte(PointerPde);
-                    PteFlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
+                    FlushGather.FlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
 
 #if (_MI_PAGING_LEVELS >= 3)
                     UsedPageDirectoryHandle = MI_GET_USED_PTES_HANDLE(PointerPte);
                     MI_DECREMENT_USED_PTES_BY_HANDLE(UsedPageDirectoryHandle);
 #endif
 
-                    MiDeletePte(PointerPde, TempVa, FALSE, CurrentProcess, NULL, &PteFlushList, OldIrql);
+                    MiDeletePte(PointerPde, TempVa, FALSE, CurrentProcess, NULL, &FlushGather, OldIrql);
                     CurrentProcess->NumberOfPrivatePages += 1;// Add back in the private page MiDeletePte subtracted.
 
 #if (_MI_PAGING_LEVELS >= 3)
                     if (MI_GET_USED_PTES_FROM_HANDLE(UsedPageDirectoryHandle) == 0) {
                         PointerPpe = MiGetPdeAddress(PointerPte);
                         TempVa = MiGetVirtualAddressMappedByPte(PointerPpe);
-                        PteFlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
+                        FlushGather.FlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
 
 #if (_MI_PAGING_LEVELS >= 4)
                         UsedPageDirectoryParentHandle = MI_GET_USED_PTES_HANDLE(PointerPde);
                         MI_DECREMENT_USED_PTES_BY_HANDLE(UsedPageDirectoryParentHandle);
 #endif
 
-                        MiDeletePte(PointerPpe, TempVa, FALSE, CurrentProcess, NULL, &PteFlushList, OldIrql);
+                        MiDeletePte(PointerPpe, TempVa, FALSE, CurrentProcess, NULL, &FlushGather, OldIrql);
 
                         // Add back in the private page MiDeletePte subtracted.
                         CurrentProcess->NumberOfPrivatePages += 1;
@@ -354,8 +355,8 @@ Environment:
                         if (MI_GET_USED_PTES_FROM_HANDLE(UsedPageDirectoryParentHandle) == 0) {
                             PointerPxe = MiGetPpeAddress(PointerPte);
                             TempVa = MiGetVirtualAddressMappedByPte(PointerPxe);
-                            PteFlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
-                            MiDeletePte(PointerPxe, TempVa, FALSE, CurrentProcess, NULL, &PteFlushList, OldIrql);
+                            FlushGather.FlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
+                            MiDeletePte(PointerPxe, TempVa, FALSE, CurrentProcess, NULL, &FlushGather, OldIrql);
                             CurrentProcess->NumberOfPrivatePages += 1;// Add back in the private page MiDeletePte subtracted.
                         }
 #endif
@@ -365,8 +366,10 @@ Environment:
                 }
                 PointerPte += 1;
             }
-            MI_FLUSH_PROCESS_TB(FALSE);
+            FlushGather.FlushList.Count = MM_MAXIMUM_FLUSH_COUNT;
+            MiFlushGather(&FlushGather);
             UNLOCK_PFN(OldIrql);
+            MiFreeFlushGather(&FlushGather);
             UNLOCK_WS_UNSAFE(CurrentThread, CurrentProcess);
             LOCK_PFN(OldIrql);
         }
@@ -166,7 +166,8 @@ Environment:
         CopyTo = MiMapPageInHyperSpace(CurrentProcess, NewPageIndex, &OldIrql);
     }
 
-    KeCopyPage(CopyTo, CopyFrom);
+    // The faulting thread is about to write to the new page so copy it with cached stores.
+    KeCopySinglePage(CopyTo, CopyFrom);
 
     if (MappingPte != NULL) {
         MiReleaseSystemPtes(MappingPte, 1, SystemPteSpace);
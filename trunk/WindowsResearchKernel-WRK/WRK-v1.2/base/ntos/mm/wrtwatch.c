@@ -15,6 +15,10 @@ Abstract:
 
 #define COPY_STACK_SIZE 256
 
+#define WRITE_WATCH_BITS_PER_WORD (sizeof(ULONG_PTR) * 8)
+
+ULONG_PTR MiGetWriteWatchBitMap(IN PMI_PHYSICAL_VIEW PhysicalView, IN PVOID BaseAddress, IN PVOID EndAddress, IN ULONG Flags, OUT PULONG DirtyBits);
+
 
 NTSTATUS NtGetWriteWatch(
     __in HANDLE ProcessHandle,
@@ -29,14 +33,16 @@ NTSTATUS NtGetWriteWatch(
 Routine Description:
     This function returns the write watch status of the argument region.
     UserAddressArray is filled with the base address of each page that has been written to since the last NtResetWriteWatch call (or if no NtResetWriteWatch calls have been made, then each page written since this address space was created).
+    If WRITE_WATCH_FLAG_BITMAP is specified, UserAddressArray instead receives a bitmap with one bit per page of the region, and the count returned is the number of bits set.
 Arguments:
     ProcessHandle - Supplies an open handle to a process object.
-    Flags - Supplies WRITE_WATCH_FLAG_RESET or nothing.
+    Flags - Supplies WRITE_WATCH_FLAG_RESET and/or WRITE_WATCH_FLAG_BITMAP, or nothing.
     BaseAddress - An address within a region of pages to be queried. This value must lie within a private memory region with the write-watch attribute already set.
     RegionSize - The size of the region in bytes beginning at the base address specified.
     UserAddressArray - Supplies a pointer to user memory to store the user addresses modified since the last reset.
     UserAddressArrayEntries - Supplies a pointer to how many user addresses can be returned in this call.
                               This is then filled with the exact number of addresses actually returned.
+                              For a bitmap query this is the number of ULONG_PTR bitmap words supplied, and must cover the whole region.
     Granularity - Supplies a pointer to a variable to receive the size of modified granule in bytes.
 Return Value:
     Various NTSTATUS codes.
@@ -67,6 +73,7 @@ Return Value:
     PMI_PHYSICAL_VIEW PhysicalView;
     ULONG_PTR PagesWritten;
     ULONG_PTR NumberOfPages;
+    ULONG_PTR BitMapWords;
     LOGICAL Attached;
     KPROCESSOR_MODE PreviousMode;
     PFN_NUMBER PageFrameIndex;
@@ -83,7 +90,7 @@ Return Value:
 
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
 
-    if ((Flags & ~WRITE_WATCH_FLAG_RESET) != 0) {
+    if ((Flags & ~(WRITE_WATCH_FLAG_RESET | WRITE_WATCH_FLAG_BITMAP)) != 0) {
         return STATUS_INVALID_PARAMETER_2;
     }
 
@@ -126,6 +133,19 @@ Return Value:
         return GetExceptionCode();
     }
 
+    // A bitmap query needs one bit per page of the region, rounded up to whole ULONG_PTRs.
+    // Only that many words are captured and returned no matter how large the caller's buffer is.
+    if (Flags & WRITE_WATCH_FLAG_BITMAP) {
+        BitMapWords = ((ULONG_PTR)ADDRESS_AND_SIZE_TO_SPAN_PAGES(BaseAddress, RegionSize) + WRITE_WATCH_BITS_PER_WORD - 1) / WRITE_WATCH_BITS_PER_WORD;
+        if (BitMapWords > NumberOfPages) {
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        if (BitMapWords != 0) {
+            NumberOfPages = BitMapWords;
+        }
+    }
+
     // Carefully probe and capture the user virtual address array.
     PoolArea = (PVOID)&StackArray[0];
     NumberOfBytes = NumberOfPages * sizeof(ULONG_PTR);
@@ -135,6 +155,10 @@ Return Value:
             return STATUS_INSUFFICIENT_RESOURCES;
         }
     }
+
+    if (Flags & WRITE_WATCH_FLAG_BITMAP) {
+        RtlZeroMemory(PoolArea, NumberOfBytes);
+    }
     PoolAreaPointer = (PVOID *)PoolArea;
     Attached = FALSE;
 
@@ -194,6 +218,13 @@ Return Value:
 
     ASSERT(Process->Flags & PS_PROCESS_FLAGS_USING_WRITE_WATCH);
 
+    if (Flags & WRITE_WATCH_FLAG_BITMAP) {
+        PagesWritten = MiGetWriteWatchBitMap(PhysicalView, BaseAddress, EndAddress, Flags, (PULONG)PoolArea);
+        UNLOCK_WS(CurrentThread, Process);
+        Status = STATUS_SUCCESS;
+        goto ErrorReturn;
+    }
+
     // Extract the write watch status for each page in the range.
     // Note the PFN lock must be held to ensure atomicity.
     BitMap = PhysicalView->u.BitMap;
@@ -375,7 +406,11 @@ ErrorReturn:
     if (Status == STATUS_SUCCESS) {
         // Return all results to the caller.
         try {
-            RtlCopyMemory(UserAddressArray, PoolArea, PagesWritten * sizeof(PVOID));
+            if (Flags & WRITE_WATCH_FLAG_BITMAP) {
+                RtlCopyMemory(UserAddressArray, PoolArea, NumberOfBytes);
+            } else {
+                RtlCopyMemory(UserAddressArray, PoolArea, PagesWritten * sizeof(PVOID));
+            }
             *EntriesInUserAddressArray = PagesWritten;
             *Granularity = PAGE_SIZE;
         } except(ExSystemExceptionFilter())
@@ -603,6 +638,172 @@ ErrorReturn:
 }
 
 
+ULONG_PTR MiGetWriteWatchBitMap(IN PMI_PHYSICAL_VIEW PhysicalView, IN PVOID BaseAddress, IN PVOID EndAddress, IN ULONG Flags, OUT PULONG DirtyBits)
+/*
+Routine Description:
+    This routine builds a bitmap of the pages in the argument range written since the last reset.
+    The bits captured in the write watch bitmap are copied a page table page at a time, skipping zero words.
+    Hardware dirty bits are only examined beneath page directory entries that are valid and have their accessed bit set,
+    so a page table page nobody has touched since the last bitmap reset costs a single PDE read.
+
+    When WRITE_WATCH_FLAG_RESET is specified the write watch bits are cleared, dirty PTEs are made clean and the accessed bit
+    of every page directory entry whose entire page table page lies in the range is cleared.
+    A single flush of the process TB is issued at the end instead of one flush per PTE, which also guarantees that the next
+    access through a reset page directory entry sets its accessed bit again.
+Arguments:
+    PhysicalView - Supplies the write watch physical view describing the range.
+    BaseAddress - Supplies the first address of the range.
+    EndAddress - Supplies the last address of the range.
+    Flags - Supplies WRITE_WATCH_FLAG_RESET or nothing.
+    DirtyBits - Supplies a zeroed buffer to receive one bit per page of the range.
+Return Value:
+    The number of pages written in the range.
+Environment:
+    Kernel mode, APCs disabled, working set mutex held, attached to the target process.
+*/
+{
+    PMMVAD Vad;
+    PMMPFN Pfn1;
+    KIRQL OldIrql;
+    PMMPTE PointerPte;
+    PMMPTE PointerPde;
+#if (_MI_PAGING_LEVELS >= 3)
+    PMMPTE PointerPpe;
+#endif
+#if (_MI_PAGING_LEVELS >= 4)
+    PMMPTE PointerPxe;
+#endif
+    PMMPTE NextPte;
+    PMMPTE LastPte;
+    PMMPTE EndPte;
+    MMPTE PteContents;
+    MMPTE TempPte;
+    MMPTE PreviousPte;
+    PRTL_BITMAP BitMap;
+    ULONG BitMapIndex;
+    ULONG SpanIndex;
+    ULONG SpanEnd;
+    ULONG OutputIndex;
+    ULONG WorkingSetIndex;
+    PFN_NUMBER PageFrameIndex;
+    ULONG_PTR PagesWritten;
+    LOGICAL ScanPtes;
+    LOGICAL FlushTb;
+
+    Vad = PhysicalView->Vad;
+    BitMap = PhysicalView->u.BitMap;
+    PointerPte = MiGetPteAddress(BaseAddress);
+    EndPte = MiGetPteAddress(EndAddress);
+    BaseAddress = MiGetVirtualAddressMappedByPte(PointerPte);
+    BitMapIndex = (ULONG)(((PCHAR)BaseAddress - (PCHAR)(Vad->StartingVpn << PAGE_SHIFT)) >> PAGE_SHIFT);
+    ASSERT(BitMapIndex + (EndPte - PointerPte) < BitMap->SizeOfBitMap);
+
+    OutputIndex = 0;
+    PagesWritten = 0;
+    FlushTb = FALSE;
+
+    LOCK_PFN(OldIrql);
+    while (PointerPte <= EndPte) {
+        // Find the end of the stride covered by the current paging structure.
+        // An invalid upper level covers everything beneath it, and the dirty bits there have already been captured to the write watch bitmap.
+        ScanPtes = FALSE;
+        PointerPde = MiGetPteAddress(PointerPte);
+#if (_MI_PAGING_LEVELS >= 4)
+        PointerPxe = MiGetPpeAddress(PointerPte);
+        if (PointerPxe->u.Hard.Valid == 0) {
+            NextPte = MiGetVirtualAddressMappedByPte(MiGetVirtualAddressMappedByPte(MiGetVirtualAddressMappedByPte(PointerPxe + 1)));
+        } else
+#endif
+#if (_MI_PAGING_LEVELS >= 3)
+        if ((PointerPpe = MiGetPdeAddress(PointerPte))->u.Hard.Valid == 0) {
+            NextPte = MiGetVirtualAddressMappedByPte(MiGetVirtualAddressMappedByPte(PointerPpe + 1));
+        } else
+#endif
+        {
+            NextPte = MiGetVirtualAddressMappedByPte(PointerPde + 1);
+
+            // A clear accessed bit means no translation has gone through this page directory entry since a bitmap reset cleared it and flushed the TB.
+            // No PTE beneath it can have been dirtied since then.
+            if ((PointerPde->u.Hard.Valid == 1) && (PointerPde->u.Hard.Accessed == 1)) {
+                ScanPtes = TRUE;
+            }
+        }
+
+        LastPte = (NextPte > EndPte) ? (EndPte + 1) : NextPte;
+
+        // Copy the captured write watch bits for the stride, a zero word at a time where possible.
+        SpanIndex = BitMapIndex;
+        SpanEnd = BitMapIndex + (ULONG)(LastPte - PointerPte);
+        while (SpanIndex < SpanEnd) {
+            if (((SpanIndex & 0x1F) == 0) && (SpanIndex + 32 <= SpanEnd) && (BitMap->Buffer[SpanIndex >> 5] == 0)) {
+                SpanIndex += 32;
+                continue;
+            }
+
+            if (MI_CHECK_BIT(BitMap->Buffer, SpanIndex)) {
+                MI_SET_BIT(DirtyBits, OutputIndex + (SpanIndex - BitMapIndex));
+                PagesWritten += 1;
+            }
+            SpanIndex += 1;
+        }
+
+        if (Flags & WRITE_WATCH_FLAG_RESET) {
+            RtlClearBits(BitMap, BitMapIndex, SpanEnd - BitMapIndex);
+        }
+
+        if (ScanPtes == TRUE) {
+            // Merge in the hardware dirty bits of the valid PTEs in this page table page.
+            for (SpanIndex = 0; PointerPte + SpanIndex < LastPte; SpanIndex += 1) {
+                PteContents = PointerPte[SpanIndex];
+                if ((PteContents.u.Hard.Valid == 0) || (!MI_IS_PTE_DIRTY(PteContents))) {
+                    continue;
+                }
+
+                ASSERT(MI_PFN_ELEMENT(MI_GET_PAGE_FRAME_FROM_PTE(&PteContents))->u3.e1.PrototypePte == 0);
+                if (MI_CHECK_BIT(DirtyBits, OutputIndex + SpanIndex) == 0) {
+                    MI_SET_BIT(DirtyBits, OutputIndex + SpanIndex);
+                    PagesWritten += 1;
+                }
+
+                if (Flags & WRITE_WATCH_FLAG_RESET) {
+                    // The PTE writable bit must be disabled so future writes trigger write watch updates.
+                    // The TB is flushed once for the whole range below.
+                    PageFrameIndex = MI_GET_PAGE_FRAME_FROM_PTE(&PteContents);
+                    Pfn1 = MI_PFN_ELEMENT(PageFrameIndex);
+                    MI_MAKE_VALID_USER_PTE(TempPte, PageFrameIndex, Pfn1->OriginalPte.u.Soft.Protection, &PointerPte[SpanIndex]);
+                    WorkingSetIndex = MI_GET_WORKING_SET_FROM_PTE(&PteContents);
+                    MI_SET_PTE_IN_WORKING_SET(&TempPte, WorkingSetIndex);
+                    PreviousPte = PointerPte[SpanIndex];
+                    ASSERT(PreviousPte.u.Hard.Valid == 1);
+                    MI_WRITE_VALID_PTE_NEW_PROTECTION(&PointerPte[SpanIndex], TempPte);
+                    MI_CAPTURE_DIRTY_BIT_TO_PFN(&PreviousPte, Pfn1);
+                    FlushTb = TRUE;
+                }
+            }
+
+            // Only a page table page lying entirely in the range may have its accessed bit cleared, otherwise dirty PTEs outside the range would later be skipped.
+            if ((Flags & WRITE_WATCH_FLAG_RESET) && (MiIsPteOnPdeBoundary(PointerPte)) && (LastPte == NextPte)) {
+                TempPte = *PointerPde;
+                TempPte.u.Hard.Accessed = 0;
+                MI_WRITE_VALID_PTE_NEW_PROTECTION(PointerPde, TempPte);
+                FlushTb = TRUE;
+            }
+        }
+
+        OutputIndex += (ULONG)(LastPte - PointerPte);
+        BitMapIndex = SpanEnd;
+        PointerPte = LastPte;
+    }
+
+    if (FlushTb == TRUE) {
+        MI_FLUSH_PROCESS_TB(FALSE);
+    }
+
+    UNLOCK_PFN(OldIrql);
+    return PagesWritten;
+}
+
+
 VOID MiCaptureWriteWatchDirtyBit(IN PEPROCESS Process, IN PVOID VirtualAddress)
 /*
 Routine Description:
@@ -2445,6 +2445,12 @@ Environment:
 }
 
 
+// An age based trim examines at most this many entries for each page it is asked to remove (but never fewer than the minimum),
+// resuming where the last trim of the working set stopped.
+#define MI_TRIM_SCAN_FACTOR 16
+#define MI_MINIMUM_TRIM_SCAN 1024
+
+
 WSLE_NUMBER MiTrimWorkingSet(IN WSLE_NUMBER Reduction, IN PMMSUPPORT WsInfo, IN ULONG TrimAge)
 /*
 Routine Description:
@@ -2455,11 +2461,14 @@ Arguments:
     TrimAge - Supplies the age value to use - ie: pages of this age or older will be removed.
 Return Value:
     Returns the actual number of pages removed.
+    An age based trim of a large working set with few old pages may remove fewer pages than requested
+    because it stops after a bounded number of entries, the next trim carries on from there.
 Environment:
     Kernel mode, APCs disabled, working set lock.
     PFN lock NOT held.
 */
 {
+    WSLE_NUMBER ScanLimit;
     WSLE_NUMBER TryToFree;
     WSLE_NUMBER StartEntry;
     WSLE_NUMBER LastEntry;
@@ -2482,6 +2491,15 @@ Environment:
     }
     StartEntry = TryToFree;
 
+    // A trim with no age takes any page, so it may still walk the whole list.
+    ScanLimit = LastEntry + 1;
+    if ((TrimAge != 0) && (Reduction <= LastEntry / MI_TRIM_SCAN_FACTOR)) {
+        ScanLimit = Reduction * MI_TRIM_SCAN_FACTOR;
+        if (ScanLimit < MI_MINIMUM_TRIM_SCAN) {
+            ScanLimit = MI_MINIMUM_TRIM_SCAN;
+        }
+    }
+
 TrimMore:
     while (NumberLeftToRemove != 0) {
         if (Wsle[TryToFree].u1.e1.Valid == 1) {
@@ -2507,13 +2525,18 @@ TrimMore:
         if (TryToFree == StartEntry) {
             break;
         }
+
+        ScanLimit -= 1;
+        if (ScanLimit == 0) {
+            break;
+        }
     }
 
     if (WsleFlushList.Count != 0) {
         NumberNotFlushed = MiFreeWsleList(WsInfo, &WsleFlushList);
         NumberLeftToRemove += NumberNotFlushed;
         if (NumberLeftToRemove != 0) {
-            if (TryToFree != StartEntry) {
+            if ((TryToFree != StartEntry) && (ScanLimit != 0)) {
                 WsleFlushList.Count = 0;
                 goto TrimMore;
             }
@@ -92,13 +92,39 @@ typedef struct _MMWS_TRIM_CRITERIA
 } MMWS_TRIM_CRITERIA, *PMMWS_TRIM_CRITERIA;
 
 ULONG MiComputeSystemTrimCriteria(IN OUT PMMWS_TRIM_CRITERIA Criteria);
+VOID MiNotifyMemoryPressure(IN PFN_NUMBER Available, IN ULONG StandbyRemoved);
 LOGICAL MiCheckSystemTrimEndCriteria(IN OUT PMMWS_TRIM_CRITERIA Criteria, IN KIRQL OldIrql);
 WSLE_NUMBER MiDetermineTrimAmount(IN PMMWS_TRIM_CRITERIA Criteria, IN PMMSUPPORT VmSupport);
 VOID MiProcessWorkingSets(IN ULONG WorkingSetRequest, IN PMMWS_TRIM_CRITERIA TrimCriteria);
+VOID MiProcessWorkingSetRound(IN ULONG WorkingSetRequestFlags, IN PMMWS_TRIM_CRITERIA TrimCriteria, IN PLARGE_INTEGER CurrentTime, IN OUT PWSLE_NUMBER WslesScanned, IN KIRQL OldIrql);
 VOID MiAdjustClaimParameters(IN LOGICAL EnoughPages);
 VOID MiRearrangeWorkingSetExpansionList(VOID);
 VOID MiCaptureAndResetWorkingSetAccessBits(IN PMMSUPPORT WsInfo, IN ULONG Flags);
 
+#if defined(MI_MULTINODE)
+
+// On ccNUMA systems each node other than node zero has a worker thread that runs every round of aging or trimming together with the working set manager.
+// The threads take working sets off the expansion list one at a time just as the working set manager does, so a large number of working sets is
+// processed by all of them at once. The workers are only touched by the working set manager, which waits for all of them at the end of each round.
+typedef struct _MI_WS_WORKER {
+    KEVENT WorkEvent;
+    MMWS_TRIM_CRITERIA TrimCriteria;
+    WSLE_NUMBER WslesScanned;
+} MI_WS_WORKER, *PMI_WS_WORKER;
+
+MI_WS_WORKER MiWsWorkers[MAXIMUM_CCNUMA_NODES];
+ULONG MiWsWorkerNodes;              // Bitmask of the nodes that have a worker thread
+LONG MiWsWorkersActive;
+KEVENT MiWsWorkersDoneEvent;
+ULONG MiWsRoundFlags;
+LARGE_INTEGER MiWsRoundTime;
+
+VOID MiStartWorkingSetWorkers(VOID);
+VOID MiWorkingSetWorkerThread(IN PVOID Context);
+VOID MiDispatchWorkingSetWorkers(IN ULONG WorkingSetRequestFlags, IN PMMWS_TRIM_CRITERIA TrimCriteria, IN PLARGE_INTEGER CurrentTime);
+VOID MiWaitForWorkingSetWorkers(IN OUT PMMWS_TRIM_CRITERIA TrimCriteria, IN OUT PWSLE_NUMBER WslesScanned, IN KIRQL OldIrql);
+#endif
+
 
 VOID MiAdjustWorkingSetManagerParameters(IN LOGICAL WorkStation)
 /*
@@ -359,6 +385,12 @@ Environment:
     if (Initialized == 0) {
         PsGetCurrentThread()->MemoryMaker = 1;
         Initialized = 1;
+
+#if defined(MI_MULTINODE)
+        if (KeNumberNodes > 1) {
+            MiStartWorkingSetWorkers();
+        }
+#endif
     }
 
 #if DBG
@@ -432,6 +464,8 @@ Environment:
         }
     }
 
+    MiNotifyMemoryPressure(Available, StandbyRemoved);
+
     // MmPlentyFreePages can change dynamically, so snap it now.
     PlentyFreePages = MmPlentyFreePages;
 
@@ -487,6 +521,101 @@ Environment:
 }
 
 
+// The current memory pressure level and the available pages at the previous sample, both only touched by the working set manager.
+MM_MEMORY_PRESSURE MiMemoryPressure;
+PFN_NUMBER MiLastPressureAvailable;
+
+#define MI_RAISE_PRESSURE(NewLevel, TheLevel, TheReason) \
+    if ((TheLevel) > (NewLevel)) {                       \
+        (NewLevel) = (TheLevel);                         \
+    }                                                    \
+    Information.Reasons |= (TheReason);
+
+
+VOID MiNotifyMemoryPressure(IN PFN_NUMBER Available, IN ULONG StandbyRemoved)
+/*
+Routine Description:
+    This routine computes the memory pressure level from the available pages, how fast they are falling, the standby pages being repurposed,
+    the modified page backlog and the commit headroom, and notifies the memory pressure callbacks when the level changes.
+    The level rises at once but falls by one level per sample so callbacks are not notified again and again around a threshold.
+Arguments:
+    Available - Supplies the number of available pages.
+    StandbyRemoved - Supplies the number of standby pages repurposed since the previous sample.
+Environment:
+    Kernel mode, PASSIVE_LEVEL, working set manager.  No locks held.
+*/
+{
+    MM_MEMORY_PRESSURE NewLevel;
+    MM_MEMORY_PRESSURE_INFORMATION Information;
+    PFN_NUMBER Falling;
+    SIZE_T Committed;
+    SIZE_T CommitLimit;
+
+    NewLevel = MmPressureNone;
+    Information.Reasons = 0;
+
+    if (Available < MmLowMemoryThreshold / 2) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureHigh, MM_PRESSURE_AVAILABLE_PAGES);
+    } else if (Available < MmLowMemoryThreshold) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureMedium, MM_PRESSURE_AVAILABLE_PAGES);
+    } else if (Available < MmHighMemoryThreshold) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureLow, MM_PRESSURE_AVAILABLE_PAGES);
+    }
+
+    // Anticipate the thresholds that the available pages would cross within a few samples at the rate they are falling.
+    if (MiLastPressureAvailable > Available) {
+        Falling = 4 * (MiLastPressureAvailable - Available);
+        if (Available < MmLowMemoryThreshold + Falling) {
+            MI_RAISE_PRESSURE(NewLevel, MmPressureMedium, MM_PRESSURE_AVAILABLE_FALLING);
+        } else if (Available < MmHighMemoryThreshold + Falling) {
+            MI_RAISE_PRESSURE(NewLevel, MmPressureLow, MM_PRESSURE_AVAILABLE_FALLING);
+        }
+    }
+
+    MiLastPressureAvailable = Available;
+
+    // Standby pages that are repurposed never get the chance to be soft faulted back, the more of them the younger the standby list.
+    if (StandbyRemoved >= (Available >> 2)) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureMedium, MM_PRESSURE_STANDBY_REPURPOSED);
+    } else if ((StandbyRemoved != 0) && (StandbyRemoved >= (Available >> 4))) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureLow, MM_PRESSURE_STANDBY_REPURPOSED);
+    }
+
+    if (MmModifiedPageListHead.Total >= 2 * MmModifiedPageMaximum) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureMedium, MM_PRESSURE_MODIFIED_BACKLOG);
+    } else if (MmModifiedPageListHead.Total >= MmModifiedPageMaximum) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureLow, MM_PRESSURE_MODIFIED_BACKLOG);
+    }
+
+    // The headroom is measured against the maximum commit limit as the paging files can still grow up to it.
+    Committed = MmTotalCommittedPages;
+    CommitLimit = MmTotalCommitLimitMaximum;
+    Information.CommitHeadroom = (CommitLimit > Committed) ? (CommitLimit - Committed) : 0;
+    if (Information.CommitHeadroom < CommitLimit / 32) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureHigh, MM_PRESSURE_COMMIT_HEADROOM);
+    } else if (Information.CommitHeadroom < CommitLimit / 16) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureMedium, MM_PRESSURE_COMMIT_HEADROOM);
+    } else if (Information.CommitHeadroom < CommitLimit / 8) {
+        MI_RAISE_PRESSURE(NewLevel, MmPressureLow, MM_PRESSURE_COMMIT_HEADROOM);
+    }
+
+    if (NewLevel < MiMemoryPressure) {
+        NewLevel = (MM_MEMORY_PRESSURE)(MiMemoryPressure - 1);
+    }
+
+    if (NewLevel == MiMemoryPressure) {
+        return;
+    }
+
+    MiMemoryPressure = NewLevel;
+    Information.Level = NewLevel;
+    Information.AvailablePages = Available;
+    Information.StandbyRepurposed = StandbyRemoved;
+    Information.ModifiedPages = MmModifiedPageListHead.Total;
+    ExNotifyCallback(ExCbMemoryPressure, (PVOID)(ULONG_PTR)NewLevel, &Information);
+}
+
+
 LOGICAL MiCheckSystemTrimEndCriteria(IN PMMWS_TRIM_CRITERIA Criteria, IN KIRQL OldIrql)
 /*
 Routine Description:
@@ -547,6 +676,7 @@ VOID MiProcessWorkingSets(IN ULONG WorkingSetRequestFlags, IN PMMWS_TRIM_CRITERI
 /*
 Routine Description:
     Walk through the sets on the working set expansion list, taking action as specified by the argument request.
+    Each pass over the list is a round run by MiProcessWorkingSetRound, on the worker threads of the other nodes as well as this thread.
 Arguments:
     WorkingSetRequestFlags - Supplies the working set request flags to apply to all the working sets.
     TrimCriteria - Supplies relevant trim/aging criteria.
@@ -555,10 +685,7 @@ Environment:
     PFN lock NOT held.
 */
 {
-    PLIST_ENTRY ListEntry;
-    WSLE_NUMBER Trim;
     KIRQL OldIrql;
-    PMMSUPPORT VmSupport;
     LARGE_INTEGER CurrentTime;
     WSLE_NUMBER WslesScanned;
     ULONG WorkingSetRequestFlagsDone;
@@ -574,6 +701,84 @@ Environment:
 
     LOCK_EXPANSION(OldIrql);
 
+    while (!IsListEmpty(&MmWorkingSetExpansionHead.ListHead)) {
+#if defined(MI_MULTINODE)
+        MiDispatchWorkingSetWorkers(WorkingSetRequestFlags, TrimCriteria, &CurrentTime);
+#endif
+
+        MiProcessWorkingSetRound(WorkingSetRequestFlags, TrimCriteria, &CurrentTime, &WslesScanned, OldIrql);
+
+#if defined(MI_MULTINODE)
+        MiWaitForWorkingSetWorkers(TrimCriteria, &WslesScanned, OldIrql);
+#endif
+
+        if (IsListEmpty(&MmWorkingSetExpansionHead.ListHead)) {
+            break;
+        }
+
+        // Every working set on the list has been here in this round.
+        // If we aren't finished we may sleep in MiCheck.
+        if ((WorkingSetRequestFlags & MI_TRIM_ALL_WORKING_SETS) && (MiCheckSystemTrimEndCriteria(TrimCriteria, OldIrql)) == FALSE) {
+            KeQuerySystemTime(&CurrentTime);// Start a new round of trimming.
+            continue;
+        }
+
+        // No more pages are needed.
+        // If no new requests have been queued, then we're done.
+        WorkingSetRequestFlags &= ~(MI_TRIM_ALL_WORKING_SETS | MI_AGE_ALL_WORKING_SETS);
+        WorkingSetRequestFlagsDone |= WorkingSetRequestFlags;
+        if (WorkingSetRequestFlagsDone != MiWorkingSetRequestFlags) {
+            // Some other thread has made an additional request(s) so pick up the new bits and process them now before returning.
+            WorkingSetRequestFlags = (WorkingSetRequestFlagsDone ^ MiWorkingSetRequestFlags);
+            ASSERT((WorkingSetRequestFlags & ~MI_WORKING_SET_FLAGS) == 0);
+            ASSERT(WorkingSetRequestFlags != 0);
+            KeQuerySystemTime(&CurrentTime);
+            continue;
+        }
+
+        if (MiWorkingSetRequestFlags != 0) {
+            // Clear all the flags and wake any waiters since every request has been processed.
+            MiWorkingSetRequestFlags = 0;
+            KeSetEvent(&MiWorkingSetRequestEvent, 0, FALSE);
+        }
+
+        break;
+    }
+
+    if (WorkingSetRequestFlags & (MI_TRIM_ALL_WORKING_SETS | MI_AGE_ALL_WORKING_SETS)) {
+        MmTotalClaim = TrimCriteria->NewTotalClaim;
+        MmTotalEstimatedAvailable = TrimCriteria->NewTotalEstimatedAvailable;
+    }
+
+    UNLOCK_EXPANSION(OldIrql);
+
+    if (WorkingSetRequestFlags & MI_AGE_ALL_WORKING_SETS) {
+        MiAdjustClaimParameters(TRUE);
+    }
+}
+
+
+VOID MiProcessWorkingSetRound(IN ULONG WorkingSetRequestFlags, IN PMMWS_TRIM_CRITERIA TrimCriteria, IN PLARGE_INTEGER CurrentTime, IN OUT PWSLE_NUMBER WslesScanned, IN KIRQL OldIrql)
+/*
+Routine Description:
+    Take the working sets off the expansion list one at a time, applying the request to each one that has not been here in this round.
+    The round is over when the working set at the head of the list has already been stamped with the time of the round, it is left at the head.
+    Any number of threads may run the same round at once.
+Arguments:
+    WorkingSetRequestFlags - Supplies the working set request flags to apply to all the working sets.
+    TrimCriteria - Supplies relevant trim/aging criteria, the claim and estimate of each working set are added to it.
+    CurrentTime - Supplies the time that identifies the round.
+    WslesScanned - Supplies the number of entries this thread has scanned so far in the sweep and returns it updated.
+    OldIrql - Supplies the old IRQL to lower to when the expansion lock is released.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+    Expansion lock held, it is released while each working set is processed.
+*/
+{
+    PLIST_ENTRY ListEntry;
+    WSLE_NUMBER Trim;
+    PMMSUPPORT VmSupport;
+
     while (!IsListEmpty(&MmWorkingSetExpansionHead.ListHead)) {
         // Remove the entry at the head and operate on it.
         ListEntry = RemoveHeadList(&MmWorkingSetExpansionHead.ListHead);
@@ -583,35 +788,9 @@ Environment:
         ASSERT(VmSupport->WorkingSetExpansionLinks.Flink != MM_WS_TRIMMING);
 
         // Check to see if we've been here before.
-        if (VmSupport->LastTrimTime.QuadPart == CurrentTime.QuadPart) {
+        if (VmSupport->LastTrimTime.QuadPart == CurrentTime->QuadPart) {
             InsertHeadList(&MmWorkingSetExpansionHead.ListHead, &VmSupport->WorkingSetExpansionLinks);
-
-            // If we aren't finished we may sleep in MiCheck.
-            if ((WorkingSetRequestFlags & MI_TRIM_ALL_WORKING_SETS) && (MiCheckSystemTrimEndCriteria(TrimCriteria, OldIrql)) == FALSE) {
-                KeQuerySystemTime(&CurrentTime);// Start a new round of trimming.
-                continue;
-            }
-
-            // No more pages are needed.
-            // If no new requests have been queued, then we're done.
-            WorkingSetRequestFlags &= ~(MI_TRIM_ALL_WORKING_SETS | MI_AGE_ALL_WORKING_SETS);
-            WorkingSetRequestFlagsDone |= WorkingSetRequestFlags;
-            if (WorkingSetRequestFlagsDone != MiWorkingSetRequestFlags) {
-                // Some other thread has made an additional request(s) so pick up the new bits and process them now before returning.
-                WorkingSetRequestFlags = (WorkingSetRequestFlagsDone ^ MiWorkingSetRequestFlags);
-                ASSERT((WorkingSetRequestFlags & ~MI_WORKING_SET_FLAGS) == 0);
-                ASSERT(WorkingSetRequestFlags != 0);
-                KeQuerySystemTime(&CurrentTime);
-                continue;
-            }
-
-            if (MiWorkingSetRequestFlags != 0) {
-                // Clear all the flags and wake any waiters since every request has been processed.
-                MiWorkingSetRequestFlags = 0;
-                KeSetEvent(&MiWorkingSetRequestEvent, 0, FALSE);
-            }
-
-            break;
+            return;
         }
 
         // Only attach if the working set is worth examining.
@@ -621,7 +800,7 @@ Environment:
             continue;
         }
 
-        VmSupport->LastTrimTime = CurrentTime;
+        VmSupport->LastTrimTime = *CurrentTime;
         VmSupport->WorkingSetExpansionLinks.Flink = MM_WS_TRIMMING;
         VmSupport->WorkingSetExpansionLinks.Blink = NULL;
 
@@ -647,7 +826,7 @@ Environment:
                 // Aging is only done if the trim pass warrants it (ie: the first pass only).
                 MiAgeWorkingSet(VmSupport, TrimCriteria->DoAging, NULL, &TrimCriteria->NewTotalClaim, &TrimCriteria->NewTotalEstimatedAvailable);
             } else if (WorkingSetRequestFlags & MI_AGE_ALL_WORKING_SETS) {
-                MiAgeWorkingSet(VmSupport, TRUE, &WslesScanned, &TrimCriteria->NewTotalClaim, &TrimCriteria->NewTotalEstimatedAvailable);
+                MiAgeWorkingSet(VmSupport, TRUE, WslesScanned, &TrimCriteria->NewTotalClaim, &TrimCriteria->NewTotalEstimatedAvailable);
             }
 
             if (WorkingSetRequestFlags & MI_CAPTURE_AND_RESET_ALL_ACCESS_BITS) {
@@ -682,18 +861,153 @@ Environment:
             KeSetEvent((PKEVENT)VmSupport->WorkingSetExpansionLinks.Blink, 0, FALSE);
         }
     }
+}
 
-    if (WorkingSetRequestFlags & (MI_TRIM_ALL_WORKING_SETS | MI_AGE_ALL_WORKING_SETS)) {
-        MmTotalClaim = TrimCriteria->NewTotalClaim;
-        MmTotalEstimatedAvailable = TrimCriteria->NewTotalEstimatedAvailable;
+
+#if defined(MI_MULTINODE)
+VOID MiStartWorkingSetWorkers(VOID)
+/*
+Routine Description:
+    This routine starts a working set worker thread for each node other than node zero.
+    A node whose thread can't be created is just left to the other threads.
+Environment:
+    Kernel mode, PASSIVE_LEVEL, called by the working set manager the first time it runs.
+*/
+{
+    ULONG i;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ThreadHandle;
+
+    KeInitializeEvent(&MiWsWorkersDoneEvent, SynchronizationEvent, FALSE);
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    for (i = 1; i < KeNumberNodes; i += 1) {
+        KeInitializeEvent(&MiWsWorkers[i].WorkEvent, SynchronizationEvent, FALSE);
+        if (NT_SUCCESS(PsCreateSystemThread(&ThreadHandle, THREAD_ALL_ACCESS, &ObjectAttributes, 0L, NULL, MiWorkingSetWorkerThread, (PVOID)(ULONG_PTR)i))) {
+            ZwClose(ThreadHandle);
+            MiWsWorkerNodes |= (1 << i);
+        }
+    }
+}
+
+
+VOID MiWorkingSetWorkerThread(IN PVOID Context)
+/*
+Routine Description:
+    This routine is the working set worker thread of a single node.
+    It runs each round of aging or trimming that the working set manager hands it, on the processors of the node.
+Arguments:
+    Context - Supplies the number of the node.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    KIRQL OldIrql;
+    PKNODE NodeBlock;
+    PETHREAD Thread;
+    PMI_WS_WORKER Worker;
+
+    Worker = &MiWsWorkers[(ULONG)(ULONG_PTR)Context];
+    NodeBlock = KeNodeBlock[(ULONG)(ULONG_PTR)Context];
+
+    // Run at the priority of the balance set manager so the rounds are not held up by the threads that are using up the memory.
+    Thread = PsGetCurrentThread();
+    Thread->MemoryMaker = 1;
+    KeSetPriorityThread(&Thread->Tcb, LOW_REALTIME_PRIORITY);
+    if (NodeBlock->ProcessorMask != 0) {
+        KeSetSystemAffinityThread(NodeBlock->ProcessorMask);
+    }
+
+    do {
+        KeWaitForSingleObject(&Worker->WorkEvent, WrVirtualMemory, KernelMode, FALSE, NULL);
+
+        LOCK_EXPANSION(OldIrql);
+        MiProcessWorkingSetRound(MiWsRoundFlags, &Worker->TrimCriteria, &MiWsRoundTime, &Worker->WslesScanned, OldIrql);
+        UNLOCK_EXPANSION(OldIrql);
+
+        if (InterlockedDecrement(&MiWsWorkersActive) == 0) {
+            KeSetEvent(&MiWsWorkersDoneEvent, 0, FALSE);
+        }
+    } while (TRUE);
+}
+
+
+VOID MiDispatchWorkingSetWorkers(IN ULONG WorkingSetRequestFlags, IN PMMWS_TRIM_CRITERIA TrimCriteria, IN PLARGE_INTEGER CurrentTime)
+/*
+Routine Description:
+    This routine hands the round about to be run by the working set manager to the worker threads.
+    Requests to empty working sets or to capture access bits are rare and are left to the working set manager alone.
+Arguments:
+    WorkingSetRequestFlags - Supplies the working set request flags of the round.
+    TrimCriteria - Supplies the trim/aging criteria of the round.
+    CurrentTime - Supplies the time that identifies the round.
+Environment:
+    Kernel mode, expansion lock held.
+*/
+{
+    ULONG i;
+    PMI_WS_WORKER Worker;
+
+    if ((MiWsWorkerNodes == 0) || (WorkingSetRequestFlags & ~(MI_TRIM_ALL_WORKING_SETS | MI_AGE_ALL_WORKING_SETS))) {
+        return;
+    }
+
+    ASSERT(MiWsWorkersActive == 0);
+    MiWsRoundFlags = WorkingSetRequestFlags;
+    MiWsRoundTime = *CurrentTime;
+    for (i = 1; i < KeNumberNodes; i += 1) {
+        if (MiWsWorkerNodes & (1 << i)) {
+            // Each worker needs its own copy of the criteria as the trim age is chosen separately for every working set.
+            Worker = &MiWsWorkers[i];
+            Worker->TrimCriteria = *TrimCriteria;
+            Worker->TrimCriteria.NewTotalClaim = 0;
+            Worker->TrimCriteria.NewTotalEstimatedAvailable = 0;
+            Worker->WslesScanned = 0;
+            MiWsWorkersActive += 1;
+        }
+    }
+
+    for (i = 1; i < KeNumberNodes; i += 1) {
+        if (MiWsWorkerNodes & (1 << i)) {
+            KeSetEvent(&MiWsWorkers[i].WorkEvent, 0, FALSE);
+        }
+    }
+}
+
+
+VOID MiWaitForWorkingSetWorkers(IN OUT PMMWS_TRIM_CRITERIA TrimCriteria, IN OUT PWSLE_NUMBER WslesScanned, IN KIRQL OldIrql)
+/*
+Routine Description:
+    This routine waits for the worker threads to finish the current round and adds their claims and estimates to the criteria.
+Arguments:
+    TrimCriteria - Supplies the trim/aging criteria of the working set manager.
+    WslesScanned - Supplies the number of entries scanned by the working set manager and returns it with those of the workers added.
+    OldIrql - Supplies the old IRQL to lower to when the expansion lock is released.
+Environment:
+    Kernel mode, PASSIVE_LEVEL, expansion lock held. The lock is released while waiting.
+*/
+{
+    ULONG i;
+    PMI_WS_WORKER Worker;
+
+    if (MiWsWorkersActive == 0) {
+        return;
     }
 
     UNLOCK_EXPANSION(OldIrql);
+    KeWaitForSingleObject(&MiWsWorkersDoneEvent, WrVirtualMemory, KernelMode, FALSE, NULL);
+    LOCK_EXPANSION(OldIrql);
 
-    if (WorkingSetRequestFlags & MI_AGE_ALL_WORKING_SETS) {
-        MiAdjustClaimParameters(TRUE);
+    ASSERT(MiWsWorkersActive == 0);
+    for (i = 1; i < KeNumberNodes; i += 1) {
+        if (MiWsWorkerNodes & (1 << i)) {
+            Worker = &MiWsWorkers[i];
+            TrimCriteria->NewTotalClaim += Worker->TrimCriteria.NewTotalClaim;
+            TrimCriteria->NewTotalEstimatedAvailable += Worker->TrimCriteria.NewTotalEstimatedAvailable;
+            *WslesScanned += Worker->WslesScanned;
+        }
     }
 }
+#endif
 
 
 WSLE_NUMBER MiDetermineTrimAmount(PMMWS_TRIM_CRITERIA Criteria, PMMSUPPORT VmSupport)
@@ -29,6 +29,95 @@ ULONG MiWslePteLoops = 16;
 VOID MiRepointWsleHashIndex(IN MMWSLE WsleEntry, IN PMMWSL WorkingSetList, IN WSLE_NUMBER NewWsIndex);
 VOID MiCheckWsleHash(IN PMMWSL WorkingSetList);
 
+// The working set list hash is an open addressed table with linear probing.
+// Every key is stored in the run of occupied slots that starts at its home slot, with no free slot in between,
+// so a lookup ends at the first free slot it reaches. Since the table is kept at most three quarters full this is
+// usually within the cache line of the home slot. Removals move the later entries of the run back to keep this true.
+
+
+FORCEINLINE WSLE_NUMBER MiLookupWsleHash(IN PMMWSL WorkingSetList, IN PVOID Key)
+/*
+Routine Description:
+    This routine finds the hash slot holding the specified key.
+Arguments:
+    WorkingSetList - Supplies the working set list, which must have a hash table.
+    Key - Supplies the page aligned virtual address with the valid bit or'ed in.
+Return Value:
+    The index of the slot, or WSLE_NULL_INDEX if the key is not in the table.
+Environment:
+    Kernel mode, Working Set Mutex held.
+*/
+{
+    WSLE_NUMBER Hash;
+    ULONG HashTableSize;
+    ULONG Probes;
+    PMMWSLE_HASH Table;
+
+    Table = WorkingSetList->HashTable;
+    HashTableSize = WorkingSetList->HashTableSize;
+    Hash = MI_WSLE_HASH(Key, WorkingSetList);
+    for (Probes = 0; Probes < HashTableSize; Probes += 1) {
+        if (Table[Hash].Key == Key) {
+            return Hash;
+        }
+
+        if (Table[Hash].Key == 0) {
+            break;
+        }
+
+        Hash += 1;
+        if (Hash >= HashTableSize) {
+            Hash = 0;
+        }
+    }
+
+    return WSLE_NULL_INDEX;
+}
+
+
+VOID MiDeleteWsleHashSlot(IN PMMWSL WorkingSetList, IN WSLE_NUMBER Hash)
+/*
+Routine Description:
+    This routine frees a slot of the working set list hash.
+    The entries that follow it in the same run are moved back into the free slot where they can be, so that all of them
+    can still be reached from their home slots without crossing a free slot.
+Arguments:
+    WorkingSetList - Supplies the working set list.
+    Hash - Supplies the index of the slot to free.
+Environment:
+    Kernel mode, Working Set Mutex held.
+*/
+{
+    WSLE_NUMBER Home;
+    WSLE_NUMBER Next;
+    ULONG HashTableSize;
+    ULONG Probes;
+    PMMWSLE_HASH Table;
+
+    Table = WorkingSetList->HashTable;
+    HashTableSize = WorkingSetList->HashTableSize;
+    Next = Hash;
+    for (Probes = 1; Probes < HashTableSize; Probes += 1) {
+        Next += 1;
+        if (Next >= HashTableSize) {
+            Next = 0;
+        }
+
+        if (Table[Next].Key == 0) {
+            break;
+        }
+
+        // The entry can fill the free slot unless its home slot lies between the free slot and the entry.
+        Home = MI_WSLE_HASH(Table[Next].Key, WorkingSetList);
+        if (((Next + HashTableSize - Home) % HashTableSize) >= ((Next + HashTableSize - Hash) % HashTableSize)) {
+            Table[Hash] = Table[Next];
+            Hash = Next;
+        }
+    }
+
+    Table[Hash].Key = 0;
+}
+
 
 VOID FASTCALL MiInsertWsleHash(IN WSLE_NUMBER Entry, IN PMMSUPPORT WsInfo)
 /*
@@ -44,6 +133,7 @@ Environment:
     ULONG Tries;
     PMMWSLE Wsle;
     WSLE_NUMBER Hash;
+    WSLE_NUMBER StartHash;
     PMMWSLE_HASH Table;
     WSLE_NUMBER j;
     WSLE_NUMBER Index;
@@ -71,10 +161,12 @@ Environment:
 #endif
 
     Hash = MI_WSLE_HASH(Wsle[Entry].u1.Long, WorkingSetList);
+    StartHash = Hash;
     HashTableSize = WorkingSetList->HashTableSize;
 
     // Check hash table size and see if there is enough room to hash or if the table should be grown.
-    if ((WorkingSetList->NonDirectCount + 10 + (HashTableSize >> 4)) > HashTableSize) {
+    // The table is grown once it is three quarters full so that the runs of occupied slots stay short.
+    if ((WorkingSetList->NonDirectCount + 10 + (HashTableSize >> 2)) > HashTableSize) {
         if ((Table + HashTableSize + ((2 * PAGE_SIZE) / sizeof(MMWSLE_HASH)) <= (PMMWSLE_HASH)WorkingSetList->HighestPermittedHashAddress)) {
             WsInfo->Flags.GrowWsleHash = 1;
         }
@@ -135,10 +227,10 @@ Environment:
                     if (CurrentVictimWsleContents.u1.e1.Age >= MI_PASS0_TRIM_AGE) {
                         // This address hasn't been accessed in a while, so take the WSLE and the hash entry.
                         if (MiFreeWsle(Index, WsInfo, MiGetPteAddress(Table[CurrentVictimHashIndex].Key))) {
-                            // The previous entry (WSLE & hash) has been eliminated, so take it.
-                            ASSERT(Table[CurrentVictimHashIndex].Key == 0);
-                            Hash = CurrentVictimHashIndex;
-                            goto GotHash;
+                            // The previous entry (WSLE & hash) has been eliminated.
+                            // Its removal may have moved other entries back into its slot, so probe for the free slot it left.
+                            Hash = StartHash;
+                            break;
                         }
 
                         // Fall through to take just the hash entry.
@@ -146,6 +238,7 @@ Environment:
 
                     // Purge the previous entry's hash index (but not WSLE) so it can be reused for the new entry.
                     // This is nice because it preserves both entries in the working set (although it is a bit more costly to remove the original entry later since it won't have a hash entry).
+                    // The slot is in the run starting at the new entry's home slot, so the new entry can be found there.
                     ASSERT(Wsle[Index].u1.e1.Hashed == 1);
                     Wsle[Index].u1.e1.Hashed = 0;
                     Table[CurrentVictimHashIndex].Key = 0;
@@ -336,9 +429,7 @@ Environment:
     PMMWSLE Wsle;
     PMMWSLE LastWsle;
     WSLE_NUMBER Hash;
-    WSLE_NUMBER StartHash;
     PMMWSLE_HASH Table;
-    ULONG Tries;
 #if defined (_WIN64)
     ULONG LoopCount;
     WSLE_NUMBER WsPteIndex;
@@ -377,30 +468,16 @@ Environment:
 #endif
 
     if (WorkingSetList->HashTable != NULL) {
-        Tries = 0;
         Table = WorkingSetList->HashTable;
-        Hash = MI_WSLE_HASH(VirtualAddress, WorkingSetList);
-        StartHash = Hash;
-        while (Table[Hash].Key != VirtualAddress) {
-            Hash += 1;
-            if (Hash >= WorkingSetList->HashTableSize) {
-                ASSERT(Tries == 0);
-                Hash = 0;
-                Tries = 1;
-            }
-            if (Hash == StartHash) {
-                Tries = 2;
-                break;
-            }
-        }
-        if (Tries < 2) {
+        Hash = MiLookupWsleHash(WorkingSetList, VirtualAddress);
+        if (Hash != WSLE_NULL_INDEX) {
             WsPfnIndex = Table[Hash].Index;
             ASSERT(Wsle[WsPfnIndex].u1.e1.Hashed == 1);
             ASSERT(Wsle[WsPfnIndex].u1.e1.Direct == 0);
             ASSERT(MI_GENERATE_VALID_WSLE(&Wsle[WsPfnIndex]) == Table[Hash].Key);
             if (Deletion) {
                 Wsle[WsPfnIndex].u1.e1.Hashed = 0;
-                Table[Hash].Key = 0;
+                MiDeleteWsleHashSlot(WorkingSetList, Hash);
             }
             return WsPfnIndex;
         }
@@ -433,11 +510,11 @@ Environment:
 {
     PMMWSLE Wsle;
     PVOID VirtualAddress;
+#if DBG
     PMMWSLE_HASH Table;
+#endif
     MMWSLE WsleContents;
     WSLE_NUMBER Hash;
-    WSLE_NUMBER StartHash;
-    ULONG Tries;
 
     Wsle = WorkingSetList->Wsle;
 
@@ -486,30 +563,18 @@ Environment:
         }
 
         if (WorkingSetList->HashTable != NULL) {
-            Hash = MI_WSLE_HASH(WsleContents.u1.Long, WorkingSetList);
-            Table = WorkingSetList->HashTable;
-            Tries = 0;
-            StartHash = Hash;
-
             // Or in the valid bit so virtual address 0 is handled properly (instead of matching a free hash entry).
             VirtualAddress = (PVOID)((ULONG_PTR)VirtualAddress | 0x1);
-            while (Table[Hash].Key != VirtualAddress) {
-                Hash += 1;
-                if (Hash >= WorkingSetList->HashTableSize) {
-                    ASSERT(Tries == 0);
-                    Hash = 0;
-                    Tries = 1;
-                }
-                if (Hash == StartHash) {
-                    // The entry could not be found in the hash, it must never have been inserted.
-                    // This is ok, we don't need to do anything more in this case.
-                    ASSERT(WsleContents.u1.e1.Hashed == 0);
-                    return;
-                }
+            Hash = MiLookupWsleHash(WorkingSetList, VirtualAddress);
+            if (Hash == WSLE_NULL_INDEX) {
+                // The entry could not be found in the hash, it must never have been inserted.
+                // This is ok, we don't need to do anything more in this case.
+                ASSERT(WsleContents.u1.e1.Hashed == 0);
+                return;
             }
 
             ASSERT(WsleContents.u1.e1.Hashed == 1);
-            Table[Hash].Key = 0;
+            MiDeleteWsleHashSlot(WorkingSetList, Hash);
         }
     }
 }
@@ -701,10 +766,8 @@ Environment:
 */
 {
     WSLE_NUMBER Hash;
-    WSLE_NUMBER StartHash;
     PVOID VirtualAddress;
     PMMWSLE_HASH Table;
-    ULONG Tries;
 
     if (WsleEntry.u1.e1.Hashed == 0) {
 #if DBG
@@ -719,24 +782,13 @@ Environment:
         return;
     }
 
-    Tries = 0;
     Table = WorkingSetList->HashTable;
     VirtualAddress = MI_GENERATE_VALID_WSLE(&WsleEntry);
-    Hash = MI_WSLE_HASH(WsleEntry.u1.VirtualAddress, WorkingSetList);
-    StartHash = Hash;
-    while (Table[Hash].Key != VirtualAddress) {
-        Hash += 1;
-        if (Hash >= WorkingSetList->HashTableSize) {
-            ASSERT(Tries == 0);
-            Hash = 0;
-            Tries = 1;
-        }
-
-        if (StartHash == Hash) {
-            // Didn't find the hash entry, so this virtual address must not have one.
-            // That's ok, just return as nothing needs to be done in this case.
-            return;
-        }
+    Hash = MiLookupWsleHash(WorkingSetList, VirtualAddress);
+    if (Hash == WSLE_NULL_INDEX) {
+        // Didn't find the hash entry, so this virtual address must not have one.
+        // That's ok, just return as nothing needs to be done in this case.
+        return;
     }
 
     Table[Hash].Index = NewWsIndex;
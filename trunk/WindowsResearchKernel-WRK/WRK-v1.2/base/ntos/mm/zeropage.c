@@ -25,6 +25,29 @@ LOGICAL MiZeroingDisabled = FALSE;
 ULONG MiInitialZeroNoPtes = 0;
 #endif
 
+// Zeroing throughput of each node, in pages zeroed and interrupt time (100ns units) spent zeroing them.
+// Each node is zeroed by a single thread at any time, so the counts are updated without interlocks.
+typedef struct DECLSPEC_CACHEALIGN _MI_ZERO_PAGE_STATISTICS {
+    ULONGLONG PagesZeroed;
+    ULONGLONG ZeroingTime;
+} MI_ZERO_PAGE_STATISTICS, *PMI_ZERO_PAGE_STATISTICS;
+
+MI_ZERO_PAGE_STATISTICS MiZeroPageStatistics[MAXIMUM_CCNUMA_NODES];
+
+#if defined(MI_MULTINODE)
+// Each node other than node zero gets its own zeroing thread which waits on the event of its node.
+// The zero page thread sets the event of a node that has free pages and zeroes only the nodes without a thread of their own.
+KEVENT MiZeroNodeEvent[MAXIMUM_CCNUMA_NODES];
+ULONG MiZeroNodeThreads;
+#endif
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE,MmGetZeroPageInformation)
+#if defined(MI_MULTINODE)
+#pragma alloc_text(INIT,MiStartZeroNodeThreads)
+#endif
+#endif
+
 #if !defined(NT_UP)
 LONG MiNextZeroProcessor = (LONG)-1;
 #ifdef ALLOC_PRAGMA
@@ -33,6 +56,120 @@ LONG MiNextZeroProcessor = (LONG)-1;
 #endif
 
 
+PFN_COUNT MiRemovePagesToZero(IN OUT PULONG Color, IN PFN_COUNT MaximumPagesToZero, OUT PMMPFN *PfnAllocation)
+/*
+Routine Description:
+    This routine removes a chain of free pages to be zeroed, marching through the colors of the node that Color belongs to.
+Arguments:
+    Color - Supplies the color to start at and returns the color to start at next time.
+    MaximumPagesToZero - Supplies the maximum number of pages to remove.
+    PfnAllocation - Returns the chain of pages linked through u1.Flink and ending with MM_EMPTY_LIST.
+Return Value:
+    The number of pages removed, zero if the node has no free pages.
+Environment:
+    Kernel mode, PFN lock held.
+*/
+{
+    PMMCOLOR_TABLES FreePagesByColor;
+    PFN_COUNT PagesToZero;
+    PFN_NUMBER PageFrame;
+    PFN_NUMBER PageFrame1;
+    PMMPFN Pfn1;
+    ULONG SecondaryColorMask;
+    ULONG StartColor;
+
+    MM_PFN_LOCK_ASSERT();
+
+    FreePagesByColor = MmFreePagesByColor[FreePageList];
+    SecondaryColorMask = MmSecondaryColorMask;
+    PagesToZero = 0;
+    *PfnAllocation = (PMMPFN)MM_EMPTY_LIST;
+    StartColor = *Color;
+    do {
+        PageFrame = FreePagesByColor[*Color].Flink;
+        if (PageFrame != MM_EMPTY_LIST) {
+            Pfn1 = MI_PFN_ELEMENT(PageFrame);
+
+            // Check the frame carefully because a single bit (hardware) error causing us to zero the wrong frame is very hard to reconstruct after the fact.
+            if ((Pfn1->u3.e1.PageLocation != FreePageList) || (Pfn1->u3.e2.ReferenceCount != 0)) {
+                // Someone has removed a page from the colored lists chain without updating the freelist chain.
+                KeBugCheckEx(PFN_LIST_CORRUPT, 0x8D, PageFrame, (Pfn1->u3.e2.ShortFlags << 16) | Pfn1->u3.e2.ReferenceCount, (ULONG_PTR)Pfn1->PteAddress);
+            }
+
+            PageFrame1 = MiRemoveAnyPage(*Color);
+            if (PageFrame != PageFrame1) {
+                // Someone has removed a page from the colored lists chain without updating the freelist chain.
+                KeBugCheckEx(PFN_LIST_CORRUPT, 0x8E, PageFrame, PageFrame1, 0);
+            }
+
+            Pfn1->u1.Flink = (PFN_NUMBER)*PfnAllocation;
+
+            // Temporarily mark the page as bad so that contiguous memory allocators won't steal it when we release the PFN lock.
+            // This also prevents the MiIdentifyPfn code from trying to identify it as we haven't filled in all the fields yet.
+            Pfn1->u3.e1.PageLocation = BadPageList;
+            *PfnAllocation = Pfn1;
+            PagesToZero += 1;
+        }
+
+        // March to the next color - this will be used to finish filling the current chunk or to start the next one.
+        *Color = (*Color & ~SecondaryColorMask) | ((*Color + 1) & SecondaryColorMask);
+    } while ((PagesToZero != MaximumPagesToZero) && (*Color != StartColor));
+
+    return PagesToZero;
+}
+
+
+LOGICAL MiZeroPagesInSystemSpace(IN PMMPFN PfnAllocation, IN PFN_COUNT PagesToZero)
+/*
+Routine Description:
+    This routine zeroes a chain of pages through system PTEs.
+    Unlike hyperspace, system PTEs may be used by any number of threads at once and no spinlock is held while zeroing.
+    KeZeroPages uses non-temporal stores so zeroing does not flush the caches of the processor.
+Arguments:
+    PfnAllocation - Supplies the chain of pages linked through u1.Flink and ending with MM_EMPTY_LIST.
+    PagesToZero - Supplies the number of pages in the chain, at most 64k worth.
+Return Value:
+    TRUE if the pages were zeroed, FALSE if no system PTEs were available.
+Environment:
+    Kernel mode, APC_LEVEL or below.
+*/
+{
+    MMPTE DefaultCachedPte;
+    PMMPFN Pfn1;
+    PMMPTE PointerPte;
+    MMPTE TempPte;
+    PVOID ZeroBase;
+
+    PointerPte = MiReserveSystemPtes(PagesToZero, SystemPteSpace);
+    if (PointerPte == NULL) {
+        return FALSE;
+    }
+
+    DefaultCachedPte = ValidKernelPte;
+    ZeroBase = MiGetVirtualAddressMappedByPte(PointerPte);
+    Pfn1 = PfnAllocation;
+    do {
+        ASSERT(PointerPte->u.Hard.Valid == 0);
+        TempPte = DefaultCachedPte;
+        if (Pfn1->u3.e1.CacheAttribute == MiWriteCombined) {
+            MI_SET_PTE_WRITE_COMBINE(TempPte);
+        } else if (Pfn1->u3.e1.CacheAttribute == MiNonCached) {
+            MI_DISABLE_CACHING(TempPte);
+        }
+
+        TempPte.u.Hard.PageFrameNumber = MI_PFN_ELEMENT_TO_INDEX(Pfn1);
+        MI_WRITE_VALID_PTE(PointerPte, TempPte);
+        PointerPte += 1;
+        Pfn1 = (PMMPFN)Pfn1->u1.Flink;
+    } while (Pfn1 != (PMMPFN)MM_EMPTY_LIST);
+
+    KeZeroPages(ZeroBase, PagesToZero << PAGE_SHIFT);
+    PointerPte -= PagesToZero;
+    MiReleaseSystemPtes(PointerPte, PagesToZero, SystemPteSpace);
+    return TRUE;
+}
+
+
 VOID MmZeroPageThread(VOID)
 /*
 Routine Description:
@@ -59,6 +196,8 @@ Environment:
     PMMPFN PfnAllocation;
     ULONG SecondaryColorMask;
     PMMCOLOR_TABLES FreePagesByColor;
+    PMI_ZERO_PAGE_STATISTICS Statistics;
+    ULONGLONG StartTime;
 
 #if defined(MI_MULTINODE)
     ULONG i;
@@ -74,6 +213,13 @@ Environment:
     FreePagesByColor = MmFreePagesByColor[FreePageList];
     SecondaryColorMask = MmSecondaryColorMask;
 
+#if defined(MI_MULTINODE)
+    // Start the zeroing threads of the other nodes while the initialization code is still present.
+    if (KeNumberNodes > 1) {
+        MiStartZeroNodeThreads();
+    }
+#endif
+
     // Before this becomes the zero page thread, free the kernel initialization code.
     MiFindInitializationCode(&StartVa, &EndVa);
     if (StartVa != NULL) {
@@ -126,6 +272,17 @@ Environment:
 
         PagesToZero = 0;
 
+#if defined(MI_MULTINODE)
+        // Wake the zeroing threads of the nodes that have free pages.
+        if (MiZeroNodeThreads != 0) {
+            for (i = 0; i < KeNumberNodes; i += 1) {
+                if ((MiZeroNodeThreads & (1 << i)) && (KeNodeBlock[i]->FreeCount[FreePageList] != 0)) {
+                    KeSetEvent(&MiZeroNodeEvent[i], 0, FALSE);
+                }
+            }
+        }
+#endif
+
         LOCK_PFN(OldIrql);
         do {
             if (MmFreePageListHead.Total == 0) {
@@ -145,17 +302,24 @@ Environment:
 #if defined(MI_MULTINODE)
             // In a multinode system, zero pages by node.
             // Resume on the last node examined, find a node with free pages that need to be zeroed.
+            // Nodes with a zeroing thread of their own are left to that thread.
             if (KeNumberNodes > 1) {
                 n = LastNodeZeroing;
 
                 for (i = 0; i < KeNumberNodes; i += 1) {
-                    if (KeNodeBlock[n]->FreeCount[FreePageList] != 0) {
+                    if (((MiZeroNodeThreads & (1 << n)) == 0) && (KeNodeBlock[n]->FreeCount[FreePageList] != 0)) {
                         break;
                     }
                     n = (n + 1) % KeNumberNodes;
                 }
 
-                ASSERT(i != KeNumberNodes);
+                if (i == KeNumberNodes) {
+                    // The only free pages left are being zeroed by the node threads, wait for some more.
+                    MmZeroingPageThreadActive = FALSE;
+                    UNLOCK_PFN(OldIrql);
+                    break;
+                }
+
                 ASSERT(KeNodeBlock[n]->FreeCount[FreePageList] != 0);
 
                 if (n != LastNodeZeroing) {
@@ -224,9 +388,18 @@ Environment:
 
             ZeroedAlready = FALSE;
             if (ZeroedAlready == FALSE) {
+                StartTime = KeQueryInterruptTime();
                 ZeroBase = MiMapPagesToZeroInHyperSpace(PfnAllocation, PagesToZero);
                 MACHINE_ZERO_PAGE(ZeroBase, PagesToZero << PAGE_SHIFT);
                 MiUnmapPagesInZeroSpace(ZeroBase, PagesToZero);
+
+#if defined(MI_MULTINODE)
+                Statistics = &MiZeroPageStatistics[n];
+#else
+                Statistics = &MiZeroPageStatistics[0];
+#endif
+                Statistics->PagesZeroed += PagesToZero;
+                Statistics->ZeroingTime += KeQueryInterruptTime() - StartTime;
             }
 
             PagesToZero = 0;
@@ -260,12 +433,8 @@ Environment:
     Because this is INIT only code, don't bother charging commit for the pages.
 */
 {
-    MMPTE TempPte;
-    MMPTE DefaultCachedPte;
-    PMMPTE PointerPte;
     KAFFINITY Affinity;
     KIRQL OldIrql;
-    PVOID ZeroBase;
     PKTHREAD Thread;
     CCHAR OldProcessor;
     SCHAR OldBasePriority;
@@ -275,20 +444,14 @@ Environment:
     PFN_COUNT PagesToZero;
     PFN_COUNT MaximumPagesToZero;
     PFN_NUMBER PageFrame;
-    PFN_NUMBER PageFrame1;
     PMMPFN PfnAllocation;
     ULONG Color;
-    ULONG StartColor;
-    LOGICAL ZeroedAlready;
-    PMMCOLOR_TABLES FreePagesByColor;
     ULONG SecondaryColorMask;
 
     WorkItem = (PWORK_QUEUE_ITEM)Context;
     ExFreePool(WorkItem);
-    DefaultCachedPte = ValidKernelPte;
 
     // Make local copies of globals so they don't have to be wastefully refetched while holding the PFN lock.
-    FreePagesByColor = MmFreePagesByColor[FreePageList];
     SecondaryColorMask = MmSecondaryColorMask;
 
     // The following code sets the current thread's base and current priorities to one so all other code (except the zero page thread) can preempt it.
@@ -325,113 +488,37 @@ Environment:
     if (MaximumPagesToZero > (64 * 1024) / PAGE_SIZE) {
         MaximumPagesToZero = (64 * 1024) / PAGE_SIZE;
     }
-    PagesToZero = 0;
-    PfnAllocation = (PMMPFN)MM_EMPTY_LIST;
 
     LOCK_PFN(OldIrql);
     do {
-        StartColor = Color;
-        ASSERT(PagesToZero == 0);
-        ASSERT(PfnAllocation == (PMMPFN)MM_EMPTY_LIST);
-        do {
-            PageFrame = FreePagesByColor[Color].Flink;
-            if (PageFrame != MM_EMPTY_LIST) {
-                Pfn1 = MI_PFN_ELEMENT(PageFrame);
-
-                // Check the frame carefully because a single bit (hardware) error causing us to zero the wrong frame is very hard to reconstruct after the fact.
-                if ((Pfn1->u3.e1.PageLocation != FreePageList) || (Pfn1->u3.e2.ReferenceCount != 0)) {
-                    // Someone has removed a page from the colored lists chain without updating the freelist chain.
-                    KeBugCheckEx(PFN_LIST_CORRUPT, 0x8D, PageFrame, (Pfn1->u3.e2.ShortFlags << 16) | Pfn1->u3.e2.ReferenceCount, (ULONG_PTR)Pfn1->PteAddress);
-                }
-
-                PageFrame1 = MiRemoveAnyPage(Color);
-
-                if (PageFrame != PageFrame1) {
-                    // Someone has removed a page from the colored lists chain without updating the freelist chain.
-                    KeBugCheckEx(PFN_LIST_CORRUPT, 0x8E, PageFrame, PageFrame1, 0);
-                }
-
-                Pfn1->u1.Flink = (PFN_NUMBER)PfnAllocation;
-
-                // Temporarily mark the page as bad so that contiguous memory allocators won't steal it when we release the PFN lock below.
-                // This also prevents the MiIdentifyPfn code from trying to identify it as we haven't filled in all the fields yet.
-                Pfn1->u3.e1.PageLocation = BadPageList;
-                PfnAllocation = Pfn1;
-                PagesToZero += 1;
-            }
-
-            // March to the next color - this will be used to finish filling the current chunk or to start the next one.
-            Color = (Color & ~SecondaryColorMask) | ((Color + 1) & SecondaryColorMask);
-            if (PagesToZero == MaximumPagesToZero) {
-                break;
-            }
-
-            if (Color == StartColor) {
-                if (PagesToZero == 0) {
-                    // All of the pages for this node have been zeroed, bail.
-                    ASSERT(PfnAllocation == (PMMPFN)MM_EMPTY_LIST);
-                    UNLOCK_PFN(OldIrql);
-                    goto ZeroingComplete;
-                }
-
-                break;
-            }
-        } while (TRUE);
-
-        ASSERT(PagesToZero != 0);
-        ASSERT(PfnAllocation != (PMMPFN)MM_EMPTY_LIST);
+        PagesToZero = MiRemovePagesToZero(&Color, MaximumPagesToZero, &PfnAllocation);
 
         // Use system PTEs instead of hyperspace to zero the page so that a spinlock (ie: interrupts blocked) is not held while zeroing.
         // Since system PTE acquisition is lock free and the TB lazy flushed, this is perhaps the best path regardless.
         UNLOCK_PFN(OldIrql);
+        if (PagesToZero == 0) {
+            // All of the pages for this node have been zeroed, bail.
+            break;
+        }
 
-        ZeroedAlready = FALSE;
-        if (ZeroedAlready == FALSE) {
-            Pfn1 = PfnAllocation;
-            PointerPte = MiReserveSystemPtes(PagesToZero, SystemPteSpace);
-            if (PointerPte == NULL) {
+        if (MiZeroPagesInSystemSpace(PfnAllocation, PagesToZero) == FALSE) {
 #if DBG
-                MiInitialZeroNoPtes += 1;
+            MiInitialZeroNoPtes += 1;
 #endif
 
-                // Put these pages back on the freelist.
-                LOCK_PFN(OldIrql);
-                do {
-                    PageFrame = MI_PFN_ELEMENT_TO_INDEX(Pfn1);
-                    Pfn1 = (PMMPFN)Pfn1->u1.Flink;
-                    MiInsertPageInFreeList(PageFrame);
-                } while (Pfn1 != (PMMPFN)MM_EMPTY_LIST);
-                UNLOCK_PFN(OldIrql);
-                break;
-            }
-
-            ZeroBase = MiGetVirtualAddressMappedByPte(PointerPte);
-
+            // Put these pages back on the freelist.
+            Pfn1 = PfnAllocation;
+            LOCK_PFN(OldIrql);
             do {
-                ASSERT(PointerPte->u.Hard.Valid == 0);
                 PageFrame = MI_PFN_ELEMENT_TO_INDEX(Pfn1);
-                TempPte = DefaultCachedPte;
-
-                if (Pfn1->u3.e1.CacheAttribute == MiWriteCombined) {
-                    MI_SET_PTE_WRITE_COMBINE(TempPte);
-                } else if (Pfn1->u3.e1.CacheAttribute == MiNonCached) {
-                    MI_DISABLE_CACHING(TempPte);
-                }
-
-                TempPte.u.Hard.PageFrameNumber = PageFrame;
-                MI_WRITE_VALID_PTE(PointerPte, TempPte);
-                PointerPte += 1;
                 Pfn1 = (PMMPFN)Pfn1->u1.Flink;
+                MiInsertPageInFreeList(PageFrame);
             } while (Pfn1 != (PMMPFN)MM_EMPTY_LIST);
-
-            KeZeroPages(ZeroBase, PagesToZero << PAGE_SHIFT);
-            PointerPte -= PagesToZero;
-            MiReleaseSystemPtes(PointerPte, PagesToZero, SystemPteSpace);
+            UNLOCK_PFN(OldIrql);
+            break;
         }
 
-        PagesToZero = 0;
         Pfn1 = PfnAllocation;
-        PfnAllocation = (PMMPFN)MM_EMPTY_LIST;
 
         LOCK_PFN(OldIrql);
 
@@ -442,7 +529,6 @@ Environment:
         } while (Pfn1 != (PMMPFN)MM_EMPTY_LIST);
     } while (TRUE);
 
-ZeroingComplete:
     // Restore the entry thread priority and processor affinity.
     KeRevertToUserAffinityThread();
     KeSetPriorityThread(Thread, OldPriority);
@@ -471,4 +557,167 @@ Environment:
         ExQueueWorkItem(WorkItem, CriticalWorkQueue);
     }
 }
-#endif
\ No newline at end of file
+#endif
+
+
+#if defined(MI_MULTINODE)
+VOID MiZeroNodePageThread(IN PVOID Context)
+/*
+Routine Description:
+    This routine is the zeroing thread of a single node. It runs on the processors of the node and
+    zeroes the free pages of the node through system PTEs whenever the zero page thread sets the event of the node.
+Arguments:
+    Context - Supplies the number of the node.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    ULONG Color;
+    PFN_COUNT MaximumPagesToZero;
+    ULONG Node;
+    PKNODE NodeBlock;
+    KIRQL OldIrql;
+    PFN_NUMBER PageFrame;
+    PFN_COUNT PagesToZero;
+    PMMPFN Pfn1;
+    PMMPFN PfnAllocation;
+    PMI_ZERO_PAGE_STATISTICS Statistics;
+    ULONGLONG StartTime;
+    PKTHREAD Thread;
+
+    Node = (ULONG)(ULONG_PTR)Context;
+    NodeBlock = KeNodeBlock[Node];
+    Statistics = &MiZeroPageStatistics[Node];
+
+    // Run at priority one so all other code (except the zero page thread) can preempt this thread, and on the node's own processors
+    // so the pages are zeroed through the node's memory controller.
+    Thread = KeGetCurrentThread();
+    Thread->BasePriority = 1;
+    KeSetPriorityThread(Thread, 1);
+    if (NodeBlock->ProcessorMask != 0) {
+        KeSetSystemAffinityThread(NodeBlock->ProcessorMask);
+    }
+
+    // Zero a maximum of 64k at a time since 64k is the largest binned system PTE size.
+    // Charge commitment as well as resident available up front since zeroing may get starved priority-wise.
+    MaximumPagesToZero = 1;
+    PagesToZero = MmSecondaryColorMask + 1;
+    if (PagesToZero > (64 * 1024) / PAGE_SIZE) {
+        PagesToZero = (64 * 1024) / PAGE_SIZE;
+    }
+
+    if (MiChargeCommitment(PagesToZero, NULL) == TRUE) {
+        LOCK_PFN(OldIrql);
+        if (MI_NONPAGEABLE_MEMORY_AVAILABLE() > (SPFN_NUMBER)(PagesToZero)) {
+            MI_DECREMENT_RESIDENT_AVAILABLE(PagesToZero, MM_RESAVAIL_ALLOCATE_ZERO_PAGE_CLUSTERS);
+            MaximumPagesToZero = PagesToZero;
+        }
+        UNLOCK_PFN(OldIrql);
+    }
+
+    Color = NodeBlock->MmShiftedColor;
+
+    // Loop forever zeroing pages.
+    do {
+        KeWaitForSingleObject(&MiZeroNodeEvent[Node], WrFreePage, KernelMode, FALSE, NULL);
+
+        // Zero the free pages of this node until there are none left.
+        while (MiZeroingDisabled == FALSE) {
+            LOCK_PFN(OldIrql);
+            PagesToZero = MiRemovePagesToZero(&Color, MaximumPagesToZero, &PfnAllocation);
+            UNLOCK_PFN(OldIrql);
+            if (PagesToZero == 0) {
+                break;
+            }
+
+            StartTime = KeQueryInterruptTime();
+            if (MiZeroPagesInSystemSpace(PfnAllocation, PagesToZero) == FALSE) {
+                // Put these pages back on the freelist and try again the next time the node is signaled.
+                Pfn1 = PfnAllocation;
+                LOCK_PFN(OldIrql);
+                do {
+                    PageFrame = MI_PFN_ELEMENT_TO_INDEX(Pfn1);
+                    Pfn1 = (PMMPFN)Pfn1->u1.Flink;
+                    MiInsertPageInFreeList(PageFrame);
+                } while (Pfn1 != (PMMPFN)MM_EMPTY_LIST);
+                UNLOCK_PFN(OldIrql);
+                break;
+            }
+
+            Statistics->PagesZeroed += PagesToZero;
+            Statistics->ZeroingTime += KeQueryInterruptTime() - StartTime;
+
+            Pfn1 = PfnAllocation;
+            LOCK_PFN(OldIrql);
+            do {
+                PageFrame = MI_PFN_ELEMENT_TO_INDEX(Pfn1);
+                Pfn1 = (PMMPFN)Pfn1->u1.Flink;
+                MiInsertPageInList(&MmZeroedPageListHead, PageFrame);
+            } while (Pfn1 != (PMMPFN)MM_EMPTY_LIST);
+            UNLOCK_PFN(OldIrql);
+        }
+    } while (TRUE);
+}
+
+
+VOID MiStartZeroNodeThreads(VOID)
+/*
+Routine Description:
+    This routine starts a zeroing thread for each node other than node zero, which is zeroed by the zero page thread itself.
+    A node whose thread can't be created is zeroed by the zero page thread as well.
+Environment:
+    Kernel mode initialization phase 1, PASSIVE_LEVEL.
+*/
+{
+    ULONG i;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ThreadHandle;
+
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    for (i = 1; i < KeNumberNodes; i += 1) {
+        KeInitializeEvent(&MiZeroNodeEvent[i], SynchronizationEvent, FALSE);
+        if (NT_SUCCESS(PsCreateSystemThread(&ThreadHandle, THREAD_ALL_ACCESS, &ObjectAttributes, 0L, NULL, MiZeroNodePageThread, (PVOID)(ULONG_PTR)i))) {
+            ZwClose(ThreadHandle);
+            MiZeroNodeThreads |= (1 << i);
+        }
+    }
+}
+#endif
+
+
+NTSTATUS MmGetZeroPageInformation(OUT PVOID SystemInformation, IN ULONG SystemInformationLength, OUT PULONG Length)
+/*
+Routine Description:
+    This routine returns the zeroing throughput of each node.
+Arguments:
+    SystemInformation - Returns the zero page information.
+    SystemInformationLength - Supplies the length of the SystemInformation buffer.
+    Length - Returns the length of the information placed in the buffer.
+Return Value:
+    Returns the status of the operation.
+Environment:
+    Kernel mode, PASSIVE_LEVEL. The buffer has been probed and the caller handles exceptions.
+*/
+{
+    ULONG i;
+    ULONG NumberOfNodes;
+    PSYSTEM_ZERO_PAGE_INFORMATION ZeroPageInfo;
+
+    PAGED_CODE();
+
+    NumberOfNodes = KeNumberNodes;
+    *Length = FIELD_OFFSET(SYSTEM_ZERO_PAGE_INFORMATION, Node) + NumberOfNodes * sizeof(SYSTEM_ZERO_PAGE_NODE_INFORMATION);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    ZeroPageInfo = (PSYSTEM_ZERO_PAGE_INFORMATION)SystemInformation;
+    ZeroPageInfo->NumberOfNodes = NumberOfNodes;
+    ZeroPageInfo->Reserved = 0;
+    for (i = 0; i < NumberOfNodes; i += 1) {
+        ZeroPageInfo->Node[i].PagesZeroed = MiZeroPageStatistics[i].PagesZeroed;
+        ZeroPageInfo->Node[i].ZeroingTime = MiZeroPageStatistics[i].ZeroingTime;
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -63,6 +63,11 @@ Abstract:
     +-----------+---+    +-----------+-----+ Dereference the object directly
     |    q      | n | => |    q      |  n  | as the pointer p has been
     +-----------+---+    +-----------+-----+ replaced by q. q May be NULL
+
+    Objects that every processor references continuously still bounce the one fast ref (and the object header) between processors.
+    A processor reference gives each processor its own cache aligned fast ref to the same object, so the header is only touched once every
+    ExFastRefGetAdditionalReferenceCount references per processor. The cached references hide the exact pointer count while the processor
+    reference exists; ObDeleteProcessorReference returns them all, after which the pointer count is exact again and the object can go away.
 */
 
 #include "obp.h"
@@ -75,6 +80,8 @@ Abstract:
 #pragma alloc_text(PAGE,ObFastReferenceObjectLocked)
 #pragma alloc_text(PAGE,ObFastDereferenceObject)
 #pragma alloc_text(PAGE,ObFastReplaceObject)
+#pragma alloc_text(PAGE,ObCreateProcessorReference)
+#pragma alloc_text(PAGE,ObDeleteProcessorReference)
 #endif
 
 
@@ -200,4 +207,137 @@ Return Value:
     }
 
     return OldObject;
-}
\ No newline at end of file
+}
+
+
+NTKERNELAPI POB_PROCESSOR_REFERENCE ObCreateProcessorReference(IN PVOID Object)
+/*
+Routine Description:
+    This routine creates a set of per processor fast references to an object.
+    The processor reference holds its own references on the object, the caller keeps the reference it used to supply the object.
+Arguments:
+    Object - Object that will be referenced through the processor reference
+Return Value:
+    POB_PROCESSOR_REFERENCE - The new processor reference or NULL if there was not enough pool
+*/
+{
+    POB_PROCESSOR_REFERENCE Reference;
+    ULONG NumberOfProcessors, Index;
+
+    PAGED_CODE();
+
+    NumberOfProcessors = (ULONG)KeNumberProcessors;
+    Reference = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                      FIELD_OFFSET(OB_PROCESSOR_REFERENCE, Processor) + NumberOfProcessors * sizeof(OB_PROCESSOR_FAST_REF),
+                                      'rPbO');
+    if (Reference == NULL) {
+        return NULL;
+    }
+
+    Reference->Object = Object;
+    Reference->NumberOfProcessors = NumberOfProcessors;
+
+    // Each processor's fast ref owns one reference for the pointer itself plus its cached references.
+    ObReferenceObjectEx(Object, NumberOfProcessors);
+    for (Index = 0; Index < NumberOfProcessors; Index += 1) {
+        ObInitializeFastReference(&Reference->Processor[Index].FastRef, Object);
+    }
+
+    return Reference;
+}
+
+
+NTKERNELAPI PVOID FASTCALL ObProcessorReferenceObject(IN POB_PROCESSOR_REFERENCE Reference)
+/*
+Routine Description:
+    This routine references the object through the current processor's fast ref.
+    Unlike ObFastReferenceObject this never fails, since the processor reference keeps the object alive until it is deleted.
+    It may be called at DISPATCH_LEVEL.
+Arguments:
+    Reference - Processor reference to be used for the reference
+Return Value:
+    PVOID - Object that was referenced
+*/
+{
+    PEX_FAST_REF FastRef;
+    EX_FAST_REF OldRef;
+    PVOID Object;
+    ULONG Number, RefsToAdd, Unused;
+
+    // Processors added after the processor reference was created share the first fast ref.
+    Number = KeGetCurrentProcessorNumber();
+    if (Number >= Reference->NumberOfProcessors) {
+        Number = 0;
+    }
+
+    FastRef = &Reference->Processor[Number].FastRef;
+    Object = Reference->Object;
+
+    OldRef = ExFastReference(FastRef);
+    Unused = ExFastRefGetUnusedReferences(OldRef);
+    if (Unused <= 1) {
+        if (Unused == 0) {
+            // Another thread is refilling this cache. The fast ref still holds its own reference so we can reference the object directly.
+            ObReferenceObject(Object);
+            return Object;
+        }
+
+        // We took the counter to zero so refill it for the next referencer on this processor.
+        RefsToAdd = ExFastRefGetAdditionalReferenceCount();
+        ObReferenceObjectEx(Object, RefsToAdd);
+        if (!ExFastRefAddAdditionalReferenceCounts(FastRef, Object, RefsToAdd)) {
+            ObDereferenceObjectEx(Object, RefsToAdd);
+        }
+    }
+
+    return Object;
+}
+
+
+NTKERNELAPI VOID FASTCALL ObProcessorDereferenceObject(IN POB_PROCESSOR_REFERENCE Reference, IN PVOID Object)
+/*
+Routine Description:
+    This routine returns a reference to the current processor's fast ref if possible, otherwise it dereferences the object.
+    The reference may have been obtained on another processor or with ObReferenceObject.
+Arguments:
+    Reference - Processor reference the object was referenced through
+    Object - Object being dereferenced
+*/
+{
+    ULONG Number;
+
+    Number = KeGetCurrentProcessorNumber();
+    if (Number >= Reference->NumberOfProcessors) {
+        Number = 0;
+    }
+
+    if (!ExFastRefDereference(&Reference->Processor[Number].FastRef, Object)) {
+        ObDereferenceObject(Object);// The cache on this processor is full or has been run down.
+    }
+}
+
+
+NTKERNELAPI VOID ObDeleteProcessorReference(IN POB_PROCESSOR_REFERENCE Reference)
+/*
+Routine Description:
+    This routine runs down the per processor fast refs and returns all references they hold.
+    References handed out earlier remain valid and are released to the object directly, since their fast ref no longer matches.
+    The caller must make sure nobody references the object through this processor reference anymore.
+Arguments:
+    Reference - Processor reference to delete
+*/
+{
+    EX_FAST_REF OldRef;
+    ULONG Index, RefsToReturn;
+
+    PAGED_CODE();
+
+    RefsToReturn = 0;
+    for (Index = 0; Index < Reference->NumberOfProcessors; Index += 1) {
+        OldRef = ExFastRefSwapObject(&Reference->Processor[Index].FastRef, NULL);
+        RefsToReturn += ExFastRefGetUnusedReferences(OldRef) + 1;
+    }
+
+    ObDereferenceObjectEx(Reference->Object, RefsToReturn);
+    ExFreePool(Reference);
+}
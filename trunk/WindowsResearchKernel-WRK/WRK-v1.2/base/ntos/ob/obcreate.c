@@ -459,6 +459,7 @@ NTSTATUS ObpAllocateObject(
     POBJECT_HEADER_HANDLE_INFO HandleInfo;
     POBJECT_HEADER_NAME_INFO NameInfo;
     POBJECT_HEADER_CREATOR_INFO CreatorInfo;
+    PEX_OBJECT_CACHE ObjectCache;
     POOL_TYPE PoolType;
 
     PAGED_CODE();
@@ -533,7 +534,18 @@ NTSTATUS ObpAllocateObject(
         PoolType = PagedPool;
     }
 
-    ObjectHeader = ExAllocatePoolWithTag(PoolType, HeaderSize + ObjectBodySize, (ObjectType == NULL ? 'TjbO' : ObjectType->Key) | PROTECTED_POOL);
+    //  If the object has the common header layout of its type, then allocate it from the object cache of the type.
+    ObjectCache = NULL;
+    if ((ObjectCreateInfo != NULL) && (QuotaInfoSize == 0) && (NameInfoSize == 0)) {
+        ObjectCache = ObpGetObjectTypeCache(ObjectType, HeaderSize + ObjectBodySize);
+    }
+
+    if (ObjectCache != NULL) {
+        ObjectHeader = ExAllocateFromObjectCache(ObjectCache, HeaderSize + ObjectBodySize);
+    } else {
+        ObjectHeader = ExAllocatePoolWithTag(PoolType, HeaderSize + ObjectBodySize, (ObjectType == NULL ? 'TjbO' : ObjectType->Key) | PROTECTED_POOL);
+    }
+
     if (ObjectHeader == NULL) {
         return STATUS_INSUFFICIENT_RESOURCES;
     }
@@ -577,23 +589,26 @@ NTSTATUS ObpAllocateObject(
         ObjectHeader = (POBJECT_HEADER)(CreatorInfo + 1);
     }
 
-    //  Compute the proper offsets based on what we have
-    if (QuotaInfoSize != 0) {
-        ObjectHeader->QuotaInfoOffset = (UCHAR)(QuotaInfoSize + HandleInfoSize + NameInfoSize + CreatorInfoSize);
-    } else {
-        ObjectHeader->QuotaInfoOffset = 0;
-    }
+    //  Compute the proper offsets based on what we have.
+    //  Objects from the object cache of the type keep the offsets set by the object cache constructor.
+    if (ObjectCache == NULL) {
+        if (QuotaInfoSize != 0) {
+            ObjectHeader->QuotaInfoOffset = (UCHAR)(QuotaInfoSize + HandleInfoSize + NameInfoSize + CreatorInfoSize);
+        } else {
+            ObjectHeader->QuotaInfoOffset = 0;
+        }
 
-    if (HandleInfoSize != 0) {
-        ObjectHeader->HandleInfoOffset = (UCHAR)(HandleInfoSize + NameInfoSize + CreatorInfoSize);
-    } else {
-        ObjectHeader->HandleInfoOffset = 0;
-    }
+        if (HandleInfoSize != 0) {
+            ObjectHeader->HandleInfoOffset = (UCHAR)(HandleInfoSize + NameInfoSize + CreatorInfoSize);
+        } else {
+            ObjectHeader->HandleInfoOffset = 0;
+        }
 
-    if (NameInfoSize != 0) {
-        ObjectHeader->NameInfoOffset = (UCHAR)(NameInfoSize + CreatorInfoSize);
-    } else {
-        ObjectHeader->NameInfoOffset = 0;
+        if (NameInfoSize != 0) {
+            ObjectHeader->NameInfoOffset = (UCHAR)(NameInfoSize + CreatorInfoSize);
+        } else {
+            ObjectHeader->NameInfoOffset = 0;
+        }
     }
 
     //  Say that this is a new object, and conditionally set the other flags
@@ -669,6 +684,7 @@ Arguments:
     POBJECT_HEADER_NAME_INFO NameInfo;
     POBJECT_HEADER_CREATOR_INFO CreatorInfo;
     PVOID FreeBuffer;
+    PEX_OBJECT_CACHE ObjectCache;
     ULONG NonPagedPoolCharge;
     ULONG PagedPoolCharge;
 
@@ -709,6 +725,11 @@ Arguments:
     }
 #endif
 
+    //  An object that was inserted may still be in use by a thread that read one of its handles without locking the entry.
+    if ((ObjectHeader->Flags & OB_FLAG_NEW_OBJECT) == 0) {
+        ObpWaitForHandleReaders();
+    }
+
     //  Decrement the number of objects of this type
     InterlockedDecrement((PLONG)&ObjectType->TotalNumberOfObjects);
 
@@ -758,7 +779,18 @@ Arguments:
     //  Win64 Note: trash it by zero-extended it.
     //                sign-extension will create a valid kernel address.
     ObjectHeader->Type = UIntToPtr(0xBAD0B0B0);
-    ExFreePoolWithTag(FreeBuffer, (ObjectType == NULL ? 'TjbO' : ObjectType->Key) | PROTECTED_POOL);
+
+    //  If the object has the common header layout of a type with an object cache, then it was allocated from the object cache.
+    ObjectCache = NULL;
+    if ((ObjectType != NULL) && (QuotaInfo == NULL) && (NameInfo == NULL)) {
+        ObjectCache = ObpLookupObjectTypeCache(ObjectType);
+    }
+
+    if ((ObjectCache != NULL) && (ObjectCache != OBP_OBJECT_CACHE_DISABLED)) {
+        ExFreeToObjectCache(FreeBuffer);
+    } else {
+        ExFreePoolWithTag(FreeBuffer, (ObjectType == NULL ? 'TjbO' : ObjectType->Key) | PROTECTED_POOL);
+    }
 }
 
 
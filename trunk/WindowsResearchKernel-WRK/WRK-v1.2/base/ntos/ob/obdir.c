@@ -14,6 +14,8 @@ Abstract:
 #include "obp.h"
 #include <stdio.h>
 
+extern POBJECT_TYPE IoDeviceObjectType;
+
 POBJECT_DIRECTORY ObpGetShadowDirectory(POBJECT_DIRECTORY Dir);
 
 // Defined in ntos\se\rmlogon.c
@@ -26,6 +28,10 @@ VOID ObpReleaseExclusiveNameLock(IN POBJECT_HEADER ObjectHeader);
 POBJECT_DIRECTORY_ENTRY ObpUnlinkDirectoryEntry(IN POBJECT_DIRECTORY Directory, IN ULONG HashIndex);
 VOID ObpLinkDirectoryEntry(IN POBJECT_DIRECTORY Directory, IN ULONG HashIndex, IN POBJECT_DIRECTORY_ENTRY NewDirectoryEntry);
 VOID ObpReleaseLookupContextObject(IN POBP_LOOKUP_CONTEXT LookupContext);
+PVOID ObpLookupNameCache(IN PDEVICE_MAP DeviceMap, IN PUNICODE_STRING Name);
+VOID ObpInsertNameCache(IN PDEVICE_MAP DeviceMap, IN PUNICODE_STRING Name, IN LONG Generation, IN PVOID Object);
+VOID ObpPurgeNameCache(IN PVOID Object);
+VOID ObpGrowDirectoryHashTable(IN POBJECT_DIRECTORY Directory);
 
 #if defined(ALLOC_PRAGMA)
 #pragma alloc_text(PAGE,NtCreateDirectoryObject)
@@ -34,6 +40,11 @@ VOID ObpReleaseLookupContextObject(IN POBP_LOOKUP_CONTEXT LookupContext);
 #pragma alloc_text(PAGE,ObpLookupDirectoryEntry)
 #pragma alloc_text(PAGE,ObpInsertDirectoryEntry)
 #pragma alloc_text(PAGE,ObpDeleteDirectoryEntry)
+#pragma alloc_text(PAGE,ObpGrowDirectoryHashTable)
+#pragma alloc_text(PAGE,ObpDeleteDirectory)
+#pragma alloc_text(PAGE,ObpLookupNameCache)
+#pragma alloc_text(PAGE,ObpInsertNameCache)
+#pragma alloc_text(PAGE,ObpPurgeNameCache)
 #pragma alloc_text(PAGE,ObpLookupObjectName)
 #pragma alloc_text(PAGE,NtMakePermanentObject)
 
@@ -60,6 +71,13 @@ extern ULONG ObpLUIDDeviceMapsEnabled;
 WCHAR ObpUnsecureGlobalNamesBuffer[128] = {0};
 ULONG ObpUnsecureGlobalNamesLength = sizeof(ObpUnsecureGlobalNamesBuffer);
 
+//  A directory starts with its NUMBER_HASH_BUCKETS embedded buckets and moves to the next larger (prime) table
+//  once it averages more than OBP_DIRECTORY_ENTRIES_PER_BUCKET entries per chain.
+//  The largest size must fit the USHORT HashIndex kept in the lookup context.
+#define OBP_DIRECTORY_ENTRIES_PER_BUCKET 4
+
+const ULONG ObpDirectoryBucketSizes[] = {251, 1021, 4093, 16381, 65521};
+
 
 BOOLEAN ObpIsUnsecureName(IN PUNICODE_STRING ObjectName, IN BOOLEAN CaseInsensitive)
 {
@@ -320,8 +338,8 @@ Return Value:
     Status = STATUS_NO_MORE_ENTRIES;//  By default we'll say there are no more entries until the following loop put in some data
 
     //  Our outer loop processes each hash bucket in the directory object
-    for (Bucket = 0; Bucket < NUMBER_HASH_BUCKETS; Bucket++) {
-        DirectoryEntry = Directory->HashBuckets[Bucket];
+    for (Bucket = 0; Bucket < ObpDirectoryBucketCount(Directory); Bucket++) {
+        DirectoryEntry = *ObpDirectoryBucket(Directory, Bucket);
 
         //  For this hash bucket we'll zip through its list of entries.
         //  This is a singly linked list so when the next pointer is null
@@ -587,21 +605,28 @@ Return Value:
         }
     }
 
+    //  The running sum above mostly reflects the last few characters of the name.
+    //  Mix the high bits back down so that large directories spread names like "Global\\Foo1234" across all of their buckets.
     HashValue = HashIndex;
-    HashIndex %= NUMBER_HASH_BUCKETS;
+    HashValue ^= HashValue >> 16;
+    HashValue *= 0x85EBCA6B;
+    HashValue ^= HashValue >> 13;
 
-    LookupContext->HashIndex = (USHORT)HashIndex;
     LookupContext->HashValue = HashValue;
 
     while (1) {
-        HeadDirectoryEntry = (POBJECT_DIRECTORY_ENTRY*)&Directory->HashBuckets[HashIndex];
-        LookupBucket = HeadDirectoryEntry;
-
         //  Lock the directory for read access, if the context was not previously locked exclusively
         if (!LookupContext->DirectoryLocked) {
             ObpLockDirectoryShared(Directory, LookupContext);
         }
 
+        //  The size of the hash table can only change under the exclusive lock, so the bucket is picked once the directory is locked
+        HashIndex = HashValue % ObpDirectoryBucketCount(Directory);
+        LookupContext->HashIndex = (USHORT)HashIndex;
+
+        HeadDirectoryEntry = ObpDirectoryBucket(Directory, HashIndex);
+        LookupBucket = HeadDirectoryEntry;
+
         //  Walk the chain of directory entries for this hash bucket, 
         //  looking for either a match, or the insertion point if no match in the chain.
         while ((DirectoryEntry = *HeadDirectoryEntry) != NULL) {
@@ -726,7 +751,13 @@ Return Value:
         return(FALSE);
     }
 
-    HeadDirectoryEntry = (POBJECT_DIRECTORY_ENTRY*)&Directory->HashBuckets[LookupContext->HashIndex];//  Get the right lookup bucket based on the HashIndex
+    //  Move to a larger table if the chains got long.  This rehashes the directory, so the bucket index is recomputed from the hash value
+    if (Directory->NumberOfEntries >= ObpDirectoryBucketCount(Directory) * OBP_DIRECTORY_ENTRIES_PER_BUCKET) {
+        ObpGrowDirectoryHashTable(Directory);
+        LookupContext->HashIndex = (USHORT)(LookupContext->HashValue % ObpDirectoryBucketCount(Directory));
+    }
+
+    HeadDirectoryEntry = ObpDirectoryBucket(Directory, LookupContext->HashIndex);//  Get the right lookup bucket based on the HashIndex
 
     //  Link the new entry into the chain at the insertion point.
     //  This puts the new object right at the head of the current hash bucket chain
@@ -734,8 +765,10 @@ Return Value:
     NewDirectoryEntry->ChainLink = *HeadDirectoryEntry;
     *HeadDirectoryEntry = NewDirectoryEntry;
     NewDirectoryEntry->Object = &ObjectHeader->Body;
+    Directory->NumberOfEntries += 1;
 
     NameInfo->Directory = Directory;//  Point the object header back to the directory we just inserted it into.
+    ObpInvalidateNameCache();//  A new name may shadow a name that resolved to a cached device
     return(TRUE);//  Return success.
 }
 
@@ -760,17 +793,92 @@ Return Value:
     }
 
     //  The lookup path places the object in the front of the list, so basically we find the object immediately
-    HeadDirectoryEntry = (POBJECT_DIRECTORY_ENTRY*)&Directory->HashBuckets[LookupContext->HashIndex];
+    HeadDirectoryEntry = ObpDirectoryBucket(Directory, LookupContext->HashIndex);
     DirectoryEntry = *HeadDirectoryEntry;
 
     //  Unlink the entry from the head of the bucket chain and free the memory for the entry.
     *HeadDirectoryEntry = DirectoryEntry->ChainLink;
     DirectoryEntry->ChainLink = NULL;
+    Directory->NumberOfEntries -= 1;
     ExFreePool(DirectoryEntry);
+
+    //  Every cached translation may have gone through this name, and the cache must not keep a device that lost its name alive
+    ObpPurgeNameCache(LookupContext->Object);
     return TRUE;
 }
 
 
+VOID ObpGrowDirectoryHashTable(IN POBJECT_DIRECTORY Directory)
+/*
+Routine Description:
+    This routine moves a directory to the next larger hash table and rehashes its entries using the hash value saved in each entry.
+    The directory must be locked exclusive.  Since the chains are rebuilt, the bucket index held by any lookup context is stale afterwards.
+    If the directory already uses the largest table, or the new table cannot be allocated, the directory keeps its current table.
+Arguments:
+    Directory - Supplies the directory being grown
+*/
+{
+    POBJECT_DIRECTORY_ENTRY* NewBuckets;
+    POBJECT_DIRECTORY_ENTRY DirectoryEntry;
+    ULONG OldCount, NewCount, Bucket, Index;
+
+    OldCount = ObpDirectoryBucketCount(Directory);
+    for (Index = 0; Index < RTL_NUMBER_OF(ObpDirectoryBucketSizes); Index++) {
+        if (ObpDirectoryBucketSizes[Index] > OldCount) {
+            break;
+        }
+    }
+
+    if (Index == RTL_NUMBER_OF(ObpDirectoryBucketSizes)) {
+        return;
+    }
+
+    NewCount = ObpDirectoryBucketSizes[Index];
+    NewBuckets = ExAllocatePoolWithTag(PagedPool, NewCount * sizeof(POBJECT_DIRECTORY_ENTRY), 'hDbO');
+    if (NewBuckets == NULL) {
+        return;
+    }
+    RtlZeroMemory(NewBuckets, NewCount * sizeof(POBJECT_DIRECTORY_ENTRY));
+
+    for (Bucket = 0; Bucket < OldCount; Bucket++) {
+        while ((DirectoryEntry = *ObpDirectoryBucket(Directory, Bucket)) != NULL) {
+            *ObpDirectoryBucket(Directory, Bucket) = DirectoryEntry->ChainLink;
+
+            Index = DirectoryEntry->HashValue % NewCount;
+            DirectoryEntry->ChainLink = NewBuckets[Index];
+            NewBuckets[Index] = DirectoryEntry;
+        }
+    }
+
+    if (Directory->ExtendedHashBuckets != NULL) {
+        ExFreePool(Directory->ExtendedHashBuckets);
+    }
+
+    Directory->ExtendedHashBuckets = NewBuckets;
+    Directory->NumberOfExtendedBuckets = NewCount;
+}
+
+
+VOID ObpDeleteDirectory(IN PVOID Object)
+/*
+Routine Description:
+    This routine is called when the last reference to a directory object goes away.
+    The directory is empty by then, so all that is left is the hash table it may have grown into.
+Arguments:
+    Object - Supplies the directory object being deleted
+*/
+{
+    POBJECT_DIRECTORY Directory = (POBJECT_DIRECTORY)Object;
+
+    PAGED_CODE();
+
+    if (Directory->ExtendedHashBuckets != NULL) {
+        ExFreePool(Directory->ExtendedHashBuckets);
+        Directory->ExtendedHashBuckets = NULL;
+    }
+}
+
+
 POBJECT_DIRECTORY ObpGetShadowDirectory(POBJECT_DIRECTORY Dir)
 {
     POBJECT_DIRECTORY NewDir;
@@ -974,6 +1082,7 @@ VOID FASTCALL ObfDereferenceDeviceMap(IN PDEVICE_MAP DeviceMap)
     if (DeviceMap->ReferenceCount == 0) {
         DeviceMap->DosDevicesDirectory->DeviceMap = NULL;
         ObpUnlockDeviceMap();
+        ObpInvalidateNameCache();//  The address of this device map can be reused for another one
 
         // This devmap is dead so mark the directory temporary so its name will go away and dereference it.
         ObMakeTemporaryObject(DeviceMap->DosDevicesDirectory);
@@ -985,6 +1094,150 @@ VOID FASTCALL ObfDereferenceDeviceMap(IN PDEVICE_MAP DeviceMap)
 }
 
 
+PVOID ObpLookupNameCache(IN PDEVICE_MAP DeviceMap, IN PUNICODE_STRING Name)
+/*
+Routine Description:
+    This routine looks up the device object a name below the dos devices directory resolved to the last time it was opened.
+Arguments:
+    DeviceMap - Supplies the device map the name is resolved in
+    Name - Supplies the first component of the name after the "\??\" prefix
+Return Value:
+    A referenced pointer to the device object if the cache holds a current translation, otherwise NULL
+*/
+{
+    POBP_NAME_CACHE_ENTRY Entry;
+    PVOID Object = NULL;
+    ULONG Hash;
+    ULONG i;
+
+    PAGED_CODE();
+
+    if (Name->Length > sizeof(Entry->Name)) {
+        return NULL;
+    }
+
+    Hash = (ULONG)((ULONG_PTR)DeviceMap >> 4);
+    for (i = 0; i < Name->Length / sizeof(WCHAR); i += 1) {
+        Hash = (Hash * 31) + RtlUpcaseUnicodeChar(Name->Buffer[i]);
+    }
+
+    Entry = &ObpNameCache[Hash % OBP_NAME_CACHE_SIZE];
+    KeEnterCriticalRegion();
+    ExAcquirePushLockShared(&ObpNameCacheLock);
+    if ((Entry->Object != NULL) &&
+        (Entry->DeviceMap == DeviceMap) &&
+        (Entry->Generation == ObpNameCacheGeneration) &&
+        (Entry->Length == Name->Length)) {
+        for (i = 0; i < Name->Length / sizeof(WCHAR); i += 1) {
+            if (Entry->Name[i] != RtlUpcaseUnicodeChar(Name->Buffer[i])) {
+                break;
+            }
+        }
+
+        if (i == Name->Length / sizeof(WCHAR)) {
+            Object = Entry->Object;
+            ObReferenceObject(Object);
+        }
+    }
+
+    ExReleasePushLockShared(&ObpNameCacheLock);
+    KeLeaveCriticalRegion();
+    return Object;
+}
+
+
+VOID ObpInsertNameCache(IN PDEVICE_MAP DeviceMap, IN PUNICODE_STRING Name, IN LONG Generation, IN PVOID Object)
+/*
+Routine Description:
+    This routine records the device object a name below the dos devices directory resolved to.
+    The entry is only recorded if nothing in the namespace changed since the lookup started.
+Arguments:
+    DeviceMap - Supplies the device map the name was resolved in
+    Name - Supplies the first component of the name after the "\??\" prefix
+    Generation - Supplies the cache generation that was current when the lookup started
+    Object - Supplies the device object the name resolved to
+Return Value:
+    None.
+*/
+{
+    POBP_NAME_CACHE_ENTRY Entry;
+    PVOID OldObject;
+    ULONG Hash;
+    ULONG i;
+
+    PAGED_CODE();
+
+    ASSERT(Name->Length <= sizeof(Entry->Name));
+
+    Hash = (ULONG)((ULONG_PTR)DeviceMap >> 4);
+    for (i = 0; i < Name->Length / sizeof(WCHAR); i += 1) {
+        Hash = (Hash * 31) + RtlUpcaseUnicodeChar(Name->Buffer[i]);
+    }
+
+    Entry = &ObpNameCache[Hash % OBP_NAME_CACHE_SIZE];
+    ObReferenceObject(Object);
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&ObpNameCacheLock);
+
+    //  The generation is checked under the lock so a purge of this object that ran after the lookup can not be undone here
+    if (Generation != ObpNameCacheGeneration) {
+        OldObject = Object;
+    } else {
+        OldObject = Entry->Object;
+        Entry->Object = Object;
+        Entry->DeviceMap = DeviceMap;
+        Entry->Generation = Generation;
+        Entry->Length = Name->Length;
+        for (i = 0; i < Name->Length / sizeof(WCHAR); i += 1) {
+            Entry->Name[i] = RtlUpcaseUnicodeChar(Name->Buffer[i]);
+        }
+    }
+
+    ExReleasePushLockExclusive(&ObpNameCacheLock);
+    KeLeaveCriticalRegion();
+    if (OldObject != NULL) {
+        ObDereferenceObject(OldObject);
+    }
+}
+
+
+VOID ObpPurgeNameCache(IN PVOID Object)
+/*
+Routine Description:
+    This routine makes every name cache entry stale and drops the entries that refer to an object whose name is being deleted.
+    It is called with the directory of the object locked, so the references are released without running a delete routine inline.
+Arguments:
+    Object - Supplies the object whose directory entry has been removed
+Return Value:
+    None.
+*/
+{
+    PVOID Purged[OBP_NAME_CACHE_SIZE];
+    ULONG Count = 0;
+    ULONG i;
+
+    PAGED_CODE();
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&ObpNameCacheLock);
+    ObpInvalidateNameCache();
+    if ((Object != NULL) && (OBJECT_TO_OBJECT_HEADER(Object)->Type == IoDeviceObjectType)) {
+        for (i = 0; i < OBP_NAME_CACHE_SIZE; i += 1) {
+            if (ObpNameCache[i].Object == Object) {
+                Purged[Count++] = Object;
+                ObpNameCache[i].Object = NULL;
+            }
+        }
+    }
+
+    ExReleasePushLockExclusive(&ObpNameCacheLock);
+    KeLeaveCriticalRegion();
+    while (Count != 0) {
+        ObDereferenceObjectDeferDelete(Purged[--Count]);
+    }
+}
+
+
 NTSTATUS ObpLookupObjectName(IN HANDLE RootDirectoryHandle OPTIONAL,
                              IN PUNICODE_STRING ObjectName,
                              IN ULONG Attributes,
@@ -1040,6 +1293,12 @@ Return Value:
     OB_PARSE_METHOD ParseProcedure;
     extern POBJECT_TYPE IoFileObjectType;
     KPROCESSOR_MODE AccessCheckMode;
+    PVOID CachedObject = NULL;
+    PDEVICE_MAP NameCacheMap = NULL;
+    UNICODE_STRING NameCacheKey;
+    WCHAR NameCacheBuffer[OBP_NAME_CACHE_NAME_LENGTH];
+    USHORT NameCacheTail = 0;
+    LONG NameCacheGeneration = 0;
 
     ObpValidateIrql("ObpLookupObjectName");
 
@@ -1227,6 +1486,45 @@ Return Value:
                             RemainingName = *ObjectName;
                             RemainingName.Buffer += (ObpDosDevicesShortName.Length / sizeof(WCHAR));
                             RemainingName.Length = (USHORT)(RemainingName.Length - ObpDosDevicesShortName.Length);
+
+                            //  A name like "\??\C:\path" opened by a caller that skips traverse checks can use the name cache.
+                            //  The first component is looked up and on a hit we go straight to the parse routine of the device it resolved to before.
+                            if (!ReparsedSymbolicLink &&
+                                (InsertObject == NULL) &&
+                                (Attributes & OBJ_CASE_INSENSITIVE) &&
+                                ((AccessCheckMode == KernelMode) || (AccessState->Flags & TOKEN_HAS_TRAVERSE_PRIVILEGE))) {
+                                NameCacheKey.Buffer = RemainingName.Buffer;
+                                NameCacheKey.Length = 0;
+                                while ((NameCacheKey.Length < RemainingName.Length) &&
+                                    (NameCacheKey.Buffer[NameCacheKey.Length / sizeof(WCHAR)] != OBJ_NAME_PATH_SEPARATOR)) {
+                                    NameCacheKey.Length += sizeof(WCHAR);
+                                }
+
+                                if ((NameCacheKey.Length != 0) &&
+                                    (NameCacheKey.Length <= sizeof(NameCacheBuffer)) &&
+                                    (NameCacheKey.Length < RemainingName.Length)) {
+                                    NameCacheGeneration = ObpNameCacheGeneration;
+                                    CachedObject = ObpLookupNameCache(DeviceMap, &NameCacheKey);
+                                    if (CachedObject != NULL) {
+                                        RemainingName.Buffer += NameCacheKey.Length / sizeof(WCHAR);
+                                        RemainingName.Length = (USHORT)(RemainingName.Length - NameCacheKey.Length);
+                                        ParentDirectory = NULL;
+                                        Directory = NULL;
+                                        Object = CachedObject;
+                                        goto ReparseObject;
+                                    }
+
+                                    //  Remember the component and the length of the rest of the name.
+                                    //  The symbolic links we go through only replace the text in front of the rest,
+                                    //  so if the device parse routine is handed exactly that many characters the component resolved to that device.
+                                    RtlCopyMemory(NameCacheBuffer, NameCacheKey.Buffer, NameCacheKey.Length);
+                                    NameCacheKey.Buffer = NameCacheBuffer;
+                                    NameCacheKey.MaximumLength = sizeof(NameCacheBuffer);
+                                    NameCacheMap = DeviceMap;
+                                    NameCacheTail = (USHORT)(RemainingName.Length - NameCacheKey.Length);
+                                }
+                            }
+
                             goto quickStart;
                         }
                     }
@@ -1444,6 +1742,18 @@ Return Value:
                     ReferencedParentDirectory = NULL;
                 }
 
+                //  Follow a name cache candidate through the symbolic links until it reaches a device with the rest of the name untouched
+                if (NameCacheTail != 0) {
+                    if (RemainingName.Length != NameCacheTail) {
+                        NameCacheTail = 0;
+                    } else if (ObjectHeader->Type == IoDeviceObjectType) {
+                        ObpInsertNameCache(NameCacheMap, &NameCacheKey, NameCacheGeneration, Object);
+                        NameCacheTail = 0;
+                    } else if (ParseProcedure != ObpParseSymbolicLink) {
+                        NameCacheTail = 0;
+                    }
+                }
+
                 ObpBeginTypeSpecificCallOut(SaveIrql);
 
                 //  Call the objects parse routine
@@ -1596,6 +1906,10 @@ Return Value:
         RootDirectoryHandle = NULL;
     }
 
+    if (CachedObject != NULL) {//  Release the reference the name cache gave us on a hit
+        ObDereferenceObject(CachedObject);
+    }
+
     return(Status);//  And return to our caller
 }
 
@@ -1714,12 +2028,13 @@ POBJECT_DIRECTORY_ENTRY ObpUnlinkDirectoryEntry(IN POBJECT_DIRECTORY Directory,
     POBJECT_DIRECTORY_ENTRY DirectoryEntry;
 
     //  The lookup path places the object in the front of the list, so basically we find the object immediately
-    HeadDirectoryEntry = (POBJECT_DIRECTORY_ENTRY*)&Directory->HashBuckets[HashIndex];
+    HeadDirectoryEntry = ObpDirectoryBucket(Directory, HashIndex);
     DirectoryEntry = *HeadDirectoryEntry;
 
     //  Unlink the entry from the head of the bucket chain and free the memory for the entry.
     *HeadDirectoryEntry = DirectoryEntry->ChainLink;
     DirectoryEntry->ChainLink = NULL;
+    Directory->NumberOfEntries -= 1;
     return DirectoryEntry;
 }
 
@@ -1740,12 +2055,14 @@ VOID ObpLinkDirectoryEntry(IN POBJECT_DIRECTORY Directory,
 {
     POBJECT_DIRECTORY_ENTRY* HeadDirectoryEntry;
 
-    HeadDirectoryEntry = (POBJECT_DIRECTORY_ENTRY*)&Directory->HashBuckets[HashIndex];//  Get the right lookup bucket based on the HashIndex
+    HeadDirectoryEntry = ObpDirectoryBucket(Directory, HashIndex);//  Get the right lookup bucket based on the HashIndex
 
     //  Link the new entry into the chain at the insertion point.
     //  This puts the new object right at the head of the current hash bucket chain
     NewDirectoryEntry->ChainLink = *HeadDirectoryEntry;
     *HeadDirectoryEntry = NewDirectoryEntry;
+    Directory->NumberOfEntries += 1;
+    ObpInvalidateNameCache();//  The entry may now be reached by a name that was cached for another object
 }
 
 
@@ -22,6 +22,36 @@ Abstract:
 
 // Define local prototypes
 NTSTATUS ObpIncrementHandleDataBase(IN POBJECT_HEADER ObjectHeader, IN PEPROCESS Process, OUT PULONG NewProcessHandleCount);
+ULONG ObGetHandleCount(VOID)
+/*
+Routine Description:
+    This routine returns the number of handles currently open in the system, summed from the per type handle counts.
+    It does not walk the handle tables, so it is cheap enough to size a handle information buffer,
+    but the value may be stale by the time the caller snapshots the tables.
+Arguments:
+    None.
+Return Value:
+    The number of open handles.
+*/
+{
+    ULONG Count;
+    ULONG i;
+
+    PAGED_CODE();
+
+    Count = 0;
+    for (i = 0; i < OBP_MAX_DEFINED_OBJECT_TYPES; i++) {
+        if (ObpObjectTypes[i] == NULL) {
+            break;
+        }
+
+        Count += ObpObjectTypes[i]->TotalNumberOfHandles;
+    }
+
+    return Count;
+}
+
+
 NTSTATUS ObpCaptureHandleInformation(
     IN OUT PSYSTEM_HANDLE_TABLE_ENTRY_INFO *HandleEntryInfo,
     IN HANDLE UniqueProcessId,
@@ -46,6 +76,7 @@ USHORT RtlLogUmodeStackBackTrace(VOID);
 #pragma alloc_text(PAGE,NtDuplicateObject)
 #pragma alloc_text(PAGE,ObGetHandleInformation)
 #pragma alloc_text(PAGE,ObGetHandleInformationEx)
+#pragma alloc_text(PAGE,ObGetHandleCount)
 #pragma alloc_text(PAGE,ObpCaptureHandleInformation)
 #pragma alloc_text(PAGE,ObpCaptureHandleInformationEx)
 #pragma alloc_text(PAGE,ObpIncrementHandleDataBase)
@@ -72,6 +103,8 @@ Routine Description:
     This function allows safe cross process handle table references.
     Table deletion at process exit waits for all outstanding references to finish.
     Once the table is marked deleted further references are denied byt this function.
+    N.B. If the process has per-processor handle table rundown protection, then it is used instead of the process rundown protection
+         so that concurrent references on different processors do not contend on a single reference count.
 Arguments:
     SourceProcesss - Process whose handle table is to be referenced
 Return Value:
@@ -79,10 +112,19 @@ Return Value:
 */
 {
     PHANDLE_TABLE ObjectTable;
+    PEX_RUNDOWN_REF_CACHE_AWARE RunRefCacheAware;
 
     ObjectTable = NULL;
 
-    if (ExAcquireRundownProtection(&SourceProcess->RundownProtect)) {
+    RunRefCacheAware = SourceProcess->HandleTableRundown;
+    if (RunRefCacheAware != NULL) {
+        if (ExAcquireRundownProtectionCacheAware(RunRefCacheAware)) {
+            ObjectTable = SourceProcess->ObjectTable;
+            if (ObjectTable == NULL) {
+                ExReleaseRundownProtectionCacheAware(RunRefCacheAware);
+            }
+        }
+    } else if (ExAcquireRundownProtection(&SourceProcess->RundownProtect)) {
         ObjectTable = SourceProcess->ObjectTable;
         if (ObjectTable == NULL) {
             ExReleaseRundownProtection(&SourceProcess->RundownProtect);
@@ -101,7 +143,11 @@ Arguments:
     ObjectTable - Handle table to dereference
 */
 {
-    ExReleaseRundownProtection(&SourceProcess->RundownProtect);
+    if (SourceProcess->HandleTableRundown != NULL) {
+        ExReleaseRundownProtectionCacheAware(SourceProcess->HandleTableRundown);
+    } else {
+        ExReleaseRundownProtection(&SourceProcess->RundownProtect);
+    }
 }
 
 
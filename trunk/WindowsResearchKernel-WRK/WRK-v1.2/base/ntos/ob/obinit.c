@@ -57,6 +57,7 @@ BOOLEAN ObAuditInheritedHandleProcedure(IN PHANDLE_TABLE_ENTRY ObjectTableEntry,
 VOID ObDestroyHandleProcedure(IN HANDLE HandleIndex);
 BOOLEAN ObpEnumFindHandleProcedure(PHANDLE_TABLE_ENTRY ObjectTableEntry, HANDLE HandleId, PVOID EnumParameter);
 BOOLEAN ObpCloseHandleProcedure(IN PHANDLE_TABLE_ENTRY HandleTableEntry, IN HANDLE Handle, IN PVOID EnumParameter);
+VOID ObpRundownHandleTableWorker(IN PVOID Parameter);
 #pragma alloc_text(INIT,ObInitSystem)
 #pragma alloc_text(PAGE,ObDupHandleProcedure)
 #pragma alloc_text(PAGE,ObAuditInheritedHandleProcedure)
@@ -66,6 +67,7 @@ BOOLEAN ObpCloseHandleProcedure(IN PHANDLE_TABLE_ENTRY HandleTableEntry, IN HAND
 #pragma alloc_text(PAGE,ObKillProcess)
 #pragma alloc_text(PAGE,ObClearProcessHandleTable)
 #pragma alloc_text(PAGE,ObpCloseHandleProcedure)
+#pragma alloc_text(PAGE,ObpRundownHandleTableWorker)
 #pragma alloc_text(PAGE,ObpEnumFindHandleProcedure)
 #pragma alloc_text(PAGE,ObFindHandleForObject)
 #pragma alloc_text(PAGE,ObpShutdownCloseHandleProcedure)
@@ -215,11 +217,17 @@ Return Value:
         Prcb->PPLookasideList[LookasideNameBufferList].L = &ObpNameBufferLookasideList;
         Prcb->PPLookasideList[LookasideNameBufferList].P = &ObpNameBufferLookasideList;
 
-        ObpRemoveObjectList = NULL;//  Initialize the object removal queue listhead.
+        //  Initialize the per processor object removal queues and their deferred delete work items.
+        for (Index = 0; Index < MAXIMUM_PROCESSORS; Index += 1) {
+            ObpRemoveObjectQueues[Index].List = NULL;
+            ExInitializeWorkItem(&ObpRemoveObjectQueues[Index].WorkItem, ObpProcessRemoveObjectQueue, &ObpRemoveObjectQueues[Index]);
+        }
         ObpInitSecurityDescriptorCache();//  Initialize security descriptor cache
 
         KeInitializeEvent(&ObpDefaultObject, NotificationEvent, TRUE);
         ExInitializePushLock(&ObpLock);
+        ExInitializePushLock(&ObpHandleReaderLock);
+        ExInitializePushLock(&ObpNameCacheLock);
         PsGetCurrentProcess()->GrantedAccess = PROCESS_ALL_ACCESS;
         PsGetCurrentThread()->GrantedAccess = THREAD_ALL_ACCESS;
 
@@ -238,7 +246,6 @@ Return Value:
         ExSetHandleTableStrictFIFO(ObpKernelHandleTable);// On checked make handle reuse take much longer
 #endif
 
-        ExInitializeWorkItem(&ObpRemoveObjectWorkItem, ObpProcessRemoveObjectQueue, NULL);// Initialize the deferred delete work item.
 
         //  Create an object type for the "Type" object.  This is the start of of the object types and goes in the ObpTypeDirectoryObject.
         RtlZeroMemory(&ObjectTypeInitializer, sizeof(ObjectTypeInitializer));
@@ -264,7 +271,7 @@ Return Value:
         ObjectTypeInitializer.GenericMapping = ObpDirectoryMapping;
         ObjectTypeInitializer.UseDefaultObject = TRUE;
         ObjectTypeInitializer.MaintainTypeList = FALSE;
-        ObjectTypeInitializer.DeleteProcedure = NULL;
+        ObjectTypeInitializer.DeleteProcedure = &ObpDeleteDirectory;
         ObCreateObjectType(&DirectoryTypeName, &ObjectTypeInitializer, (PSECURITY_DESCRIPTOR)NULL, &ObpDirectoryObjectType);
 
         //  Clear SYNCHRONIZE from the access mask to not allow synchronization on directory objects
@@ -733,6 +740,69 @@ Arguments:
 }
 
 
+//  Tables with at least this many handles are run down by the exiting thread together with up to OBP_RUNDOWN_MAXIMUM_WORKERS delayed workers.
+//  Each participant claims one low level handle table at a time until the table is exhausted.
+#define OBP_RUNDOWN_PARALLEL_HANDLES 8192
+#define OBP_RUNDOWN_MAXIMUM_WORKERS  4
+
+typedef struct _OBP_RUNDOWN_CONTEXT {
+    OBP_SWEEP_CONTEXT SweepContext;
+    PEPROCESS Process;
+    volatile LONG NextPartition;
+    volatile LONG ActiveSweepers;
+    KEVENT Event;
+    WORK_QUEUE_ITEM WorkItems[OBP_RUNDOWN_MAXIMUM_WORKERS];
+} OBP_RUNDOWN_CONTEXT, *POBP_RUNDOWN_CONTEXT;
+
+
+VOID ObpRundownHandleTablePartitions(IN POBP_RUNDOWN_CONTEXT RundownContext)
+/*
+Routine Description:
+    This function closes the handles of the low level tables not yet claimed by another participant of the rundown.
+    The caller must be in the context of the process being run down and inside a critical region.
+Arguments:
+    RundownContext - Shared rundown state
+*/
+{
+    ULONG Partition;
+
+    do {
+        Partition = (ULONG)InterlockedIncrement(&RundownContext->NextPartition) - 1;
+    } while (ExSweepHandleTablePartition(RundownContext->SweepContext.HandleTable, Partition, ObpCloseHandleProcedure, &RundownContext->SweepContext));
+}
+
+
+VOID ObpRundownHandleTableWorker(IN PVOID Parameter)
+/*
+Routine Description:
+    This is the work routine that helps an exiting thread close the handles of its process.
+    The worker attaches to the process so close and delete procedures see the same process they would on the exiting thread.
+Arguments:
+    Parameter - Shared rundown state
+*/
+{
+    POBP_RUNDOWN_CONTEXT RundownContext = Parameter;
+    KAPC_STATE ApcState;
+    BOOLEAN PreviousIOHardError;
+    PKTHREAD CurrentThread;
+
+    PAGED_CODE();
+
+    KeStackAttachProcess(&RundownContext->Process->Pcb, &ApcState);
+    PreviousIOHardError = IoSetThreadHardErrorMode(FALSE);
+    CurrentThread = KeGetCurrentThread();
+    KeEnterCriticalRegionThread(CurrentThread);
+    ObpRundownHandleTablePartitions(RundownContext);
+    KeLeaveCriticalRegionThread(CurrentThread);
+    IoSetThreadHardErrorMode(PreviousIOHardError);
+    KeUnstackDetachProcess(&ApcState);
+
+    if (InterlockedDecrement(&RundownContext->ActiveSweepers) == 0) {
+        KeSetEvent(&RundownContext->Event, 0, FALSE);
+    }
+}
+
+
 VOID ObKillProcess(PEPROCESS Process)
 /*
 Routine Description:
@@ -746,6 +816,8 @@ Arguments:
     BOOLEAN PreviousIOHardError;
     PKTHREAD CurrentThread;
     OBP_SWEEP_CONTEXT SweepContext;
+    OBP_RUNDOWN_CONTEXT RundownContext;
+    ULONG Workers, Index;
 
     PAGED_CODE();
 
@@ -753,6 +825,10 @@ Arguments:
 
     ExWaitForRundownProtectionRelease(&Process->RundownProtect);// Wait for any cross process references to finish
     ExRundownCompleted(&Process->RundownProtect);// This routine gets recalled multiple times for the same object so just mark the object so future waits work ok.
+    if (Process->HandleTableRundown != NULL) {// Wait for any cross process handle table references made through the per-processor rundown protection
+        ExWaitForRundownProtectionReleaseCacheAware(Process->HandleTableRundown);
+        ExRundownCompletedCacheAware(Process->HandleTableRundown);
+    }
 
     ObjectTable = Process->ObjectTable;
     if (ObjectTable != NULL) {//  If the process does NOT have an object table, return
@@ -765,7 +841,27 @@ Arguments:
         KeEnterCriticalRegionThread(CurrentThread);
         SweepContext.PreviousMode = KernelMode;
         SweepContext.HandleTable = ObjectTable;
-        ExSweepHandleTable(ObjectTable, ObpCloseHandleProcedure, &SweepContext);
+        if (ObjectTable->HandleCount >= OBP_RUNDOWN_PARALLEL_HANDLES && KeNumberProcessors > 1) {
+            //  Nobody can create handles in this table anymore, so the low level tables can be swept concurrently.
+            //  The context lives on this stack, which stays resident since we wait in kernel mode.
+            Workers = min((ULONG)KeNumberProcessors - 1, OBP_RUNDOWN_MAXIMUM_WORKERS);
+            RundownContext.SweepContext = SweepContext;
+            RundownContext.Process = Process;
+            RundownContext.NextPartition = 0;
+            RundownContext.ActiveSweepers = Workers + 1;
+            KeInitializeEvent(&RundownContext.Event, NotificationEvent, FALSE);
+            for (Index = 0; Index < Workers; Index += 1) {
+                ExInitializeWorkItem(&RundownContext.WorkItems[Index], ObpRundownHandleTableWorker, &RundownContext);
+                ExQueueWorkItem(&RundownContext.WorkItems[Index], DelayedWorkQueue);
+            }
+
+            ObpRundownHandleTablePartitions(&RundownContext);
+            if (InterlockedDecrement(&RundownContext.ActiveSweepers) != 0) {
+                KeWaitForSingleObject(&RundownContext.Event, Executive, KernelMode, FALSE, NULL);
+            }
+        } else {
+            ExSweepHandleTable(ObjectTable, ObpCloseHandleProcedure, &SweepContext);
+        }
         ASSERT(ObjectTable->HandleCount == 0);
         KeLeaveCriticalRegionThread(CurrentThread);
         IoSetThreadHardErrorMode(PreviousIOHardError);
@@ -1268,8 +1364,8 @@ Routine Description:
         restart_dir_walk:
             ASSERT(Directory);
 
-            for (Bucket = 0; Bucket < NUMBER_HASH_BUCKETS; Bucket++) {
-                DirectoryEntryPtr = Directory->HashBuckets + Bucket;
+            for (Bucket = 0; Bucket < ObpDirectoryBucketCount(Directory); Bucket++) {
+                DirectoryEntryPtr = ObpDirectoryBucket(Directory, Bucket);
                 while (*DirectoryEntryPtr) {
                     Object = (*DirectoryEntryPtr)->Object;
                     ObjectHeader = OBJECT_TO_OBJECT_HEADER(Object);
@@ -1282,7 +1378,7 @@ Routine Description:
                             DescentDirectory = NULL;
                             if (SymlinkHitDepth > Depth) {
                                 // We hit a symlink in that descent, which potentially rearranged the buckets in this chain; we need to rescan the entire chain.
-                                DirectoryEntryPtr = Directory->HashBuckets + Bucket;
+                                DirectoryEntryPtr = ObpDirectoryBucket(Directory, Bucket);
                                 SymlinkHitDepth = Depth;
                                 continue;
                             }
@@ -1310,6 +1406,7 @@ Routine Description:
                         if (ObjectHeader->HandleCount == 0) {
                             OldDirectoryEntry = *DirectoryEntryPtr;
                             *DirectoryEntryPtr = OldDirectoryEntry->ChainLink;
+                            Directory->NumberOfEntries -= 1;
                             ExFreePool(OldDirectoryEntry);
                             if (!ObjectType->TypeInfo.SecurityRequired) {
                                 ObpBeginTypeSpecificCallOut(SaveIrql);
@@ -1330,7 +1427,7 @@ Routine Description:
                                 SymlinkHitDepth = Depth;
                                 ObpDeleteSymbolicLinkName((POBJECT_SYMBOLIC_LINK)Object);
                                 // Since ObpDeleteSymbolicLinkName may potentially rearrange our buckets, we need to rescan from the beginning of this hash chain.
-                                DirectoryEntryPtr = Directory->HashBuckets + Bucket;
+                                DirectoryEntryPtr = ObpDirectoryBucket(Directory, Bucket);
                             }
 
                             //  Free the name buffer and zero out the name data fields
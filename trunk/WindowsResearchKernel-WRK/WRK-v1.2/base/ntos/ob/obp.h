@@ -78,8 +78,16 @@ struct _OBJECT_BODY_HEADER;
 EX_PUSH_LOCK ObpLock;
 
 KEVENT ObpDefaultObject;
-WORK_QUEUE_ITEM ObpRemoveObjectWorkItem;
-PVOID ObpRemoveObjectList;
+
+//  Objects whose last reference goes away where they cannot be deleted inline are queued on the list of the processor that dropped the reference.
+//  Each list has its own work item, so a burst of teardown is drained by several workers instead of one.
+//  The list head holds the value 1 while its worker is processing a batch.
+typedef struct DECLSPEC_CACHEALIGN _OBP_REMOVE_OBJECT_QUEUE {
+    PVOID List;
+    WORK_QUEUE_ITEM WorkItem;
+} OBP_REMOVE_OBJECT_QUEUE, *POBP_REMOVE_OBJECT_QUEUE;
+
+OBP_REMOVE_OBJECT_QUEUE ObpRemoveObjectQueues[MAXIMUM_PROCESSORS];
 
 //  This global lock is used to protect the device map tear down and build up
 //  We can no longer use an individual lock in the device map itself because that wasn't sufficient to protect the device map itself.
@@ -170,6 +178,52 @@ extern BOOLEAN ObpTraceEnabled;
 #define OBP_MAX_DEFINED_OBJECT_TYPES 48
 POBJECT_TYPE ObpObjectTypes[OBP_MAX_DEFINED_OBJECT_TYPES];
 
+//  Declare a global table of object caches for the object types in the object type table.
+//  An entry is set once, by the first allocation of an object with the common header layout of the type, and is never changed.
+//  If the object cache cannot be created, then the entry is set to disabled and the objects of the type are always allocated from pool.
+#define OBP_OBJECT_CACHE_DISABLED ((PEX_OBJECT_CACHE)1)
+PEX_OBJECT_CACHE ObpObjectTypeCaches[OBP_MAX_DEFINED_OBJECT_TYPES];
+
+#define ObpLookupObjectTypeCache(_ObjectType)                                               \
+    ((((_ObjectType)->Index - 1) < (OBP_MAX_DEFINED_OBJECT_TYPES - 1)) ? ObpObjectTypeCaches[(_ObjectType)->Index - 1] : NULL)
+
+
+//  Declare the state used to reference objects by handle without locking the handle table entry.
+//  A reader counts itself in the slot of its processor for the current epoch while it uses an unlocked entry.
+//  An object that was ever reachable through a handle is not freed until the readers that could have seen it have left.
+//  N.B. A reader decrements the slot it incremented even if it has moved to another processor.
+typedef struct DECLSPEC_CACHEALIGN _OBP_HANDLE_READERS {
+    LONG Count[2];
+} OBP_HANDLE_READERS, *POBP_HANDLE_READERS;
+
+OBP_HANDLE_READERS ObpHandleReaders[MAXIMUM_PROCESSORS];
+volatile LONG ObpHandleReaderEpoch;
+EX_PUSH_LOCK ObpHandleReaderLock;
+
+VOID ObpWaitForHandleReaders(VOID);
+
+
+//  Declare the cache of names below "\??\" whose first component resolves to a device object.
+//  An entry maps a device map and a drive letter style component (e.g. "C:") to the referenced device object,
+//  so a repeated open can skip the directory walk and the symbolic link reparse and go straight to the device parse routine.
+//  Any change to a directory entry or the release of a device map bumps the generation which makes every entry stale.
+#define OBP_NAME_CACHE_SIZE 32
+#define OBP_NAME_CACHE_NAME_LENGTH 16
+
+typedef struct _OBP_NAME_CACHE_ENTRY {
+    PDEVICE_MAP DeviceMap;
+    PVOID Object;
+    LONG Generation;
+    USHORT Length;
+    WCHAR Name[OBP_NAME_CACHE_NAME_LENGTH];
+} OBP_NAME_CACHE_ENTRY, *POBP_NAME_CACHE_ENTRY;
+
+OBP_NAME_CACHE_ENTRY ObpNameCache[OBP_NAME_CACHE_SIZE];
+volatile LONG ObpNameCacheGeneration;
+EX_PUSH_LOCK ObpNameCacheLock;
+
+#define ObpInvalidateNameCache() InterlockedIncrement(&ObpNameCacheGeneration)
+
 
 //  This is some special purpose code to keep a table of access masks correlated with back traces.
 //  If used these routines replace the GrantedAccess mask in the preceding object table entry with a granted access index and a call back index.
@@ -222,9 +276,7 @@ typedef struct _SECURITY_DESCRIPTOR_HEADER {
     LIST_ENTRY Link;
     ULONG  RefCount;
     ULONG  FullHash;
-#if defined (_WIN64)
-    PVOID  Spare;   // Align to 16 byte boundary.
-#endif
+    LUID   DescriptorId;    // Unique for the life of the system, lets Se cache access checks against this descriptor. Keeps 16 byte alignment on _WIN64.
     QUAD   SecurityDescriptor;
 } SECURITY_DESCRIPTOR_HEADER, *PSECURITY_DESCRIPTOR_HEADER;
 
@@ -385,6 +437,7 @@ PVOID ObpLookupDirectoryEntry(
     OUT POBP_LOOKUP_CONTEXT LookupContext);
 BOOLEAN ObpInsertDirectoryEntry(IN POBJECT_DIRECTORY Directory, IN POBP_LOOKUP_CONTEXT LookupContext, IN POBJECT_HEADER ObjectHeader);
 BOOLEAN ObpDeleteDirectoryEntry(IN POBP_LOOKUP_CONTEXT LookupContext);
+VOID ObpDeleteDirectory(IN PVOID Object);
 NTSTATUS ObpLookupObjectName(
     IN HANDLE RootDirectoryHandle,
     IN PUNICODE_STRING ObjectName,
@@ -480,6 +533,7 @@ NTSTATUS ObpCloseHandleTableEntry(
     IN BOOLEAN Rundown);
 NTSTATUS ObpCloseHandle(IN HANDLE Handle, IN KPROCESSOR_MODE PreviousMode);
 VOID ObpDeleteObjectType(IN  PVOID   Object);
+PEX_OBJECT_CACHE ObpGetObjectTypeCache(IN POBJECT_TYPE ObjectType, IN ULONG ObjectSize);
 VOID ObpAuditObjectAccess(IN HANDLE Handle, IN PHANDLE_TABLE_ENTRY_INFO ObjectTableEntryInfo, IN PUNICODE_STRING ObjectTypeName, IN ACCESS_MASK DesiredAccess);
 NTSTATUS ObpQueryNameString(IN PVOID Object, OUT POBJECT_NAME_INFORMATION ObjectNameInfo, IN ULONG Length, OUT PULONG ReturnLength, IN KPROCESSOR_MODE Mode);
 
@@ -630,6 +684,32 @@ Return Value:
 }
 
 
+ULONG FORCEINLINE ObpDirectoryBucketCount(IN POBJECT_DIRECTORY Directory)
+/*
+Routine Description:
+    This Function returns the number of hash buckets currently used by the Directory.
+    The directory must be locked, since the table is only replaced under the exclusive lock.
+Arguments:
+    Directory - The directory being examined
+*/
+{
+    return (Directory->ExtendedHashBuckets != NULL) ? Directory->NumberOfExtendedBuckets : NUMBER_HASH_BUCKETS;
+}
+
+
+POBJECT_DIRECTORY_ENTRY* FORCEINLINE ObpDirectoryBucket(IN POBJECT_DIRECTORY Directory, IN ULONG HashIndex)
+/*
+Routine Description:
+    This Function returns the head of the bucket chain for HashIndex in the Directory's current hash table.
+Arguments:
+    Directory - The directory being examined
+    HashIndex - The bucket index, less than ObpDirectoryBucketCount
+*/
+{
+    return (Directory->ExtendedHashBuckets != NULL) ? &Directory->ExtendedHashBuckets[HashIndex] : &Directory->HashBuckets[HashIndex];
+}
+
+
 VOID FORCEINLINE ObpLockDirectoryExclusive(IN POBJECT_DIRECTORY Directory, IN POBP_LOOKUP_CONTEXT LockContext)
 /*
 Routine Description:
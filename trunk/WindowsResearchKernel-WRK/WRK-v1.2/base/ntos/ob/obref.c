@@ -15,10 +15,22 @@ Abstract:
 
 #undef ObReferenceObjectByHandle
 
+BOOLEAN ObpFastReferenceObjectByHandle(IN PHANDLE_TABLE HandleTable,
+                                       IN HANDLE Handle,
+                                       IN ACCESS_MASK DesiredAccess,
+                                       IN POBJECT_TYPE ObjectType OPTIONAL,
+                                       IN KPROCESSOR_MODE AccessMode,
+                                       OUT PVOID* Object,
+                                       OUT POBJECT_HANDLE_INFORMATION HandleInformation OPTIONAL);
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT,ObpInitStackTrace)
 #pragma alloc_text(PAGE,ObOpenObjectByName)
 #pragma alloc_text(PAGE,ObOpenObjectByPointer)
+#pragma alloc_text(PAGE,ObpFastReferenceObjectByHandle)
+#pragma alloc_text(PAGE,ObpWaitForHandleReaders)
+#pragma alloc_text(PAGE,ObReferenceObjectByUnlockedEntry)
+#pragma alloc_text(PAGE,ObWaitForUnlockedEntryReaders)
 #pragma alloc_text(PAGE,ObReferenceObjectByHandle)
 #pragma alloc_text(PAGE,ObpReferenceProcessObjectByHandle)
 #pragma alloc_text(PAGE,ObReferenceObjectByName)
@@ -589,6 +601,265 @@ Return Value:
 }
 
 
+FORCEINLINE BOOLEAN ObpReferenceObjectIfLive(IN POBJECT_HEADER ObjectHeader)
+/*
+Routine Description:
+    This routine increments the pointer count of an object unless the count has already dropped to zero.
+Arguments:
+    ObjectHeader - Supplies the header of the object being referenced.
+Return Value:
+    TRUE if a reference was taken, and FALSE if the object is being deleted.
+*/
+{
+    LONG_PTR NewCount;
+    LONG_PTR PointerCount;
+
+    PointerCount = *(volatile LONG_PTR *)&ObjectHeader->PointerCount;
+    while (PointerCount != 0) {
+        NewCount = ObpInterlockedCompareExchange(&ObjectHeader->PointerCount, PointerCount + 1, PointerCount);
+        if (NewCount == PointerCount) {
+            return TRUE;
+        }
+
+        PointerCount = NewCount;
+    }
+
+    return FALSE;
+}
+
+
+BOOLEAN ObpFastReferenceObjectByHandle(IN PHANDLE_TABLE HandleTable,
+                                       IN HANDLE Handle,
+                                       IN ACCESS_MASK DesiredAccess,
+                                       IN POBJECT_TYPE ObjectType OPTIONAL,
+                                       IN KPROCESSOR_MODE AccessMode,
+                                       OUT PVOID* Object,
+                                       OUT POBJECT_HANDLE_INFORMATION HandleInformation OPTIONAL
+)
+/*
+Routine Description:
+    This routine references the object behind a handle without locking the handle table entry.
+    The entry is read, a reference is taken on the object if it is still live, and the entry is read again to validate the reference.
+    Since nothing is written to the entry, threads sharing a handle do not contend for the cache line of the entry.
+    N.B. This routine only handles the common case. Any case that needs the entry lock or that fails is left to the caller,
+         which repeats the whole operation on the locked path so that errors, audits and tracing behave as before.
+Arguments:
+    HandleTable - Supplies the handle table the handle belongs to.
+    Handle - Supplies a handle that is not a pseudo handle and has been decoded if it is a kernel handle.
+    DesiredAccess - Supplies the access being requested by the caller
+    ObjectType - Optionally supplies the type of the object we are expecting
+    AccessMode - Supplies the processor mode of the access
+    Object - Receives a pointer to the object body if the operation is successful
+    HandleInformation - Optionally receives information regarding the input handle.
+Return Value:
+    TRUE if the object was referenced, and FALSE if the caller must use the locked path.
+Environment:
+    Kernel mode, inside a critical region.
+*/
+{
+    ULONG Epoch;
+    ACCESS_MASK GrantedAccess;
+    POBJECT_HEADER ObjectHeader;
+    PHANDLE_TABLE_ENTRY ObjectTableEntry;
+    PLONG Readers;
+    BOOLEAN Referenced;
+    HANDLE_TABLE_ENTRY Snapshot;
+
+    PAGED_CODE();
+
+    //  Handle tracing, granted access back traces and reference tracing all need the locked path.
+    if (HandleTable->DebugInfo != NULL) {
+        return FALSE;
+    }
+
+#if i386
+    if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
+        return FALSE;
+    }
+#endif // i386
+
+#ifdef POOL_TAGGING
+    if (ObpTraceEnabled) {
+        return FALSE;
+    }
+#endif // POOL_TAGGING
+
+    //  Count this thread as a reader of the current epoch. If the epoch changed before this thread was counted,
+    //  then a thread freeing an object may not be waiting for this slot, so leave it to the locked path.
+    Epoch = ObpHandleReaderEpoch;
+    Readers = &ObpHandleReaders[KeGetCurrentProcessorNumber()].Count[Epoch];
+    InterlockedIncrement(Readers);
+    if (ObpHandleReaderEpoch != (LONG)Epoch) {
+        InterlockedDecrement(Readers);
+        return FALSE;
+    }
+
+    Referenced = FALSE;
+    ObjectTableEntry = ExReadHandleTableEntry(HandleTable, Handle, &Snapshot);
+    if ((ObjectTableEntry != NULL) && ((Snapshot.ObAttributes & OBJ_AUDIT_OBJECT_CLOSE) == 0)) {
+        ObjectHeader = (POBJECT_HEADER)(((ULONG_PTR)(Snapshot.Object)) & ~OBJ_HANDLE_ATTRIBUTES);
+        GrantedAccess = ObpDecodeGrantedAccess(Snapshot.GrantedAccess);
+        if (((ObjectHeader->Type == ObjectType) || (ObjectType == NULL)) &&
+            ((SeComputeDeniedAccesses(GrantedAccess, DesiredAccess) == 0) || (AccessMode == KernelMode))) {
+            Referenced = ObpReferenceObjectIfLive(ObjectHeader);
+        }
+    }
+
+    if (Referenced) {
+        //  The reference only belongs to the handle if the entry still holds the same object with the same access.
+        KeMemoryBarrier();
+        if ((*(volatile ULONG_PTR *)&ObjectTableEntry->Value != Snapshot.Value) ||
+            (*(volatile ACCESS_MASK *)&ObjectTableEntry->GrantedAccess != Snapshot.GrantedAccess)) {
+            //  The reference must be dropped after this thread stops counting as a reader,
+            //  because the last dereference may free the object and wait for the readers.
+            InterlockedDecrement(Readers);
+            ObDereferenceObject(&ObjectHeader->Body);
+            return FALSE;
+        }
+    }
+
+    InterlockedDecrement(Readers);
+    if (!Referenced) {
+        return FALSE;
+    }
+
+    if (ARGUMENT_PRESENT(HandleInformation)) {
+        HandleInformation->GrantedAccess = GrantedAccess;
+        HandleInformation->HandleAttributes = ObpGetHandleAttributes(&Snapshot);
+    }
+
+    *Object = &ObjectHeader->Body;
+    return TRUE;
+}
+
+
+VOID ObpWaitForHandleReaders(VOID)
+/*
+Routine Description:
+    This routine waits until no thread can still be using a handle table entry it read before the object being freed lost its last handle.
+    If no reader is counted at all, then no wait is needed. Otherwise the epoch is flipped so that new readers count in the other slots,
+    and the readers of the old epoch are waited for.
+    N.B. The readers count themselves before they read an entry, so a reader that is not counted cannot have seen a handle that is already closed.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    ULONG Epoch;
+    LARGE_INTEGER Interval;
+    ULONG Index;
+    LONG Readers;
+
+    PAGED_CODE();
+
+    Readers = 0;
+    for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+        Readers |= ObpHandleReaders[Index].Count[0] | ObpHandleReaders[Index].Count[1];
+    }
+
+    if (Readers == 0) {
+        return;
+    }
+
+    Interval.QuadPart = -10 * 1000;//  1ms
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&ObpHandleReaderLock);
+
+    Epoch = ObpHandleReaderEpoch;
+    InterlockedExchange((PLONG)&ObpHandleReaderEpoch, Epoch ^ 1);
+    do {
+        Readers = 0;
+        for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+            Readers |= *(volatile LONG *)&ObpHandleReaders[Index].Count[Epoch];
+        }
+
+        if (Readers != 0) {
+            KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+        }
+    } while (Readers != 0);
+
+    ExReleasePushLockExclusive(&ObpHandleReaderLock);
+    KeLeaveCriticalRegion();
+}
+
+
+BOOLEAN ObReferenceObjectByUnlockedEntry(IN PHANDLE_TABLE HandleTable, IN HANDLE Handle, OUT PVOID *Object)
+/*
+Routine Description:
+    This routine references the object stored in an entry of a table whose entries hold object bodies, such as the client ID table,
+    without locking the entry. It is the ObpFastReferenceObjectByHandle scheme without the access and attribute checks of object handles.
+    N.B. The owner of the table must call ObWaitForUnlockedEntryReaders after it destroys an entry and before the object can be freed,
+         unless the object was inserted, in which case the free path already waits.
+Arguments:
+    HandleTable - Supplies the table the handle belongs to.
+    Handle - Supplies the handle of the entry.
+    Object - Receives a referenced pointer to the object body if the operation is successful.
+Return Value:
+    TRUE if the object was referenced, and FALSE if the caller must look the entry up with the entry locked.
+Environment:
+    Kernel mode, inside a critical region.
+*/
+{
+    ULONG Epoch;
+    PVOID Body;
+    PHANDLE_TABLE_ENTRY TableEntry;
+    PLONG Readers;
+    HANDLE_TABLE_ENTRY Snapshot;
+
+    PAGED_CODE();
+
+    if (HandleTable->DebugInfo != NULL) {
+        return FALSE;
+    }
+
+    Epoch = ObpHandleReaderEpoch;
+    Readers = &ObpHandleReaders[KeGetCurrentProcessorNumber()].Count[Epoch];
+    InterlockedIncrement(Readers);
+    if (ObpHandleReaderEpoch != (LONG)Epoch) {
+        InterlockedDecrement(Readers);
+        return FALSE;
+    }
+
+    TableEntry = ExReadHandleTableEntry(HandleTable, Handle, &Snapshot);
+    if (TableEntry == NULL) {
+        InterlockedDecrement(Readers);
+        return FALSE;
+    }
+
+    Body = (PVOID)(((ULONG_PTR)(Snapshot.Object)) & ~OBJ_HANDLE_ATTRIBUTES);
+    if (!ObReferenceObjectSafe(Body)) {
+        InterlockedDecrement(Readers);
+        return FALSE;
+    }
+
+    //  The entry may have been destroyed and reused for another object while the reference was taken.
+    KeMemoryBarrier();
+    if (*(volatile ULONG_PTR *)&TableEntry->Value != Snapshot.Value) {
+        InterlockedDecrement(Readers);
+        ObDereferenceObject(Body);
+        return FALSE;
+    }
+
+    InterlockedDecrement(Readers);
+    *Object = Body;
+    return TRUE;
+}
+
+
+VOID ObWaitForUnlockedEntryReaders(VOID)
+/*
+Routine Description:
+    This routine waits until no thread in ObReferenceObjectByUnlockedEntry can still be using an entry it read before the entry was destroyed.
+Environment:
+    Kernel mode, PASSIVE_LEVEL.
+*/
+{
+    PAGED_CODE();
+
+    ObpWaitForHandleReaders();
+}
+
+
 NTSTATUS ObReferenceObjectByHandle(__in HANDLE Handle,
                                    __in ACCESS_MASK DesiredAccess,
                                    __in_opt POBJECT_TYPE ObjectType,
@@ -691,6 +962,13 @@ Return Value:
 
     KeEnterCriticalRegionThread(&Thread->Tcb);// Protect this thread from being suspended while we hold the handle table entry lock
 
+    //  Try to reference the object without locking the handle table entry first.
+    if (ObpFastReferenceObjectByHandle(HandleTable, Handle, DesiredAccess, ObjectType, AccessMode, Object, HandleInformation)) {
+        KeLeaveCriticalRegionThread(&Thread->Tcb);
+        ASSERT(*Object != NULL);
+        return STATUS_SUCCESS;
+    }
+
     //  Translate the specified handle to an object table index.
     ObjectTableEntry = ExMapHandleToPointerEx(HandleTable, Handle, AccessMode);
     if (ObjectTableEntry != NULL) {//  Make sure the object table entry really does exist
@@ -1237,19 +1515,22 @@ Return Value:
 
 VOID ObpDeferObjectDeletion(IN POBJECT_HEADER ObjectHeader)
 {
+    POBP_REMOVE_OBJECT_QUEUE Queue;
     PVOID OldValue;
 
-    // Push this object on the list. If we make an empty to non-empty transition then we may have to start a worker thread.
+    // Push this object on the list of the current processor. If we move to another processor meanwhile we just use a remote list.
+    // If we make an empty to non-empty transition then we may have to start a worker thread.
+    Queue = &ObpRemoveObjectQueues[KeGetCurrentProcessorNumber()];
     while (1) {
-        OldValue = ReadForWriteAccess(&ObpRemoveObjectList);
+        OldValue = ReadForWriteAccess(&Queue->List);
         ObjectHeader->NextToFree = OldValue;
-        if (InterlockedCompareExchangePointer(&ObpRemoveObjectList, ObjectHeader, OldValue) == OldValue) {
+        if (InterlockedCompareExchangePointer(&Queue->List, ObjectHeader, OldValue) == OldValue) {
             break;
         }
     }
 
     if (OldValue == NULL) {//  If we have to start the worker thread then go ahead and enqueue the work item        
-        ExQueueWorkItem(&ObpRemoveObjectWorkItem, CriticalWorkQueue);
+        ExQueueWorkItem(&Queue->WorkItem, CriticalWorkQueue);
     }
 }
 
@@ -1429,23 +1710,24 @@ VOID ObDereferenceObjectDeferDelete(IN PVOID Object)
 VOID ObpProcessRemoveObjectQueue(PVOID Parameter)
 /*
 Routine Description:
-    This is the work routine for the remove object work queue.
-    Its job is to remove and process items from the remove object queue.
+    This is the work routine for a per processor remove object work queue.
+    Its job is to remove and process items from that remove object queue.
+    The queues are drained independently, so objects queued on different processors are deleted in parallel.
+    This is no different from objects being deleted inline by concurrent ObDereferenceObject callers.
 Arguments:
-    Parameter - Ignored
+    Parameter - The OBP_REMOVE_OBJECT_QUEUE being drained
 */
 {
+    POBP_REMOVE_OBJECT_QUEUE Queue = (POBP_REMOVE_OBJECT_QUEUE)Parameter;
     POBJECT_HEADER ObjectHeader, NextObject;
 
-    UNREFERENCED_PARAMETER(Parameter);
-
     // Process the list of deferred delete objects.
     // The list head serves two purposes.
     // First it maintains the list of objects we need to delete and second it signals that this thread is active.
     // While we are processing the latest list we leave the header as the value 1. 
     // This will never be an object address as the bottom bits should be clear for an object.
     while (1) {
-        ObjectHeader = InterlockedExchangePointer(&ObpRemoveObjectList, (PVOID)1);
+        ObjectHeader = InterlockedExchangePointer(&Queue->List, (PVOID)1);
         while (1) {
 #ifdef POOL_TAGGING
             if (ObpTraceEnabled && !ObpTraceNoDeregister) {
@@ -1453,6 +1735,10 @@ Arguments:
             }
 #endif
             NextObject = ObjectHeader->NextToFree;
+            if (NextObject != NULL && NextObject != (PVOID)1) {
+                PreFetchCacheLine(PF_TEMPORAL_LEVEL_1, NextObject);// The next header is touched right after this object is freed
+            }
+
             ObpRemoveObjectRoutine(&ObjectHeader->Body, TRUE);
             ObjectHeader = NextObject;
             if (ObjectHeader == NULL || ObjectHeader == (PVOID)1) {
@@ -1460,7 +1746,7 @@ Arguments:
             }
         }
 
-        if (ObpRemoveObjectList == (PVOID)1 && InterlockedCompareExchangePointer(&ObpRemoveObjectList, NULL, (PVOID)1) == (PVOID)1) {
+        if (Queue->List == (PVOID)1 && InterlockedCompareExchangePointer(&Queue->List, NULL, (PVOID)1) == (PVOID)1) {
             break;
         }
     }
@@ -328,6 +328,7 @@ Return Value:
     //  Fill the header, copy over the descriptor data, and return to our caller
     NewDescriptor->RefCount = RefBias;
     NewDescriptor->FullHash = FullHash;
+    ExAllocateLocallyUniqueId(&NewDescriptor->DescriptorId);
     RtlCopyMemory(&NewDescriptor->SecurityDescriptor, InputSecurityDescriptor, SecurityDescriptorLength);
     return NewDescriptor;
 }
@@ -273,16 +273,17 @@ BOOLEAN ObCheckObjectAccess(
     SeLockSubjectContext(&AccessState->SubjectSecurityContext);
 
     //  Do the access check, and if we have some privileges then put those in the access state too.
-    AccessAllowed = SeAccessCheck(SecurityDescriptor,
-                                  &AccessState->SubjectSecurityContext,
-                                  TRUE,                        // Tokens are locked
-                                  AccessState->RemainingDesiredAccess,
-                                  AccessState->PreviouslyGrantedAccess,
-                                  &Privileges,
-                                  &ObjectType->TypeInfo.GenericMapping,
-                                  AccessMode,
-                                  &GrantedAccess,
-                                  AccessStatus);
+    //  Descriptors from the security descriptor cache have an identity, which lets repeated opens with the same token reuse the result.
+    AccessAllowed = SeCachedAccessCheck(SecurityDescriptor,
+                                        MemoryAllocated ? NULL : &SD_TO_SD_HEADER(SecurityDescriptor)->DescriptorId,
+                                        &AccessState->SubjectSecurityContext,
+                                        AccessState->RemainingDesiredAccess,
+                                        AccessState->PreviouslyGrantedAccess,
+                                        &Privileges,
+                                        &ObjectType->TypeInfo.GenericMapping,
+                                        AccessMode,
+                                        &GrantedAccess,
+                                        AccessStatus);
     if (Privileges != NULL) {
         Status = SeAppendPrivileges(AccessState, Privileges);
         SeFreePrivileges(Privileges);
@@ -454,10 +455,19 @@ BOOLEAN ObpCheckTraverseAccess(
 
         //  The world does not have traverse access and we have the client's access state so lock down the client's token and then do the access check, 
         //  appending privileges if present.
-        //  The access check will give the answer we return back to our caller
+        //  The access check will give the answer we return back to our caller.
+        //  Opening a deep path checks every directory along it, so the result is remembered in the token for descriptors that have an identity.
         SeLockSubjectContext(&AccessState->SubjectSecurityContext);
-        AccessAllowed = SeAccessCheck(SecurityDescriptor, &AccessState->SubjectSecurityContext, TRUE,             // Tokens are locked
-                                      TraverseAccess, 0, &Privileges, &ObjectType->TypeInfo.GenericMapping, PreviousMode, &GrantedAccess, AccessStatus);
+        AccessAllowed = SeCachedAccessCheck(SecurityDescriptor,
+                                            (MemoryAllocated || SecurityDescriptor == NULL) ? NULL : &SD_TO_SD_HEADER(SecurityDescriptor)->DescriptorId,
+                                            &AccessState->SubjectSecurityContext,
+                                            TraverseAccess,
+                                            0,
+                                            &Privileges,
+                                            &ObjectType->TypeInfo.GenericMapping,
+                                            PreviousMode,
+                                            &GrantedAccess,
+                                            AccessStatus);
         if (Privileges != NULL) {
             Status = SeAppendPrivileges(AccessState, Privileges);
             SeFreePrivileges(Privileges);
@@ -21,6 +21,7 @@ typedef struct _OBJECT_TYPE_ARRAY
 
 POBJECT_TYPE_ARRAY ObpCreateTypeArray(IN POBJECT_TYPE ObjectType);
 VOID ObpDestroyTypeArray(IN POBJECT_TYPE_ARRAY ObjectArray);
+VOID ObpConstructObject(IN PVOID Object, IN PVOID Context);
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,ObCreateObjectType)
@@ -29,6 +30,8 @@ VOID ObpDestroyTypeArray(IN POBJECT_TYPE_ARRAY ObjectArray);
 #pragma alloc_text(PAGE,ObpDestroyTypeArray)
 #pragma alloc_text(PAGE,ObGetObjectInformation)
 #pragma alloc_text(PAGE,ObpDeleteObjectType)
+#pragma alloc_text(PAGE,ObpGetObjectTypeCache)
+#pragma alloc_text(PAGE,ObpConstructObject)
 #endif
 
 /*
@@ -260,13 +263,113 @@ Arguments:
 {
     ULONG i;
     POBJECT_TYPE ObjectType = (POBJECT_TYPE)Object;
+    PEX_OBJECT_CACHE ObjectCache;
 
-    //  The only cleaning up we need to do is to delete the type resource
+    //  The only cleaning up we need to do is to delete the type resource and the object cache of the type.
+    //  There are no objects of the type left, so the object cache holds only cached objects.
     for (i = 0; i < OBJECT_LOCK_COUNT; i++) {
         ExDeleteResourceLite(&ObjectType->ObjectLocks[i]);
     }
 
     ExDeleteResourceLite(&ObjectType->Mutex);
+    ObjectCache = ObpLookupObjectTypeCache(ObjectType);
+    if ((ObjectCache != NULL) && (ObjectCache != OBP_OBJECT_CACHE_DISABLED)) {
+        ObpObjectTypeCaches[ObjectType->Index - 1] = OBP_OBJECT_CACHE_DISABLED;
+        ExDeleteObjectCache(ObjectCache);
+        ExFreePoolWithTag(ObjectCache, 'cTbO');
+    }
+}
+
+
+PEX_OBJECT_CACHE ObpGetObjectTypeCache(IN POBJECT_TYPE ObjectType, IN ULONG ObjectSize)
+/*
+Routine Description:
+    This routine returns the object cache for objects of the specified type that have the common header layout of the type.
+    The common header layout has no quota or name information, so objects that are created unnamed and with the default quota charges use it.
+    If the object type does not have an object cache yet, then one is created with an entry size of the specified object size.
+Arguments:
+    ObjectType - Supplies the type of the object being allocated.
+    ObjectSize - Supplies the size of the object header, optional header information, and body.
+Return Value:
+    A pointer to the object cache, or NULL if objects of the type are allocated from pool.
+*/
+{
+    PEX_OBJECT_CACHE ObjectCache;
+    PEX_OBJECT_CACHE PreviousCache;
+    PEX_OBJECT_CACHE *ObjectCacheEntry;
+    POOL_TYPE PoolType;
+
+    PAGED_CODE();
+
+    if ((ObjectType->Index - 1) >= (OBP_MAX_DEFINED_OBJECT_TYPES - 1)) {
+        return NULL;
+    }
+
+    //  If this is the first object of the type with the common header layout, then create the object cache of the type.
+
+    //  N.B. No object with the common header layout is allocated before the entry is set, so ObpFreeObject can tell cached objects from the entry and the header layout.
+    ObjectCacheEntry = &ObpObjectTypeCaches[ObjectType->Index - 1];
+    ObjectCache = *ObjectCacheEntry;
+    if (ObjectCache == NULL) {
+        if (ObjectType->TypeInfo.PoolType == NonPagedPool) {
+            PoolType = NonPagedPool;
+        } else {
+            PoolType = PagedPool;
+        }
+
+        ObjectCache = ExAllocatePoolWithTag(NonPagedPoolCacheAligned, sizeof(EX_OBJECT_CACHE), 'cTbO');
+        if (ObjectCache != NULL) {
+            if (!NT_SUCCESS(ExInitializeObjectCache(ObjectCache, PoolType, ObjectSize, ObjectType->Key | PROTECTED_POOL, ObpConstructObject, NULL, ObjectType))) {
+                ExFreePoolWithTag(ObjectCache, 'cTbO');
+                ObjectCache = OBP_OBJECT_CACHE_DISABLED;
+            }
+        } else {
+            ObjectCache = OBP_OBJECT_CACHE_DISABLED;
+        }
+
+        PreviousCache = InterlockedCompareExchangePointer(ObjectCacheEntry, ObjectCache, NULL);
+        if (PreviousCache != NULL) {
+            if (ObjectCache != OBP_OBJECT_CACHE_DISABLED) {
+                ExDeleteObjectCache(ObjectCache);
+                ExFreePoolWithTag(ObjectCache, 'cTbO');
+            }
+
+            ObjectCache = PreviousCache;
+        }
+    }
+
+    if (ObjectCache == OBP_OBJECT_CACHE_DISABLED) {
+        return NULL;
+    }
+
+    return ObjectCache;
+}
+
+
+VOID ObpConstructObject(IN PVOID Object, IN PVOID Context)
+/*
+Routine Description:
+    This routine is the object cache constructor for objects with the common header layout of a type.
+    It sets the optional header offsets, which do not change while the object is cached, so ObpAllocateObject does not recompute them.
+Arguments:
+    Object - Supplies a pointer to the start of the object allocation.
+    Context - Supplies a pointer to the object type.
+*/
+{
+    ULONG CreatorInfoSize;
+    ULONG HandleInfoSize;
+    POBJECT_HEADER ObjectHeader;
+    POBJECT_TYPE ObjectType;
+
+    PAGED_CODE();
+
+    ObjectType = (POBJECT_TYPE)Context;
+    HandleInfoSize = ObjectType->TypeInfo.MaintainHandleCount ? sizeof(OBJECT_HEADER_HANDLE_INFO) : 0;
+    CreatorInfoSize = ObjectType->TypeInfo.MaintainTypeList ? sizeof(OBJECT_HEADER_CREATOR_INFO) : 0;
+    ObjectHeader = (POBJECT_HEADER)((PUCHAR)Object + HandleInfoSize + CreatorInfoSize);
+    ObjectHeader->QuotaInfoOffset = 0;
+    ObjectHeader->HandleInfoOffset = (UCHAR)((HandleInfoSize != 0) ? (HandleInfoSize + CreatorInfoSize) : 0);
+    ObjectHeader->NameInfoOffset = 0;
 }
 
 
@@ -33,35 +33,41 @@ Abstract:
 VOID PerfInfoFlushProfileCache(VOID)
 /*
 Routine description:
-    Flushes the profile cache to the log buffer.
-    To make sure it get's valid data we read the 2 separate version numbers (1 before and 1 after) to check if it's been changed.
-    If so, we just read again.  If that fails often, then we disable the cache.
-    Once the cache is read, we clear it.
+    Flushes the per processor profile caches to the log buffer.
+    Each cache is claimed through its InUse flag before it is read so that the profile interrupt on that processor cannot change it underneath us.
+    If the interrupt holds a cache, we skip it; the interrupt flushes it itself once it fills up.
+    Once a cache is read, we clear it.
     This may cause samples to be lost but that's ok as this is statistical and it won't matter.
-Arguments:
-    CheckVersion - If FALSE, the version is not checked. This used when the profile interrupt code flushes the cache.
 */
 {
-    ULONG PreviousInProgress;
+    PPERFINFO_PROCESSOR_PROFILE_CACHE ProcessorCache;
+    ULONG i;
 
-    if ((PerfProfileCache.Entries == 0) || (PerfInfoSampledProfileCaching == FALSE)) {
+    if (PerfInfoSampledProfileCaching == FALSE) {
         return;
     }
 
-    // Signal the interrupt not to mess with the cache
-    PreviousInProgress = InterlockedIncrement(&PerfInfoSampledProfileFlushInProgress);
-    if (PreviousInProgress != 1) {
-        InterlockedDecrement(&PerfInfoSampledProfileFlushInProgress);// A flush is already in progress so just return.
-        return;
-    }
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++) {
+        ProcessorCache = &PerfProfileCache[i];
+        if (ProcessorCache->Cache.Entries == 0) {
+            continue;
+        }
+
+        if (InterlockedCompareExchange(&ProcessorCache->InUse, 1, 0) != 0) {
+            continue;// The profile interrupt on that processor is using the cache.
+        }
+
+        // Log the portion of the cache that has valid data.
+        if (ProcessorCache->Cache.Entries != 0) {
+            PerfInfoLogBytes(PERFINFO_LOG_TYPE_SAMPLED_PROFILE_CACHE,
+                             &ProcessorCache->Cache,
+                             FIELD_OFFSET(PERFINFO_SAMPLED_PROFILE_CACHE, Sample) + (ProcessorCache->Cache.Entries * sizeof(PERFINFO_SAMPLED_PROFILE_INFORMATION)));
 
-    // Log the portion of the cache that has valid data.
-    PerfInfoLogBytes(PERFINFO_LOG_TYPE_SAMPLED_PROFILE_CACHE,
-                     &PerfProfileCache, 
-                     FIELD_OFFSET(PERFINFO_SAMPLED_PROFILE_CACHE, Sample) + (PerfProfileCache.Entries * sizeof(PERFINFO_SAMPLED_PROFILE_INFORMATION)));
+            ProcessorCache->Cache.Entries = 0;// Clear the cache for the next set of entries.
+        }
 
-    PerfProfileCache.Entries = 0;// Clear the cache for the next set of entries.
-    InterlockedDecrement(&PerfInfoSampledProfileFlushInProgress);// Let the interrupt fill the cache again.
+        InterlockedExchange(&ProcessorCache->InUse, 0);// Let the interrupt fill the cache again.
+    }
 }
 
 
@@ -69,8 +75,8 @@ VOID FASTCALL PerfProfileInterrupt(IN KPROFILE_SOURCE Source, IN PVOID Instructi
 /*
 Routine description:
     Implements instruction profiling.  If the source is not the one we're sampling on, we return.
-    If caching is off, we write any samples coming from the immediately to the log.
-    If caching is on, wrap the cache update with writes to the two versions so that the flush routine can know if it has a valid buffer.
+    If caching is off, or the cache of this processor is being flushed, we write the sample immediately to the log.
+    Otherwise the sample goes into the cache of the current processor, which only this interrupt and the flush routine touch.
 Arguments:
     Source - Type of profile interrupt
     InstructionPointer - IP at the time of the interrupt
@@ -78,17 +84,20 @@ Arguments:
 {
     ULONG i;
     PERFINFO_SAMPLED_PROFILE_INFORMATION SampleData;
+    PPERFINFO_PROCESSOR_PROFILE_CACHE ProcessorCache;
+    PPERFINFO_SAMPLED_PROFILE_CACHE Cache;
 #ifdef _X86_
     ULONG_PTR TwiddledIP;
 #endif // _X86_
     ULONG ThreadId;
 
-    if (!PERFINFO_IS_GROUP_ON(PERF_PROFILE) && (Source != PerfInfoProfileSourceActive)) {
+    if (!PERFINFO_IS_GROUP_ON(PERF_PROFILE) || (Source != PerfInfoProfileSourceActive)) {
         return;// We don't handle multple sources.
     }
 
     ThreadId = HandleToUlong(PsGetCurrentThread()->Cid.UniqueThread);
-    if (!PerfInfoSampledProfileCaching || PerfInfoSampledProfileFlushInProgress != 0) {// No caching. Log and return.
+    ProcessorCache = &PerfProfileCache[KeGetCurrentProcessorNumber()];
+    if (!PerfInfoSampledProfileCaching || (InterlockedCompareExchange(&ProcessorCache->InUse, 1, 0) != 0)) {// No caching. Log and return.
         SampleData.ThreadId = ThreadId;
         SampleData.InstructionPointer = InstructionPointer;
         SampleData.Count = 1;
@@ -96,38 +105,43 @@ Arguments:
         return;
     }
 
+    Cache = &ProcessorCache->Cache;
+
 #ifdef _X86_
     // Clear the low two bits to have more cache hits for loops.  Don't waste cycles on other architectures.
     TwiddledIP = (ULONG_PTR)InstructionPointer & ~3;
 #endif
 
     // Initial walk thru Instruction Pointer Cache.  Bump Count if address is in cache.
-    for (i = 0; i < PerfProfileCache.Entries; i++) {
-        if ((PerfProfileCache.Sample[i].ThreadId == ThreadId) &&
+    for (i = 0; i < Cache->Entries; i++) {
+        if ((Cache->Sample[i].ThreadId == ThreadId) &&
 #ifdef _X86_
-        (((ULONG_PTR)PerfProfileCache.Sample[i].InstructionPointer & ~3) == TwiddledIP)
+        (((ULONG_PTR)Cache->Sample[i].InstructionPointer & ~3) == TwiddledIP)
 #else
-            (PerfProfileCache.Sample[i].InstructionPointer == InstructionPointer)
+            (Cache->Sample[i].InstructionPointer == InstructionPointer)
 #endif // _X86_
             ) {
-            PerfProfileCache.Sample[i].Count++;// If we find the instruction pointer in the cache, bump the count
-            return;
+            Cache->Sample[i].Count++;// If we find the instruction pointer in the cache, bump the count
+            goto Done;
         }
     }
-    if (PerfProfileCache.Entries < PERFINFO_SAMPLED_PROFILE_CACHE_MAX) {// If we find an empty spot in the cache, use it for this instruction pointer
-        PerfProfileCache.Sample[i].ThreadId = ThreadId;
-        PerfProfileCache.Sample[i].InstructionPointer = InstructionPointer;
-        PerfProfileCache.Sample[i].Count = 1;
-        PerfProfileCache.Entries++;
-        return;
+    if (Cache->Entries < PERFINFO_SAMPLED_PROFILE_CACHE_MAX) {// If we find an empty spot in the cache, use it for this instruction pointer
+        Cache->Sample[i].ThreadId = ThreadId;
+        Cache->Sample[i].InstructionPointer = InstructionPointer;
+        Cache->Sample[i].Count = 1;
+        Cache->Entries++;
+        goto Done;
     }
 
     // Flush the cache
-    PerfInfoLogBytes(PERFINFO_LOG_TYPE_SAMPLED_PROFILE_CACHE, &PerfProfileCache, sizeof(PERFINFO_SAMPLED_PROFILE_CACHE));
-    PerfProfileCache.Sample[0].ThreadId = ThreadId;
-    PerfProfileCache.Sample[0].InstructionPointer = InstructionPointer;
-    PerfProfileCache.Sample[0].Count = 1;
-    PerfProfileCache.Entries = 1;
+    PerfInfoLogBytes(PERFINFO_LOG_TYPE_SAMPLED_PROFILE_CACHE, Cache, sizeof(PERFINFO_SAMPLED_PROFILE_CACHE));
+    Cache->Sample[0].ThreadId = ThreadId;
+    Cache->Sample[0].InstructionPointer = InstructionPointer;
+    Cache->Sample[0].Count = 1;
+    Cache->Entries = 1;
+
+Done:
+    InterlockedExchange(&ProcessorCache->InUse, 0);
 }
 
 
@@ -16,6 +16,7 @@ Abstract:
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGEWMI, PerfInfoReserveBytes)
 #pragma alloc_text(PAGEWMI, PerfInfoLogBytes)
+#pragma alloc_text(PAGEWMI, PerfInfoLogStackTrace)
 #endif //ALLOC_PRAGMA
 
 
@@ -75,5 +76,70 @@ Return Value:
 
     RtlCopyMemory(PERFINFO_HOOK_HANDLE_TO_DATA(Hook, PPERF_BYTE), Data, BytesToLog);
     PERF_FINISH_HOOK(Hook);
+
+    // Memory, disk I/O and pool events get the stack of the caller when asked for.
+    switch (HookId & 0xFF00) {
+    case EVENT_TRACE_GROUP_IO:
+    case EVENT_TRACE_GROUP_MEMORY:
+    case EVENT_TRACE_GROUP_POOL:
+        PERFINFO_LOG_STACK_TRACE(HookId);
+        break;
+    }
+
     return STATUS_SUCCESS;
+}
+
+
+VOID PerfInfoLogStackTrace(USHORT HookId)
+/*
+Routine Description:
+    Captures the kernel stack of the caller and logs it right after the event it belongs to.
+    If this processor logged the same stack recently, only the hash is logged and the
+    consumer resolves it from the earlier record with the same HookId and StackHash.
+Arguments:
+    HookId - Id of the hook that was just logged
+Environment:
+    Any IRQL at which the event itself can be logged.
+*/
+{
+    PVOID Frames[PERFINFO_STACK_TRACE_DEPTH];
+    PERFINFO_HOOK_HANDLE Hook;
+    PPERFINFO_STACK_TRACE_INFORMATION StackTrace;
+    PULONG CacheEntry;
+    ULONG FrameCount;
+    ULONG StackHash;
+    NTSTATUS Status;
+
+    // Skip this routine and the logging routine that called it
+    FrameCount = RtlCaptureStackBackTrace(2, PERFINFO_STACK_TRACE_DEPTH, Frames, NULL);
+    if (FrameCount == 0) {
+        return;
+    }
+
+    // Never let a hash of zero match an empty cache slot
+    StackHash = PerfInfoCalcHashValue(Frames, FrameCount * sizeof(PVOID)) | 1;
+
+    // The cache is only a hint; an entry overwritten by a preempted
+    // logger on the same processor merely costs a full stack record.
+    CacheEntry = &PerfStackCache[KeGetCurrentProcessorNumber()].Hash[StackHash & (PERFINFO_STACK_CACHE_SIZE - 1)];
+    if (*CacheEntry == StackHash) {
+        FrameCount = 0;
+    } else {
+        *CacheEntry = StackHash;
+    }
+
+    Status = PerfInfoReserveBytes(&Hook, PERFINFO_LOG_TYPE_BACKTRACE, FIELD_OFFSET(PERFINFO_STACK_TRACE_INFORMATION, Frames) + FrameCount * sizeof(PVOID));
+    if (!NT_SUCCESS(Status)) {
+        if (FrameCount != 0) {
+            *CacheEntry = 0;// The full stack never made it into the trace
+        }
+        return;
+    }
+
+    StackTrace = PERFINFO_HOOK_HANDLE_TO_DATA(Hook, PPERFINFO_STACK_TRACE_INFORMATION);
+    StackTrace->HookId = HookId;
+    StackTrace->FrameCount = (USHORT)FrameCount;
+    StackTrace->StackHash = StackHash;
+    RtlCopyMemory(StackTrace->Frames, Frames, FrameCount * sizeof(PVOID));
+    PERF_FINISH_HOOK(Hook);
 }
\ No newline at end of file
@@ -23,5 +23,7 @@ KPROFILE_SOURCE PerfInfoProfileSourceActive = ProfileMaximum;   // Set to invali
 KPROFILE_SOURCE PerfInfoProfileSourceRequested = ProfileTime;
 KPROFILE_SOURCE PerfInfoProfileInterval = 10000;    // 1ms in 100ns ticks
 BOOLEAN PerfInfoSampledProfileCaching;
-LONG PerfInfoSampledProfileFlushInProgress;
-PERFINFO_SAMPLED_PROFILE_CACHE PerfProfileCache;
\ No newline at end of file
+PERFINFO_PROCESSOR_PROFILE_CACHE PerfProfileCache[MAXIMUM_PROCESSORS];
+
+// Stack traces
+PERFINFO_STACK_CACHE PerfStackCache[MAXIMUM_PROCESSORS];
@@ -30,17 +30,42 @@ Abstract:
 #include "ntos.h"
 
 // Profiling structures
+// Each processor caches the samples taken by its own profile interrupt.
+// InUse is claimed by the interrupt while it updates the cache and by anyone flushing it.
+typedef struct _PERFINFO_PROCESSOR_PROFILE_CACHE {
+    LONG InUse;
+    PERFINFO_SAMPLED_PROFILE_CACHE Cache;
+} PERFINFO_PROCESSOR_PROFILE_CACHE, *PPERFINFO_PROCESSOR_PROFILE_CACHE;
+
 extern KPROFILE PerfInfoProfileObject;
-extern PERFINFO_SAMPLED_PROFILE_CACHE PerfProfileCache;
+extern PERFINFO_PROCESSOR_PROFILE_CACHE PerfProfileCache[MAXIMUM_PROCESSORS];
 extern BOOLEAN PerfInfoSampledProfileCaching;
 extern KPROFILE_SOURCE PerfInfoProfileSourceActive;
 extern KPROFILE_SOURCE PerfInfoProfileSourceRequested;
 extern KPROFILE_SOURCE PerfInfoProfileInterval;
-extern LONG PerfInfoSampledProfileFlushInProgress;
 extern PERFINFO_GROUPMASK PerfGlobalGroupMask;
 
 #define PERFPOOLTAG 'freP'
 
+// Stack traces logged for PERF_BACKTRACE.
+// Each processor remembers the hashes of the stacks it logged most recently
+// so that a repeated stack is logged as a reference to its hash only.
+#define PERFINFO_STACK_TRACE_DEPTH  32
+#define PERFINFO_STACK_CACHE_SIZE   16  // Must be a power of two
+
+typedef struct _PERFINFO_STACK_TRACE_INFORMATION {
+    USHORT HookId;          // Hook of the event the stack belongs to
+    USHORT FrameCount;      // Zero if the stack was already logged with this hash
+    ULONG StackHash;
+    PVOID Frames[1];
+} PERFINFO_STACK_TRACE_INFORMATION, *PPERFINFO_STACK_TRACE_INFORMATION;
+
+typedef struct _PERFINFO_STACK_CACHE {
+    ULONG Hash[PERFINFO_STACK_CACHE_SIZE];
+} PERFINFO_STACK_CACHE, *PPERFINFO_STACK_CACHE;
+
+extern PERFINFO_STACK_CACHE PerfStackCache[MAXIMUM_PROCESSORS];
+
 NTSTATUS PerfInfoReserveBytesWMI(PPERFINFO_HOOK_HANDLE Hook, USHORT HookId, ULONG BytesToReserve);
 NTSTATUS PerfInfoFileNameRunDown();
 NTSTATUS PerfInfoProcessRunDown();
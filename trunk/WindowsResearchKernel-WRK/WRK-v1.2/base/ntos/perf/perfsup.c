@@ -30,13 +30,9 @@ Routine description:
     Starts the sampled profile and initializes the cache
 */
 {
-#if !defined(NT_UP)
-    PerfInfoSampledProfileCaching = FALSE;
-#else
+    // The caches are per processor, so caching is safe on MP as well.
     PerfInfoSampledProfileCaching = TRUE;
-#endif // !defined(NT_UP)
-    PerfInfoSampledProfileFlushInProgress = 0;
-    PerfProfileCache.Entries = 0;
+    RtlZeroMemory(PerfProfileCache, sizeof(PerfProfileCache));
 
     PerfInfoProfileSourceActive = PerfInfoProfileSourceRequested;
 
@@ -138,6 +134,11 @@ Arguments:
         }
     }
 
+    // Stack hashes logged to a previous trace mean nothing in this one
+    if (PerfIsGroupOnInGroupMask(PERF_BACKTRACE, PGroupMask)) {
+        RtlZeroMemory(PerfStackCache, sizeof(PerfStackCache));
+    }
+
     // See if we need to empty the working set to start
     if (PerfIsGroupOnInGroupMask(PERF_FOOTPRINT, PGroupMask) || PerfIsGroupOnInGroupMask(PERF_BIGFOOT, PGroupMask)) {
         MmEmptyAllWorkingSets();
@@ -275,6 +275,7 @@ Arguments:
     InitializeListHead(&Thread->LpcReplyChain);
 
     InitializeListHead(&Thread->IrpList);// Initialize Io
+    IoInitializeThreadCompletionBatch(Thread);
     InitializeListHead(&Thread->PostBlockList);// Initialize Registry
     PspInitializeThreadLock(Thread);// Initialize the thread lock
 
@@ -361,7 +362,7 @@ Arguments:
             PEX_CALLBACK_ROUTINE_BLOCK CallBack;
             PCREATE_PROCESS_NOTIFY_ROUTINE Rtn;
 
-            for (i = 0; i < PSP_MAX_CREATE_PROCESS_NOTIFY; i++) {
+            for (i = 0; i < PspCreateProcessNotifyRoutineLimit; i++) {
                 CallBack = ExReferenceCallBackBlock(&PspCreateProcessNotifyRoutine[i]);
                 if (CallBack != NULL) {
                     Rtn = (PCREATE_PROCESS_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack);
@@ -393,7 +394,7 @@ Arguments:
         ULONG i;
         PEX_CALLBACK_ROUTINE_BLOCK CallBack;
         PCREATE_THREAD_NOTIFY_ROUTINE Rtn;
-        for (i = 0; i < PSP_MAX_CREATE_THREAD_NOTIFY; i++) {
+        for (i = 0; i < PspCreateThreadNotifyRoutineLimit; i++) {
             CallBack = ExReferenceCallBackBlock(&PspCreateThreadNotifyRoutine[i]);
             if (CallBack != NULL) {
                 Rtn = (PCREATE_THREAD_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack);
@@ -723,6 +724,9 @@ NTSTATUS PspCreateProcess(
     // Teardown actions that occur in the process delete routine do not need to be performed inline.
     RtlZeroMemory(Process, sizeof(EPROCESS));
     ExInitializeRundownProtection(&Process->RundownProtect);
+
+    // Cross process handle table references use per-processor rundown protection when it can be allocated and the process rundown protection otherwise.
+    Process->HandleTableRundown = ExAllocateCacheAwareRundownProtection(PagedPool, 'rHsP');
     PspInitializeProcessLock(Process);
     InitializeListHead(&Process->ThreadListHead);
 
@@ -1013,6 +1017,7 @@ NTSTATUS PspCreateProcess(
     // Add the process to the global list of processes.
     PspLockProcessList(CurrentThread);
     InsertTailList(&PsActiveProcessHead, &Process->ActiveProcessLinks);
+    PspLogProcessListChange(Process, SYSTEM_PROCESS_CHANGE_CREATED);
     PspUnlockProcessList(CurrentThread);
     AccessState = NULL;
     if (!PsUseImpersonationToken) {
@@ -1134,7 +1139,7 @@ Return Value:
     PAGED_CODE();
 
     if (Remove) {
-        for (i = 0; i < PSP_MAX_CREATE_PROCESS_NOTIFY; i++) {
+        for (i = 0; i < PspCreateProcessNotifyRoutineLimit; i++) {
             CallBack = ExReferenceCallBackBlock(&PspCreateProcessNotifyRoutine[i]);// Reference the callback so we can check its routine address.
             if (CallBack != NULL) {
                 // See if the routine matches our target
@@ -1160,6 +1165,7 @@ Return Value:
 
         for (i = 0; i < PSP_MAX_CREATE_PROCESS_NOTIFY; i++) {
             if (ExCompareExchangeCallBack(&PspCreateProcessNotifyRoutine[i], CallBack, NULL)) {// Try and swap a null entry for the new block.
+                PspRaiseNotifyRoutineLimit(&PspCreateProcessNotifyRoutineLimit, i);
                 InterlockedIncrement((PLONG)&PspCreateProcessNotifyRoutineCount);
                 return STATUS_SUCCESS;
             }
@@ -1198,6 +1204,7 @@ Return Value:
 
     for (i = 0; i < PSP_MAX_CREATE_THREAD_NOTIFY; i += 1) {
         if (ExCompareExchangeCallBack(&PspCreateThreadNotifyRoutine[i], CallBack, NULL)) {// Try and swap a null entry for the new block.
+            PspRaiseNotifyRoutineLimit(&PspCreateThreadNotifyRoutineLimit, i);
             InterlockedIncrement((PLONG)&PspCreateThreadNotifyRoutineCount);
             return STATUS_SUCCESS;
         }
@@ -1224,7 +1231,7 @@ Return Value:
 
     PAGED_CODE();
 
-    for (i = 0; i < PSP_MAX_CREATE_THREAD_NOTIFY; i += 1) {
+    for (i = 0; i < PspCreateThreadNotifyRoutineLimit; i += 1) {
         CallBack = ExReferenceCallBackBlock(&PspCreateThreadNotifyRoutine[i]);// Reference the callback so we can check its routine address.
         if (CallBack != NULL) {
             if ((PCREATE_THREAD_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack) == NotifyRoutine) {// See if the routine matches our target
@@ -1451,6 +1458,7 @@ Return Value:
 
     for (i = 0; i < PSP_MAX_LOAD_IMAGE_NOTIFY; i++) {        
         if (ExCompareExchangeCallBack(&PspLoadImageNotifyRoutine[i], CallBack, NULL)) {// Try and swap a null entry for the new block.
+            PspRaiseNotifyRoutineLimit(&PspLoadImageNotifyRoutineLimit, i);
             InterlockedIncrement((PLONG)&PspLoadImageNotifyRoutineCount);
             PsImageNotifyEnabled = TRUE;
             return STATUS_SUCCESS;
@@ -1477,7 +1485,7 @@ Return Value:
 
     PAGED_CODE();
 
-    for (i = 0; i < PSP_MAX_LOAD_IMAGE_NOTIFY; i++) {
+    for (i = 0; i < PspLoadImageNotifyRoutineLimit; i++) {
         CallBack = ExReferenceCallBackBlock(&PspLoadImageNotifyRoutine[i]);// Reference the callback so we can check its routine address.
         if (CallBack != NULL) {
             if ((PLOAD_IMAGE_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack) == NotifyRoutine) {// See if the routine matches our target
@@ -1516,7 +1524,7 @@ Arguments:
     PAGED_CODE();
 
     if (PsImageNotifyEnabled) {
-        for (i = 0; i < PSP_MAX_LOAD_IMAGE_NOTIFY; i++) {
+        for (i = 0; i < PspLoadImageNotifyRoutineLimit; i++) {
             CallBack = ExReferenceCallBackBlock(&PspLoadImageNotifyRoutine[i]);
             if (CallBack != NULL) {
                 Rtn = (PLOAD_IMAGE_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack);
@@ -45,13 +45,16 @@ Return Value:
     CurrentThread = PsGetCurrentThread();
 
     KeEnterCriticalRegionThread(&CurrentThread->Tcb);
-    CidEntry = ExMapHandleToPointer(PspCidTable, Cid->UniqueThread);
-    if (CidEntry != NULL) {
-        lThread = (PETHREAD)CidEntry->Object;
-        if (!ObReferenceObjectSafe(lThread)) {
-            lThread = NULL;
+    if (!ObReferenceObjectByUnlockedEntry(PspCidTable, Cid->UniqueThread, (PVOID *)&lThread)) {
+        lThread = NULL;
+        CidEntry = ExMapHandleToPointer(PspCidTable, Cid->UniqueThread);
+        if (CidEntry != NULL) {
+            lThread = (PETHREAD)CidEntry->Object;
+            if (!ObReferenceObjectSafe(lThread)) {
+                lThread = NULL;
+            }
+            ExUnlockHandleTableEntry(PspCidTable, CidEntry);
         }
-        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
     KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
 
@@ -99,6 +102,19 @@ Return Value:
     CurrentThread = PsGetCurrentThread();
 
     KeEnterCriticalRegionThread(&CurrentThread->Tcb);
+
+    //  Most lookups find a live process, so reference it without locking the entry and check what was found afterwards.
+    if (ObReferenceObjectByUnlockedEntry(PspCidTable, ProcessId, (PVOID *)&lProcess)) {
+        KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+        if (lProcess->Pcb.Header.Type == ProcessObject && lProcess->GrantedAccess != 0) {
+            *Process = lProcess;
+            return STATUS_SUCCESS;
+        }
+
+        ObDereferenceObject(lProcess);
+        return Status;
+    }
+
     CidEntry = ExMapHandleToPointer(PspCidTable, ProcessId);
     if (CidEntry != NULL) {
         lProcess = (PEPROCESS)CidEntry->Object;
@@ -140,6 +156,19 @@ Return Value:
     CurrentThread = PsGetCurrentThread();
 
     KeEnterCriticalRegionThread(&CurrentThread->Tcb);
+
+    //  Most lookups find a live thread, so reference it without locking the entry and check what was found afterwards.
+    if (ObReferenceObjectByUnlockedEntry(PspCidTable, ThreadId, (PVOID *)&lThread)) {
+        KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+        if (lThread->Tcb.Header.Type == ThreadObject && lThread->GrantedAccess) {
+            *Thread = lThread;
+            return STATUS_SUCCESS;
+        }
+
+        ObDereferenceObject(lThread);
+        return Status;
+    }
+
     CidEntry = ExMapHandleToPointer(PspCidTable, ThreadId);
     if (CidEntry != NULL) {
         lThread = (PETHREAD)CidEntry->Object;
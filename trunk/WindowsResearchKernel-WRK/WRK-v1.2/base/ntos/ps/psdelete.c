@@ -598,7 +598,7 @@ Arguments:
         ULONG i;
         PEX_CALLBACK_ROUTINE_BLOCK CallBack;
         PCREATE_THREAD_NOTIFY_ROUTINE Rtn;
-        for (i = 0; i < PSP_MAX_CREATE_THREAD_NOTIFY; i++) {
+        for (i = 0; i < PspCreateThreadNotifyRoutineLimit; i++) {
             CallBack = ExReferenceCallBackBlock(&PspCreateThreadNotifyRoutine[i]);
             if (CallBack != NULL) {
                 Rtn = (PCREATE_THREAD_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack);
@@ -824,6 +824,8 @@ Arguments:
 
         ObKillProcess(Process);// Rundown the handle table
 
+        IoRundownRegisteredBuffers(Process);// Unlock any buffers registered for unbuffered I/O
+
         if (Process->SectionObject != NULL) {
             ObDereferenceObject(Process->SectionObject);// Release the image section
             Process->SectionObject = NULL;
@@ -909,7 +911,7 @@ VOID PspExitProcess(IN BOOLEAN LastThreadExit, IN PEPROCESS Process)
             PEX_CALLBACK_ROUTINE_BLOCK CallBack;
             PCREATE_PROCESS_NOTIFY_ROUTINE Rtn;
 
-            for (i = 0; i < PSP_MAX_CREATE_PROCESS_NOTIFY; i++) {
+            for (i = 0; i < PspCreateProcessNotifyRoutineLimit; i++) {
                 CallBack = ExReferenceCallBackBlock(&PspCreateProcessNotifyRoutine[i]);
                 if (CallBack != NULL) {
                     Rtn = (PCREATE_PROCESS_NOTIFY_ROUTINE)ExGetCallBackBlockRoutine(CallBack);
@@ -1029,6 +1031,7 @@ VOID PspProcessDelete(IN PVOID Object)
 
         PspLockProcessList(CurrentThread);
         RemoveEntryList(&Process->ActiveProcessLinks);
+        PspLogProcessListChange(Process, SYSTEM_PROCESS_CHANGE_DELETED);
         PspUnlockProcessList(CurrentThread);
     }
 
@@ -1068,6 +1071,11 @@ VOID PspProcessDelete(IN PVOID Object)
         KeUnstackDetachProcess(&ApcState);
     }
 
+    if (Process->HandleTableRundown != NULL) {
+        ExFreeCacheAwareRundownProtection(Process->HandleTableRundown);
+        Process->HandleTableRundown = NULL;
+    }
+
     if (Process->Flags & PS_PROCESS_FLAGS_HAS_ADDRESS_SPACE) {
         // Clean address space of the process
         KeStackAttachProcess(&Process->Pcb, &ApcState);
@@ -1080,6 +1088,9 @@ VOID PspProcessDelete(IN PVOID Object)
         if (!(ExDestroyHandle(PspCidTable, Process->UniqueProcessId, NULL))) {
             KeBugCheck(CID_HANDLE_DELETION);
         }
+
+        // Client ID lookups read the table without locking it, so wait for any that may still hold the old entry.
+        ObWaitForUnlockedEntryReaders();
     }
 
     PspDeleteProcessSecurity(Process);
@@ -1127,6 +1138,9 @@ VOID PspThreadDelete(IN PVOID Object)
         if (!ExDestroyHandle(PspCidTable, Thread->Cid.UniqueThread, NULL)) {
             KeBugCheck(CID_HANDLE_DELETION);
         }
+
+        // Client ID lookups read the table without locking it, so wait for any that may still hold the old entry.
+        ObWaitForUnlockedEntryReaders();
     }
 
     PspDeleteThreadSecurity(Thread);
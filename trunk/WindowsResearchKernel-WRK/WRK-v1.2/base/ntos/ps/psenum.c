@@ -17,6 +17,9 @@ Abstract:
 #pragma alloc_text(PAGE, PsEnumProcesses)
 #pragma alloc_text(PAGE, PsGetNextProcess)
 #pragma alloc_text(PAGE, PsQuitNextProcess)
+#pragma alloc_text(PAGE, PsGetNextProcessBatched)
+#pragma alloc_text(PAGE, PsQuitNextProcessBatched)
+#pragma alloc_text(PAGE, PsQueryProcessChanges)
 #pragma alloc_text(PAGE, PsEnumProcessThreads)
 #pragma alloc_text(PAGE, PsGetNextProcessThread)
 #pragma alloc_text(PAGE, PsQuitNextProcessThread)
@@ -152,6 +155,153 @@ Arguments:
 }
 
 
+PEPROCESS PsGetNextProcessBatched(IN PPS_PROCESS_ENUM_CONTEXT Context, IN PEPROCESS Process)
+/*
+Routine Description:
+    This function is PsGetNextProcess for callers that walk the whole list, such as the system process information query.
+    Instead of taking the process list lock for every process, it references up to PS_PROCESS_ENUM_BATCH processes each time it takes the lock
+    and hands them out one by one, so a walk of a large list holds up process creation and deletion far less often.
+    Enumeration may be terminated early by calling PsQuitNextProcessBatched on the last non-NULL process returned.
+Arguments:
+    Context - Enumeration context. Count must be zero before the first call.
+    Process - Process to get the next process from or NULL for the first process
+Return Value:
+    PEPROCESS - Next process or NULL if no more processes available
+*/
+{
+    PEPROCESS NewProcess;
+    PETHREAD CurrentThread;
+    PLIST_ENTRY ListEntry;
+    ULONG Count;
+
+    PAGED_CODE();
+
+    if (Context->Count == 0 || Context->Next == Context->Count) {
+        // Process is the last one handed out and is still referenced, so it is still on the list and the walk can continue from it.
+        Count = 0;
+        CurrentThread = PsGetCurrentThread();
+
+        PspLockProcessList(CurrentThread);
+        for (ListEntry = (Process == NULL) ? PsActiveProcessHead.Flink : Process->ActiveProcessLinks.Flink;
+             ListEntry != &PsActiveProcessHead && Count < PS_PROCESS_ENUM_BATCH;
+             ListEntry = ListEntry->Flink) {
+            NewProcess = CONTAINING_RECORD(ListEntry, EPROCESS, ActiveProcessLinks);
+            if (ObReferenceObjectSafe(NewProcess)) {
+                Context->Processes[Count++] = NewProcess;
+            }
+        }
+        PspUnlockProcessList(CurrentThread);
+
+        Context->Count = Count;
+        Context->Next = 0;
+    }
+
+    if (Process != NULL) {
+        ObDereferenceObject(Process);
+    }
+
+    if (Context->Next == Context->Count) {
+        return NULL;
+    }
+
+    return Context->Processes[Context->Next++];
+}
+
+
+VOID PsQuitNextProcessBatched(IN PPS_PROCESS_ENUM_CONTEXT Context, IN PEPROCESS Process)
+/*
+Routine Description:
+    This function is used to terminate early a process enumeration using PsGetNextProcessBatched
+Arguments:
+    Context - Enumeration context.
+    Process - Last process obtained by a call to PsGetNextProcessBatched, or NULL.
+*/
+{
+    PAGED_CODE();
+
+    if (Process != NULL) {
+        ObDereferenceObject(Process);
+    }
+
+    while (Context->Next < Context->Count) {
+        ObDereferenceObject(Context->Processes[Context->Next++]);
+    }
+}
+
+
+NTSTATUS PsQueryProcessChanges(OUT PSYSTEM_PROCESS_CHANGE_INFORMATION Information, IN ULONG InformationLength, OUT PULONG ReturnLength)
+/*
+Routine Description:
+    This function returns the changes made to the active process list since the generation passed in Information.
+    The changes are copied out of the log under the process list lock and written to the caller's buffer after it is released.
+Arguments:
+    Information - Buffer holding the last generation seen by the caller on input and receiving the changes on output.
+                  The caller handles exceptions raised by accesses to this buffer.
+    InformationLength - Length of the buffer.
+    ReturnLength - Receives the length needed for the changes.
+Return Value:
+    STATUS_SUCCESS, STATUS_INFO_LENGTH_MISMATCH or STATUS_INSUFFICIENT_RESOURCES.
+*/
+{
+    PSYSTEM_PROCESS_CHANGE Changes;
+    PETHREAD CurrentThread;
+    ULONG Generation;
+    ULONG Since;
+    ULONG Pending;
+    ULONG Index;
+    ULONG Length;
+    BOOLEAN Overflow;
+
+    PAGED_CODE();
+
+    *ReturnLength = FIELD_OFFSET(SYSTEM_PROCESS_CHANGE_INFORMATION, Changes);
+    if (InformationLength < FIELD_OFFSET(SYSTEM_PROCESS_CHANGE_INFORMATION, Changes)) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Since = Information->Generation;
+
+    Changes = ExAllocatePoolWithTag(PagedPool, sizeof(PspProcessChangeLog), 'cPsP');
+    if (Changes == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    CurrentThread = PsGetCurrentThread();
+
+    PspLockProcessList(CurrentThread);
+    Generation = PspProcessListGeneration;
+    Pending = Generation - Since;
+    Overflow = FALSE;
+    if (Pending > PSP_PROCESS_CHANGE_LOG_SIZE) {
+        Overflow = TRUE;
+        Pending = 0;
+    }
+
+    for (Index = 0; Index < Pending; Index += 1) {
+        Changes[Index] = PspProcessChangeLog[(Since + 1 + Index) % PSP_PROCESS_CHANGE_LOG_SIZE];
+    }
+    PspUnlockProcessList(CurrentThread);
+
+    Length = FIELD_OFFSET(SYSTEM_PROCESS_CHANGE_INFORMATION, Changes) + Pending * sizeof(SYSTEM_PROCESS_CHANGE);
+    *ReturnLength = Length;
+    if (InformationLength < Length) {
+        ExFreePool(Changes);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    try {
+        Information->Generation = Generation;
+        Information->NumberOfChanges = Pending;
+        Information->Overflow = Overflow;
+        RtlCopyMemory(Information->Changes, Changes, Pending * sizeof(SYSTEM_PROCESS_CHANGE));
+    } finally {
+        ExFreePool(Changes);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
 PETHREAD PsGetNextProcessThread(IN PEPROCESS Process, IN PETHREAD Thread)
 /*
 Routine Description:
@@ -105,6 +105,8 @@ PVOID PsSystemDllBase;
 // List head and mutex that links all processes that have been initialized
 KGUARDED_MUTEX PspActiveProcessMutex;
 LIST_ENTRY PsActiveProcessHead;
+ULONG PspProcessListGeneration;
+SYSTEM_PROCESS_CHANGE PspProcessChangeLog[PSP_PROCESS_CHANGE_LOG_SIZE];
 PEPROCESS PsIdleProcess;
 PETHREAD PspShutdownThread;
 
@@ -648,9 +650,9 @@ VOID PsChangeQuantumTable(BOOLEAN ModifyActiveProcesses, ULONG PrioritySeparatio
             }
 
             if (Process->PriorityClass != PROCESS_PRIORITY_CLASS_IDLE) {
-                // If the process is contained within a JOB, AND we are running Fixed, Long Quantums, use the quantum associated with the Job's scheduling class
+                // If the process is contained within a JOB, AND we are running Fixed, Long Quantums or the Job has set a scheduling class limit, use the quantum associated with the Job's scheduling class
                 Job = Process->Job;
-                if (Job != NULL && PspUseJobSchedulingClasses) {
+                if (Job != NULL && PspJobSchedulingClassInEffect(Job)) {
                     QuantumReset = PspJobSchedulingClasses[Job->SchedulingClass];
                 } else {
                     QuantumReset = PspForegroundQuantum[QuantumIndex];
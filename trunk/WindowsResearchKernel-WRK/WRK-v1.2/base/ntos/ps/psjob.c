@@ -34,6 +34,7 @@ Abstract:
 #pragma alloc_text(PAGE, PspApplyJobLimitsToProcess)
 #pragma alloc_text(PAGE, PspTerminateAllProcessesInJob)
 #pragma alloc_text(PAGE, PspFoldProcessAccountingIntoJob)
+#pragma alloc_text(PAGE, PspQueryJobUserTime)
 #pragma alloc_text(PAGE, PspCaptureTokenFilter)
 #pragma alloc_text(PAGE, PsReportProcessMemoryLimitViolation)
 #pragma alloc_text(PAGE, PspJobTimeLimitsWork)
@@ -96,6 +97,10 @@ NTSTATUS NTAPI NtCreateJobObject(__out PHANDLE JobHandle, __in ACCESS_MASK Desir
         InitializeListHead(&Job->JobSetLinks);
         KeInitializeEvent(&Job->Event, NotificationEvent, FALSE);
         PspInitializeJobLimitsLock(Job);
+        Job->ChargeBlocks = ExAllocatePoolWithTag(NonPagedPoolCacheAligned, KeNumberProcessors * sizeof(PS_JOB_CHARGE_BLOCK), 'cJsP');
+        if (Job->ChargeBlocks != NULL) {
+            RtlZeroMemory(Job->ChargeBlocks, KeNumberProcessors * sizeof(PS_JOB_CHARGE_BLOCK));
+        }
 
         // Job Object gets the SessionId of the Process creating the Job
         // We will use this sessionid to restrict the processes that can be added to a job.
@@ -515,6 +520,10 @@ VOID PspJobDelete(IN PVOID Object)
         ExFreePool(Filter);
     }
 
+    if (Job->ChargeBlocks != NULL) {
+        ExFreePool(Job->ChargeBlocks);
+    }
+
     ExDeleteResourceLite(&Job->JobLock);
 }
 
@@ -1634,9 +1643,9 @@ VOID PspApplyJobLimitsToProcess(PEJOB Job, PEPROCESS Process)
 
     PspUnlockJobLimitsShared(Job, CurrentThread);
 
-    // If the process is NOT IDLE Priority Class, and long fixed quantums are in use, use the scheduling class stored in the job object for this process
+    // If the process is NOT IDLE Priority Class, and long fixed quantums are in use or the job has set a scheduling class limit, use the scheduling class stored in the job object for this process
     if (Process->PriorityClass != PROCESS_PRIORITY_CLASS_IDLE) {
-        if (PspUseJobSchedulingClasses) {
+        if (PspJobSchedulingClassInEffect(Job)) {
             KeSetQuantumProcess(&Process->Pcb, PspJobSchedulingClasses[Job->SchedulingClass]);
         }
 
@@ -1681,6 +1690,7 @@ VOID PsEnforceExecutionTimeLimits(VOID)
     PETHREAD CurrentThread;
     NTSTATUS Status;
     BOOLEAN KilledSome;
+    ULONG TotalUser;
 
     PAGED_CODE();
 
@@ -1689,105 +1699,150 @@ VOID PsEnforceExecutionTimeLimits(VOID)
     // Look at each job. If time limits are set for the job, then enforce them
     for (Job = PsGetNextJob(NULL); Job != NULL; Job = PsGetNextJob(Job)) {
         if (Job->LimitFlags & (JOB_OBJECT_LIMIT_PROCESS_TIME | JOB_OBJECT_LIMIT_JOB_TIME)) {
+            // Gather an approximate job runtime without the job lock.
+            // The lock is only taken for processes and jobs that look like they are over their limits, and the job total is recomputed exactly then.
+            RunningJobTime.QuadPart = Job->ThisPeriodTotalUserTime.QuadPart;
             for (Process = PsGetNextJobProcess(Job, NULL); Process != NULL; Process = PsGetNextJobProcess(Job, Process)) {
-                // Job looks like a candidate for time enforcing.
+                KeQueryRuntimeProcess(&Process->Pcb, &TotalUser);
+                ProcessTime.QuadPart = UInt32x32To64(TotalUser, KeMaximumIncrement);
+                if (!(Process->JobStatus & PS_JOB_STATUS_ACCOUNTING_FOLDED)) {
+                    RunningJobTime.QuadPart += ProcessTime.QuadPart;
+                }
+
+                if ((Job->LimitFlags & JOB_OBJECT_LIMIT_PROCESS_TIME) == 0 ||
+                    ProcessTime.QuadPart <= Job->PerProcessUserTimeLimit.QuadPart ||
+                    (Process->JobStatus & PS_JOB_STATUS_NOT_REALLY_ACTIVE)) {
+                    continue;
+                }
+
+                // Process looks like a candidate for time enforcing.
                 // Need to get the job lock to be sure, but we don't want to hang waiting for the job lock, so skip the job until next time around if we need to
                 KeEnterCriticalRegionThread(&CurrentThread->Tcb);
                 if (ExAcquireResourceExclusiveLite(&Job->JobLock, FALSE)) {
-                    // Job is setup for time limits
-                    RunningJobTime.QuadPart = Job->ThisPeriodTotalUserTime.QuadPart;
-                    if (Job->LimitFlags & (JOB_OBJECT_LIMIT_PROCESS_TIME | JOB_OBJECT_LIMIT_JOB_TIME)) {
-                        ULONG TotalUser;
-
-                        KeQueryRuntimeProcess(&Process->Pcb, &TotalUser);
-                        ProcessTime.QuadPart = UInt32x32To64(TotalUser, KeMaximumIncrement);
-
-                        if (!(Process->JobStatus & PS_JOB_STATUS_ACCOUNTING_FOLDED)) {
-                            RunningJobTime.QuadPart += ProcessTime.QuadPart;
-                        }
+                    if (Job->LimitFlags & JOB_OBJECT_LIMIT_PROCESS_TIME) {
+                        if (ProcessTime.QuadPart > Job->PerProcessUserTimeLimit.QuadPart) {
+                            // Process Time Limit has been exceeded.
+
+                            // Reference the process. Assert that it is not in its delete routine.
+                            // If all is OK, then delete and dereference the process
+                            if (!(Process->JobStatus & PS_JOB_STATUS_NOT_REALLY_ACTIVE)) {
+                                PS_SET_CLEAR_BITS(&Process->JobStatus, PS_JOB_STATUS_NOT_REALLY_ACTIVE, PS_JOB_STATUS_LAST_REPORT_MEMORY);
+                                ExReleaseResourceLite(&Job->JobLock);
+                                KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
 
-                        if (Job->LimitFlags & JOB_OBJECT_LIMIT_PROCESS_TIME) {
-                            if (ProcessTime.QuadPart > Job->PerProcessUserTimeLimit.QuadPart) {
-                                // Process Time Limit has been exceeded.
-
-                                // Reference the process. Assert that it is not in its delete routine.
-                                // If all is OK, then delete and dereference the process
-                                if (!(Process->JobStatus & PS_JOB_STATUS_NOT_REALLY_ACTIVE)) {
-                                    PS_SET_CLEAR_BITS(&Process->JobStatus, PS_JOB_STATUS_NOT_REALLY_ACTIVE, PS_JOB_STATUS_LAST_REPORT_MEMORY);
-                                    ExReleaseResourceLite(&Job->JobLock);
-                                    KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
-
-                                    Status = PspTerminateProcess(Process, ERROR_NOT_ENOUGH_QUOTA);
-                                    KeEnterCriticalRegionThread(&CurrentThread->Tcb);
-                                    ExAcquireResourceExclusiveLite(&Job->JobLock, TRUE);
-                                    if (NT_SUCCESS(Status)) {
-                                        Job->TotalTerminatedProcesses++;
-                                        Job->ActiveProcesses--;
-                                        if (Job->CompletionPort != NULL) {
-                                            IoSetIoCompletion(
-                                                Job->CompletionPort,
-                                                Job->CompletionKey,
-                                                (PVOID)Process->UniqueProcessId,
-                                                STATUS_SUCCESS,
-                                                JOB_OBJECT_MSG_END_OF_PROCESS_TIME,
-                                                FALSE);
-                                        }
-
-                                        PspFoldProcessAccountingIntoJob(Job, Process);
+                                Status = PspTerminateProcess(Process, ERROR_NOT_ENOUGH_QUOTA);
+                                KeEnterCriticalRegionThread(&CurrentThread->Tcb);
+                                ExAcquireResourceExclusiveLite(&Job->JobLock, TRUE);
+                                if (NT_SUCCESS(Status)) {
+                                    Job->TotalTerminatedProcesses++;
+                                    Job->ActiveProcesses--;
+                                    if (Job->CompletionPort != NULL) {
+                                        IoSetIoCompletion(
+                                            Job->CompletionPort,
+                                            Job->CompletionKey,
+                                            (PVOID)Process->UniqueProcessId,
+                                            STATUS_SUCCESS,
+                                            JOB_OBJECT_MSG_END_OF_PROCESS_TIME,
+                                            FALSE);
                                     }
+
+                                    PspFoldProcessAccountingIntoJob(Job, Process);
                                 }
                             }
                         }
                     }
 
-                    if (Job->LimitFlags & JOB_OBJECT_LIMIT_JOB_TIME) {
-                        if (RunningJobTime.QuadPart > Job->PerJobUserTimeLimit.QuadPart) {
-                            // Job Time Limit has been exceeded.
+                    ExReleaseResourceLite(&Job->JobLock);
+                }
 
-                            // Perform the appropriate action
-                            switch (Job->EndOfJobTimeAction) {
-                            case JOB_OBJECT_TERMINATE_AT_END_OF_JOB:
-                                ExReleaseResourceLite(&Job->JobLock);
-                                KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+                KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+            }
 
-                                KilledSome = PspTerminateAllProcessesInJob(Job, ERROR_NOT_ENOUGH_QUOTA, TRUE);
-                                if (!KilledSome) {
-                                    continue;
-                                }
+            if ((Job->LimitFlags & JOB_OBJECT_LIMIT_JOB_TIME) == 0 || RunningJobTime.QuadPart <= Job->PerJobUserTimeLimit.QuadPart) {
+                continue;
+            }
 
-                                KeEnterCriticalRegionThread(&CurrentThread->Tcb);
-                                ExAcquireResourceExclusiveLite(&Job->JobLock, TRUE);
-                                if (Job->ActiveProcesses == 0 && Job->CompletionPort) {
-                                    IoSetIoCompletion(Job->CompletionPort, Job->CompletionKey, NULL, STATUS_SUCCESS, JOB_OBJECT_MSG_END_OF_JOB_TIME, FALSE);
-                                }
-                                break;
-                            case JOB_OBJECT_POST_AT_END_OF_JOB:
-                                if (Job->CompletionPort) {
-                                    Status = IoSetIoCompletion(Job->CompletionPort, Job->CompletionKey, NULL, STATUS_SUCCESS, JOB_OBJECT_MSG_END_OF_JOB_TIME, FALSE);
-                                    if (NT_SUCCESS(Status)) {
-                                        // Clear job level time limit
-                                        Job->LimitFlags &= ~JOB_OBJECT_LIMIT_JOB_TIME;
-                                        Job->PerJobUserTimeLimit.QuadPart = 0;
-                                    }
-                                } else {
-                                    ExReleaseResourceLite(&Job->JobLock);
-                                    KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
-                                    PspTerminateAllProcessesInJob(Job, ERROR_NOT_ENOUGH_QUOTA, TRUE);
-                                    continue;
-                                }
+            KeEnterCriticalRegionThread(&CurrentThread->Tcb);
+            if (ExAcquireResourceExclusiveLite(&Job->JobLock, FALSE)) {
+                if (Job->LimitFlags & JOB_OBJECT_LIMIT_JOB_TIME) {
+                    RunningJobTime.QuadPart = PspQueryJobUserTime(Job);
+                    if (RunningJobTime.QuadPart > Job->PerJobUserTimeLimit.QuadPart) {
+                        // Job Time Limit has been exceeded.
+
+                        // Perform the appropriate action
+                        switch (Job->EndOfJobTimeAction) {
+                        case JOB_OBJECT_TERMINATE_AT_END_OF_JOB:
+                            ExReleaseResourceLite(&Job->JobLock);
+                            KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+
+                            KilledSome = PspTerminateAllProcessesInJob(Job, ERROR_NOT_ENOUGH_QUOTA, TRUE);
+                            if (!KilledSome) {
+                                continue;
+                            }
 
-                                break;
+                            KeEnterCriticalRegionThread(&CurrentThread->Tcb);
+                            ExAcquireResourceExclusiveLite(&Job->JobLock, TRUE);
+                            if (Job->ActiveProcesses == 0 && Job->CompletionPort) {
+                                IoSetIoCompletion(Job->CompletionPort, Job->CompletionKey, NULL, STATUS_SUCCESS, JOB_OBJECT_MSG_END_OF_JOB_TIME, FALSE);
                             }
+                            break;
+                        case JOB_OBJECT_POST_AT_END_OF_JOB:
+                            if (Job->CompletionPort) {
+                                Status = IoSetIoCompletion(Job->CompletionPort, Job->CompletionKey, NULL, STATUS_SUCCESS, JOB_OBJECT_MSG_END_OF_JOB_TIME, FALSE);
+                                if (NT_SUCCESS(Status)) {
+                                    // Clear job level time limit
+                                    Job->LimitFlags &= ~JOB_OBJECT_LIMIT_JOB_TIME;
+                                    Job->PerJobUserTimeLimit.QuadPart = 0;
+                                }
+                            } else {
+                                ExReleaseResourceLite(&Job->JobLock);
+                                KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+                                PspTerminateAllProcessesInJob(Job, ERROR_NOT_ENOUGH_QUOTA, TRUE);
+                                continue;
+                            }
+
+                            break;
                         }
                     }
-
-                    ExReleaseResourceLite(&Job->JobLock);
                 }
 
-                KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+                ExReleaseResourceLite(&Job->JobLock);
             }
+
+            KeLeaveCriticalRegionThread(&CurrentThread->Tcb);
+        }
+    }
+}
+
+
+ULONGLONG PspQueryJobUserTime(PEJOB Job)
+/*
+Routine Description:
+    This function computes the user time charged to a job in the current period.
+    This is the time folded into the job plus the runtime of every process whose accounting has not been folded yet.
+Arguments:
+    Job - Supplies the job to query. The job lock must be held by the caller.
+Return Value:
+    ULONGLONG - User time of the job in the current period.
+*/
+{
+    PLIST_ENTRY Next;
+    PEPROCESS Process;
+    ULONGLONG UserTime;
+    ULONG TotalUser;
+
+    PAGED_CODE();
+
+    UserTime = Job->ThisPeriodTotalUserTime.QuadPart;
+    for (Next = Job->ProcessListHead.Flink; Next != &Job->ProcessListHead; Next = Next->Flink) {
+        Process = (PEPROCESS)(CONTAINING_RECORD(Next, EPROCESS, JobLinks));
+        if (!(Process->JobStatus & PS_JOB_STATUS_ACCOUNTING_FOLDED)) {
+            KeQueryRuntimeProcess(&Process->Pcb, &TotalUser);
+            UserTime += UInt32x32To64(TotalUser, KeMaximumIncrement);
         }
     }
+
+    return UserTime;
 }
 
 
@@ -1851,9 +1906,7 @@ VOID PspFoldProcessAccountingIntoJob(PEJOB Job, PEPROCESS Process)
         Job->OtherTransferCount += Values.OtherTransferCount;
         Job->TotalPageFaultCount += Process->Vm.PageFaultCount;
 
-        if (Process->CommitChargePeak > Job->PeakProcessMemoryUsed) {
-            Job->PeakProcessMemoryUsed = Process->CommitChargePeak;
-        }
+        PspUpdateJobPeakCharge(&Job->PeakProcessMemoryUsed, Process->CommitChargePeak);
 
         PS_SET_CLEAR_BITS(&Process->JobStatus, PS_JOB_STATUS_ACCOUNTING_FOLDED, PS_JOB_STATUS_LAST_REPORT_MEMORY);
         if (Job->CompletionPort && Job->ActiveProcesses == 0) {
@@ -1948,7 +2001,10 @@ BOOLEAN PsChangeJobMemoryUsage(IN ULONG Flags, IN SSIZE_T Amount)
     PEPROCESS Process;
     PETHREAD CurrentThread;
     PEJOB Job;
+    PPS_JOB_CHARGE_BLOCK ChargeBlock;
+    SSIZE_T Delta;
     SIZE_T CurrentJobMemoryUsed;
+    ULONG i;
     BOOLEAN ReturnValue;
 
     if ((Flags & PS_JOB_STATUS_REPORT_COMMIT_CHANGES) == 0) {
@@ -1961,14 +2017,43 @@ BOOLEAN PsChangeJobMemoryUsage(IN ULONG Flags, IN SSIZE_T Amount)
     Process = PsGetCurrentProcessByThread(CurrentThread);
     Job = Process->Job;
     if (Job) {
+        // Small charges go to this processor's charge block without any lock as long as the job is well clear of its limit.
+        // The block is folded into the job total once it drifts a batch away from zero, so the total is never off
+        // by more than a couple of batches per processor.
+        if (Job->ChargeBlocks != NULL && Amount <= PSP_JOB_CHARGE_BATCH && Amount >= -PSP_JOB_CHARGE_BATCH) {
+            if (Amount <= 0 ||
+                (Job->LimitFlags & JOB_OBJECT_LIMIT_JOB_MEMORY) == 0 ||
+                Job->CurrentJobMemoryUsed + Amount + 2 * PSP_JOB_CHARGE_BATCH * (SIZE_T)KeNumberProcessors <= Job->JobMemoryLimit) {
+                ChargeBlock = &Job->ChargeBlocks[KeGetCurrentProcessorNumber()];
+                Delta = InterlockedExchangeAddSizeT(&ChargeBlock->CommitCharge, Amount) + Amount;
+                if (Delta > PSP_JOB_CHARGE_BATCH || Delta < -PSP_JOB_CHARGE_BATCH) {
+                    PspFoldJobChargeBlock(Job, ChargeBlock);
+                }
+
+                if (Amount > 0) {
+                    PspUpdateJobPeakCharge(&Job->PeakProcessMemoryUsed, Process->CommitCharge + Amount);
+                }
+
+                return TRUE;
+            }
+        }
+
         // This routine can be called while holding the process lock (during teb deletion... So instead of using the job lock, we must use the memory limits lock.
         // The lock order is always (job lock followed by process lock.
         // The memory limits lock never nests or calls other code while held.
         // It can be grapped while holding the job lock, or the process lock.
         PspLockJobLimitsShared(Job, CurrentThread);
-        CurrentJobMemoryUsed = Job->CurrentJobMemoryUsed + Amount;
+
+        // Reconcile the per-processor charges so the limit is checked against the exact total.
+        CurrentJobMemoryUsed = Job->CurrentJobMemoryUsed;
+        if (Job->ChargeBlocks != NULL) {
+            for (i = 0; i < (ULONG)KeNumberProcessors; i += 1) {
+                CurrentJobMemoryUsed = PspFoldJobChargeBlock(Job, &Job->ChargeBlocks[i]);
+            }
+        }
+
+        CurrentJobMemoryUsed += Amount;
         if (Job->LimitFlags & JOB_OBJECT_LIMIT_JOB_MEMORY && CurrentJobMemoryUsed > Job->JobMemoryLimit) {
-            CurrentJobMemoryUsed = Job->CurrentJobMemoryUsed;
             ReturnValue = FALSE;
 
             // Tell the job port that commit has been exceeded, and process id x was the one that hit it.
@@ -1979,17 +2064,12 @@ BOOLEAN PsChangeJobMemoryUsage(IN ULONG Flags, IN SSIZE_T Amount)
         }
 
         if (ReturnValue) {
-            Job->CurrentJobMemoryUsed = CurrentJobMemoryUsed;
+            CurrentJobMemoryUsed = InterlockedExchangeAddSizeT(&Job->CurrentJobMemoryUsed, Amount) + Amount;
 
             // Update current and peak counters if this is an addition.
             if (Amount > 0) {
-                if (CurrentJobMemoryUsed > Job->PeakJobMemoryUsed) {
-                    Job->PeakJobMemoryUsed = CurrentJobMemoryUsed;
-                }
-
-                if (Process->CommitCharge + Amount > Job->PeakProcessMemoryUsed) {
-                    Job->PeakProcessMemoryUsed = Process->CommitCharge + Amount;
-                }
+                PspUpdateJobPeakCharge(&Job->PeakJobMemoryUsed, CurrentJobMemoryUsed);
+                PspUpdateJobPeakCharge(&Job->PeakProcessMemoryUsed, Process->CommitCharge + Amount);
             }
         }
 
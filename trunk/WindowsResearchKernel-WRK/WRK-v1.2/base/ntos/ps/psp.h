@@ -180,6 +180,25 @@ EX_CALLBACK PspCreateThreadNotifyRoutine[PSP_MAX_CREATE_THREAD_NOTIFY];
 ULONG PspLoadImageNotifyRoutineCount;
 EX_CALLBACK PspLoadImageNotifyRoutine[PSP_MAX_LOAD_IMAGE_NOTIFY];
 
+// One more than the highest slot ever filled in each callout array. Registration takes the lowest free slot,
+// so everything at or above the limit is empty and the notify loops stop there instead of probing the whole array.
+ULONG PspCreateProcessNotifyRoutineLimit;
+ULONG PspCreateThreadNotifyRoutineLimit;
+ULONG PspLoadImageNotifyRoutineLimit;
+
+FORCEINLINE VOID PspRaiseNotifyRoutineLimit(IN OUT PULONG Limit, IN ULONG Slot)
+// Raises the callout limit to cover a newly filled slot. The limit never drops.
+{
+    ULONG OldLimit;
+
+    do {
+        OldLimit = *(volatile ULONG *)Limit;
+        if (OldLimit > Slot) {
+            return;
+        }
+    } while ((ULONG)InterlockedCompareExchange((PLONG)Limit, Slot + 1, OldLimit) != OldLimit);
+}
+
 NTSTATUS PspCreateThread(
     OUT PHANDLE ThreadHandle,
     IN ACCESS_MASK DesiredAccess,
@@ -261,6 +280,7 @@ VOID PspApplyJobLimitsToProcessSet(PEJOB Job);
 VOID PspApplyJobLimitsToProcess(PEJOB Job, PEPROCESS Process);
 BOOLEAN PspTerminateAllProcessesInJob(PEJOB Job, NTSTATUS Status, BOOLEAN IncCounter);
 VOID PspFoldProcessAccountingIntoJob(PEJOB Job, PEPROCESS Process);
+ULONGLONG PspQueryJobUserTime(PEJOB Job);
 NTSTATUS PspCaptureTokenFilter(KPROCESSOR_MODE PreviousMode, PJOBOBJECT_SECURITY_LIMIT_INFORMATION SecurityLimitInfo, PPS_JOB_TOKEN_FILTER * TokenFilter);
 KPRIORITY PspComputeQuantumAndPriority(__inout PEPROCESS Process, __in PSPROCESSPRIORITYMODE PriorityMode, __out PSCHAR QuantumReset);
 VOID PspShutdownJobLimits(VOID);
@@ -375,6 +395,24 @@ VOID FORCEINLINE PspUnlockProcessList (IN PETHREAD CurrentThread)
     KeLeaveGuardedRegionThread (&CurrentThread->Tcb);
 }
 
+// Log of the most recent changes to the active process list, see SystemProcessChangeInformation. Protected by the process list lock.
+#define PSP_PROCESS_CHANGE_LOG_SIZE 1024
+
+extern ULONG PspProcessListGeneration;
+extern SYSTEM_PROCESS_CHANGE PspProcessChangeLog[PSP_PROCESS_CHANGE_LOG_SIZE];
+
+VOID FORCEINLINE PspLogProcessListChange (IN PEPROCESS Process, IN ULONG ChangeType)
+{
+    PSYSTEM_PROCESS_CHANGE Change;
+
+    PspProcessListGeneration += 1;
+    Change = &PspProcessChangeLog[PspProcessListGeneration % PSP_PROCESS_CHANGE_LOG_SIZE];
+    Change->Generation = PspProcessListGeneration;
+    Change->ChangeType = ChangeType;
+    Change->UniqueProcessId = Process->UniqueProcessId;
+    Change->InheritedFromUniqueProcessId = Process->InheritedFromUniqueProcessId;
+}
+
 
 // Routines to lock and unlock the job list mutex
 extern KGUARDED_MUTEX PspJobListLock;
@@ -465,6 +503,45 @@ VOID FORCEINLINE PspUnlockJobLimitsSharedUnsafe (IN PEJOB Job)
     KeReleaseGuardedMutexUnsafe (&Job->MemoryLimitsLock);
 }
 
+// Pages of commit a processor may charge to a job before folding them into the job total.
+// A job's total may hide up to twice this many pages per processor,
+// so charges that would bring the job within that distance of its limit are checked exactly under the memory limits lock.
+#define PSP_JOB_CHARGE_BATCH 64
+
+VOID FORCEINLINE PspUpdateJobPeakCharge (IN PSIZE_T Peak, IN SIZE_T Value)
+{
+    SIZE_T OldPeak, NewPeak;
+
+    OldPeak = *(volatile SIZE_T *)Peak;
+    while (Value > OldPeak) {
+        NewPeak = (SIZE_T)InterlockedCompareExchangePointer((PVOID *)Peak, (PVOID)Value, (PVOID)OldPeak);
+        if (NewPeak == OldPeak) {
+            break;
+        }
+        OldPeak = NewPeak;
+    }
+}
+
+SIZE_T FORCEINLINE PspFoldJobChargeBlock (IN PEJOB Job, IN PPS_JOB_CHARGE_BLOCK ChargeBlock)
+{
+    SSIZE_T Delta;
+    SIZE_T CurrentJobMemoryUsed;
+
+    // Charges made to the block while we fold it stay behind for the next fold.
+    Delta = *(volatile SSIZE_T *)&ChargeBlock->CommitCharge;
+    if (Delta == 0) {
+        return *(volatile SIZE_T *)&Job->CurrentJobMemoryUsed;
+    }
+
+    InterlockedExchangeAddSizeT(&ChargeBlock->CommitCharge, -Delta);
+    CurrentJobMemoryUsed = InterlockedExchangeAddSizeT(&Job->CurrentJobMemoryUsed, Delta) + Delta;
+    if (Delta > 0) {
+        PspUpdateJobPeakCharge(&Job->PeakJobMemoryUsed, CurrentJobMemoryUsed);
+    }
+
+    return CurrentJobMemoryUsed;
+}
+
 extern KGUARDED_MUTEX PspJobTimeLimitsLock;// Routines to lock job time limits structures
 
 VOID FORCEINLINE PspInitializeJobTimeLimitsLock (VOID)
@@ -555,6 +632,10 @@ extern SCHAR PspForegroundQuantum[3];
 extern const SCHAR PspJobSchedulingClasses[PSP_NUMBER_OF_SCHEDULING_CLASSES];
 extern BOOLEAN PspUseJobSchedulingClasses;
 
+// The quantum of a process in a job is taken from the job scheduling class when long fixed quantums are in use system wide, or when the job itself has set a scheduling class limit.
+// The latter lets a single job select throughput or latency oriented quanta without changing the global quantum configuration.
+#define PspJobSchedulingClassInEffect(Job) (PspUseJobSchedulingClasses || (((Job)->LimitFlags & JOB_OBJECT_LIMIT_SCHEDULING_CLASS) != 0))
+
 extern LIST_ENTRY PspJobList;
 extern KDPC PspJobLimeLimitsDpc;
 extern KTIMER PspJobTimeLimitsTimer;
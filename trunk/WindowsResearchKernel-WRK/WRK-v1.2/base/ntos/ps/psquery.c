@@ -2117,6 +2117,42 @@ NTSTATUS NtSetInformationProcess(
 
         st = MmSetExecuteOptions(ExecuteOptions);
         return st;
+    case ProcessPreferredNode:
+    {
+        ULONG NodeNumber;
+
+        if (ProcessInformationLength != sizeof(ULONG)) {
+            return STATUS_INFO_LENGTH_MISMATCH;
+        }
+
+        try {
+            NodeNumber = *(PULONG)ProcessInformation;
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            return GetExceptionCode();
+        }
+
+        st = ObReferenceObjectByHandle(ProcessHandle, PROCESS_SET_INFORMATION, PsProcessType, PreviousMode, &Process, NULL);
+        if (!NT_SUCCESS(st)) {
+            return st;
+        }
+
+        // Acquire rundown protection to give back the correct error if the process has or is being terminated.
+        if (!ExAcquireRundownProtection(&Process->RundownProtect)) {
+            st = STATUS_PROCESS_IS_TERMINATING;
+        } else {
+            PspLockProcessExclusive(Process, CurrentThread);
+            if (KeSetIdealNodeProcess(&Process->Pcb, NodeNumber) == FALSE) {
+                st = STATUS_INVALID_PARAMETER;
+            }
+
+            PspUnlockProcessExclusive(Process, CurrentThread);
+            ExReleaseRundownProtection(&Process->RundownProtect);
+        }
+
+        ObDereferenceObject(Process);
+        return st;
+    }
     default:
         return STATUS_INVALID_INFO_CLASS;
     }
@@ -2153,6 +2189,7 @@ NTSTATUS NtQueryInformationThread(__in HANDLE ThreadHandle,
     ULONG BreakOnTerminationEnabled;
     PETHREAD CurrentThread;
     ULONG ThreadTerminated;
+    ULONG IoPriority;
 
     // Get previous processor mode and probe output argument if necessary.
 
@@ -2433,6 +2470,31 @@ NTSTATUS NtQueryInformationThread(__in HANDLE ThreadHandle,
             return GetExceptionCode();
         }
 
+        return STATUS_SUCCESS;
+    case ThreadIoPriority:
+        if (ThreadInformationLength != sizeof(ULONG)) {
+            return STATUS_INFO_LENGTH_MISMATCH;
+        }
+
+        st = ObReferenceObjectByHandle(ThreadHandle, THREAD_QUERY_INFORMATION, PsThreadType, PreviousMode, &Thread, NULL);
+        if (!NT_SUCCESS(st)) {
+            return st;
+        }
+
+        // The thread stores the priority plus one, with zero meaning normal priority.
+        IoPriority = (Thread->IoPriority != 0) ? (ULONG)Thread->IoPriority - 1 : IoPriorityNormal;
+        ObDereferenceObject(Thread);
+
+        try {
+            *(PULONG)ThreadInformation = IoPriority;
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = sizeof(ULONG);
+            }
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            return GetExceptionCode();
+        }
+
         return STATUS_SUCCESS;
     default:
         return STATUS_INVALID_INFO_CLASS;
@@ -2471,6 +2533,7 @@ NTSTATUS NtSetInformationThread(
     ULONG EnableBreakOnTermination;
     ULONG IdealProcessor;
     ULONG DisableBoost;
+    ULONG IoPriority;
     PVOID *ExpansionSlots;
     HANDLE ImpersonationTokenHandle;
     BOOLEAN HasPrivilege;
@@ -2938,6 +3001,35 @@ NTSTATUS NtSetInformationThread(
 #else
         return STATUS_NOT_IMPLEMENTED;
 #endif
+    case ThreadIoPriority:
+        if (ThreadInformationLength != sizeof(ULONG)) {
+            return STATUS_INFO_LENGTH_MISMATCH;
+        }
+
+        try {
+            IoPriority = *(PULONG)ThreadInformation;
+        } except(EXCEPTION_EXECUTE_HANDLER)
+        {
+            return GetExceptionCode();
+        }
+
+        if (IoPriority >= MaxIoPriorityTypes) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        // Raising the I/O priority above normal takes the same privilege as raising the base priority.
+        if (IoPriority > IoPriorityNormal && !SeSinglePrivilegeCheck(SeIncreaseBasePriorityPrivilege, PreviousMode)) {
+            return STATUS_PRIVILEGE_NOT_HELD;
+        }
+
+        st = ObReferenceObjectByHandle(ThreadHandle, THREAD_SET_INFORMATION, PsThreadType, PreviousMode, &Thread, NULL);
+        if (!NT_SUCCESS(st)) {
+            return st;
+        }
+
+        Thread->IoPriority = (UCHAR)(IoPriority + 1);
+        ObDereferenceObject(Thread);
+        return STATUS_SUCCESS;
     default:
         return STATUS_INVALID_INFO_CLASS;
     }
@@ -3088,7 +3180,7 @@ Return Value:
     // Compute quantum reset value.
     if (Process->PriorityClass != PROCESS_PRIORITY_CLASS_IDLE) {
         Job = Process->Job;
-        if ((Job != NULL) && (PspUseJobSchedulingClasses != FALSE)) {
+        if ((Job != NULL) && PspJobSchedulingClassInEffect(Job)) {
             Quantum = PspJobSchedulingClasses[Job->SchedulingClass];
         } else {
             Quantum = PspForegroundQuantum[QuantumIndex];
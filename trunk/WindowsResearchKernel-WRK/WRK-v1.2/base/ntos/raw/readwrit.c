@@ -44,12 +44,23 @@ Return Value:
     //  This is a very simple operation.
     //  Simply forward the request to the device driver since exact blocks are being read and return whatever status was given.
 
-    //  Get the next stack location, and copy over the stack location
-    NextIrpSp = IoGetNextIrpStackLocation( Irp );
-    *NextIrpSp = *IrpSp;
+    //  Only synchronous reads and writes need the completion routine, which updates the current byte offset of the file object.
+    //  Everything else is passed down in our own stack location without a completion routine, so asynchronous requests complete
+    //  straight back to the I/O manager and any number of them can be outstanding on the volume at once.
+    if (((IrpSp->MajorFunction == IRP_MJ_READ) || (IrpSp->MajorFunction == IRP_MJ_WRITE)) &&
+        (IrpSp->FileObject != NULL) && FlagOn(IrpSp->FileObject->Flags, FO_SYNCHRONOUS_IO))
+    {
+        //  Get the next stack location, and copy over the stack location
+        NextIrpSp = IoGetNextIrpStackLocation( Irp );
+        *NextIrpSp = *IrpSp;
+
+        NextIrpSp->Flags |= SL_OVERRIDE_VERIFY_VOLUME; //  Prohibit verifies all together.
+        IoSetCompletionRoutine( Irp, RawCompletionRoutine, NULL, TRUE, TRUE, TRUE );//  Set up the completion routine
+    } else {
+        IrpSp->Flags |= SL_OVERRIDE_VERIFY_VOLUME; //  Prohibit verifies all together.
+        IoSkipCurrentIrpStackLocation( Irp );
+    }
 
-    NextIrpSp->Flags |= SL_OVERRIDE_VERIFY_VOLUME; //  Prohibit verifies all together.
-    IoSetCompletionRoutine( Irp, RawCompletionRoutine, NULL, TRUE, TRUE, TRUE );//  Set up the completion routine
     Status = IoCallDriver(Vcb->TargetDeviceObject, Irp);//  Send the request.
     return Status;
 }
\ No newline at end of file
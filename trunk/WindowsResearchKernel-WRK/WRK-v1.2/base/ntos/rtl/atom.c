@@ -21,6 +21,8 @@ void RtlpFreeAtom(IN PVOID p);
 void RtlpInitializeLockAtomTable(IN OUT PRTL_ATOM_TABLE AtomTable);
 BOOLEAN RtlpLockAtomTable(IN PRTL_ATOM_TABLE AtomTable);
 void RtlpUnlockAtomTable(IN PRTL_ATOM_TABLE AtomTable);
+BOOLEAN RtlpLockAtomTableShared(IN PRTL_ATOM_TABLE AtomTable);
+void RtlpUnlockAtomTableShared(IN PRTL_ATOM_TABLE AtomTable);
 void RtlpDestroyLockAtomTable(IN OUT PRTL_ATOM_TABLE AtomTable);
 BOOLEAN RtlpInitializeHandleTableForAtomTable(PRTL_ATOM_TABLE AtomTable);
 void RtlpDestroyHandleTableForAtomTable(PRTL_ATOM_TABLE AtomTable);
@@ -39,6 +41,8 @@ PRTL_ATOM_TABLE_ENTRY RtlpHashStringToAtom(IN PRTL_ATOM_TABLE p,
 #pragma alloc_text(PAGE,RtlInitializeAtomPackage)
 #pragma alloc_text(PAGE,RtlpLockAtomTable)
 #pragma alloc_text(PAGE,RtlpUnlockAtomTable)
+#pragma alloc_text(PAGE,RtlpLockAtomTableShared)
+#pragma alloc_text(PAGE,RtlpUnlockAtomTableShared)
 #pragma alloc_text(PAGE,RtlpDestroyLockAtomTable)
 #pragma alloc_text(PAGE,RtlpInitializeHandleTableForAtomTable)
 #pragma alloc_text(PAGE,RtlpDestroyHandleTableForAtomTable)
@@ -135,6 +139,26 @@ void RtlpUnlockAtomTable(IN PRTL_ATOM_TABLE AtomTable)
 }
 
 
+// Lookups and queries neither change the hash chains nor the atom entries, so they only need the table lock shared.
+BOOLEAN RtlpLockAtomTableShared(IN PRTL_ATOM_TABLE AtomTable)
+{
+    if (AtomTable == NULL || AtomTable->Signature != RTL_ATOM_TABLE_SIGNATURE) {
+        return FALSE;
+    }
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockShared(&AtomTable->PushLock);
+    return TRUE;
+}
+
+
+void RtlpUnlockAtomTableShared(IN PRTL_ATOM_TABLE AtomTable)
+{
+    ExReleasePushLockShared(&AtomTable->PushLock);
+    KeLeaveCriticalRegion();
+}
+
+
 void RtlpDestroyLockAtomTable(IN OUT PRTL_ATOM_TABLE AtomTable)
 {
 
@@ -555,7 +579,7 @@ NTSTATUS RtlLookupAtomInAtomTable(__in PVOID AtomTableHandle, __in PWSTR AtomNam
 
     RTL_PAGED_CODE();
 
-    if (!RtlpLockAtomTable(p)) {
+    if (!RtlpLockAtomTableShared(p)) {
         return STATUS_INVALID_PARAMETER;
     }
 
@@ -594,7 +618,7 @@ NTSTATUS RtlLookupAtomInAtomTable(__in PVOID AtomTableHandle, __in PWSTR AtomNam
         Status = GetExceptionCode();
     }
 
-    RtlpUnlockAtomTable(p);
+    RtlpUnlockAtomTableShared(p);
 
     return Status;
 }
@@ -698,7 +722,7 @@ NTSTATUS RtlQueryAtomInAtomTable(__in PVOID AtomTableHandle,
 
     RTL_PAGED_CODE();
 
-    if (!RtlpLockAtomTable(p)) {
+    if (!RtlpLockAtomTableShared(p)) {
         return STATUS_INVALID_PARAMETER;
     }
 
@@ -776,7 +800,7 @@ NTSTATUS RtlQueryAtomInAtomTable(__in PVOID AtomTableHandle,
         Status = GetExceptionCode();
     }
 
-    RtlpUnlockAtomTable(p);
+    RtlpUnlockAtomTableShared(p);
 
     return Status;
 }
@@ -795,7 +819,7 @@ NTSTATUS RtlQueryAtomsInAtomTable(IN PVOID AtomTableHandle,
 
     RTL_PAGED_CODE();
 
-    if (!RtlpLockAtomTable(p)) {
+    if (!RtlpLockAtomTableShared(p)) {
         return STATUS_INVALID_PARAMETER;
     }
 
@@ -823,7 +847,7 @@ NTSTATUS RtlQueryAtomsInAtomTable(IN PVOID AtomTableHandle,
         Status = GetExceptionCode();
     }
 
-    RtlpUnlockAtomTable(p);
+    RtlpUnlockAtomTableShared(p);
 
     return Status;
 }
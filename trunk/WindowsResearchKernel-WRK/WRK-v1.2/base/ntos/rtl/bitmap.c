@@ -2660,6 +2660,7 @@ RtlFindNextForwardRunClear(
     ULONG End;
     PULONG PHunk, BitMapEnd;
     ULONG Hunk;
+    ULONG Index;
 
 
     // Take care of the boundary case of the null bitmap
@@ -2729,10 +2730,30 @@ RtlFindNextForwardRunClear(
     }
 
 
-    //  Bitwise search forward for the clear bit
+    //  Search forward within the word for the clear bit.  Either the
+    //  word holds a clear bit at or after Start, or it is the last word
+    //  of the bitmap, whose bits past the end may hold anything and
+    //  are clipped off.
+
+
+    if (Start < BitMapHeader->SizeOfBitMap) {
+
+        Hunk = ~(BitMapHeader->Buffer[Start / 32] | FillMaskUlong[Start % 32]);
+
+        if (_BitScanForward(&Index, Hunk)) {
+
+            Start = (Start & ~31) + Index;
 
+        } else {
+
+            Start = (Start & ~31) + 32;
+        }
 
-    while ((Start < BitMapHeader->SizeOfBitMap) && (RtlCheckBit(BitMapHeader, Start) == 1)) { Start += 1; }
+        if (Start > BitMapHeader->SizeOfBitMap) {
+
+            Start = BitMapHeader->SizeOfBitMap;
+        }
+    }
 
 
     //  Scan forward for the first set bit
@@ -2779,10 +2800,28 @@ RtlFindNextForwardRunClear(
     }
 
 
-    //  Bitwise search forward for the set bit
+    //  Search forward within the word for the set bit, again clipping
+    //  the run at the end of the bitmap
 
 
-    while ((End < BitMapHeader->SizeOfBitMap) && (RtlCheckBit(BitMapHeader, End) == 0)) { End += 1; }
+    if (End < BitMapHeader->SizeOfBitMap) {
+
+        Hunk = BitMapHeader->Buffer[End / 32] & ~FillMaskUlong[End % 32];
+
+        if (_BitScanForward(&Index, Hunk)) {
+
+            End = (End & ~31) + Index;
+
+        } else {
+
+            End = (End & ~31) + 32;
+        }
+
+        if (End > BitMapHeader->SizeOfBitMap) {
+
+            End = BitMapHeader->SizeOfBitMap;
+        }
+    }
 
 
     //  Compute the index and return the length
@@ -314,7 +314,11 @@ Return Value:
     if ((*SearchResult == TableEmptyTree) || (*SearchResult != TableFoundNode)) {
         return NULL;
     } else {
-        Table->TableRoot = RtlSplay(*NodeOrParent);// Splay the tree with this node.
+        // Splay the tree with this node.  A repeated lookup of the element already at the root
+        // leaves the tree alone, so hot keys do not keep dirtying the table and its nodes.
+        if (*NodeOrParent != Table->TableRoot) {
+            Table->TableRoot = RtlSplay(*NodeOrParent);
+        }
         return &((PTABLE_ENTRY_HEADER)*NodeOrParent)->UserData;// Return a pointer to the user data.
     }
 }
@@ -24,6 +24,24 @@ Abstract:
 #if !defined(_X86_)
 UNWIND_HISTORY_TABLE RtlpUnwindHistoryTable = {0, UNWIND_HISTORY_TABLE_NONE, -1, 0};
 
+// Define the per processor function table hints.
+// Each processor remembers the last inverted function table entry it matched so repeated lookups in the same module skip the loaded
+// module spin lock. A slot is only written by its own processor at SYNCH_LEVEL; the sequence is odd while the slot is being written so a
+// lookup from a higher level interrupt never uses a torn entry. The generation is advanced under the loaded module spin lock whenever an
+// entry is removed from the inverted table, which invalidates every hint at once.
+
+typedef struct _RTLP_FUNCTION_TABLE_HINT {
+    ULONG Sequence;
+    ULONG Generation;
+    PVOID ImageBase;
+    PRUNTIME_FUNCTION FunctionTable;
+    ULONG SizeOfImage;
+    ULONG SizeOfTable;
+} RTLP_FUNCTION_TABLE_HINT, *PRTLP_FUNCTION_TABLE_HINT;
+
+RTLP_FUNCTION_TABLE_HINT RtlpFunctionTableHint[MAXIMUM_PROCESSORS];
+volatile ULONG RtlpInvertedFunctionTableGeneration = 1;
+
 
 VOID RtlInitializeHistoryTable(VOID)
 /*
@@ -72,6 +90,7 @@ Routine Description:
 PRUNTIME_FUNCTION RtlpSearchInvertedFunctionTable(PINVERTED_FUNCTION_TABLE InvertedTable,
                                                   PVOID ControlPc,
                                                   OUT PVOID *ImageBase,
+                                                  OUT PULONG SizeOfImage,
                                                   OUT PULONG SizeOfTable
 )
 /*
@@ -82,6 +101,7 @@ Arguments:
     InvertedTable - Supplies a pointer to an inverted function table.
     ControlPc - Supplies a PC value to to use in searching the inverted function table.
     ImageBase - Supplies a pointer to a variable that receives the base address of the corresponding module.
+    SizeOfImage - Supplies a pointer to a variable that receives the size of the corresponding module.
     SizeOfTable - Supplies a pointer to a variable that receives the size of the function table in bytes.
 Return Value:
     If a matching entry is located in the specified function table, then the function table address is returned as the function value.
@@ -113,6 +133,7 @@ Return Value:
                 Low = Middle + 1;
             } else {
                 *ImageBase = InvertedEntry->ImageBase;
+                *SizeOfImage = InvertedEntry->SizeOfImage;
                 *SizeOfTable = InvertedEntry->SizeOfTable;
                 return InvertedEntry->FunctionTable;
             }
@@ -203,19 +224,54 @@ Return Value:
     PVOID FunctionTable;
 #else
     PRUNTIME_FUNCTION FunctionTable;
+    volatile RTLP_FUNCTION_TABLE_HINT *Hint;
+    ULONG Sequence;
+    ULONG SizeOfImage;
 #endif
     KIRQL OldIrql;
 
-    // Acquire the loaded module list spinlock and scan the list for the specified PC value if the list has been initialized.
+    // Raise to synchronization level, which also keeps this thread on the current processor while its function table hint is examined.
     OldIrql = KeGetCurrentIrql();
     if (OldIrql < SYNCH_LEVEL) {
         KeRaiseIrqlToSynchLevel();
     }
 
+#ifndef _X86_
+    // If the control PC is in the module this processor matched last and no entry has been removed from the inverted table since, then
+    // return the remembered function table without acquiring the loaded module list spinlock.
+    Hint = &RtlpFunctionTableHint[KeGetCurrentProcessorNumber()];
+    Sequence = Hint->Sequence;
+    if (((Sequence & 1) == 0) && (Hint->Generation == RtlpInvertedFunctionTableGeneration)) {
+        Base = Hint->ImageBase;
+        FunctionTable = Hint->FunctionTable;
+        SizeOfImage = Hint->SizeOfImage;
+        *SizeOfTable = Hint->SizeOfTable;
+        if ((Hint->Sequence == Sequence) &&
+            ((ULONG_PTR)ControlPc >= (ULONG_PTR)Base) &&
+            ((ULONG_PTR)ControlPc < ((ULONG_PTR)Base + SizeOfImage))) {
+            KeLowerIrql(OldIrql);
+            *ImageBase = Base;
+            return FunctionTable;
+        }
+    }
+#endif
+
+    // Acquire the loaded module list spinlock and scan the list for the specified PC value if the list has been initialized.
     ExAcquireSpinLockAtDpcLevel(&PsLoadedModuleSpinLock);
 
 #ifndef _X86_
-    FunctionTable = RtlpSearchInvertedFunctionTable(&PsInvertedFunctionTable, ControlPc, &Base, SizeOfTable);
+    FunctionTable = RtlpSearchInvertedFunctionTable(&PsInvertedFunctionTable, ControlPc, &Base, &SizeOfImage, SizeOfTable);
+    if (FunctionTable != NULL) {
+        // Remember the matching entry for the next lookup on this processor.
+        Hint->Sequence += 1;
+        Hint->Generation = RtlpInvertedFunctionTableGeneration;
+        Hint->ImageBase = Base;
+        Hint->FunctionTable = FunctionTable;
+        Hint->SizeOfImage = SizeOfImage;
+        Hint->SizeOfTable = *SizeOfTable;
+        Hint->Sequence += 1;
+    }
+
     if ((FunctionTable == NULL) && (PsInvertedFunctionTable.Overflow != FALSE))
 #endif
     {
@@ -316,6 +372,7 @@ Arguments:
     // Search for an entry in the specified inverted table that matches the image base.
     // N.B. It is possible a matching entry is not in the inverted table the table was full when an attempt was made to insert the corresponding entry.
     CurrentSize = InvertedTable->CurrentSize;
+    RtlpInvertedFunctionTableGeneration += 1;// Invalidate the per processor function table hints.
     for (Index = 0; Index < CurrentSize; Index += 1) {
         if (ImageBase == InvertedTable->TableEntry[Index].ImageBase) {
             break;
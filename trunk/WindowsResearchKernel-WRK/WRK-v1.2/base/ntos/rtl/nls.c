@@ -725,7 +725,21 @@ Return Value:
 
     StopIndex = ((ULONG)SourceString->Length) / sizeof(WCHAR);
 
-    for (Index = 0; Index < StopIndex; Index++) {
+    // Upcase four 7 bit characters at a time.
+    // In each 16 bit lane bit 7 of (c + 0x1f) is set for c >= 'a' and bit 7 of (c + 0x05) is set for c > 'z', which leaves 0x80 only for lowercase letters; shifting that down gives the 0x20 to subtract.
+    for (Index = 0; Index + 4 <= StopIndex; Index += 4) {
+        ULONGLONG Chars = *(ULONGLONG UNALIGNED *)&SourceString->Buffer[Index];
+        ULONGLONG Lower;
+
+        if ((Chars & 0xff80ff80ff80ff80UI64) != 0) {
+            break;
+        }
+
+        Lower = (Chars + 0x001f001f001f001fUI64) & ~(Chars + 0x0005000500050005UI64) & 0x0080008000800080UI64;
+        *(ULONGLONG UNALIGNED *)&DestinationString->Buffer[Index] = Chars - (Lower >> 2);
+    }
+
+    for (; Index < StopIndex; Index++) {
         DestinationString->Buffer[Index] = (WCHAR)NLS_UPCASE(SourceString->Buffer[Index]);
     }
 
@@ -1818,9 +1832,16 @@ NTSTATUS RtlHashUnicodeString(const UNICODE_STRING *String, BOOLEAN CaseInSensit
     case HASH_STRING_ALGORITHM_DEFAULT:
     case HASH_STRING_ALGORITHM_X65599:
         if (CaseInSensitive) {
+            // Names are overwhelmingly ASCII with mixed case, so upcase that range without a branch on the letter test; NLS_UPCASE is only needed above 0x7f.
             while (Chars-- != 0) {
                 WCHAR Char = *Buffer++;
-                TmpHashValue = (TmpHashValue * 65599) + NLS_UPCASE(Char);
+                if (Char < 0x80) {
+                    Char = (WCHAR)(Char - (((ULONG)(Char - 'a') <= (ULONG)('z' - 'a')) * ('a' - 'A')));
+                } else {
+                    Char = NLS_UPCASE(Char);
+                }
+
+                TmpHashValue = (TmpHashValue * 65599) + Char;
             }
         } else {
             while (Chars-- != 0)
@@ -360,6 +360,8 @@ Return Value:
     ULONG TmpCount;
     PUSHORT TranslateTable;
     ULONG MaxCharsInUnicodeString;
+    ULONG AsciiCheck;
+    LONG Index;
 
     RTL_PAGED_CODE();
 
@@ -376,6 +378,23 @@ Return Value:
         UnicodeString += (LoopCount - TmpCount);
         MultiByteString += (LoopCount - TmpCount);
     quick_copy:
+        if (TmpCount == 0x20) {
+            // A full block that is all 7 bit characters is simply zero extended (see above) without the table lookups.
+            // The block is walked backwards so an in place conversion never overwrites source bytes it has not read.
+            AsciiCheck = 0;
+            for (Index = 0; Index < 0x20; Index += sizeof(ULONG)) {
+                AsciiCheck |= *(ULONG UNALIGNED *)&MultiByteString[Index];
+            }
+
+            if ((AsciiCheck & 0x80808080) == 0) {
+                for (Index = 0x1F; Index >= 0; Index--) {
+                    UnicodeString[Index] = (WCHAR)(UCHAR)MultiByteString[Index];
+                }
+
+                TmpCount = 0;
+            }
+        }
+
         switch (TmpCount) {
         default:
             UnicodeString[0x1F] = TranslateTable[(UCHAR)MultiByteString[0x1F]];
@@ -838,6 +838,8 @@ PUNICODE_PREFIX_TABLE_ENTRY RtlFindUnicodePrefix(IN PUNICODE_PREFIX_TABLE Prefix
 Routine Description:
     This routine finds if a full name has a prefix in a prefix table.
     It returns a pointer to the largest proper prefix found if one exists.
+    The search does not restructure the prefix trees, so callers may run lookups concurrently under a shared lock and only need
+    exclusive access for insert and remove.
 Arguments:
     PrefixTable - Supplies the prefix table to search
     FullString - Supplies the name to search for
@@ -848,9 +850,7 @@ Return Value:
 */
 {
     CLONG NameLength;
-    PUNICODE_PREFIX_TABLE_ENTRY PreviousTree;
     PUNICODE_PREFIX_TABLE_ENTRY CurrentTree;
-    PUNICODE_PREFIX_TABLE_ENTRY NextTree;
     PRTL_SPLAY_LINKS Links;
     PUNICODE_PREFIX_TABLE_ENTRY Node;
     PUNICODE_PREFIX_TABLE_ENTRY Next;
@@ -862,10 +862,8 @@ Return Value:
     NameLength = ComputeUnicodeNameLength(FullName);
 
     //  Locate the first tree that can contain a prefix
-    PreviousTree = (PUNICODE_PREFIX_TABLE_ENTRY)PrefixTable;
-    CurrentTree = PreviousTree->NextPrefixTree;
+    CurrentTree = PrefixTable->NextPrefixTree;
     while (CurrentTree->NameLength > (CSHORT)NameLength) {
-        PreviousTree = CurrentTree;
         CurrentTree = CurrentTree->NextPrefixTree;
     }
 
@@ -892,29 +890,9 @@ Return Value:
             } else {
                 //  We have either a prefix or a match either way we need to check if we should do case sensitive searches
                 if (CaseInsensitiveIndex == 0) {
-                    //  The caller wants case insensitive so we'll return the first one we found
-
-                    //  Now that we've located the node we can splay the tree.
-                    //  To do this we need to remember how we find this tree in the root tree list, 
-                    //  set the root to be an internal, splay, the tree, and then setup the new root node.
-                    if (Node->NodeTypeCode == RTL_NTC_UNICODE_INTERNAL) {
-                        //  Save a pointer to the next tree, we already have the previous tree
-                        NextTree = CurrentTree->NextPrefixTree;
-
-                        //  Reset the current root to be an internal node
-                        CurrentTree->NodeTypeCode = RTL_NTC_UNICODE_INTERNAL;
-                        CurrentTree->NextPrefixTree = NULL;
-
-                        //  Splay the tree and get the root
-                        Node = CONTAINING_RECORD(RtlSplay(&Node->Links), UNICODE_PREFIX_TABLE_ENTRY, Links);
-
-                        //  Set the new root's node type code and make it part of the root tree list
-                        Node->NodeTypeCode = RTL_NTC_UNICODE_ROOT;
-                        PreviousTree->NextPrefixTree = Node;
-                        Node->NextPrefixTree = NextTree;
-                    }
-
-                    return Node;//  Now return the root to our caller
+                    //  The caller wants case insensitive so we'll return the first one we found.
+                    //  The tree is deliberately not splayed here so that lookups never write to the table.
+                    return Node;
                 }
 
                 //  The caller wants an exact match so search the case match until we find a complete match.  Get the first node
@@ -941,7 +919,6 @@ Return Value:
         }
 
         //  This tree is done so now find the next tree
-        PreviousTree = CurrentTree;
         CurrentTree = CurrentTree->NextPrefixTree;
     }
 
@@ -85,6 +85,10 @@ SepNormalAccessCheck(
 );
 
 BOOLEAN SepSidInTokenEx(IN PACCESS_TOKEN AToken, IN PSID PrincipalSelfSid, IN PSID Sid, IN BOOLEAN DenyAce, IN BOOLEAN Restricted);
+BOOLEAN SepLookupAccessCache(IN PTOKEN Token, IN PLUID DescriptorId, IN ACCESS_MASK DesiredAccess, IN ACCESS_MASK PreviouslyGrantedAccess,
+                             IN PGENERIC_MAPPING GenericMapping, OUT PACCESS_MASK GrantedAccess, OUT PNTSTATUS AccessStatus);
+VOID SepInsertAccessCache(IN PTOKEN Token, IN PLUID DescriptorId, IN ACCESS_MASK DesiredAccess, IN ACCESS_MASK PreviouslyGrantedAccess,
+                          IN PGENERIC_MAPPING GenericMapping, IN ACCESS_MASK GrantedAccess, IN NTSTATUS AccessStatus);
 
 
 #ifdef ALLOC_PRAGMA
@@ -102,6 +106,9 @@ BOOLEAN SepSidInTokenEx(IN PACCESS_TOKEN AToken, IN PSID PrincipalSelfSid, IN PS
 #pragma alloc_text(PAGE,SeAccessCheckByType)
 #pragma alloc_text(PAGE,SeFreePrivileges)
 #pragma alloc_text(PAGE,SeAccessCheck)
+#pragma alloc_text(PAGE,SepLookupAccessCache)
+#pragma alloc_text(PAGE,SepInsertAccessCache)
+#pragma alloc_text(PAGE,SeCachedAccessCheck)
 #pragma alloc_text(PAGE,SePrivilegePolicyCheck)
 #pragma alloc_text(PAGE,SepTokenIsOwner)
 #pragma alloc_text(PAGE,SeFastTraverseCheck)
@@ -469,12 +476,14 @@ Return Value:
 */
 {
     ULONG i;
+    LONG Index;
     PISID MatchSid;
     ULONG SidLength;
     PTOKEN Token;
     PSID_AND_ATTRIBUTES TokenSid;
     ULONG UserAndGroupCount;
     USHORT TargetShort;
+    PSEP_SID_HASH SidHash;
 
     C_ASSERT(FIELD_OFFSET(SID, Revision) + sizeof(((SID *)Sid)->Revision) == FIELD_OFFSET(SID, SubAuthorityCount));
     C_ASSERT(sizeof(((SID *)Sid)->Revision) + sizeof(((SID *)Sid)->SubAuthorityCount) == sizeof(USHORT));
@@ -498,6 +507,18 @@ Return Value:
     TokenSid = Token->UserAndGroups;
     UserAndGroupCount = Token->UserAndGroupCount;
 
+    // Tokens with many groups have a hash of their SIDs, which finds the same entry a scan would.
+    SidHash = SepGetSidHash(Token, FALSE);
+    if (SidHash != NULL) {
+        Index = SepLookupSidHash(SidHash, TokenSid, (PISID)Sid, SidLength);
+        if (Index < 0) {
+            return FALSE;
+        }
+
+        TokenSid += Index;
+        return (BOOLEAN)((Index == 0) || (TokenSid->Attributes & SE_GROUP_ENABLED) || (DenyAce && (TokenSid->Attributes & SE_GROUP_USE_FOR_DENY_ONLY)));
+    }
+
     // Scan through the user/groups and attempt to find a match with the specified SID.
     for (i = 0; i < UserAndGroupCount; i += 1) {
         MatchSid = (PISID)TokenSid->Sid;
@@ -543,12 +564,14 @@ Return Value:
 */
 {
     ULONG i;
+    LONG Index;
     PISID MatchSid;
     ULONG SidLength;
     PTOKEN Token;
     PSID_AND_ATTRIBUTES TokenSid;
     ULONG UserAndGroupCount;
     USHORT TargetShort;
+    PSEP_SID_HASH SidHash;
 
     C_ASSERT(FIELD_OFFSET(SID, Revision) + sizeof(((SID *)Sid)->Revision) == FIELD_OFFSET(SID, SubAuthorityCount));
     C_ASSERT(sizeof(((SID *)Sid)->Revision) + sizeof(((SID *)Sid)->SubAuthorityCount) == sizeof(USHORT));
@@ -581,6 +604,20 @@ Return Value:
         UserAndGroupCount = Token->UserAndGroupCount;
     }
 
+    // Tokens with many groups have a hash of their SIDs, which finds the same entry a scan would.
+    SidHash = SepGetSidHash(Token, Restricted);
+    if (SidHash != NULL) {
+        Index = SepLookupSidHash(SidHash, TokenSid, (PISID)Sid, SidLength);
+        if (Index < 0) {
+            return FALSE;
+        }
+
+        TokenSid += Index;
+        return (BOOLEAN)((!Restricted && (Index == 0) && ((TokenSid->Attributes & SE_GROUP_USE_FOR_DENY_ONLY) == 0)) ||
+                         (TokenSid->Attributes & SE_GROUP_ENABLED) ||
+                         (DenyAce && (TokenSid->Attributes & SE_GROUP_USE_FOR_DENY_ONLY)));
+    }
+
     // Scan through the user/groups and attempt to find a match with the specified SID.
     for (i = 0; i < UserAndGroupCount; i += 1) {
         MatchSid = (PISID)TokenSid->Sid;
@@ -2121,6 +2158,179 @@ Return Value:
 }
 
 
+BOOLEAN SepLookupAccessCache(IN PTOKEN Token, IN PLUID DescriptorId, IN ACCESS_MASK DesiredAccess, IN ACCESS_MASK PreviouslyGrantedAccess,
+                             IN PGENERIC_MAPPING GenericMapping, OUT PACCESS_MASK GrantedAccess, OUT PNTSTATUS AccessStatus)
+/*
+Routine Description:
+    Looks up a previous access check result in the token's access check cache.
+    The token must be locked. Results recorded before the token was last modified are ignored.
+Arguments:
+    Token - The token the access check is made for
+    DescriptorId - Identity of the security descriptor
+    DesiredAccess, PreviouslyGrantedAccess, GenericMapping - The remaining inputs of the access check
+    GrantedAccess - Receives the cached granted access
+    AccessStatus - Receives the cached access status
+Return Value:
+    TRUE if a result was found, FALSE otherwise.
+*/
+{
+    PSEP_ACCESS_CACHE Cache;
+    PSEP_ACCESS_CACHE_ENTRY Entry;
+    BOOLEAN Found = FALSE;
+    ULONG Index;
+
+    PAGED_CODE();
+
+    Cache = Token->AccessCache;
+    if (Cache == NULL) {
+        return FALSE;
+    }
+
+    ExAcquirePushLockShared(&Cache->Lock);
+    if (RtlEqualLuid(&Cache->ModifiedId, &Token->ModifiedId)) {
+        for (Index = 0; Index < Cache->EntryCount; Index++) {
+            Entry = &Cache->Entries[Index];
+            if (RtlEqualLuid(&Entry->DescriptorId, DescriptorId) &&
+                Entry->DesiredAccess == DesiredAccess &&
+                Entry->PreviouslyGrantedAccess == PreviouslyGrantedAccess &&
+                Entry->GenericMapping == GenericMapping) {
+                *GrantedAccess = Entry->GrantedAccess;
+                *AccessStatus = Entry->AccessStatus;
+                Found = TRUE;
+                break;
+            }
+        }
+    }
+
+    ExReleasePushLockShared(&Cache->Lock);
+    return Found;
+}
+
+
+VOID SepInsertAccessCache(IN PTOKEN Token, IN PLUID DescriptorId, IN ACCESS_MASK DesiredAccess, IN ACCESS_MASK PreviouslyGrantedAccess,
+                          IN PGENERIC_MAPPING GenericMapping, IN ACCESS_MASK GrantedAccess, IN NTSTATUS AccessStatus)
+/*
+Routine Description:
+    Records an access check result in the token's access check cache, replacing the oldest entry when the cache is full.
+    The token must be locked. The cache is allocated on first use; if that fails the result is simply not recorded.
+Arguments:
+    Token - The token the access check was made for
+    DescriptorId - Identity of the security descriptor
+    DesiredAccess, PreviouslyGrantedAccess, GenericMapping - The remaining inputs of the access check
+    GrantedAccess, AccessStatus - The result of the access check
+*/
+{
+    PSEP_ACCESS_CACHE Cache;
+    PSEP_ACCESS_CACHE_ENTRY Entry;
+
+    PAGED_CODE();
+
+    Cache = Token->AccessCache;
+    if (Cache == NULL) {
+        Cache = ExAllocatePoolWithTag(PagedPool, sizeof(SEP_ACCESS_CACHE), 'cAeS');
+        if (Cache == NULL) {
+            return;
+        }
+
+        ExInitializePushLock(&Cache->Lock);
+        Cache->ModifiedId = Token->ModifiedId;
+        Cache->EntryCount = 0;
+        Cache->NextEntry = 0;
+
+        // Another thread sharing the token lock may have attached a cache first.
+        if (InterlockedCompareExchangePointer(&Token->AccessCache, Cache, NULL) != NULL) {
+            ExFreePool(Cache);
+            Cache = Token->AccessCache;
+        }
+    }
+
+    ExAcquirePushLockExclusive(&Cache->Lock);
+
+    // The token changed since these results were recorded, start over.
+    if (!RtlEqualLuid(&Cache->ModifiedId, &Token->ModifiedId)) {
+        Cache->ModifiedId = Token->ModifiedId;
+        Cache->EntryCount = 0;
+        Cache->NextEntry = 0;
+    }
+
+    Entry = &Cache->Entries[Cache->NextEntry];
+    Entry->DescriptorId = *DescriptorId;
+    Entry->GenericMapping = GenericMapping;
+    Entry->DesiredAccess = DesiredAccess;
+    Entry->PreviouslyGrantedAccess = PreviouslyGrantedAccess;
+    Entry->GrantedAccess = GrantedAccess;
+    Entry->AccessStatus = AccessStatus;
+
+    Cache->NextEntry = (Cache->NextEntry + 1) % SEP_ACCESS_CACHE_ENTRIES;
+    if (Cache->EntryCount < SEP_ACCESS_CACHE_ENTRIES) {
+        Cache->EntryCount += 1;
+    }
+
+    ExReleasePushLockExclusive(&Cache->Lock);
+}
+
+
+BOOLEAN SeCachedAccessCheck(
+    __in PSECURITY_DESCRIPTOR SecurityDescriptor,
+    __in_opt PLUID DescriptorId,
+    __in PSECURITY_SUBJECT_CONTEXT SubjectSecurityContext,
+    __in ACCESS_MASK DesiredAccess,
+    __in ACCESS_MASK PreviouslyGrantedAccess,
+    __deref_out_opt PPRIVILEGE_SET *Privileges,
+    __in PGENERIC_MAPPING GenericMapping,
+    __in KPROCESSOR_MODE AccessMode,
+    __out PACCESS_MASK GrantedAccess,
+    __out PNTSTATUS AccessStatus
+)
+/*
+Routine Description:
+    This routine is SeAccessCheck for callers that know a stable identity for the security descriptor, such as one from the
+    object manager's security descriptor cache. Results are remembered in the subject's token, so repeated checks of the same
+    token against the same descriptor skip the DACL walk. Any change to the token's groups or privileges gives it a new ModifiedId,
+    which invalidates the results.
+
+    Only checks made by a thread that is not impersonating are cached; under impersonation the primary token takes part in the check too.
+    Checks that used a privilege are never cached, since the privilege use must be reported to the caller each time.
+Arguments:
+    DescriptorId - Supplies the identity of SecurityDescriptor, or NULL if it has none, in which case this is just SeAccessCheck.
+    Other arguments are as for SeAccessCheck. The subject context must be locked.
+Return Value:
+    BOOLEAN - TRUE if access is allowed and FALSE otherwise
+*/
+{
+    PTOKEN Token;
+    BOOLEAN AccessAllowed;
+
+    PAGED_CODE();
+
+    if (DescriptorId == NULL || AccessMode == KernelMode || SecurityDescriptor == NULL || DesiredAccess == 0 ||
+        SubjectSecurityContext->ClientToken != NULL) {
+        return SeAccessCheck(SecurityDescriptor, SubjectSecurityContext, TRUE, DesiredAccess, PreviouslyGrantedAccess,
+                             Privileges, GenericMapping, AccessMode, GrantedAccess, AccessStatus);
+    }
+
+    Token = (PTOKEN)SubjectSecurityContext->PrimaryToken;
+    *Privileges = NULL;
+    if (SepLookupAccessCache(Token, DescriptorId, DesiredAccess, PreviouslyGrantedAccess, GenericMapping, GrantedAccess, AccessStatus)) {
+        return (BOOLEAN)NT_SUCCESS(*AccessStatus);
+    }
+
+    AccessAllowed = SeAccessCheck(SecurityDescriptor, SubjectSecurityContext, TRUE, DesiredAccess, PreviouslyGrantedAccess,
+                                  Privileges, GenericMapping, AccessMode, GrantedAccess, AccessStatus);
+
+    // Only remember plain grants and denials; anything else (no memory for the privilege set, ...) may not repeat.
+    if (*Privileges == NULL) {
+        if (AccessAllowed && NT_SUCCESS(*AccessStatus)) {
+            SepInsertAccessCache(Token, DescriptorId, DesiredAccess, PreviouslyGrantedAccess, GenericMapping, *GrantedAccess, *AccessStatus);
+        } else if (!AccessAllowed && *AccessStatus == STATUS_ACCESS_DENIED) {
+            SepInsertAccessCache(Token, DescriptorId, DesiredAccess, PreviouslyGrantedAccess, GenericMapping, 0, STATUS_ACCESS_DENIED);
+        }
+    }
+
+    return AccessAllowed;
+}
+
+
 NTSTATUS SePrivilegePolicyCheck(
     __inout PACCESS_MASK RemainingDesiredAccess,
     __inout PACCESS_MASK PreviouslyGrantedAccess,
@@ -23,6 +23,8 @@ Abstract:
 #pragma alloc_text(PAGE,SepAdtLogAuditRecord)
 #pragma alloc_text(PAGE,SepAuditFailed)
 #pragma alloc_text(PAGE,SepAdtMarshallAuditRecord)
+#pragma alloc_text(PAGE,SepAdtAuditRecordSize)
+#pragma alloc_text(PAGE,SepAdtMarshallAuditRecordInPlace)
 #pragma alloc_text(PAGE,SepAdtCopyToLsaSharedMemory)
 #pragma alloc_text(PAGE,SepQueueWorkItem)
 #pragma alloc_text(PAGE,SepDequeueWorkItem)
@@ -37,6 +39,9 @@ Routine Description:
     The function constructs an Audit Record in self-relative format from the information provided and appends it to the Audit Record Queue,
     a doubly-linked list of Audit Records awaiting output to the Audit Log.
     A dedicated thread reads this queue, writing Audit Records to the Audit Log and removing them from the Audit Queue.
+
+    The record is built directly behind the work item in a single allocation, so queuing an audit costs one pool allocation and one free.
+    While the queue is over its bounds and audits are being discarded, records that would be discarded are only counted, not built.
 Arguments:
     AuditEventType - Specifies the type of the Audit Event described by the audit information provided.
     AuditInformation - Pointer to buffer containing captured auditing information related to an Audit Event of type AuditEventType.
@@ -46,18 +51,48 @@ Return Value:
     STATUS_INSUFFICIENT_RESOURCES - unable to allocate heap
 */
 {
-    NTSTATUS Status;
     BOOLEAN ForceQueue;
+    BOOLEAN Discard;
+    ULONG RecordSize;
+    PSE_ADT_PARAMETER_ARRAY AuditRecord;
     PSEP_LSA_WORK_ITEM AuditWorkItem;
 
     PAGED_CODE();
 
-    AuditWorkItem = ExAllocatePoolWithTag(PagedPool, sizeof(SEP_LSA_WORK_ITEM), 'iAeS');
+    // If we're going to crash on a discarded audit, ignore the queue bounds check and force the item onto the queue.
+    if (SepCrashOnAuditFail || AuditParameters->AuditId == SE_AUDITID_AUDITS_DISCARDED) {
+        ForceQueue = TRUE;
+    } else {
+        ForceQueue = FALSE;
+    }
+
+    // While audits are being discarded SepQueueWorkItem would toss this one anyway, so count it without building the record.
+    // The unlocked test only decides whether to look; the queue lock makes the decision, exactly as SepQueueWorkItem does.
+    if (!ForceQueue && SepAdtDiscardingAudits) {
+        Discard = FALSE;
+        SepLockLsaQueue();
+        if (SepAdtDiscardingAudits && SepAdtCurrentListLength >= SepAdtMinListLength) {
+            SepAdtCountEventsDiscarded++;
+            Discard = TRUE;
+        }
+        SepUnlockLsaQueue();
+
+        if (Discard) {
+            SepAuditFailed(STATUS_UNSUCCESSFUL);
+            return;
+        }
+    }
+
+    // Allocate the work item and the self-relative record behind it as one block; SepDequeueWorkItem frees both together.
+    RecordSize = SepAdtAuditRecordSize(AuditParameters);
+    AuditWorkItem = ExAllocatePoolWithTag(PagedPool, sizeof(SEP_LSA_WORK_ITEM) + RecordSize, 'iAeS');
     if (AuditWorkItem == NULL) {
         SepAuditFailed(STATUS_INSUFFICIENT_RESOURCES);
         return;
     }
 
+    AuditRecord = (PSE_ADT_PARAMETER_ARRAY)(AuditWorkItem + 1);
+
     AuditWorkItem->Tag = SepAuditRecord;
     AuditWorkItem->CommandNumber = LsapWriteAuditMessageCommand;
     AuditWorkItem->ReplyBuffer = NULL;
@@ -65,30 +100,17 @@ Return Value:
     AuditWorkItem->CleanupFunction = NULL;
 
     // Build an Audit record in self-relative format from the supplied Audit Information.
-    Status = SepAdtMarshallAuditRecord(AuditParameters,
-        (PSE_ADT_PARAMETER_ARRAY *)&AuditWorkItem->CommandParams.BaseAddress,
-                                       &AuditWorkItem->CommandParamsMemoryType);
-    if (NT_SUCCESS(Status)) {
-        // Extract the length of the Audit Record.  Store it as the length of the Command Parameters buffer.
-        AuditWorkItem->CommandParamsLength = ((PSE_ADT_PARAMETER_ARRAY)AuditWorkItem->CommandParams.BaseAddress)->Length;
-
-        // If we're going to crash on a discarded audit, ignore the queue bounds check and force the item onto the queue.
-        if (SepCrashOnAuditFail || AuditParameters->AuditId == SE_AUDITID_AUDITS_DISCARDED) {
-            ForceQueue = TRUE;
-        } else {
-            ForceQueue = FALSE;
-        }
-
-        if (!SepQueueWorkItem(AuditWorkItem, ForceQueue)) {
-            ExFreePool(AuditWorkItem->CommandParams.BaseAddress);
-            ExFreePool(AuditWorkItem);
+    // The record is not separately allocated pool, so SepRmCallLsa must not free it.
+    SepAdtMarshallAuditRecordInPlace(AuditParameters, AuditRecord, RecordSize);
+    AuditWorkItem->CommandParams.BaseAddress = AuditRecord;
+    AuditWorkItem->CommandParamsMemoryType = SepRmUnspecifiedMemory;
+    AuditWorkItem->CommandParamsLength = RecordSize;
 
-            // We failed to put the record on the queue.  Take whatever action is appropriate.
-            SepAuditFailed(STATUS_UNSUCCESSFUL);
-        }
-    } else {
+    if (!SepQueueWorkItem(AuditWorkItem, ForceQueue)) {
         ExFreePool(AuditWorkItem);
-        SepAuditFailed(Status);
+
+        // We failed to put the record on the queue.  Take whatever action is appropriate.
+        SepAuditFailed(STATUS_UNSUCCESSFUL);
     }
 }
 
@@ -164,14 +186,39 @@ Arguments:
 Return Value:
     NTSTATUS code
 */
+{
+    ULONG TotalSize;
+
+    PAGED_CODE();
+
+    TotalSize = SepAdtAuditRecordSize(AuditParameters);
+
+    // Allocate a big enough block of memory to hold everything.
+    // If it fails, quietly abort, since there isn't much else we can do.
+    *MarshalledAuditParameters = ExAllocatePoolWithTag(PagedPool, TotalSize, 'pAeS');
+    if (*MarshalledAuditParameters == NULL) {
+        *RecordMemoryType = SepRmNoMemory;
+        return(STATUS_INSUFFICIENT_RESOURCES);
+    }
+
+    *RecordMemoryType = SepRmPagedPoolMemory;
+    SepAdtMarshallAuditRecordInPlace(AuditParameters, *MarshalledAuditParameters, TotalSize);
+    return(STATUS_SUCCESS);
+}
+
+
+ULONG SepAdtAuditRecordSize(IN PSE_ADT_PARAMETER_ARRAY AuditParameters)
+/*
+Routine Description:
+    Computes the size of the self-relative form of an AuditParameters structure.
+Arguments:
+    AuditParameters - A filled in set of AuditParameters to be marshalled.
+Return Value:
+    The number of bytes SepAdtMarshallAuditRecordInPlace needs.
+*/
 {
     ULONG i;
     ULONG TotalSize = sizeof(SE_ADT_PARAMETER_ARRAY);
-    PUNICODE_STRING TargetString;
-    PCHAR Base;
-    ULONG BaseIncr;
-    ULONG Size;
-    PSE_ADT_PARAMETER_ARRAY_ENTRY pInParam, pOutParam;
 
     PAGED_CODE();
 
@@ -185,27 +232,43 @@ Return Value:
     // The overestimate can't be more than 24 dwords, and will never even approach that amount, 
     // so it isn't worth the time it would take to avoid it.
     for (i = 0; i < AuditParameters->ParameterCount; i++) {
-        Size = AuditParameters->Parameters[i].Length;
-        TotalSize += PtrAlignSize(Size);
+        TotalSize += PtrAlignSize(AuditParameters->Parameters[i].Length);
     }
 
-    // Allocate a big enough block of memory to hold everything.
-    // If it fails, quietly abort, since there isn't much else we can do.
-    *MarshalledAuditParameters = ExAllocatePoolWithTag(PagedPool, TotalSize, 'pAeS');
-    if (*MarshalledAuditParameters == NULL) {
-        *RecordMemoryType = SepRmNoMemory;
-        return(STATUS_INSUFFICIENT_RESOURCES);
-    }
+    return TotalSize;
+}
 
-    *RecordMemoryType = SepRmPagedPoolMemory;
-    RtlCopyMemory(*MarshalledAuditParameters, AuditParameters, sizeof(SE_ADT_PARAMETER_ARRAY));
-    (*MarshalledAuditParameters)->Length = TotalSize;
-    (*MarshalledAuditParameters)->Flags = SE_ADT_PARAMETERS_SELF_RELATIVE;
+
+VOID SepAdtMarshallAuditRecordInPlace(IN PSE_ADT_PARAMETER_ARRAY AuditParameters,
+                                      OUT PSE_ADT_PARAMETER_ARRAY MarshalledAuditParameters,
+                                      IN ULONG TotalSize)
+/*
+Routine Description:
+    This routine builds the self-relative form of an AuditParameters structure in a caller supplied buffer.
+Arguments:
+    AuditParameters - A filled in set of AuditParameters to be marshalled.
+    MarshalledAuditParameters - Pointer aligned buffer that receives the AuditParameters in self-relative form.
+    TotalSize - Size of the buffer, as returned by SepAdtAuditRecordSize.
+*/
+{
+    ULONG i;
+    PUNICODE_STRING TargetString;
+    PCHAR Base;
+    ULONG BaseIncr;
+    PSE_ADT_PARAMETER_ARRAY_ENTRY pInParam, pOutParam;
+
+    PAGED_CODE();
+
+    ASSERT(TotalSize == SepAdtAuditRecordSize(AuditParameters));
+
+    RtlCopyMemory(MarshalledAuditParameters, AuditParameters, sizeof(SE_ADT_PARAMETER_ARRAY));
+    MarshalledAuditParameters->Length = TotalSize;
+    MarshalledAuditParameters->Flags = SE_ADT_PARAMETERS_SELF_RELATIVE;
     pInParam = &AuditParameters->Parameters[0];
-    pOutParam = &((*MarshalledAuditParameters)->Parameters[0]);
+    pOutParam = &(MarshalledAuditParameters->Parameters[0]);
 
     // Start walking down the list of parameters and marshall them into the target buffer.
-    Base = (PCHAR)((PCHAR)(*MarshalledAuditParameters) + sizeof(SE_ADT_PARAMETER_ARRAY));
+    Base = (PCHAR)((PCHAR)MarshalledAuditParameters + sizeof(SE_ADT_PARAMETER_ARRAY));
     for (i = 0; i < AuditParameters->ParameterCount; i++, pInParam++, pOutParam++) {
         switch (AuditParameters->Parameters[i].Type) {
         case SeAdtParmTypeNone:
@@ -236,15 +299,15 @@ Return Value:
             *TargetString = *SourceString;
 
             // Reset the data pointer in the output parameters to 'point' to the new string structure.
-            pOutParam->Address = Base - (ULONG_PTR)(*MarshalledAuditParameters);
+            pOutParam->Address = Base - (ULONG_PTR)MarshalledAuditParameters;
             Base += sizeof(UNICODE_STRING);
             RtlCopyMemory(Base, SourceString->Buffer, SourceString->Length);
 
             // Make the string buffer in the target string point to where we just copied the data.
-            TargetString->Buffer = (PWSTR)(Base - (ULONG_PTR)(*MarshalledAuditParameters));
+            TargetString->Buffer = (PWSTR)(Base - (ULONG_PTR)MarshalledAuditParameters);
             BaseIncr = PtrAlignSize(SourceString->Length);
             Base += BaseIncr;
-            ASSERT((ULONG_PTR)Base <= (ULONG_PTR)(*MarshalledAuditParameters) + TotalSize);
+            ASSERT((ULONG_PTR)Base <= (ULONG_PTR)MarshalledAuditParameters + TotalSize);
             break;
         }
 
@@ -258,9 +321,9 @@ Return Value:
             RtlCopyMemory(Base, pInParam->Address, pInParam->Length);// Copy the data into the output buffer
 
             // Reset the 'address' of the data to be its offset in the buffer.
-            pOutParam->Address = Base - (ULONG_PTR)(*MarshalledAuditParameters);
+            pOutParam->Address = Base - (ULONG_PTR)MarshalledAuditParameters;
             Base += PtrAlignSize(pInParam->Length);
-            ASSERT((ULONG_PTR)Base <= (ULONG_PTR)(*MarshalledAuditParameters) + TotalSize);
+            ASSERT((ULONG_PTR)Base <= (ULONG_PTR)MarshalledAuditParameters + TotalSize);
             break;
         }
         default:
@@ -270,8 +333,6 @@ Return Value:
         }
         }
     }
-
-    return(STATUS_SUCCESS);
 }
 
 
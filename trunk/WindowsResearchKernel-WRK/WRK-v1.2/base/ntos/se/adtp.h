@@ -64,6 +64,18 @@ SepAdtMarshallAuditRecord(
     OUT PSEP_RM_LSA_MEMORY_TYPE RecordMemoryType
     );
 
+ULONG
+SepAdtAuditRecordSize(
+    IN PSE_ADT_PARAMETER_ARRAY AuditParameters
+    );
+
+VOID
+SepAdtMarshallAuditRecordInPlace(
+    IN PSE_ADT_PARAMETER_ARRAY AuditParameters,
+    OUT PSE_ADT_PARAMETER_ARRAY MarshalledAuditParameters,
+    IN ULONG TotalSize
+    );
+
 
 BOOLEAN
 SepAdtPrivilegeObjectAuditAlarm (
@@ -40,6 +40,8 @@ BOOLEAN SepCompareSidAndAttributeArrays(IN PSID_AND_ATTRIBUTES SidArray1,
 #pragma alloc_text(INIT,SepTokenInitialization)
 #pragma alloc_text(PAGE,NtCreateToken)
 #pragma alloc_text(PAGE,SepTokenDeleteMethod)
+#pragma alloc_text(PAGE,SepGetSidHash)
+#pragma alloc_text(PAGE,SepLookupSidHash)
 #pragma alloc_text(PAGE,SepCreateToken)
 #pragma alloc_text(PAGE,SepIdAssignableAsOwner)
 #pragma alloc_text(PAGE,SeIsChildToken)
@@ -1557,6 +1559,18 @@ Return Value:
         ExFreePool((((TOKEN *)Token)->AuditData));
     }
 
+    if (ARGUMENT_PRESENT(((TOKEN *)Token)->AccessCache)) {
+        ExFreePool((((TOKEN *)Token)->AccessCache));
+    }
+
+    if (ARGUMENT_PRESENT(((TOKEN *)Token)->SidHash)) {
+        ExFreePool((((TOKEN *)Token)->SidHash));
+    }
+
+    if (ARGUMENT_PRESENT(((TOKEN *)Token)->RestrictedSidHash)) {
+        ExFreePool((((TOKEN *)Token)->RestrictedSidHash));
+    }
+
     if (ARGUMENT_PRESENT(((TOKEN *)Token)->TokenLock)) {
         ExDeleteResourceLite(((TOKEN *)Token)->TokenLock);
         ExFreePool(((TOKEN *)Token)->TokenLock);
@@ -1564,6 +1578,122 @@ Return Value:
 }
 
 
+FORCEINLINE ULONG SepHashSid(IN PISID Sid)
+{
+    ULONG Hash;
+    ULONG Index;
+
+    // The RIDs differ the most between the groups of a token, the authorities hardly at all.
+    Hash = Sid->SubAuthorityCount + Sid->IdentifierAuthority.Value[5];
+    for (Index = 0; Index < Sid->SubAuthorityCount; Index += 1) {
+        Hash = (Hash * 31) + Sid->SubAuthority[Index];
+    }
+
+    return Hash ^ (Hash >> 16);
+}
+
+
+PSEP_SID_HASH SepGetSidHash(IN PTOKEN Token, IN BOOLEAN Restricted)
+/*
+Routine Description:
+    Returns the hash of the user/group or restricted SID array of a token, building it on first use.
+    The arrays never change their membership or order once the token is created, only the attributes, so the hash stays valid for the life of the token.
+    The token must be locked; since the lock may only be held shared the hash is published with an interlocked exchange.
+Arguments:
+    Token - The token to be examined
+    Restricted - Selects the restricted SID array instead of the user/group array
+Return Value:
+    The hash, or NULL if the array is small enough to scan or there was not enough pool to build the hash.
+*/
+{
+    PSEP_SID_HASH *HashLink;
+    PSEP_SID_HASH SidHash;
+    PSID_AND_ATTRIBUTES Sids;
+    ULONG Count, SlotCount, Index, Slot;
+
+    PAGED_CODE();
+
+    if (Restricted) {
+        HashLink = &Token->RestrictedSidHash;
+        Sids = Token->RestrictedSids;
+        Count = Token->RestrictedSidCount;
+    } else {
+        HashLink = &Token->SidHash;
+        Sids = Token->UserAndGroups;
+        Count = Token->UserAndGroupCount;
+    }
+
+    SidHash = *HashLink;
+    if (SidHash != NULL || Count < SEP_SID_HASH_MINIMUM_SIDS || Count >= MAXUSHORT) {
+        return SidHash;
+    }
+
+    // Keep the table at most half full so probe sequences stay short.
+    for (SlotCount = 2 * SEP_SID_HASH_MINIMUM_SIDS; SlotCount < 2 * Count; SlotCount *= 2) {
+        NOTHING;
+    }
+
+    SidHash = ExAllocatePoolWithTag(PagedPool, FIELD_OFFSET(SEP_SID_HASH, Slots) + SlotCount * sizeof(USHORT), 'hSeS');
+    if (SidHash == NULL) {
+        return NULL;
+    }
+
+    SidHash->SlotMask = SlotCount - 1;
+    RtlZeroMemory(SidHash->Slots, SlotCount * sizeof(USHORT));
+
+    // Insert in array order so that a SID present twice is found at its first position, as a linear scan would.
+    for (Index = 0; Index < Count; Index += 1) {
+        Slot = SepHashSid((PISID)Sids[Index].Sid) & SidHash->SlotMask;
+        while (SidHash->Slots[Slot] != 0) {
+            Slot = (Slot + 1) & SidHash->SlotMask;
+        }
+
+        SidHash->Slots[Slot] = (USHORT)(Index + 1);
+    }
+
+    if (InterlockedCompareExchangePointer(HashLink, SidHash, NULL) != NULL) {
+        ExFreePool(SidHash);
+        SidHash = *HashLink;
+    }
+
+    return SidHash;
+}
+
+
+LONG SepLookupSidHash(IN PSEP_SID_HASH SidHash, IN PSID_AND_ATTRIBUTES Sids, IN PISID Sid, IN ULONG SidLength)
+/*
+Routine Description:
+    Finds a SID in the array a SID hash was built for.
+Arguments:
+    SidHash - The hash of Sids
+    Sids - The user/group or restricted SID array of the token
+    Sid - The SID of interest
+    SidLength - Length of Sid
+Return Value:
+    The index of the first matching entry in Sids, or -1 if the SID is not there.
+*/
+{
+    ULONG Slot;
+    ULONG Index;
+    PISID MatchSid;
+
+    PAGED_CODE();
+
+    Slot = SepHashSid(Sid) & SidHash->SlotMask;
+    while (SidHash->Slots[Slot] != 0) {
+        Index = SidHash->Slots[Slot] - 1;
+        MatchSid = (PISID)Sids[Index].Sid;
+        if (*(USHORT *)&MatchSid->Revision == *(USHORT *)&Sid->Revision && RtlEqualMemory(Sid, MatchSid, SidLength)) {
+            return (LONG)Index;
+        }
+
+        Slot = (Slot + 1) & SidHash->SlotMask;
+    }
+
+    return -1;
+}
+
+
 NTSTATUS
 SepCreateToken(
     OUT PHANDLE TokenHandle,
@@ -1835,6 +1965,9 @@ Return Value:
     Token->ProxyData = NULL;
     Token->AuditData = NULL;
     Token->DynamicPart = NULL;
+    Token->AccessCache = NULL;
+    Token->SidHash = NULL;
+    Token->RestrictedSidHash = NULL;
 
     // Increment the reference count for this logon session
     // (fail if there is no corresponding logon session.)
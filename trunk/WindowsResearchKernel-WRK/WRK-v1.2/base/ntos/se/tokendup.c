@@ -371,6 +371,9 @@ Return Value:
 
     ExAllocateLocallyUniqueId(&(NewToken->TokenId));
     NewToken->TokenInUse = FALSE;
+    NewToken->AccessCache = NULL;
+    NewToken->SidHash = NULL;
+    NewToken->RestrictedSidHash = NULL;
     NewToken->TokenType = TokenType;
     NewToken->ImpersonationLevel = ImpersonationLevel;
     NewToken->TokenLock = TokenLock;
@@ -1414,6 +1417,9 @@ Return Value:
     ExAllocateLocallyUniqueId(&(NewToken->ModifiedId));
     ExAllocateLocallyUniqueId(&(NewToken->TokenId));
     NewToken->TokenInUse = FALSE;
+    NewToken->AccessCache = NULL;
+    NewToken->SidHash = NULL;
+    NewToken->RestrictedSidHash = NULL;
     NewToken->AuthenticationId = ExistingToken->AuthenticationId;
     NewToken->TokenSource = ExistingToken->TokenSource;
     NewToken->DynamicAvailable = 0;
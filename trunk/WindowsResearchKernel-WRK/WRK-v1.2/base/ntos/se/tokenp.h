@@ -159,6 +159,40 @@ typedef struct _SEP_AUDIT_POLICY {
 
 //                   ! ! ! ! ! ! ! ! ! ! !
 
+// Cache of recent access check results of a token, see SeCachedAccessCheck.
+// Entries are keyed by the identity of a cached security descriptor and are only valid while ModifiedId matches the token's.
+// The cache has its own lock since it is filled while the token lock is only held shared.
+// Sized so that traverse checks along a deep path do not push out each other or the open of the final component.
+#define SEP_ACCESS_CACHE_ENTRIES 16
+
+typedef struct _SEP_ACCESS_CACHE_ENTRY {
+    LUID DescriptorId;
+    PGENERIC_MAPPING GenericMapping;
+    ACCESS_MASK DesiredAccess;
+    ACCESS_MASK PreviouslyGrantedAccess;
+    ACCESS_MASK GrantedAccess;
+    NTSTATUS AccessStatus;
+} SEP_ACCESS_CACHE_ENTRY, *PSEP_ACCESS_CACHE_ENTRY;
+
+typedef struct _SEP_ACCESS_CACHE {
+    EX_PUSH_LOCK Lock;
+    LUID ModifiedId;
+    ULONG EntryCount;
+    ULONG NextEntry;
+    SEP_ACCESS_CACHE_ENTRY Entries[SEP_ACCESS_CACHE_ENTRIES];
+} SEP_ACCESS_CACHE, *PSEP_ACCESS_CACHE;
+
+
+// Open addressed hash of the SIDs of a token's user/group or restricted SID array, see SepGetSidHash.
+// Slots hold the array index plus one, zero marks an empty slot. Tokens with few SIDs are scanned linearly instead.
+#define SEP_SID_HASH_MINIMUM_SIDS 16
+
+typedef struct _SEP_SID_HASH {
+    ULONG SlotMask;
+    USHORT Slots[1];
+} SEP_SID_HASH, *PSEP_SID_HASH;
+
+
 typedef struct _TOKEN {
     // Fields arranged by size to preserve alignment.
     // Large fields before small fields.
@@ -212,6 +246,9 @@ typedef struct _TOKEN {
 
     PSECURITY_TOKEN_PROXY_DATA ProxyData;               // Ro: 4-Bytes
     PSECURITY_TOKEN_AUDIT_DATA AuditData;               // Ro: 4-Bytes
+    PSEP_ACCESS_CACHE AccessCache;                      // Rw: Ptr, set once, entries protected by the cache lock
+    PSEP_SID_HASH SidHash;                              // Rw: Ptr, set once, hash of UserAndGroups
+    PSEP_SID_HASH RestrictedSidHash;                    // Rw: Ptr, set once, hash of RestrictedSids
 
     // Pointer to the referenced logon session. Protected by the token
     // lock and only valid when TOKEN_SESSION_NOT_REFERENCED is clear.
@@ -336,6 +373,9 @@ VOID SeFreeCapturedObjectTypeList(IN PVOID ObjectTypeList);
       SepReleaseTokenReadLock( T ); \
     }
 
+PSEP_SID_HASH SepGetSidHash(IN PTOKEN Token, IN BOOLEAN Restricted);
+LONG SepLookupSidHash(IN PSEP_SID_HASH SidHash, IN PSID_AND_ATTRIBUTES Sids, IN PISID Sid, IN ULONG SidLength);
+
 // Reference individual privilege attribute flags of any privilege array
 
 //  P - is a pointer to an array of privileges (PLUID_AND_ATTRIBUTES)
@@ -710,6 +710,8 @@ Arguments:
 #endif
     }
     WmipReleaseTraceBuffer(BufferResource, LoggerContext);
+
+    PERFINFO_LOG_STACK_TRACE(EVENT_TRACE_GROUP_MEMORY | Type);
 }
 
 
@@ -811,6 +813,9 @@ Arguments:
     IoTrace->IrpAddr = (PVOID)Irp;
     IoTrace->FileObject = NULL;
 
+    // The event space is already reserved, so the stack lands after it in the buffer
+    PERFINFO_LOG_STACK_TRACE(EVENT_TRACE_GROUP_IO | Header->Packet.Type);
+
     if (FileTraceOn) {
         PFILE_OBJECT *fileTable;
         ULONG i;
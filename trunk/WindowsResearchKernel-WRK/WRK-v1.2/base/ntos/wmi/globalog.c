@@ -288,6 +288,10 @@ Arguments:
     LogfileHeader->MaximumFileSize = LoggerContext->MaximumFileSize;
     LogfileHeader->TimerResolution = KeMaximumIncrement;
 
+    // Consumers of EVENT_TRACE_CLOCK_CPUCYCLE logs need the cycle rate to turn timestamps into time.
+    // The rate was measured against the performance counter when this processor was initialized.
+    LogfileHeader->CpuSpeedInMHz = KeGetCurrentPrcb()->MHz;
+
     if (LoggerContext->Wow && !LoggerContext->KernelTraceOn) {
         // We need to shrink a log file header for a non-kernel WOW64 logger.
         PUCHAR LoggerNamePtr64, LogFileNamePtr64;
@@ -266,6 +266,35 @@ Environment:
 }
 
 
+ULONG WmipGetEventsLost(IN PWMI_LOGGER_CONTEXT LoggerContext)
+/*
+Routine Description:
+    This routine returns the number of events lost by a logger.  Events dropped while
+    reserving space are counted in a per processor slot and are summed here with the
+    logger wide count.  The result is a snapshot; events may still be lost while summing.
+Arguments:
+    LoggerContext - Logger Context
+Return Value:
+    The number of events lost.
+Environment:
+    Kernel mode.
+    This routine works at any IRQL.
+*/
+{
+    ULONG EventsLost;
+    ULONG i;
+
+    EventsLost = LoggerContext->EventsLost;
+    if (LoggerContext->ProcessorEventsLost != NULL) {
+        for (i = 0; i < (ULONG)KeNumberProcessors; i++) {
+            EventsLost += LoggerContext->ProcessorEventsLost[i];
+        }
+    }
+
+    return EventsLost;
+}
+
+
 NTSTATUS WmipAdjustFreeBuffers(IN PWMI_LOGGER_CONTEXT LoggerContext)
 /*
 Routine Description:
@@ -513,7 +542,13 @@ TryFindSpace:
 LostEvent:
     // Will get here it we are throwing away the event
     ASSERT(Buffer == NULL);
-    LoggerContext->EventsLost++;    // best attempt to be accurate
+    if (LoggerContext->ProcessorEventsLost != NULL) {
+        // Count it against the processor we are on so concurrent losses
+        // on other processors do not contend for the same counter.
+        InterlockedIncrement((PLONG)&LoggerContext->ProcessorEventsLost[KeGetCurrentProcessorNumber()]);
+    } else {
+        LoggerContext->EventsLost++;    // best attempt to be accurate
+    }
     ReservedSpace = NULL;
     if (LoggerContext->SequencePtr) {
         InterlockedIncrement(LoggerContext->SequencePtr);
@@ -969,11 +1004,20 @@ Return Value:
                     Buffer->Wnode.Flags |= WNODE_FLAG_USE_TIMESTAMP;
                 }
 
+                // Real time consumers parse up to Buffer->Offset, so only hand
+                // them the filled part of the buffer.  The 0XFF padding is
+                // only needed for the fixed size records in the log file.
+                // This keeps a mostly empty buffer from costing a full
+                // BufferSize copy and a full BufferSize of event queue space.
+                Buffer->Wnode.BufferSize = Buffer->Offset;
+
                 // need to see if we can send anymore
                 // check for queue length
                 if (!NT_SUCCESS(WmipProcessEvent((PWNODE_HEADER)Buffer, FALSE, FALSE))) {
                     LoggerContext->RealTimeBuffersLost++;
                 }
+
+                Buffer->Wnode.BufferSize = BufferSize;
             }
         }
 
@@ -1682,7 +1726,7 @@ NTSTATUS WmipFinalizeHeader(IN HANDLE FileHandle, IN PWMI_LOGGER_CONTEXT LoggerC
     } else {
         FileHeader->BuffersLost = LoggerContext->LogBuffersLost;
     }
-    FileHeader->EventsLost = LoggerContext->EventsLost;
+    FileHeader->EventsLost = WmipGetEventsLost(LoggerContext);
     Status = ZwWriteFile(FileHandle, NULL, NULL, NULL, &IoStatus, &Buffer[0], PAGE_SIZE, &ByteOffset, NULL);
     return Status;
 }
@@ -1914,7 +1958,11 @@ Return Value:
         }
     }
 
-    LoggerContext->EventsLost++;
+    if (LoggerContext->ProcessorEventsLost != NULL) {
+        LoggerContext->ProcessorEventsLost[CurrentProcessor]++;// Context swap tracing runs at DISPATCH_LEVEL on this processor
+    } else {
+        LoggerContext->EventsLost++;
+    }
     return NULL;
 }
 
@@ -137,6 +137,7 @@ typedef struct _WMI_LOGGER_CONTEXT {
     SLIST_HEADER                WaitList;
     SLIST_HEADER                GlobalList;
     PWMI_BUFFER_HEADER*         ProcessorBuffers;   // Per Processor Buffer
+    PULONG                      ProcessorEventsLost; // Per Processor lost event counts
     UNICODE_STRING              LoggerName;         // points to paged pool
     UNICODE_STRING              LogFileName;
     UNICODE_STRING              LogFilePattern;
@@ -237,6 +238,7 @@ PVOID FASTCALL WmipReserveTraceBuffer(IN  PWMI_LOGGER_CONTEXT LoggerContext, IN
 ULONG FASTCALL WmipReleaseTraceBuffer(IN PWMI_BUFFER_HEADER Buffer, IN PWMI_LOGGER_CONTEXT LoggerContext);
 PWMI_BUFFER_HEADER WmipGetFreeBuffer(IN PWMI_LOGGER_CONTEXT LoggerContext);
 ULONG WmipAllocateFreeBuffers(IN PWMI_LOGGER_CONTEXT LoggerContext, IN ULONG NumberOfBuffers);
+ULONG WmipGetEventsLost(IN PWMI_LOGGER_CONTEXT LoggerContext);
 NTSTATUS WmipAdjustFreeBuffers(IN PWMI_LOGGER_CONTEXT LoggerContext);
 NTSTATUS WmipShutdown(IN PDEVICE_OBJECT DeviceObject, IN PIRP           Irp);
 VOID WmipLogger(IN PWMI_LOGGER_CONTEXT LoggerContext);
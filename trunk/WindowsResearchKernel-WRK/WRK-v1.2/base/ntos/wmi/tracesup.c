@@ -904,7 +904,7 @@ Return Value:
     LoggerInfo->NumberOfBuffers = (ULONG)LoggerContext->NumberOfBuffers;
     LoggerInfo->MinimumBuffers = LoggerContext->MinimumBuffers;
     LoggerInfo->MaximumBuffers = LoggerContext->MaximumBuffers;
-    LoggerInfo->EventsLost = LoggerContext->EventsLost;
+    LoggerInfo->EventsLost = WmipGetEventsLost(LoggerContext);
     LoggerInfo->FreeBuffers = (ULONG)LoggerContext->BuffersAvailable;
     LoggerInfo->BuffersWritten = LoggerContext->BuffersWritten;
     LoggerInfo->Wow = LoggerContext->Wow;
@@ -1383,6 +1383,15 @@ Returned Value:
         return STATUS_NO_MEMORY;
     }
 
+    // Allocate Per Processor lost event counters so that dropping events
+    // on one processor does not bounce a shared counter between all of them.
+    // The context page is zeroed when it is allocated.
+    LoggerContext->ProcessorEventsLost = (PULONG)WmipExtendBase(LoggerContext, sizeof(ULONG)*NumberProcessors);
+    if (LoggerContext->ProcessorEventsLost == NULL) {
+        WmipFreeTraceBufferPool(LoggerContext);
+        return STATUS_NO_MEMORY;
+    }
+
     // NOTE: We already know that we have allocated > number of processors buffers
     for (i = 0; i < (LONG)NumberProcessors; i++) {
         Buffer = (PWMI_BUFFER_HEADER)WmipGetFreeBuffer(LoggerContext);
@@ -127,6 +127,33 @@ typedef struct _PERFINFO_DRIVER_COMPLETE_REQUEST_RET {
     ULONG UniqMatchId;
 } PERFINFO_DRIVER_COMPLETE_REQUEST_RET, *PPERFINFO_DRIVER_COMPLETE_REQUEST_RET;
 
+typedef struct _PERFINFO_DRIVER_COMPLETIONROUTINE {
+    PVOID Routine;
+    PVOID Irp;
+    ULONG UniqMatchId;
+} PERFINFO_DRIVER_COMPLETIONROUTINE, *PPERFINFO_DRIVER_COMPLETIONROUTINE;
+
+typedef struct _PERFINFO_DRIVER_COMPLETIONROUTINE_RET {
+    PVOID Irp;
+    ULONG UniqMatchId;
+} PERFINFO_DRIVER_COMPLETIONROUTINE_RET, *PPERFINFO_DRIVER_COMPLETIONROUTINE_RET;
+
+// This structure is logged when the special kernel APC that finishes an IRP in the requesting thread starts to run.
+typedef struct _PERFINFO_DRIVER_COMPLETE_REQUEST_APC {
+    PVOID Irp;
+    LONG Status;
+} PERFINFO_DRIVER_COMPLETE_REQUEST_APC, *PPERFINFO_DRIVER_COMPLETE_REQUEST_APC;
+
+// This structure is logged for each device when the PERF_DRIVERS group is turned off.
+// Count[n] is the number of IRPs sent to the device whose time from first dispatch to completion by a driver was
+// 2^n up to 2^(n+1) microseconds; the first and last buckets also count everything below and above.
+#define PERFINFO_DRIVER_LATENCY_BUCKETS 24
+
+typedef struct _PERFINFO_DRIVER_LATENCY_HISTOGRAM {
+    PVOID DeviceObject;
+    ULONG Count[PERFINFO_DRIVER_LATENCY_BUCKETS];
+} PERFINFO_DRIVER_LATENCY_HISTOGRAM, *PPERFINFO_DRIVER_LATENCY_HISTOGRAM;
+
 // This structure is logged when PopSetPowerAction is called to start
 // propagating a new power action (e.g. standby/hibernate/shutdown)
 typedef struct _PERFINFO_SET_POWER_ACTION {
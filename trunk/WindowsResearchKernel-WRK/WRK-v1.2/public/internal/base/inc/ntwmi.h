@@ -721,6 +721,7 @@ typedef struct _WMI_SWITCH_BUFFER_INFORMATION {
 #define PERFINFO_LOG_TYPE_THREAD_RESERVED2          (EVENT_TRACE_GROUP_THREAD | 0x26)
 #define PERFINFO_LOG_TYPE_OUTSWAPSTACK              (EVENT_TRACE_GROUP_THREAD | 0x27) // going away
 #define PERFINFO_LOG_TYPE_INSWAPSTACK               (EVENT_TRACE_GROUP_THREAD | 0x28) // going away
+#define PERFINFO_LOG_TYPE_READYTHREAD               (EVENT_TRACE_GROUP_THREAD | 0x29) // wait satisfied, logged with context swaps
 
 
 // Event types for IO subsystem
@@ -761,6 +762,8 @@ typedef struct _WMI_SWITCH_BUFFER_INFORMATION {
 #define PERFINFO_LOG_TYPE_DRIVER_COMPLETE_REQUEST           (EVENT_TRACE_GROUP_IO | 0x34)
 #define PERFINFO_LOG_TYPE_DRIVER_COMPLETE_REQUEST_RETURN    (EVENT_TRACE_GROUP_IO | 0x35)
 #define PERFINFO_LOG_TYPE_BOOT_PREFETCH_INFORMATION         (EVENT_TRACE_GROUP_IO | 0x36)
+#define PERFINFO_LOG_TYPE_DRIVER_COMPLETE_REQUEST_APC       (EVENT_TRACE_GROUP_IO | 0x37)
+#define PERFINFO_LOG_TYPE_DRIVER_LATENCY_HISTOGRAM          (EVENT_TRACE_GROUP_IO | 0x38)
 
 
 // Event types for Memory subsystem
@@ -1331,6 +1334,20 @@ typedef struct _WMI_CONTEXTSWAP {
 
 } WMI_CONTEXTSWAP, *PWMI_CONTEXTSWAP;
 
+typedef struct _WMI_READYTHREAD {
+
+    ULONG   ThreadId;               // Thread whose wait was satisfied
+    ULONG   ReadyingThreadId;       // Thread that satisfied it, 0 if done by a DPC
+    ULONG   WaitTime;               // Ticks spent in the wait
+    LONG    WaitStatus;             // Wait completion status
+
+    UCHAR   WaitReason;
+    CHAR    WaitMode;
+    CHAR    AdjustIncrement;
+    UCHAR   Reserved;
+
+} WMI_READYTHREAD, *PWMI_READYTHREAD;
+
 typedef struct _HEAP_EVENT_ALLOC {
 
         PVOID HeapHandle;               // Handle of Heap
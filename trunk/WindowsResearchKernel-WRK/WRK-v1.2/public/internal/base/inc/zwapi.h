@@ -416,6 +416,50 @@ NTSYSAPI NTSTATUS NTAPI ZwReadFileScatter(
     __in_opt PLARGE_INTEGER ByteOffset,
     __in_opt PULONG Key
 );
+NTSYSAPI NTSTATUS NTAPI ZwRegisterIoBuffer(__in_bcount(Length) PVOID Buffer, __in ULONG Length, __out_opt PULONG BufferIndex);
+NTSYSAPI NTSTATUS NTAPI ZwUnregisterIoBuffer(__in PVOID Buffer);
+NTSYSAPI NTSTATUS NTAPI ZwRegisterIoHandle(__in HANDLE FileHandle, __out PULONG FileIndex);
+NTSYSAPI NTSTATUS NTAPI ZwUnregisterIoHandle(__in ULONG FileIndex);
+NTSYSAPI NTSTATUS NTAPI ZwReadFileRegistered(
+    __in ULONG FileIndex,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in ULONG BufferIndex,
+    __in ULONG BufferOffset,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+);
+NTSYSAPI NTSTATUS NTAPI ZwWriteFileRegistered(
+    __in ULONG FileIndex,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in ULONG BufferIndex,
+    __in ULONG BufferOffset,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+);
+NTSYSAPI NTSTATUS NTAPI ZwReadFileVector(
+    __in HANDLE FileHandle,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_ecount(NumberOfSegments) PFILE_IO_SEGMENT SegmentArray,
+    __in ULONG NumberOfSegments,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+);
+NTSYSAPI NTSTATUS NTAPI ZwWriteFileVector(
+    __in HANDLE FileHandle,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_ecount(NumberOfSegments) PFILE_IO_SEGMENT SegmentArray,
+    __in ULONG NumberOfSegments,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+);
 NTSYSAPI NTSTATUS NTAPI ZwSetEaFile(__in HANDLE FileHandle,
                                     __out PIO_STATUS_BLOCK IoStatusBlock,
                                     __in_bcount(Length) PVOID Buffer,
@@ -459,6 +503,15 @@ NTSYSAPI NTSTATUS NTAPI ZwRemoveIoCompletion(__in HANDLE IoCompletionHandle,
                                              __out PVOID* ApcContext,
                                              __out PIO_STATUS_BLOCK IoStatusBlock,
                                              __in_opt PLARGE_INTEGER Timeout);
+NTSYSAPI NTSTATUS NTAPI ZwEnterIoRing(__inout PIO_RING Ring,
+                                      __in HANDLE IoCompletionHandle,
+                                      __in ULONG MinimumCompletions,
+                                      __in_opt PLARGE_INTEGER Timeout);
+NTSYSAPI NTSTATUS NTAPI ZwRemoveIoCompletionEx(__in HANDLE IoCompletionHandle,
+                                               __out_ecount(Count) PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+                                               __in ULONG Count,
+                                               __out PULONG NumEntriesRemoved,
+                                               __in_opt PLARGE_INTEGER Timeout);
 NTSYSAPI NTSTATUS NTAPI ZwCallbackReturn(__in_bcount_opt(OutputLength) PVOID OutputBuffer, __in ULONG OutputLength, __in NTSTATUS Status);
 NTSYSAPI NTSTATUS NTAPI ZwQueryDebugFilterState(__in ULONG ComponentId, __in ULONG Level);
 NTSYSAPI NTSTATUS NTAPI ZwSetDebugFilterState(__in ULONG ComponentId, __in ULONG Level, __in BOOLEAN State);
@@ -590,6 +643,21 @@ NTSYSAPI NTSTATUS NTAPI ZwFreeVirtualMemory(
     __inout PSIZE_T RegionSize,
     __in ULONG FreeType
 );
+NTSYSAPI NTSTATUS NTAPI ZwAllocateVirtualMemoryRanges(
+    __in HANDLE ProcessHandle,
+    __in ULONG_PTR NumberOfEntries,
+    __inout_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY Ranges,
+    __in ULONG AllocationType,
+    __in ULONG Protect,
+    __out_opt PULONG_PTR NumberOfEntriesProcessed
+);
+NTSYSAPI NTSTATUS NTAPI ZwFreeVirtualMemoryRanges(
+    __in HANDLE ProcessHandle,
+    __in ULONG_PTR NumberOfEntries,
+    __inout_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY Ranges,
+    __in ULONG FreeType,
+    __out_opt PULONG_PTR NumberOfEntriesProcessed
+);
 NTSYSAPI NTSTATUS NTAPI ZwReadVirtualMemory(
     __in HANDLE ProcessHandle,
     __in_opt PVOID BaseAddress,
@@ -603,6 +671,7 @@ NTSYSAPI NTSTATUS NTAPI ZwWriteVirtualMemory(__in HANDLE ProcessHandle,
                                              __in SIZE_T BufferSize,
                                              __out_opt PSIZE_T NumberOfBytesWritten);
 NTSYSAPI NTSTATUS NTAPI ZwFlushVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID* BaseAddress, __inout PSIZE_T RegionSize, __out PIO_STATUS_BLOCK IoStatus);
+NTSYSAPI NTSTATUS NTAPI ZwPrefetchVirtualMemory(__in ULONG_PTR NumberOfEntries, __in_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY VirtualAddresses, __in ULONG Flags);
 NTSYSAPI NTSTATUS NTAPI ZwLockVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID* BaseAddress, __inout PSIZE_T RegionSize, __in ULONG MapType);
 NTSYSAPI NTSTATUS NTAPI ZwUnlockVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID* BaseAddress, __inout PSIZE_T RegionSize, __in ULONG MapType);
 NTSYSAPI NTSTATUS NTAPI ZwProtectVirtualMemory(__in HANDLE ProcessHandle,
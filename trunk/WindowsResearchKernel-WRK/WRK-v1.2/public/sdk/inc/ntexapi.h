@@ -566,6 +566,16 @@ typedef enum _SYSTEM_INFORMATION_CLASS {
     SystemSuperfetchInformation,
     SystemMemoryListInformation,
     SystemFileCacheInformationEx,
+    SystemTimerCoalescingInformation,
+    SystemLockProfileInformation,
+    SystemDpcLatencyInformation,
+    SystemPoolProfileInformation,
+    SystemLookasideTuningInformation,
+    SystemZeroPageInformation,
+    SystemModifiedWriterInformation,
+    SystemAweMapInformation,
+    SystemCacheManagerInformation,
+    SystemProcessChangeInformation,
     MaxSystemInfoClass  // MaxSystemInfoClass should always be the last enum
 } SYSTEM_INFORMATION_CLASS;
 
@@ -1314,6 +1324,68 @@ typedef struct _SYSTEM_DPC_BEHAVIOR_INFORMATION {
     ULONG IdealDpcRate;
 } SYSTEM_DPC_BEHAVIOR_INFORMATION, *PSYSTEM_DPC_BEHAVIOR_INFORMATION;
 
+typedef struct _SYSTEM_TIMER_COALESCING_INFORMATION {
+    ULONG CoalescedExpirations;
+} SYSTEM_TIMER_COALESCING_INFORMATION, *PSYSTEM_TIMER_COALESCING_INFORMATION;
+
+#define SYSTEM_DPC_LATENCY_BUCKETS 16
+
+typedef struct _SYSTEM_DPC_LATENCY_INFORMATION {
+    ULONG QueueLatency[SYSTEM_DPC_LATENCY_BUCKETS];
+    ULONG ExecutionTime[SYSTEM_DPC_LATENCY_BUCKETS];
+    ULONG OffloadCount;
+} SYSTEM_DPC_LATENCY_INFORMATION, *PSYSTEM_DPC_LATENCY_INFORMATION;
+
+typedef struct _SYSTEM_DPC_LATENCY_CONTROL {
+    BOOLEAN EnableHistograms;
+    BOOLEAN ResetHistograms;
+    ULONGLONG OffloadThreshold;
+} SYSTEM_DPC_LATENCY_CONTROL, *PSYSTEM_DPC_LATENCY_CONTROL;
+
+typedef struct _SYSTEM_LOCK_PROFILE_ENTRY {
+    PVOID Lock;
+    PVOID CallSite;
+    ULONG Processor;
+    ULONG Reserved;
+    ULONGLONG AcquireCount;
+    ULONGLONG ContentionCount;
+    ULONGLONG SpinCycles;
+    ULONGLONG MaximumHoldCycles;
+} SYSTEM_LOCK_PROFILE_ENTRY, *PSYSTEM_LOCK_PROFILE_ENTRY;
+
+typedef struct _SYSTEM_LOCK_PROFILE_INFORMATION {
+    ULONG NumberOfEntries;
+    ULONG DroppedCount;
+    SYSTEM_LOCK_PROFILE_ENTRY Entries[1];
+} SYSTEM_LOCK_PROFILE_INFORMATION, *PSYSTEM_LOCK_PROFILE_INFORMATION;
+
+#define SYSTEM_POOL_PROFILE_FRAMES 8
+
+typedef struct _SYSTEM_POOL_PROFILE_ENTRY {
+    ULONG CallSiteHash;
+    ULONG Tag;
+    ULONG Allocations;
+    ULONG Frees;
+    LONGLONG BytesOutstanding;
+    ULONG Depth;
+    ULONG Reserved;
+    PVOID BackTrace[SYSTEM_POOL_PROFILE_FRAMES];
+} SYSTEM_POOL_PROFILE_ENTRY, *PSYSTEM_POOL_PROFILE_ENTRY;
+
+typedef struct _SYSTEM_POOL_PROFILE_INFORMATION {
+    ULONG SampleInterval;
+    ULONG NumberOfEntries;
+    ULONG DroppedCount;
+    ULONG Reserved;
+    ULONGLONG ElapsedTime;
+    SYSTEM_POOL_PROFILE_ENTRY Entries[1];
+} SYSTEM_POOL_PROFILE_INFORMATION, *PSYSTEM_POOL_PROFILE_INFORMATION;
+
+typedef struct _SYSTEM_POOL_PROFILE_CONTROL {
+    ULONG SampleInterval;
+    BOOLEAN Reset;
+} SYSTEM_POOL_PROFILE_CONTROL, *PSYSTEM_POOL_PROFILE_CONTROL;
+
 #endif // DEVL
 
 typedef struct _SYSTEM_LOOKASIDE_INFORMATION {
@@ -1328,6 +1400,106 @@ typedef struct _SYSTEM_LOOKASIDE_INFORMATION {
     ULONG Size;
 } SYSTEM_LOOKASIDE_INFORMATION, *PSYSTEM_LOOKASIDE_INFORMATION;
 
+#define SYSTEM_LOOKASIDE_DEPTH_HISTORY 2
+
+typedef struct _SYSTEM_LOOKASIDE_TUNING_INFORMATION {
+    USHORT CurrentDepth;
+    USHORT MaximumDepth;
+    USHORT PeakDepth;
+    USHORT HitRatio;
+    USHORT DepthHistory[SYSTEM_LOOKASIDE_DEPTH_HISTORY];
+    ULONG TotalAllocates;
+    ULONG AllocateMisses;
+    ULONG Type;
+    ULONG Tag;
+    ULONG Size;
+} SYSTEM_LOOKASIDE_TUNING_INFORMATION, *PSYSTEM_LOOKASIDE_TUNING_INFORMATION;
+
+typedef struct _SYSTEM_ZERO_PAGE_NODE_INFORMATION {
+    ULONGLONG PagesZeroed;
+    ULONGLONG ZeroingTime;      // in 100ns units
+} SYSTEM_ZERO_PAGE_NODE_INFORMATION, *PSYSTEM_ZERO_PAGE_NODE_INFORMATION;
+
+typedef struct _SYSTEM_ZERO_PAGE_INFORMATION {
+    ULONG NumberOfNodes;
+    ULONG Reserved;
+    SYSTEM_ZERO_PAGE_NODE_INFORMATION Node[1];
+} SYSTEM_ZERO_PAGE_INFORMATION, *PSYSTEM_ZERO_PAGE_INFORMATION;
+
+// Bucket N of a cluster histogram counts the writes of 2^N to 2^(N+1)-1 pages, the last bucket also counts all larger writes.
+#define SYSTEM_WRITE_CLUSTER_HISTOGRAM 8
+
+typedef struct _SYSTEM_WRITE_STATISTICS {
+    ULONGLONG PagesWritten;
+    ULONGLONG Writes;
+    ULONG ClusterHistogram[SYSTEM_WRITE_CLUSTER_HISTOGRAM];
+} SYSTEM_WRITE_STATISTICS, *PSYSTEM_WRITE_STATISTICS;
+
+typedef struct _SYSTEM_MODIFIED_WRITER_INFORMATION {
+    ULONG PagesWrittenPerSecond;    // over the last full second of writes
+    ULONG NumberOfPagingFiles;
+    SYSTEM_WRITE_STATISTICS MappedFiles;
+    SYSTEM_WRITE_STATISTICS PagingFile[1];
+} SYSTEM_MODIFIED_WRITER_INFORMATION, *PSYSTEM_MODIFIED_WRITER_INFORMATION;
+
+// Bucket N of the latency histogram counts the calls taking 2^(N+10) to 2^(N+11)-1 cycles, the first and last buckets also count all shorter and longer calls.
+#define SYSTEM_AWE_MAP_LATENCY_BUCKETS 16
+
+typedef struct _SYSTEM_AWE_MAP_INFORMATION {
+    ULONGLONG Calls;
+    ULONGLONG PagesMapped;
+    ULONGLONG PagesUnmapped;    // valid mappings replaced or removed
+    ULONGLONG TbFlushes;
+    ULONGLONG Cycles;           // time stamp counter cycles spent mapping
+    ULONG Latency[SYSTEM_AWE_MAP_LATENCY_BUCKETS];
+} SYSTEM_AWE_MAP_INFORMATION, *PSYSTEM_AWE_MAP_INFORMATION;
+
+// Write behinds are counted per volume bucket, volumes being hashed on their device object.
+#define SYSTEM_CACHE_WRITE_BEHIND_BUCKETS 32
+
+typedef struct _SYSTEM_CACHE_MANAGER_INFORMATION {
+    ULONG CopyReads;                // CcCopyRead and CcFastCopyRead calls
+    ULONG CopyReadMisses;           // pages those calls had to fault in
+    ULONG ReadAheadPages;           // pages touched by read ahead
+    ULONG ReadAheadPagesResident;   // of those, pages which were already resident
+    ULONG ReadAheadIos;
+    ULONG VacbMaps;                 // views mapped into the system cache
+    ULONG VacbUnmaps;
+    ULONG DirtyPages;
+    ULONG DirtyPageThreshold;
+    ULONG PagesYetToWrite;          // pages the current lazy write pass has still to write
+    ULONG LazyWriteIos;
+    ULONG LazyWritePages;
+    ULONG WorkQueueDepth;           // work items waiting for a cache worker thread
+    ULONG ActiveWorkerThreads;
+    ULONG NumberWorkerThreads;
+    ULONG DeferredWrites;           // writes currently held up by the write throttle
+    ULONG DeferredWriteWaits;       // synchronous writers which had to wait
+    ULONGLONG DeferredWriteWaitTime;    // total time those writers waited, in 100ns units
+    ULONG ActiveWriteBehinds[SYSTEM_CACHE_WRITE_BEHIND_BUCKETS];
+} SYSTEM_CACHE_MANAGER_INFORMATION, *PSYSTEM_CACHE_MANAGER_INFORMATION;
+
+// Every insertion into and removal from the active process list gets the next generation number.
+// A caller passes in the last generation it has seen and gets the changes made since, oldest first.
+// If more changes were made than the system remembers, Overflow is set and no changes are returned;
+// the caller must enumerate SystemProcessInformation again. Querying the changes before enumerating ensures none is missed.
+#define SYSTEM_PROCESS_CHANGE_CREATED 1
+#define SYSTEM_PROCESS_CHANGE_DELETED 2
+
+typedef struct _SYSTEM_PROCESS_CHANGE {
+    ULONG Generation;
+    ULONG ChangeType;
+    HANDLE UniqueProcessId;
+    HANDLE InheritedFromUniqueProcessId;
+} SYSTEM_PROCESS_CHANGE, *PSYSTEM_PROCESS_CHANGE;
+
+typedef struct _SYSTEM_PROCESS_CHANGE_INFORMATION {
+    ULONG Generation;           // in: last generation seen, out: current generation
+    ULONG NumberOfChanges;
+    BOOLEAN Overflow;
+    SYSTEM_PROCESS_CHANGE Changes[1];
+} SYSTEM_PROCESS_CHANGE_INFORMATION, *PSYSTEM_PROCESS_CHANGE_INFORMATION;
+
 typedef struct _SYSTEM_LEGACY_DRIVER_INFORMATION {
     ULONG VetoType;
     UNICODE_STRING VetoList;
@@ -155,6 +155,8 @@ extern "C" {
 #define FILE_OPEN_FOR_BACKUP_INTENT             0x00004000
 #define FILE_NO_COMPRESSION                     0x00008000
 
+#define FILE_POSITIONAL_IO_ONLY                 0x00080000
+
 #define FILE_RESERVE_OPFILTER                   0x00100000
 #define FILE_OPEN_REPARSE_POINT                 0x00200000
 #define FILE_OPEN_NO_RECALL                     0x00400000
@@ -455,6 +457,7 @@ typedef enum _FILE_INFORMATION_CLASS {
     FileIdFullDirectoryInformation, // 38
     FileValidDataLengthInformation, // 39
     FileShortNameInformation,       // 40
+    FileIoPriorityHintInformation,  // 41
     FileMaximumInformation
 // begin_wdm
 } FILE_INFORMATION_CLASS, *PFILE_INFORMATION_CLASS;
@@ -609,6 +612,7 @@ typedef struct _FILE_OBJECTID_INFORMATION {
 //      FILE_SHORT_NAME_INFORMATION
 //      FILE_STREAM_INFORMATION
 //      FILE_COMPLETION_INFORMATION
+//      FILE_IO_PRIORITY_HINT_INFORMATION
 
 //      FILE_PIPE_INFORMATION
 //      FILE_PIPE_LOCAL_INFORMATION
@@ -757,6 +761,21 @@ typedef struct _FILE_COMPLETION_INFORMATION {
     PVOID Key;
 } FILE_COMPLETION_INFORMATION, *PFILE_COMPLETION_INFORMATION;
 
+// Define the I/O priority classes.
+// Requests of a more urgent class are started ahead of less urgent ones by devices that queue through IoStartPacket.
+typedef enum _IO_PRIORITY_HINT {
+    IoPriorityBackground = 0,
+    IoPriorityLow,
+    IoPriorityNormal,
+    IoPriorityHigh,
+    IoPriorityCritical,
+    MaxIoPriorityTypes
+} IO_PRIORITY_HINT;
+
+typedef struct _FILE_IO_PRIORITY_HINT_INFORMATION {
+    IO_PRIORITY_HINT PriorityHint;
+} FILE_IO_PRIORITY_HINT_INFORMATION, *PFILE_IO_PRIORITY_HINT_INFORMATION;
+
 typedef struct _FILE_PIPE_INFORMATION {
      ULONG ReadMode;
      ULONG CompletionMode;
@@ -1214,6 +1233,66 @@ NTSYSCALLAPI NTSTATUS NTAPI NtWriteFileGather (
     __in_opt PULONG Key
     );
 
+NTSYSCALLAPI NTSTATUS NTAPI NtRegisterIoBuffer (__in_bcount(Length) PVOID Buffer, __in ULONG Length, __out_opt PULONG BufferIndex);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtUnregisterIoBuffer (__in PVOID Buffer);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtRegisterIoHandle (__in HANDLE FileHandle, __out PULONG FileIndex);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtUnregisterIoHandle (__in ULONG FileIndex);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtReadFileRegistered (
+    __in ULONG FileIndex,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in ULONG BufferIndex,
+    __in ULONG BufferOffset,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+    );
+
+NTSYSCALLAPI NTSTATUS NTAPI NtWriteFileRegistered (
+    __in ULONG FileIndex,
+    __in_opt HANDLE Event,
+    __in_opt PIO_APC_ROUTINE ApcRoutine,
+    __in_opt PVOID ApcContext,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in ULONG BufferIndex,
+    __in ULONG BufferOffset,
+    __in ULONG Length,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+    );
+
+// A segment of the caller's memory for NtReadFileVector and NtWriteFileVector.  Segments may be of any length and alignment.
+typedef struct _FILE_IO_SEGMENT {
+    PVOID Buffer;
+    ULONG Length;
+} FILE_IO_SEGMENT, *PFILE_IO_SEGMENT;
+
+#define IO_VECTOR_MAXIMUM_SEGMENTS 1024
+
+NTSYSCALLAPI NTSTATUS NTAPI NtReadFileVector (
+    __in HANDLE FileHandle,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_ecount(NumberOfSegments) PFILE_IO_SEGMENT SegmentArray,
+    __in ULONG NumberOfSegments,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+    );
+
+NTSYSCALLAPI NTSTATUS NTAPI NtWriteFileVector (
+    __in HANDLE FileHandle,
+    __out PIO_STATUS_BLOCK IoStatusBlock,
+    __in_ecount(NumberOfSegments) PFILE_IO_SEGMENT SegmentArray,
+    __in ULONG NumberOfSegments,
+    __in_opt PLARGE_INTEGER ByteOffset,
+    __in_opt PULONG Key
+    );
+
 NTSYSCALLAPI NTSTATUS NTAPI NtLoadDriver (__in PUNICODE_STRING DriverServiceName);
 NTSYSCALLAPI NTSTATUS NTAPI NtUnloadDriver (__in PUNICODE_STRING DriverServiceName);
 
@@ -2317,6 +2396,57 @@ typedef struct _IO_COMPLETION_BASIC_INFORMATION {
     LONG Depth;
 } IO_COMPLETION_BASIC_INFORMATION, *PIO_COMPLETION_BASIC_INFORMATION;
 
+// I/O Completion Entry Information Structure returned by NtRemoveIoCompletionEx.
+typedef struct _FILE_IO_COMPLETION_INFORMATION {
+    PVOID KeyContext;
+    PVOID ApcContext;
+    IO_STATUS_BLOCK IoStatusBlock;
+} FILE_IO_COMPLETION_INFORMATION, *PFILE_IO_COMPLETION_INFORMATION;
+
+// I/O ring used by NtEnterIoRing.
+// The header is followed by SubmissionEntries submission entries and then CompletionEntries completion entries; both counts are powers of two.
+// The caller fills submissions and advances SubmissionTail, and consumes completions and advances CompletionHead.
+// The system advances SubmissionHead and CompletionTail.  The indexes run freely and are masked with the entry count.
+typedef enum _IO_RING_OPERATION {
+    IoRingOperationRead,
+    IoRingOperationWrite,
+    IoRingOperationReadRegistered,
+    IoRingOperationWriteRegistered,
+    IoRingOperationDeviceControl
+} IO_RING_OPERATION;
+
+typedef struct _IO_RING_SUBMISSION_ENTRY {
+    ULONG Operation;                    // IO_RING_OPERATION
+    ULONG Key;
+    HANDLE FileHandle;                  // Read, Write and DeviceControl
+    ULONG FileIndex;                    // ReadRegistered and WriteRegistered
+    ULONG IoControlCode;                // DeviceControl
+    PVOID Buffer;                       // Read, Write, and the DeviceControl input buffer
+    ULONG Length;
+    ULONG BufferIndex;                  // ReadRegistered and WriteRegistered
+    ULONG BufferOffset;                 // ReadRegistered and WriteRegistered
+    ULONG OutputBufferLength;           // DeviceControl
+    PVOID OutputBuffer;                 // DeviceControl
+    LARGE_INTEGER ByteOffset;
+    PVOID UserData;                     // Returned as the ApcContext of the completion
+    PIO_STATUS_BLOCK IoStatusBlock;
+} IO_RING_SUBMISSION_ENTRY, *PIO_RING_SUBMISSION_ENTRY;
+
+typedef struct _IO_RING {
+    ULONG SubmissionHead;
+    ULONG SubmissionTail;
+    ULONG CompletionHead;
+    ULONG CompletionTail;
+    ULONG SubmissionEntries;
+    ULONG CompletionEntries;
+    ULONG Reserved[2];
+} IO_RING, *PIO_RING;
+
+#define IO_RING_MAXIMUM_ENTRIES 4096
+
+#define IO_RING_SIZE(SubmissionEntries, CompletionEntries) \
+    (sizeof(IO_RING) + ((SubmissionEntries) * sizeof(IO_RING_SUBMISSION_ENTRY)) + ((CompletionEntries) * sizeof(FILE_IO_COMPLETION_INFORMATION)))
+
 NTSYSCALLAPI NTSTATUS NTAPI NtCreateIoCompletion (
     __out PHANDLE IoCompletionHandle,
     __in ACCESS_MASK DesiredAccess,
@@ -2350,6 +2480,21 @@ NTSYSCALLAPI NTSTATUS NTAPI NtRemoveIoCompletion (
     __in_opt PLARGE_INTEGER Timeout
     );
 
+NTSYSCALLAPI NTSTATUS NTAPI NtEnterIoRing (
+    __inout PIO_RING Ring,
+    __in HANDLE IoCompletionHandle,
+    __in ULONG MinimumCompletions,
+    __in_opt PLARGE_INTEGER Timeout
+    );
+
+NTSYSCALLAPI NTSTATUS NTAPI NtRemoveIoCompletionEx (
+    __in HANDLE IoCompletionHandle,
+    __out_ecount(Count) PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+    __in ULONG Count,
+    __out PULONG NumEntriesRemoved,
+    __in_opt PLARGE_INTEGER Timeout
+    );
+
 
 // Defines that are used to access the registry, but are not registry specific.
 
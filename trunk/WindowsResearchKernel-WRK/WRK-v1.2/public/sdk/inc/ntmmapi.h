@@ -185,6 +185,7 @@ extern "C" {
     typedef enum _SECTION_INFORMATION_CLASS {
         SectionBasicInformation,
         SectionImageInformation,
+        SectionReadAheadInformation,
         MaxSectionInfoClass  // MaxSectionInfoClass should always be the last enum
     } SECTION_INFORMATION_CLASS;
 
@@ -200,6 +201,22 @@ extern "C" {
         LARGE_INTEGER MaximumSize;
     } SECTION_BASIC_INFORMATION, * PSECTION_BASIC_INFORMATION;
 
+    // Read ahead pages are pages read in beside the faulting page for user views of a data file.
+    // They are hits if the next read started right after them, wasted if it did not,
+    // and pending until the next read, so ReadAheadPages - ReadAheadHits - PendingPages were wasted.
+    typedef struct _SECTION_READ_AHEAD_INFORMATION {
+        ULONG ClusterSize;
+        ULONG ReadAheadPages;
+        ULONG ReadAheadHits;
+        ULONG PendingPages;
+    } SECTION_READ_AHEAD_INFORMATION, * PSECTION_READ_AHEAD_INFORMATION;
+
+    // A range of a process passed to NtPrefetchVirtualMemory, NtAllocateVirtualMemoryRanges and NtFreeVirtualMemoryRanges.
+    typedef struct _MEMORY_RANGE_ENTRY {
+        PVOID VirtualAddress;
+        SIZE_T NumberOfBytes;
+    } MEMORY_RANGE_ENTRY, * PMEMORY_RANGE_ENTRY;
+
 #if _MSC_VER >= 1200
 #pragma warning(push)
 #endif
@@ -316,6 +333,7 @@ extern "C" {
 #define MEM_TOP_DOWN       0x100000     // winnt ntddk wdm
 #define MEM_WRITE_WATCH    0x200000     // winnt
 #define MEM_PHYSICAL       0x400000     // winnt
+#define MEM_ADVISE        0x2000000
 #define MEM_LARGE_PAGES  0x20000000     // winnt ntddk wdm
 #define MEM_DOS_LIM      0x40000000
 #define MEM_4MB_PAGES    0x80000000     // winnt ntddk wdm
@@ -333,6 +351,14 @@ extern "C" {
 #define MEM_IMAGE         SEC_IMAGE     // winnt
 
 #define WRITE_WATCH_FLAG_RESET 0x01     // winnt
+#define WRITE_WATCH_FLAG_BITMAP 0x02
+
+// Advice passed as the protection of a MEM_ADVISE allocation.
+#define MEM_ADVICE_NORMAL       0
+#define MEM_ADVICE_RANDOM       1
+#define MEM_ADVICE_SEQUENTIAL   2
+#define MEM_ADVICE_WILLNEED     3
+#define MEM_ADVICE_DONTNEED     4
 
 #define MAP_PROCESS 1L
 #define MAP_SYSTEM  2L
@@ -387,6 +413,19 @@ extern "C" {
 
     // end_ntifs
 
+    NTSYSCALLAPI NTSTATUS NTAPI NtAllocateVirtualMemoryRanges(__in HANDLE ProcessHandle,
+                                                              __in ULONG_PTR NumberOfEntries,
+                                                              __inout_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY Ranges,
+                                                              __in ULONG AllocationType,
+                                                              __in ULONG Protect,
+                                                              __out_opt PULONG_PTR NumberOfEntriesProcessed);
+
+    NTSYSCALLAPI NTSTATUS NTAPI NtFreeVirtualMemoryRanges(__in HANDLE ProcessHandle,
+                                                          __in ULONG_PTR NumberOfEntries,
+                                                          __inout_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY Ranges,
+                                                          __in ULONG FreeType,
+                                                          __out_opt PULONG_PTR NumberOfEntriesProcessed);
+
     NTSYSCALLAPI NTSTATUS NTAPI NtReadVirtualMemory(__in HANDLE ProcessHandle,
                                                     __in_opt PVOID BaseAddress,
                                                     __out_bcount(BufferSize) PVOID Buffer,
@@ -403,6 +442,9 @@ extern "C" {
                                                      __inout PVOID* BaseAddress,
                                                      __inout PSIZE_T RegionSize,
                                                      __out PIO_STATUS_BLOCK IoStatus);
+    NTSYSCALLAPI NTSTATUS NTAPI NtPrefetchVirtualMemory(__in ULONG_PTR NumberOfEntries,
+                                                        __in_ecount(NumberOfEntries) PMEMORY_RANGE_ENTRY VirtualAddresses,
+                                                        __in ULONG Flags);
     NTSYSCALLAPI NTSTATUS NTAPI NtLockVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID* BaseAddress, __inout PSIZE_T RegionSize, __in ULONG MapType);
     NTSYSCALLAPI NTSTATUS NTAPI NtUnlockVirtualMemory(__in HANDLE ProcessHandle, __inout PVOID* BaseAddress, __inout PSIZE_T RegionSize, __in ULONG MapType);
     NTSYSCALLAPI NTSTATUS NTAPI NtProtectVirtualMemory(__in HANDLE ProcessHandle,
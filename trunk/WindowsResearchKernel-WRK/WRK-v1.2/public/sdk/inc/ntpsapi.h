@@ -413,6 +413,7 @@ typedef enum _PROCESSINFOCLASS {
     ProcessResourceManagement,
     ProcessCookie,
     ProcessImageInformation,
+    ProcessPreferredNode,
     MaxProcessInfoClass             // MaxProcessInfoClass should always be the last enum
 } PROCESSINFOCLASS;
 
@@ -439,6 +440,7 @@ typedef enum _THREADINFOCLASS {
     ThreadBreakOnTermination,
     ThreadSwitchLegacyState,
     ThreadIsTerminated,
+    ThreadIoPriority,
     MaxThreadInfoClass
     } THREADINFOCLASS;
 // end_ntddk end_ntifs